@@ -0,0 +1,54 @@
+module;
+#include <folly/Function.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include <folly/executors/thread_factory/ThreadFactory.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+
+export module halo.common.threads:Executors;
+import :ThreadBudget;
+
+namespace halo::common::threads {
+
+// Names the threads of a pool and marks them as executor threads. Owned by
+// the pool, so it holds the pool's reservation for as long as the pool
+// lives.
+class BudgetedThreadFactory final : public folly::ThreadFactory {
+ public:
+  BudgetedThreadFactory(ThreadLease reservation, std::string prefix)
+      : reservation_(std::move(reservation)), named_(std::move(prefix)) {}
+
+  std::thread newThread(folly::Func&& func) override {
+    return named_.newThread([func = std::move(func)]() mutable {
+      const ExecutorThreadScope scope;
+      func();
+    });
+  }
+
+  const std::string& getNamePrefix() const override {
+    return named_.getNamePrefix();
+  }
+
+ private:
+  const ThreadLease reservation_;
+  folly::NamedThreadFactory named_;
+};
+
+// A CPU pool of `threads' that reserves them from `budget' until it is
+// destroyed. Library calls its tasks make through ScopedParallelism run
+// on at most `executor_call_threads' each.
+export std::shared_ptr<folly::CPUThreadPoolExecutor> makeBudgetedExecutor(
+    ThreadBudget& budget, std::size_t threads, std::string prefix) {
+  return std::make_shared<folly::CPUThreadPoolExecutor>(
+      threads, std::make_shared<BudgetedThreadFactory>(
+                   budget.reserve(static_cast<std::uint32_t>(threads)),
+                   std::move(prefix)));
+}
+
+}  // namespace halo::common::threads
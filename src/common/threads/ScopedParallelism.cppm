@@ -0,0 +1,55 @@
+module;
+#include <omp.h>
+#ifdef __linux__
+#include <cblas.h>
+#endif
+
+#include <cstdint>
+
+export module halo.common.threads:ScopedParallelism;
+import :ThreadBudget;
+
+namespace halo::common::threads {
+
+// Leases threads for the parallel library calls the current thread makes
+// while it lives, and sizes the OpenMP team and the OpenBLAS thread count
+// of this thread to the lease: FAISS, BLAS and `omp parallel' regions run
+// on as many threads as were granted. Restores both counts on the way
+// out. Both settings are per thread, so calls on other threads keep their
+// own.
+//
+// Open one around the call, not across code that waits on other work:
+// the leased threads are unavailable to the rest of the process until it
+// closes.
+export class ScopedParallelism final {
+ public:
+  // Up to `wanted' threads, or as many as `budget' has for 0.
+  ScopedParallelism(ThreadBudget& budget, std::uint32_t wanted)
+      : lease_(budget.lease(wanted)), omp_threads_(omp_get_max_threads()) {
+    const auto threads = static_cast<int>(lease_.threads());
+    omp_set_num_threads(threads);
+#ifdef __linux__
+    blas_threads_ = openblas_set_num_threads_local(threads);
+#endif
+  }
+
+  ScopedParallelism(const ScopedParallelism&) = delete;
+  ScopedParallelism& operator=(const ScopedParallelism&) = delete;
+
+  ~ScopedParallelism() {
+    omp_set_num_threads(omp_threads_);
+#ifdef __linux__
+    openblas_set_num_threads_local(blas_threads_);
+#endif
+  }
+
+  [[nodiscard]] std::uint32_t threads() const { return lease_.threads(); }
+
+ private:
+  const ThreadLease lease_;
+  const int omp_threads_;
+  // What this thread had before; 0 for the process-wide count.
+  int blas_threads_ = 0;
+};
+
+}  // namespace halo::common::threads
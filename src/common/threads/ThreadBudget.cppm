@@ -0,0 +1,202 @@
+module;
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+export module halo.common.threads:ThreadBudget;
+import halo.common;
+
+namespace halo::common::threads {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+export struct ThreadBudgetOptions {
+  // Threads the process keeps busy at once; about one per core.
+  std::uint32_t threads = std::max(1U, std::thread::hardware_concurrency());
+  // Most threads a call from an executor thread, such as a Velox driver,
+  // runs on, its own included. The executor pools already fill the cores
+  // they reserved, so by default such calls run single-threaded.
+  std::uint32_t executor_call_threads = 1;
+};
+
+export struct ThreadBudgetStats {
+  std::uint64_t leases = 0;
+  // Leases granted fewer threads than they asked for.
+  std::uint64_t capped = 0;
+  // Threads held by executor pools, and helper threads held by leases.
+  std::uint32_t reserved = 0;
+  std::uint32_t leased = 0;
+};
+
+thread_local bool on_executor_thread = false;
+
+// Marks the current thread as an executor thread for as long as it lives,
+// for pools that aren't made by makeBudgetedExecutor(): library calls made
+// from it then lease at most `executor_call_threads'.
+export class ExecutorThreadScope final {
+ public:
+  ExecutorThreadScope() : outer_(on_executor_thread) {
+    on_executor_thread = true;
+  }
+
+  ExecutorThreadScope(const ExecutorThreadScope&) = delete;
+  ExecutorThreadScope& operator=(const ExecutorThreadScope&) = delete;
+
+  ~ExecutorThreadScope() { on_executor_thread = outer_; }
+
+ private:
+  const bool outer_;
+};
+
+export class ThreadBudget;
+
+// Threads granted by a ThreadBudget, given back when the lease goes away.
+// Move-only; must not outlive its budget.
+export class ThreadLease final {
+ public:
+  ThreadLease(ThreadLease&& other) noexcept
+      : budget_(std::exchange(other.budget_, nullptr)),
+        threads_(other.threads_),
+        charged_(other.charged_),
+        reservation_(other.reservation_) {}
+
+  ThreadLease& operator=(ThreadLease&& other) noexcept {
+    if (this != &other) {
+      release();
+      budget_ = std::exchange(other.budget_, nullptr);
+      threads_ = other.threads_;
+      charged_ = other.charged_;
+      reservation_ = other.reservation_;
+    }
+    return *this;
+  }
+
+  ThreadLease(const ThreadLease&) = delete;
+  ThreadLease& operator=(const ThreadLease&) = delete;
+
+  ~ThreadLease() { release(); }
+
+  // Threads the holder may run on, its own included.
+  [[nodiscard]] std::uint32_t threads() const { return threads_; }
+
+ private:
+  friend class ThreadBudget;
+
+  ThreadLease(ThreadBudget* budget, std::uint32_t threads,
+              std::uint32_t charged, bool reservation)
+      : budget_(budget),
+        threads_(threads),
+        charged_(charged),
+        reservation_(reservation) {}
+
+  inline void release();
+
+  ThreadBudget* budget_;
+  std::uint32_t threads_;
+  // What the lease counts against the budget.
+  std::uint32_t charged_;
+  bool reservation_;
+};
+
+// Shares the cores among the thread pools of a process: the folly
+// executors that run Velox drivers and sessions, and the OpenMP and
+// OpenBLAS pools that FAISS and BLAS calls start on whatever thread makes
+// them. Left alone, each of those sizes itself to the whole machine: a
+// driver per core, each starting a team per core, runs cores * cores
+// threads.
+//
+// Executor pools reserve their threads for as long as they live. A call
+// site that can go parallel leases helper threads from what is left,
+// never waiting: it is granted what is free, down to running on its own
+// thread alone, and from an executor thread no more than
+// `executor_call_threads'. The caller's own thread is not counted, since
+// it is either an executor thread, already reserved, or runs nothing else
+// while it waits for the call.
+//
+// Thread-safe.
+export class ThreadBudget final {
+ public:
+  static StatusOr<std::unique_ptr<ThreadBudget>> create(
+      const ThreadBudgetOptions& options = {}) {
+    if (options.threads == 0 || options.executor_call_threads == 0) {
+      return Status::Invalid("thread budget counts must be positive");
+    }
+    return std::unique_ptr<ThreadBudget>(new ThreadBudget(options));
+  }
+
+  // The budget of the process, with the default options.
+  static ThreadBudget& global() {
+    static ThreadBudget budget{ThreadBudgetOptions{}};
+    return budget;
+  }
+
+  ThreadBudget(const ThreadBudget&) = delete;
+  ThreadBudget& operator=(const ThreadBudget&) = delete;
+
+  // Up to `wanted' threads for a parallel call, the caller's included, or
+  // as many as the budget has for 0. Always at least one.
+  ThreadLease lease(std::uint32_t wanted) {
+    if (wanted == 0) {
+      wanted = options_.threads;
+    }
+    const auto allowed = on_executor_thread
+                             ? std::min(wanted, options_.executor_call_threads)
+                             : wanted;
+    const std::lock_guard lock(mutex_);
+    const auto busy = stats_.reserved + stats_.leased;
+    const auto free = options_.threads > busy ? options_.threads - busy : 0;
+    const auto helpers = std::min(allowed - 1, free);
+    stats_.leased += helpers;
+    ++stats_.leases;
+    if (helpers + 1 < wanted) {
+      ++stats_.capped;
+    }
+    return ThreadLease(this, helpers + 1, helpers, false);
+  }
+
+  // Counts the `threads' of an executor pool against the budget until the
+  // lease goes away. Always granted in full: a pool needs its threads, and
+  // reserving past the budget leaves calls nothing to lease.
+  ThreadLease reserve(std::uint32_t threads) {
+    const std::lock_guard lock(mutex_);
+    stats_.reserved += threads;
+    return ThreadLease(this, threads, threads, true);
+  }
+
+  // Whether the current thread belongs to an executor pool.
+  static bool onExecutorThread() { return on_executor_thread; }
+
+  [[nodiscard]] ThreadBudgetStats stats() const {
+    const std::lock_guard lock(mutex_);
+    return stats_;
+  }
+
+  [[nodiscard]] const ThreadBudgetOptions& options() const { return options_; }
+
+ private:
+  friend class ThreadLease;
+
+  explicit ThreadBudget(const ThreadBudgetOptions& options)
+      : options_(options) {}
+
+  void release(std::uint32_t charged, bool reservation) {
+    const std::lock_guard lock(mutex_);
+    (reservation ? stats_.reserved : stats_.leased) -= charged;
+  }
+
+  const ThreadBudgetOptions options_;
+  mutable std::mutex mutex_;
+  ThreadBudgetStats stats_;
+};
+
+void ThreadLease::release() {
+  if (budget_ != nullptr) {
+    std::exchange(budget_, nullptr)->release(charged_, reservation_);
+  }
+}
+
+}  // namespace halo::common::threads
@@ -0,0 +1,4 @@
+export module halo.common.threads;
+export import :Executors;
+export import :ScopedParallelism;
+export import :ThreadBudget;
@@ -0,0 +1,152 @@
+module;
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+export module halo.exec.crypto:AesGcm;
+import halo.common;
+
+namespace halo::exec::crypto {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+// A sealed value is its nonce, its ciphertext and its tag, in that order.
+export constexpr std::size_t kAesGcmNonceBytes = 12;
+export constexpr std::size_t kAesGcmTagBytes = 16;
+export constexpr std::size_t kAesGcmOverhead =
+    kAesGcmNonceBytes + kAesGcmTagBytes;
+
+export enum class AesGcmMode { kEncrypt, kDecrypt };
+
+// AES-GCM under one key, for every value of a batch. create() expands the
+// key and precomputes the GHASH tables once; each value then only sets its
+// nonce on the same context, where a context per value pays for both
+// again, which costs more than sealing a short value. OpenSSL runs the
+// cipher on AES-NI and GHASH on carry-less multiplies where the CPU has
+// them.
+export class AesGcm final {
+ public:
+  // AES-128, -192 or -256 by the size of `key'.
+  static StatusOr<AesGcm> create(std::string_view key, AesGcmMode mode) {
+    const EVP_CIPHER* cipher = nullptr;
+    switch (key.size()) {
+      case 16:
+        cipher = EVP_aes_128_gcm();
+        break;
+      case 24:
+        cipher = EVP_aes_192_gcm();
+        break;
+      case 32:
+        cipher = EVP_aes_256_gcm();
+        break;
+      default:
+        return Status::Invalid("AES-GCM keys are 16, 24 or 32 bytes, not " +
+                               std::to_string(key.size()));
+    }
+    std::unique_ptr<EVP_CIPHER_CTX, FreeContext> context(
+        EVP_CIPHER_CTX_new());
+    const auto initialized =
+        context != nullptr &&
+        (mode == AesGcmMode::kEncrypt
+             ? EVP_EncryptInit_ex(context.get(), cipher, nullptr,
+                                  bytesOf(key), nullptr)
+             : EVP_DecryptInit_ex(context.get(), cipher, nullptr,
+                                  bytesOf(key), nullptr)) == 1;
+    if (!initialized) {
+      return Status::Error("cannot set up AES-GCM");
+    }
+    return AesGcm(std::move(context), mode);
+  }
+
+  // Writes `plaintext' sealed under `nonce' to `out', plaintext.size() +
+  // kAesGcmOverhead bytes.
+  Status seal(std::string_view plaintext, const std::uint8_t* nonce,
+              std::uint8_t* out) {
+    std::copy(nonce, nonce + kAesGcmNonceBytes, out);
+    auto* ciphertext = out + kAesGcmNonceBytes;
+    int size = 0;
+    int final_size = 0;
+    const auto sealed =
+        mode_ == AesGcmMode::kEncrypt &&
+        EVP_EncryptInit_ex(context_.get(), nullptr, nullptr, nullptr,
+                           nonce) == 1 &&
+        EVP_EncryptUpdate(context_.get(), ciphertext, &size,
+                          bytesOf(plaintext),
+                          static_cast<int>(plaintext.size())) == 1 &&
+        EVP_EncryptFinal_ex(context_.get(), ciphertext + size,
+                            &final_size) == 1 &&
+        EVP_CIPHER_CTX_ctrl(context_.get(), EVP_CTRL_GCM_GET_TAG,
+                            kAesGcmTagBytes,
+                            ciphertext + plaintext.size()) == 1;
+    return sealed ? Status::OK() : Status::Error("cannot seal with AES-GCM");
+  }
+
+  // Writes the plaintext of `sealed' to `out', sealed.size() -
+  // kAesGcmOverhead bytes. Fails unless the value is one sealed under this
+  // key, unaltered.
+  Status open(std::string_view sealed, std::uint8_t* out) {
+    if (mode_ != AesGcmMode::kDecrypt) {
+      return Status::Error("cannot open with an AES-GCM encryptor");
+    }
+    if (sealed.size() < kAesGcmOverhead) {
+      return Status::Invalid("AES-GCM value is shorter than its overhead");
+    }
+    const auto* nonce = bytesOf(sealed);
+    const auto* ciphertext = nonce + kAesGcmNonceBytes;
+    const auto size = static_cast<int>(sealed.size() - kAesGcmOverhead);
+    // OpenSSL takes the expected tag through a non-const pointer.
+    auto* tag = const_cast<unsigned char*>(ciphertext + size);
+    int written = 0;
+    int final_size = 0;
+    const auto opened =
+        EVP_DecryptInit_ex(context_.get(), nullptr, nullptr, nullptr,
+                           nonce) == 1 &&
+        EVP_DecryptUpdate(context_.get(), out, &written, ciphertext, size) ==
+            1 &&
+        EVP_CIPHER_CTX_ctrl(context_.get(), EVP_CTRL_GCM_SET_TAG,
+                            kAesGcmTagBytes, tag) == 1 &&
+        EVP_DecryptFinal_ex(context_.get(), out + written, &final_size) == 1;
+    return opened ? Status::OK()
+                  : Status::Invalid("AES-GCM value does not authenticate");
+  }
+
+ private:
+  struct FreeContext {
+    void operator()(EVP_CIPHER_CTX* context) const {
+      EVP_CIPHER_CTX_free(context);
+    }
+  };
+
+  AesGcm(std::unique_ptr<EVP_CIPHER_CTX, FreeContext> context,
+         AesGcmMode mode)
+      : context_(std::move(context)), mode_(mode) {}
+
+  static const unsigned char* bytesOf(std::string_view value) {
+    return reinterpret_cast<const unsigned char*>(value.data());
+  }
+
+  std::unique_ptr<EVP_CIPHER_CTX, FreeContext> context_;
+  AesGcmMode mode_;
+};
+
+// Fresh random nonces for `count' values, kAesGcmNonceBytes each, drawn in
+// one call rather than one per value.
+export StatusOr<std::vector<std::uint8_t>> randomNonces(std::size_t count) {
+  std::vector<std::uint8_t> nonces(count * kAesGcmNonceBytes);
+  if (!nonces.empty() &&
+      RAND_bytes(nonces.data(), static_cast<int>(nonces.size())) != 1) {
+    return Status::Error("cannot draw AES-GCM nonces");
+  }
+  return nonces;
+}
+
+}  // namespace halo::exec::crypto
@@ -0,0 +1,223 @@
+module;
+#include <velox/common/base/Exceptions.h>
+#include <velox/common/base/Status.h>
+#include <velox/expression/DecodedArgs.h>
+#include <velox/expression/EvalCtx.h>
+#include <velox/expression/FunctionSignature.h>
+#include <velox/expression/VectorFunction.h>
+#include <velox/type/StringView.h>
+#include <velox/type/Type.h>
+#include <velox/vector/BaseVector.h>
+#include <velox/vector/ConstantVector.h>
+#include <velox/vector/DecodedVector.h>
+#include <velox/vector/FlatVector.h>
+#include <velox/vector/SelectivityVector.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+export module halo.exec.crypto:CryptoFunctions;
+import halo.common;
+import :AesGcm;
+import :Sha256Lanes;
+
+namespace halo::exec::crypto {
+
+namespace velox = facebook::velox;
+
+// The selected rows of the first argument and their values, in row order,
+// so that a kernel takes the whole batch in one call.
+struct Batch {
+  std::vector<velox::vector_size_t> rows;
+  std::vector<std::string_view> values;
+};
+
+Batch gatherBatch(const velox::SelectivityVector& rows,
+                  const velox::DecodedVector& input) {
+  Batch batch;
+  batch.rows.reserve(rows.countSelected());
+  batch.values.reserve(rows.countSelected());
+  rows.applyToSelected([&](velox::vector_size_t row) {
+    const auto value = input.valueAt<velox::StringView>(row);
+    batch.rows.push_back(row);
+    batch.values.emplace_back(value.data(), value.size());
+  });
+  return batch;
+}
+
+// The constant key argument: one key per call, so one context per batch.
+std::string_view constantKey(const std::vector<velox::VectorPtr>& args,
+                             const std::string& name) {
+  VELOX_USER_CHECK(args[1]->isConstantEncoding() && !args[1]->isNullAt(0),
+                   "{}() needs a constant, non-null key", name);
+  const auto key =
+      args[1]->as<velox::ConstantVector<velox::StringView>>()->valueAt(0);
+  return {key.data(), key.size()};
+}
+
+velox::StringView viewOf(const std::uint8_t* data, std::size_t size) {
+  return velox::StringView(reinterpret_cast<const char*>(data),
+                           static_cast<std::int32_t>(size));
+}
+
+// Sets the digest of each row of `batch' from `digests'.
+void setDigests(const Batch& batch, const std::vector<std::uint8_t>& digests,
+                const velox::SelectivityVector& rows,
+                velox::exec::EvalCtx& context, velox::VectorPtr& result) {
+  context.ensureWritable(rows, velox::VARBINARY(), result);
+  auto* hashes = result->asUnchecked<velox::FlatVector<velox::StringView>>();
+  for (std::size_t i = 0; i < batch.rows.size(); ++i) {
+    hashes->set(batch.rows[i],
+                viewOf(digests.data() + kSha256Bytes * i, kSha256Bytes));
+  }
+}
+
+// sha256(varbinary) -> varbinary, and over varchar by its bytes.
+class Sha256Function final : public velox::exec::VectorFunction {
+ public:
+  void apply(const velox::SelectivityVector& rows,
+             std::vector<velox::VectorPtr>& args,
+             const velox::TypePtr& /*outputType*/,
+             velox::exec::EvalCtx& context,
+             velox::VectorPtr& result) const override {
+    velox::exec::DecodedArgs decoded_args(rows, args, context);
+    const auto batch = gatherBatch(rows, *decoded_args.at(0));
+    std::vector<std::uint8_t> digests(kSha256Bytes * batch.values.size());
+    sha256Batch(batch.values, digests.data());
+    setDigests(batch, digests, rows, context, result);
+  }
+};
+
+// hmac_sha256(varbinary, constant varbinary) -> varbinary.
+class HmacSha256Function final : public velox::exec::VectorFunction {
+ public:
+  void apply(const velox::SelectivityVector& rows,
+             std::vector<velox::VectorPtr>& args,
+             const velox::TypePtr& /*outputType*/,
+             velox::exec::EvalCtx& context,
+             velox::VectorPtr& result) const override {
+    const HmacSha256 hmac(constantKey(args, "hmac_sha256"));
+    velox::exec::DecodedArgs decoded_args(rows, args, context);
+    const auto batch = gatherBatch(rows, *decoded_args.at(0));
+    std::vector<std::uint8_t> digests(kSha256Bytes * batch.values.size());
+    hmac.hash(batch.values, digests.data());
+    setDigests(batch, digests, rows, context, result);
+  }
+};
+
+// aes_gcm_encrypt(varbinary, constant varbinary) -> varbinary: each value
+// sealed under a random nonce, as nonce, ciphertext and tag. Registered as
+// non-deterministic, so that Velox doesn't evaluate it once per distinct
+// value of a dictionary and hand every row of that value the same nonce.
+//
+// Random 96-bit nonces are only safe for about 2^32 values under one key
+// (NIST SP 800-38D): past that the chance of a repeated nonce, which gives
+// away the XOR of two plaintexts and the key's authentication subkey,
+// exceeds 2^-32. Rotate the key before a column or table gets there.
+class AesGcmEncryptFunction final : public velox::exec::VectorFunction {
+ public:
+  void apply(const velox::SelectivityVector& rows,
+             std::vector<velox::VectorPtr>& args,
+             const velox::TypePtr& /*outputType*/,
+             velox::exec::EvalCtx& context,
+             velox::VectorPtr& result) const override {
+    auto cipher =
+        AesGcm::create(constantKey(args, "aes_gcm_encrypt"),
+                       AesGcmMode::kEncrypt);
+    VELOX_USER_CHECK(cipher.ok(), cipher.status().toString());
+    velox::exec::DecodedArgs decoded_args(rows, args, context);
+    const auto batch = gatherBatch(rows, *decoded_args.at(0));
+    const auto nonces = randomNonces(batch.values.size());
+    VELOX_CHECK(nonces.ok(), nonces.status().toString());
+    context.ensureWritable(rows, velox::VARBINARY(), result);
+    auto* sealed = result->asUnchecked<velox::FlatVector<velox::StringView>>();
+    std::vector<std::uint8_t> scratch;
+    for (std::size_t i = 0; i < batch.rows.size(); ++i) {
+      const auto value = batch.values[i];
+      scratch.resize(value.size() + kAesGcmOverhead);
+      const auto status = cipher->seal(
+          value, nonces->data() + kAesGcmNonceBytes * i, scratch.data());
+      VELOX_CHECK(status.ok(), status.toString());
+      sealed->set(batch.rows[i], viewOf(scratch.data(), scratch.size()));
+    }
+  }
+};
+
+// aes_gcm_decrypt(varbinary, constant varbinary) -> varbinary. A value
+// that doesn't authenticate under the key is an error for its row.
+class AesGcmDecryptFunction final : public velox::exec::VectorFunction {
+ public:
+  void apply(const velox::SelectivityVector& rows,
+             std::vector<velox::VectorPtr>& args,
+             const velox::TypePtr& /*outputType*/,
+             velox::exec::EvalCtx& context,
+             velox::VectorPtr& result) const override {
+    auto cipher =
+        AesGcm::create(constantKey(args, "aes_gcm_decrypt"),
+                       AesGcmMode::kDecrypt);
+    VELOX_USER_CHECK(cipher.ok(), cipher.status().toString());
+    velox::exec::DecodedArgs decoded_args(rows, args, context);
+    const auto batch = gatherBatch(rows, *decoded_args.at(0));
+    context.ensureWritable(rows, velox::VARBINARY(), result);
+    auto* opened = result->asUnchecked<velox::FlatVector<velox::StringView>>();
+    std::vector<std::uint8_t> scratch;
+    for (std::size_t i = 0; i < batch.rows.size(); ++i) {
+      const auto value = batch.values[i];
+      // Room for the plaintext, which is shorter.
+      scratch.resize(value.size());
+      const auto status = cipher->open(value, scratch.data());
+      if (!status.ok()) {
+        context.setStatus(batch.rows[i],
+                          velox::Status::UserError(status.toString()));
+        continue;
+      }
+      opened->set(batch.rows[i],
+                  viewOf(scratch.data(), value.size() - kAesGcmOverhead));
+    }
+  }
+};
+
+// Registers `sha256', `hmac_sha256', `aes_gcm_encrypt' and
+// `aes_gcm_decrypt' under `prefix', each taking a whole batch per call.
+// `sha256' and `hmac_sha256' take VARBINARY or VARCHAR; with no prefix
+// they take the place of the Presto functions of the same names, which
+// hash a row at a time.
+export void registerCryptoFunctions(const std::string& prefix = "") {
+  const auto signatures = [](std::size_t arguments) {
+    std::vector<velox::exec::FunctionSignaturePtr> result;
+    for (const auto* input : {"varbinary", "varchar"}) {
+      velox::exec::FunctionSignatureBuilder builder;
+      builder.returnType("varbinary").argumentType(input);
+      if (arguments > 1) {
+        builder.constantArgumentType("varbinary");
+      }
+      result.push_back(builder.build());
+    }
+    return result;
+  };
+  velox::exec::registerVectorFunction(prefix + "sha256", signatures(1),
+                                      std::make_unique<Sha256Function>());
+  velox::exec::registerVectorFunction(
+      prefix + "hmac_sha256", signatures(2),
+      std::make_unique<HmacSha256Function>());
+  velox::exec::registerVectorFunction(
+      prefix + "aes_gcm_encrypt", signatures(2),
+      std::make_unique<AesGcmEncryptFunction>(),
+      velox::exec::VectorFunctionMetadataBuilder()
+          .deterministic(false)
+          .build());
+  velox::exec::registerVectorFunction(
+      prefix + "aes_gcm_decrypt",
+      {velox::exec::FunctionSignatureBuilder()
+           .returnType("varbinary")
+           .argumentType("varbinary")
+           .constantArgumentType("varbinary")
+           .build()},
+      std::make_unique<AesGcmDecryptFunction>());
+}
+
+}  // namespace halo::exec::crypto
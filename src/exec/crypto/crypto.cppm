@@ -0,0 +1,4 @@
+export module halo.exec.crypto;
+export import :AesGcm;
+export import :CryptoFunctions;
+export import :Sha256Lanes;
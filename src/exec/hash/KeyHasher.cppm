@@ -0,0 +1,281 @@
+module;
+// Inlined so that the short inputs of key hashing take xxh3's fixed-size
+// paths without a call.
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+#include <velox/type/StringView.h>
+#include <velox/type/Timestamp.h>
+#include <velox/type/Type.h>
+#include <velox/vector/BaseVector.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/DecodedVector.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+export module halo.exec.hash:KeyHasher;
+import halo.common;
+
+namespace halo::exec::hash {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+namespace velox = facebook::velox;
+
+// xxh3 of `bytes', chained on `seed'.
+export std::uint64_t hashBytes(std::string_view bytes,
+                               std::uint64_t seed = 0) {
+  return XXH3_64bits_withSeed(bytes.data(), bytes.size(), seed);
+}
+
+// xxh3 hasher for maps keyed by strings, looked up by string_view as well.
+export struct StringHash {
+  using is_transparent = void;
+
+  std::size_t operator()(std::string_view value) const {
+    return static_cast<std::size_t>(hashBytes(value));
+  }
+};
+
+// Chains a NULL key onto `seed', apart from any value, the empty string
+// included.
+std::uint64_t hashNull(std::uint64_t seed) {
+  constexpr std::uint64_t kNullSalt = 0x9E3779B97F4A7C15ULL;
+  return XXH3_64bits_withSeed(nullptr, 0, seed ^ kNullSalt);
+}
+
+// Hashes the key columns of batches into one 64-bit hash per row with
+// xxh3, for hash partitioning, grouping and joins. Rows with equal keys
+// hash alike whatever the encoding of their vectors.
+//
+// Fixed-width keys are gathered column by column into a packed row of
+// bytes, and each row is hashed with a single xxh3 call over it; string
+// keys then chain onto that hash, a flat batch of StringViews at a time;
+// keys of other types chain their Velox hashes. Floating-point keys hash
+// -0 as 0 and every NaN alike, matching how they compare.
+//
+// Not thread-safe: holds scratch space for the batch being hashed.
+export class KeyHasher final {
+ public:
+  static StatusOr<KeyHasher> create(
+      const velox::RowTypePtr& type,
+      const std::vector<velox::column_index_t>& keys) {
+    if (keys.empty()) {
+      return Status::Invalid("key hasher needs at least one key column");
+    }
+    KeyHasher hasher;
+    for (const auto key : keys) {
+      if (key >= type->size()) {
+        return Status::Invalid("key column " + std::to_string(key) +
+                               " out of range for " + type->toString());
+      }
+      const auto& key_type = type->childAt(key);
+      const auto width = fixedWidth(key_type->kind());
+      if (width > 0) {
+        hasher.fixed_.push_back(
+            {key, key_type->kind(), hasher.value_bytes_, width});
+        hasher.value_bytes_ += width;
+      } else if (key_type->kind() == velox::TypeKind::VARCHAR ||
+                 key_type->kind() == velox::TypeKind::VARBINARY) {
+        hasher.strings_.push_back(key);
+      } else {
+        hasher.others_.push_back(key);
+      }
+    }
+    // A NULL flag byte per fixed-width key follows the values.
+    hasher.row_bytes_ = hasher.value_bytes_ + hasher.fixed_.size();
+    return hasher;
+  }
+
+  // Replaces `hashes' with the hash of every row of `batch'.
+  void hash(const velox::RowVector& batch,
+            std::vector<std::uint64_t>& hashes) {
+    const auto size = static_cast<std::size_t>(batch.size());
+    hashes.assign(size, 0);
+    if (!fixed_.empty()) {
+      packed_.assign(size * row_bytes_, 0);
+      for (std::size_t k = 0; k < fixed_.size(); ++k) {
+        pack(batch, fixed_[k], value_bytes_ + k, size);
+      }
+      for (std::size_t row = 0; row < size; ++row) {
+        hashes[row] = XXH3_64bits(packed_.data() + row * row_bytes_,
+                                  row_bytes_);
+      }
+    }
+    for (const auto column : strings_) {
+      hashStrings(*batch.childAt(column), hashes);
+    }
+    for (const auto column : others_) {
+      const velox::DecodedVector decoded(*batch.childAt(column));
+      for (std::size_t row = 0; row < size; ++row) {
+        const auto r = static_cast<velox::vector_size_t>(row);
+        if (decoded.isNullAt(r)) {
+          hashes[row] = hashNull(hashes[row]);
+          continue;
+        }
+        const auto value = decoded.base()->hashValueAt(decoded.index(r));
+        hashes[row] =
+            XXH3_64bits_withSeed(&value, sizeof(value), hashes[row]);
+      }
+    }
+  }
+
+  // Bytes of the packed fixed-width part of a row.
+  [[nodiscard]] std::size_t rowBytes() const { return row_bytes_; }
+
+ private:
+  struct FixedKey {
+    velox::column_index_t column;
+    velox::TypeKind kind;
+    // Where the value goes in the packed row.
+    std::size_t offset;
+    std::size_t width;
+  };
+
+  KeyHasher() = default;
+
+  static std::size_t fixedWidth(velox::TypeKind kind) {
+    switch (kind) {
+      case velox::TypeKind::BOOLEAN:
+      case velox::TypeKind::TINYINT:
+        return 1;
+      case velox::TypeKind::SMALLINT:
+        return 2;
+      case velox::TypeKind::INTEGER:
+      case velox::TypeKind::REAL:
+        return 4;
+      case velox::TypeKind::BIGINT:
+      case velox::TypeKind::DOUBLE:
+        return 8;
+      case velox::TypeKind::HUGEINT:
+        return sizeof(velox::int128_t);
+      case velox::TypeKind::TIMESTAMP:
+        return sizeof(velox::Timestamp);
+      default:
+        return 0;
+    }
+  }
+
+  template <typename T>
+  static T canonical(T value) {
+    if constexpr (std::is_floating_point_v<T>) {
+      if (std::isnan(value)) {
+        return std::numeric_limits<T>::quiet_NaN();
+      }
+      if (value == 0) {
+        return 0;
+      }
+    }
+    return value;
+  }
+
+  // Copies the values of `key' into their slot of every packed row, and
+  // sets the NULL flag at `null_offset' of the rows where it is NULL.
+  template <typename T>
+  void packValues(const velox::DecodedVector& decoded, const FixedKey& key,
+                  std::size_t null_offset, std::size_t size) {
+    auto* out = packed_.data() + key.offset;
+    if (decoded.isIdentityMapping() && !decoded.mayHaveNulls()) {
+      const auto* values = decoded.data<T>();
+      for (std::size_t row = 0; row < size; ++row, out += row_bytes_) {
+        const T value = canonical(values[row]);
+        std::memcpy(out, &value, sizeof(T));
+      }
+      return;
+    }
+    for (std::size_t row = 0; row < size; ++row, out += row_bytes_) {
+      const auto r = static_cast<velox::vector_size_t>(row);
+      if (decoded.isNullAt(r)) {
+        packed_[row * row_bytes_ + null_offset] = 1;
+        continue;
+      }
+      const T value = canonical(decoded.valueAt<T>(r));
+      std::memcpy(out, &value, sizeof(T));
+    }
+  }
+
+  void pack(const velox::RowVector& batch, const FixedKey& key,
+            std::size_t null_offset, std::size_t size) {
+    const velox::DecodedVector decoded(*batch.childAt(key.column));
+    switch (key.kind) {
+      case velox::TypeKind::BOOLEAN:
+        // Bit-packed, so always read one by one.
+        for (std::size_t row = 0; row < size; ++row) {
+          const auto r = static_cast<velox::vector_size_t>(row);
+          auto* out = packed_.data() + row * row_bytes_;
+          if (decoded.isNullAt(r)) {
+            out[null_offset] = 1;
+          } else {
+            out[key.offset] = decoded.valueAt<bool>(r) ? 1 : 0;
+          }
+        }
+        return;
+      case velox::TypeKind::TINYINT:
+        return packValues<std::int8_t>(decoded, key, null_offset, size);
+      case velox::TypeKind::SMALLINT:
+        return packValues<std::int16_t>(decoded, key, null_offset, size);
+      case velox::TypeKind::INTEGER:
+        return packValues<std::int32_t>(decoded, key, null_offset, size);
+      case velox::TypeKind::BIGINT:
+        return packValues<std::int64_t>(decoded, key, null_offset, size);
+      case velox::TypeKind::REAL:
+        return packValues<float>(decoded, key, null_offset, size);
+      case velox::TypeKind::DOUBLE:
+        return packValues<double>(decoded, key, null_offset, size);
+      case velox::TypeKind::HUGEINT:
+        return packValues<velox::int128_t>(decoded, key, null_offset, size);
+      case velox::TypeKind::TIMESTAMP:
+        return packValues<velox::Timestamp>(decoded, key, null_offset, size);
+      default:
+        return;
+    }
+  }
+
+  static void hashStrings(const velox::BaseVector& vector,
+                          std::vector<std::uint64_t>& hashes) {
+    // Out-of-line strings are fetched this many rows ahead of hashing.
+    constexpr std::size_t kPrefetchDistance = 8;
+    const velox::DecodedVector decoded(vector);
+    const auto size = hashes.size();
+    if (decoded.isIdentityMapping() && !decoded.mayHaveNulls()) {
+      const auto* values = decoded.data<velox::StringView>();
+      for (std::size_t row = 0; row < size; ++row) {
+        if (row + kPrefetchDistance < size &&
+            !values[row + kPrefetchDistance].isInline()) {
+          __builtin_prefetch(values[row + kPrefetchDistance].data());
+        }
+        hashes[row] = XXH3_64bits_withSeed(values[row].data(),
+                                           values[row].size(), hashes[row]);
+      }
+      return;
+    }
+    for (std::size_t row = 0; row < size; ++row) {
+      const auto r = static_cast<velox::vector_size_t>(row);
+      if (decoded.isNullAt(r)) {
+        hashes[row] = hashNull(hashes[row]);
+        continue;
+      }
+      const auto value = decoded.valueAt<velox::StringView>(r);
+      hashes[row] =
+          XXH3_64bits_withSeed(value.data(), value.size(), hashes[row]);
+    }
+  }
+
+  std::vector<FixedKey> fixed_;
+  std::vector<velox::column_index_t> strings_;
+  std::vector<velox::column_index_t> others_;
+  std::size_t value_bytes_ = 0;
+  std::size_t row_bytes_ = 0;
+  // Packed fixed-width keys of the batch being hashed, row after row.
+  std::vector<char> packed_;
+};
+
+}  // namespace halo::exec::hash
@@ -0,0 +1,2 @@
+export module halo.exec.hash;
+export import :KeyHasher;
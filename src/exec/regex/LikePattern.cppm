@@ -0,0 +1,59 @@
+module;
+#include <re2/re2.h>
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+export module halo.exec.regex:LikePattern;
+import halo.common;
+
+namespace halo::exec::regex {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+// The RE2 pattern matching exactly the strings `LIKE pattern' does: `%'
+// stands for any run of characters, newlines included, `_' for any one
+// character, and `escape' makes the `%', `_' or escape after it literal.
+// The result is anchored at both ends, so it can join unanchored
+// `regexp_like' patterns in a PatternSet.
+export StatusOr<std::string> likeToRegex(
+    std::string_view pattern, std::optional<char> escape = std::nullopt) {
+  std::string regex = "(?s:^";
+  std::string literal;
+  const auto flush = [&] {
+    regex += RE2::QuoteMeta(literal);
+    literal.clear();
+  };
+  for (std::size_t i = 0; i < pattern.size(); ++i) {
+    const char c = pattern[i];
+    if (escape.has_value() && c == *escape) {
+      if (i + 1 == pattern.size()) {
+        return Status::Invalid("LIKE pattern `" + std::string(pattern) +
+                               "' ends with the escape character");
+      }
+      const char next = pattern[++i];
+      if (next != '%' && next != '_' && next != *escape) {
+        return Status::Invalid("escape character in LIKE pattern `" +
+                               std::string(pattern) +
+                               "' must be followed by `%', `_' or itself");
+      }
+      literal.push_back(next);
+    } else if (c == '%') {
+      flush();
+      regex += ".*";
+    } else if (c == '_') {
+      flush();
+      regex += '.';
+    } else {
+      literal.push_back(c);
+    }
+  }
+  flush();
+  regex += "$)";
+  return regex;
+}
+
+}  // namespace halo::exec::regex
@@ -0,0 +1,212 @@
+module;
+#include <velox/core/Expressions.h>
+#include <velox/core/ITypedExpr.h>
+#include <velox/type/Type.h>
+#include <velox/type/Variant.h>
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+export module halo.exec.regex:OrChainRewrite;
+import halo.common;
+import :LikePattern;
+import :RegexCache;
+
+namespace halo::exec::regex {
+
+namespace velox = facebook::velox;
+
+export struct OrChainRewriteOptions {
+  // Chains with fewer patterns over one column are left as they are.
+  std::size_t min_patterns = 2;
+  std::string or_name = "or";
+  std::string regexp_like_name = "regexp_like";
+  std::string like_name = "like";
+  // The function the patterns of a chain are folded into, as registered
+  // by registerRegexFunctions.
+  std::string any_name = "regexp_like_any";
+};
+
+// A disjunct `regexp_like(subject, 'regex')' or `like(subject, 'pattern'
+// [, 'escape'])' with its pattern as a regex.
+struct PatternDisjunct {
+  velox::core::TypedExprPtr subject;
+  std::string regex;
+};
+
+std::optional<std::string> constantString(
+    const velox::core::TypedExprPtr& expression) {
+  const auto constant =
+      std::dynamic_pointer_cast<const velox::core::ConstantTypedExpr>(
+          expression);
+  if (constant == nullptr || constant->hasValueVector() ||
+      constant->type()->kind() != velox::TypeKind::VARCHAR ||
+      constant->value().isNull()) {
+    return std::nullopt;
+  }
+  return constant->value().value<std::string>();
+}
+
+std::optional<PatternDisjunct> patternDisjunct(
+    const velox::core::TypedExprPtr& expression,
+    const OrChainRewriteOptions& options) {
+  const auto call =
+      std::dynamic_pointer_cast<const velox::core::CallTypedExpr>(expression);
+  if (call == nullptr) {
+    return std::nullopt;
+  }
+  const auto& inputs = call->inputs();
+  if (call->name() == options.regexp_like_name && inputs.size() == 2) {
+    auto regex = constantString(inputs[1]);
+    if (!regex.has_value()) {
+      return std::nullopt;
+    }
+    return PatternDisjunct{inputs[0], std::move(*regex)};
+  }
+  if (call->name() == options.like_name &&
+      (inputs.size() == 2 || inputs.size() == 3)) {
+    const auto pattern = constantString(inputs[1]);
+    std::optional<char> escape;
+    if (inputs.size() == 3) {
+      const auto text = constantString(inputs[2]);
+      if (!text.has_value() || text->size() != 1) {
+        return std::nullopt;
+      }
+      escape = text->front();
+    }
+    if (!pattern.has_value()) {
+      return std::nullopt;
+    }
+    // A malformed pattern stays with `like', which reports it.
+    auto regex = likeToRegex(*pattern, escape);
+    if (!regex.ok()) {
+      return std::nullopt;
+    }
+    return PatternDisjunct{inputs[0], std::move(regex).value()};
+  }
+  return std::nullopt;
+}
+
+// Appends the disjuncts of `expression' to `disjuncts', looking through
+// nested ORs.
+void flattenOr(const velox::core::TypedExprPtr& expression,
+               const OrChainRewriteOptions& options,
+               std::vector<velox::core::TypedExprPtr>& disjuncts) {
+  const auto call =
+      std::dynamic_pointer_cast<const velox::core::CallTypedExpr>(expression);
+  if (call != nullptr && call->name() == options.or_name) {
+    for (const auto& input : call->inputs()) {
+      flattenOr(input, options, disjuncts);
+    }
+    return;
+  }
+  disjuncts.push_back(expression);
+}
+
+// Rewrites every OR chain in `expression' so that its `regexp_like' and
+// `like' disjuncts over the same subject become a single
+// `regexp_like_any(subject, 'regex', ...)', which matches them all in one
+// RE2::Set pass over each string instead of one pass per pattern. The
+// other disjuncts, chains with fewer than `min_patterns' patterns over any
+// one subject and patterns that don't compile into a set are kept as they
+// are. Looks into the arguments of calls only, which is where filters put
+// their ORs.
+export velox::core::TypedExprPtr rewriteOrChains(
+    const velox::core::TypedExprPtr& expression,
+    const OrChainRewriteOptions& options = {}) {
+  const auto call =
+      std::dynamic_pointer_cast<const velox::core::CallTypedExpr>(expression);
+  if (call == nullptr) {
+    return expression;
+  }
+  if (call->name() != options.or_name) {
+    std::vector<velox::core::TypedExprPtr> inputs;
+    bool changed = false;
+    for (const auto& input : call->inputs()) {
+      inputs.push_back(rewriteOrChains(input, options));
+      changed |= inputs.back() != input;
+    }
+    if (!changed) {
+      return expression;
+    }
+    return std::make_shared<velox::core::CallTypedExpr>(
+        call->type(), std::move(inputs), call->name());
+  }
+
+  std::vector<velox::core::TypedExprPtr> disjuncts;
+  flattenOr(expression, options, disjuncts);
+
+  // Patterns by subject. `group' is the index into `groups' of each
+  // disjunct that is a pattern.
+  struct Group {
+    std::string key;
+    velox::core::TypedExprPtr subject;
+    std::vector<std::string> regexes;
+    bool foldable = false;
+    bool emitted = false;
+  };
+  std::vector<Group> groups;
+  std::vector<std::optional<std::size_t>> group(disjuncts.size());
+  for (std::size_t i = 0; i < disjuncts.size(); ++i) {
+    auto pattern = patternDisjunct(disjuncts[i], options);
+    if (!pattern.has_value()) {
+      continue;
+    }
+    auto key = pattern->subject->toString();
+    std::size_t g = 0;
+    while (g < groups.size() && groups[g].key != key) {
+      ++g;
+    }
+    if (g == groups.size()) {
+      groups.push_back(Group{std::move(key), pattern->subject, {}});
+    }
+    groups[g].regexes.push_back(std::move(pattern->regex));
+    group[i] = g;
+  }
+  // A set RE2 cannot compile, such as one beyond its memory limit, would
+  // fail the query; its chain stays as it is. The sets that compile are in
+  // the cache `any_name' reads them from.
+  for (auto& candidate : groups) {
+    candidate.foldable =
+        candidate.regexes.size() >= options.min_patterns &&
+        RegexCache::global().getSet(candidate.regexes).ok();
+  }
+
+  // Each folded group takes the place of its first disjunct.
+  std::vector<velox::core::TypedExprPtr> rewritten;
+  bool changed = false;
+  for (std::size_t i = 0; i < disjuncts.size(); ++i) {
+    if (!group[i].has_value() || !groups[*group[i]].foldable) {
+      rewritten.push_back(rewriteOrChains(disjuncts[i], options));
+      changed |= rewritten.back() != disjuncts[i];
+      continue;
+    }
+    auto& folded = groups[*group[i]];
+    if (folded.emitted) {
+      continue;
+    }
+    folded.emitted = true;
+    changed = true;
+    std::vector<velox::core::TypedExprPtr> inputs{folded.subject};
+    for (auto& regex : folded.regexes) {
+      inputs.push_back(std::make_shared<velox::core::ConstantTypedExpr>(
+          velox::VARCHAR(), velox::variant(std::move(regex))));
+    }
+    rewritten.push_back(std::make_shared<velox::core::CallTypedExpr>(
+        velox::BOOLEAN(), std::move(inputs), options.any_name));
+  }
+  if (!changed) {
+    return expression;
+  }
+  if (rewritten.size() == 1) {
+    return rewritten.front();
+  }
+  return std::make_shared<velox::core::CallTypedExpr>(
+      call->type(), std::move(rewritten), options.or_name);
+}
+
+}  // namespace halo::exec::regex
@@ -0,0 +1,126 @@
+module;
+#include <re2/re2.h>
+#include <re2/set.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+export module halo.exec.regex:PatternSet;
+import halo.common;
+import :RegexOptions;
+
+namespace halo::exec::regex {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+// Many patterns matched against a string in one pass. RE2::Set compiles
+// them into a single automaton, so a string is scanned once whatever the
+// number of patterns, where matching them one by one scans it once per
+// pattern. Patterns match anywhere in the string, as `regexp_like' does;
+// anchor them with `^' and `$' to match whole strings.
+//
+// Immutable once created and safe to share between threads.
+export class PatternSet final {
+ public:
+  static StatusOr<std::shared_ptr<const PatternSet>> create(
+      std::vector<std::string> patterns, const RegexOptions& options = {}) {
+    if (patterns.empty()) {
+      return Status::Invalid("pattern set needs at least one pattern");
+    }
+    auto set = std::make_unique<RE2::Set>(toRe2Options(options),
+                                          RE2::UNANCHORED);
+    for (std::size_t i = 0; i < patterns.size(); ++i) {
+      std::string error;
+      if (set->Add(patterns[i], &error) < 0) {
+        return Status::Invalid("pattern " + std::to_string(i) + " `" +
+                               patterns[i] + "': " + error);
+      }
+    }
+    if (!set->Compile()) {
+      return Status::Invalid("cannot compile a set of " +
+                             std::to_string(patterns.size()) +
+                             " patterns within " +
+                             std::to_string(options.max_mem) + " bytes");
+    }
+    return std::shared_ptr<const PatternSet>(
+        new PatternSet(std::move(patterns), options, std::move(set)));
+  }
+
+  PatternSet(const PatternSet&) = delete;
+  PatternSet& operator=(const PatternSet&) = delete;
+
+  [[nodiscard]] std::size_t size() const { return patterns_.size(); }
+
+  [[nodiscard]] const std::vector<std::string>& patterns() const {
+    return patterns_;
+  }
+
+  // Whether any pattern matches in `text'. Stops at the first match.
+  [[nodiscard]] bool matchesAny(std::string_view text) const {
+    RE2::Set::ErrorInfo error;
+    if (set_->Match(text, nullptr, &error)) {
+      return true;
+    }
+    if (error.kind == RE2::Set::kNoError) {
+      return false;
+    }
+    const auto& regexes = fallback();
+    return std::any_of(regexes.begin(), regexes.end(), [&](const auto& re) {
+      return RE2::PartialMatch(text, *re);
+    });
+  }
+
+  // Replaces `matched' with the indexes of the patterns matching in
+  // `text', ascending.
+  void match(std::string_view text, std::vector<int>& matched) const {
+    matched.clear();
+    RE2::Set::ErrorInfo error;
+    if (set_->Match(text, &matched, &error)) {
+      std::sort(matched.begin(), matched.end());
+      return;
+    }
+    if (error.kind == RE2::Set::kNoError) {
+      return;
+    }
+    const auto& regexes = fallback();
+    for (std::size_t i = 0; i < regexes.size(); ++i) {
+      if (RE2::PartialMatch(text, *regexes[i])) {
+        matched.push_back(static_cast<int>(i));
+      }
+    }
+  }
+
+ private:
+  PatternSet(std::vector<std::string> patterns, const RegexOptions& options,
+             std::unique_ptr<RE2::Set> set)
+      : patterns_(std::move(patterns)),
+        options_(options),
+        set_(std::move(set)) {}
+
+  // The patterns compiled one by one, for texts on which the set's DFA
+  // runs out of memory. Compiled on the first such text.
+  const std::vector<std::unique_ptr<RE2>>& fallback() const {
+    std::call_once(fallback_once_, [this] {
+      const auto options = toRe2Options(options_);
+      for (const auto& pattern : patterns_) {
+        fallback_.push_back(std::make_unique<RE2>(pattern, options));
+      }
+    });
+    return fallback_;
+  }
+
+  const std::vector<std::string> patterns_;
+  const RegexOptions options_;
+  const std::unique_ptr<RE2::Set> set_;
+  mutable std::once_flag fallback_once_;
+  mutable std::vector<std::unique_ptr<RE2>> fallback_;
+};
+
+}  // namespace halo::exec::regex
@@ -0,0 +1,187 @@
+module;
+#include <re2/re2.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+export module halo.exec.regex:RegexCache;
+import halo.common;
+import :PatternSet;
+import :RegexOptions;
+
+namespace halo::exec::regex {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+export struct RegexCacheStats {
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
+  std::uint64_t evictions = 0;
+  // Programs and pattern sets currently cached.
+  std::uint64_t regexes = 0;
+  std::uint64_t sets = 0;
+};
+
+// Compiled values by key, evicting the least recently used past capacity.
+// Not synchronized.
+template <typename T>
+class LruMap {
+ public:
+  explicit LruMap(std::size_t capacity) : capacity_(capacity) {}
+
+  std::shared_ptr<const T> find(const std::string& key) {
+    const auto it = entries_.find(key);
+    if (it == entries_.end()) {
+      return nullptr;
+    }
+    order_.splice(order_.begin(), order_, it->second.position);
+    return it->second.value;
+  }
+
+  // Inserts `value' unless `key' is already there, and returns the value
+  // kept. Adds the entries evicted for room to `evictions'.
+  std::shared_ptr<const T> insert(const std::string& key,
+                                  std::shared_ptr<const T> value,
+                                  std::uint64_t& evictions) {
+    if (auto existing = find(key)) {
+      return existing;
+    }
+    while (!entries_.empty() && entries_.size() >= capacity_) {
+      entries_.erase(order_.back());
+      order_.pop_back();
+      ++evictions;
+    }
+    order_.push_front(key);
+    entries_.emplace(key, Entry{value, order_.begin()});
+    return value;
+  }
+
+  [[nodiscard]] std::size_t size() const { return entries_.size(); }
+
+  void clear() {
+    entries_.clear();
+    order_.clear();
+  }
+
+ private:
+  using Order = std::list<std::string>;
+
+  struct Entry {
+    std::shared_ptr<const T> value;
+    Order::iterator position;
+  };
+
+  const std::size_t capacity_;
+  // Most recently used first.
+  Order order_;
+  std::unordered_map<std::string, Entry> entries_;
+};
+
+// Compiled RE2 programs and pattern sets keyed by their patterns and
+// options, so that a pattern is compiled once per process rather than once
+// per task or per batch. Both kinds are capped in count and evicted least
+// recently used first; a value evicted while in use lives on until its
+// last user drops it. Patterns are compiled outside the lock, so a slow
+// compile doesn't hold up lookups of other patterns.
+export class RegexCache final {
+ public:
+  static constexpr std::size_t kDefaultRegexes = 4096;
+  static constexpr std::size_t kDefaultSets = 256;
+
+  static std::unique_ptr<RegexCache> create(
+      std::size_t regexes = kDefaultRegexes, std::size_t sets = kDefaultSets) {
+    return std::unique_ptr<RegexCache>(new RegexCache(regexes, sets));
+  }
+
+  // The cache string predicates share within the process.
+  static RegexCache& global() {
+    static const std::unique_ptr<RegexCache> cache = create();
+    return *cache;
+  }
+
+  RegexCache(const RegexCache&) = delete;
+  RegexCache& operator=(const RegexCache&) = delete;
+
+  // `pattern' compiled with `options'. Invalid patterns are not cached.
+  StatusOr<std::shared_ptr<const RE2>> get(std::string_view pattern,
+                                           const RegexOptions& options = {}) {
+    auto key = keyOf(options);
+    key.append(pattern);
+    {
+      const std::scoped_lock lock(mutex_);
+      if (auto regex = regexes_.find(key)) {
+        ++stats_.hits;
+        return regex;
+      }
+      ++stats_.misses;
+    }
+    auto regex = std::make_shared<const RE2>(pattern, toRe2Options(options));
+    if (!regex->ok()) {
+      return Status::Invalid("invalid pattern `" + std::string(pattern) +
+                             "': " + regex->error());
+    }
+    const std::scoped_lock lock(mutex_);
+    return regexes_.insert(key, std::move(regex), stats_.evictions);
+  }
+
+  // A set of `patterns' compiled with `options', for which the order of
+  // the patterns is part of the key.
+  StatusOr<std::shared_ptr<const PatternSet>> getSet(
+      const std::vector<std::string>& patterns,
+      const RegexOptions& options = {}) {
+    auto key = keyOf(options);
+    for (const auto& pattern : patterns) {
+      key += std::to_string(pattern.size());
+      key += ':';
+      key += pattern;
+    }
+    {
+      const std::scoped_lock lock(mutex_);
+      if (auto set = sets_.find(key)) {
+        ++stats_.hits;
+        return set;
+      }
+      ++stats_.misses;
+    }
+    auto set = PatternSet::create(patterns, options);
+    if (!set.ok()) {
+      return set.status();
+    }
+    const std::scoped_lock lock(mutex_);
+    return sets_.insert(key, std::move(set).value(), stats_.evictions);
+  }
+
+  [[nodiscard]] RegexCacheStats stats() const {
+    const std::scoped_lock lock(mutex_);
+    auto stats = stats_;
+    stats.regexes = regexes_.size();
+    stats.sets = sets_.size();
+    return stats;
+  }
+
+  void clear() {
+    const std::scoped_lock lock(mutex_);
+    regexes_.clear();
+    sets_.clear();
+  }
+
+ private:
+  RegexCache(std::size_t regexes, std::size_t sets)
+      : regexes_(regexes), sets_(sets) {}
+
+  mutable std::mutex mutex_;
+  LruMap<RE2> regexes_;
+  LruMap<PatternSet> sets_;
+  RegexCacheStats stats_;
+};
+
+}  // namespace halo::exec::regex
@@ -0,0 +1,153 @@
+module;
+#include <velox/buffer/Buffer.h>
+#include <velox/common/base/BitUtil.h>
+#include <velox/expression/DecodedArgs.h>
+#include <velox/expression/EvalCtx.h>
+#include <velox/expression/FunctionSignature.h>
+#include <velox/expression/VectorFunction.h>
+#include <velox/type/StringView.h>
+#include <velox/type/Type.h>
+#include <velox/vector/BaseVector.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/ConstantVector.h>
+#include <velox/vector/FlatVector.h>
+#include <velox/vector/SelectivityVector.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+export module halo.exec.regex:RegexFunctions;
+import halo.common;
+import :PatternSet;
+import :RegexCache;
+
+namespace halo::exec::regex {
+
+namespace velox = facebook::velox;
+
+// The set of the constant pattern arguments after the subject, from the
+// process-wide cache, so each distinct list compiles once.
+std::shared_ptr<const PatternSet> constantPatterns(
+    const std::vector<velox::VectorPtr>& args, const std::string& name) {
+  std::vector<std::string> patterns;
+  for (std::size_t i = 1; i < args.size(); ++i) {
+    VELOX_USER_CHECK(args[i]->isConstantEncoding() && !args[i]->isNullAt(0),
+                     "{}() needs constant, non-null patterns", name);
+    const auto pattern =
+        args[i]->as<velox::ConstantVector<velox::StringView>>()->valueAt(0);
+    patterns.emplace_back(pattern.data(), pattern.size());
+  }
+  auto set = RegexCache::global().getSet(patterns);
+  VELOX_USER_CHECK(set.ok(), set.status().toString());
+  return std::move(set).value();
+}
+
+// regexp_like_any(varchar, constant varchar...) -> boolean: whether any of
+// the patterns matches part of the string, as an OR of `regexp_like' calls
+// would say, but in a single pass over the string.
+class RegexpLikeAnyFunction final : public velox::exec::VectorFunction {
+ public:
+  void apply(const velox::SelectivityVector& rows,
+             std::vector<velox::VectorPtr>& args,
+             const velox::TypePtr& /*outputType*/,
+             velox::exec::EvalCtx& context,
+             velox::VectorPtr& result) const override {
+    const auto set = constantPatterns(args, "regexp_like_any");
+    velox::exec::DecodedArgs decoded_args(rows, args, context);
+    const auto* text = decoded_args.at(0);
+    context.ensureWritable(rows, velox::BOOLEAN(), result);
+    auto* matches = result->asUnchecked<velox::FlatVector<bool>>();
+    rows.applyToSelected([&](velox::vector_size_t row) {
+      if (text->isNullAt(row)) {
+        matches->setNull(row, true);
+        return;
+      }
+      const auto value = text->valueAt<velox::StringView>(row);
+      matches->set(row, set->matchesAny(
+                            std::string_view(value.data(), value.size())));
+    });
+  }
+};
+
+// regexp_matching_patterns(varchar, constant varchar...) -> array(integer):
+// the 1-based positions of the patterns that match part of the string, in
+// ascending order. Tells which of many rules fired from one pass.
+class RegexpMatchingPatternsFunction final
+    : public velox::exec::VectorFunction {
+ public:
+  void apply(const velox::SelectivityVector& rows,
+             std::vector<velox::VectorPtr>& args,
+             const velox::TypePtr& outputType,
+             velox::exec::EvalCtx& context,
+             velox::VectorPtr& result) const override {
+    const auto set = constantPatterns(args, "regexp_matching_patterns");
+    velox::exec::DecodedArgs decoded_args(rows, args, context);
+    const auto* text = decoded_args.at(0);
+
+    auto* pool = context.pool();
+    const auto size = rows.end();
+    auto offsets = velox::allocateOffsets(size, pool);
+    auto sizes = velox::allocateSizes(size, pool);
+    auto* raw_offsets = offsets->asMutable<velox::vector_size_t>();
+    auto* raw_sizes = sizes->asMutable<velox::vector_size_t>();
+    velox::BufferPtr nulls;
+    std::vector<std::int32_t> positions;
+    std::vector<int> matched;
+    rows.applyToSelected([&](velox::vector_size_t row) {
+      raw_offsets[row] = static_cast<velox::vector_size_t>(positions.size());
+      if (text->isNullAt(row)) {
+        if (nulls == nullptr) {
+          nulls = velox::allocateNulls(size, pool);
+        }
+        velox::bits::setNull(nulls->asMutable<std::uint64_t>(), row);
+        return;
+      }
+      const auto value = text->valueAt<velox::StringView>(row);
+      set->match(std::string_view(value.data(), value.size()), matched);
+      for (const auto index : matched) {
+        positions.push_back(index + 1);
+      }
+      raw_sizes[row] = static_cast<velox::vector_size_t>(matched.size());
+    });
+
+    auto elements = velox::BaseVector::create<velox::FlatVector<std::int32_t>>(
+        velox::INTEGER(), static_cast<velox::vector_size_t>(positions.size()),
+        pool);
+    std::copy(positions.begin(), positions.end(),
+              elements->mutableRawValues());
+    auto arrays = std::make_shared<velox::ArrayVector>(
+        pool, outputType, std::move(nulls), size, std::move(offsets),
+        std::move(sizes), std::move(elements));
+    context.moveOrCopyResult(arrays, rows, result);
+  }
+};
+
+// Registers `regexp_like_any' and `regexp_matching_patterns', each taking
+// a subject and one or more constant patterns, under `prefix'.
+export void registerRegexFunctions(const std::string& prefix = "") {
+  velox::exec::registerVectorFunction(
+      prefix + "regexp_like_any",
+      {velox::exec::FunctionSignatureBuilder()
+           .returnType("boolean")
+           .argumentType("varchar")
+           .constantArgumentType("varchar")
+           .variableArity()
+           .build()},
+      std::make_unique<RegexpLikeAnyFunction>());
+  velox::exec::registerVectorFunction(
+      prefix + "regexp_matching_patterns",
+      {velox::exec::FunctionSignatureBuilder()
+           .returnType("array(integer)")
+           .argumentType("varchar")
+           .constantArgumentType("varchar")
+           .variableArity()
+           .build()},
+      std::make_unique<RegexpMatchingPatternsFunction>());
+}
+
+}  // namespace halo::exec::regex
@@ -0,0 +1,39 @@
+module;
+#include <re2/re2.h>
+
+#include <cstdint>
+#include <string>
+
+export module halo.exec.regex:RegexOptions;
+
+namespace halo::exec::regex {
+
+// The RE2 options string predicates compile their patterns with. Patterns
+// are UTF-8 and match with leftmost-first (Perl) semantics.
+export struct RegexOptions {
+  bool case_sensitive = true;
+  // `.' matches a newline too.
+  bool dot_nl = false;
+  // Memory a compiled program and its DFAs may use, RE2's default.
+  std::int64_t max_mem = 8 << 20;
+
+  bool operator==(const RegexOptions&) const = default;
+};
+
+RE2::Options toRe2Options(const RegexOptions& options) {
+  RE2::Options re2;
+  re2.set_case_sensitive(options.case_sensitive);
+  re2.set_dot_nl(options.dot_nl);
+  re2.set_max_mem(options.max_mem);
+  // Bad patterns come back as a Status; don't also log them.
+  re2.set_log_errors(false);
+  return re2;
+}
+
+// Prefix of the cache keys of patterns compiled with `options'.
+std::string keyOf(const RegexOptions& options) {
+  return std::string(options.case_sensitive ? "c" : "i") +
+         (options.dot_nl ? "s" : "-") + std::to_string(options.max_mem) + '|';
+}
+
+}  // namespace halo::exec::regex
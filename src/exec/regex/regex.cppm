@@ -0,0 +1,7 @@
+export module halo.exec.regex;
+export import :LikePattern;
+export import :OrChainRewrite;
+export import :PatternSet;
+export import :RegexCache;
+export import :RegexFunctions;
+export import :RegexOptions;
@@ -0,0 +1,98 @@
+module;
+#include <geos_c.h>
+#include <velox/type/StringView.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+export module halo.exec.spatial:GeosContext;
+import halo.common;
+
+namespace halo::exec::spatial {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+namespace velox = facebook::velox;
+
+// How a geometry column stores its values: WKB in VARBINARY columns, WKT
+// in VARCHAR ones.
+export enum class GeometryEncoding : std::uint8_t {
+  kWkb,
+  kWkt,
+};
+
+export struct GeometryDeleter {
+  GEOSContextHandle_t handle = nullptr;
+
+  void operator()(GEOSGeometry* geometry) const {
+    GEOSGeom_destroy_r(handle, geometry);
+  }
+};
+
+export using GeometryPtr = std::unique_ptr<GEOSGeometry, GeometryDeleter>;
+
+// A reentrant GEOS context with its WKB and WKT readers, whose errors are
+// kept for the Status of the failing call instead of going to stderr.
+// Contexts are not thread-safe; each thread uses its own. Geometries may be
+// shared between contexts as long as nothing modifies them.
+export class GeosContext final {
+ public:
+  static std::unique_ptr<GeosContext> create() {
+    return std::unique_ptr<GeosContext>(new GeosContext());
+  }
+
+  GeosContext(const GeosContext&) = delete;
+  GeosContext& operator=(const GeosContext&) = delete;
+
+  ~GeosContext() {
+    GEOSWKBReader_destroy_r(handle_, wkb_reader_);
+    GEOSWKTReader_destroy_r(handle_, wkt_reader_);
+    GEOS_finish_r(handle_);
+  }
+
+  [[nodiscard]] GEOSContextHandle_t handle() const { return handle_; }
+
+  StatusOr<GeometryPtr> read(velox::StringView value,
+                             GeometryEncoding encoding) {
+    error_.clear();
+    GEOSGeometry* geometry = nullptr;
+    if (encoding == GeometryEncoding::kWkb) {
+      geometry = GEOSWKBReader_read_r(
+          handle_, wkb_reader_,
+          reinterpret_cast<const unsigned char*>(value.data()), value.size());
+    } else {
+      // The WKT reader wants a terminated string.
+      const std::string text(value.data(), value.size());
+      geometry = GEOSWKTReader_read_r(handle_, wkt_reader_, text.c_str());
+    }
+    if (geometry == nullptr) {
+      return Status::Invalid("cannot read geometry: " + error_);
+    }
+    return GeometryPtr(geometry, GeometryDeleter{handle_});
+  }
+
+  // Message of the last error GEOS reported.
+  [[nodiscard]] const std::string& lastError() const { return error_; }
+
+ private:
+  GeosContext() : handle_(GEOS_init_r()) {
+    GEOSContext_setErrorMessageHandler_r(handle_, &GeosContext::onError,
+                                         this);
+    wkb_reader_ = GEOSWKBReader_create_r(handle_);
+    wkt_reader_ = GEOSWKTReader_create_r(handle_);
+  }
+
+  static void onError(const char* message, void* context) {
+    static_cast<GeosContext*>(context)->error_ = message;
+  }
+
+  GEOSContextHandle_t handle_;
+  GEOSWKBReader* wkb_reader_ = nullptr;
+  GEOSWKTReader* wkt_reader_ = nullptr;
+  std::string error_;
+};
+
+}  // namespace halo::exec::spatial
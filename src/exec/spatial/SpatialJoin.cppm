@@ -0,0 +1,363 @@
+module;
+#include <geos_c.h>
+#include <velox/buffer/Buffer.h>
+#include <velox/common/memory/MemoryPool.h>
+#include <velox/type/StringView.h>
+#include <velox/type/Type.h>
+#include <velox/vector/BaseVector.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/DecodedVector.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+export module halo.exec.spatial:SpatialJoin;
+import halo.common;
+import :GeosContext;
+
+namespace halo::exec::spatial {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+namespace velox = facebook::velox;
+
+// Join condition between a build row's geometry and a probe row's.
+export enum class SpatialPredicate : std::uint8_t {
+  // ST_Contains(build, probe), e.g. polygons containing points.
+  kContains,
+  // ST_Intersects(build, probe).
+  kIntersects,
+};
+
+export struct SpatialJoinStats {
+  std::uint64_t probe_rows = 0;
+  // Build rows whose envelope overlaps a probe's, i.e. exact predicate
+  // evaluations.
+  std::uint64_t candidates = 0;
+  std::uint64_t matches = 0;
+  std::uint64_t prepared = 0;
+};
+
+// The encoding a geometry column of `type' is read with.
+StatusOr<GeometryEncoding> encodingOf(const velox::TypePtr& type) {
+  if (type->kind() == velox::TypeKind::VARBINARY) {
+    return GeometryEncoding::kWkb;
+  }
+  if (type->kind() == velox::TypeKind::VARCHAR) {
+    return GeometryEncoding::kWkt;
+  }
+  return Status::Invalid("geometry column must be VARBINARY (WKB) or "
+                         "VARCHAR (WKT), got " +
+                         type->toString());
+}
+
+export class SpatialJoinBuilder;
+export class SpatialJoinProbe;
+
+// Build side of a spatial join: all build rows, their geometries and a
+// STRtree over the geometries' envelopes. Immutable once built and shared
+// by the probes of every thread.
+export class SpatialJoinBuild final {
+ public:
+  SpatialJoinBuild(const SpatialJoinBuild&) = delete;
+  SpatialJoinBuild& operator=(const SpatialJoinBuild&) = delete;
+
+  ~SpatialJoinBuild() {
+    GEOSSTRtree_destroy_r(context_->handle(), tree_);
+  }
+
+  [[nodiscard]] const velox::RowVectorPtr& rows() const { return rows_; }
+
+  [[nodiscard]] SpatialPredicate predicate() const { return predicate_; }
+
+ private:
+  friend class SpatialJoinBuilder;
+  friend class SpatialJoinProbe;
+
+  static constexpr std::size_t kNodeCapacity = 10;
+
+  SpatialJoinBuild(std::unique_ptr<GeosContext> context,
+                   velox::RowVectorPtr rows,
+                   std::vector<GeometryPtr> geometries,
+                   SpatialPredicate predicate)
+      : context_(std::move(context)),
+        rows_(std::move(rows)),
+        geometries_(std::move(geometries)),
+        predicate_(predicate),
+        tree_(GEOSSTRtree_create_r(context_->handle(), kNodeCapacity)) {
+    for (std::size_t row = 0; row < geometries_.size(); ++row) {
+      if (geometries_[row] != nullptr &&
+          GEOSisEmpty_r(context_->handle(), geometries_[row].get()) == 0) {
+        GEOSSTRtree_insert_r(context_->handle(), tree_, geometries_[row].get(),
+                             reinterpret_cast<void*>(row));
+      }
+    }
+    // The tree is packed on its first query. Query once here so that the
+    // probes only ever read it.
+    GeometryPtr origin(GEOSGeom_createPointFromXY_r(context_->handle(), 0, 0),
+                       GeometryDeleter{context_->handle()});
+    GEOSSTRtree_query_r(
+        context_->handle(), tree_, origin.get(), [](void*, void*) {}, nullptr);
+  }
+
+  // Declared first so that the geometries read with it go before it.
+  std::unique_ptr<GeosContext> context_;
+  velox::RowVectorPtr rows_;
+  // Null for NULL build rows.
+  std::vector<GeometryPtr> geometries_;
+  SpatialPredicate predicate_;
+  GEOSSTRtree* tree_;
+};
+
+// Collects build batches and parses their geometries. The geometry column
+// is WKB (VARBINARY) or WKT (VARCHAR); NULL geometries never match.
+export class SpatialJoinBuilder final {
+ public:
+  static StatusOr<SpatialJoinBuilder> create(velox::RowTypePtr type,
+                                             velox::column_index_t column,
+                                             SpatialPredicate predicate,
+                                             velox::memory::MemoryPool* pool) {
+    if (column >= type->size()) {
+      return Status::Invalid("no geometry column " + std::to_string(column) +
+                             " in " + type->toString());
+    }
+    auto encoding = encodingOf(type->childAt(column));
+    if (!encoding.ok()) {
+      return encoding.status();
+    }
+    return SpatialJoinBuilder(std::move(type), column, *encoding, predicate,
+                              pool);
+  }
+
+  Status append(const velox::RowVectorPtr& batch) {
+    if (!batch->type()->equivalent(*type_)) {
+      return Status::Invalid("build batch of type " +
+                             batch->type()->toString() + ", expected " +
+                             type_->toString());
+    }
+    const velox::DecodedVector decoded(*batch->childAt(column_));
+    std::vector<GeometryPtr> geometries(
+        static_cast<std::size_t>(batch->size()));
+    for (velox::vector_size_t row = 0; row < batch->size(); ++row) {
+      if (decoded.isNullAt(row)) {
+        continue;
+      }
+      auto geometry = context_->read(
+          decoded.valueAt<velox::StringView>(row), encoding_);
+      if (!geometry.ok()) {
+        const auto build_row =
+            geometries_.size() + static_cast<std::size_t>(row);
+        return Status::Invalid("build row " + std::to_string(build_row) +
+                               ": " + geometry.status().message());
+      }
+      geometries[static_cast<std::size_t>(row)] = std::move(geometry).value();
+    }
+    std::move(geometries.begin(), geometries.end(),
+              std::back_inserter(geometries_));
+    batches_.push_back(batch);
+    return Status::OK();
+  }
+
+  std::shared_ptr<const SpatialJoinBuild> build() {
+    auto rows = velox::BaseVector::create<velox::RowVector>(
+        type_, static_cast<velox::vector_size_t>(geometries_.size()), pool_);
+    velox::vector_size_t offset = 0;
+    for (const auto& batch : batches_) {
+      rows->copy(batch.get(), offset, 0, batch->size());
+      offset += batch->size();
+    }
+    batches_.clear();
+    return std::shared_ptr<const SpatialJoinBuild>(
+        new SpatialJoinBuild(std::move(context_), std::move(rows),
+                             std::move(geometries_), predicate_));
+  }
+
+ private:
+  SpatialJoinBuilder(velox::RowTypePtr type, velox::column_index_t column,
+                     GeometryEncoding encoding, SpatialPredicate predicate,
+                     velox::memory::MemoryPool* pool)
+      : type_(std::move(type)),
+        column_(column),
+        encoding_(encoding),
+        predicate_(predicate),
+        pool_(pool),
+        context_(GeosContext::create()) {}
+
+  velox::RowTypePtr type_;
+  velox::column_index_t column_;
+  GeometryEncoding encoding_;
+  SpatialPredicate predicate_;
+  velox::memory::MemoryPool* pool_;
+  std::unique_ptr<GeosContext> context_;
+  std::vector<velox::RowVectorPtr> batches_;
+  std::vector<GeometryPtr> geometries_;
+};
+
+// Probe side of a spatial join, one per thread. Each probe geometry is
+// looked up in the build side's STRtree, which leaves only the build rows
+// whose envelopes overlap it; the exact predicate runs on those alone. A
+// build geometry that turns up as a candidate more than once is prepared
+// (its edges indexed for point-in-polygon and intersection tests), which
+// is what makes repeated probes against large polygons cheap.
+export class SpatialJoinProbe final {
+ public:
+  // Build geometries are prepared from their second candidate pair on.
+  static constexpr std::uint32_t kPrepareAfter = 2;
+
+  explicit SpatialJoinProbe(std::shared_ptr<const SpatialJoinBuild> build)
+      : build_(std::move(build)),
+        context_(GeosContext::create()),
+        prepared_(build_->geometries_.size()),
+        hits_(build_->geometries_.size(), 0) {}
+
+  SpatialJoinProbe(const SpatialJoinProbe&) = delete;
+  SpatialJoinProbe& operator=(const SpatialJoinProbe&) = delete;
+
+  ~SpatialJoinProbe() {
+    for (const auto* prepared : prepared_) {
+      if (prepared != nullptr) {
+        GEOSPreparedGeom_destroy_r(context_->handle(), prepared);
+      }
+    }
+  }
+
+  // Inner join of `probe' with the build rows: every pair whose geometries
+  // satisfy the predicate, as the probe columns followed by the build
+  // columns. Pairs are ordered by probe row, then build row.
+  StatusOr<velox::RowVectorPtr> join(const velox::RowVectorPtr& probe,
+                                     velox::column_index_t column) {
+    if (column >= probe->childrenSize()) {
+      return Status::Invalid("no geometry column " + std::to_string(column) +
+                             " in the probe batch");
+    }
+    auto encoding = encodingOf(probe->type()->childAt(column));
+    if (!encoding.ok()) {
+      return encoding.status();
+    }
+    probe_rows_.clear();
+    build_rows_.clear();
+    const velox::DecodedVector decoded(*probe->childAt(column));
+    for (velox::vector_size_t row = 0; row < probe->size(); ++row) {
+      ++stats_.probe_rows;
+      if (decoded.isNullAt(row)) {
+        continue;
+      }
+      auto geometry =
+          context_->read(decoded.valueAt<velox::StringView>(row), *encoding);
+      if (!geometry.ok()) {
+        return Status::Invalid("probe row " + std::to_string(row) + ": " +
+                               geometry.status().message());
+      }
+      if (auto status = match(row, **geometry); !status.ok()) {
+        return status;
+      }
+    }
+    return output(probe);
+  }
+
+  [[nodiscard]] const SpatialJoinStats& stats() const { return stats_; }
+
+ private:
+  // Appends the build rows `geometry' of probe row `row' joins with.
+  Status match(velox::vector_size_t row, const GEOSGeometry& geometry) {
+    const auto handle = context_->handle();
+    candidates_.clear();
+    GEOSSTRtree_query_r(
+        handle, build_->tree_, &geometry,
+        [](void* item, void* candidates) {
+          static_cast<std::vector<std::size_t>*>(candidates)->push_back(
+              reinterpret_cast<std::size_t>(item));
+        },
+        &candidates_);
+    std::sort(candidates_.begin(), candidates_.end());
+    stats_.candidates += candidates_.size();
+
+    const bool contains = build_->predicate_ == SpatialPredicate::kContains;
+    for (const auto candidate : candidates_) {
+      char result = 0;
+      if (++hits_[candidate] >= kPrepareAfter) {
+        auto*& prepared = prepared_[candidate];
+        if (prepared == nullptr) {
+          prepared = GEOSPrepare_r(handle,
+                                   build_->geometries_[candidate].get());
+          if (prepared == nullptr) {
+            return Status::QueryExecutorError("cannot prepare geometry: " +
+                                              context_->lastError());
+          }
+          ++stats_.prepared;
+        }
+        result = contains
+                     ? GEOSPreparedContains_r(handle, prepared, &geometry)
+                     : GEOSPreparedIntersects_r(handle, prepared, &geometry);
+      } else {
+        const auto* build = build_->geometries_[candidate].get();
+        result = contains ? GEOSContains_r(handle, build, &geometry)
+                          : GEOSIntersects_r(handle, build, &geometry);
+      }
+      if (result == 2) {
+        return Status::QueryExecutorError("spatial predicate failed: " +
+                                          context_->lastError());
+      }
+      if (result == 1) {
+        probe_rows_.push_back(row);
+        build_rows_.push_back(static_cast<velox::vector_size_t>(candidate));
+      }
+    }
+    return Status::OK();
+  }
+
+  // Wraps both sides' columns in dictionaries over the matched rows.
+  velox::RowVectorPtr output(const velox::RowVectorPtr& probe) {
+    stats_.matches += probe_rows_.size();
+    auto* pool = probe->pool();
+    const auto size = static_cast<velox::vector_size_t>(probe_rows_.size());
+    const auto indices = [&](const std::vector<velox::vector_size_t>& rows) {
+      auto buffer = velox::allocateIndices(size, pool);
+      std::copy(rows.begin(), rows.end(),
+                buffer->asMutable<velox::vector_size_t>());
+      return buffer;
+    };
+    const auto probe_indices = indices(probe_rows_);
+    const auto build_indices = indices(build_rows_);
+
+    const auto& build_rows = build_->rows();
+    const auto& probe_type = probe->type()->asRow();
+    const auto& build_type = build_rows->type()->asRow();
+    std::vector<std::string> names;
+    std::vector<velox::TypePtr> types;
+    std::vector<velox::VectorPtr> columns;
+    for (velox::column_index_t i = 0; i < probe_type.size(); ++i) {
+      names.push_back(probe_type.nameOf(i));
+      types.push_back(probe_type.childAt(i));
+      columns.push_back(velox::BaseVector::wrapInDictionary(
+          nullptr, probe_indices, size, probe->childAt(i)));
+    }
+    for (velox::column_index_t i = 0; i < build_type.size(); ++i) {
+      names.push_back(build_type.nameOf(i));
+      types.push_back(build_type.childAt(i));
+      columns.push_back(velox::BaseVector::wrapInDictionary(
+          nullptr, build_indices, size, build_rows->childAt(i)));
+    }
+    return std::make_shared<velox::RowVector>(
+        pool, velox::ROW(std::move(names), std::move(types)), nullptr, size,
+        std::move(columns));
+  }
+
+  const std::shared_ptr<const SpatialJoinBuild> build_;
+  const std::unique_ptr<GeosContext> context_;
+  std::vector<const GEOSPreparedGeometry*> prepared_;
+  std::vector<std::uint32_t> hits_;
+  std::vector<std::size_t> candidates_;
+  std::vector<velox::vector_size_t> probe_rows_;
+  std::vector<velox::vector_size_t> build_rows_;
+  SpatialJoinStats stats_;
+};
+
+}  // namespace halo::exec::spatial
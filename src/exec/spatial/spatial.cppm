@@ -0,0 +1,3 @@
+export module halo.exec.spatial;
+export import :GeosContext;
+export import :SpatialJoin;
@@ -0,0 +1,161 @@
+module;
+#include <velox/expression/DecodedArgs.h>
+#include <velox/expression/EvalCtx.h>
+#include <velox/expression/FunctionSignature.h>
+#include <velox/expression/VectorFunction.h>
+#include <velox/type/StringView.h>
+#include <velox/type/Type.h>
+#include <velox/vector/BaseVector.h>
+#include <velox/vector/FlatVector.h>
+#include <velox/vector/SelectivityVector.h>
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+export module halo.exec.utf8:StringFunctions;
+import :Utf8Kernels;
+
+namespace halo::exec::utf8 {
+
+namespace velox = facebook::velox;
+
+std::string_view viewOf(const velox::StringView& value) {
+  return {value.data(), value.size()};
+}
+
+// lower(varchar) and upper(varchar) -> varchar.
+template <bool kUpper>
+class CaseFunction final : public velox::exec::VectorFunction {
+ public:
+  void apply(const velox::SelectivityVector& rows,
+             std::vector<velox::VectorPtr>& args,
+             const velox::TypePtr& /*outputType*/,
+             velox::exec::EvalCtx& context,
+             velox::VectorPtr& result) const override {
+    velox::exec::DecodedArgs decoded_args(rows, args, context);
+    const auto* text = decoded_args.at(0);
+    context.ensureWritable(rows, velox::VARCHAR(), result);
+    auto* mapped = result->asUnchecked<velox::FlatVector<velox::StringView>>();
+    std::string scratch;
+    rows.applyToSelected([&](velox::vector_size_t row) {
+      const auto value = viewOf(text->valueAt<velox::StringView>(row));
+      scratch.resize(maxCaseMappedBytes(value.size()));
+      const auto size = kUpper ? toUpper(value, scratch.data())
+                               : toLower(value, scratch.data());
+      mapped->set(row, velox::StringView(scratch.data(),
+                                         static_cast<std::int32_t>(size)));
+    });
+  }
+};
+
+// length(varchar) -> bigint, in characters.
+class LengthFunction final : public velox::exec::VectorFunction {
+ public:
+  void apply(const velox::SelectivityVector& rows,
+             std::vector<velox::VectorPtr>& args,
+             const velox::TypePtr& /*outputType*/,
+             velox::exec::EvalCtx& context,
+             velox::VectorPtr& result) const override {
+    velox::exec::DecodedArgs decoded_args(rows, args, context);
+    const auto* text = decoded_args.at(0);
+    context.ensureWritable(rows, velox::BIGINT(), result);
+    auto* lengths = result->asUnchecked<velox::FlatVector<std::int64_t>>();
+    rows.applyToSelected([&](velox::vector_size_t row) {
+      lengths->set(row, static_cast<std::int64_t>(codepointCount(
+                            viewOf(text->valueAt<velox::StringView>(row)))));
+    });
+  }
+};
+
+// substr(varchar, bigint[, bigint]) -> varchar, by characters. The result
+// points into the input's strings rather than copying them.
+class SubstrFunction final : public velox::exec::VectorFunction {
+ public:
+  void apply(const velox::SelectivityVector& rows,
+             std::vector<velox::VectorPtr>& args,
+             const velox::TypePtr& /*outputType*/,
+             velox::exec::EvalCtx& context,
+             velox::VectorPtr& result) const override {
+    velox::exec::DecodedArgs decoded_args(rows, args, context);
+    const auto* text = decoded_args.at(0);
+    const auto* start = decoded_args.at(1);
+    const auto* length = args.size() > 2 ? decoded_args.at(2) : nullptr;
+    context.ensureWritable(rows, velox::VARCHAR(), result);
+    auto* substrings =
+        result->asUnchecked<velox::FlatVector<velox::StringView>>();
+    substrings->acquireSharedStringBuffers(args[0].get());
+    rows.applyToSelected([&](velox::vector_size_t row) {
+      const auto value = text->valueAt<velox::StringView>(row);
+      const auto substring = substringByCodepoint(
+          viewOf(value), start->valueAt<std::int64_t>(row),
+          length == nullptr ? std::numeric_limits<std::int64_t>::max()
+                            : length->valueAt<std::int64_t>(row));
+      // Inline strings live in the input's StringView itself; the new view
+      // copies those, and longer ones point into the buffers acquired.
+      substrings->setNoCopy(
+          row, velox::StringView(substring.data(),
+                                 static_cast<std::int32_t>(substring.size())));
+    });
+  }
+};
+
+// is_valid_utf8(varchar) -> boolean.
+class IsValidUtf8Function final : public velox::exec::VectorFunction {
+ public:
+  void apply(const velox::SelectivityVector& rows,
+             std::vector<velox::VectorPtr>& args,
+             const velox::TypePtr& /*outputType*/,
+             velox::exec::EvalCtx& context,
+             velox::VectorPtr& result) const override {
+    velox::exec::DecodedArgs decoded_args(rows, args, context);
+    const auto* text = decoded_args.at(0);
+    context.ensureWritable(rows, velox::BOOLEAN(), result);
+    auto* valid = result->asUnchecked<velox::FlatVector<bool>>();
+    rows.applyToSelected([&](velox::vector_size_t row) {
+      valid->set(row,
+                 isValidUtf8(viewOf(text->valueAt<velox::StringView>(row))));
+    });
+  }
+};
+
+// Registers `lower', `upper', `length', `substr' and `is_valid_utf8' over
+// VARCHAR under `prefix'. With no prefix they take the place of the Presto
+// functions of the same names.
+export void registerStringFunctions(const std::string& prefix = "") {
+  const auto unary = [](const char* returns) {
+    return std::vector<velox::exec::FunctionSignaturePtr>{
+        velox::exec::FunctionSignatureBuilder()
+            .returnType(returns)
+            .argumentType("varchar")
+            .build()};
+  };
+  velox::exec::registerVectorFunction(prefix + "lower", unary("varchar"),
+                                      std::make_unique<CaseFunction<false>>());
+  velox::exec::registerVectorFunction(prefix + "upper", unary("varchar"),
+                                      std::make_unique<CaseFunction<true>>());
+  velox::exec::registerVectorFunction(prefix + "length", unary("bigint"),
+                                      std::make_unique<LengthFunction>());
+  velox::exec::registerVectorFunction(
+      prefix + "is_valid_utf8", unary("boolean"),
+      std::make_unique<IsValidUtf8Function>());
+  velox::exec::registerVectorFunction(
+      prefix + "substr",
+      {velox::exec::FunctionSignatureBuilder()
+           .returnType("varchar")
+           .argumentType("varchar")
+           .argumentType("bigint")
+           .build(),
+       velox::exec::FunctionSignatureBuilder()
+           .returnType("varchar")
+           .argumentType("varchar")
+           .argumentType("bigint")
+           .argumentType("bigint")
+           .build()},
+      std::make_unique<SubstrFunction>());
+}
+
+}  // namespace halo::exec::utf8
@@ -0,0 +1,257 @@
+module;
+#include <utf8proc.h>
+#include <xsimd/xsimd.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+export module halo.exec.utf8:Utf8Kernels;
+
+namespace halo::exec::utf8 {
+
+// Kernels over UTF-8 strings that handle ASCII a block at a time. Most
+// text is ASCII, where a byte is a character and case mapping is a range
+// check, so each kernel tests kBlockBytes at once with SIMD and only hands
+// the characters of blocks that aren't all ASCII to utf8proc.
+
+using ByteBatch = xsimd::batch<std::uint8_t>;
+
+// 64 bytes: one AVX-512 register, two AVX2 or four SSE/NEON ones.
+export constexpr std::size_t kBlockBytes = 64;
+
+static_assert(kBlockBytes % ByteBatch::size == 0);
+
+const std::uint8_t* bytesOf(const char* data) {
+  return reinterpret_cast<const std::uint8_t*>(data);
+}
+
+// Whether the kBlockBytes at `data' are all ASCII.
+bool isAsciiBlock(const char* data) {
+  auto bits = ByteBatch::load_unaligned(bytesOf(data));
+  for (std::size_t i = ByteBatch::size; i < kBlockBytes;
+       i += ByteBatch::size) {
+    bits |= ByteBatch::load_unaligned(bytesOf(data + i));
+  }
+  return !xsimd::any((bits & ByteBatch(0x80)) != ByteBatch(0));
+}
+
+// Characters starting in the kBlockBytes at `data', i.e. its bytes that
+// are not continuation bytes (10xxxxxx).
+std::size_t leadBytesInBlock(const char* data) {
+  std::size_t leads = 0;
+  for (std::size_t i = 0; i < kBlockBytes; i += ByteBatch::size) {
+    const auto bytes = ByteBatch::load_unaligned(bytesOf(data + i));
+    leads += static_cast<std::size_t>(std::popcount(
+        ((bytes & ByteBatch(0xC0)) != ByteBatch(0x80)).mask()));
+  }
+  return leads;
+}
+
+bool isContinuation(char c) {
+  return (static_cast<std::uint8_t>(c) & 0xC0) == 0x80;
+}
+
+// Length of the ASCII prefix of `text'.
+export std::size_t asciiPrefix(std::string_view text) {
+  std::size_t position = 0;
+  for (; text.size() - position >= kBlockBytes; position += kBlockBytes) {
+    if (isAsciiBlock(text.data() + position)) {
+      continue;
+    }
+    for (std::size_t i = 0;; i += ByteBatch::size) {
+      const auto bytes =
+          ByteBatch::load_unaligned(bytesOf(text.data() + position + i));
+      const auto high = ((bytes & ByteBatch(0x80)) != ByteBatch(0)).mask();
+      if (high != 0) {
+        return position + i +
+               static_cast<std::size_t>(std::countr_zero(high));
+      }
+    }
+  }
+  while (position < text.size() &&
+         static_cast<std::uint8_t>(text[position]) < 0x80) {
+    ++position;
+  }
+  return position;
+}
+
+export bool isAscii(std::string_view text) {
+  return asciiPrefix(text) == text.size();
+}
+
+// Whether `text' is well-formed UTF-8: no stray continuation bytes,
+// truncated or overlong sequences, surrogates or code points past
+// U+10FFFF.
+export bool isValidUtf8(std::string_view text) {
+  std::size_t position = 0;
+  while (true) {
+    position += asciiPrefix(text.substr(position));
+    if (position == text.size()) {
+      return true;
+    }
+    utf8proc_int32_t codepoint = 0;
+    const auto length = utf8proc_iterate(
+        bytesOf(text.data() + position),
+        static_cast<utf8proc_ssize_t>(text.size() - position), &codepoint);
+    if (length < 0) {
+      return false;
+    }
+    position += static_cast<std::size_t>(length);
+  }
+}
+
+// Number of characters in `text'. Counts the bytes that start a
+// character, so a malformed sequence counts as one character per byte
+// that isn't a continuation byte.
+export std::size_t codepointCount(std::string_view text) {
+  std::size_t count = 0;
+  std::size_t position = 0;
+  for (; text.size() - position >= kBlockBytes; position += kBlockBytes) {
+    count += isAsciiBlock(text.data() + position)
+                 ? kBlockBytes
+                 : leadBytesInBlock(text.data() + position);
+  }
+  for (; position < text.size(); ++position) {
+    count += isContinuation(text[position]) ? 0 : 1;
+  }
+  return count;
+}
+
+// Byte offset in `text' of its character number `n' (from 0), or its size
+// when it has no more than `n' characters.
+export std::size_t codepointOffset(std::string_view text, std::size_t n) {
+  std::size_t position = 0;
+  // A block whose characters all come before character `n' is skipped in
+  // one step, along with the rest of a character it ends inside.
+  while (n >= kBlockBytes && text.size() - position >= kBlockBytes) {
+    const auto leads = leadBytesInBlock(text.data() + position);
+    if (leads > n) {
+      break;
+    }
+    n -= leads;
+    position += kBlockBytes;
+    while (position < text.size() && isContinuation(text[position])) {
+      ++position;
+    }
+  }
+  for (; position < text.size(); ++position) {
+    if (!isContinuation(text[position])) {
+      if (n == 0) {
+        return position;
+      }
+      --n;
+    }
+  }
+  return text.size();
+}
+
+// substr(text, start, length) with SQL semantics on characters: `start'
+// counts from 1, or from the end when negative, and 0 gives an empty
+// string. Returns a view into `text'.
+export std::string_view substringByCodepoint(std::string_view text,
+                                             std::int64_t start,
+                                             std::int64_t length) {
+  if (start == 0 || length <= 0) {
+    return {};
+  }
+  std::size_t first = 0;
+  if (start > 0) {
+    first = static_cast<std::size_t>(start - 1);
+  } else {
+    const auto count = static_cast<std::int64_t>(codepointCount(text));
+    if (start < -count) {
+      return {};
+    }
+    first = static_cast<std::size_t>(count + start);
+  }
+  const auto begin = codepointOffset(text, first);
+  const auto rest = text.substr(begin);
+  return rest.substr(
+      0, codepointOffset(rest, static_cast<std::size_t>(length)));
+}
+
+// An upper bound on the bytes toLower and toUpper write for `bytes' of
+// input. ASCII maps to ASCII, and no character grows by more than the
+// bytes it takes.
+export constexpr std::size_t maxCaseMappedBytes(std::size_t bytes) {
+  return 2 * bytes;
+}
+
+template <bool kUpper>
+std::size_t mapCase(std::string_view text, char* out) {
+  // The ASCII letters of the other case, and what to add to them.
+  constexpr std::uint8_t kFirst = kUpper ? 'a' : 'A';
+  constexpr std::uint8_t kLast = kUpper ? 'z' : 'Z';
+  constexpr auto kShift = static_cast<std::uint8_t>(kUpper ? 0xE0 : 0x20);
+  const auto mapAscii = [&](char c) {
+    const auto byte = static_cast<std::uint8_t>(c);
+    return static_cast<char>(byte >= kFirst && byte <= kLast
+                                 ? static_cast<std::uint8_t>(byte + kShift)
+                                 : byte);
+  };
+
+  std::size_t written = 0;
+  std::size_t position = 0;
+  while (position < text.size()) {
+    if (text.size() - position >= kBlockBytes &&
+        isAsciiBlock(text.data() + position)) {
+      for (std::size_t i = 0; i < kBlockBytes; i += ByteBatch::size) {
+        const auto bytes =
+            ByteBatch::load_unaligned(bytesOf(text.data() + position + i));
+        const auto letters =
+            (bytes >= ByteBatch(kFirst)) & (bytes <= ByteBatch(kLast));
+        xsimd::select(letters, bytes + ByteBatch(kShift), bytes)
+            .store_unaligned(
+                reinterpret_cast<std::uint8_t*>(out + written + i));
+      }
+      position += kBlockBytes;
+      written += kBlockBytes;
+      continue;
+    }
+    // Up to the next block: ASCII bytes one by one, the rest through
+    // utf8proc.
+    const auto end = std::min(text.size(), position + kBlockBytes);
+    while (position < end) {
+      const char c = text[position];
+      if (static_cast<std::uint8_t>(c) < 0x80) {
+        out[written++] = mapAscii(c);
+        ++position;
+        continue;
+      }
+      utf8proc_int32_t codepoint = 0;
+      const auto length = utf8proc_iterate(
+          bytesOf(text.data() + position),
+          static_cast<utf8proc_ssize_t>(text.size() - position), &codepoint);
+      if (length < 0) {
+        // Malformed bytes pass through unchanged.
+        out[written++] = c;
+        ++position;
+        continue;
+      }
+      const auto mapped =
+          kUpper ? utf8proc_toupper(codepoint) : utf8proc_tolower(codepoint);
+      written += static_cast<std::size_t>(utf8proc_encode_char(
+          mapped, reinterpret_cast<utf8proc_uint8_t*>(out + written)));
+      position += static_cast<std::size_t>(length);
+    }
+  }
+  return written;
+}
+
+// Writes `text' lowercased to `out', which has room for
+// maxCaseMappedBytes(text.size()) bytes, and returns the bytes written.
+// Maps each character on its own, without the context-dependent rules of
+// full case mapping.
+export std::size_t toLower(std::string_view text, char* out) {
+  return mapCase<false>(text, out);
+}
+
+// Uppercase counterpart of toLower.
+export std::size_t toUpper(std::string_view text, char* out) {
+  return mapCase<true>(text, out);
+}
+
+}  // namespace halo::exec::utf8
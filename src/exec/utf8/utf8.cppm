@@ -0,0 +1,3 @@
+export module halo.exec.utf8;
+export import :StringFunctions;
+export import :Utf8Kernels;
@@ -0,0 +1,260 @@
+module;
+#include <folly/Executor.h>
+#include <folly/futures/Future.h>
+#include <velox/buffer/Buffer.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+export module halo.ingest.csv:CsvLoader;
+import halo.common;
+import halo.storage.file;
+import :CsvParser;
+
+namespace halo::ingest::csv {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+using halo::storage::file::ReadFile;
+using halo::storage::file::ReadRange;
+
+namespace velox = facebook::velox;
+
+constexpr std::size_t kScanBlockBytes = 1024 * 1024;
+
+// Finds row ends by reading the file in blocks. In quoted-newline mode it
+// tracks quote state and therefore has to move forward through every byte.
+class RowBoundaryScanner final {
+ public:
+  RowBoundaryScanner(const ReadFile& file, const CsvOptions& options)
+      : file_(file), options_(options), block_(kScanBlockBytes, '\0') {}
+
+  // Only valid without quoted newlines, where a row ends at any newline.
+  void seek(std::uint64_t offset) { position_ = offset; }
+
+  // Offset just past the next row end, or the file size.
+  StatusOr<std::uint64_t> nextRowEnd() {
+    const std::uint64_t size = file_.size();
+    while (position_ < size) {
+      if (position_ < block_offset_ ||
+          position_ >= block_offset_ + block_length_) {
+        block_offset_ = position_;
+        block_length_ =
+            std::min<std::uint64_t>(block_.size(), size - position_);
+        auto status = file_.pread(block_offset_, block_length_, block_.data());
+        if (!status.ok()) {
+          return status;
+        }
+      }
+      const char* data = block_.data() + (position_ - block_offset_);
+      const auto length = static_cast<std::size_t>(
+          block_offset_ + block_length_ - position_);
+      if (!options_.quoted_newlines) {
+        const auto* newline =
+            static_cast<const char*>(std::memchr(data, '\n', length));
+        if (newline != nullptr) {
+          position_ += static_cast<std::uint64_t>(newline - data) + 1;
+          return position_;
+        }
+        position_ += length;
+        continue;
+      }
+      for (std::size_t i = 0; i < length; ++i) {
+        if (data[i] == options_.quote) {
+          in_quote_ = !in_quote_;
+        } else if (data[i] == '\n' && !in_quote_) {
+          position_ += i + 1;
+          return position_;
+        }
+      }
+      position_ += length;
+    }
+    return size;
+  }
+
+ private:
+  const ReadFile& file_;
+  const CsvOptions& options_;
+  std::string block_;
+  std::uint64_t block_offset_ = 0;
+  std::uint64_t block_length_ = 0;
+  std::uint64_t position_ = 0;
+  bool in_quote_ = false;
+};
+
+// Splits the data rows of `file' into chunks of roughly `chunk_bytes', each
+// ending just after a row's newline. Without quoted newlines every boundary
+// is found by probing the bytes after its target offset; with them the file
+// is scanned once, sequentially, before parsing starts.
+export StatusOr<std::vector<ReadRange>> findCsvChunks(
+    const ReadFile& file, const CsvOptions& options) {
+  if (options.chunk_bytes == 0) {
+    return Status::Invalid("chunk_bytes must be positive");
+  }
+  const std::uint64_t size = file.size();
+  RowBoundaryScanner scanner(file, options);
+  std::uint64_t start = 0;
+  if (options.header) {
+    auto header_end = scanner.nextRowEnd();
+    if (!header_end.ok()) {
+      return header_end.status();
+    }
+    start = *header_end;
+  }
+
+  std::vector<ReadRange> chunks;
+  while (start < size) {
+    const std::uint64_t target = start + options.chunk_bytes - 1;
+    if (target >= size - 1) {
+      chunks.push_back({.offset = start, .length = size - start});
+      break;
+    }
+    if (!options.quoted_newlines) {
+      scanner.seek(target);
+    }
+    std::uint64_t end = start;
+    while (end <= target) {
+      auto row_end = scanner.nextRowEnd();
+      if (!row_end.ok()) {
+        return row_end.status();
+      }
+      end = *row_end;
+    }
+    chunks.push_back({.offset = start, .length = end - start});
+    start = end;
+  }
+  return chunks;
+}
+
+export struct CsvLoadStats {
+  std::uint64_t rows = 0;
+  std::uint64_t bytes = 0;
+  std::size_t chunks = 0;
+};
+
+// Receives parsed batches in file order, e.g. to append them to a table.
+export using RowVectorSink = std::function<Status(velox::RowVectorPtr)>;
+
+// Bulk CSV loader. The file is cut into row-aligned chunks which are read and
+// parsed concurrently on `executor', straight into typed Velox flat vectors;
+// the resulting batches are handed to the sink in file order. At most
+// max_chunks_in_flight chunks are buffered at a time.
+export class CsvLoader final {
+ public:
+  static StatusOr<CsvLoader> create(velox::RowTypePtr row_type,
+                                    const CsvOptions& options,
+                                    velox::memory::MemoryPool* pool,
+                                    folly::Executor* executor) {
+    if (pool == nullptr || executor == nullptr) {
+      return Status::Invalid("CSV loader needs a memory pool and executor");
+    }
+    auto parser = CsvChunkParser::create(std::move(row_type), options, pool);
+    if (!parser.ok()) {
+      return parser.status();
+    }
+    return CsvLoader(std::move(parser).value(), options, pool, executor);
+  }
+
+  StatusOr<CsvLoadStats> load(const ReadFile& file,
+                              const RowVectorSink& sink) const {
+    auto chunks = findCsvChunks(file, options_);
+    if (!chunks.ok()) {
+      return chunks.status();
+    }
+    std::size_t window = options_.max_chunks_in_flight;
+    if (window == 0) {
+      window = 2 * std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    CsvLoadStats stats;
+    Status status = Status::OK();
+    std::deque<folly::SemiFuture<StatusOr<velox::RowVectorPtr>>> pending;
+    std::size_t next = 0;
+    while (next < chunks->size() || !pending.empty()) {
+      while (status.ok() && next < chunks->size() &&
+             pending.size() < window) {
+        pending.push_back(parseAsync(file, (*chunks)[next++]));
+      }
+      if (pending.empty()) {
+        break;
+      }
+      // Always drained, even after an error: the tasks reference `file'.
+      auto batch = std::move(pending.front()).get();
+      pending.pop_front();
+      if (!status.ok()) {
+        continue;
+      }
+      if (!batch.ok()) {
+        status = batch.status();
+        continue;
+      }
+      stats.rows += static_cast<std::uint64_t>((*batch)->size());
+      ++stats.chunks;
+      status = sink(std::move(batch).value());
+    }
+    if (!status.ok()) {
+      return status;
+    }
+    stats.bytes = file.size();
+    return stats;
+  }
+
+ private:
+  CsvLoader(CsvChunkParser parser, const CsvOptions& options,
+            velox::memory::MemoryPool* pool, folly::Executor* executor)
+      : parser_(std::move(parser)),
+        options_(options),
+        pool_(pool),
+        executor_(executor) {}
+
+  folly::SemiFuture<StatusOr<velox::RowVectorPtr>> parseAsync(
+      const ReadFile& file, ReadRange range) const {
+    folly::Promise<StatusOr<velox::RowVectorPtr>> promise;
+    auto future = promise.getSemiFuture();
+    executor_->add([this, &file, range,
+                    promise = std::move(promise)]() mutable {
+      promise.setValue(parse(file, range));
+    });
+    return future;
+  }
+
+  // Runs on the executor. Velox throws, e.g. when the pool is out of
+  // memory; an exception escaping the task would only reach the caller as
+  // a broken promise, so it is turned into a Status here.
+  StatusOr<velox::RowVectorPtr> parse(const ReadFile& file,
+                                      ReadRange range) const {
+    try {
+      auto buffer = velox::AlignedBuffer::allocate<char>(range.length, pool_);
+      auto status =
+          file.pread(range.offset, range.length, buffer->asMutable<char>());
+      if (!status.ok()) {
+        return status;
+      }
+      return parser_.parse(std::move(buffer), range.offset);
+    } catch (const std::exception& e) {
+      return Status::StorageError("cannot load CSV chunk at offset " +
+                                  std::to_string(range.offset) + ": " +
+                                  e.what());
+    }
+  }
+
+  CsvChunkParser parser_;
+  CsvOptions options_;
+  velox::memory::MemoryPool* pool_;
+  folly::Executor* executor_;
+};
+
+}  // namespace halo::ingest::csv
@@ -0,0 +1,379 @@
+module;
+#include <fast_float/fast_float.h>
+#include <velox/buffer/Buffer.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/StringView.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+export module halo.ingest.csv:CsvParser;
+import halo.common;
+
+namespace halo::ingest::csv {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+namespace velox = facebook::velox;
+
+export struct CsvOptions {
+  char delimiter = ',';
+  char quote = '"';
+  // Skip the first line of the file.
+  bool header = true;
+  // Unquoted fields equal to this are NULL. A quoted empty field ("") is
+  // always an empty string.
+  std::string null_string;
+  // Target bytes per parallel chunk; chunks end on a row boundary.
+  std::size_t chunk_bytes = 8 * 1024 * 1024;
+  // Allow newlines inside quoted fields. Finding row boundaries then needs a
+  // sequential quote-aware scan of the file before parsing starts.
+  bool quoted_newlines = false;
+  // Chunks read, parsed and buffered at once; 0 means twice the hardware
+  // concurrency.
+  std::size_t max_chunks_in_flight = 0;
+};
+
+bool isSupportedKind(velox::TypeKind kind) {
+  switch (kind) {
+    case velox::TypeKind::BOOLEAN:
+    case velox::TypeKind::TINYINT:
+    case velox::TypeKind::SMALLINT:
+    case velox::TypeKind::INTEGER:
+    case velox::TypeKind::BIGINT:
+    case velox::TypeKind::REAL:
+    case velox::TypeKind::DOUBLE:
+    case velox::TypeKind::VARCHAR:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Parses one chunk of complete CSV rows into a RowVector of `row_type'.
+//
+// The chunk is read into a mutable buffer owned by the caller and handed
+// over here; VARCHAR values point into it (quoted fields are unescaped in
+// place), so string columns need no further copies and the buffer becomes
+// their string buffer.
+export class CsvChunkParser final {
+ public:
+  static StatusOr<CsvChunkParser> create(velox::RowTypePtr row_type,
+                                         const CsvOptions& options,
+                                         velox::memory::MemoryPool* pool) {
+    if (row_type == nullptr || row_type->size() == 0) {
+      return Status::Invalid("CSV schema must have at least one column");
+    }
+    for (std::size_t i = 0; i < row_type->size(); ++i) {
+      if (!isSupportedKind(row_type->childAt(i)->kind())) {
+        return Status::NotImplemented("CSV column '" + row_type->nameOf(i) +
+                                      "' has unsupported type " +
+                                      row_type->childAt(i)->toString());
+      }
+    }
+    if (options.delimiter == '\n' || options.delimiter == options.quote) {
+      return Status::Invalid("invalid CSV delimiter");
+    }
+    return CsvChunkParser(std::move(row_type), options, pool);
+  }
+
+  // `chunk' holds whole rows; `first_byte' is its file offset, used only in
+  // error messages.
+  StatusOr<velox::RowVectorPtr> parse(velox::BufferPtr chunk,
+                                      std::uint64_t first_byte) const {
+    char* const begin = chunk->asMutable<char>();
+    char* const end = begin + chunk->size();
+    // Upper bound; blank lines and quoted newlines make it overshoot and the
+    // vectors are shrunk at the end.
+    const auto capacity = static_cast<velox::vector_size_t>(
+        std::count(begin, end, '\n') +
+        (chunk->size() > 0 && end[-1] != '\n' ? 1 : 0));
+
+    std::vector<velox::VectorPtr> children;
+    std::vector<ColumnTarget> targets;
+    children.reserve(row_type_->size());
+    targets.reserve(row_type_->size());
+    for (const auto& type : row_type_->children()) {
+      children.push_back(velox::BaseVector::create(type, capacity, pool_));
+      targets.push_back(ColumnTarget::of(*children.back()));
+    }
+
+    velox::vector_size_t row = 0;
+    char* cursor = begin;
+    while (cursor < end) {
+      if (*cursor == '\n' || (*cursor == '\r' && cursor + 1 < end &&
+                              cursor[1] == '\n')) {
+        cursor += *cursor == '\r' ? 2 : 1;
+        continue;
+      }
+      for (std::size_t column = 0; column < children.size(); ++column) {
+        Field field;
+        const char* error = nextField(cursor, end, field);
+        if (error == nullptr && field.last != (column + 1 == children.size())) {
+          error = field.last ? "too few fields" : "too many fields";
+        }
+        if (error == nullptr) {
+          error = store(targets[column], row, field);
+        }
+        if (error != nullptr) {
+          return Status::Invalid(
+              "CSV error in row " + std::to_string(row) +
+              " of chunk at byte " + std::to_string(first_byte) +
+              ", column '" + row_type_->nameOf(column) + "': " + error +
+              " '" + std::string(field.data, field.size) + "'");
+        }
+      }
+      ++row;
+    }
+
+    for (std::size_t column = 0; column < children.size(); ++column) {
+      auto& child = children[column];
+      if (child->typeKind() == velox::TypeKind::VARCHAR) {
+        child->asFlatVector<velox::StringView>()->setStringBuffers({chunk});
+      }
+      if (row != capacity) {
+        child->resize(row);
+      }
+    }
+    return std::make_shared<velox::RowVector>(
+        pool_, row_type_, nullptr, row, std::move(children));
+  }
+
+  [[nodiscard]] const velox::RowTypePtr& rowType() const { return row_type_; }
+
+ private:
+  // Typed write access to one output column, resolved once per chunk so the
+  // per-value path needs no virtual calls or casts.
+  struct ColumnTarget {
+    velox::TypeKind kind;
+    velox::BaseVector* vector;
+    void* raw_values;
+
+    static ColumnTarget of(velox::BaseVector& vector) {
+      void* raw = nullptr;
+      switch (vector.typeKind()) {
+        case velox::TypeKind::TINYINT:
+          raw = rawValues<std::int8_t>(vector);
+          break;
+        case velox::TypeKind::SMALLINT:
+          raw = rawValues<std::int16_t>(vector);
+          break;
+        case velox::TypeKind::INTEGER:
+          raw = rawValues<std::int32_t>(vector);
+          break;
+        case velox::TypeKind::BIGINT:
+          raw = rawValues<std::int64_t>(vector);
+          break;
+        case velox::TypeKind::REAL:
+          raw = rawValues<float>(vector);
+          break;
+        case velox::TypeKind::DOUBLE:
+          raw = rawValues<double>(vector);
+          break;
+        case velox::TypeKind::VARCHAR:
+          raw = rawValues<velox::StringView>(vector);
+          break;
+        default:
+          // BOOLEAN is bit-packed and written through FlatVector::set.
+          break;
+      }
+      return {.kind = vector.typeKind(), .vector = &vector, .raw_values = raw};
+    }
+
+    template <typename T>
+    static T* rawValues(velox::BaseVector& vector) {
+      return vector.asFlatVector<T>()->mutableRawValues();
+    }
+
+    template <typename T>
+    void set(velox::vector_size_t row, T value) const {
+      static_cast<T*>(raw_values)[row] = value;
+    }
+  };
+
+  struct Field {
+    const char* data = nullptr;
+    std::size_t size = 0;
+    bool quoted = false;
+    // Field ended the row.
+    bool last = false;
+  };
+
+  CsvChunkParser(velox::RowTypePtr row_type, const CsvOptions& options,
+                 velox::memory::MemoryPool* pool)
+      : row_type_(std::move(row_type)), options_(options), pool_(pool) {}
+
+  // The per-field helpers below return a static error message, or nullptr on
+  // success, keeping Status construction off the per-value path.
+
+  // Advances `cursor' past the next field and its delimiter or line end.
+  const char* nextField(char*& cursor, char* end, Field& field) const {
+    if (cursor < end && *cursor == options_.quote) {
+      char* read = cursor + 1;
+      char* write = read;
+      field.data = read;
+      field.quoted = true;
+      while (true) {
+        auto* quote = static_cast<char*>(std::memchr(
+            read, options_.quote, static_cast<std::size_t>(end - read)));
+        if (quote == nullptr) {
+          return "unterminated quoted field";
+        }
+        const auto length = static_cast<std::size_t>(quote - read);
+        if (write != read) {
+          std::memmove(write, read, length);
+        }
+        write += length;
+        read = quote + 1;
+        if (read < end && *read == options_.quote) {
+          *write++ = options_.quote;
+          ++read;
+          continue;
+        }
+        break;
+      }
+      field.size = static_cast<std::size_t>(write - field.data);
+      cursor = read;
+      return endField(cursor, end, field);
+    }
+
+    field.data = cursor;
+    while (cursor < end && *cursor != options_.delimiter && *cursor != '\n') {
+      ++cursor;
+    }
+    field.size = static_cast<std::size_t>(cursor - field.data);
+    if (field.size > 0 && field.data[field.size - 1] == '\r' &&
+        (cursor == end || *cursor == '\n')) {
+      --field.size;
+    }
+    return endField(cursor, end, field);
+  }
+
+  const char* endField(char*& cursor, char* end, Field& field) const {
+    if (cursor < end && *cursor == '\r' && cursor + 1 < end &&
+        cursor[1] == '\n') {
+      ++cursor;
+    }
+    if (cursor == end || *cursor == '\n') {
+      field.last = true;
+    } else if (*cursor != options_.delimiter) {
+      return "unexpected character after quoted field";
+    }
+    if (cursor < end) {
+      ++cursor;
+    }
+    return nullptr;
+  }
+
+  const char* store(const ColumnTarget& target, velox::vector_size_t row,
+                    const Field& field) const {
+    const std::string_view text(field.data, field.size);
+    if (!field.quoted && text == options_.null_string) {
+      target.vector->setNull(row, true);
+      return nullptr;
+    }
+    switch (target.kind) {
+      case velox::TypeKind::BOOLEAN:
+        return storeBoolean(target, row, text);
+      case velox::TypeKind::TINYINT:
+        return storeInteger<std::int8_t>(target, row, text);
+      case velox::TypeKind::SMALLINT:
+        return storeInteger<std::int16_t>(target, row, text);
+      case velox::TypeKind::INTEGER:
+        return storeInteger<std::int32_t>(target, row, text);
+      case velox::TypeKind::BIGINT:
+        return storeInteger<std::int64_t>(target, row, text);
+      case velox::TypeKind::REAL:
+        return storeFloat<float>(target, row, text);
+      case velox::TypeKind::DOUBLE:
+        return storeFloat<double>(target, row, text);
+      case velox::TypeKind::VARCHAR:
+        target.set(row, velox::StringView(
+                            field.data, static_cast<std::int32_t>(field.size)));
+        return nullptr;
+      default:
+        return "unsupported column type";
+    }
+  }
+
+  template <typename T>
+  static const char* storeInteger(const ColumnTarget& target,
+                                  velox::vector_size_t row,
+                                  std::string_view text) {
+    T value{};
+    const char* first = text.data();
+    if (!text.empty() && text.front() == '+') {
+      // from_chars accepts the '-' of "+-5", so a second sign is refused
+      // here.
+      if (++first != text.data() + text.size() &&
+          (*first == '-' || *first == '+')) {
+        return "invalid integer";
+      }
+    }
+    const auto [ptr, ec] =
+        std::from_chars(first, text.data() + text.size(), value);
+    if (ec != std::errc() || ptr != text.data() + text.size()) {
+      return "invalid integer";
+    }
+    target.set(row, value);
+    return nullptr;
+  }
+
+  template <typename T>
+  static const char* storeFloat(const ColumnTarget& target,
+                                velox::vector_size_t row,
+                                std::string_view text) {
+    T value{};
+    const char* first = text.data();
+    if (!text.empty() && text.front() == '+') {
+      if (++first != text.data() + text.size() &&
+          (*first == '-' || *first == '+')) {
+        return "invalid number";
+      }
+    }
+    const auto [ptr, ec] =
+        fast_float::from_chars(first, text.data() + text.size(), value);
+    if (ec != std::errc() || ptr != text.data() + text.size()) {
+      return "invalid number";
+    }
+    target.set(row, value);
+    return nullptr;
+  }
+
+  static const char* storeBoolean(const ColumnTarget& target,
+                                  velox::vector_size_t row,
+                                  std::string_view text) {
+    const auto equals = [&](std::string_view word) {
+      return std::ranges::equal(text, word, [](char a, char b) {
+        return (a | 0x20) == b;
+      });
+    };
+    bool value = false;
+    if (text == "1" || equals("t") || equals("true")) {
+      value = true;
+    } else if (!(text == "0" || equals("f") || equals("false"))) {
+      return "invalid boolean";
+    }
+    target.vector->asFlatVector<bool>()->set(row, value);
+    return nullptr;
+  }
+
+  velox::RowTypePtr row_type_;
+  CsvOptions options_;
+  velox::memory::MemoryPool* pool_;
+};
+
+}  // namespace halo::ingest::csv
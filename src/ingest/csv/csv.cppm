@@ -0,0 +1,3 @@
+export module halo.ingest.csv;
+export import :CsvLoader;
+export import :CsvParser;
@@ -0,0 +1,670 @@
+module;
+#include <simdjson.h>
+#include <velox/buffer/Buffer.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/StringView.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+export module halo.ingest.json:JsonColumnWriter;
+import halo.common;
+
+namespace halo::ingest::json {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+namespace velox = facebook::velox;
+namespace ondemand = simdjson::ondemand;
+
+// Pool-backed array that is appended to and grown by doubling; finish()
+// hands the buffer to a vector and starts over.
+template <typename T>
+class BufferBuilder final {
+ public:
+  explicit BufferBuilder(velox::memory::MemoryPool* pool) : pool_(pool) {}
+
+  void append(T value) {
+    if (size_ == capacity_) {
+      grow();
+    }
+    data_[size_++] = value;
+  }
+
+  [[nodiscard]] T* data() { return data_; }
+  [[nodiscard]] std::size_t size() const { return size_; }
+
+  velox::BufferPtr finish() {
+    if (buffer_ == nullptr) {
+      return velox::AlignedBuffer::allocate<T>(0, pool_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    capacity_ = 0;
+    return std::move(buffer_);
+  }
+
+ private:
+  void grow() {
+    const std::size_t capacity = std::max<std::size_t>(64, 2 * capacity_);
+    auto buffer = velox::AlignedBuffer::allocate<T>(capacity, pool_);
+    if (size_ > 0) {
+      std::memcpy(buffer->template asMutable<T>(), data_, size_ * sizeof(T));
+    }
+    buffer_ = std::move(buffer);
+    data_ = buffer_->asMutable<T>();
+    capacity_ = capacity;
+  }
+
+  velox::memory::MemoryPool* pool_;
+  velox::BufferPtr buffer_;
+  T* data_ = nullptr;
+  std::size_t size_ = 0;
+  std::size_t capacity_ = 0;
+};
+
+// Velox null bits (set means not null) for nested vectors; finish() returns
+// nullptr when nothing was null.
+class NullsBuilder final {
+ public:
+  explicit NullsBuilder(velox::memory::MemoryPool* pool) : words_(pool) {}
+
+  void append(bool is_null) {
+    if (size_ % 64 == 0) {
+      words_.append(~std::uint64_t{0});
+    }
+    if (is_null) {
+      words_.data()[size_ / 64] &= ~(std::uint64_t{1} << (size_ % 64));
+      has_nulls_ = true;
+    }
+    ++size_;
+  }
+
+  velox::BufferPtr finish() {
+    auto words = words_.finish();
+    const bool has_nulls = has_nulls_;
+    size_ = 0;
+    has_nulls_ = false;
+    return has_nulls ? std::move(words) : nullptr;
+  }
+
+ private:
+  BufferBuilder<std::uint64_t> words_;
+  std::size_t size_ = 0;
+  bool has_nulls_ = false;
+};
+
+// Appends JSON values of one column, in document order, straight into the
+// Velox vector of its declared type. A JSON null, or a field missing from
+// its object, becomes a NULL entry.
+//
+// append() and friends return a static error message, or nullptr on
+// success, keeping Status construction off the per-value path.
+class ColumnWriter {
+ public:
+  virtual ~ColumnWriter() = default;
+
+  static StatusOr<std::unique_ptr<ColumnWriter>> create(
+      const velox::TypePtr& type, bool null_on_mismatch,
+      velox::memory::MemoryPool* pool);
+
+  virtual const char* append(ondemand::value& value) = 0;
+  virtual void appendNull() = 0;
+
+  // The values appended since the last call, as a vector of that length.
+  virtual velox::VectorPtr finish() = 0;
+
+  // Dotted path, below this column, of the field whose value failed to
+  // append last; empty when the column is not a ROW.
+  [[nodiscard]] virtual std::string errorPath() const { return {}; }
+
+ protected:
+  explicit ColumnWriter(bool null_on_mismatch)
+      : null_on_mismatch_(null_on_mismatch) {}
+
+  // For values of the wrong JSON type or out of range for the column.
+  const char* mismatch(const char* error) {
+    if (null_on_mismatch_) {
+      appendNull();
+      return nullptr;
+    }
+    return error;
+  }
+
+ private:
+  bool null_on_mismatch_;
+};
+
+template <typename T>
+class FlatWriter final : public ColumnWriter {
+ public:
+  FlatWriter(velox::TypePtr type, bool null_on_mismatch,
+             velox::memory::MemoryPool* pool)
+      : ColumnWriter(null_on_mismatch), type_(std::move(type)), pool_(pool) {}
+
+  const char* append(ondemand::value& value) override {
+    ondemand::json_type json_type;
+    if (value.type().get(json_type) != simdjson::SUCCESS) {
+      return "invalid JSON value";
+    }
+    if (json_type == ondemand::json_type::null) {
+      appendNull();
+      return nullptr;
+    }
+    T result{};
+    if (const char* error = read(value, json_type, result)) {
+      return mismatch(error);
+    }
+    appendValue(result);
+    return nullptr;
+  }
+
+  // For VARCHAR the string is copied into the vector's own string buffers:
+  // simdjson unescapes into parser memory that the next document reuses.
+  void appendValue(T value) {
+    const velox::vector_size_t row = nextRow();
+    flat_->set(row, value);
+  }
+
+  void appendNull() override {
+    const velox::vector_size_t row = nextRow();
+    vector_->setNull(row, true);
+  }
+
+  velox::VectorPtr finish() override {
+    if (vector_ == nullptr) {
+      return velox::BaseVector::create(type_, 0, pool_);
+    }
+    vector_->resize(size_);
+    // The next batch most likely needs as many slots as this one did.
+    initial_capacity_ = capacity_;
+    flat_ = nullptr;
+    size_ = 0;
+    capacity_ = 0;
+    return std::move(vector_);
+  }
+
+ private:
+  velox::vector_size_t nextRow() {
+    if (size_ == capacity_) {
+      capacity_ = std::max(initial_capacity_, 2 * capacity_);
+      if (vector_ == nullptr) {
+        vector_ = velox::BaseVector::create(type_, capacity_, pool_);
+      } else {
+        vector_->resize(capacity_);
+      }
+      flat_ = vector_->asFlatVector<T>();
+    }
+    return size_++;
+  }
+
+  static const char* read(ondemand::value& value,
+                          ondemand::json_type json_type, T& result) {
+    if constexpr (std::is_same_v<T, velox::StringView>) {
+      std::string_view text;
+      if (json_type == ondemand::json_type::string) {
+        if (value.get_string().get(text) != simdjson::SUCCESS) {
+          return "invalid JSON string";
+        }
+      } else {
+        // Any other JSON value is kept as its JSON text.
+        if (value.raw_json().get(text) != simdjson::SUCCESS) {
+          return "invalid JSON value";
+        }
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t' ||
+                                 text.back() == '\r' || text.back() == '\n')) {
+          text.remove_suffix(1);
+        }
+      }
+      result = velox::StringView(text.data(),
+                                 static_cast<std::int32_t>(text.size()));
+      return nullptr;
+    } else if constexpr (std::is_same_v<T, bool>) {
+      if (json_type != ondemand::json_type::boolean ||
+          value.get_bool().get(result) != simdjson::SUCCESS) {
+        return "expected a JSON boolean";
+      }
+      return nullptr;
+    } else if constexpr (std::is_floating_point_v<T>) {
+      double number = 0;
+      if (json_type != ondemand::json_type::number ||
+          value.get_double().get(number) != simdjson::SUCCESS) {
+        return "expected a JSON number";
+      }
+      result = static_cast<T>(number);
+      return nullptr;
+    } else {
+      std::int64_t number = 0;
+      if (json_type != ondemand::json_type::number ||
+          value.get_int64().get(number) != simdjson::SUCCESS) {
+        return "expected a JSON integer";
+      }
+      if (number < std::numeric_limits<T>::min() ||
+          number > std::numeric_limits<T>::max()) {
+        return "integer out of range";
+      }
+      result = static_cast<T>(number);
+      return nullptr;
+    }
+  }
+
+  velox::TypePtr type_;
+  velox::memory::MemoryPool* pool_;
+  velox::VectorPtr vector_;
+  velox::FlatVector<T>* flat_ = nullptr;
+  velox::vector_size_t size_ = 0;
+  velox::vector_size_t capacity_ = 0;
+  velox::vector_size_t initial_capacity_ = 1024;
+};
+
+// JSON arrays as an ArrayVector; elements go to the child writer.
+class ArrayWriter final : public ColumnWriter {
+ public:
+  ArrayWriter(velox::TypePtr type, std::unique_ptr<ColumnWriter> elements,
+              bool null_on_mismatch, velox::memory::MemoryPool* pool)
+      : ColumnWriter(null_on_mismatch),
+        type_(std::move(type)),
+        pool_(pool),
+        elements_(std::move(elements)),
+        offsets_(pool),
+        sizes_(pool),
+        nulls_(pool) {}
+
+  const char* append(ondemand::value& value) override {
+    ondemand::json_type json_type;
+    if (value.type().get(json_type) != simdjson::SUCCESS) {
+      return "invalid JSON value";
+    }
+    if (json_type == ondemand::json_type::null) {
+      appendNull();
+      return nullptr;
+    }
+    if (json_type != ondemand::json_type::array) {
+      return mismatch("expected a JSON array");
+    }
+    ondemand::array array;
+    if (value.get_array().get(array) != simdjson::SUCCESS) {
+      return "invalid JSON array";
+    }
+    const velox::vector_size_t offset = num_elements_;
+    for (auto element : array) {
+      ondemand::value element_value;
+      if (element.get(element_value) != simdjson::SUCCESS) {
+        return "invalid JSON array element";
+      }
+      if (const char* error = elements_->append(element_value)) {
+        return error;
+      }
+      ++num_elements_;
+    }
+    offsets_.append(offset);
+    sizes_.append(num_elements_ - offset);
+    nulls_.append(false);
+    ++size_;
+    return nullptr;
+  }
+
+  void appendNull() override {
+    offsets_.append(num_elements_);
+    sizes_.append(0);
+    nulls_.append(true);
+    ++size_;
+  }
+
+  velox::VectorPtr finish() override {
+    auto vector = std::make_shared<velox::ArrayVector>(
+        pool_, type_, nulls_.finish(), size_, offsets_.finish(),
+        sizes_.finish(), elements_->finish());
+    size_ = 0;
+    num_elements_ = 0;
+    return vector;
+  }
+
+  [[nodiscard]] std::string errorPath() const override {
+    return elements_->errorPath();
+  }
+
+ private:
+  velox::TypePtr type_;
+  velox::memory::MemoryPool* pool_;
+  std::unique_ptr<ColumnWriter> elements_;
+  BufferBuilder<velox::vector_size_t> offsets_;
+  BufferBuilder<velox::vector_size_t> sizes_;
+  NullsBuilder nulls_;
+  velox::vector_size_t size_ = 0;
+  velox::vector_size_t num_elements_ = 0;
+};
+
+// JSON objects with arbitrary keys as a MAP(VARCHAR, V).
+class MapWriter final : public ColumnWriter {
+ public:
+  MapWriter(velox::TypePtr type, std::unique_ptr<ColumnWriter> values,
+            bool null_on_mismatch, velox::memory::MemoryPool* pool)
+      : ColumnWriter(null_on_mismatch),
+        type_(std::move(type)),
+        pool_(pool),
+        keys_(type_->childAt(0), false, pool),
+        values_(std::move(values)),
+        offsets_(pool),
+        sizes_(pool),
+        nulls_(pool) {}
+
+  const char* append(ondemand::value& value) override {
+    ondemand::json_type json_type;
+    if (value.type().get(json_type) != simdjson::SUCCESS) {
+      return "invalid JSON value";
+    }
+    if (json_type == ondemand::json_type::null) {
+      appendNull();
+      return nullptr;
+    }
+    if (json_type != ondemand::json_type::object) {
+      return mismatch("expected a JSON object");
+    }
+    ondemand::object object;
+    if (value.get_object().get(object) != simdjson::SUCCESS) {
+      return "invalid JSON object";
+    }
+    const velox::vector_size_t offset = num_entries_;
+    for (auto field : object) {
+      std::string_view key;
+      ondemand::value field_value;
+      if (field.unescaped_key().get(key) != simdjson::SUCCESS) {
+        return "invalid JSON object key";
+      }
+      keys_.appendValue(
+          velox::StringView(key.data(), static_cast<std::int32_t>(key.size())));
+      if (field.value().get(field_value) != simdjson::SUCCESS) {
+        return "invalid JSON object value";
+      }
+      if (const char* error = values_->append(field_value)) {
+        return error;
+      }
+      ++num_entries_;
+    }
+    offsets_.append(offset);
+    sizes_.append(num_entries_ - offset);
+    nulls_.append(false);
+    ++size_;
+    return nullptr;
+  }
+
+  void appendNull() override {
+    offsets_.append(num_entries_);
+    sizes_.append(0);
+    nulls_.append(true);
+    ++size_;
+  }
+
+  velox::VectorPtr finish() override {
+    auto vector = std::make_shared<velox::MapVector>(
+        pool_, type_, nulls_.finish(), size_, offsets_.finish(),
+        sizes_.finish(), keys_.finish(), values_->finish());
+    size_ = 0;
+    num_entries_ = 0;
+    return vector;
+  }
+
+  [[nodiscard]] std::string errorPath() const override {
+    return values_->errorPath();
+  }
+
+ private:
+  velox::TypePtr type_;
+  velox::memory::MemoryPool* pool_;
+  FlatWriter<velox::StringView> keys_;
+  std::unique_ptr<ColumnWriter> values_;
+  BufferBuilder<velox::vector_size_t> offsets_;
+  BufferBuilder<velox::vector_size_t> sizes_;
+  NullsBuilder nulls_;
+  velox::vector_size_t size_ = 0;
+  velox::vector_size_t num_entries_ = 0;
+};
+
+// JSON objects as a RowVector with the declared fields. Keys are matched as
+// they appear in the input, without unescaping. Fields not in the schema
+// are never read: simdjson On-Demand skips over their values when the
+// iteration moves on, so they cost no parsing, unescaping or allocation,
+// and once every declared field has been found the rest of the object is
+// not iterated at all. For repeated keys the first occurrence wins.
+class RowWriter final : public ColumnWriter {
+ public:
+  static StatusOr<std::unique_ptr<RowWriter>> create(
+      const velox::TypePtr& type, bool null_on_mismatch,
+      velox::memory::MemoryPool* pool) {
+    const auto& row_type = type->asRow();
+    std::vector<std::unique_ptr<ColumnWriter>> children;
+    children.reserve(row_type.size());
+    for (std::size_t i = 0; i < row_type.size(); ++i) {
+      auto child =
+          ColumnWriter::create(row_type.childAt(i), null_on_mismatch, pool);
+      if (!child.ok()) {
+        return child.status();
+      }
+      children.push_back(std::move(child).value());
+    }
+    return std::unique_ptr<RowWriter>(
+        new RowWriter(type, std::move(children), null_on_mismatch, pool));
+  }
+
+  const char* append(ondemand::value& value) override {
+    ondemand::json_type json_type;
+    if (value.type().get(json_type) != simdjson::SUCCESS) {
+      return "invalid JSON value";
+    }
+    if (json_type == ondemand::json_type::null) {
+      appendNull();
+      return nullptr;
+    }
+    if (json_type != ondemand::json_type::object) {
+      return mismatch("expected a JSON object");
+    }
+    ondemand::object object;
+    if (value.get_object().get(object) != simdjson::SUCCESS) {
+      return "invalid JSON object";
+    }
+    return appendObject(object);
+  }
+
+  const char* appendObject(ondemand::object& object) {
+    std::fill(seen_.begin(), seen_.end(), false);
+    std::size_t found = 0;
+    error_field_ = -1;
+    for (auto field : object) {
+      std::string_view key;
+      if (field.escaped_key().get(key) != simdjson::SUCCESS) {
+        return "invalid JSON object key";
+      }
+      const std::size_t index = find(key);
+      if (index == children_.size()) {
+        ++skipped_fields_;
+        continue;
+      }
+      if (seen_[index]) {
+        continue;
+      }
+      seen_[index] = true;
+      ondemand::value field_value;
+      if (field.value().get(field_value) != simdjson::SUCCESS) {
+        error_field_ = static_cast<int>(index);
+        return "invalid JSON object value";
+      }
+      if (const char* error = children_[index]->append(field_value)) {
+        error_field_ = static_cast<int>(index);
+        return error;
+      }
+      if (++found == children_.size()) {
+        // The rest of the object is skipped as a whole.
+        break;
+      }
+    }
+    if (found == children_.size()) {
+      nulls_.append(false);
+      ++size_;
+      return nullptr;
+    }
+    for (std::size_t i = 0; i < children_.size(); ++i) {
+      if (!seen_[i]) {
+        children_[i]->appendNull();
+      }
+    }
+    nulls_.append(false);
+    ++size_;
+    return nullptr;
+  }
+
+  void appendNull() override {
+    for (auto& child : children_) {
+      child->appendNull();
+    }
+    nulls_.append(true);
+    ++size_;
+  }
+
+  velox::VectorPtr finish() override {
+    std::vector<velox::VectorPtr> children;
+    children.reserve(children_.size());
+    for (auto& child : children_) {
+      children.push_back(child->finish());
+    }
+    auto vector = std::make_shared<velox::RowVector>(
+        pool_, type_, nulls_.finish(), size_, std::move(children));
+    size_ = 0;
+    return vector;
+  }
+
+  [[nodiscard]] std::string errorPath() const override {
+    if (error_field_ < 0) {
+      return {};
+    }
+    const auto index = static_cast<std::size_t>(error_field_);
+    std::string path = names_[index];
+    if (auto child = children_[index]->errorPath(); !child.empty()) {
+      path += "." + child;
+    }
+    return path;
+  }
+
+  [[nodiscard]] velox::vector_size_t size() const { return size_; }
+
+  // Object fields passed over because they are not in the schema.
+  [[nodiscard]] std::uint64_t skippedFields() const { return skipped_fields_; }
+
+ private:
+  RowWriter(velox::TypePtr type,
+            std::vector<std::unique_ptr<ColumnWriter>> children,
+            bool null_on_mismatch, velox::memory::MemoryPool* pool)
+      : ColumnWriter(null_on_mismatch),
+        type_(std::move(type)),
+        pool_(pool),
+        children_(std::move(children)),
+        seen_(children_.size(), false),
+        nulls_(pool) {
+    const auto& row_type = type_->asRow();
+    for (std::size_t i = 0; i < row_type.size(); ++i) {
+      names_.push_back(row_type.nameOf(i));
+      const auto length = names_.back().size();
+      if (length >= fields_by_length_.size()) {
+        fields_by_length_.resize(length + 1);
+      }
+      fields_by_length_[length].push_back(i);
+    }
+  }
+
+  // Index of the field named `key', or the number of fields. Most keys of a
+  // wide object are not in the schema; bucketing names by length rejects
+  // them with a compare or two instead of hashing every key.
+  std::size_t find(std::string_view key) const {
+    if (key.size() < fields_by_length_.size()) {
+      for (const std::size_t index : fields_by_length_[key.size()]) {
+        if (names_[index] == key) {
+          return index;
+        }
+      }
+    }
+    return children_.size();
+  }
+
+  velox::TypePtr type_;
+  velox::memory::MemoryPool* pool_;
+  std::vector<std::unique_ptr<ColumnWriter>> children_;
+  std::vector<std::string> names_;
+  std::vector<std::vector<std::size_t>> fields_by_length_;
+  std::vector<bool> seen_;
+  NullsBuilder nulls_;
+  velox::vector_size_t size_ = 0;
+  std::uint64_t skipped_fields_ = 0;
+  int error_field_ = -1;
+};
+
+StatusOr<std::unique_ptr<ColumnWriter>> ColumnWriter::create(
+    const velox::TypePtr& type, bool null_on_mismatch,
+    velox::memory::MemoryPool* pool) {
+  const auto flat = [&]<typename T>() -> std::unique_ptr<ColumnWriter> {
+    return std::make_unique<FlatWriter<T>>(type, null_on_mismatch, pool);
+  };
+  switch (type->kind()) {
+    case velox::TypeKind::BOOLEAN:
+      return flat.operator()<bool>();
+    case velox::TypeKind::TINYINT:
+      return flat.operator()<std::int8_t>();
+    case velox::TypeKind::SMALLINT:
+      return flat.operator()<std::int16_t>();
+    case velox::TypeKind::INTEGER:
+      return flat.operator()<std::int32_t>();
+    case velox::TypeKind::BIGINT:
+      return flat.operator()<std::int64_t>();
+    case velox::TypeKind::REAL:
+      return flat.operator()<float>();
+    case velox::TypeKind::DOUBLE:
+      return flat.operator()<double>();
+    case velox::TypeKind::VARCHAR:
+      return flat.operator()<velox::StringView>();
+    case velox::TypeKind::ARRAY: {
+      auto elements = create(type->childAt(0), null_on_mismatch, pool);
+      if (!elements.ok()) {
+        return elements.status();
+      }
+      return std::unique_ptr<ColumnWriter>(std::make_unique<ArrayWriter>(
+          type, std::move(elements).value(), null_on_mismatch, pool));
+    }
+    case velox::TypeKind::MAP: {
+      if (type->childAt(0)->kind() != velox::TypeKind::VARCHAR) {
+        return Status::NotImplemented("JSON object keys map only to VARCHAR, "
+                                      "not " +
+                                      type->childAt(0)->toString());
+      }
+      auto values = create(type->childAt(1), null_on_mismatch, pool);
+      if (!values.ok()) {
+        return values.status();
+      }
+      return std::unique_ptr<ColumnWriter>(std::make_unique<MapWriter>(
+          type, std::move(values).value(), null_on_mismatch, pool));
+    }
+    case velox::TypeKind::ROW: {
+      auto row = RowWriter::create(type, null_on_mismatch, pool);
+      if (!row.ok()) {
+        return row.status();
+      }
+      return std::unique_ptr<ColumnWriter>(std::move(row).value());
+    }
+    default:
+      return Status::NotImplemented("JSON ingestion does not support type " +
+                                    type->toString());
+  }
+}
+
+}  // namespace halo::ingest::json
@@ -0,0 +1,244 @@
+module;
+#include <simdjson.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+export module halo.ingest.json:NdjsonReader;
+import halo.common;
+import halo.storage.file;
+import :JsonColumnWriter;
+
+namespace halo::ingest::json {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+using halo::storage::file::ReadFile;
+
+namespace velox = facebook::velox;
+namespace ondemand = simdjson::ondemand;
+
+export struct JsonOptions {
+  // Documents per output RowVector.
+  velox::vector_size_t batch_rows = 8192;
+  // Largest document accepted. simdjson indexes the input in windows of this
+  // size, so it also bounds the parser's memory.
+  std::size_t max_document_bytes = 1024 * 1024;
+  // Bytes read from the file at a time; doubled while a single line does not
+  // fit.
+  std::size_t read_block_bytes = 16 * 1024 * 1024;
+  // Write NULL for values of the wrong JSON type, or out of the column's
+  // range, instead of failing the read.
+  bool null_on_type_mismatch = false;
+};
+
+export struct JsonScanStats {
+  std::uint64_t documents = 0;
+  std::uint64_t bytes = 0;
+  std::size_t batches = 0;
+  // Top-level fields passed over because they are not in the projection.
+  // Fields after the last projected one of an object are not even visited
+  // and not counted.
+  std::uint64_t skipped_fields = 0;
+};
+
+// Receives batches in input order.
+export using RowVectorSink = std::function<Status(velox::RowVectorPtr)>;
+
+// Reads newline-delimited JSON objects into RowVectors of a declared ROW
+// type, using simdjson On-Demand: values are decoded straight from the
+// input into the Velox vectors of their columns (ROW, ARRAY and MAP
+// included), with no DOM or intermediate format in between, and fields
+// outside the declared type are skipped without being decoded.
+//
+// Holds a simdjson parser and is therefore not thread-safe; use one reader
+// per thread.
+export class NdjsonReader final {
+ public:
+  static StatusOr<NdjsonReader> create(velox::RowTypePtr row_type,
+                                       const JsonOptions& options,
+                                       velox::memory::MemoryPool* pool) {
+    if (pool == nullptr) {
+      return Status::Invalid("JSON reader needs a memory pool");
+    }
+    if (row_type == nullptr || row_type->size() == 0) {
+      return Status::Invalid("JSON schema must have at least one column");
+    }
+    if (options.batch_rows <= 0 || options.max_document_bytes == 0 ||
+        options.read_block_bytes == 0) {
+      return Status::Invalid(
+          "batch_rows, max_document_bytes and read_block_bytes must be "
+          "positive");
+    }
+    auto writer =
+        RowWriter::create(row_type, options.null_on_type_mismatch, pool);
+    if (!writer.ok()) {
+      return writer.status();
+    }
+    return NdjsonReader(std::move(row_type), options,
+                        std::move(writer).value());
+  }
+
+  [[nodiscard]] const velox::RowTypePtr& rowType() const { return row_type_; }
+
+  // Reads documents already in memory. simdjson needs SIMDJSON_PADDING
+  // readable bytes past the end, which padded_string provides.
+  StatusOr<JsonScanStats> read(simdjson::padded_string_view input,
+                               const RowVectorSink& sink) {
+    begin();
+    auto status = parse(input.data(), input.length(), 0, sink);
+    if (status.ok()) {
+      status = flush(sink);
+    }
+    return end(status, input.length());
+  }
+
+  // Reads `file' block by block; each block is cut after its last newline
+  // and the remainder carried into the next one.
+  StatusOr<JsonScanStats> read(const ReadFile& file,
+                               const RowVectorSink& sink) {
+    begin();
+    const std::uint64_t size = file.size();
+    std::size_t capacity = options_.read_block_bytes;
+    std::vector<char> block(capacity + simdjson::SIMDJSON_PADDING);
+    std::size_t carried = 0;
+    std::uint64_t offset = 0;
+    Status status = Status::OK();
+    while (status.ok() && offset < size) {
+      if (carried == capacity) {
+        capacity *= 2;
+        block.resize(capacity + simdjson::SIMDJSON_PADDING);
+      }
+      const auto length = static_cast<std::size_t>(
+          std::min<std::uint64_t>(capacity - carried, size - offset));
+      status = file.pread(offset, length, block.data() + carried);
+      if (!status.ok()) {
+        break;
+      }
+      offset += length;
+      const std::size_t filled = carried + length;
+      std::size_t complete = filled;
+      if (offset < size) {
+        const auto newline =
+            std::string_view(block.data(), filled).rfind('\n');
+        if (newline == std::string_view::npos) {
+          carried = filled;
+          continue;
+        }
+        complete = newline + 1;
+      }
+      status = parse(block.data(), complete, offset - filled, sink);
+      carried = filled - complete;
+      std::memmove(block.data(), block.data() + complete, carried);
+    }
+    if (status.ok()) {
+      status = flush(sink);
+    }
+    return end(status, size);
+  }
+
+ private:
+  NdjsonReader(velox::RowTypePtr row_type, const JsonOptions& options,
+               std::unique_ptr<RowWriter> writer)
+      : row_type_(std::move(row_type)),
+        options_(options),
+        writer_(std::move(writer)) {}
+
+  void begin() {
+    stats_ = {};
+    skipped_before_ = writer_->skippedFields();
+  }
+
+  StatusOr<JsonScanStats> end(const Status& status, std::uint64_t bytes) {
+    if (!status.ok()) {
+      // Drop the rows of the partial batch.
+      writer_->finish();
+      return status;
+    }
+    stats_.bytes = bytes;
+    stats_.skipped_fields = writer_->skippedFields() - skipped_before_;
+    return stats_;
+  }
+
+  // `data' holds whole documents; `first_byte' is its input offset, used
+  // only in error messages.
+  Status parse(const char* data, std::size_t length, std::uint64_t first_byte,
+               const RowVectorSink& sink) {
+    ondemand::document_stream stream;
+    auto error = parser_.iterate_many(data, length, options_.max_document_bytes)
+                     .get(stream);
+    if (error != simdjson::SUCCESS) {
+      return Status::Invalid(std::string("cannot parse JSON input: ") +
+                             simdjson::error_message(error));
+    }
+    for (auto it = stream.begin(); it != stream.end(); ++it) {
+      const std::uint64_t offset = first_byte + it.current_index();
+      ondemand::object object;
+      auto document = *it;
+      error = document.error();
+      if (error == simdjson::SUCCESS) {
+        error = document.get_object().get(object);
+      }
+      if (error == simdjson::CAPACITY) {
+        return documentError(offset, "document larger than "
+                                     "max_document_bytes");
+      }
+      if (error != simdjson::SUCCESS) {
+        return documentError(offset, simdjson::error_message(error));
+      }
+      if (const char* message = writer_->appendObject(object)) {
+        return documentError(offset, message);
+      }
+      ++stats_.documents;
+      if (writer_->size() == options_.batch_rows) {
+        auto status = flush(sink);
+        if (!status.ok()) {
+          return status;
+        }
+      }
+    }
+    if (stream.truncated_bytes() > 0) {
+      return documentError(first_byte + length - stream.truncated_bytes(),
+                           "truncated document");
+    }
+    return Status::OK();
+  }
+
+  Status flush(const RowVectorSink& sink) {
+    if (writer_->size() == 0) {
+      return Status::OK();
+    }
+    ++stats_.batches;
+    return sink(std::static_pointer_cast<velox::RowVector>(writer_->finish()));
+  }
+
+  Status documentError(std::uint64_t offset, const char* message) const {
+    std::string text = "JSON error in document " +
+                       std::to_string(stats_.documents) + " at byte " +
+                       std::to_string(offset);
+    if (auto path = writer_->errorPath(); !path.empty()) {
+      text += ", field '" + path + "'";
+    }
+    return Status::Invalid(text + ": " + message);
+  }
+
+  velox::RowTypePtr row_type_;
+  JsonOptions options_;
+  std::unique_ptr<RowWriter> writer_;
+  ondemand::parser parser_;
+  JsonScanStats stats_;
+  std::uint64_t skipped_before_ = 0;
+};
+
+}  // namespace halo::ingest::json
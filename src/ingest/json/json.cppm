@@ -0,0 +1,3 @@
+export module halo.ingest.json;
+export import :JsonColumnWriter;
+export import :NdjsonReader;
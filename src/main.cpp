@@ -1,34 +1,89 @@
 #include <absl/strings/str_cat.h>
 #include <jemalloc/jemalloc.h>
-#include <velox/type/Type.h>
-#include <velox/vector/BaseVector.h>
-#include <velox/vector/SimpleVector.h>
+#include <pthread.h>
+#include <velox/common/memory/Memory.h>
 
-#include <duckdb.hpp>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
+#include <string>
+#include <string_view>
 
-int main() {
-  std::cout << absl::StrCat("Message: ", "Halo Start...") << '\n';
+import halo.server.pgwire;
+import halo.server.session;
 
-  // Simple Velox integration test
-  try {
-    auto int_type = facebook::velox::TypeFactory<
-        facebook::velox::TypeKind::INTEGER>::create();
-    std::cout << "Velox integration successful!" << '\n';
-  } catch (const std::exception& e) {
-    std::cout << "Velox integration error: " << e.what() << '\n';
-    return 1;
+namespace {
+
+struct Flags {
+  std::uint16_t port = 5432;
+  // DuckDB database file; empty for an in-memory database.
+  std::string database;
+};
+
+bool parseFlags(int argc, char** argv, Flags& flags) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg.starts_with("--port=")) {
+      const auto port = std::atoi(arg.substr(7).data());
+      if (port <= 0 || port > 65535) {
+        return false;
+      }
+      flags.port = static_cast<std::uint16_t>(port);
+    } else if (arg.starts_with("--database=")) {
+      flags.database = std::string(arg.substr(11));
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+// Serves the PostgreSQL wire protocol on a DuckDB database until SIGINT or
+// SIGTERM.
+int main(int argc, char** argv) {
+  Flags flags;
+  if (!parseFlags(argc, argv, flags)) {
+    std::cerr << "usage: " << argv[0] << " [--port=N] [--database=PATH]\n";
+    return 2;
   }
 
-  // Simple DuckDB integration test
-  duckdb::DuckDB db(nullptr);
-  duckdb::Connection con(db);
-  auto result = con.Query("SELECT 'DuckDB integration successful!'");
-  if (!result->HasError()) {
-    std::cout << result->GetValue(0, 0).ToString() << '\n';
-  } else {
-    std::cout << "DuckDB query error: " << result->GetError() << '\n';
+  // Block the stop signals before any thread starts, so that all of them
+  // inherit the mask and only sigwait below sees the signals.
+  sigset_t stop_signals;
+  sigemptyset(&stop_signals);
+  sigaddset(&stop_signals, SIGINT);
+  sigaddset(&stop_signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+
+  facebook::velox::memory::MemoryManager::initialize(
+      facebook::velox::memory::MemoryManager::Options{});
+
+  auto engine = halo::server::session::SessionQueryEngine::create(
+      halo::server::session::SessionManager::create(), flags.database);
+  if (!engine.ok()) {
+    std::cerr << engine.status().toString() << '\n';
+    return 1;
+  }
+  auto server = halo::server::pgwire::PgServer::create(*engine, {});
+  if (!server.ok()) {
+    std::cerr << server.status().toString() << '\n';
+    return 1;
+  }
+  if (auto status = (*server)->listen(flags.port); !status.ok()) {
+    std::cerr << status.toString() << '\n';
+    return 1;
   }
+  std::cout << absl::StrCat("Halo serving ",
+                            flags.database.empty() ? ":memory:"
+                                                   : flags.database,
+                            " on port ", (*server)->port())
+            << '\n';
 
+  int received = 0;
+  sigwait(&stop_signals, &received);
+  (*server)->stop();
   return 0;
 }
@@ -0,0 +1,457 @@
+module;
+#include <fmt/chrono.h>
+#include <fmt/compile.h>
+#include <fmt/format.h>
+#include <velox/type/DecimalUtil.h>
+#include <velox/type/StringView.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+export module halo.result.text:ResultFormatter;
+import halo.common;
+import :TextBuffer;
+
+namespace halo::result::text {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+namespace velox = facebook::velox;
+
+export enum class TextFormat : std::uint8_t {
+  kCsv,
+  kTsv,
+  kJsonLines,
+};
+
+export struct TextFormatOptions {
+  TextFormat format = TextFormat::kCsv;
+  // Column names as the first line; ignored for JSON lines.
+  bool header = true;
+  // Text of NULL cells in CSV and TSV; by default empty in CSV and \N in TSV,
+  // as in PostgreSQL's COPY. JSON lines always write null. In CSV an equal
+  // string value is quoted to stay distinguishable.
+  std::optional<std::string> null_string;
+  // Formatted output is handed to the sink in pieces of about this size.
+  std::size_t buffer_bytes = 1024 * 1024;
+};
+
+// Receives formatted output in order.
+export using TextSink = std::function<Status(std::string_view)>;
+
+// Formats RowVectors as CSV (RFC 4180 quoting), TSV (backslash escapes) or
+// JSON lines.
+//
+// Works a column at a time: each column of a batch is formatted into its
+// own scratch buffer with one type dispatch and a tight typed loop
+// (std::to_chars for integers, shortest round-trip floats via fmt), then the
+// rows are assembled by copying each cell's bytes into one preallocated
+// output buffer. Scratch and output buffers are reused across batches.
+// Dispatch is on the logical type: DATE, DECIMAL and the interval types are
+// stored as integers but written as Velox writes them. Types without a fast
+// path are written through BaseVector::toString().
+//
+// Not thread-safe.
+export class ResultFormatter final {
+ public:
+  static StatusOr<ResultFormatter> create(velox::RowTypePtr row_type,
+                                          const TextFormatOptions& options) {
+    if (row_type == nullptr || row_type->size() == 0) {
+      return Status::Invalid("result must have at least one column");
+    }
+    if (options.buffer_bytes == 0) {
+      return Status::Invalid("buffer_bytes must be positive");
+    }
+    return ResultFormatter(std::move(row_type), options);
+  }
+
+  [[nodiscard]] const velox::RowTypePtr& rowType() const { return row_type_; }
+
+  // Formats the rows of `batch', handing full buffers to `sink'.
+  Status write(const velox::RowVector& batch, const TextSink& sink) {
+    if (batch.childrenSize() != columns_.size()) {
+      return Status::Invalid("batch has " +
+                             std::to_string(batch.childrenSize()) +
+                             " columns, expected " +
+                             std::to_string(columns_.size()));
+    }
+    if (!header_written_) {
+      header_written_ = true;
+      if (options_.header && options_.format != TextFormat::kJsonLines) {
+        writeHeader();
+      }
+    }
+    const velox::vector_size_t rows = batch.size();
+    for (std::size_t column = 0; column < columns_.size(); ++column) {
+      formatColumn(batch.childAt(column), rows, columns_[column]);
+    }
+
+    const std::string_view terminator = terminator_;
+    for (velox::vector_size_t row = 0; row < rows; ++row) {
+      for (std::size_t column = 0; column < columns_.size(); ++column) {
+        const auto& text = columns_[column];
+        const std::size_t begin = row == 0 ? 0 : text.ends[row - 1];
+        output_.append(prefixes_[column]);
+        output_.append({text.data.data() + begin, text.ends[row] - begin});
+      }
+      output_.append(terminator);
+      if (output_.size() >= options_.buffer_bytes) {
+        auto status = flush(sink);
+        if (!status.ok()) {
+          return status;
+        }
+      }
+    }
+    return Status::OK();
+  }
+
+  // Hands whatever is buffered to `sink'; call once after the last batch.
+  Status flush(const TextSink& sink) {
+    if (!header_written_ && options_.header &&
+        options_.format != TextFormat::kJsonLines) {
+      header_written_ = true;
+      writeHeader();
+    }
+    if (output_.size() == 0) {
+      return Status::OK();
+    }
+    auto status = sink(output_.view());
+    output_.clear();
+    return status;
+  }
+
+ private:
+  // Formatted cells of one column of the current batch; cell i spans
+  // [ends[i - 1], ends[i]) of `data'.
+  struct ColumnText {
+    TextBuffer data;
+    std::vector<std::size_t> ends;
+  };
+
+  ResultFormatter(velox::RowTypePtr row_type, const TextFormatOptions& options)
+      : row_type_(std::move(row_type)),
+        options_(options),
+        columns_(row_type_->size()),
+        output_(options.buffer_bytes + options.buffer_bytes / 8) {
+    const bool json = options_.format == TextFormat::kJsonLines;
+    delimiter_ = options_.format == TextFormat::kTsv ? '\t' : ',';
+    if (json) {
+      null_text_ = "null";
+    } else {
+      null_text_ = options_.null_string.value_or(
+          options_.format == TextFormat::kTsv ? "\\N" : "");
+    }
+    terminator_ = json ? "}\n" : "\n";
+    switch (options_.format) {
+      case TextFormat::kCsv:
+        for (const char c : {',', '"', '\n', '\r'}) {
+          special_[static_cast<unsigned char>(c)] = true;
+        }
+        break;
+      case TextFormat::kTsv:
+        for (const char c : {'\t', '\n', '\r', '\b', '\f', '\v', '\\'}) {
+          special_[static_cast<unsigned char>(c)] = true;
+        }
+        break;
+      case TextFormat::kJsonLines:
+        for (unsigned c = 0; c < 0x20; ++c) {
+          special_[c] = true;
+        }
+        special_['"'] = true;
+        special_['\\'] = true;
+        break;
+    }
+
+    TextBuffer name;
+    for (std::size_t i = 0; i < row_type_->size(); ++i) {
+      name.clear();
+      if (json) {
+        name.append(i == 0 ? "{" : ",");
+        writeString(row_type_->nameOf(i), name);
+        name.append(":");
+      } else if (i > 0) {
+        name.append({&delimiter_, 1});
+      }
+      prefixes_.emplace_back(name.view());
+    }
+  }
+
+  void writeHeader() {
+    for (std::size_t i = 0; i < row_type_->size(); ++i) {
+      if (i > 0) {
+        output_.append({&delimiter_, 1});
+      }
+      writeString(row_type_->nameOf(i), output_);
+    }
+    output_.append("\n");
+  }
+
+  void formatColumn(const velox::VectorPtr& vector, velox::vector_size_t rows,
+                    ColumnText& text) const {
+    text.data.clear();
+    text.ends.resize(static_cast<std::size_t>(rows));
+    const auto& type = vector->type();
+    if (type->isDate()) {
+      return formatText<std::int32_t>(
+          vector, rows, text, false, [](std::int32_t days) {
+            return fmt::format("{:%F}",
+                               std::chrono::sys_days(std::chrono::days(days)));
+          });
+    }
+    if (type->isShortDecimal()) {
+      return formatText<std::int64_t>(
+          vector, rows, text, true, [&](std::int64_t unscaled) {
+            return velox::DecimalUtil::toString(unscaled, type);
+          });
+    }
+    if (type->isLongDecimal()) {
+      return formatText<velox::int128_t>(
+          vector, rows, text, true, [&](velox::int128_t unscaled) {
+            return velox::DecimalUtil::toString(unscaled, type);
+          });
+    }
+    if (type->isIntervalDayTime()) {
+      return formatText<std::int64_t>(
+          vector, rows, text, false, [](std::int64_t millis) {
+            return velox::INTERVAL_DAY_TIME()->valueToString(millis);
+          });
+    }
+    if (type->isIntervalYearMonth()) {
+      return formatText<std::int32_t>(
+          vector, rows, text, false, [](std::int32_t months) {
+            return velox::INTERVAL_YEAR_MONTH()->valueToString(months);
+          });
+    }
+    // Any other logical type over a primitive kind, e.g. JSON, has its own
+    // name and no fast path.
+    const auto kind = type->name() == velox::TypeKindName::toName(type->kind())
+                          ? type->kind()
+                          : velox::TypeKind::UNKNOWN;
+    switch (kind) {
+      case velox::TypeKind::BOOLEAN:
+        return formatFlat<bool>(vector, rows, text);
+      case velox::TypeKind::TINYINT:
+        return formatFlat<std::int8_t>(vector, rows, text);
+      case velox::TypeKind::SMALLINT:
+        return formatFlat<std::int16_t>(vector, rows, text);
+      case velox::TypeKind::INTEGER:
+        return formatFlat<std::int32_t>(vector, rows, text);
+      case velox::TypeKind::BIGINT:
+        return formatFlat<std::int64_t>(vector, rows, text);
+      case velox::TypeKind::REAL:
+        return formatFlat<float>(vector, rows, text);
+      case velox::TypeKind::DOUBLE:
+        return formatFlat<double>(vector, rows, text);
+      case velox::TypeKind::VARCHAR:
+        return formatFlat<velox::StringView>(vector, rows, text);
+      default:
+        for (velox::vector_size_t row = 0; row < rows; ++row) {
+          if (vector->isNullAt(row)) {
+            text.data.append(null_text_);
+          } else {
+            writeString(vector->toString(row), text.data);
+          }
+          text.ends[static_cast<std::size_t>(row)] = text.data.size();
+        }
+        return;
+    }
+  }
+
+  template <typename T>
+  void formatFlat(velox::VectorPtr vector, velox::vector_size_t rows,
+                  ColumnText& text) const {
+    // Results may be dictionary or constant encoded.
+    velox::BaseVector::flattenVector(vector);
+    const auto* flat = vector->asFlatVector<T>();
+    const bool may_have_nulls = vector->mayHaveNulls();
+    for (velox::vector_size_t row = 0; row < rows; ++row) {
+      if (may_have_nulls && vector->isNullAt(row)) {
+        text.data.append(null_text_);
+      } else if constexpr (std::is_same_v<T, velox::StringView>) {
+        const auto value = flat->valueAt(row);
+        writeString({value.data(), static_cast<std::size_t>(value.size())},
+                    text.data);
+      } else {
+        writeNumber(flat->valueAt(row), text.data);
+      }
+      text.ends[static_cast<std::size_t>(row)] = text.data.size();
+    }
+  }
+
+  // Cells of a logical type, through `toText'. `numeric' text is written
+  // bare in JSON lines instead of as a string.
+  template <typename T, typename ToText>
+  void formatText(velox::VectorPtr vector, velox::vector_size_t rows,
+                  ColumnText& text, bool numeric, const ToText& toText) const {
+    velox::BaseVector::flattenVector(vector);
+    const auto* flat = vector->asFlatVector<T>();
+    for (velox::vector_size_t row = 0; row < rows; ++row) {
+      if (vector->isNullAt(row)) {
+        text.data.append(null_text_);
+      } else if (numeric && options_.format == TextFormat::kJsonLines) {
+        text.data.append(toText(flat->valueAt(row)));
+      } else {
+        writeString(toText(flat->valueAt(row)), text.data);
+      }
+      text.ends[static_cast<std::size_t>(row)] = text.data.size();
+    }
+  }
+
+  template <typename T>
+  void writeNumber(T value, TextBuffer& out) const {
+    if constexpr (std::is_same_v<T, bool>) {
+      out.append(value ? "true" : "false");
+    } else if constexpr (std::is_floating_point_v<T>) {
+      // JSON has no NaN or infinity.
+      if (!std::isfinite(value) &&
+          options_.format == TextFormat::kJsonLines) {
+        out.append("null");
+        return;
+      }
+      // The longest shortest round-trip double takes 24 characters.
+      char* cursor = out.reserve(32);
+      out.commitUntil(fmt::format_to(cursor, FMT_COMPILE("{}"), value));
+    } else {
+      char* cursor = out.reserve(24);
+      out.commitUntil(std::to_chars(cursor, cursor + 24, value).ptr);
+    }
+  }
+
+  // Letter of the backslash escape of `c' in TSV, as PostgreSQL's COPY
+  // text format writes it.
+  static char tsvEscape(char c) {
+    switch (c) {
+      case '\t':
+        return 't';
+      case '\n':
+        return 'n';
+      case '\r':
+        return 'r';
+      case '\b':
+        return 'b';
+      case '\f':
+        return 'f';
+      case '\v':
+        return 'v';
+      default:
+        return c;
+    }
+  }
+
+  void writeString(std::string_view value, TextBuffer& out) const {
+    std::size_t first = 0;
+    while (first < value.size() &&
+           !special_[static_cast<unsigned char>(value[first])]) {
+      ++first;
+    }
+    switch (options_.format) {
+      case TextFormat::kCsv: {
+        const bool ambiguous =
+            value == null_text_;  // Includes "" when it is NULL.
+        if (first == value.size() && !ambiguous) {
+          out.append(value);
+          return;
+        }
+        // Quoting doubles at most every byte.
+        char* cursor = out.reserve(2 * value.size() + 2);
+        *cursor++ = '"';
+        std::memcpy(cursor, value.data(), first);
+        cursor += first;
+        for (std::size_t i = first; i < value.size(); ++i) {
+          if (value[i] == '"') {
+            *cursor++ = '"';
+          }
+          *cursor++ = value[i];
+        }
+        *cursor++ = '"';
+        out.commitUntil(cursor);
+        return;
+      }
+      case TextFormat::kTsv: {
+        if (first == value.size()) {
+          out.append(value);
+          return;
+        }
+        char* cursor = out.reserve(2 * value.size());
+        std::memcpy(cursor, value.data(), first);
+        cursor += first;
+        for (std::size_t i = first; i < value.size(); ++i) {
+          const char c = value[i];
+          if (special_[static_cast<unsigned char>(c)]) {
+            *cursor++ = '\\';
+            *cursor++ = tsvEscape(c);
+          } else {
+            *cursor++ = c;
+          }
+        }
+        out.commitUntil(cursor);
+        return;
+      }
+      case TextFormat::kJsonLines: {
+        // \u00XX is the longest escape.
+        char* cursor = out.reserve(6 * value.size() + 2);
+        *cursor++ = '"';
+        std::memcpy(cursor, value.data(), first);
+        cursor += first;
+        for (std::size_t i = first; i < value.size(); ++i) {
+          const auto c = static_cast<unsigned char>(value[i]);
+          if (!special_[c]) {
+            *cursor++ = static_cast<char>(c);
+            continue;
+          }
+          *cursor++ = '\\';
+          switch (c) {
+            case '"':
+            case '\\':
+              *cursor++ = static_cast<char>(c);
+              break;
+            case '\n':
+              *cursor++ = 'n';
+              break;
+            case '\r':
+              *cursor++ = 'r';
+              break;
+            case '\t':
+              *cursor++ = 't';
+              break;
+            default:
+              cursor = fmt::format_to(cursor, FMT_COMPILE("u{:04x}"), c);
+              break;
+          }
+        }
+        *cursor++ = '"';
+        out.commitUntil(cursor);
+        return;
+      }
+    }
+  }
+
+  velox::RowTypePtr row_type_;
+  TextFormatOptions options_;
+  std::vector<ColumnText> columns_;
+  TextBuffer output_;
+  std::vector<std::string> prefixes_;
+  std::string null_text_;
+  std::string terminator_;
+  std::array<bool, 256> special_{};
+  char delimiter_ = ',';
+  bool header_written_ = false;
+};
+
+}  // namespace halo::result::text
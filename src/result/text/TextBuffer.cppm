@@ -0,0 +1,62 @@
+module;
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <utility>
+
+export module halo.result.text:TextBuffer;
+
+namespace halo::result::text {
+
+// Growable byte buffer written through raw pointers: reserve() returns room
+// for at least `bytes' more, commit() claims what was written. Unlike
+// std::string it never zero-fills the space it hands out.
+export class TextBuffer final {
+ public:
+  TextBuffer() = default;
+  explicit TextBuffer(std::size_t capacity) { grow(capacity); }
+
+  char* reserve(std::size_t bytes) {
+    if (capacity_ - size_ < bytes) {
+      grow(std::max(2 * capacity_, size_ + bytes));
+    }
+    return data_.get() + size_;
+  }
+
+  void commit(std::size_t bytes) { size_ += bytes; }
+
+  // Sets the size to the end of what was written after reserve().
+  void commitUntil(const char* end) {
+    size_ = static_cast<std::size_t>(end - data_.get());
+  }
+
+  void append(std::string_view text) {
+    std::memcpy(reserve(text.size()), text.data(), text.size());
+    size_ += text.size();
+  }
+
+  void clear() { size_ = 0; }
+
+  [[nodiscard]] const char* data() const { return data_.get(); }
+  [[nodiscard]] std::size_t size() const { return size_; }
+  [[nodiscard]] std::size_t capacity() const { return capacity_; }
+  [[nodiscard]] std::string_view view() const { return {data_.get(), size_}; }
+
+ private:
+  void grow(std::size_t capacity) {
+    auto data = std::make_unique_for_overwrite<char[]>(capacity);
+    if (size_ > 0) {
+      std::memcpy(data.get(), data_.get(), size_);
+    }
+    data_ = std::move(data);
+    capacity_ = capacity;
+  }
+
+  std::unique_ptr<char[]> data_;
+  std::size_t size_ = 0;
+  std::size_t capacity_ = 0;
+};
+
+}  // namespace halo::result::text
@@ -0,0 +1,3 @@
+export module halo.result.text;
+export import :ResultFormatter;
+export import :TextBuffer;
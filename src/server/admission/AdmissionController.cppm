@@ -0,0 +1,448 @@
+module;
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+export module halo.server.admission:AdmissionController;
+import halo.common;
+
+namespace halo::server::admission {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+export enum class QueryPriority : std::uint8_t {
+  // Short queries a user waits for; admitted ahead of any batch query.
+  kInteractive = 0,
+  // Scans and reports that may queue.
+  kBatch = 1,
+};
+
+constexpr std::size_t kPriorities = 2;
+
+export constexpr std::string_view kDefaultGroup = "default";
+
+// What one query holds while it runs.
+export struct QueryDemand {
+  std::string group = std::string(kDefaultGroup);
+  QueryPriority priority = QueryPriority::kInteractive;
+  std::uint64_t memory_bytes = 0;
+  std::uint32_t cpu_slots = 1;
+};
+
+// A class of queries with budgets of its own within the controller's.
+export struct ResourceGroupConfig {
+  std::string name;
+  // Shares of the controller's memory and CPU slots the group's running
+  // queries may hold together, in (0, 1].
+  double memory_fraction = 1.0;
+  double slot_fraction = 1.0;
+  // Queries of the group waiting at once; more are refused at once.
+  std::size_t max_queued = 1000;
+};
+
+export struct AdmissionOptions {
+  // Memory the running queries may hold together.
+  std::uint64_t memory_bytes = 8ULL << 30;
+  // Queries run at once, counted in the slots they ask for; about one per
+  // core keeps them from thrashing each other.
+  std::uint32_t cpu_slots = std::max(1U, std::thread::hardware_concurrency());
+  // Shares of the budgets that batch queries may hold together. The rest
+  // stays free for interactive queries, which then start without waiting
+  // for a long scan to finish.
+  double batch_memory_fraction = 0.75;
+  double batch_slot_fraction = 0.5;
+  // How long a query may wait for admission before it fails.
+  std::chrono::milliseconds queue_timeout{60000};
+  // Groups besides `default', which takes queries of unknown groups and
+  // may use the whole budgets.
+  std::vector<ResourceGroupConfig> groups;
+};
+
+// Upper bounds of the wait-time histogram buckets: 1us, 2us, ... ~34s.
+export constexpr std::size_t kWaitBuckets = 26;
+
+export constexpr std::chrono::nanoseconds waitBucketBound(std::size_t bucket) {
+  return std::chrono::microseconds(std::int64_t{1} << bucket);
+}
+
+// Counters of the queries of one priority within one group.
+export struct ClassStats {
+  std::uint64_t queued = 0;
+  std::uint64_t running = 0;
+  std::uint64_t admitted = 0;
+  // Refused for a full queue, a timeout or a demand beyond the budgets.
+  std::uint64_t rejected = 0;
+  std::chrono::nanoseconds total_wait{0};
+  std::chrono::nanoseconds max_wait{0};
+  // Admitted queries by wait: bucket i counts waits of at most
+  // waitBucketBound(i), the last one everything longer as well.
+  std::array<std::uint64_t, kWaitBuckets> wait_buckets{};
+
+  // Bound of the bucket holding the `fraction' quantile of waits.
+  [[nodiscard]] std::chrono::nanoseconds waitPercentile(
+      double fraction) const {
+    if (admitted == 0) {
+      return std::chrono::nanoseconds(0);
+    }
+    const auto rank = static_cast<std::uint64_t>(
+        std::ceil(fraction * static_cast<double>(admitted)));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < kWaitBuckets; ++i) {
+      seen += wait_buckets[i];
+      if (seen >= std::max<std::uint64_t>(rank, 1)) {
+        return std::min(waitBucketBound(i), max_wait);
+      }
+    }
+    return max_wait;
+  }
+};
+
+export struct GroupStats {
+  std::string name;
+  std::uint64_t memory_bytes = 0;
+  std::uint32_t cpu_slots = 0;
+  // By QueryPriority.
+  std::array<ClassStats, kPriorities> classes;
+};
+
+export struct AdmissionStats {
+  std::uint64_t memory_bytes = 0;
+  std::uint32_t cpu_slots = 0;
+  std::vector<GroupStats> groups;
+};
+
+export class AdmissionController;
+
+// The budgets one admitted query holds, given back when the ticket is
+// destroyed.
+export class AdmissionTicket final {
+ public:
+  AdmissionTicket(AdmissionTicket&& other) noexcept = default;
+  AdmissionTicket& operator=(AdmissionTicket&& other) noexcept {
+    if (this != &other) {
+      release();
+      controller_ = std::move(other.controller_);
+      demand_ = std::move(other.demand_);
+      waited_ = other.waited_;
+    }
+    return *this;
+  }
+
+  AdmissionTicket(const AdmissionTicket&) = delete;
+  AdmissionTicket& operator=(const AdmissionTicket&) = delete;
+
+  ~AdmissionTicket() { release(); }
+
+  // Time the query spent queued.
+  [[nodiscard]] std::chrono::nanoseconds waited() const { return waited_; }
+
+ private:
+  friend class AdmissionController;
+
+  AdmissionTicket(std::shared_ptr<AdmissionController> controller,
+                  QueryDemand demand, std::chrono::nanoseconds waited)
+      : controller_(std::move(controller)),
+        demand_(std::move(demand)),
+        waited_(waited) {}
+
+  void release();
+
+  std::shared_ptr<AdmissionController> controller_;
+  QueryDemand demand_;
+  std::chrono::nanoseconds waited_{0};
+};
+
+// Admits queries against a memory budget and a budget of CPU slots, so that
+// under load queries queue instead of starting together and thrashing.
+// Waiting queries are taken interactive first and in arrival order within a
+// priority. A query held up by the global budgets holds up those behind it
+// and all batch queries; one held up only by its group's budgets or the
+// batch share lets the others pass.
+export class AdmissionController final
+    : public std::enable_shared_from_this<AdmissionController> {
+ public:
+  static StatusOr<std::shared_ptr<AdmissionController>> create(
+      AdmissionOptions options) {
+    if (options.memory_bytes == 0 || options.cpu_slots == 0) {
+      return Status::Invalid("admission budgets must not be empty");
+    }
+    const auto valid = [](double fraction) {
+      return fraction > 0 && fraction <= 1;
+    };
+    if (!valid(options.batch_memory_fraction) ||
+        !valid(options.batch_slot_fraction)) {
+      return Status::Invalid("batch fractions must be in (0, 1]");
+    }
+    for (const auto& group : options.groups) {
+      if (group.name.empty() || group.name == kDefaultGroup) {
+        return Status::Invalid("resource group needs a name other than " +
+                               std::string(kDefaultGroup));
+      }
+      if (!valid(group.memory_fraction) || !valid(group.slot_fraction)) {
+        return Status::Invalid("fractions of resource group " + group.name +
+                               " must be in (0, 1]");
+      }
+    }
+    return std::shared_ptr<AdmissionController>(
+        new AdmissionController(std::move(options)));
+  }
+
+  AdmissionController(const AdmissionController&) = delete;
+  AdmissionController& operator=(const AdmissionController&) = delete;
+
+  // Waits until `demand' fits the budgets, at most the queue timeout.
+  StatusOr<AdmissionTicket> admit(QueryDemand demand) {
+    const auto start = std::chrono::steady_clock::now();
+    std::unique_lock lock(mutex_);
+    auto& group = groupOf(demand);
+    demand.group = group.name;
+    auto& stats = group.stats[index(demand.priority)];
+    if (!canEverFit(demand, group)) {
+      ++stats.rejected;
+      return Status::Invalid(
+          "query demand exceeds the budgets of resource group " + group.name);
+    }
+
+    Waiter waiter{.demand = &demand, .group = &group};
+    auto& queue = queues_[index(demand.priority)];
+    queue.push_back(&waiter);
+    ++group.queued;
+    ++stats.queued;
+    dispatch();
+    if (!waiter.granted && group.queued > group.config.max_queued) {
+      dequeue(waiter);
+      ++stats.rejected;
+      return Status::QueryExecutorError("admission queue of resource group " +
+                                        group.name + " is full");
+    }
+    if (!waiter.admitted.wait_for(lock, options_.queue_timeout,
+                                  [&] { return waiter.granted; })) {
+      dequeue(waiter);
+      ++stats.rejected;
+      // Queries behind it may fit now.
+      dispatch();
+      return Status::QueryExecutorError(
+          "query waited for admission longer than " +
+          std::to_string(options_.queue_timeout.count()) + " ms");
+    }
+
+    const auto waited = std::chrono::steady_clock::now() - start;
+    ++stats.admitted;
+    stats.total_wait += waited;
+    stats.max_wait = std::max<std::chrono::nanoseconds>(stats.max_wait, waited);
+    std::size_t bucket = 0;
+    while (bucket + 1 < kWaitBuckets && waited > waitBucketBound(bucket)) {
+      ++bucket;
+    }
+    ++stats.wait_buckets[bucket];
+    return AdmissionTicket(shared_from_this(), std::move(demand), waited);
+  }
+
+  [[nodiscard]] AdmissionStats stats() const {
+    const std::scoped_lock lock(mutex_);
+    AdmissionStats stats{.memory_bytes = used_.memory_bytes,
+                         .cpu_slots = used_.cpu_slots};
+    for (const auto& [name, group] : groups_) {
+      stats.groups.push_back({.name = name,
+                              .memory_bytes = group.used.memory_bytes,
+                              .cpu_slots = group.used.cpu_slots,
+                              .classes = group.stats});
+    }
+    return stats;
+  }
+
+ private:
+  friend class AdmissionTicket;
+
+  struct Usage {
+    std::uint64_t memory_bytes = 0;
+    std::uint32_t cpu_slots = 0;
+  };
+
+  struct Limits {
+    std::uint64_t memory_bytes = 0;
+    std::uint32_t cpu_slots = 0;
+  };
+
+  struct Group {
+    std::string name;
+    ResourceGroupConfig config;
+    Limits limits;
+    Usage used;
+    std::size_t queued = 0;
+    std::array<ClassStats, kPriorities> stats;
+  };
+
+  struct Waiter {
+    QueryDemand* demand;
+    Group* group;
+    std::condition_variable admitted;
+    bool granted = false;
+  };
+
+  enum class Fit : std::uint8_t {
+    kFits,
+    // Over the controller's budgets, which every query shares.
+    kBlocked,
+    // Over budgets only some queries share: the group's or the batch share.
+    kCapped,
+  };
+
+  explicit AdmissionController(AdmissionOptions options)
+      : options_(std::move(options)) {
+    batch_limits_ = share(options_.batch_memory_fraction,
+                          options_.batch_slot_fraction);
+    auto& fallback = groups_[std::string(kDefaultGroup)];
+    fallback.name = kDefaultGroup;
+    fallback.config.name = kDefaultGroup;
+    fallback.limits = share(1, 1);
+    for (const auto& config : options_.groups) {
+      auto& group = groups_[config.name];
+      group.name = config.name;
+      group.config = config;
+      group.limits = share(config.memory_fraction, config.slot_fraction);
+    }
+  }
+
+  static std::size_t index(QueryPriority priority) {
+    return static_cast<std::size_t>(priority);
+  }
+
+  [[nodiscard]] Limits share(double memory, double slots) const {
+    return {
+        .memory_bytes = std::max<std::uint64_t>(
+            1, static_cast<std::uint64_t>(
+                   memory * static_cast<double>(options_.memory_bytes))),
+        .cpu_slots = std::max<std::uint32_t>(
+            1, static_cast<std::uint32_t>(slots * options_.cpu_slots))};
+  }
+
+  Group& groupOf(const QueryDemand& demand) {
+    const auto it = groups_.find(demand.group);
+    return it != groups_.end() ? it->second
+                               : groups_.at(std::string(kDefaultGroup));
+  }
+
+  [[nodiscard]] bool canEverFit(const QueryDemand& demand,
+                                const Group& group) const {
+    auto limits = group.limits;
+    if (demand.priority == QueryPriority::kBatch) {
+      limits.memory_bytes =
+          std::min(limits.memory_bytes, batch_limits_.memory_bytes);
+      limits.cpu_slots = std::min(limits.cpu_slots, batch_limits_.cpu_slots);
+    }
+    return demand.memory_bytes <= limits.memory_bytes &&
+           demand.cpu_slots <= limits.cpu_slots;
+  }
+
+  static bool over(const Usage& used, const QueryDemand& demand,
+                   const Limits& limits) {
+    return used.memory_bytes + demand.memory_bytes > limits.memory_bytes ||
+           used.cpu_slots + demand.cpu_slots > limits.cpu_slots;
+  }
+
+  [[nodiscard]] Fit fit(const QueryDemand& demand, const Group& group) const {
+    if (over(used_, demand,
+             {.memory_bytes = options_.memory_bytes,
+              .cpu_slots = options_.cpu_slots})) {
+      return Fit::kBlocked;
+    }
+    if (over(group.used, demand, group.limits) ||
+        (demand.priority == QueryPriority::kBatch &&
+         over(batch_used_, demand, batch_limits_))) {
+      return Fit::kCapped;
+    }
+    return Fit::kFits;
+  }
+
+  void dequeue(Waiter& waiter) {
+    auto& queue = queues_[index(waiter.demand->priority)];
+    queue.erase(std::find(queue.begin(), queue.end(), &waiter));
+    --waiter.group->queued;
+    --waiter.group->stats[index(waiter.demand->priority)].queued;
+  }
+
+  void grant(Waiter& waiter) {
+    const auto& demand = *waiter.demand;
+    auto& group = *waiter.group;
+    used_.memory_bytes += demand.memory_bytes;
+    used_.cpu_slots += demand.cpu_slots;
+    group.used.memory_bytes += demand.memory_bytes;
+    group.used.cpu_slots += demand.cpu_slots;
+    if (demand.priority == QueryPriority::kBatch) {
+      batch_used_.memory_bytes += demand.memory_bytes;
+      batch_used_.cpu_slots += demand.cpu_slots;
+    }
+    ++group.stats[index(demand.priority)].running;
+    waiter.granted = true;
+  }
+
+  // Admits the waiting queries that fit now. Called with `mutex_' held.
+  void dispatch() {
+    for (auto& queue : queues_) {
+      for (auto it = queue.begin(); it != queue.end();) {
+        auto* waiter = *it;
+        const auto result = fit(*waiter->demand, *waiter->group);
+        if (result == Fit::kBlocked) {
+          return;
+        }
+        if (result == Fit::kCapped) {
+          ++it;
+          continue;
+        }
+        ++it;
+        dequeue(*waiter);
+        grant(*waiter);
+        waiter->admitted.notify_one();
+      }
+    }
+  }
+
+  void release(const QueryDemand& demand) {
+    const std::scoped_lock lock(mutex_);
+    auto& group = groupOf(demand);
+    used_.memory_bytes -= demand.memory_bytes;
+    used_.cpu_slots -= demand.cpu_slots;
+    group.used.memory_bytes -= demand.memory_bytes;
+    group.used.cpu_slots -= demand.cpu_slots;
+    if (demand.priority == QueryPriority::kBatch) {
+      batch_used_.memory_bytes -= demand.memory_bytes;
+      batch_used_.cpu_slots -= demand.cpu_slots;
+    }
+    --group.stats[index(demand.priority)].running;
+    dispatch();
+  }
+
+  const AdmissionOptions options_;
+  Limits batch_limits_;
+
+  mutable std::mutex mutex_;
+  std::map<std::string, Group> groups_;
+  Usage used_;
+  Usage batch_used_;
+  // Waiting queries by priority, in arrival order.
+  std::array<std::list<Waiter*>, kPriorities> queues_;
+};
+
+void AdmissionTicket::release() {
+  if (controller_ != nullptr) {
+    controller_->release(demand_);
+    controller_.reset();
+  }
+}
+
+}  // namespace halo::server::admission
@@ -0,0 +1,170 @@
+module;
+#include <velox/common/memory/Memory.h>
+#include <velox/common/memory/MemoryPool.h>
+#include <velox/type/Type.h>
+
+#include <cctype>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+export module halo.server.admission:AdmittedQueryEngine;
+import halo.common;
+import halo.server.engine;
+import :AdmissionController;
+
+namespace halo::server::admission {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+using halo::server::engine::PlanFingerprint;
+using halo::server::engine::QueryEngine;
+using halo::server::engine::RowVectorSink;
+
+namespace velox = facebook::velox;
+
+// Decides the resource group, priority and CPU slots of a query. The
+// memory demand is filled in from the query's pool afterwards, where the
+// classifier leaves it 0.
+export using QueryClassifier = std::function<QueryDemand(std::string_view)>;
+
+std::string_view trimLeft(std::string_view text) {
+  while (!text.empty() &&
+         std::isspace(static_cast<unsigned char>(text.front())) != 0) {
+    text.remove_prefix(1);
+  }
+  return text;
+}
+
+// Reads a leading hint comment such as
+// `/*+ group=etl priority=batch slots=4 */ SELECT ...'. Queries without one
+// are interactive queries of the default group taking one slot; unknown
+// keys and malformed values are ignored.
+export QueryDemand classifyByHint(std::string_view query) {
+  QueryDemand demand;
+  query = trimLeft(query);
+  if (!query.starts_with("/*+")) {
+    return demand;
+  }
+  const auto end = query.find("*/");
+  if (end == std::string_view::npos) {
+    return demand;
+  }
+  auto hint = query.substr(3, end - 3);
+  while (!(hint = trimLeft(hint)).empty()) {
+    auto size = hint.find_first_of(" \t\r\n");
+    const auto item = hint.substr(0, size);
+    hint.remove_prefix(size == std::string_view::npos ? hint.size() : size);
+    const auto equals = item.find('=');
+    if (equals == std::string_view::npos) {
+      continue;
+    }
+    const auto key = item.substr(0, equals);
+    const auto value = item.substr(equals + 1);
+    if (key == "group" && !value.empty()) {
+      demand.group = std::string(value);
+    } else if (key == "priority") {
+      if (value == "batch") {
+        demand.priority = QueryPriority::kBatch;
+      } else if (value == "interactive") {
+        demand.priority = QueryPriority::kInteractive;
+      }
+    } else if (key == "slots") {
+      std::uint32_t slots = 0;
+      for (const char c : value) {
+        if (std::isdigit(static_cast<unsigned char>(c)) == 0 || slots > 1024) {
+          slots = 0;
+          break;
+        }
+        slots = slots * 10 + static_cast<std::uint32_t>(c - '0');
+      }
+      if (slots > 0) {
+        demand.cpu_slots = slots;
+      }
+    }
+  }
+  return demand;
+}
+
+export struct AdmittedQueryEngineOptions {
+  QueryClassifier classifier = classifyByHint;
+  // Memory demand of queries whose pool has no capacity of its own.
+  std::uint64_t default_memory_bytes = 1ULL << 30;
+};
+
+// Runs every query of `engine' through an admission controller: a query
+// waits until its group and priority have room for its memory, which is
+// the capacity of the pool it runs in, and its CPU slots. The front ends
+// take it in place of the engine it wraps.
+export class AdmittedQueryEngine final : public QueryEngine {
+ public:
+  static StatusOr<std::shared_ptr<AdmittedQueryEngine>> create(
+      std::shared_ptr<QueryEngine> engine,
+      std::shared_ptr<AdmissionController> controller,
+      AdmittedQueryEngineOptions options = {}) {
+    if (engine == nullptr || controller == nullptr) {
+      return Status::Invalid(
+          "admitted query engine needs an engine and a controller");
+    }
+    if (!options.classifier) {
+      return Status::Invalid("admitted query engine needs a classifier");
+    }
+    return std::shared_ptr<AdmittedQueryEngine>(new AdmittedQueryEngine(
+        std::move(engine), std::move(controller), std::move(options)));
+  }
+
+  // Planning is cheap next to running and goes unadmitted.
+  StatusOr<velox::RowTypePtr> describe(const std::string& query) override {
+    return engine_->describe(query);
+  }
+
+  Status execute(const std::string& query, velox::memory::MemoryPool* pool,
+                 const RowVectorSink& sink) override {
+    auto demand = options_.classifier(query);
+    if (demand.memory_bytes == 0) {
+      demand.memory_bytes = memoryDemand(pool);
+    }
+    auto ticket = controller_->admit(std::move(demand));
+    if (!ticket.ok()) {
+      return ticket.status();
+    }
+    return engine_->execute(query, pool, sink);
+  }
+
+  std::optional<PlanFingerprint> fingerprint(
+      const std::string& query) override {
+    return engine_->fingerprint(query);
+  }
+
+  [[nodiscard]] const std::shared_ptr<AdmissionController>& controller()
+      const {
+    return controller_;
+  }
+
+ private:
+  AdmittedQueryEngine(std::shared_ptr<QueryEngine> engine,
+                      std::shared_ptr<AdmissionController> controller,
+                      AdmittedQueryEngineOptions options)
+      : engine_(std::move(engine)),
+        controller_(std::move(controller)),
+        options_(std::move(options)) {}
+
+  [[nodiscard]] std::uint64_t memoryDemand(
+      velox::memory::MemoryPool* pool) const {
+    const auto capacity = pool == nullptr ? velox::memory::kMaxMemory
+                                          : pool->root()->maxCapacity();
+    return capacity <= 0 || capacity == velox::memory::kMaxMemory
+               ? options_.default_memory_bytes
+               : static_cast<std::uint64_t>(capacity);
+  }
+
+  const std::shared_ptr<QueryEngine> engine_;
+  const std::shared_ptr<AdmissionController> controller_;
+  const AdmittedQueryEngineOptions options_;
+};
+
+}  // namespace halo::server::admission
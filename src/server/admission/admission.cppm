@@ -0,0 +1,3 @@
+export module halo.server.admission;
+export import :AdmissionController;
+export import :AdmittedQueryEngine;
@@ -0,0 +1,267 @@
+module;
+#include <arrow/buffer.h>
+#include <arrow/c/abi.h>
+#include <arrow/c/bridge.h>
+#include <arrow/io/memory.h>
+#include <arrow/ipc/options.h>
+#include <arrow/ipc/reader.h>
+#include <arrow/ipc/writer.h>
+#include <arrow/record_batch.h>
+#include <arrow/util/compression.h>
+#include <velox/common/memory/MemoryPool.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/arrow/Bridge.h>
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+export module halo.server.cache:CachingQueryEngine;
+import halo.common;
+import halo.server.engine;
+import halo.server.flight;
+import :ResultCache;
+
+namespace halo::server::cache {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+using halo::server::engine::PlanFingerprint;
+using halo::server::engine::QueryEngine;
+using halo::server::engine::RowVectorSink;
+
+namespace velox = facebook::velox;
+
+export struct CachingQueryEngineOptions {
+  // Codec of the cached IPC buffers. LZ4 is used where the Arrow build
+  // lacks it, and no compression where it lacks both.
+  arrow::Compression::type compression = arrow::Compression::ZSTD;
+};
+
+// Writes the batches of one result into a compressed Arrow IPC stream.
+// Gives up, without failing the query, once the stream outgrows
+// `max_bytes' or a batch cannot be converted.
+class ResultRecorder final {
+ public:
+  ResultRecorder(std::shared_ptr<arrow::util::Codec> codec,
+                 std::uint64_t max_bytes, velox::memory::MemoryPool* pool)
+      : codec_(std::move(codec)), max_bytes_(max_bytes), pool_(pool) {}
+
+  void add(const velox::RowVectorPtr& batch) {
+    if (abandoned_ || batch->size() == 0) {
+      return;
+    }
+    if (writer_ == nullptr && !start(batch)) {
+      abandoned_ = true;
+      return;
+    }
+    auto record_batch = exporter_->exportBatch(batch);
+    if (!record_batch.ok() ||
+        !writer_->WriteRecordBatch(**record_batch).ok()) {
+      abandoned_ = true;
+      return;
+    }
+    rows_ += batch->size();
+    const auto written = output_->Tell();
+    abandoned_ = !written.ok() || static_cast<std::uint64_t>(*written) >
+                                      max_bytes_;
+  }
+
+  // The recorded stream, or nullopt if recording gave up.
+  std::optional<CachedResult> finish(std::chrono::nanoseconds cost) {
+    if (abandoned_) {
+      return std::nullopt;
+    }
+    if (writer_ == nullptr) {
+      // No rows: a hit replays nothing.
+      return CachedResult{.ipc = arrow::Buffer::FromString(std::string()),
+                          .cost = cost};
+    }
+    if (!writer_->Close().ok()) {
+      return std::nullopt;
+    }
+    auto buffer = output_->Finish();
+    if (!buffer.ok()) {
+      return std::nullopt;
+    }
+    return CachedResult{
+        .ipc = std::move(buffer).ValueUnsafe(), .rows = rows_, .cost = cost};
+  }
+
+ private:
+  bool start(const velox::RowVectorPtr& batch) {
+    auto exporter = flight::ArrowExporter::create(
+        velox::asRowType(batch->type()), false, pool_);
+    if (!exporter.ok()) {
+      return false;
+    }
+    exporter_.emplace(std::move(exporter).value());
+    auto output = arrow::io::BufferOutputStream::Create();
+    if (!output.ok()) {
+      return false;
+    }
+    output_ = std::move(output).ValueUnsafe();
+    auto options = arrow::ipc::IpcWriteOptions::Defaults();
+    options.codec = codec_;
+    auto writer =
+        arrow::ipc::MakeStreamWriter(output_, exporter_->schema(), options);
+    if (!writer.ok()) {
+      return false;
+    }
+    writer_ = std::move(writer).ValueUnsafe();
+    return true;
+  }
+
+  const std::shared_ptr<arrow::util::Codec> codec_;
+  const std::uint64_t max_bytes_;
+  velox::memory::MemoryPool* const pool_;
+  std::optional<flight::ArrowExporter> exporter_;
+  std::shared_ptr<arrow::io::BufferOutputStream> output_;
+  std::shared_ptr<arrow::ipc::RecordBatchWriter> writer_;
+  std::int64_t rows_ = 0;
+  bool abandoned_ = false;
+};
+
+// Streams a cached result to `sink' as Velox vectors imported from the
+// Arrow buffers, without running the query.
+Status replay(const CachedResult& result, velox::memory::MemoryPool* pool,
+              const RowVectorSink& sink) {
+  if (result.ipc->size() == 0) {
+    return Status::OK();
+  }
+  auto input = std::make_shared<arrow::io::BufferReader>(result.ipc);
+  auto reader = arrow::ipc::RecordBatchStreamReader::Open(input);
+  if (!reader.ok()) {
+    return flight::fromArrow(reader.status());
+  }
+  while (true) {
+    std::shared_ptr<arrow::RecordBatch> batch;
+    if (const auto read = (*reader)->ReadNext(&batch); !read.ok()) {
+      return flight::fromArrow(read);
+    }
+    if (batch == nullptr) {
+      return Status::OK();
+    }
+    ArrowSchema c_schema;
+    ArrowArray c_array;
+    if (const auto exported =
+            arrow::ExportRecordBatch(*batch, &c_array, &c_schema);
+        !exported.ok()) {
+      return flight::fromArrow(exported);
+    }
+    velox::RowVectorPtr rows;
+    try {
+      // Takes ownership of both C structures.
+      rows = std::dynamic_pointer_cast<velox::RowVector>(
+          velox::importFromArrowAsOwner(c_schema, c_array, pool));
+    } catch (const std::exception& e) {
+      return Status::QueryExecutorError(
+          std::string("cannot import cached batch: ") + e.what());
+    }
+    if (rows == nullptr) {
+      return Status::QueryExecutorError("cached batch is not a row vector");
+    }
+    if (auto status = sink(std::move(rows)); !status.ok()) {
+      return status;
+    }
+  }
+}
+
+// Serves repeated queries from a result cache. A query the engine gives a
+// plan fingerprint for is looked up under that fingerprint and the current
+// versions of its tables; on a miss it runs, and its result is recorded on
+// the way to the client and cached once it completes.
+export class CachingQueryEngine final : public QueryEngine {
+ public:
+  static StatusOr<std::shared_ptr<CachingQueryEngine>> create(
+      std::shared_ptr<QueryEngine> engine, std::shared_ptr<ResultCache> cache,
+      const CachingQueryEngineOptions& options = {}) {
+    if (engine == nullptr || cache == nullptr) {
+      return Status::Invalid(
+          "caching query engine needs an engine and a cache");
+    }
+    std::shared_ptr<arrow::util::Codec> codec;
+    for (const auto type :
+         {options.compression, arrow::Compression::LZ4_FRAME}) {
+      if (type == arrow::Compression::UNCOMPRESSED) {
+        break;
+      }
+      if (!arrow::util::Codec::IsAvailable(type)) {
+        continue;
+      }
+      if (auto created = arrow::util::Codec::Create(type); created.ok()) {
+        codec = std::move(created).ValueUnsafe();
+        break;
+      }
+    }
+    return std::shared_ptr<CachingQueryEngine>(new CachingQueryEngine(
+        std::move(engine), std::move(cache), std::move(codec)));
+  }
+
+  StatusOr<velox::RowTypePtr> describe(const std::string& query) override {
+    return engine_->describe(query);
+  }
+
+  std::optional<PlanFingerprint> fingerprint(
+      const std::string& query) override {
+    return engine_->fingerprint(query);
+  }
+
+  Status execute(const std::string& query, velox::memory::MemoryPool* pool,
+                 const RowVectorSink& sink) override {
+    const auto plan = engine_->fingerprint(query);
+    if (!plan.has_value()) {
+      return engine_->execute(query, pool, sink);
+    }
+    const auto versions = cache_->versions()->versions(plan->tables);
+    const auto key = ResultCache::key(*plan, versions);
+    if (auto hit = cache_->lookup(key)) {
+      const auto start = std::chrono::steady_clock::now();
+      auto status = replay(*hit, pool, sink);
+      if (status.ok()) {
+        cache_->recordServed(hit->cost,
+                             std::chrono::steady_clock::now() - start);
+      }
+      return status;
+    }
+
+    ResultRecorder recorder(codec_, cache_->options().max_entry_bytes, pool);
+    const auto start = std::chrono::steady_clock::now();
+    auto status = engine_->execute(
+        query, pool, [&](velox::RowVectorPtr batch) -> Status {
+          recorder.add(batch);
+          return sink(std::move(batch));
+        });
+    if (status.ok()) {
+      if (auto result =
+              recorder.finish(std::chrono::steady_clock::now() - start)) {
+        cache_->insert(key, plan->tables, versions, std::move(*result));
+      }
+    }
+    return status;
+  }
+
+  [[nodiscard]] const std::shared_ptr<ResultCache>& cache() const {
+    return cache_;
+  }
+
+ private:
+  CachingQueryEngine(std::shared_ptr<QueryEngine> engine,
+                     std::shared_ptr<ResultCache> cache,
+                     std::shared_ptr<arrow::util::Codec> codec)
+      : engine_(std::move(engine)),
+        cache_(std::move(cache)),
+        codec_(std::move(codec)) {}
+
+  const std::shared_ptr<QueryEngine> engine_;
+  const std::shared_ptr<ResultCache> cache_;
+  // Null for uncompressed buffers.
+  const std::shared_ptr<arrow::util::Codec> codec_;
+};
+
+}  // namespace halo::server::cache
@@ -0,0 +1,459 @@
+module;
+#include <arrow/buffer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+export module halo.server.cache:ResultCache;
+import halo.common;
+import halo.exec.hash;
+import halo.server.engine;
+import :TableVersions;
+
+namespace halo::server::cache {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+using halo::server::engine::PlanFingerprint;
+
+export enum class EvictionPolicy : std::uint8_t {
+  // Least recently used first.
+  kLru,
+  // Least often used first, least recently used among equals. Keeps the
+  // dashboard queries that come back every few seconds over one-off ones.
+  kLfu,
+};
+
+export struct ResultCacheOptions {
+  // Compressed results kept in memory.
+  std::uint64_t memory_bytes = 1ULL << 30;
+  // Directory of a second tier that results evicted from memory move to;
+  // empty for none. Files left in it by an earlier process are not reused.
+  std::string disk_directory;
+  std::uint64_t disk_bytes = 16ULL << 30;
+  // Results larger than this compressed are not cached.
+  std::uint64_t max_entry_bytes = 64ULL << 20;
+  EvictionPolicy policy = EvictionPolicy::kLru;
+};
+
+// A finished result as one compressed Arrow IPC stream.
+export struct CachedResult {
+  std::shared_ptr<arrow::Buffer> ipc;
+  std::int64_t rows = 0;
+  // How long the query took to run, which a hit saves.
+  std::chrono::nanoseconds cost{0};
+};
+
+export struct ResultCacheStats {
+  std::uint64_t hits = 0;
+  // Hits served from the disk tier, included in `hits'.
+  std::uint64_t disk_hits = 0;
+  std::uint64_t misses = 0;
+  std::uint64_t inserts = 0;
+  // Entries moved from memory to disk, and entries dropped for room.
+  std::uint64_t demotions = 0;
+  std::uint64_t evictions = 0;
+  // Entries dropped because a table they read was written.
+  std::uint64_t invalidations = 0;
+  std::uint64_t entries = 0;
+  std::uint64_t memory_bytes = 0;
+  std::uint64_t disk_bytes = 0;
+  // Run time of the queries served from the cache less the time serving
+  // them took.
+  std::chrono::nanoseconds saved{0};
+
+  [[nodiscard]] double hitRatio() const {
+    const auto lookups = hits + misses;
+    return lookups == 0 ? 0
+                        : static_cast<double>(hits) /
+                              static_cast<double>(lookups);
+  }
+};
+
+// Finished query results by plan fingerprint and the versions of the
+// tables the plan read. A write to a table drops every entry that read it.
+// Memory and disk are each capped, evicting by the configured policy; what
+// leaves memory moves to disk if there is a disk tier and it fits. Files
+// of the disk tier are read and written outside the cache's lock.
+export class ResultCache final
+    : public std::enable_shared_from_this<ResultCache> {
+ public:
+  static StatusOr<std::shared_ptr<ResultCache>> create(
+      ResultCacheOptions options, std::shared_ptr<TableVersions> versions) {
+    if (versions == nullptr) {
+      return Status::Invalid("result cache needs table versions");
+    }
+    if (!options.disk_directory.empty()) {
+      std::error_code error;
+      std::filesystem::create_directories(options.disk_directory, error);
+      if (error) {
+        return Status::StorageError("cannot create " +
+                                    options.disk_directory + ": " +
+                                    error.message());
+      }
+    }
+    std::shared_ptr<ResultCache> cache(
+        new ResultCache(std::move(options), std::move(versions)));
+    std::weak_ptr<ResultCache> weak = cache;
+    cache->subscription_ =
+        cache->versions_->subscribe([weak](const std::string& table) {
+          if (auto alive = weak.lock()) {
+            alive->invalidate(table);
+          }
+        });
+    return cache;
+  }
+
+  ResultCache(const ResultCache&) = delete;
+  ResultCache& operator=(const ResultCache&) = delete;
+
+  ~ResultCache() {
+    versions_->unsubscribe(subscription_);
+    for (const auto& [key, entry] : entries_) {
+      if (entry.on_disk) {
+        std::error_code ignored;
+        std::filesystem::remove(entry.file, ignored);
+      }
+    }
+  }
+
+  [[nodiscard]] const std::shared_ptr<TableVersions>& versions() const {
+    return versions_;
+  }
+
+  [[nodiscard]] const ResultCacheOptions& options() const { return options_; }
+
+  // The key of `fingerprint' over its tables at `versions', which are in
+  // the order of `fingerprint.tables'.
+  static std::string key(const PlanFingerprint& fingerprint,
+                         const std::vector<std::uint64_t>& versions) {
+    std::vector<std::pair<std::string, std::uint64_t>> tables;
+    for (std::size_t i = 0; i < fingerprint.tables.size(); ++i) {
+      tables.emplace_back(fingerprint.tables[i], versions.at(i));
+    }
+    std::sort(tables.begin(), tables.end());
+    std::ostringstream key;
+    key << std::hex << fingerprint.hash << std::dec;
+    for (const auto& [table, version] : tables) {
+      key << '|' << table << '@' << version;
+    }
+    return key.str();
+  }
+
+  std::optional<CachedResult> lookup(const std::string& key) {
+    Entry taken;
+    {
+      const std::scoped_lock lock(mutex_);
+      const auto it = entries_.find(key);
+      if (it == entries_.end()) {
+        ++stats_.misses;
+        return std::nullopt;
+      }
+      auto& entry = it->second;
+      if (!entry.on_disk) {
+        unrank(entry);
+        ++entry.hits;
+        entry.last_used = ++clock_;
+        rank(entry);
+        ++stats_.hits;
+        return entry.result;
+      }
+      // Read without `mutex_'; lookups of `key' miss until it is back.
+      taken = detach(it);
+    }
+    auto ipc = readFile(taken.file);
+    std::error_code ignored;
+    std::filesystem::remove(taken.file, ignored);
+
+    Pending pending;
+    std::optional<CachedResult> result;
+    {
+      const std::scoped_lock lock(mutex_);
+      if (!ipc.ok()) {
+        ++stats_.misses;
+        return std::nullopt;
+      }
+      ++stats_.hits;
+      ++stats_.disk_hits;
+      taken.result.ipc = std::move(ipc).value();
+      taken.on_disk = false;
+      result = taken.result;
+      // Back into memory, unless one of its tables was written or `key'
+      // inserted again while the file was read.
+      if (versions_->versions(taken.tables) == taken.versions &&
+          !entries_.contains(key)) {
+        ++taken.hits;
+        taken.last_used = ++clock_;
+        makeRoomInMemory(taken.bytes, pending);
+        place(std::move(taken));
+      }
+    }
+    settle(std::move(pending));
+    return result;
+  }
+
+  // Stores `result' of a plan reading `tables' at `versions' under `key',
+  // unless one of the tables has been written since.
+  void insert(const std::string& key, const std::vector<std::string>& tables,
+              const std::vector<std::uint64_t>& versions,
+              CachedResult result) {
+    const auto bytes = static_cast<std::uint64_t>(result.ipc->size());
+    if (bytes > options_.max_entry_bytes || bytes > options_.memory_bytes) {
+      return;
+    }
+    Pending pending;
+    {
+      const std::scoped_lock lock(mutex_);
+      // Under `mutex_', so that a write racing with this insert either
+      // shows up here or finds the entry to invalidate.
+      if (versions_->versions(tables) != versions) {
+        return;
+      }
+      if (const auto it = entries_.find(key); it != entries_.end()) {
+        remove(it, pending);
+      }
+      makeRoomInMemory(bytes, pending);
+      Entry entry;
+      entry.key = key;
+      entry.tables = tables;
+      entry.versions = versions;
+      entry.result = std::move(result);
+      entry.bytes = bytes;
+      entry.last_used = ++clock_;
+      place(std::move(entry));
+      ++stats_.inserts;
+    }
+    settle(std::move(pending));
+  }
+
+  // Records a hit that took `served' to stream back.
+  void recordServed(std::chrono::nanoseconds cost,
+                    std::chrono::nanoseconds served) {
+    const std::scoped_lock lock(mutex_);
+    stats_.saved += std::max(cost - served, std::chrono::nanoseconds(0));
+  }
+
+  [[nodiscard]] ResultCacheStats stats() const {
+    const std::scoped_lock lock(mutex_);
+    auto stats = stats_;
+    stats.entries = entries_.size();
+    return stats;
+  }
+
+ private:
+  // Eviction order: the first element goes first.
+  using Rank = std::tuple<std::uint64_t, std::uint64_t, std::string>;
+
+  struct Entry {
+    std::string key;
+    std::vector<std::string> tables;
+    // Of `tables' when the result was inserted.
+    std::vector<std::uint64_t> versions;
+    // `result.ipc' is null while the entry is on disk.
+    CachedResult result;
+    std::filesystem::path file;
+    std::uint64_t bytes = 0;
+    std::uint64_t hits = 0;
+    std::uint64_t last_used = 0;
+    bool on_disk = false;
+  };
+
+  // Keys are long, mostly alike strings, which xxh3 gets through faster
+  // than std::hash.
+  using Entries = std::unordered_map<std::string, Entry,
+                                     exec::hash::StringHash, std::equal_to<>>;
+
+  // File I/O a change made under `mutex_' leaves for after it is released:
+  // entries leaving memory for the disk tier, with their files named, and
+  // files of entries dropped from it.
+  struct Pending {
+    std::vector<Entry> demoted;
+    std::vector<std::filesystem::path> unlinked;
+  };
+
+  ResultCache(ResultCacheOptions options,
+              std::shared_ptr<TableVersions> versions)
+      : options_(std::move(options)), versions_(std::move(versions)) {}
+
+  [[nodiscard]] Rank rankOf(const Entry& entry) const {
+    return {options_.policy == EvictionPolicy::kLfu ? entry.hits : 0,
+            entry.last_used, entry.key};
+  }
+
+  void rank(const Entry& entry) {
+    (entry.on_disk ? disk_order_ : memory_order_).insert(rankOf(entry));
+  }
+
+  void unrank(const Entry& entry) {
+    (entry.on_disk ? disk_order_ : memory_order_).erase(rankOf(entry));
+  }
+
+  // Takes the entry at `it' out of the cache, leaving its file, if any.
+  Entry detach(Entries::iterator it) {
+    auto entry = std::move(it->second);
+    entries_.erase(it);
+    unrank(entry);
+    (entry.on_disk ? stats_.disk_bytes : stats_.memory_bytes) -= entry.bytes;
+    for (const auto& table : entry.tables) {
+      const auto keys = by_table_.find(table);
+      if (keys != by_table_.end()) {
+        keys->second.erase(entry.key);
+        if (keys->second.empty()) {
+          by_table_.erase(keys);
+        }
+      }
+    }
+    return entry;
+  }
+
+  void place(Entry entry) {
+    for (const auto& table : entry.tables) {
+      by_table_[table].insert(entry.key);
+    }
+    (entry.on_disk ? stats_.disk_bytes : stats_.memory_bytes) += entry.bytes;
+    auto key = entry.key;
+    rank(entries_[std::move(key)] = std::move(entry));
+  }
+
+  void remove(Entries::iterator it, Pending& pending) {
+    auto entry = detach(it);
+    if (entry.on_disk) {
+      pending.unlinked.push_back(std::move(entry.file));
+    }
+  }
+
+  void invalidate(const std::string& table) {
+    Pending pending;
+    {
+      const std::scoped_lock lock(mutex_);
+      const auto keys = by_table_.find(table);
+      if (keys == by_table_.end()) {
+        return;
+      }
+      const auto stale = keys->second;
+      for (const auto& key : stale) {
+        if (const auto it = entries_.find(key); it != entries_.end()) {
+          remove(it, pending);
+          ++stats_.invalidations;
+        }
+      }
+    }
+    settle(std::move(pending));
+  }
+
+  // Entries the disk tier can take leave memory through `pending', the
+  // others are dropped.
+  void makeRoomInMemory(std::uint64_t bytes, Pending& pending) {
+    while (stats_.memory_bytes + bytes > options_.memory_bytes &&
+           !memory_order_.empty()) {
+      const auto it = entries_.find(std::get<2>(*memory_order_.begin()));
+      if (options_.disk_directory.empty() ||
+          it->second.bytes > options_.disk_bytes) {
+        remove(it, pending);
+        ++stats_.evictions;
+        continue;
+      }
+      auto entry = detach(it);
+      entry.file = std::filesystem::path(options_.disk_directory) /
+                   ("result_" + std::to_string(next_file_++) + ".arrows");
+      pending.demoted.push_back(std::move(entry));
+    }
+  }
+
+  void makeRoomOnDisk(std::uint64_t bytes, Pending& pending) {
+    while (stats_.disk_bytes + bytes > options_.disk_bytes &&
+           !disk_order_.empty()) {
+      remove(entries_.find(std::get<2>(*disk_order_.begin())), pending);
+      ++stats_.evictions;
+    }
+  }
+
+  // Does the I/O of `pending' without `mutex_': writes each demoted entry
+  // and, unless one of its tables was written or its key inserted again
+  // meanwhile, puts it back on disk; then removes the files to go.
+  void settle(Pending pending) {
+    for (auto& entry : pending.demoted) {
+      const bool written = writeFile(entry.file, *entry.result.ipc);
+      const std::scoped_lock lock(mutex_);
+      if (!written ||
+          versions_->versions(entry.tables) != entry.versions ||
+          entries_.contains(entry.key)) {
+        if (written) {
+          pending.unlinked.push_back(std::move(entry.file));
+        }
+        ++stats_.evictions;
+        continue;
+      }
+      makeRoomOnDisk(entry.bytes, pending);
+      entry.result.ipc.reset();
+      entry.on_disk = true;
+      place(std::move(entry));
+      ++stats_.demotions;
+    }
+    for (const auto& file : pending.unlinked) {
+      std::error_code ignored;
+      std::filesystem::remove(file, ignored);
+    }
+  }
+
+  static bool writeFile(const std::filesystem::path& file,
+                        const arrow::Buffer& ipc) {
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(ipc.data()),
+              static_cast<std::streamsize>(ipc.size()));
+    out.close();
+    if (!out) {
+      std::error_code ignored;
+      std::filesystem::remove(file, ignored);
+      return false;
+    }
+    return true;
+  }
+
+  static StatusOr<std::shared_ptr<arrow::Buffer>> readFile(
+      const std::filesystem::path& file) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+      return Status::StorageError("cannot open " + file.string());
+    }
+    std::string bytes((std::istreambuf_iterator<char>(in)),
+                      std::istreambuf_iterator<char>());
+    if (in.bad()) {
+      return Status::StorageError("cannot read " + file.string());
+    }
+    return std::shared_ptr<arrow::Buffer>(
+        arrow::Buffer::FromString(std::move(bytes)));
+  }
+
+  const ResultCacheOptions options_;
+  const std::shared_ptr<TableVersions> versions_;
+  std::uint64_t subscription_ = 0;
+
+  mutable std::mutex mutex_;
+  Entries entries_;
+  std::map<std::string, std::set<std::string>> by_table_;
+  std::set<Rank> memory_order_;
+  std::set<Rank> disk_order_;
+  std::uint64_t clock_ = 0;
+  std::uint64_t next_file_ = 0;
+  ResultCacheStats stats_;
+};
+
+}  // namespace halo::server::cache
@@ -0,0 +1,91 @@
+module;
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+export module halo.server.cache:TableVersions;
+
+namespace halo::server::cache {
+
+// Called with the name of a table that was written.
+export using TableListener = std::function<void(const std::string&)>;
+
+// Version counters of tables, which writers advance after every change so
+// that cached results of the old contents are no longer used. A table
+// never written has version 0.
+export class TableVersions final {
+ public:
+  static std::shared_ptr<TableVersions> create() {
+    return std::shared_ptr<TableVersions>(new TableVersions());
+  }
+
+  TableVersions(const TableVersions&) = delete;
+  TableVersions& operator=(const TableVersions&) = delete;
+
+  [[nodiscard]] std::uint64_t version(const std::string& table) const {
+    const std::scoped_lock lock(mutex_);
+    const auto it = versions_.find(table);
+    return it == versions_.end() ? 0 : it->second;
+  }
+
+  // Versions of `tables', in the same order.
+  [[nodiscard]] std::vector<std::uint64_t> versions(
+      const std::vector<std::string>& tables) const {
+    const std::scoped_lock lock(mutex_);
+    std::vector<std::uint64_t> result;
+    result.reserve(tables.size());
+    for (const auto& table : tables) {
+      const auto it = versions_.find(table);
+      result.push_back(it == versions_.end() ? 0 : it->second);
+    }
+    return result;
+  }
+
+  // Records a write of `table' once it is visible to readers, and tells
+  // the listeners. Returns the new version.
+  std::uint64_t bump(const std::string& table) {
+    std::vector<TableListener> listeners;
+    std::uint64_t version = 0;
+    {
+      const std::scoped_lock lock(mutex_);
+      version = ++versions_[table];
+      listeners.reserve(listeners_.size());
+      for (const auto& [id, listener] : listeners_) {
+        listeners.push_back(listener);
+      }
+    }
+    for (const auto& listener : listeners) {
+      listener(table);
+    }
+    return version;
+  }
+
+  // Calls `listener' after every bump until `unsubscribe' with the id
+  // returned. Listeners run on the writer's thread and must not bump.
+  std::uint64_t subscribe(TableListener listener) {
+    const std::scoped_lock lock(mutex_);
+    const auto id = next_listener_++;
+    listeners_.emplace(id, std::move(listener));
+    return id;
+  }
+
+  void unsubscribe(std::uint64_t id) {
+    const std::scoped_lock lock(mutex_);
+    listeners_.erase(id);
+  }
+
+ private:
+  TableVersions() = default;
+
+  mutable std::mutex mutex_;
+  std::map<std::string, std::uint64_t> versions_;
+  std::map<std::uint64_t, TableListener> listeners_;
+  std::uint64_t next_listener_ = 0;
+};
+
+}  // namespace halo::server::cache
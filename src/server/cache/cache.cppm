@@ -0,0 +1,4 @@
+export module halo.server.cache;
+export import :CachingQueryEngine;
+export import :ResultCache;
+export import :TableVersions;
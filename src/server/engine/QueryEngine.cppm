@@ -0,0 +1,60 @@
+module;
+#include <velox/common/memory/MemoryPool.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+export module halo.server.engine:QueryEngine;
+import halo.common;
+
+namespace halo::server::engine {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+namespace velox = facebook::velox;
+
+// Receives result batches in order. A non-OK status stops the query.
+export using RowVectorSink = std::function<Status(velox::RowVectorPtr)>;
+
+// Identifies the result of a query for as long as the tables it reads do
+// not change.
+export struct PlanFingerprint {
+  // Hash of the optimized plan, literals and session settings that shape
+  // the result included.
+  std::uint64_t hash = 0;
+  // Tables the plan reads.
+  std::vector<std::string> tables;
+};
+
+// What the network front ends need from the planner and executor.
+// Implementations must be safe to call from several streams at once.
+export class QueryEngine {
+ public:
+  virtual ~QueryEngine() = default;
+
+  // Result type of `query' without running it.
+  virtual StatusOr<velox::RowTypePtr> describe(const std::string& query) = 0;
+
+  // Runs `query', allocating from `pool' and handing every batch to `sink'.
+  // A non-OK sink status must end execution and be returned. Allocations
+  // beyond the pool's capacity throw.
+  virtual Status execute(const std::string& query,
+                         velox::memory::MemoryPool* pool,
+                         const RowVectorSink& sink) = 0;
+
+  // Fingerprint of the plan of `query' for caching its result, or nullopt
+  // if its result must not be reused, as for writes and non-deterministic
+  // functions. Engines without a planner to ask cache nothing.
+  virtual std::optional<PlanFingerprint> fingerprint(
+      const std::string& /*query*/) {
+    return std::nullopt;
+  }
+};
+
+}  // namespace halo::server::engine
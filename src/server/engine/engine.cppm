@@ -0,0 +1,2 @@
+export module halo.server.engine;
+export import :QueryEngine;
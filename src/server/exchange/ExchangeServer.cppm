@@ -0,0 +1,187 @@
+module;
+#include <folly/ScopeGuard.h>
+#include <folly/coro/AsyncGenerator.h>
+#include <halo/server/exchange/gen-cpp2/ExchangeService.h>
+#include <thrift/lib/cpp2/async/ServerStream.h>
+#include <thrift/lib/cpp2/server/ThriftServer.h>
+#include <thrift/lib/cpp2/util/ScopedServerInterfaceThread.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+export module halo.server.exchange:ExchangeServer;
+import halo.common;
+import :ExchangeSink;
+import :PageCodec;
+import :PageQueue;
+import :QuicTransport;
+
+namespace halo::server::exchange {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+namespace velox = facebook::velox;
+
+wire::ExchangeError exchangeError(const Status& status) {
+  wire::ExchangeError error;
+  error.message() = status.message();
+  return error;
+}
+
+class ExchangeHandler final
+    : public apache::thrift::ServiceHandler<wire::ExchangeService> {
+ public:
+  explicit ExchangeHandler(std::shared_ptr<SinkRegistry> registry)
+      : registry_(std::move(registry)) {}
+
+  apache::thrift::ServerStream<wire::Page> fetch(
+      std::unique_ptr<wire::FetchRequest> request) override {
+    auto queue = registry_->take(*request->exchange_id(),
+                                 *request->partition());
+    if (!queue.ok()) {
+      throw exchangeError(queue.status());
+    }
+    return pages(std::move(queue).value());
+  }
+
+ private:
+  // Rocket pulls from the generator only while the client has credit left,
+  // so a consumer that falls behind leaves pages in `queue', and a full
+  // queue in turn holds back the sink.
+  static folly::coro::AsyncGenerator<wire::Page&&> pages(
+      std::shared_ptr<PageQueue> queue) {
+    // Releases the producer if the client goes away mid-stream.
+    SCOPE_EXIT {
+      queue->cancel();
+    };
+    while (auto page = co_await queue->pop()) {
+      wire::Page out;
+      out.data() = std::move(page->data);
+      out.rows() = page->rows;
+      out.compression() = static_cast<std::int32_t>(page->compression);
+      co_yield std::move(out);
+    }
+    const auto status = queue->status();
+    if (!status.ok()) {
+      throw exchangeError(status);
+    }
+  }
+
+  const std::shared_ptr<SinkRegistry> registry_;
+};
+
+export struct ExchangeServerOptions {
+  std::string host = "0.0.0.0";
+  // 0 picks a free port, see ExchangeServer::port().
+  std::uint16_t port = 0;
+  std::size_t io_threads = 1;
+  // Threads running the page streams; they only move queued pages.
+  std::size_t worker_threads =
+      std::max(1U, std::thread::hardware_concurrency() / 2);
+  // Also serves the sinks over QUIC, see ExchangeServer::quicPort().
+  bool quic = false;
+  // UDP port of the QUIC listener; 0 picks a free one.
+  std::uint16_t quic_port = 0;
+  // Certificate of the QUIC listener; a self-signed one when empty.
+  TlsIdentity quic_identity;
+};
+
+// Serves the partitions of this worker's exchange sinks to the workers
+// consuming them, over fbthrift Rocket streams (ExchangeService in
+// exchange.thrift) and, with `quic' set, over QUIC streams (see
+// QuicTransport). One server per worker process carries any number of
+// concurrent exchanges; each partition is read once, over either.
+export class ExchangeServer final {
+ public:
+  static StatusOr<std::unique_ptr<ExchangeServer>> start(
+      const ExchangeServerOptions& options) {
+    if (options.io_threads == 0 || options.worker_threads == 0) {
+      return Status::Invalid("thread counts must be positive");
+    }
+    auto registry = std::make_shared<SinkRegistry>();
+    std::unique_ptr<apache::thrift::ScopedServerInterfaceThread> thread;
+    try {
+      thread = std::make_unique<apache::thrift::ScopedServerInterfaceThread>(
+          std::make_shared<ExchangeHandler>(registry), options.host,
+          options.port, [&options](apache::thrift::ThriftServer& server) {
+            server.setNumIOWorkerThreads(options.io_threads);
+            server.setNumCPUWorkerThreads(options.worker_threads);
+          });
+    } catch (const std::exception& e) {
+      return Status::StorageError("cannot start exchange server on " +
+                                  options.host + ":" +
+                                  std::to_string(options.port) + ": " +
+                                  e.what());
+    }
+    std::unique_ptr<QuicPageServer> quic;
+    if (options.quic) {
+      auto started =
+          QuicPageServer::start(registry, options.host, options.quic_port,
+                                options.io_threads, options.quic_identity);
+      if (!started.ok()) {
+        return started.status();
+      }
+      quic = std::move(started).value();
+    }
+    return std::unique_ptr<ExchangeServer>(new ExchangeServer(
+        std::move(registry), std::move(thread), std::move(quic)));
+  }
+
+  ExchangeServer(const ExchangeServer&) = delete;
+  ExchangeServer& operator=(const ExchangeServer&) = delete;
+
+  // Stops serving; streams still open end with an error on the client.
+  ~ExchangeServer() = default;
+
+  // Creates the sink of exchange `exchange_id', whose `partitions'
+  // partitions are served until each has been fetched once. Consumers
+  // fetching before the sink exists are refused, so workers create their
+  // sinks before the consuming side starts.
+  StatusOr<std::shared_ptr<ExchangeSink>> createSink(
+      const std::string& exchange_id, velox::RowTypePtr row_type,
+      std::vector<velox::column_index_t> keys, std::size_t partitions,
+      const ExchangeSinkOptions& options, velox::memory::MemoryPool* pool) {
+    auto sink = ExchangeSink::create(std::move(row_type), std::move(keys),
+                                     partitions, options, pool);
+    if (!sink.ok()) {
+      return sink.status();
+    }
+    auto status = registry_->add(exchange_id, *sink);
+    if (!status.ok()) {
+      return status;
+    }
+    return sink;
+  }
+
+  [[nodiscard]] std::uint16_t port() const { return thread_->getPort(); }
+
+  // UDP port of the QUIC listener; 0 without one.
+  [[nodiscard]] std::uint16_t quicPort() const {
+    return quic_ == nullptr ? 0 : quic_->port();
+  }
+
+ private:
+  ExchangeServer(
+      std::shared_ptr<SinkRegistry> registry,
+      std::unique_ptr<apache::thrift::ScopedServerInterfaceThread> thread,
+      std::unique_ptr<QuicPageServer> quic)
+      : registry_(std::move(registry)),
+        thread_(std::move(thread)),
+        quic_(std::move(quic)) {}
+
+  std::shared_ptr<SinkRegistry> registry_;
+  std::unique_ptr<apache::thrift::ScopedServerInterfaceThread> thread_;
+  std::unique_ptr<QuicPageServer> quic_;
+};
+
+}  // namespace halo::server::exchange
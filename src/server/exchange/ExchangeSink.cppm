@@ -0,0 +1,280 @@
+module;
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/BaseVector.h>
+#include <velox/vector/ComplexVector.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+export module halo.server.exchange:ExchangeSink;
+import halo.common;
+import halo.exec.hash;
+import :PageCodec;
+import :PageQueue;
+
+namespace halo::server::exchange {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+namespace velox = facebook::velox;
+
+export struct ExchangeSinkOptions {
+  PageCompression compression = PageCompression::kLz4;
+  // A partition's pending rows become a page once they reach this size.
+  std::uint64_t target_page_bytes = 1ULL << 20;
+  // Bytes of pages held per partition for a consumer that has not fetched
+  // them yet; add() waits beyond that.
+  std::uint64_t max_queued_bytes = 32ULL << 20;
+  // How long add() and finish() wait for a partition's consumer to make
+  // room before failing the sink.
+  std::chrono::milliseconds max_wait = std::chrono::minutes(5);
+};
+
+// Producing side of an exchange: hash-partitions batches on key columns
+// and cuts each partition's rows into compressed pages, which the
+// partition's consumer streams from the ExchangeServer the sink was
+// created on. Rows with equal keys land in the same partition on every
+// worker, which is what a partitioned aggregation or join relies on.
+//
+// add() and finish() are called from one thread.
+export class ExchangeSink final {
+ public:
+  static StatusOr<std::shared_ptr<ExchangeSink>> create(
+      velox::RowTypePtr row_type, std::vector<velox::column_index_t> keys,
+      std::size_t partitions, const ExchangeSinkOptions& options,
+      velox::memory::MemoryPool* pool) {
+    if (row_type == nullptr || pool == nullptr) {
+      return Status::Invalid("row type and memory pool must not be null");
+    }
+    if (partitions == 0) {
+      return Status::Invalid("an exchange needs at least one partition");
+    }
+    if (options.max_wait <= std::chrono::milliseconds::zero()) {
+      return Status::Invalid("max_wait must be positive");
+    }
+    if (keys.empty() && partitions > 1) {
+      return Status::Invalid("partitioning needs at least one key column");
+    }
+    for (const auto key : keys) {
+      if (key >= row_type->size()) {
+        return Status::Invalid("key column " + std::to_string(key) +
+                               " out of range for " + row_type->toString());
+      }
+    }
+    std::optional<exec::hash::KeyHasher> hasher;
+    if (partitions > 1) {
+      auto created = exec::hash::KeyHasher::create(row_type, keys);
+      if (!created.ok()) {
+        return created.status();
+      }
+      hasher.emplace(std::move(created).value());
+    }
+    return std::shared_ptr<ExchangeSink>(new ExchangeSink(
+        std::move(row_type), std::move(hasher), partitions, options, pool));
+  }
+
+  ExchangeSink(const ExchangeSink&) = delete;
+  ExchangeSink& operator=(const ExchangeSink&) = delete;
+
+  ~ExchangeSink() {
+    if (!finished_) {
+      abort(Status::QueryExecutorError(
+          "exchange sink destroyed before finish()"));
+    }
+  }
+
+  Status add(const velox::RowVectorPtr& batch) {
+    if (finished_) {
+      return Status::Invalid("add() after finish()");
+    }
+    if (!batch->type()->equivalent(*row_type_)) {
+      return Status::Invalid("batch of type " + batch->type()->toString() +
+                             " does not match exchange type " +
+                             row_type_->toString());
+    }
+    assignPartitions(*batch);
+    for (std::size_t p = 0; p < writers_.size(); ++p) {
+      auto& writer = *writers_[p];
+      auto status = writer.append(batch, rows_[p]);
+      if (status.ok() && writer.bytes() >= options_.target_page_bytes) {
+        status = flush(p);
+      }
+      if (!status.ok()) {
+        abort(status);
+        return status;
+      }
+    }
+    return Status::OK();
+  }
+
+  // Sends the remaining rows and ends every partition.
+  Status finish() {
+    if (finished_) {
+      return Status::OK();
+    }
+    for (std::size_t p = 0; p < writers_.size(); ++p) {
+      auto status = flush(p);
+      if (!status.ok()) {
+        abort(status);
+        return status;
+      }
+    }
+    finished_ = true;
+    for (const auto& queue : queues_) {
+      queue->close(Status::OK());
+    }
+    return Status::OK();
+  }
+
+  // Ends every partition with `status', which its consumer receives after
+  // the pages already queued.
+  void abort(const Status& status) {
+    finished_ = true;
+    for (const auto& queue : queues_) {
+      queue->close(status);
+    }
+  }
+
+  [[nodiscard]] const velox::RowTypePtr& rowType() const { return row_type_; }
+
+  [[nodiscard]] std::size_t partitions() const { return queues_.size(); }
+
+  // Hands partition `partition' to its consumer. Each partition is read
+  // once.
+  StatusOr<std::shared_ptr<PageQueue>> takePartition(std::int32_t partition) {
+    if (partition < 0 ||
+        static_cast<std::size_t>(partition) >= queues_.size()) {
+      return Status::Invalid("partition " + std::to_string(partition) +
+                             " out of range, the exchange has " +
+                             std::to_string(queues_.size()));
+    }
+    std::lock_guard lock(taken_mutex_);
+    if (taken_[partition]) {
+      return Status::Invalid("partition " + std::to_string(partition) +
+                             " is already being read");
+    }
+    taken_[partition] = true;
+    ++taken_count_;
+    return queues_[partition];
+  }
+
+  [[nodiscard]] bool allTaken() const {
+    std::lock_guard lock(taken_mutex_);
+    return taken_count_ == taken_.size();
+  }
+
+ private:
+  ExchangeSink(velox::RowTypePtr row_type,
+               std::optional<exec::hash::KeyHasher> hasher,
+               std::size_t partitions, const ExchangeSinkOptions& options,
+               velox::memory::MemoryPool* pool)
+      : row_type_(std::move(row_type)),
+        hasher_(std::move(hasher)),
+        options_(options),
+        rows_(partitions),
+        taken_(partitions, false) {
+    writers_.reserve(partitions);
+    queues_.reserve(partitions);
+    for (std::size_t p = 0; p < partitions; ++p) {
+      writers_.push_back(std::make_unique<PageWriter>(
+          row_type_, options.compression, pool));
+      queues_.push_back(std::make_shared<PageQueue>(options.max_queued_bytes,
+                                                    options.max_wait));
+    }
+  }
+
+  // Fills `rows_' with the rows of `batch' each partition receives.
+  void assignPartitions(const velox::RowVector& batch) {
+    const auto size = batch.size();
+    for (auto& rows : rows_) {
+      rows.clear();
+    }
+    if (rows_.size() == 1) {
+      rows_[0].resize(size);
+      for (velox::vector_size_t row = 0; row < size; ++row) {
+        rows_[0][row] = row;
+      }
+      return;
+    }
+    hasher_->hash(batch, hashes_);
+    for (velox::vector_size_t row = 0; row < size; ++row) {
+      rows_[hashes_[row] % rows_.size()].push_back(row);
+    }
+  }
+
+  Status flush(std::size_t partition) {
+    auto page = writers_[partition]->flush();
+    if (!page.ok()) {
+      return page.status();
+    }
+    if (page->rows == 0) {
+      return Status::OK();
+    }
+    const auto pushed = queues_[partition]->push(std::move(page).value());
+    if (!pushed.ok()) {
+      return Status::StorageError("partition " + std::to_string(partition) +
+                                  ": " + pushed.message());
+    }
+    return Status::OK();
+  }
+
+  const velox::RowTypePtr row_type_;
+  // Hashes the key columns; only there with more than one partition.
+  std::optional<exec::hash::KeyHasher> hasher_;
+  const ExchangeSinkOptions options_;
+  std::vector<std::unique_ptr<PageWriter>> writers_;
+  std::vector<std::shared_ptr<PageQueue>> queues_;
+  // Scratch for assignPartitions().
+  std::vector<std::uint64_t> hashes_;
+  std::vector<std::vector<velox::vector_size_t>> rows_;
+  mutable std::mutex taken_mutex_;
+  std::vector<bool> taken_;
+  std::size_t taken_count_ = 0;
+  bool finished_ = false;
+};
+
+// Sinks waiting for their consumers, by exchange id.
+class SinkRegistry final {
+ public:
+  Status add(const std::string& exchange_id,
+             std::shared_ptr<ExchangeSink> sink) {
+    std::lock_guard lock(mutex_);
+    if (!sinks_.emplace(exchange_id, std::move(sink)).second) {
+      return Status::Invalid("exchange '" + exchange_id +
+                             "' already exists");
+    }
+    return Status::OK();
+  }
+
+  // The queue of one partition. A sink is forgotten once all its
+  // partitions are being read; the streams keep the queues alive.
+  StatusOr<std::shared_ptr<PageQueue>> take(const std::string& exchange_id,
+                                            std::int32_t partition) {
+    std::lock_guard lock(mutex_);
+    const auto it = sinks_.find(exchange_id);
+    if (it == sinks_.end()) {
+      return Status::Invalid("unknown exchange '" + exchange_id + "'");
+    }
+    auto queue = it->second->takePartition(partition);
+    if (queue.ok() && it->second->allTaken()) {
+      sinks_.erase(it);
+    }
+    return queue;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::map<std::string, std::shared_ptr<ExchangeSink>> sinks_;
+};
+
+}  // namespace halo::server::exchange
@@ -0,0 +1,210 @@
+module;
+#include <folly/SocketAddress.h>
+#include <folly/coro/AsyncGenerator.h>
+#include <folly/coro/BlockingWait.h>
+#include <folly/coro/Merge.h>
+#include <folly/io/async/AsyncSocket.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <halo/server/exchange/gen-cpp2/ExchangeService.h>
+#include <thrift/lib/cpp2/async/RocketClientChannel.h>
+#include <thrift/lib/cpp2/async/RpcOptions.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+export module halo.server.exchange:ExchangeSource;
+import halo.common;
+import :PageCodec;
+import :QuicTransport;
+
+namespace halo::server::exchange {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+namespace velox = facebook::velox;
+
+using ExchangeClient = apache::thrift::Client<wire::ExchangeService>;
+
+export struct ExchangeEndpoint {
+  std::string host;
+  std::uint16_t port = 0;
+};
+
+export struct ExchangeSourceOptions {
+  // Pages each upstream may send before this consumer has read any: the
+  // credit of its stream. Credit is returned as pages are read, so memory
+  // held for a slow consumer is bounded by upstreams * credit_pages pages.
+  std::int32_t credit_pages = 4;
+  std::chrono::milliseconds connect_timeout{5000};
+  // Fetches over QUIC rather than Rocket when set; the upstream ports are
+  // then the servers' quicPort(). Sources sharing a client share its
+  // connections, one per upstream worker.
+  std::shared_ptr<QuicExchangeClient> quic;
+};
+
+// Consuming side of an exchange: reads one partition from every upstream
+// worker's ExchangeServer and returns its pages as batches, in the order
+// they arrive from any upstream.
+export class ExchangeSource final {
+ public:
+  static StatusOr<std::unique_ptr<ExchangeSource>> create(
+      velox::RowTypePtr row_type, const std::string& exchange_id,
+      std::int32_t partition, const std::vector<ExchangeEndpoint>& upstreams,
+      const ExchangeSourceOptions& options, velox::memory::MemoryPool* pool) {
+    if (row_type == nullptr || pool == nullptr) {
+      return Status::Invalid("row type and memory pool must not be null");
+    }
+    if (options.credit_pages <= 0) {
+      return Status::Invalid("credit_pages must be positive");
+    }
+    std::unique_ptr<ExchangeSource> source(
+        new ExchangeSource(std::move(row_type), pool));
+    if (options.quic != nullptr) {
+      source->quic_ = options.quic;
+      std::vector<folly::coro::AsyncGenerator<SerializedPage&&>> streams;
+      streams.reserve(upstreams.size());
+      for (const auto& upstream : upstreams) {
+        streams.push_back(QuicExchangeClient::pages(
+            options.quic->upstream(
+                folly::SocketAddress(upstream.host, upstream.port)),
+            exchange_id, partition, options.credit_pages));
+      }
+      source->pages_ = folly::coro::merge(
+          folly::getKeepAliveToken(options.quic->eventBase()),
+          each(std::move(streams)));
+      return source;
+    }
+    source->io_thread_ = std::make_unique<folly::ScopedEventBaseThread>();
+    auto* event_base = source->io_thread_->getEventBase();
+    std::vector<folly::coro::AsyncGenerator<SerializedPage&&>> streams;
+    streams.reserve(upstreams.size());
+    wire::FetchRequest request;
+    request.exchange_id() = exchange_id;
+    request.partition() = partition;
+    try {
+      for (const auto& upstream : upstreams) {
+        streams.push_back(upstreamPages(connect(event_base, upstream, options),
+                                        request, options.credit_pages));
+      }
+    } catch (const std::exception& e) {
+      return Status::StorageError(std::string("cannot connect to exchange: ") +
+                                  e.what());
+    }
+    source->pages_ = folly::coro::merge(folly::getKeepAliveToken(event_base),
+                                        each(std::move(streams)));
+    return source;
+  }
+
+  ExchangeSource(const ExchangeSource&) = delete;
+  ExchangeSource& operator=(const ExchangeSource&) = delete;
+
+  // Destroying the source before the end cancels the open streams.
+  ~ExchangeSource() = default;
+
+  // The next batch; nullptr once every upstream has ended the partition.
+  StatusOr<velox::RowVectorPtr> next() {
+    if (done_) {
+      return velox::RowVectorPtr();
+    }
+    SerializedPage page;
+    try {
+      auto item = folly::coro::blockingWait(pages_.next());
+      if (!item) {
+        done_ = true;
+        return velox::RowVectorPtr();
+      }
+      page = std::move(*item);
+    } catch (const wire::ExchangeError& e) {
+      return fail(Status::StorageError(*e.message()));
+    } catch (const std::exception& e) {
+      return fail(Status::StorageError(
+          std::string("exchange stream failed: ") + e.what()));
+    }
+    auto batch = reader_.read(page);
+    if (!batch.ok()) {
+      return fail(batch.status());
+    }
+    return batch;
+  }
+
+ private:
+  ExchangeSource(velox::RowTypePtr row_type, velox::memory::MemoryPool* pool)
+      : reader_(std::move(row_type), pool) {}
+
+  // Clients live on the I/O thread's event base and are destroyed there.
+  static std::shared_ptr<ExchangeClient> connect(
+      folly::EventBase* event_base, const ExchangeEndpoint& upstream,
+      const ExchangeSourceOptions& options) {
+    std::shared_ptr<ExchangeClient> client;
+    event_base->runInEventBaseThreadAndWait([&] {
+      folly::AsyncSocket::UniquePtr socket(new folly::AsyncSocket(
+          event_base, folly::SocketAddress(upstream.host, upstream.port),
+          static_cast<std::uint32_t>(options.connect_timeout.count())));
+      client.reset(
+          new ExchangeClient(
+              apache::thrift::RocketClientChannel::newChannel(
+                  std::move(socket))),
+          [event_base](ExchangeClient* doomed) {
+            event_base->runImmediatelyOrRunInEventBaseThreadAndWait(
+                [doomed] { delete doomed; });
+          });
+    });
+    return client;
+  }
+
+  static folly::coro::AsyncGenerator<SerializedPage&&> upstreamPages(
+      std::shared_ptr<ExchangeClient> client, wire::FetchRequest request,
+      std::int32_t credit_pages) {
+    apache::thrift::RpcOptions rpc_options;
+    rpc_options.setChunkBufferSize(credit_pages);
+    auto stream = co_await client->co_fetch(rpc_options, request);
+    auto pages = std::move(stream).toAsyncGenerator();
+    while (auto page = co_await pages.next()) {
+      const auto compression = *page->compression();
+      if (compression < static_cast<std::int32_t>(PageCompression::kNone) ||
+          compression > static_cast<std::int32_t>(PageCompression::kZstd)) {
+        throw std::runtime_error("unknown page compression " +
+                                 std::to_string(compression));
+      }
+      co_yield SerializedPage{
+          .data = std::move(*page->data()),
+          .rows = *page->rows(),
+          .compression = static_cast<PageCompression>(compression)};
+    }
+  }
+
+  static folly::coro::AsyncGenerator<
+      folly::coro::AsyncGenerator<SerializedPage&&>>
+  each(std::vector<folly::coro::AsyncGenerator<SerializedPage&&>> streams) {
+    for (auto& stream : streams) {
+      co_yield std::move(stream);
+    }
+  }
+
+  Status fail(Status status) {
+    done_ = true;
+    pages_ = {};
+    return status;
+  }
+
+  // Declared first so that the streams below end before they stop; the
+  // Rocket streams run on `io_thread_', the QUIC ones on the client's.
+  std::shared_ptr<QuicExchangeClient> quic_;
+  std::unique_ptr<folly::ScopedEventBaseThread> io_thread_;
+  PageReader reader_;
+  folly::coro::AsyncGenerator<SerializedPage&&> pages_;
+  bool done_ = false;
+};
+
+}  // namespace halo::server::exchange
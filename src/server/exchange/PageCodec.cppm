@@ -0,0 +1,186 @@
+module;
+#include <folly/Range.h>
+#include <folly/io/IOBuf.h>
+#include <velox/common/compression/Compression.h>
+#include <velox/common/memory/ByteStream.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/common/memory/StreamArena.h>
+#include <velox/serializers/PrestoSerializer.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/VectorStream.h>
+
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+export module halo.server.exchange:PageCodec;
+import halo.common;
+
+namespace halo::server::exchange {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+namespace velox = facebook::velox;
+
+export enum class PageCompression : std::int32_t {
+  kNone = 0,
+  kLz4 = 1,
+  kZstd = 2,
+};
+
+velox::common::CompressionKind compressionKind(PageCompression compression) {
+  switch (compression) {
+    case PageCompression::kNone:
+      return velox::common::CompressionKind::CompressionKind_NONE;
+    case PageCompression::kLz4:
+      return velox::common::CompressionKind::CompressionKind_LZ4;
+    case PageCompression::kZstd:
+      return velox::common::CompressionKind::CompressionKind_ZSTD;
+  }
+  return velox::common::CompressionKind::CompressionKind_NONE;
+}
+
+velox::serializer::presto::PrestoVectorSerde::PrestoOptions serdeOptions(
+    PageCompression compression) {
+  velox::serializer::presto::PrestoVectorSerde::PrestoOptions options;
+  options.useLosslessTimestamp = true;
+  options.compressionKind = compressionKind(compression);
+  return options;
+}
+
+// Rows of one partition in the Presto page format. A page the codec could
+// not shrink below the serde's minimum ratio travels uncompressed and says
+// so in its header.
+export struct SerializedPage {
+  std::unique_ptr<folly::IOBuf> data;
+  std::int64_t rows = 0;
+  PageCompression compression = PageCompression::kNone;
+
+  [[nodiscard]] std::uint64_t bytes() const {
+    return data == nullptr ? 0 : data->computeChainDataLength();
+  }
+};
+
+// Collects rows bound for one destination until flush() turns them into
+// a page. Rows are picked out of the producer's batches by index, so
+// partitioning does not copy vectors.
+export class PageWriter final {
+ public:
+  PageWriter(velox::RowTypePtr row_type, PageCompression compression,
+             velox::memory::MemoryPool* pool)
+      : row_type_(std::move(row_type)),
+        compression_(compression),
+        options_(serdeOptions(compression)),
+        pool_(pool) {}
+
+  Status append(const velox::RowVectorPtr& batch,
+                std::span<const velox::vector_size_t> rows) {
+    if (rows.empty()) {
+      return Status::OK();
+    }
+    try {
+      if (serializer_ == nullptr) {
+        arena_ = std::make_unique<velox::StreamArena>(pool_);
+        serializer_ = serde_.createIterativeSerializer(
+            row_type_, static_cast<std::int32_t>(rows.size()), arena_.get(),
+            &options_);
+      }
+      serializer_->append(batch, folly::Range(rows.data(), rows.size()),
+                          scratch_);
+    } catch (const std::exception& e) {
+      return Status::QueryExecutorError(
+          std::string("cannot serialize exchange page: ") + e.what());
+    }
+    rows_ += static_cast<std::int64_t>(rows.size());
+    return Status::OK();
+  }
+
+  // Upper bound of the pending rows' size before compression.
+  [[nodiscard]] std::uint64_t bytes() const {
+    return serializer_ == nullptr ? 0 : serializer_->maxSerializedSize();
+  }
+
+  [[nodiscard]] std::int64_t rows() const { return rows_; }
+
+  // Serializes and compresses the pending rows. A writer without pending
+  // rows returns a page without data.
+  StatusOr<SerializedPage> flush() {
+    SerializedPage page;
+    page.compression = compression_;
+    if (serializer_ == nullptr) {
+      return page;
+    }
+    try {
+      velox::IOBufOutputStream out(*pool_);
+      serializer_->flush(&out);
+      page.data = out.getIOBuf();
+    } catch (const std::exception& e) {
+      return Status::QueryExecutorError(
+          std::string("cannot serialize exchange page: ") + e.what());
+    }
+    page.rows = rows_;
+    serializer_.reset();
+    arena_.reset();
+    rows_ = 0;
+    return page;
+  }
+
+ private:
+  const velox::RowTypePtr row_type_;
+  const PageCompression compression_;
+  const velox::serializer::presto::PrestoVectorSerde::PrestoOptions options_;
+  velox::memory::MemoryPool* const pool_;
+  velox::serializer::presto::PrestoVectorSerde serde_;
+  velox::Scratch scratch_;
+  std::unique_ptr<velox::StreamArena> arena_;
+  std::unique_ptr<velox::IterativeVectorSerializer> serializer_;
+  std::int64_t rows_ = 0;
+};
+
+// Turns pages back into vectors allocated from `pool'.
+export class PageReader final {
+ public:
+  PageReader(velox::RowTypePtr row_type, velox::memory::MemoryPool* pool)
+      : row_type_(std::move(row_type)), pool_(pool) {}
+
+  StatusOr<velox::RowVectorPtr> read(const SerializedPage& page) {
+    if (page.data == nullptr) {
+      return Status::Invalid("exchange page without data");
+    }
+    std::vector<velox::ByteRange> ranges;
+    for (const auto range : *page.data) {
+      if (!range.empty()) {
+        ranges.push_back({const_cast<std::uint8_t*>(range.data()),
+                          static_cast<std::int32_t>(range.size()), 0});
+      }
+    }
+    const auto options = serdeOptions(page.compression);
+    velox::RowVectorPtr result;
+    try {
+      velox::BufferInputStream input(std::move(ranges));
+      serde_.deserialize(&input, pool_, row_type_, &result, &options);
+    } catch (const std::exception& e) {
+      return Status::Invalid(std::string("corrupt exchange page: ") +
+                             e.what());
+    }
+    if (static_cast<std::int64_t>(result->size()) != page.rows) {
+      return Status::Invalid("exchange page holds " +
+                             std::to_string(result->size()) +
+                             " rows, expected " + std::to_string(page.rows));
+    }
+    return result;
+  }
+
+ private:
+  const velox::RowTypePtr row_type_;
+  velox::memory::MemoryPool* const pool_;
+  velox::serializer::presto::PrestoVectorSerde serde_;
+};
+
+}  // namespace halo::server::exchange
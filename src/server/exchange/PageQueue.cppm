@@ -0,0 +1,127 @@
+module;
+#include <folly/coro/Baton.h>
+#include <folly/coro/Task.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+
+export module halo.server.exchange:PageQueue;
+import halo.common;
+import :PageCodec;
+
+namespace halo::server::exchange {
+
+using halo::common::base::Status;
+
+// Pages of one partition between the thread producing them and the
+// stream sending them. Bounded by bytes like the Flight result queue, but
+// the consumer is a coroutine on the server's executor, so pop() suspends
+// instead of blocking a thread while the producer is behind.
+//
+// One producer, one consumer.
+export class PageQueue final {
+ public:
+  PageQueue(std::uint64_t max_bytes, std::chrono::milliseconds max_wait)
+      : max_bytes_(max_bytes), max_wait_(max_wait) {}
+
+  PageQueue(const PageQueue&) = delete;
+  PageQueue& operator=(const PageQueue&) = delete;
+
+  // Blocks while `max_bytes' or more are queued; an empty queue always
+  // admits the page. Fails, dropping `page', once the consumer has
+  // cancelled, or after `max_wait' without room, so a partition nobody
+  // fetches cannot hold its producer forever.
+  Status push(SerializedPage page) {
+    {
+      std::unique_lock lock(mutex_);
+      const bool admitted = space_available_.wait_for(lock, max_wait_, [&] {
+        return cancelled_ || pages_.empty() || queued_bytes_ < max_bytes_;
+      });
+      if (cancelled_) {
+        return Status::StorageError("consumer went away");
+      }
+      if (!admitted) {
+        return Status::StorageError(
+            "no consumer fetched the queued pages within " +
+            std::to_string(max_wait_.count()) + " ms");
+      }
+      queued_bytes_ += page.bytes();
+      pages_.push_back(std::move(page));
+    }
+    page_available_.post();
+    return Status::OK();
+  }
+
+  // Ends the partition after the queued pages. `status' is reported by
+  // status() once pop() has drained them.
+  void close(Status status) {
+    {
+      std::lock_guard lock(mutex_);
+      closed_ = true;
+      status_ = std::move(status);
+    }
+    page_available_.post();
+  }
+
+  // Drops the queued pages and fails every later push().
+  void cancel() {
+    std::lock_guard lock(mutex_);
+    cancelled_ = true;
+    pages_.clear();
+    queued_bytes_ = 0;
+    space_available_.notify_one();
+  }
+
+  // The next page; nullopt at the end of the partition.
+  folly::coro::Task<std::optional<SerializedPage>> pop() {
+    while (true) {
+      {
+        std::lock_guard lock(mutex_);
+        if (!pages_.empty()) {
+          auto page = std::move(pages_.front());
+          pages_.pop_front();
+          queued_bytes_ -= page.bytes();
+          space_available_.notify_one();
+          co_return std::move(page);
+        }
+        if (closed_) {
+          co_return std::nullopt;
+        }
+        // Any push() after this point posts again.
+        page_available_.reset();
+      }
+      co_await page_available_;
+    }
+  }
+
+  // How the producer ended the partition; OK until close().
+  [[nodiscard]] Status status() const {
+    std::lock_guard lock(mutex_);
+    return status_;
+  }
+
+  [[nodiscard]] std::uint64_t queuedBytes() const {
+    std::lock_guard lock(mutex_);
+    return queued_bytes_;
+  }
+
+ private:
+  const std::uint64_t max_bytes_;
+  const std::chrono::milliseconds max_wait_;
+  mutable std::mutex mutex_;
+  std::condition_variable space_available_;
+  folly::coro::Baton page_available_;
+  std::deque<SerializedPage> pages_;
+  std::uint64_t queued_bytes_ = 0;
+  Status status_ = Status::OK();
+  bool closed_ = false;
+  bool cancelled_ = false;
+};
+
+}  // namespace halo::server::exchange
@@ -0,0 +1,774 @@
+module;
+#include <fizz/backend/openssl/certificate/CertUtils.h>
+#include <fizz/client/FizzClientContext.h>
+#include <fizz/protocol/CertificateVerifier.h>
+#include <fizz/server/CertManager.h>
+#include <fizz/server/FizzServerContext.h>
+#include <folly/ScopeGuard.h>
+#include <folly/SocketAddress.h>
+#include <folly/coro/AsyncGenerator.h>
+#include <folly/coro/Baton.h>
+#include <folly/coro/Task.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/IOBufQueue.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/ssl/OpenSSLPtrTypes.h>
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <quic/api/QuicSocket.h>
+#include <quic/client/QuicClientTransport.h>
+#include <quic/common/events/FollyQuicEventBase.h>
+#include <quic/common/udpsocket/FollyQuicAsyncUDPSocket.h>
+#include <quic/fizz/client/handshake/FizzClientQuicHandshakeContext.h>
+#include <quic/server/QuicServer.h>
+#include <quic/server/QuicServerTransport.h>
+#include <quic/server/QuicServerTransportFactory.h>
+#include <quic/state/TransportSettings.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+export module halo.server.exchange:QuicTransport;
+import halo.common;
+import :ExchangeSink;
+import :PageCodec;
+import :PageQueue;
+
+namespace halo::server::exchange {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+// Exchange over QUIC (mvfst). A consumer keeps one connection per upstream
+// worker and fetches each partition on its own bidirectional stream, so
+// a lost packet only stalls the partition it belonged to, and a shuffle
+// between n workers needs n connections per worker rather than one per
+// partition and worker.
+//
+// Each stream carries frames: the client sends one kRequest and ends its
+// side; the server answers with kPage frames and one kEnd or kError.
+// Frame header: kind (1 byte), compression (1), rows (8, big endian),
+// payload length (4, big endian).
+//
+// Flow control is QUIC's own: a consumer that holds `credit_pages' unread
+// pages stops reading the stream, its receive window closes, the server
+// stops writing, and the partition's PageQueue then holds back the sink.
+
+enum class FrameKind : std::uint8_t {
+  kRequest = 0,
+  kPage = 1,
+  kEnd = 2,
+  kError = 3,
+};
+
+constexpr std::size_t kFrameHeaderBytes = 14;
+constexpr std::uint32_t kMaxFramePayload = 1U << 30;
+constexpr std::string_view kAlpn = "halo-exchange";
+
+struct Frame {
+  FrameKind kind = FrameKind::kEnd;
+  std::uint8_t compression = 0;
+  std::int64_t rows = 0;
+  std::unique_ptr<folly::IOBuf> payload;
+};
+
+std::unique_ptr<folly::IOBuf> encodeFrame(
+    FrameKind kind, std::uint8_t compression, std::int64_t rows,
+    std::unique_ptr<folly::IOBuf> payload) {
+  auto frame = folly::IOBuf::create(kFrameHeaderBytes);
+  folly::io::Appender out(frame.get(), 0);
+  out.write(static_cast<std::uint8_t>(kind));
+  out.write(compression);
+  out.writeBE(rows);
+  out.writeBE(static_cast<std::uint32_t>(
+      payload == nullptr ? 0 : payload->computeChainDataLength()));
+  if (payload != nullptr) {
+    frame->appendToChain(std::move(payload));
+  }
+  return frame;
+}
+
+// Takes the next complete frame off `queue'; nullopt until one arrived.
+StatusOr<std::optional<Frame>> decodeFrame(folly::IOBufQueue& queue) {
+  if (queue.chainLength() < kFrameHeaderBytes) {
+    return std::optional<Frame>();
+  }
+  folly::io::Cursor cursor(queue.front());
+  const auto kind = cursor.read<std::uint8_t>();
+  if (kind > static_cast<std::uint8_t>(FrameKind::kError)) {
+    return Status::Invalid("unknown exchange frame " + std::to_string(kind));
+  }
+  Frame frame;
+  frame.kind = static_cast<FrameKind>(kind);
+  frame.compression = cursor.read<std::uint8_t>();
+  frame.rows = cursor.readBE<std::int64_t>();
+  const auto length = cursor.readBE<std::uint32_t>();
+  if (length > kMaxFramePayload) {
+    return Status::Invalid("exchange frame of " + std::to_string(length) +
+                           " bytes");
+  }
+  if (queue.chainLength() < kFrameHeaderBytes + length) {
+    return std::optional<Frame>();
+  }
+  queue.trimStart(kFrameHeaderBytes);
+  if (length > 0) {
+    frame.payload = queue.split(length);
+  }
+  return std::optional<Frame>(std::move(frame));
+}
+
+quic::TransportSettings transportSettings() {
+  quic::TransportSettings settings;
+  // One stream per partition fetched over the connection.
+  settings.advertisedInitialMaxStreamsBidi = 4096;
+  return settings;
+}
+
+// PEM certificate and private key of a server.
+export struct TlsIdentity {
+  std::string certificate;
+  std::string private_key;
+};
+
+// A throwaway P-256 identity for servers started without one.
+StatusOr<TlsIdentity> selfSignedIdentity() {
+  folly::ssl::EcKeyUniquePtr ec_key(
+      EC_KEY_new_by_curve_name(NID_X9_62_prime256v1));
+  folly::ssl::EvpPkeyUniquePtr key(EVP_PKEY_new());
+  folly::ssl::X509UniquePtr certificate(X509_new());
+  if (ec_key == nullptr || key == nullptr || certificate == nullptr ||
+      EC_KEY_generate_key(ec_key.get()) != 1 ||
+      EVP_PKEY_assign_EC_KEY(key.get(), ec_key.release()) != 1) {
+    return Status::Error("cannot generate exchange TLS key");
+  }
+  ASN1_INTEGER_set(X509_get_serialNumber(certificate.get()), 1);
+  X509_gmtime_adj(X509_getm_notBefore(certificate.get()), 0);
+  X509_gmtime_adj(X509_getm_notAfter(certificate.get()),
+                  365L * 24 * 60 * 60);
+  X509_set_pubkey(certificate.get(), key.get());
+  auto* name = X509_get_subject_name(certificate.get());
+  X509_NAME_add_entry_by_txt(
+      name, "CN", MBSTRING_ASC,
+      reinterpret_cast<const unsigned char*>(kAlpn.data()),
+      static_cast<int>(kAlpn.size()), -1, 0);
+  X509_set_issuer_name(certificate.get(), name);
+  if (X509_sign(certificate.get(), key.get(), EVP_sha256()) == 0) {
+    return Status::Error("cannot sign exchange TLS certificate");
+  }
+  const auto pem = [](auto write) -> std::string {
+    folly::ssl::BioUniquePtr bio(BIO_new(BIO_s_mem()));
+    if (bio == nullptr || write(bio.get()) != 1) {
+      return {};
+    }
+    char* data = nullptr;
+    const auto size = BIO_get_mem_data(bio.get(), &data);
+    return std::string(data, static_cast<std::size_t>(size));
+  };
+  TlsIdentity identity;
+  identity.certificate = pem([&](BIO* bio) {
+    return PEM_write_bio_X509(bio, certificate.get());
+  });
+  identity.private_key = pem([&](BIO* bio) {
+    return PEM_write_bio_PrivateKey(bio, key.get(), nullptr, nullptr, 0,
+                                    nullptr, nullptr);
+  });
+  if (identity.certificate.empty() || identity.private_key.empty()) {
+    return Status::Error("cannot encode exchange TLS identity");
+  }
+  return identity;
+}
+
+// Workers accept any server certificate: QUIC needs TLS, but the exchange
+// trusts its network as the Rocket transport, which runs in plain text,
+// does.
+class AcceptAnyCertificate final : public fizz::CertificateVerifier {
+ public:
+  std::shared_ptr<const folly::AsyncTransportCertificate> verify(
+      const std::vector<std::shared_ptr<const fizz::PeerCert>>& certificates)
+      const override {
+    return certificates.empty() ? nullptr : certificates.front();
+  }
+
+  [[nodiscard]] std::vector<fizz::Extension> getCertificateRequestExtensions()
+      const override {
+    return {};
+  }
+};
+
+// One client connection on the server side. Lives on its event base.
+class QuicServerConnection final
+    : public quic::QuicSocket::ConnectionSetupCallback,
+      public quic::QuicSocket::ConnectionCallback,
+      public quic::QuicSocket::ReadCallback,
+      public quic::QuicSocket::WriteCallback,
+      public std::enable_shared_from_this<QuicServerConnection> {
+ public:
+  QuicServerConnection(folly::EventBase* event_base,
+                       std::shared_ptr<SinkRegistry> registry)
+      : event_base_(event_base), registry_(std::move(registry)) {}
+
+  // Keeps the connection alive until the transport reports its end.
+  void attach(std::shared_ptr<quic::QuicSocket> socket) {
+    socket_ = std::move(socket);
+    self_ = shared_from_this();
+  }
+
+  void onConnectionSetupError(quic::QuicError /*error*/) noexcept override {
+    end();
+  }
+
+  void onTransportReady() noexcept override {}
+
+  void onNewBidirectionalStream(quic::StreamId id) noexcept override {
+    streams_.emplace(id, std::make_shared<Stream>());
+    socket_->setReadCallback(id, this);
+  }
+
+  void onNewUnidirectionalStream(quic::StreamId /*id*/) noexcept override {}
+
+  void onStopSending(quic::StreamId id,
+                     quic::ApplicationErrorCode /*error*/) noexcept override {
+    abandon(id);
+  }
+
+  void onConnectionEnd() noexcept override { end(); }
+
+  void onConnectionError(quic::QuicError /*error*/) noexcept override {
+    end();
+  }
+
+  void readAvailable(quic::StreamId id) noexcept override {
+    const auto it = streams_.find(id);
+    if (it == streams_.end()) {
+      return;
+    }
+    auto stream = it->second;
+    auto data = socket_->read(id, 0);
+    if (data.hasError()) {
+      abandon(id);
+      return;
+    }
+    if (data->first != nullptr) {
+      stream->request.append(std::move(data->first));
+    }
+    // The request ends with the client's side of the stream.
+    if (!data->second) {
+      return;
+    }
+    socket_->setReadCallback(id, nullptr);
+    auto frame = decodeFrame(stream->request);
+    if (!frame.ok() || !*frame || (*frame)->kind != FrameKind::kRequest ||
+        !stream->request.empty()) {
+      finish(id, Status::Invalid("malformed exchange request"));
+      return;
+    }
+    const std::string exchange_id = (*frame)->payload == nullptr
+                                        ? std::string()
+                                        : (*frame)->payload->to<std::string>();
+    auto queue = registry_->take(exchange_id,
+                                 static_cast<std::int32_t>((*frame)->rows));
+    if (!queue.ok()) {
+      finish(id, queue.status());
+      return;
+    }
+    stream->queue = std::move(queue).value();
+    (void)folly::coro::co_withExecutor(
+        folly::getKeepAliveToken(event_base_),
+        pump(shared_from_this(), id, std::move(stream)))
+        .start();
+  }
+
+  void readError(quic::StreamId id, quic::QuicError /*error*/) noexcept
+      override {
+    abandon(id);
+  }
+
+  void onStreamWriteReady(quic::StreamId id,
+                          std::uint64_t /*max_to_send*/) noexcept override {
+    const auto it = streams_.find(id);
+    if (it != streams_.end()) {
+      it->second->writable.post();
+    }
+  }
+
+  void onStreamWriteError(quic::StreamId id,
+                          quic::QuicError /*error*/) noexcept override {
+    abandon(id);
+  }
+
+ private:
+  struct Stream {
+    folly::IOBufQueue request{folly::IOBufQueue::cacheChainLength()};
+    std::shared_ptr<PageQueue> queue;
+    folly::coro::Baton writable;
+    bool closed = false;
+  };
+
+  // Sends the partition's pages, each once the stream has window for more.
+  static folly::coro::Task<void> pump(
+      std::shared_ptr<QuicServerConnection> self, quic::StreamId id,
+      std::shared_ptr<Stream> stream) {
+    // Releases the producer if the client goes away mid-stream.
+    SCOPE_EXIT {
+      stream->queue->cancel();
+    };
+    while (auto page = co_await stream->queue->pop()) {
+      if (!co_await self->writable(id, *stream)) {
+        co_return;
+      }
+      self->socket_->writeChain(
+          id,
+          encodeFrame(FrameKind::kPage,
+                      static_cast<std::uint8_t>(page->compression),
+                      page->rows, std::move(page->data)),
+          /*eof=*/false);
+    }
+    if (co_await self->writable(id, *stream)) {
+      self->finish(id, stream->queue->status());
+    }
+  }
+
+  folly::coro::Task<bool> writable(quic::StreamId id, Stream& stream) {
+    if (stream.closed) {
+      co_return false;
+    }
+    stream.writable.reset();
+    if (socket_->notifyPendingWriteOnStream(id, this).hasError()) {
+      co_return false;
+    }
+    co_await stream.writable;
+    co_return !stream.closed;
+  }
+
+  // Ends the stream with kEnd, or kError carrying `status'.
+  void finish(quic::StreamId id, const Status& status) {
+    auto frame = status.ok()
+                     ? encodeFrame(FrameKind::kEnd, 0, 0, nullptr)
+                     : encodeFrame(FrameKind::kError, 0, 0,
+                                   folly::IOBuf::copyBuffer(status.message()));
+    socket_->writeChain(id, std::move(frame), /*eof=*/true);
+    streams_.erase(id);
+  }
+
+  void abandon(quic::StreamId id) {
+    const auto it = streams_.find(id);
+    if (it == streams_.end()) {
+      return;
+    }
+    it->second->closed = true;
+    it->second->writable.post();
+    streams_.erase(it);
+  }
+
+  void end() {
+    if (self_ == nullptr) {
+      return;
+    }
+    while (!streams_.empty()) {
+      abandon(streams_.begin()->first);
+    }
+    // Not from within the transport's own callback.
+    event_base_->runInLoop(
+        [self = std::move(self_)]() mutable { self.reset(); });
+  }
+
+  folly::EventBase* const event_base_;
+  const std::shared_ptr<SinkRegistry> registry_;
+  std::shared_ptr<quic::QuicSocket> socket_;
+  std::shared_ptr<QuicServerConnection> self_;
+  std::map<quic::StreamId, std::shared_ptr<Stream>> streams_;
+};
+
+class QuicConnectionFactory final : public quic::QuicServerTransportFactory {
+ public:
+  explicit QuicConnectionFactory(std::shared_ptr<SinkRegistry> registry)
+      : registry_(std::move(registry)) {}
+
+  quic::QuicServerTransport::Ptr make(
+      folly::EventBase* event_base,
+      std::unique_ptr<quic::FollyAsyncUDPSocket> socket,
+      const folly::SocketAddress& /*client*/, quic::QuicVersion /*version*/,
+      std::shared_ptr<const fizz::server::FizzServerContext> context) noexcept
+      override {
+    auto connection =
+        std::make_shared<QuicServerConnection>(event_base, registry_);
+    auto transport = quic::QuicServerTransport::make(
+        event_base, std::move(socket), connection.get(), connection.get(),
+        std::move(context));
+    connection->attach(transport);
+    return transport;
+  }
+
+ private:
+  const std::shared_ptr<SinkRegistry> registry_;
+};
+
+// The QUIC side of an ExchangeServer.
+class QuicPageServer final {
+ public:
+  static StatusOr<std::unique_ptr<QuicPageServer>> start(
+      std::shared_ptr<SinkRegistry> registry, const std::string& host,
+      std::uint16_t port, std::size_t threads, TlsIdentity identity) {
+    if (identity.certificate.empty()) {
+      auto generated = selfSignedIdentity();
+      if (!generated.ok()) {
+        return generated.status();
+      }
+      identity = std::move(generated).value();
+    }
+    std::shared_ptr<quic::QuicServer> server;
+    try {
+      auto certificates = std::make_shared<fizz::server::CertManager>();
+      certificates->addCertAndSetDefault(fizz::openssl::CertUtils::makeSelfCert(
+          identity.certificate, identity.private_key));
+      auto context = std::make_shared<fizz::server::FizzServerContext>();
+      context->setCertManager(std::move(certificates));
+      context->setSupportedAlpns({std::string(kAlpn)});
+      server = quic::QuicServer::createQuicServer(transportSettings());
+      server->setQuicServerTransportFactory(
+          std::make_unique<QuicConnectionFactory>(std::move(registry)));
+      server->setFizzContext(std::move(context));
+      server->start(folly::SocketAddress(host, port), threads);
+      server->waitUntilInitialized();
+    } catch (const std::exception& e) {
+      return Status::StorageError("cannot start QUIC exchange server on " +
+                                  host + ":" + std::to_string(port) + ": " +
+                                  e.what());
+    }
+    return std::unique_ptr<QuicPageServer>(
+        new QuicPageServer(std::move(server)));
+  }
+
+  QuicPageServer(const QuicPageServer&) = delete;
+  QuicPageServer& operator=(const QuicPageServer&) = delete;
+
+  ~QuicPageServer() { server_->shutdown(); }
+
+  [[nodiscard]] std::uint16_t port() const {
+    return server_->getAddress().getPort();
+  }
+
+ private:
+  explicit QuicPageServer(std::shared_ptr<quic::QuicServer> server)
+      : server_(std::move(server)) {}
+
+  std::shared_ptr<quic::QuicServer> server_;
+};
+
+// A consumer's connection to one upstream worker. Lives on the client's
+// event base; every method is called there.
+class QuicUpstream final
+    : public quic::QuicSocket::ConnectionSetupCallback,
+      public quic::QuicSocket::ConnectionCallback,
+      public quic::QuicSocket::ReadCallback {
+ public:
+  struct Stream {
+    explicit Stream(std::size_t credit_pages) : credit(credit_pages) {}
+
+    const std::size_t credit;
+    std::unique_ptr<folly::IOBuf> request;
+    std::optional<quic::StreamId> id;
+    folly::IOBufQueue buffer{folly::IOBufQueue::cacheChainLength()};
+    std::deque<SerializedPage> pages;
+    std::optional<std::string> error;
+    folly::coro::Baton ready;
+    bool ended = false;
+    bool paused = false;
+  };
+
+  QuicUpstream(
+      const std::shared_ptr<quic::FollyQuicEventBase>& event_base,
+      const folly::SocketAddress& address,
+      std::shared_ptr<quic::FizzClientQuicHandshakeContext> handshake) {
+    transport_ = std::make_shared<quic::QuicClientTransport>(
+        event_base,
+        std::make_unique<quic::FollyQuicAsyncUDPSocket>(event_base),
+        std::move(handshake));
+    transport_->setHostname(std::string(kAlpn));
+    transport_->addNewPeerAddress(address);
+    transport_->setTransportSettings(transportSettings());
+    transport_->start(this, this);
+  }
+
+  QuicUpstream(const QuicUpstream&) = delete;
+  QuicUpstream& operator=(const QuicUpstream&) = delete;
+
+  ~QuicUpstream() override { shutdown(); }
+
+  // A connection that failed is replaced on the next fetch.
+  [[nodiscard]] bool failed() const { return error_.has_value(); }
+
+  std::shared_ptr<Stream> open(const std::string& exchange_id,
+                               std::int32_t partition,
+                               std::size_t credit_pages) {
+    auto stream = std::make_shared<Stream>(credit_pages);
+    if (error_) {
+      stream->error = error_;
+      return stream;
+    }
+    stream->request = encodeFrame(FrameKind::kRequest, 0, partition,
+                                  folly::IOBuf::copyBuffer(exchange_id));
+    pending_.push_back(stream);
+    if (ready_) {
+      openPending();
+    }
+    return stream;
+  }
+
+  // Called after the consumer took a page off `stream'.
+  void consumed(Stream& stream) {
+    if (stream.paused && stream.pages.size() < stream.credit &&
+        transport_ != nullptr) {
+      stream.paused = false;
+      transport_->resumeRead(*stream.id);
+    }
+  }
+
+  // Called once the consumer is done with `stream', early or not.
+  void close(const std::shared_ptr<Stream>& stream) {
+    std::erase(pending_, stream);
+    if (!stream->id || !streams_.erase(*stream->id) ||
+        transport_ == nullptr) {
+      return;
+    }
+    transport_->setReadCallback(*stream->id, nullptr);
+    transport_->stopSending(*stream->id,
+                            quic::GenericApplicationErrorCode::NO_ERROR);
+  }
+
+  void shutdown() {
+    if (transport_ != nullptr) {
+      transport_->closeNow({});
+      transport_.reset();
+    }
+    fail("QUIC exchange connection closed");
+  }
+
+  void onConnectionSetupError(quic::QuicError error) noexcept override {
+    fail("QUIC exchange connection failed: " + error.message);
+  }
+
+  void onTransportReady() noexcept override {
+    ready_ = true;
+    openPending();
+  }
+
+  void onNewBidirectionalStream(quic::StreamId /*id*/) noexcept override {}
+
+  void onNewUnidirectionalStream(quic::StreamId /*id*/) noexcept override {}
+
+  void onStopSending(quic::StreamId /*id*/,
+                     quic::ApplicationErrorCode /*error*/) noexcept override {}
+
+  void onConnectionEnd() noexcept override {
+    fail("QUIC exchange connection closed by upstream");
+  }
+
+  void onConnectionError(quic::QuicError error) noexcept override {
+    fail("QUIC exchange connection failed: " + error.message);
+  }
+
+  void readAvailable(quic::StreamId id) noexcept override {
+    const auto it = streams_.find(id);
+    if (it == streams_.end()) {
+      return;
+    }
+    const auto stream = it->second;
+    auto data = transport_->read(id, 0);
+    if (data.hasError()) {
+      endStream(*stream, "cannot read QUIC exchange stream");
+      return;
+    }
+    if (data->first != nullptr) {
+      stream->buffer.append(std::move(data->first));
+    }
+    while (!stream->ended && !stream->error) {
+      auto frame = decodeFrame(stream->buffer);
+      if (!frame.ok()) {
+        stream->error = frame.status().message();
+      } else if (!*frame) {
+        break;
+      } else if ((*frame)->kind == FrameKind::kPage &&
+                 (*frame)->compression <=
+                     static_cast<std::uint8_t>(PageCompression::kZstd)) {
+        stream->pages.push_back(
+            {.data = std::move((*frame)->payload),
+             .rows = (*frame)->rows,
+             .compression =
+                 static_cast<PageCompression>((*frame)->compression)});
+      } else if ((*frame)->kind == FrameKind::kEnd) {
+        stream->ended = true;
+      } else if ((*frame)->kind == FrameKind::kError) {
+        stream->error = (*frame)->payload == nullptr
+                            ? std::string("exchange failed upstream")
+                            : (*frame)->payload->to<std::string>();
+      } else {
+        stream->error = "unexpected QUIC exchange frame";
+      }
+    }
+    if (data->second && !stream->ended && !stream->error) {
+      stream->error = "QUIC exchange stream ended early";
+    }
+    if (stream->ended || stream->error) {
+      streams_.erase(it);
+    } else if (!stream->paused && stream->pages.size() >= stream->credit) {
+      stream->paused = true;
+      transport_->pauseRead(id);
+    }
+    stream->ready.post();
+  }
+
+  void readError(quic::StreamId id, quic::QuicError error) noexcept override {
+    const auto it = streams_.find(id);
+    if (it != streams_.end()) {
+      const auto stream = it->second;
+      endStream(*stream, "QUIC exchange stream failed: " + error.message);
+    }
+  }
+
+ private:
+  void openPending() {
+    for (auto& stream : pending_) {
+      auto id = transport_->createBidirectionalStream();
+      if (id.hasError()) {
+        stream->error = "cannot open QUIC exchange stream";
+        stream->ready.post();
+        continue;
+      }
+      stream->id = *id;
+      streams_.emplace(*id, stream);
+      transport_->setReadCallback(*id, this);
+      transport_->writeChain(*id, std::move(stream->request), /*eof=*/true);
+    }
+    pending_.clear();
+  }
+
+  void endStream(Stream& stream, std::string error) {
+    stream.error = std::move(error);
+    if (stream.id) {
+      streams_.erase(*stream.id);
+    }
+    stream.ready.post();
+  }
+
+  void fail(std::string error) {
+    if (!error_) {
+      error_ = std::move(error);
+    }
+    for (auto& stream : pending_) {
+      stream->error = error_;
+      stream->ready.post();
+    }
+    pending_.clear();
+    while (!streams_.empty()) {
+      const auto stream = streams_.begin()->second;
+      endStream(*stream, *error_);
+    }
+  }
+
+  std::shared_ptr<quic::QuicClientTransport> transport_;
+  std::vector<std::shared_ptr<Stream>> pending_;
+  std::map<quic::StreamId, std::shared_ptr<Stream>> streams_;
+  std::optional<std::string> error_;
+  bool ready_ = false;
+};
+
+// A worker's QUIC connections to the other workers, shared by all of its
+// ExchangeSources (see ExchangeSourceOptions::quic): every partition a
+// worker reads from one upstream travels over the same connection.
+export class QuicExchangeClient final {
+ public:
+  static std::shared_ptr<QuicExchangeClient> create() {
+    return std::shared_ptr<QuicExchangeClient>(new QuicExchangeClient());
+  }
+
+  QuicExchangeClient(const QuicExchangeClient&) = delete;
+  QuicExchangeClient& operator=(const QuicExchangeClient&) = delete;
+
+  ~QuicExchangeClient() {
+    eventBase()->runInEventBaseThreadAndWait([this] {
+      for (auto& [address, upstream] : upstreams_) {
+        upstream->shutdown();
+      }
+      upstreams_.clear();
+    });
+  }
+
+  folly::EventBase* eventBase() { return io_thread_.getEventBase(); }
+
+  // The connection to `address', opened on first use.
+  std::shared_ptr<QuicUpstream> upstream(const folly::SocketAddress& address) {
+    std::shared_ptr<QuicUpstream> upstream;
+    eventBase()->runInEventBaseThreadAndWait([&] {
+      auto& slot = upstreams_[address.describe()];
+      if (slot == nullptr || slot->failed()) {
+        slot = std::make_shared<QuicUpstream>(quic_event_base_, address,
+                                              handshake_);
+      }
+      upstream = slot;
+    });
+    return upstream;
+  }
+
+  // The pages of one partition from `upstream'. Runs on eventBase().
+  static folly::coro::AsyncGenerator<SerializedPage&&> pages(
+      std::shared_ptr<QuicUpstream> upstream, std::string exchange_id,
+      std::int32_t partition, std::int32_t credit_pages) {
+    const auto stream = upstream->open(
+        exchange_id, partition, static_cast<std::size_t>(credit_pages));
+    SCOPE_EXIT {
+      upstream->close(stream);
+    };
+    while (true) {
+      if (!stream->pages.empty()) {
+        auto page = std::move(stream->pages.front());
+        stream->pages.pop_front();
+        upstream->consumed(*stream);
+        co_yield std::move(page);
+        continue;
+      }
+      if (stream->error) {
+        throw std::runtime_error(*stream->error);
+      }
+      if (stream->ended) {
+        co_return;
+      }
+      stream->ready.reset();
+      co_await stream->ready;
+    }
+  }
+
+ private:
+  QuicExchangeClient()
+      : quic_event_base_(
+            std::make_shared<quic::FollyQuicEventBase>(eventBase())) {
+    auto context = std::make_shared<fizz::client::FizzClientContext>();
+    context->setSupportedAlpns({std::string(kAlpn)});
+    handshake_ = quic::FizzClientQuicHandshakeContext::Builder()
+                     .setFizzClientContext(std::move(context))
+                     .setCertificateVerifier(
+                         std::make_shared<AcceptAnyCertificate>())
+                     .build();
+  }
+
+  folly::ScopedEventBaseThread io_thread_;
+  std::shared_ptr<quic::FollyQuicEventBase> quic_event_base_;
+  std::shared_ptr<quic::FizzClientQuicHandshakeContext> handshake_;
+  std::map<std::string, std::shared_ptr<QuicUpstream>> upstreams_;
+};
+
+}  // namespace halo::server::exchange
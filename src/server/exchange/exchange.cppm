@@ -0,0 +1,7 @@
+export module halo.server.exchange;
+export import :ExchangeServer;
+export import :ExchangeSink;
+export import :ExchangeSource;
+export import :PageCodec;
+export import :PageQueue;
+export import :QuicTransport;
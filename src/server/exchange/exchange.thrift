@@ -0,0 +1,34 @@
+// Wire format of the exchange between halo workers. Pages are Velox
+// vectors serialized with PrestoVectorSerde, see PageCodec.cppm.
+
+include "thrift/annotation/cpp.thrift"
+
+namespace cpp2 halo.server.exchange.wire
+
+@cpp.Type{name = "std::unique_ptr<folly::IOBuf>"}
+typedef binary IOBufPtr
+
+struct FetchRequest {
+  1: string exchange_id;
+  2: i32 partition;
+}
+
+struct Page {
+  1: IOBufPtr data;
+  2: i64 rows;
+  // PageCompression the page was written with.
+  3: i32 compression;
+}
+
+exception ExchangeError {
+  1: string message;
+}
+
+service ExchangeService {
+  // Every page of one partition, in the order the sink produced them. The
+  // client's stream buffer size is its credit: the server sends at most
+  // that many pages before the client has consumed some.
+  stream<Page throws (1: ExchangeError error)> fetch(
+    1: FetchRequest request,
+  ) throws (1: ExchangeError error);
+}
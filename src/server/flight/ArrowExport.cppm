@@ -0,0 +1,135 @@
+module;
+#include <arrow/c/bridge.h>
+#include <arrow/record_batch.h>
+#include <arrow/result.h>
+#include <arrow/status.h>
+#include <arrow/type.h>
+#include <velox/common/memory/MemoryPool.h>
+#include <velox/type/Type.h>
+#include <velox/vector/BaseVector.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/arrow/Bridge.h>
+
+#include <exception>
+#include <memory>
+#include <string>
+#include <utility>
+
+export module halo.server.flight:ArrowExport;
+import halo.common;
+
+namespace halo::server::flight {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+namespace velox = facebook::velox;
+
+export Status fromArrow(const arrow::Status& status) {
+  switch (status.code()) {
+    case arrow::StatusCode::OK:
+      return Status::OK();
+    case arrow::StatusCode::Invalid:
+    case arrow::StatusCode::TypeError:
+      return Status::Invalid(status.message());
+    case arrow::StatusCode::NotImplemented:
+      return Status::NotImplemented(status.message());
+    case arrow::StatusCode::IOError:
+      return Status::StorageError(status.message());
+    default:
+      return Status::Error(status.ToString());
+  }
+}
+
+arrow::Status toArrow(const Status& status) {
+  switch (status.code()) {
+    case Status::Code::kOk:
+      return arrow::Status::OK();
+    case Status::Code::kInvalid:
+    case Status::Code::kSqlError:
+      return arrow::Status::Invalid(status.message());
+    case Status::Code::kNotImplemented:
+      return arrow::Status::NotImplemented(status.message());
+    case Status::Code::kStorageError:
+      return arrow::Status::IOError(status.message());
+    default:
+      return arrow::Status::ExecutionError(status.message());
+  }
+}
+
+// Converts result batches of one row type to Arrow record batches through
+// the C data interface. Fixed-width values and null bitmaps are not copied:
+// the Arrow buffers point into the Velox buffers, which stay referenced
+// until Arrow releases the batch. VARCHAR is rewritten into an offsets
+// layout unless exported as Arrow string views. Dictionary and constant
+// columns are flattened so that every batch matches schema().
+export class ArrowExporter final {
+ public:
+  // `pool' backs the buffers the export has to allocate and must outlive
+  // the exported batches.
+  static StatusOr<ArrowExporter> create(velox::RowTypePtr row_type,
+                                        bool string_view,
+                                        velox::memory::MemoryPool* pool) {
+    velox::ArrowOptions options;
+    options.flattenDictionary = true;
+    options.flattenConstant = true;
+    options.exportToStringView = string_view;
+
+    ArrowSchema c_schema;
+    try {
+      velox::exportToArrow(velox::BaseVector::create(row_type, 0, pool),
+                           c_schema, options);
+    } catch (const std::exception& e) {
+      return Status::NotImplemented("cannot export " + row_type->toString() +
+                                    " to Arrow: " + e.what());
+    }
+    auto schema = arrow::ImportSchema(&c_schema);
+    if (!schema.ok()) {
+      return fromArrow(schema.status());
+    }
+    return ArrowExporter(std::move(row_type), std::move(*schema), options,
+                         pool);
+  }
+
+  [[nodiscard]] const std::shared_ptr<arrow::Schema>& schema() const {
+    return schema_;
+  }
+
+  StatusOr<std::shared_ptr<arrow::RecordBatch>> exportBatch(
+      const velox::RowVectorPtr& batch) const {
+    if (!batch->type()->equivalent(*row_type_)) {
+      return Status::Invalid("result batch of type " +
+                             batch->type()->toString() + ", expected " +
+                             row_type_->toString());
+    }
+    ArrowArray c_array;
+    try {
+      velox::exportToArrow(batch, c_array, pool_, options_);
+    } catch (const std::exception& e) {
+      return Status::QueryExecutorError(
+          std::string("cannot export result batch to Arrow: ") + e.what());
+    }
+    // Takes ownership of `c_array', releasing it on failure too.
+    auto record_batch = arrow::ImportRecordBatch(&c_array, schema_);
+    if (!record_batch.ok()) {
+      return fromArrow(record_batch.status());
+    }
+    return std::move(*record_batch);
+  }
+
+ private:
+  ArrowExporter(velox::RowTypePtr row_type,
+                std::shared_ptr<arrow::Schema> schema,
+                velox::ArrowOptions options, velox::memory::MemoryPool* pool)
+      : row_type_(std::move(row_type)),
+        schema_(std::move(schema)),
+        options_(std::move(options)),
+        pool_(pool) {}
+
+  velox::RowTypePtr row_type_;
+  std::shared_ptr<arrow::Schema> schema_;
+  velox::ArrowOptions options_;
+  velox::memory::MemoryPool* pool_;
+};
+
+}  // namespace halo::server::flight
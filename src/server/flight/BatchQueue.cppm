@@ -0,0 +1,117 @@
+module;
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+export module halo.server.flight:BatchQueue;
+import halo.common;
+
+namespace halo::server::flight {
+
+using halo::common::base::Status;
+
+// Hands result batches from the thread running a query to the thread
+// writing them to a client. Bounded by bytes rather than by count, so a
+// slow client pauses the producer once `max_bytes' of converted batches
+// are waiting, whatever the batch size.
+//
+// One producer, one consumer.
+export template <typename T>
+class BatchQueue final {
+ public:
+  explicit BatchQueue(std::uint64_t max_bytes) : max_bytes_(max_bytes) {}
+
+  BatchQueue(const BatchQueue&) = delete;
+  BatchQueue& operator=(const BatchQueue&) = delete;
+
+  // Blocks while the queue holds `max_bytes' or more. An empty queue always
+  // admits the item, so a batch larger than the bound still moves. Returns
+  // false, dropping `item', once the consumer has cancelled.
+  bool push(T item, std::uint64_t bytes) {
+    std::unique_lock lock(mutex_);
+    space_available_.wait(lock, [&] {
+      return cancelled_ || items_.empty() || queued_bytes_ < max_bytes_;
+    });
+    if (cancelled_) {
+      return false;
+    }
+    items_.emplace_back(std::move(item), bytes);
+    queued_bytes_ += bytes;
+    item_available_.notify_one();
+    return true;
+  }
+
+  // Ends the stream after the queued items. `status' is reported by
+  // status() once pop() has drained them. No-op after cancel().
+  void close(Status status) {
+    std::lock_guard lock(mutex_);
+    if (closed_) {
+      return;
+    }
+    closed_ = true;
+    status_ = std::move(status);
+    item_available_.notify_one();
+  }
+
+  // Drops the queued items, fails every later push() and, unless the
+  // producer has closed the stream already, ends it with `status'. Wakes
+  // both sides.
+  void cancel(Status status = Status::QueryExecutorError("stream cancelled")) {
+    std::lock_guard lock(mutex_);
+    if (!closed_) {
+      closed_ = true;
+      status_ = std::move(status);
+    }
+    cancelled_ = true;
+    items_.clear();
+    queued_bytes_ = 0;
+    space_available_.notify_one();
+    item_available_.notify_one();
+  }
+
+  [[nodiscard]] bool cancelled() const {
+    std::lock_guard lock(mutex_);
+    return cancelled_;
+  }
+
+  // Blocks for the next item; nullopt at the end of the stream.
+  std::optional<T> pop() {
+    std::unique_lock lock(mutex_);
+    item_available_.wait(lock, [&] { return closed_ || !items_.empty(); });
+    if (items_.empty()) {
+      return std::nullopt;
+    }
+    auto [item, bytes] = std::move(items_.front());
+    items_.pop_front();
+    queued_bytes_ -= bytes;
+    space_available_.notify_one();
+    return std::move(item);
+  }
+
+  // How the producer ended the stream; OK until close().
+  [[nodiscard]] Status status() const {
+    std::lock_guard lock(mutex_);
+    return status_;
+  }
+
+  [[nodiscard]] std::uint64_t queuedBytes() const {
+    std::lock_guard lock(mutex_);
+    return queued_bytes_;
+  }
+
+ private:
+  const std::uint64_t max_bytes_;
+  mutable std::mutex mutex_;
+  std::condition_variable space_available_;
+  std::condition_variable item_available_;
+  std::deque<std::pair<T, std::uint64_t>> items_;
+  std::uint64_t queued_bytes_ = 0;
+  Status status_ = Status::OK();
+  bool closed_ = false;
+  bool cancelled_ = false;
+};
+
+}  // namespace halo::server::flight
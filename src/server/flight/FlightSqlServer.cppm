@@ -0,0 +1,166 @@
+module;
+#include <arrow/flight/api.h>
+#include <arrow/flight/sql/api.h>
+#include <arrow/flight/sql/server.h>
+#include <arrow/ipc/options.h>
+#include <arrow/result.h>
+#include <arrow/status.h>
+#include <arrow/util/compression.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+
+export module halo.server.flight:FlightSqlServer;
+import halo.common;
+import halo.common.threads;
+import halo.server.engine;
+import :ArrowExport;
+import :ResultStream;
+
+namespace halo::server::flight {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+using halo::server::engine::QueryEngine;
+
+namespace velox = facebook::velox;
+
+export enum class IpcCompression : std::uint8_t {
+  kNone,
+  kLz4,
+  kZstd,
+};
+
+export struct FlightSqlOptions {
+  StreamOptions stream;
+  // Threads running DoGet queries; more DoGets wait for one. They are
+  // reserved from the process's thread budget.
+  std::size_t query_threads =
+      std::max(1U, std::thread::hardware_concurrency());
+  // Compression of the IPC message bodies sent to clients. LZ4 costs little
+  // CPU; zstd compresses further for slow links.
+  IpcCompression compression = IpcCompression::kNone;
+};
+
+// Arrow Flight SQL endpoint over a QueryEngine. GetFlightInfo plans a
+// statement and returns a single endpoint whose ticket carries the query;
+// DoGet runs it and streams the result as Arrow record batches converted
+// from the Velox vectors without copying fixed-width data.
+//
+// Each DoGet runs its query on one of `query_threads' in a memory pool
+// capped at `stream.memory_limit_bytes'. The gRPC writer pulls batches only
+// as fast as the client takes them, so a slow client pauses its query once
+// `stream.max_queued_bytes' are waiting; a client that goes away cancels
+// it.
+export class FlightSqlServer final
+    : public arrow::flight::sql::FlightSqlServerBase {
+ public:
+  static StatusOr<std::unique_ptr<FlightSqlServer>> create(
+      std::shared_ptr<QueryEngine> engine, const FlightSqlOptions& options) {
+    if (engine == nullptr) {
+      return Status::Invalid("query engine must not be null");
+    }
+    if (options.stream.max_queued_bytes == 0) {
+      return Status::Invalid("max_queued_bytes must be positive");
+    }
+    if (options.query_threads == 0) {
+      return Status::Invalid("query_threads must be positive");
+    }
+    auto write_options = arrow::ipc::IpcWriteOptions::Defaults();
+    if (options.compression != IpcCompression::kNone) {
+      // Flight clients only decode the LZ4 frame format.
+      auto codec = arrow::util::Codec::Create(
+          options.compression == IpcCompression::kLz4
+              ? arrow::Compression::LZ4_FRAME
+              : arrow::Compression::ZSTD);
+      if (!codec.ok()) {
+        return fromArrow(codec.status());
+      }
+      write_options.codec = std::move(*codec);
+    }
+    return std::unique_ptr<FlightSqlServer>(
+        new FlightSqlServer(std::move(engine), options, write_options));
+  }
+
+  // Serves on `host':`port'. Port 0 picks a free one, see port().
+  Status listen(const std::string& host, int port) {
+    auto location = arrow::flight::Location::ForGrpcTcp(host, port);
+    if (!location.ok()) {
+      return fromArrow(location.status());
+    }
+    return fromArrow(Init(arrow::flight::FlightServerOptions(*location)));
+  }
+
+  arrow::Result<std::unique_ptr<arrow::flight::FlightInfo>>
+  GetFlightInfoStatement(
+      const arrow::flight::ServerCallContext& /*context*/,
+      const arrow::flight::sql::StatementQuery& command,
+      const arrow::flight::FlightDescriptor& descriptor) override {
+    auto row_type = engine_->describe(command.query);
+    if (!row_type.ok()) {
+      return toArrow(row_type.status());
+    }
+    auto exporter = ArrowExporter::create(
+        std::move(row_type).value(), options_.stream.string_view, pool_.get());
+    if (!exporter.ok()) {
+      return toArrow(exporter.status());
+    }
+    arrow::flight::FlightEndpoint endpoint;
+    ARROW_ASSIGN_OR_RAISE(endpoint.ticket.ticket,
+                          arrow::flight::sql::CreateStatementQueryTicket(
+                              command.query));
+    ARROW_ASSIGN_OR_RAISE(auto info, arrow::flight::FlightInfo::Make(
+                                         *exporter->schema(), descriptor,
+                                         {endpoint}, -1, -1));
+    return std::make_unique<arrow::flight::FlightInfo>(std::move(info));
+  }
+
+  arrow::Result<std::unique_ptr<arrow::flight::FlightDataStream>>
+  DoGetStatement(
+      const arrow::flight::ServerCallContext& /*context*/,
+      const arrow::flight::sql::StatementQueryTicket& command) override {
+    const std::string& query = command.statement_handle;
+    auto row_type = engine_->describe(query);
+    if (!row_type.ok()) {
+      return toArrow(row_type.status());
+    }
+    auto stream =
+        ResultStream::start(engine_, query, std::move(row_type).value(),
+                            options_.stream, queries_.get());
+    if (!stream.ok()) {
+      return toArrow(stream.status());
+    }
+    return std::make_unique<arrow::flight::RecordBatchStream>(
+        std::move(stream).value(), write_options_);
+  }
+
+ private:
+  FlightSqlServer(std::shared_ptr<QueryEngine> engine,
+                  const FlightSqlOptions& options,
+                  arrow::ipc::IpcWriteOptions write_options)
+      : engine_(std::move(engine)),
+        options_(options),
+        write_options_(std::move(write_options)),
+        pool_(velox::memory::memoryManager()->addLeafPool("flight_sql")),
+        queries_(common::threads::makeBudgetedExecutor(
+            common::threads::ThreadBudget::global(), options.query_threads,
+            "FlightQuery")) {}
+
+  std::shared_ptr<QueryEngine> engine_;
+  FlightSqlOptions options_;
+  arrow::ipc::IpcWriteOptions write_options_;
+  // Only for describing result types.
+  std::shared_ptr<velox::memory::MemoryPool> pool_;
+  // Destroyed first, which waits for the queries still running.
+  std::shared_ptr<folly::CPUThreadPoolExecutor> queries_;
+};
+
+}  // namespace halo::server::flight
@@ -0,0 +1,166 @@
+module;
+#include <arrow/record_batch.h>
+#include <arrow/status.h>
+#include <arrow/type.h>
+#include <arrow/util/byte_size.h>
+#include <folly/Executor.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <utility>
+
+export module halo.server.flight:ResultStream;
+import halo.common;
+import halo.server.engine;
+import :ArrowExport;
+import :BatchQueue;
+
+namespace halo::server::flight {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+using halo::server::engine::QueryEngine;
+
+namespace velox = facebook::velox;
+
+export struct StreamOptions {
+  // Bytes of converted batches held for a client that reads slower than
+  // the query produces; the query waits beyond that.
+  std::uint64_t max_queued_bytes = 64ULL << 20;
+  // Capacity of the memory pool a statement runs in, queued batches
+  // included. 0 leaves it unlimited.
+  std::uint64_t memory_limit_bytes = 1ULL << 30;
+  // Export VARCHAR as Arrow string views, which avoids copying strings but
+  // needs a client that reads Utf8View.
+  bool string_view = false;
+};
+
+// Runs one statement as a task on `executor' and reads its result as Arrow
+// record batches. The executor bounds how many statements run at once;
+// later ones wait for a thread.
+//
+// cancel(), or destroying the stream before the end, ends the stream for
+// the reader at once and stops the query without waiting for it: a query
+// not yet started never runs, and a running one is stopped when it hands
+// over its next batch, or right away if it is waiting for the reader. The
+// task keeps what it uses alive until it returns.
+export class ResultStream final : public arrow::RecordBatchReader {
+ public:
+  static StatusOr<std::shared_ptr<ResultStream>> start(
+      std::shared_ptr<QueryEngine> engine, std::string query,
+      velox::RowTypePtr row_type, const StreamOptions& options,
+      folly::Executor* executor) {
+    if (executor == nullptr) {
+      return Status::Invalid("result stream needs an executor");
+    }
+    static std::atomic<std::uint64_t> next_id = 0;
+    const std::string name = "flight_stream_" + std::to_string(next_id++);
+    auto root = velox::memory::memoryManager()->addRootPool(
+        name, options.memory_limit_bytes == 0
+                  ? velox::memory::kMaxMemory
+                  : static_cast<std::int64_t>(options.memory_limit_bytes));
+    auto pool = root->addLeafChild(name);
+    auto exporter =
+        ArrowExporter::create(std::move(row_type), options.string_view,
+                              pool.get());
+    if (!exporter.ok()) {
+      return exporter.status();
+    }
+    auto state = std::make_shared<State>(std::move(root), std::move(pool),
+                                         std::move(exporter).value(),
+                                         options.max_queued_bytes);
+    executor->add([state, engine = std::move(engine),
+                   query = std::move(query)] { state->run(*engine, query); });
+    return std::shared_ptr<ResultStream>(new ResultStream(std::move(state)));
+  }
+
+  ResultStream(const ResultStream&) = delete;
+  ResultStream& operator=(const ResultStream&) = delete;
+
+  ~ResultStream() override { cancel(); }
+
+  [[nodiscard]] std::shared_ptr<arrow::Schema> schema() const override {
+    return state_->exporter.schema();
+  }
+
+  // Waits for the next batch. Sets `batch' to null at the end of the result
+  // and returns the query's error if it failed.
+  arrow::Status ReadNext(std::shared_ptr<arrow::RecordBatch>* batch) override {
+    auto next = state_->queue.pop();
+    if (next.has_value()) {
+      *batch = std::move(*next);
+      return arrow::Status::OK();
+    }
+    batch->reset();
+    return toArrow(state_->queue.status());
+  }
+
+  // Ends the stream with a cancellation error and stops the query. Safe
+  // from any thread, also while another one waits in ReadNext().
+  void cancel() {
+    state_->queue.cancel(Status::QueryExecutorError("query cancelled"));
+  }
+
+ private:
+  // What the reader shares with the task running the query.
+  struct State {
+    State(std::shared_ptr<velox::memory::MemoryPool> root,
+          std::shared_ptr<velox::memory::MemoryPool> pool,
+          ArrowExporter exporter, std::uint64_t max_queued_bytes)
+        : root(std::move(root)),
+          pool(std::move(pool)),
+          exporter(std::move(exporter)),
+          queue(max_queued_bytes) {}
+
+    void run(QueryEngine& engine, const std::string& query) {
+      if (queue.cancelled()) {
+        return;
+      }
+      Status status = Status::OK();
+      try {
+        status = engine.execute(
+            query, pool.get(), [this](velox::RowVectorPtr batch) -> Status {
+              if (queue.cancelled()) {
+                return Status::QueryExecutorError("query cancelled");
+              }
+              if (batch->size() == 0) {
+                return Status::OK();
+              }
+              auto record_batch = exporter.exportBatch(batch);
+              if (!record_batch.ok()) {
+                return record_batch.status();
+              }
+              const auto bytes = static_cast<std::uint64_t>(
+                  arrow::util::TotalBufferSize(**record_batch));
+              if (!queue.push(std::move(record_batch).value(), bytes)) {
+                return Status::QueryExecutorError("query cancelled");
+              }
+              return Status::OK();
+            });
+      } catch (const std::exception& e) {
+        // Velox reports exceeding the pool capacity by throwing.
+        status = Status::QueryExecutorError(e.what());
+      }
+      queue.close(std::move(status));
+    }
+
+    // Batches borrow their buffers from `pool', so the pools go last.
+    std::shared_ptr<velox::memory::MemoryPool> root;
+    std::shared_ptr<velox::memory::MemoryPool> pool;
+    ArrowExporter exporter;
+    BatchQueue<std::shared_ptr<arrow::RecordBatch>> queue;
+  };
+
+  explicit ResultStream(std::shared_ptr<State> state)
+      : state_(std::move(state)) {}
+
+  const std::shared_ptr<State> state_;
+};
+
+}  // namespace halo::server::flight
@@ -0,0 +1,5 @@
+export module halo.server.flight;
+export import :ArrowExport;
+export import :BatchQueue;
+export import :FlightSqlServer;
+export import :ResultStream;
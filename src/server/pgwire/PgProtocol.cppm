@@ -0,0 +1,195 @@
+module;
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+export module halo.server.pgwire:PgProtocol;
+import halo.common;
+
+namespace halo::server::pgwire {
+
+using halo::common::base::Status;
+
+// PostgreSQL frontend/backend protocol 3.0 framing.
+// https://www.postgresql.org/docs/current/protocol-message-formats.html
+
+export constexpr std::int32_t kProtocolVersion3 = 196608;
+export constexpr std::int32_t kSslRequestCode = 80877103;
+export constexpr std::int32_t kGssEncRequestCode = 80877104;
+export constexpr std::int32_t kCancelRequestCode = 80877102;
+
+// Frontend messages are bounded to keep a bad length from allocating
+// without limit; queries are the only large ones.
+export constexpr std::size_t kMaxMessageBytes = 64 * 1024 * 1024;
+
+// One message from the client, without its length. Messages before and
+// including the startup packet carry no type byte and have `type' == 0.
+export struct PgFrame {
+  char type = 0;
+  std::string body;
+};
+
+// Type byte of the backend messages halo sends.
+export namespace backend {
+constexpr char kAuthentication = 'R';
+constexpr char kBackendKeyData = 'K';
+constexpr char kBindComplete = '2';
+constexpr char kCloseComplete = '3';
+constexpr char kCommandComplete = 'C';
+constexpr char kCopyData = 'd';
+constexpr char kCopyDone = 'c';
+constexpr char kCopyOutResponse = 'H';
+constexpr char kDataRow = 'D';
+constexpr char kEmptyQueryResponse = 'I';
+constexpr char kErrorResponse = 'E';
+constexpr char kNoData = 'n';
+constexpr char kParameterDescription = 't';
+constexpr char kParameterStatus = 'S';
+constexpr char kParseComplete = '1';
+constexpr char kReadyForQuery = 'Z';
+constexpr char kRowDescription = 'T';
+}  // namespace backend
+
+template <typename T>
+void appendBigEndian(std::string& out, T value) {
+  const auto bits = std::byteswap(std::bit_cast<
+      std::conditional_t<sizeof(T) == 2, std::uint16_t,
+                         std::conditional_t<sizeof(T) == 4, std::uint32_t,
+                                            std::uint64_t>>>(value));
+  out.append(reinterpret_cast<const char*>(&bits), sizeof(bits));
+}
+
+// Appends backend messages to a byte string. begin() writes the type and
+// a length placeholder that end() fills in.
+export class MessageWriter final {
+ public:
+  explicit MessageWriter(std::string& out) : out_(out) {}
+
+  MessageWriter& begin(char type) {
+    out_.push_back(type);
+    start_ = out_.size();
+    out_.append(4, '\0');
+    return *this;
+  }
+
+  MessageWriter& int8(std::uint8_t value) {
+    out_.push_back(static_cast<char>(value));
+    return *this;
+  }
+
+  MessageWriter& int16(std::int16_t value) {
+    appendBigEndian(out_, value);
+    return *this;
+  }
+
+  MessageWriter& int32(std::int32_t value) {
+    appendBigEndian(out_, value);
+    return *this;
+  }
+
+  MessageWriter& cstring(std::string_view value) {
+    out_.append(value);
+    out_.push_back('\0');
+    return *this;
+  }
+
+  MessageWriter& bytes(std::string_view value) {
+    out_.append(value);
+    return *this;
+  }
+
+  void end() {
+    const auto length = static_cast<std::uint32_t>(out_.size() - start_);
+    const auto bits = std::byteswap(length);
+    std::memcpy(out_.data() + start_, &bits, sizeof(bits));
+  }
+
+ private:
+  std::string& out_;
+  std::size_t start_ = 0;
+};
+
+// Reads the fields of a frontend message body. Reads past the end set the
+// reader to failed and return zero values, so a handler can read all
+// fields and check status() once.
+export class MessageReader final {
+ public:
+  explicit MessageReader(std::string_view body) : body_(body) {}
+
+  std::uint8_t int8() { return read<std::uint8_t>(); }
+  std::int16_t int16() { return read<std::int16_t>(); }
+  std::int32_t int32() { return read<std::int32_t>(); }
+
+  std::string_view cstring() {
+    const auto end = body_.find('\0', offset_);
+    if (end == std::string_view::npos) {
+      failed_ = true;
+      return {};
+    }
+    auto value = body_.substr(offset_, end - offset_);
+    offset_ = end + 1;
+    return value;
+  }
+
+  // `length' bytes, or a NULL value for -1.
+  std::optional<std::string_view> bytes(std::int32_t length) {
+    if (length < 0) {
+      return std::nullopt;
+    }
+    if (static_cast<std::size_t>(length) > body_.size() - offset_) {
+      failed_ = true;
+      return std::string_view();
+    }
+    auto value = body_.substr(offset_, static_cast<std::size_t>(length));
+    offset_ += static_cast<std::size_t>(length);
+    return value;
+  }
+
+  [[nodiscard]] bool atEnd() const { return offset_ == body_.size(); }
+
+  [[nodiscard]] Status status(std::string_view message) const {
+    if (failed_) {
+      return Status::Invalid("malformed " + std::string(message) +
+                             " message");
+    }
+    return Status::OK();
+  }
+
+ private:
+  template <typename T>
+  T read() {
+    if (body_.size() - offset_ < sizeof(T)) {
+      failed_ = true;
+      offset_ = body_.size();
+      return 0;
+    }
+    std::make_unsigned_t<T> bits;
+    std::memcpy(&bits, body_.data() + offset_, sizeof(T));
+    offset_ += sizeof(T);
+    return static_cast<T>(std::byteswap(bits));
+  }
+
+  std::string_view body_;
+  std::size_t offset_ = 0;
+  bool failed_ = false;
+};
+
+// Length of the frame starting at `header', which holds at least 5 bytes
+// (4 before startup), or 0 if the length field is invalid.
+export std::size_t frameLength(std::string_view header, bool startup) {
+  const std::size_t skip = startup ? 0 : 1;
+  MessageReader reader(header.substr(skip, 4));
+  const std::int32_t length = reader.int32();
+  if (length < 4 || static_cast<std::size_t>(length) > kMaxMessageBytes) {
+    return 0;
+  }
+  return skip + static_cast<std::size_t>(length);
+}
+
+}  // namespace halo::server::pgwire
@@ -0,0 +1,342 @@
+module;
+#include <folly/Executor.h>
+#include <folly/SocketAddress.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/executors/IOThreadPoolExecutor.h>
+#include <folly/executors/SerialExecutor.h>
+#include <folly/futures/Future.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/IOBufQueue.h>
+#include <folly/io/async/AsyncTransport.h>
+#include <folly/io/async/EventBase.h>
+#include <velox/common/memory/Memory.h>
+#include <wangle/bootstrap/ServerBootstrap.h>
+#include <wangle/channel/AsyncSocketHandler.h>
+#include <wangle/channel/EventBaseHandler.h>
+#include <wangle/channel/Handler.h>
+#include <wangle/channel/Pipeline.h>
+#include <wangle/codec/ByteToMessageDecoder.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+export module halo.server.pgwire:PgServer;
+import halo.common;
+import halo.common.threads;
+import halo.server.engine;
+import :PgProtocol;
+import :PgSession;
+
+namespace halo::server::pgwire {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+using halo::server::engine::QueryEngine;
+
+namespace velox = facebook::velox;
+
+using PgPipeline =
+    wangle::Pipeline<folly::IOBufQueue&, std::unique_ptr<folly::IOBuf>>;
+
+// Splits the byte stream into protocol messages.
+class PgFrameDecoder final : public wangle::ByteToMessageDecoder<PgFrame> {
+ public:
+  bool decode(Context* ctx, folly::IOBufQueue& buf, PgFrame& result,
+              std::size_t& needed) override {
+    const std::size_t header_bytes = startup_ ? 4 : 5;
+    const std::size_t available = buf.chainLength();
+    if (available < header_bytes) {
+      needed = header_bytes - available;
+      return false;
+    }
+    folly::io::Cursor cursor(buf.front());
+    const std::string header = cursor.readFixedString(header_bytes);
+    const std::size_t length = frameLength(header, startup_);
+    if (length == 0) {
+      ctx->fireClose();
+      return false;
+    }
+    if (available < length) {
+      needed = length - available;
+      return false;
+    }
+    result.type = startup_ ? 0 : header[0];
+    result.body = cursor.readFixedString(length - header_bytes);
+    buf.trimStart(length);
+    // SSL and GSSAPI requests are followed by another untyped packet.
+    if (startup_ && MessageReader(result.body).int32() == kProtocolVersion3) {
+      startup_ = false;
+    }
+    return true;
+  }
+
+ private:
+  bool startup_ = true;
+};
+
+// State shared by a connection's pipeline handler, which lives on its
+// event base, and the session tasks, which run in order on the worker pool.
+class PgConnection final
+    : public std::enable_shared_from_this<PgConnection> {
+ public:
+  PgConnection(folly::EventBase* event_base, PgPipeline::Context* context)
+      : event_base_(event_base), context_(context) {}
+
+  void start(std::shared_ptr<QueryEngine> engine,
+             std::shared_ptr<velox::memory::MemoryPool> pool,
+             PgSessionOptions options) {
+    session_.emplace(
+        std::move(engine), std::move(pool),
+        [self = weak_from_this()](std::string bytes) {
+          auto connection = self.lock();
+          return connection == nullptr
+                     ? Status::StorageError("connection closed")
+                     : connection->write(std::move(bytes));
+        },
+        std::move(options));
+  }
+
+  // On the worker.
+  void handle(const PgFrame& frame) {
+    if (done_) {
+      return;
+    }
+    if (!session_->handle(frame)) {
+      done_ = true;
+      (void)drain();
+      folly::via(folly::getKeepAliveToken(event_base_),
+                 [self = shared_from_this()] {
+                   if (!self->closed_) {
+                     self->context_->fireClose();
+                   }
+                 });
+    }
+  }
+
+  // On the event base, once the transport is gone.
+  void closed() {
+    closed_ = true;
+    session_->cancel();
+  }
+
+ private:
+  // Hands `bytes' to the event base after the previous write completed, so
+  // one write is in flight while the next batch is being encoded and a
+  // slow client holds back the query.
+  Status write(std::string bytes) {
+    auto status = drain();
+    if (!status.ok()) {
+      return status;
+    }
+    in_flight_ = folly::via(
+        folly::getKeepAliveToken(event_base_),
+        [self = shared_from_this(),
+         bytes = std::move(bytes)]() mutable -> folly::Future<folly::Unit> {
+          if (self->closed_) {
+            return folly::makeFuture<folly::Unit>(
+                std::runtime_error("connection closed"));
+          }
+          return self->context_->fireWrite(
+              folly::IOBuf::fromString(std::move(bytes)));
+        });
+    return Status::OK();
+  }
+
+  Status drain() {
+    if (!in_flight_.valid()) {
+      return Status::OK();
+    }
+    try {
+      std::move(in_flight_).get();
+    } catch (const std::exception& e) {
+      return Status::StorageError(e.what());
+    }
+    return Status::OK();
+  }
+
+  folly::EventBase* const event_base_;
+  // Only used on the event base while `closed_' is unset.
+  PgPipeline::Context* const context_;
+  std::optional<PgSession> session_;
+  folly::Future<folly::Unit> in_flight_ =
+      folly::Future<folly::Unit>::makeEmpty();
+  std::atomic<bool> closed_ = false;
+  bool done_ = false;
+};
+
+class PgConnectionHandler final
+    : public wangle::HandlerAdapter<PgFrame, std::unique_ptr<folly::IOBuf>> {
+ public:
+  PgConnectionHandler(std::shared_ptr<QueryEngine> engine,
+                      folly::Executor* workers, PgSessionOptions options)
+      : engine_(std::move(engine)),
+        worker_(folly::SerialExecutor::create(
+            folly::getKeepAliveToken(workers))),
+        options_(std::move(options)) {}
+
+  void transportActive(Context* ctx) override {
+    static std::atomic<std::int32_t> next_id = 1;
+    options_.process_id = next_id++;
+    connection_ = std::make_shared<PgConnection>(
+        ctx->getTransport()->getEventBase(), ctx);
+    connection_->start(engine_,
+                       velox::memory::memoryManager()->addLeafPool(
+                           "pgwire_" + std::to_string(options_.process_id)),
+                       options_);
+    ctx->fireTransportActive();
+  }
+
+  void read(Context* /*ctx*/, PgFrame frame) override {
+    worker_->add([connection = connection_, frame = std::move(frame)] {
+      connection->handle(frame);
+    });
+  }
+
+  void readEOF(Context* ctx) override {
+    connection_->closed();
+    ctx->fireClose();
+  }
+
+  void readException(Context* ctx, folly::exception_wrapper /*e*/) override {
+    connection_->closed();
+    ctx->fireClose();
+  }
+
+  void transportInactive(Context* ctx) override {
+    if (connection_ != nullptr) {
+      connection_->closed();
+    }
+    ctx->fireTransportInactive();
+  }
+
+  void detachPipeline(Context* /*ctx*/) override {
+    if (connection_ != nullptr) {
+      connection_->closed();
+    }
+  }
+
+ private:
+  std::shared_ptr<QueryEngine> engine_;
+  folly::Executor::KeepAlive<folly::SerialExecutor> worker_;
+  PgSessionOptions options_;
+  std::shared_ptr<PgConnection> connection_;
+};
+
+class PgPipelineFactory final : public wangle::PipelineFactory<PgPipeline> {
+ public:
+  PgPipelineFactory(std::shared_ptr<QueryEngine> engine,
+                    std::shared_ptr<folly::CPUThreadPoolExecutor> workers,
+                    PgSessionOptions options)
+      : engine_(std::move(engine)),
+        workers_(std::move(workers)),
+        options_(std::move(options)) {}
+
+  PgPipeline::Ptr newPipeline(
+      std::shared_ptr<folly::AsyncTransport> socket) override {
+    auto pipeline = PgPipeline::create();
+    pipeline->addBack(wangle::AsyncSocketHandler(std::move(socket)));
+    pipeline->addBack(wangle::EventBaseHandler());
+    pipeline->addBack(PgFrameDecoder());
+    pipeline->addBack(
+        std::make_shared<PgConnectionHandler>(engine_, workers_.get(),
+                                              options_));
+    pipeline->finalize();
+    return pipeline;
+  }
+
+ private:
+  std::shared_ptr<QueryEngine> engine_;
+  // Not a keep-alive token, which would make joining the pool wait for the
+  // server to go away.
+  std::shared_ptr<folly::CPUThreadPoolExecutor> workers_;
+  PgSessionOptions options_;
+};
+
+export struct PgServerOptions {
+  // Event loops; they only move bytes.
+  std::size_t io_threads = 1;
+  // Threads running queries and encoding results. Each connection handles
+  // its messages in order on one of them at a time. They are reserved from
+  // the process's thread budget, so library calls made on them, such as
+  // FAISS searches, don't start a team per core of their own.
+  std::size_t worker_threads =
+      std::max(1U, std::thread::hardware_concurrency());
+  PgSessionOptions session;
+};
+
+// PostgreSQL wire protocol front end on a Wangle pipeline per connection:
+// socket, event base, message framing and a handler feeding PgSession.
+// Sessions run on a worker pool so that queries never block the event
+// loops; result batches are written as they are encoded.
+export class PgServer final {
+ public:
+  static StatusOr<std::unique_ptr<PgServer>> create(
+      std::shared_ptr<QueryEngine> engine, const PgServerOptions& options) {
+    if (engine == nullptr) {
+      return Status::Invalid("query engine must not be null");
+    }
+    if (options.io_threads == 0 || options.worker_threads == 0) {
+      return Status::Invalid("thread counts must be positive");
+    }
+    return std::unique_ptr<PgServer>(new PgServer(std::move(engine), options));
+  }
+
+  PgServer(const PgServer&) = delete;
+  PgServer& operator=(const PgServer&) = delete;
+
+  ~PgServer() { stop(); }
+
+  // Accepts connections on `port'. Port 0 picks a free one, see port().
+  Status listen(std::uint16_t port) {
+    try {
+      bootstrap_.bind(port);
+    } catch (const std::exception& e) {
+      return Status::StorageError("cannot listen on port " +
+                                  std::to_string(port) + ": " + e.what());
+    }
+    folly::SocketAddress address;
+    bootstrap_.getSockets().front()->getAddress(&address);
+    port_ = address.getPort();
+    return Status::OK();
+  }
+
+  [[nodiscard]] std::uint16_t port() const { return port_; }
+
+  void stop() {
+    if (stopped_.exchange(true)) {
+      return;
+    }
+    bootstrap_.stop();
+    bootstrap_.join();
+    workers_->join();
+  }
+
+ private:
+  PgServer(std::shared_ptr<QueryEngine> engine, const PgServerOptions& options)
+      : workers_(common::threads::makeBudgetedExecutor(
+            common::threads::ThreadBudget::global(), options.worker_threads,
+            "PgWorker")) {
+    bootstrap_.childPipeline(std::make_shared<PgPipelineFactory>(
+        std::move(engine), workers_, options.session));
+    bootstrap_.group(
+        std::make_shared<folly::IOThreadPoolExecutor>(1),
+        std::make_shared<folly::IOThreadPoolExecutor>(options.io_threads));
+  }
+
+  std::shared_ptr<folly::CPUThreadPoolExecutor> workers_;
+  wangle::ServerBootstrap<PgPipeline> bootstrap_;
+  std::uint16_t port_ = 0;
+  std::atomic<bool> stopped_ = false;
+};
+
+}  // namespace halo::server::pgwire
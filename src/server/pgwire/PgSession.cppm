@@ -0,0 +1,729 @@
+module;
+#include <velox/common/memory/MemoryPool.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+export module halo.server.pgwire:PgSession;
+import halo.common;
+import halo.result.text;
+import halo.server.engine;
+import :PgProtocol;
+import :RowEncoder;
+
+namespace halo::server::pgwire {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+using halo::server::engine::QueryEngine;
+
+namespace velox = facebook::velox;
+
+// Writes bytes to the client. May block while earlier output is still in
+// flight, which is how a slow client slows its query down.
+export using WireSink = std::function<Status(std::string)>;
+
+export struct PgSessionOptions {
+  // Reported as server_version; drivers pick protocol features by it.
+  std::string server_version = "14.0";
+  std::int32_t process_id = 0;
+};
+
+std::string_view trim(std::string_view text) {
+  while (!text.empty() && (std::isspace(static_cast<unsigned char>(
+                               text.front())) != 0)) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() &&
+         (std::isspace(static_cast<unsigned char>(text.back())) != 0 ||
+          text.back() == ';')) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+// Whether `c' can continue an SQL identifier, so that `SETTINGS' or
+// `SET_X' do not start with the keyword SET.
+bool isIdentifierChar(char c) {
+  const auto byte = static_cast<unsigned char>(c);
+  return std::isalnum(byte) != 0 || c == '_' || c == '$' || byte >= 0x80;
+}
+
+bool startsWithKeyword(std::string_view text, std::string_view keyword) {
+  if (text.size() < keyword.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < keyword.size(); ++i) {
+    if (std::toupper(static_cast<unsigned char>(text[i])) != keyword[i]) {
+      return false;
+    }
+  }
+  return text.size() == keyword.size() ||
+         !isIdentifierChar(text[keyword.size()]);
+}
+
+// Command tag of a transaction control statement, or nullopt for any other
+// statement.
+std::optional<std::string_view> transactionTag(std::string_view query) {
+  if (startsWithKeyword(query, "BEGIN") || startsWithKeyword(query, "START")) {
+    return "BEGIN";
+  }
+  if (startsWithKeyword(query, "COMMIT") || startsWithKeyword(query, "END")) {
+    return "COMMIT";
+  }
+  if (startsWithKeyword(query, "ROLLBACK") ||
+      startsWithKeyword(query, "ABORT")) {
+    return "ROLLBACK";
+  }
+  return std::nullopt;
+}
+
+// Statements the session answers itself, without the engine.
+bool isSessionCommand(std::string_view query) {
+  return startsWithKeyword(query, "SET") || transactionTag(query).has_value();
+}
+
+// `COPY (query) TO STDOUT [WITH] [(FORMAT text|csv, HEADER [bool])]' or
+// the old `CSV [HEADER]' spelling.
+struct CopyCommand {
+  std::string query;
+  bool csv = false;
+  bool header = false;
+};
+
+StatusOr<CopyCommand> parseCopy(std::string_view text) {
+  text = trim(text.substr(4));
+  if (text.empty() || text.front() != '(') {
+    return Status::NotImplemented(
+        "only COPY (query) TO STDOUT is supported");
+  }
+  // Find the parenthesis closing the query, skipping quoted text.
+  int depth = 0;
+  char quote = 0;
+  std::size_t close = 0;
+  for (std::size_t i = 0; i < text.size() && close == 0; ++i) {
+    const char c = text[i];
+    if (quote != 0) {
+      quote = c == quote ? 0 : quote;
+    } else if (c == '\'' || c == '"') {
+      quote = c;
+    } else if (c == '(') {
+      ++depth;
+    } else if (c == ')' && --depth == 0) {
+      close = i;
+    }
+  }
+  if (close == 0) {
+    return Status::SqlError("unterminated query in COPY");
+  }
+  CopyCommand command{.query = std::string(text.substr(1, close - 1))};
+
+  std::vector<std::string> words;
+  std::string word;
+  for (const char c : text.substr(close + 1)) {
+    if (std::isspace(static_cast<unsigned char>(c)) != 0 || c == '(' ||
+        c == ')' || c == ',') {
+      if (!word.empty()) {
+        words.push_back(std::move(word));
+        word.clear();
+      }
+    } else {
+      word.push_back(static_cast<char>(std::toupper(c)));
+    }
+  }
+  if (!word.empty()) {
+    words.push_back(std::move(word));
+  }
+  if (words.size() < 2 || words[0] != "TO" || words[1] != "STDOUT") {
+    return Status::NotImplemented("COPY only writes TO STDOUT");
+  }
+  for (std::size_t i = 2; i < words.size(); ++i) {
+    if (words[i] == "WITH") {
+      continue;
+    }
+    if (words[i] == "CSV") {
+      command.csv = true;
+    } else if (words[i] == "FORMAT" && i + 1 < words.size() &&
+               (words[i + 1] == "CSV" || words[i + 1] == "TEXT")) {
+      command.csv = words[++i] == "CSV";
+    } else if (words[i] == "HEADER") {
+      command.header = true;
+      if (i + 1 < words.size() &&
+          (words[i + 1] == "TRUE" || words[i + 1] == "FALSE")) {
+        command.header = words[++i] == "TRUE";
+      }
+    } else {
+      return Status::NotImplemented("unsupported COPY option " + words[i]);
+    }
+  }
+  return command;
+}
+
+// SQLSTATE of an error of a statement. Malformed messages are reported as
+// protocol_violation (08P01) where they are decoded.
+std::string_view sqlState(const Status& status) {
+  switch (status.code()) {
+    case Status::Code::kInvalid:
+      return "22023";  // invalid_parameter_value
+    case Status::Code::kNotImplemented:
+      return "0A000";  // feature_not_supported
+    case Status::Code::kStorageError:
+      return "58030";  // io_error
+    case Status::Code::kSqlError:
+    case Status::Code::kQueryOptimizerError:
+      return "42601";  // syntax_error
+    default:
+      return "XX000";  // internal_error
+  }
+}
+
+// One client connection's protocol state: startup, simple query, extended
+// query (Parse/Bind/Describe/Execute/Sync) and COPY TO STDOUT.
+//
+// Results are streamed: every batch the engine produces is encoded and
+// handed to the sink before the engine is asked for the next, so the first
+// rows reach the client while the query is still running. Parameters in
+// Bind are not supported and the Execute row limit is ignored. There is no
+// authentication.
+//
+// Transaction blocks are tracked for the status ReadyForQuery reports and
+// for refusing statements after an error until the block ends, as drivers
+// expect. The engine still runs every statement on its own, so ROLLBACK
+// undoes nothing.
+//
+// handle() must be called from one thread at a time; cancel() from any.
+export class PgSession final {
+ public:
+  PgSession(std::shared_ptr<QueryEngine> engine,
+            std::shared_ptr<velox::memory::MemoryPool> pool, WireSink sink,
+            PgSessionOptions options)
+      : engine_(std::move(engine)),
+        pool_(std::move(pool)),
+        sink_(std::move(sink)),
+        options_(std::move(options)) {}
+
+  // Handles one frontend message. Returns false when the connection should
+  // be closed.
+  bool handle(const PgFrame& frame) {
+    if (!started_) {
+      return startup(frame);
+    }
+    if (failed_ && frame.type != 'S' && frame.type != 'X') {
+      // After an error the rest of an extended query batch is skipped.
+      return true;
+    }
+    Status status = Status::OK();
+    switch (frame.type) {
+      case 'Q':
+        simpleQuery(MessageReader(frame.body).cstring());
+        break;
+      case 'P':
+        status = parse(frame.body);
+        break;
+      case 'B':
+        status = bind(frame.body);
+        break;
+      case 'D':
+        status = describe(frame.body);
+        break;
+      case 'E':
+        status = execute(frame.body);
+        break;
+      case 'C':
+        status = close(frame.body);
+        break;
+      case 'S':
+        failed_ = false;
+        readyForQuery();
+        break;
+      case 'H':
+        break;
+      case 'X':
+        return false;
+      default:
+        status = withSqlState(kProtocolViolation,
+                              Status::Invalid("unsupported message type '" +
+                                              std::string(1, frame.type) +
+                                              "'"));
+        break;
+    }
+    if (!status.ok()) {
+      writeError(status);
+      failed_ = true;
+    }
+    // Parse, Bind, Describe and Close replies wait for Sync or Flush.
+    if (frame.type == 'Q' || frame.type == 'S' || frame.type == 'H' ||
+        frame.type == 'E') {
+      flush();
+    }
+    return !broken_;
+  }
+
+  // Makes a running query stop at its next batch and later ones fail, for
+  // when the client has gone away.
+  void cancel() { cancelled_ = true; }
+
+ private:
+  struct Statement {
+    std::string query;
+    // Null for statements without a result, such as SET.
+    velox::RowTypePtr row_type;
+  };
+
+  struct Portal {
+    Statement statement;
+    std::optional<RowEncoder> encoder;
+  };
+
+  // Transaction status as ReadyForQuery reports it.
+  enum class TransactionState : char {
+    kIdle = 'I',
+    kInBlock = 'T',
+    kFailed = 'E',
+  };
+
+  static constexpr std::string_view kProtocolViolation = "08P01";
+  static constexpr std::string_view kInFailedTransaction = "25P02";
+
+  bool startup(const PgFrame& frame) {
+    MessageReader reader(frame.body);
+    const std::int32_t code = reader.int32();
+    if (code == kCancelRequestCode) {
+      // Cancelling from another connection is not supported.
+      return false;
+    }
+    if (code == kSslRequestCode || code == kGssEncRequestCode) {
+      // No encryption; the client goes on in plain text.
+      output_.push_back('N');
+      flush();
+      return !broken_;
+    }
+    if (code != kProtocolVersion3) {
+      writeError(Status::NotImplemented("unsupported frontend protocol"),
+                 "FATAL");
+      flush();
+      return false;
+    }
+    std::string application_name;
+    while (!reader.atEnd()) {
+      const auto key = reader.cstring();
+      if (key.empty()) {
+        break;
+      }
+      const auto value = reader.cstring();
+      if (key == "application_name") {
+        application_name = value;
+      }
+    }
+    if (!reader.status("startup").ok()) {
+      return false;
+    }
+    started_ = true;
+
+    MessageWriter writer(output_);
+    writer.begin(backend::kAuthentication).int32(0).end();
+    const std::pair<std::string_view, std::string_view> parameters[] = {
+        {"server_version", options_.server_version},
+        {"server_encoding", "UTF8"},
+        {"client_encoding", "UTF8"},
+        {"DateStyle", "ISO, MDY"},
+        {"TimeZone", "UTC"},
+        {"integer_datetimes", "on"},
+        {"standard_conforming_strings", "on"},
+        {"application_name", application_name}};
+    for (const auto& [name, value] : parameters) {
+      writer.begin(backend::kParameterStatus)
+          .cstring(name)
+          .cstring(value)
+          .end();
+    }
+    writer.begin(backend::kBackendKeyData)
+        .int32(options_.process_id)
+        .int32(0)
+        .end();
+    readyForQuery();
+    flush();
+    return !broken_;
+  }
+
+  void simpleQuery(std::string_view text) {
+    const auto query = trim(text);
+    Status status = query.empty() ? Status::OK() : checkTransaction(query);
+    if (!status.ok()) {
+      // Refused in a failed transaction block.
+    } else if (query.empty()) {
+      MessageWriter(output_).begin(backend::kEmptyQueryResponse).end();
+    } else if (isSessionCommand(query)) {
+      sessionCommand(query);
+    } else if (startsWithKeyword(query, "COPY")) {
+      status = copyOut(query);
+    } else {
+      auto statement = prepare(std::string(query));
+      if (statement.ok()) {
+        auto encoder = RowEncoder::create(statement->row_type, {});
+        if (encoder.ok()) {
+          encoder->writeRowDescription(output_);
+          status = run(statement->query, *encoder);
+        } else {
+          status = encoder.status();
+        }
+      } else {
+        status = statement.status();
+      }
+    }
+    if (!status.ok()) {
+      writeError(status);
+    }
+    readyForQuery();
+  }
+
+  Status copyOut(std::string_view text) {
+    auto command = parseCopy(text);
+    if (!command.ok()) {
+      return command.status();
+    }
+    auto row_type = engine_->describe(command->query);
+    if (!row_type.ok()) {
+      return row_type.status();
+    }
+    // COPY text format is TSV with \N for NULL; COPY CSV leaves NULL
+    // unquoted empty and quotes empty strings.
+    auto formatter = result::text::ResultFormatter::create(
+        *row_type,
+        {.format = command->csv ? result::text::TextFormat::kCsv
+                                : result::text::TextFormat::kTsv,
+         .header = command->header,
+         .null_string = command->csv ? "" : "\\N",
+         .buffer_bytes = 1});
+    if (!formatter.ok()) {
+      return formatter.status();
+    }
+
+    MessageWriter writer(output_);
+    const auto columns = static_cast<std::int16_t>((*row_type)->size());
+    writer.begin(backend::kCopyOutResponse)
+        .int8(0)
+        .int16(columns);
+    for (std::int16_t i = 0; i < columns; ++i) {
+      writer.int16(0);
+    }
+    writer.end();
+
+    // A one-byte buffer makes the formatter hand over every row on its
+    // own, and each row is one CopyData message.
+    const result::text::TextSink rows = [&](std::string_view row) {
+      MessageWriter(output_).begin(backend::kCopyData).bytes(row).end();
+      return Status::OK();
+    };
+    std::int64_t count = 0;
+    auto status = stream(command->query, [&](const velox::RowVector& batch) {
+      count += batch.size();
+      return formatter->write(batch, rows);
+    });
+    if (status.ok()) {
+      status = formatter->flush(rows);
+    }
+    if (!status.ok()) {
+      return status;
+    }
+    MessageWriter(output_).begin(backend::kCopyDone).end();
+    commandComplete("COPY " + std::to_string(count));
+    return Status::OK();
+  }
+
+  StatusOr<Statement> prepare(std::string query) {
+    auto row_type = engine_->describe(query);
+    if (!row_type.ok()) {
+      return row_type.status();
+    }
+    return Statement{std::move(query), std::move(row_type).value()};
+  }
+
+  Status parse(std::string_view body) {
+    MessageReader reader(body);
+    std::string name(reader.cstring());
+    const auto query = trim(reader.cstring());
+    auto status = reader.status("Parse");
+    if (!status.ok()) {
+      return withSqlState(kProtocolViolation, std::move(status));
+    }
+    if (isSessionCommand(query) || query.empty()) {
+      statements_[name] = Statement{std::string(query), nullptr};
+    } else {
+      auto statement = prepare(std::string(query));
+      if (!statement.ok()) {
+        return statement.status();
+      }
+      statements_[name] = std::move(statement).value();
+    }
+    MessageWriter(output_).begin(backend::kParseComplete).end();
+    return Status::OK();
+  }
+
+  Status bind(std::string_view body) {
+    MessageReader reader(body);
+    std::string portal_name(reader.cstring());
+    const std::string statement_name(reader.cstring());
+    const std::int16_t parameter_formats = reader.int16();
+    for (std::int16_t i = 0; i < parameter_formats; ++i) {
+      reader.int16();
+    }
+    if (reader.int16() != 0) {
+      return Status::NotImplemented("bind parameters are not supported");
+    }
+    std::vector<std::int16_t> result_formats(
+        static_cast<std::size_t>(std::max<std::int16_t>(reader.int16(), 0)));
+    for (auto& format : result_formats) {
+      format = reader.int16();
+    }
+    auto status = reader.status("Bind");
+    if (!status.ok()) {
+      return withSqlState(kProtocolViolation, std::move(status));
+    }
+    const auto it = statements_.find(statement_name);
+    if (it == statements_.end()) {
+      return Status::SqlError("prepared statement \"" + statement_name +
+                              "\" does not exist");
+    }
+    Portal portal{.statement = it->second, .encoder = std::nullopt};
+    if (portal.statement.row_type != nullptr) {
+      auto encoder =
+          RowEncoder::create(portal.statement.row_type, result_formats);
+      if (!encoder.ok()) {
+        // Only format codes that don't fit the message are refused.
+        return withSqlState(kProtocolViolation, encoder.status());
+      }
+      portal.encoder.emplace(std::move(encoder).value());
+    }
+    portals_.insert_or_assign(std::move(portal_name), std::move(portal));
+    MessageWriter(output_).begin(backend::kBindComplete).end();
+    return Status::OK();
+  }
+
+  Status describe(std::string_view body) {
+    MessageReader reader(body);
+    const auto kind = static_cast<char>(reader.int8());
+    const std::string name(reader.cstring());
+    auto status = reader.status("Describe");
+    if (!status.ok()) {
+      return withSqlState(kProtocolViolation, std::move(status));
+    }
+    if (kind == 'S') {
+      const auto it = statements_.find(name);
+      if (it == statements_.end()) {
+        return Status::SqlError("prepared statement \"" + name +
+                                "\" does not exist");
+      }
+      MessageWriter(output_).begin(backend::kParameterDescription)
+          .int16(0)
+          .end();
+      if (it->second.row_type == nullptr) {
+        MessageWriter(output_).begin(backend::kNoData).end();
+        return Status::OK();
+      }
+      auto encoder = RowEncoder::create(it->second.row_type, {});
+      if (!encoder.ok()) {
+        return encoder.status();
+      }
+      encoder->writeRowDescription(output_);
+      return Status::OK();
+    }
+    const auto it = portals_.find(name);
+    if (it == portals_.end()) {
+      return Status::SqlError("portal \"" + name + "\" does not exist");
+    }
+    if (!it->second.encoder.has_value()) {
+      MessageWriter(output_).begin(backend::kNoData).end();
+    } else {
+      it->second.encoder->writeRowDescription(output_);
+    }
+    return Status::OK();
+  }
+
+  Status execute(std::string_view body) {
+    MessageReader reader(body);
+    const std::string name(reader.cstring());
+    reader.int32();  // Row limit; results are always sent whole.
+    auto status = reader.status("Execute");
+    if (!status.ok()) {
+      return withSqlState(kProtocolViolation, std::move(status));
+    }
+    const auto it = portals_.find(name);
+    if (it == portals_.end()) {
+      return Status::SqlError("portal \"" + name + "\" does not exist");
+    }
+    auto& portal = it->second;
+    if (portal.statement.query.empty()) {
+      MessageWriter(output_).begin(backend::kEmptyQueryResponse).end();
+      return Status::OK();
+    }
+    status = checkTransaction(portal.statement.query);
+    if (!status.ok()) {
+      return status;
+    }
+    if (!portal.encoder.has_value()) {
+      sessionCommand(portal.statement.query);
+      return Status::OK();
+    }
+    return run(portal.statement.query, *portal.encoder);
+  }
+
+  Status close(std::string_view body) {
+    MessageReader reader(body);
+    const auto kind = static_cast<char>(reader.int8());
+    const std::string name(reader.cstring());
+    auto status = reader.status("Close");
+    if (!status.ok()) {
+      return withSqlState(kProtocolViolation, std::move(status));
+    }
+    if (kind == 'S') {
+      statements_.erase(name);
+    } else {
+      portals_.erase(name);
+    }
+    MessageWriter(output_).begin(backend::kCloseComplete).end();
+    return Status::OK();
+  }
+
+  // Streams the result of `query' as DataRows, one write per batch.
+  Status run(const std::string& query, RowEncoder& encoder) {
+    std::int64_t count = 0;
+    auto status = stream(query, [&](const velox::RowVector& batch) {
+      count += batch.size();
+      return encoder.writeDataRows(batch, output_);
+    });
+    if (!status.ok()) {
+      return status;
+    }
+    commandComplete("SELECT " + std::to_string(count));
+    return Status::OK();
+  }
+
+  template <typename Encode>
+  Status stream(const std::string& query, Encode&& encode) {
+    try {
+      return engine_->execute(
+          query, pool_.get(), [&](velox::RowVectorPtr batch) -> Status {
+            if (cancelled_) {
+              return Status::QueryExecutorError("query cancelled");
+            }
+            auto status = encode(*batch);
+            if (!status.ok()) {
+              return status;
+            }
+            flush();
+            return broken_ ? Status::StorageError("client connection lost")
+                           : Status::OK();
+          });
+    } catch (const std::exception& e) {
+      return Status::QueryExecutorError(e.what());
+    }
+  }
+
+  // Answers SET, which drivers send on connect and none of which applies,
+  // and transaction control.
+  void sessionCommand(std::string_view query) {
+    const auto tag = transactionTag(query);
+    if (!tag.has_value()) {
+      commandComplete("SET");
+    } else if (*tag == "BEGIN") {
+      transaction_ = TransactionState::kInBlock;
+      commandComplete(*tag);
+    } else {
+      // COMMIT of a failed block rolls it back.
+      const bool failed = transaction_ == TransactionState::kFailed;
+      transaction_ = TransactionState::kIdle;
+      commandComplete(failed ? "ROLLBACK" : *tag);
+    }
+  }
+
+  // In a failed transaction block only the statements ending it run.
+  Status checkTransaction(std::string_view query) {
+    if (transaction_ != TransactionState::kFailed ||
+        (transactionTag(query).has_value() &&
+         transactionTag(query) != "BEGIN")) {
+      return Status::OK();
+    }
+    return withSqlState(kInFailedTransaction,
+                        Status::SqlError("current transaction is aborted, "
+                                         "commands ignored until end of "
+                                         "transaction block"));
+  }
+
+  // Reports `status' with SQLSTATE `code' instead of the one its status
+  // code maps to.
+  Status withSqlState(std::string_view code, Status status) {
+    sql_state_ = code;
+    return status;
+  }
+
+  void commandComplete(std::string_view tag) {
+    MessageWriter(output_).begin(backend::kCommandComplete)
+        .cstring(tag)
+        .end();
+  }
+
+  void readyForQuery() {
+    MessageWriter(output_).begin(backend::kReadyForQuery)
+        .int8(static_cast<std::uint8_t>(transaction_))
+        .end();
+  }
+
+  // Also fails the transaction block, if one is open.
+  void writeError(const Status& status, std::string_view severity = "ERROR") {
+    const auto code = std::exchange(sql_state_, {});
+    if (transaction_ == TransactionState::kInBlock) {
+      transaction_ = TransactionState::kFailed;
+    }
+    MessageWriter(output_).begin(backend::kErrorResponse)
+        .int8('S')
+        .cstring(severity)
+        .int8('V')
+        .cstring(severity)
+        .int8('C')
+        .cstring(code.empty() ? sqlState(status) : code)
+        .int8('M')
+        .cstring(status.message())
+        .int8(0)
+        .end();
+  }
+
+  void flush() {
+    if (output_.empty() || broken_) {
+      output_.clear();
+      return;
+    }
+    broken_ = !sink_(std::exchange(output_, {})).ok();
+  }
+
+  std::shared_ptr<QueryEngine> engine_;
+  std::shared_ptr<velox::memory::MemoryPool> pool_;
+  WireSink sink_;
+  PgSessionOptions options_;
+  std::map<std::string, Statement, std::less<>> statements_;
+  std::map<std::string, Portal, std::less<>> portals_;
+  std::string output_;
+  // Set by withSqlState() for the next writeError().
+  std::string_view sql_state_;
+  TransactionState transaction_ = TransactionState::kIdle;
+  std::atomic<bool> cancelled_ = false;
+  bool started_ = false;
+  bool failed_ = false;
+  bool broken_ = false;
+};
+
+}  // namespace halo::server::pgwire
@@ -0,0 +1,350 @@
+module;
+#include <fmt/chrono.h>
+#include <fmt/format.h>
+#include <velox/type/StringView.h>
+#include <velox/type/Timestamp.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+export module halo.server.pgwire:RowEncoder;
+import halo.common;
+import :PgProtocol;
+
+namespace halo::server::pgwire {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+namespace velox = facebook::velox;
+
+export enum class PgFormat : std::int16_t {
+  kText = 0,
+  kBinary = 1,
+};
+
+// Type OIDs from pg_type.
+export namespace oid {
+constexpr std::int32_t kBool = 16;
+constexpr std::int32_t kInt8 = 20;
+constexpr std::int32_t kInt2 = 21;
+constexpr std::int32_t kInt4 = 23;
+constexpr std::int32_t kText = 25;
+constexpr std::int32_t kFloat4 = 700;
+constexpr std::int32_t kFloat8 = 701;
+constexpr std::int32_t kVarchar = 1043;
+constexpr std::int32_t kDate = 1082;
+constexpr std::int32_t kTimestamp = 1114;
+}  // namespace oid
+
+// Days and microseconds between the Unix and PostgreSQL epochs.
+constexpr std::int32_t kPgEpochDays = 10957;
+constexpr std::int64_t kPgEpochMicros = 946684800000000LL;
+
+// How a column is described to clients and written.
+struct PgColumn {
+  std::int32_t type_oid = oid::kText;
+  std::int16_t type_size = -1;
+  PgFormat format = PgFormat::kText;
+};
+
+PgColumn pgColumn(const velox::TypePtr& type) {
+  // Logical types (DECIMAL, INTERVAL, JSON, ...) share a physical kind with
+  // a plain type and are sent as text.
+  if (type->isDate()) {
+    return {oid::kDate, 4};
+  }
+  if (type->name() != velox::TypeKindName::toName(type->kind())) {
+    return {};
+  }
+  switch (type->kind()) {
+    case velox::TypeKind::BOOLEAN:
+      return {oid::kBool, 1};
+    case velox::TypeKind::TINYINT:
+    case velox::TypeKind::SMALLINT:
+      return {oid::kInt2, 2};
+    case velox::TypeKind::INTEGER:
+      return {oid::kInt4, 4};
+    case velox::TypeKind::BIGINT:
+      return {oid::kInt8, 8};
+    case velox::TypeKind::REAL:
+      return {oid::kFloat4, 4};
+    case velox::TypeKind::DOUBLE:
+      return {oid::kFloat8, 8};
+    case velox::TypeKind::VARCHAR:
+      return {oid::kVarchar, -1};
+    case velox::TypeKind::TIMESTAMP:
+      return {oid::kTimestamp, 8};
+    default:
+      return {};
+  }
+}
+
+// Encodes result batches as RowDescription and DataRow messages, in text
+// or binary format per column as the client asked in Bind.
+//
+// Works a column at a time like the text result formatter: each column of
+// a batch is encoded into a scratch buffer with one type dispatch, then the
+// DataRow messages are assembled from the cells. Binary output differs
+// from text for booleans, integers, floats, DATE and TIMESTAMP, which is
+// where it saves the client parsing text; text, varchar and the types sent
+// as text are the same bytes in both formats.
+export class RowEncoder final {
+ public:
+  // `formats' as in Bind: empty for all text, one code for every column or
+  // one per column.
+  static StatusOr<RowEncoder> create(velox::RowTypePtr row_type,
+                                     std::span<const std::int16_t> formats) {
+    const std::size_t size = row_type->size();
+    if (formats.size() > 1 && formats.size() != size) {
+      return Status::Invalid("bind message has " +
+                             std::to_string(formats.size()) +
+                             " result formats for " + std::to_string(size) +
+                             " columns");
+    }
+    std::vector<PgColumn> columns;
+    for (std::size_t i = 0; i < size; ++i) {
+      auto column = pgColumn(row_type->childAt(i));
+      const std::int16_t code =
+          formats.empty() ? 0 : formats[formats.size() == 1 ? 0 : i];
+      if (code != 0 && code != 1) {
+        return Status::Invalid("unknown result format " +
+                               std::to_string(code));
+      }
+      if (code == 1) {
+        // The binary form of text and varchar is the text itself.
+        column.format = PgFormat::kBinary;
+      }
+      columns.push_back(column);
+    }
+    return RowEncoder(std::move(row_type), std::move(columns));
+  }
+
+  [[nodiscard]] const velox::RowTypePtr& rowType() const { return row_type_; }
+
+  void writeRowDescription(std::string& out) const {
+    MessageWriter writer(out);
+    writer.begin(backend::kRowDescription)
+        .int16(static_cast<std::int16_t>(columns_.size()));
+    for (std::size_t i = 0; i < columns_.size(); ++i) {
+      writer.cstring(row_type_->nameOf(i))
+          .int32(0)  // Table OID.
+          .int16(0)  // Column attribute number.
+          .int32(columns_[i].type_oid)
+          .int16(columns_[i].type_size)
+          .int32(-1)  // Type modifier.
+          .int16(static_cast<std::int16_t>(columns_[i].format));
+    }
+    writer.end();
+  }
+
+  // Appends one DataRow message per row of `batch'.
+  Status writeDataRows(const velox::RowVector& batch, std::string& out) {
+    if (batch.childrenSize() != cells_.size()) {
+      return Status::Invalid("batch has " +
+                             std::to_string(batch.childrenSize()) +
+                             " columns, expected " +
+                             std::to_string(cells_.size()));
+    }
+    const velox::vector_size_t rows = batch.size();
+    for (std::size_t i = 0; i < cells_.size(); ++i) {
+      encodeColumn(batch.childAt(i), columns_[i].format, rows, cells_[i]);
+    }
+
+    std::vector<std::size_t> offsets(cells_.size(), 0);
+    const auto column_count = static_cast<std::int16_t>(cells_.size());
+    for (velox::vector_size_t row = 0; row < rows; ++row) {
+      const auto r = static_cast<std::size_t>(row);
+      std::size_t length = 4 + 2;
+      for (const auto& cells : cells_) {
+        length += 4 + static_cast<std::size_t>(
+                          std::max<std::int32_t>(cells.lengths[r], 0));
+      }
+      out.push_back(backend::kDataRow);
+      appendBigEndian(out, static_cast<std::int32_t>(length));
+      appendBigEndian(out, column_count);
+      for (std::size_t i = 0; i < cells_.size(); ++i) {
+        const std::int32_t cell = cells_[i].lengths[r];
+        appendBigEndian(out, cell);
+        if (cell > 0) {
+          out.append(cells_[i].data, offsets[i],
+                     static_cast<std::size_t>(cell));
+          offsets[i] += static_cast<std::size_t>(cell);
+        }
+      }
+    }
+    return Status::OK();
+  }
+
+ private:
+  // Encoded cells of one column of the current batch, -1 for NULL.
+  struct ColumnCells {
+    std::string data;
+    std::vector<std::int32_t> lengths;
+  };
+
+  RowEncoder(velox::RowTypePtr row_type, std::vector<PgColumn> columns)
+      : row_type_(std::move(row_type)),
+        columns_(std::move(columns)),
+        cells_(columns_.size()) {}
+
+  static void encodeColumn(const velox::VectorPtr& vector, PgFormat format,
+                           velox::vector_size_t rows, ColumnCells& cells) {
+    cells.data.clear();
+    cells.lengths.resize(static_cast<std::size_t>(rows));
+    const bool binary = format == PgFormat::kBinary;
+    if (vector->type()->isDate()) {
+      return binary ? encodeFlat<std::int32_t, kDateBinary>(vector, rows, cells)
+                    : encodeFlat<std::int32_t, kDateText>(vector, rows, cells);
+    }
+    if (pgColumn(vector->type()).type_oid == oid::kText) {
+      return encodeGeneric(*vector, rows, cells);
+    }
+    switch (vector->typeKind()) {
+      case velox::TypeKind::BOOLEAN:
+        return encodeNumeric<bool>(vector, binary, rows, cells);
+      case velox::TypeKind::TINYINT:
+        return encodeNumeric<std::int8_t>(vector, binary, rows, cells);
+      case velox::TypeKind::SMALLINT:
+        return encodeNumeric<std::int16_t>(vector, binary, rows, cells);
+      case velox::TypeKind::INTEGER:
+        return encodeNumeric<std::int32_t>(vector, binary, rows, cells);
+      case velox::TypeKind::BIGINT:
+        return encodeNumeric<std::int64_t>(vector, binary, rows, cells);
+      case velox::TypeKind::REAL:
+        return encodeNumeric<float>(vector, binary, rows, cells);
+      case velox::TypeKind::DOUBLE:
+        return encodeNumeric<double>(vector, binary, rows, cells);
+      case velox::TypeKind::VARCHAR:
+        return encodeFlat<velox::StringView, kString>(vector, rows, cells);
+      case velox::TypeKind::TIMESTAMP:
+        return binary
+                   ? encodeFlat<velox::Timestamp, kTimestampBinary>(
+                         vector, rows, cells)
+                   : encodeFlat<velox::Timestamp, kTimestampText>(vector, rows,
+                                                                  cells);
+      default:
+        return encodeGeneric(*vector, rows, cells);
+    }
+  }
+
+  enum Encoding : std::uint8_t {
+    kNumberText,
+    kNumberBinary,
+    kString,
+    kDateText,
+    kDateBinary,
+    kTimestampText,
+    kTimestampBinary,
+  };
+
+  template <typename T>
+  static void encodeNumeric(const velox::VectorPtr& vector, bool binary,
+                            velox::vector_size_t rows, ColumnCells& cells) {
+    return binary ? encodeFlat<T, kNumberBinary>(vector, rows, cells)
+                  : encodeFlat<T, kNumberText>(vector, rows, cells);
+  }
+
+  template <typename T, Encoding kEncoding>
+  static void encodeFlat(velox::VectorPtr vector, velox::vector_size_t rows,
+                         ColumnCells& cells) {
+    // Results may be dictionary or constant encoded.
+    velox::BaseVector::flattenVector(vector);
+    const auto* flat = vector->asFlatVector<T>();
+    const bool may_have_nulls = vector->mayHaveNulls();
+    auto& data = cells.data;
+    for (velox::vector_size_t row = 0; row < rows; ++row) {
+      auto& length = cells.lengths[static_cast<std::size_t>(row)];
+      if (may_have_nulls && vector->isNullAt(row)) {
+        length = -1;
+        continue;
+      }
+      const std::size_t begin = data.size();
+      const T value = flat->valueAt(row);
+      if constexpr (kEncoding == kString) {
+        data.append(value.data(), value.size());
+      } else if constexpr (kEncoding == kNumberBinary) {
+        if constexpr (std::is_same_v<T, bool>) {
+          data.push_back(value ? 1 : 0);
+        } else if constexpr (std::is_same_v<T, std::int8_t>) {
+          appendBigEndian(data, static_cast<std::int16_t>(value));
+        } else {
+          appendBigEndian(data, value);
+        }
+      } else if constexpr (kEncoding == kNumberText) {
+        writeNumber(value, data);
+      } else if constexpr (kEncoding == kDateBinary) {
+        appendBigEndian(data, value - kPgEpochDays);
+      } else if constexpr (kEncoding == kDateText) {
+        fmt::format_to(std::back_inserter(data), "{:%F}",
+                       std::chrono::sys_days(std::chrono::days(value)));
+      } else if constexpr (kEncoding == kTimestampBinary) {
+        appendBigEndian(data, value.toMicros() - kPgEpochMicros);
+      } else {
+        fmt::format_to(std::back_inserter(data), "{:%F %T}",
+                       std::chrono::sys_time<std::chrono::microseconds>(
+                           std::chrono::microseconds(value.toMicros())));
+      }
+      length = static_cast<std::int32_t>(data.size() - begin);
+    }
+  }
+
+  template <typename T>
+  static void writeNumber(T value, std::string& data) {
+    if constexpr (std::is_same_v<T, bool>) {
+      data.push_back(value ? 't' : 'f');
+    } else {
+      if constexpr (std::is_floating_point_v<T>) {
+        if (std::isnan(value)) {
+          data.append("NaN");
+          return;
+        }
+        if (std::isinf(value)) {
+          data.append(value > 0 ? "Infinity" : "-Infinity");
+          return;
+        }
+      }
+      // The longest shortest round-trip double takes 24 characters.
+      const std::size_t size = data.size();
+      data.resize(size + 32);
+      char* first = data.data() + size;
+      const auto result = std::to_chars(first, first + 32, value);
+      data.resize(static_cast<std::size_t>(result.ptr - data.data()));
+    }
+  }
+
+  static void encodeGeneric(const velox::BaseVector& vector,
+                            velox::vector_size_t rows, ColumnCells& cells) {
+    for (velox::vector_size_t row = 0; row < rows; ++row) {
+      auto& length = cells.lengths[static_cast<std::size_t>(row)];
+      if (vector.isNullAt(row)) {
+        length = -1;
+        continue;
+      }
+      const auto text = vector.toString(row);
+      cells.data.append(text);
+      length = static_cast<std::int32_t>(text.size());
+    }
+  }
+
+  velox::RowTypePtr row_type_;
+  std::vector<PgColumn> columns_;
+  std::vector<ColumnCells> cells_;
+};
+
+}  // namespace halo::server::pgwire
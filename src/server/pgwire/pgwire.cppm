@@ -0,0 +1,5 @@
+export module halo.server.pgwire;
+export import :PgProtocol;
+export import :PgServer;
+export import :PgSession;
+export import :RowEncoder;
@@ -0,0 +1,238 @@
+module;
+#include <arrow/buffer.h>
+#include <arrow/io/interfaces.h>
+#include <arrow/ipc/dictionary.h>
+#include <arrow/ipc/options.h>
+#include <arrow/ipc/writer.h>
+#include <arrow/record_batch.h>
+#include <arrow/result.h>
+#include <arrow/status.h>
+#include <arrow/type.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <grpcpp/support/byte_buffer.h>
+#include <grpcpp/support/slice.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+export module halo.server.rpc:Messages;
+import halo.common;
+
+namespace halo::server::rpc {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+using google::protobuf::internal::WireFormatLite;
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::CodedOutputStream;
+
+// Messages of query_service.proto, encoded by hand: a generated
+// ExecuteResponse would copy every result buffer into its `bytes' field,
+// while here a response is a ByteBuffer whose slices reference the Arrow
+// buffers themselves.
+
+export constexpr std::string_view kServiceName = "halo.rpc.QueryService";
+export constexpr std::string_view kExecuteMethod =
+    "/halo.rpc.QueryService/Execute";
+
+// Compression in query_service.proto.
+export enum class CallCompression : std::uint8_t {
+  kDefault = 0,
+  kNone = 1,
+  kLow = 2,
+  kMedium = 3,
+  kHigh = 4,
+};
+
+export struct ExecuteRequest {
+  std::string sql;
+  CallCompression compression = CallCompression::kDefault;
+};
+
+export StatusOr<ExecuteRequest> decodeExecuteRequest(
+    const grpc::ByteBuffer& buffer) {
+  std::vector<grpc::Slice> slices;
+  if (!buffer.Dump(&slices).ok()) {
+    return Status::Invalid("cannot read ExecuteRequest");
+  }
+  std::string bytes;
+  bytes.reserve(buffer.Length());
+  for (const auto& slice : slices) {
+    bytes.append(reinterpret_cast<const char*>(slice.begin()), slice.size());
+  }
+  CodedInputStream input(reinterpret_cast<const std::uint8_t*>(bytes.data()),
+                         static_cast<int>(bytes.size()));
+  ExecuteRequest request;
+  while (const auto tag = input.ReadTag()) {
+    const auto field = WireFormatLite::GetTagFieldNumber(tag);
+    const auto wire_type = WireFormatLite::GetTagWireType(tag);
+    if (field == 1 && wire_type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      std::uint32_t length = 0;
+      if (!input.ReadVarint32(&length) ||
+          !input.ReadString(&request.sql, static_cast<int>(length))) {
+        return Status::Invalid("truncated ExecuteRequest.sql");
+      }
+    } else if (field == 2 && wire_type == WireFormatLite::WIRETYPE_VARINT) {
+      std::uint32_t value = 0;
+      if (!input.ReadVarint32(&value)) {
+        return Status::Invalid("truncated ExecuteRequest.compression");
+      }
+      // Levels added later fall back to the server's default, as proto3
+      // does for unknown enum values.
+      request.compression =
+          value <= static_cast<std::uint32_t>(CallCompression::kHigh)
+              ? static_cast<CallCompression>(value)
+              : CallCompression::kDefault;
+    } else if (!WireFormatLite::SkipField(&input, tag)) {
+      return Status::Invalid("malformed ExecuteRequest");
+    }
+  }
+  if (!input.ConsumedEntireMessage()) {
+    return Status::Invalid("malformed ExecuteRequest");
+  }
+  return request;
+}
+
+// Collects an IPC message as slices. Buffers of at least `kShareBytes' are
+// referenced, not copied; the message header, padding and small buffers are
+// copied into slices between them.
+class SliceOutputStream final : public arrow::io::OutputStream {
+ public:
+  using arrow::io::OutputStream::Write;
+
+  static constexpr std::int64_t kShareBytes = 4096;
+
+  arrow::Status Close() override {
+    flushCopied();
+    closed_ = true;
+    return arrow::Status::OK();
+  }
+
+  [[nodiscard]] bool closed() const override { return closed_; }
+
+  [[nodiscard]] arrow::Result<std::int64_t> Tell() const override {
+    return position_;
+  }
+
+  arrow::Status Write(const void* data, std::int64_t nbytes) override {
+    copied_.append(static_cast<const char*>(data),
+                   static_cast<std::size_t>(nbytes));
+    position_ += nbytes;
+    return arrow::Status::OK();
+  }
+
+  arrow::Status Write(const std::shared_ptr<arrow::Buffer>& data) override {
+    if (data->size() < kShareBytes || !data->is_cpu()) {
+      return Write(data->data(), data->size());
+    }
+    flushCopied();
+    slices_.emplace_back(
+        const_cast<std::uint8_t*>(data->data()),
+        static_cast<std::size_t>(data->size()),
+        [](void* buffer) {
+          delete static_cast<std::shared_ptr<arrow::Buffer>*>(buffer);
+        },
+        new std::shared_ptr<arrow::Buffer>(data));
+    position_ += data->size();
+    return arrow::Status::OK();
+  }
+
+  std::vector<grpc::Slice> take() {
+    flushCopied();
+    return std::move(slices_);
+  }
+
+ private:
+  void flushCopied() {
+    if (!copied_.empty()) {
+      slices_.emplace_back(copied_.data(), copied_.size());
+      copied_.clear();
+    }
+  }
+
+  std::vector<grpc::Slice> slices_;
+  std::string copied_;
+  std::int64_t position_ = 0;
+  bool closed_ = false;
+};
+
+// A tag and a varint.
+constexpr std::size_t kFieldHeaderBytes = 16;
+
+// An ExecuteResponse around `payload', whose buffers it keeps alive.
+StatusOr<grpc::ByteBuffer> executeResponse(
+    const arrow::ipc::IpcPayload& payload,
+    const arrow::ipc::IpcWriteOptions& options, std::int64_t rows) {
+  SliceOutputStream ipc;
+  std::int32_t metadata_length = 0;
+  const auto written =
+      arrow::ipc::WriteIpcPayload(payload, options, &ipc, &metadata_length);
+  if (!written.ok()) {
+    return Status::QueryExecutorError("cannot encode Arrow IPC message: " +
+                                      written.ToString());
+  }
+  auto body = ipc.take();
+  std::uint64_t length = 0;
+  for (const auto& slice : body) {
+    length += slice.size();
+  }
+
+  std::array<std::uint8_t, kFieldHeaderBytes> header;
+  auto* end = CodedOutputStream::WriteTagToArray(
+      WireFormatLite::MakeTag(1, WireFormatLite::WIRETYPE_LENGTH_DELIMITED),
+      header.data());
+  end = CodedOutputStream::WriteVarint64ToArray(length, end);
+  std::vector<grpc::Slice> slices;
+  slices.reserve(body.size() + 2);
+  slices.emplace_back(header.data(),
+                      static_cast<std::size_t>(end - header.data()));
+  for (auto& slice : body) {
+    slices.push_back(std::move(slice));
+  }
+  if (rows != 0) {
+    std::array<std::uint8_t, kFieldHeaderBytes> trailer;
+    end = CodedOutputStream::WriteTagToArray(
+        WireFormatLite::MakeTag(2, WireFormatLite::WIRETYPE_VARINT),
+        trailer.data());
+    end = CodedOutputStream::WriteVarint64ToArray(
+        static_cast<std::uint64_t>(rows), end);
+    slices.emplace_back(trailer.data(),
+                        static_cast<std::size_t>(end - trailer.data()));
+  }
+  return grpc::ByteBuffer(slices.data(), slices.size());
+}
+
+export StatusOr<grpc::ByteBuffer> schemaResponse(
+    const arrow::Schema& schema, const arrow::ipc::IpcWriteOptions& options) {
+  arrow::ipc::IpcPayload payload;
+  const auto status = arrow::ipc::GetSchemaPayload(
+      schema, options, arrow::ipc::DictionaryFieldMapper(schema), &payload);
+  if (!status.ok()) {
+    return Status::QueryExecutorError("cannot encode result schema: " +
+                                      status.ToString());
+  }
+  return executeResponse(payload, options, 0);
+}
+
+export StatusOr<grpc::ByteBuffer> batchResponse(
+    const arrow::RecordBatch& batch,
+    const arrow::ipc::IpcWriteOptions& options) {
+  arrow::ipc::IpcPayload payload;
+  const auto status =
+      arrow::ipc::GetRecordBatchPayload(batch, options, &payload);
+  if (!status.ok()) {
+    return Status::QueryExecutorError("cannot encode result batch: " +
+                                      status.ToString());
+  }
+  return executeResponse(payload, options, batch.num_rows());
+}
+
+}  // namespace halo::server::rpc
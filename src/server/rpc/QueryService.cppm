@@ -0,0 +1,430 @@
+module;
+#include <arrow/ipc/options.h>
+#include <arrow/record_batch.h>
+#include <arrow/status.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <grpc/compression.h>
+#include <grpcpp/generic/callback_generic_service.h>
+#include <grpcpp/health_check_service_interface.h>
+#include <grpcpp/resource_quota.h>
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/server.h>
+#include <grpcpp/server_builder.h>
+#include <grpcpp/support/byte_buffer.h>
+#include <grpcpp/support/server_callback.h>
+#include <grpcpp/support/status.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+export module halo.server.rpc:QueryService;
+import halo.common;
+import halo.common.threads;
+import halo.server.engine;
+import halo.server.flight;
+import :Messages;
+
+namespace halo::server::rpc {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+using halo::server::engine::QueryEngine;
+
+grpc::Status toGrpc(const Status& status) {
+  switch (status.code()) {
+    case Status::Code::kOk:
+      return grpc::Status::OK;
+    case Status::Code::kInvalid:
+    case Status::Code::kSqlError:
+      return {grpc::StatusCode::INVALID_ARGUMENT, status.message()};
+    case Status::Code::kNotImplemented:
+      return {grpc::StatusCode::UNIMPLEMENTED, status.message()};
+    case Status::Code::kStorageError:
+      return {grpc::StatusCode::UNAVAILABLE, status.message()};
+    default:
+      return {grpc::StatusCode::INTERNAL, status.message()};
+  }
+}
+
+// Errors of a running query reach the reader as Arrow statuses.
+grpc::Status toGrpc(const arrow::Status& status) {
+  switch (status.code()) {
+    case arrow::StatusCode::OK:
+      return grpc::Status::OK;
+    case arrow::StatusCode::Invalid:
+      return {grpc::StatusCode::INVALID_ARGUMENT, status.message()};
+    case arrow::StatusCode::NotImplemented:
+      return {grpc::StatusCode::UNIMPLEMENTED, status.message()};
+    case arrow::StatusCode::IOError:
+      return {grpc::StatusCode::UNAVAILABLE, status.message()};
+    default:
+      return {grpc::StatusCode::INTERNAL, status.message()};
+  }
+}
+
+grpc_compression_level compressionLevel(CallCompression compression) {
+  switch (compression) {
+    case CallCompression::kNone:
+      return GRPC_COMPRESS_LEVEL_NONE;
+    case CallCompression::kLow:
+      return GRPC_COMPRESS_LEVEL_LOW;
+    case CallCompression::kMedium:
+      return GRPC_COMPRESS_LEVEL_MED;
+    default:
+      return GRPC_COMPRESS_LEVEL_HIGH;
+  }
+}
+
+export struct QueryServiceOptions {
+  std::string host = "0.0.0.0";
+  // 0 picks a free port, see QueryServer::port().
+  int port = 0;
+  // Queueing and memory limit of each query, as for Flight SQL.
+  flight::StreamOptions stream;
+  // Threads running queries, reserved from the process's thread budget.
+  // Admitted calls beyond them wait for one.
+  std::size_t query_threads =
+      std::max(1U, std::thread::hardware_concurrency());
+  // Threads writing results to clients, one per call for as long as it
+  // streams; admitted calls beyond them wait for one.
+  std::size_t writer_threads =
+      std::max(1U, std::thread::hardware_concurrency());
+  // Level of calls that leave ExecuteRequest.compression unset.
+  CallCompression compression = CallCompression::kLow;
+  // Memory the running queries may reserve together. A query reserves its
+  // `stream.memory_limit_bytes' for as long as it runs, and a call that
+  // would go beyond the quota fails with RESOURCE_EXHAUSTED instead of
+  // waiting, so that the client can retry elsewhere.
+  std::uint64_t memory_quota_bytes = 8ULL << 30;
+  // gRPC's ResourceQuota of the server, which bounds the buffers of its
+  // connections.
+  std::uint64_t transport_quota_bytes = 256ULL << 20;
+  // Time running calls get to finish on shutdown before they are cancelled.
+  std::chrono::milliseconds shutdown_grace{5000};
+};
+
+class QueryService;
+
+// One Execute call. Reads the request on a gRPC thread, then starts the
+// query and writes its batches from a thread of the service's writer pool,
+// one write in flight at a time: a write completes once HTTP/2 flow
+// control has let the previous message out, so a slow client holds back
+// the writer and, through the result stream's queue, the query. A call the
+// client cancels, or that hits its deadline, cancels the query.
+class ExecuteReactor final : public grpc::ServerGenericBidiReactor {
+ public:
+  ExecuteReactor(QueryService* service,
+                 grpc::GenericCallbackServerContext* context);
+
+  void OnReadDone(bool ok) override;
+
+  void OnCancel() override {
+    std::shared_ptr<flight::ResultStream> stream;
+    {
+      std::lock_guard lock(mutex_);
+      cancelled_ = true;
+      stream = stream_;
+    }
+    if (stream != nullptr) {
+      stream->cancel();
+    }
+  }
+
+  void OnWriteDone(bool ok) override {
+    std::lock_guard lock(mutex_);
+    write_ok_ = ok;
+    write_done_ = true;
+    write_finished_.notify_one();
+  }
+
+  void OnDone() override;
+
+ private:
+  void run(ExecuteRequest request) {
+    const auto status = execute(request);
+    // The reactor may be gone once Finish() returns.
+    Finish(status);
+  }
+
+  grpc::Status execute(const ExecuteRequest& request);
+
+  // Sends `response' and waits for the write to complete.
+  bool write(grpc::ByteBuffer response) {
+    response_ = std::move(response);
+    {
+      std::lock_guard lock(mutex_);
+      write_done_ = false;
+    }
+    StartWrite(&response_);
+    std::unique_lock lock(mutex_);
+    write_finished_.wait(lock, [this] { return write_done_; });
+    return write_ok_;
+  }
+
+  QueryService* const service_;
+  grpc::GenericCallbackServerContext* const context_;
+  grpc::ByteBuffer request_;
+  grpc::ByteBuffer response_;
+  // Kept until OnDone(): the slices of sent responses reference its batches.
+  // Set under `mutex_', which OnCancel() reads it under.
+  std::shared_ptr<flight::ResultStream> stream_;
+  bool admitted_ = false;
+  std::mutex mutex_;
+  bool cancelled_ = false;
+  std::condition_variable write_finished_;
+  bool write_done_ = false;
+  bool write_ok_ = false;
+};
+
+class QueryService final : public grpc::CallbackGenericService {
+ public:
+  QueryService(std::shared_ptr<QueryEngine> engine,
+               const QueryServiceOptions& options)
+      : engine_(std::move(engine)),
+        options_(options),
+        write_options_(arrow::ipc::IpcWriteOptions::Defaults()),
+        queries_(common::threads::makeBudgetedExecutor(
+            common::threads::ThreadBudget::global(), options.query_threads,
+            "RpcQuery")),
+        writers_(common::threads::makeBudgetedExecutor(
+            common::threads::ThreadBudget::global(), options.writer_threads,
+            "RpcWriter")) {}
+
+  grpc::ServerGenericBidiReactor* CreateReactor(
+      grpc::GenericCallbackServerContext* context) override {
+    return new ExecuteReactor(this, context);
+  }
+
+  [[nodiscard]] const std::shared_ptr<QueryEngine>& engine() const {
+    return engine_;
+  }
+
+  [[nodiscard]] const QueryServiceOptions& options() const {
+    return options_;
+  }
+
+  [[nodiscard]] const arrow::ipc::IpcWriteOptions& writeOptions() const {
+    return write_options_;
+  }
+
+  [[nodiscard]] folly::Executor* queries() const { return queries_.get(); }
+
+  [[nodiscard]] folly::Executor* writers() const { return writers_.get(); }
+
+  // Reserves the memory limit of one query if the quota has room for it.
+  bool admit() {
+    std::lock_guard lock(mutex_);
+    const auto limit = options_.stream.memory_limit_bytes;
+    if (reserved_bytes_ + limit > options_.memory_quota_bytes) {
+      return false;
+    }
+    reserved_bytes_ += limit;
+    return true;
+  }
+
+  void release() {
+    std::lock_guard lock(mutex_);
+    reserved_bytes_ -= options_.stream.memory_limit_bytes;
+  }
+
+ private:
+  const std::shared_ptr<QueryEngine> engine_;
+  const QueryServiceOptions options_;
+  const arrow::ipc::IpcWriteOptions write_options_;
+  std::mutex mutex_;
+  std::uint64_t reserved_bytes_ = 0;
+  // Destroyed last, after the writers reading their results, which waits
+  // for the queries still running.
+  const std::shared_ptr<folly::CPUThreadPoolExecutor> queries_;
+  const std::shared_ptr<folly::CPUThreadPoolExecutor> writers_;
+};
+
+ExecuteReactor::ExecuteReactor(QueryService* service,
+                               grpc::GenericCallbackServerContext* context)
+    : service_(service), context_(context) {
+  if (context->method() != kExecuteMethod) {
+    Finish({grpc::StatusCode::UNIMPLEMENTED,
+            "unknown method " + context->method()});
+    return;
+  }
+  StartRead(&request_);
+}
+
+void ExecuteReactor::OnReadDone(bool ok) {
+  if (!ok) {
+    Finish({grpc::StatusCode::INVALID_ARGUMENT, "Execute needs a request"});
+    return;
+  }
+  auto request = decodeExecuteRequest(request_);
+  if (!request.ok()) {
+    Finish(toGrpc(request.status()));
+    return;
+  }
+  if (!service_->admit()) {
+    Finish({grpc::StatusCode::RESOURCE_EXHAUSTED,
+            "query memory quota exhausted"});
+    return;
+  }
+  admitted_ = true;
+  // gRPC maps the level to the best algorithm the client accepts.
+  context_->set_compression_level(compressionLevel(
+      request->compression == CallCompression::kDefault
+          ? service_->options().compression
+          : request->compression));
+  service_->writers()->add(
+      [this, request = std::move(request).value()]() mutable {
+        run(std::move(request));
+      });
+}
+
+void ExecuteReactor::OnDone() {
+  if (admitted_) {
+    service_->release();
+  }
+  delete this;
+}
+
+grpc::Status ExecuteReactor::execute(const ExecuteRequest& request) {
+  {
+    std::lock_guard lock(mutex_);
+    if (cancelled_) {
+      return {grpc::StatusCode::CANCELLED, "call cancelled"};
+    }
+  }
+  auto row_type = service_->engine()->describe(request.sql);
+  if (!row_type.ok()) {
+    return toGrpc(row_type.status());
+  }
+  auto stream =
+      flight::ResultStream::start(service_->engine(), request.sql,
+                                  std::move(row_type).value(),
+                                  service_->options().stream,
+                                  service_->queries());
+  if (!stream.ok()) {
+    return toGrpc(stream.status());
+  }
+  {
+    std::lock_guard lock(mutex_);
+    stream_ = std::move(stream).value();
+    if (cancelled_) {
+      stream_->cancel();
+      return {grpc::StatusCode::CANCELLED, "call cancelled"};
+    }
+  }
+  auto schema = schemaResponse(*stream_->schema(), service_->writeOptions());
+  if (!schema.ok()) {
+    return toGrpc(schema.status());
+  }
+  if (!write(std::move(schema).value())) {
+    return {grpc::StatusCode::CANCELLED, "client went away"};
+  }
+  while (true) {
+    std::shared_ptr<arrow::RecordBatch> batch;
+    const auto status = stream_->ReadNext(&batch);
+    if (!status.ok()) {
+      return toGrpc(status);
+    }
+    if (batch == nullptr) {
+      return grpc::Status::OK;
+    }
+    auto response = batchResponse(*batch, service_->writeOptions());
+    if (!response.ok()) {
+      return toGrpc(response.status());
+    }
+    if (!write(std::move(response).value())) {
+      return {grpc::StatusCode::CANCELLED, "client went away"};
+    }
+  }
+}
+
+// gRPC front end over a QueryEngine: QueryService.Execute in
+// query_service.proto runs a statement and streams its result as Arrow IPC
+// messages, converted from the Velox vectors without copying fixed-width
+// data and sent without copying it again into protobuf messages.
+//
+// The server also answers the standard gRPC health check, reporting
+// "halo.rpc.QueryService" as SERVING until shutdown() begins.
+export class QueryServer final {
+ public:
+  static StatusOr<std::unique_ptr<QueryServer>> start(
+      std::shared_ptr<QueryEngine> engine,
+      const QueryServiceOptions& options) {
+    if (engine == nullptr) {
+      return Status::Invalid("query engine must not be null");
+    }
+    if (options.stream.max_queued_bytes == 0) {
+      return Status::Invalid("max_queued_bytes must be positive");
+    }
+    if (options.query_threads == 0 || options.writer_threads == 0) {
+      return Status::Invalid(
+          "query_threads and writer_threads must be positive");
+    }
+    if (options.stream.memory_limit_bytes == 0 ||
+        options.stream.memory_limit_bytes > options.memory_quota_bytes) {
+      return Status::Invalid(
+          "memory_limit_bytes must be positive and within "
+          "memory_quota_bytes");
+    }
+    auto service = std::make_unique<QueryService>(std::move(engine), options);
+
+    grpc::EnableDefaultHealthCheckService(true);
+    grpc::ResourceQuota quota("halo_query_service");
+    quota.Resize(options.transport_quota_bytes);
+    grpc::ServerBuilder builder;
+    builder.SetResourceQuota(quota);
+    int port = 0;
+    builder.AddListeningPort(options.host + ":" + std::to_string(options.port),
+                             grpc::InsecureServerCredentials(), &port);
+    builder.RegisterCallbackGenericService(service.get());
+    auto server = builder.BuildAndStart();
+    if (server == nullptr || port == 0) {
+      return Status::StorageError("cannot serve gRPC on " + options.host +
+                                  ":" + std::to_string(options.port));
+    }
+    server->GetHealthCheckService()->SetServingStatus(
+        std::string(kServiceName), true);
+    return std::unique_ptr<QueryServer>(
+        new QueryServer(std::move(service), std::move(server), port));
+  }
+
+  QueryServer(const QueryServer&) = delete;
+  QueryServer& operator=(const QueryServer&) = delete;
+
+  ~QueryServer() { shutdown(); }
+
+  [[nodiscard]] int port() const { return port_; }
+
+  // Reports NOT_SERVING, lets running calls finish within the grace period
+  // and cancels the rest.
+  void shutdown() {
+    if (server_ == nullptr) {
+      return;
+    }
+    server_->GetHealthCheckService()->SetServingStatus(
+        std::string(kServiceName), false);
+    server_->Shutdown(std::chrono::system_clock::now() +
+                      service_->options().shutdown_grace);
+    server_->Wait();
+    server_.reset();
+  }
+
+ private:
+  QueryServer(std::unique_ptr<QueryService> service,
+              std::unique_ptr<grpc::Server> server, int port)
+      : service_(std::move(service)), server_(std::move(server)), port_(port) {}
+
+  // Outlives the server, whose calls reference it.
+  std::unique_ptr<QueryService> service_;
+  std::unique_ptr<grpc::Server> server_;
+  int port_;
+};
+
+}  // namespace halo::server::rpc
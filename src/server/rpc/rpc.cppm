@@ -0,0 +1,3 @@
+export module halo.server.rpc;
+export import :Messages;
+export import :QueryService;
@@ -0,0 +1,246 @@
+module;
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <duckdb.hpp>
+
+export module halo.server.session:ConnectionPool;
+import halo.common;
+import :SessionSettings;
+
+namespace halo::server::session {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+// An engine connection and the session settings now applied to it.
+struct PooledConnection {
+  std::unique_ptr<duckdb::Connection> connection;
+  SessionSettings applied;
+};
+
+export struct PoolStats {
+  // Connections open, leased or idle.
+  std::size_t open = 0;
+  std::size_t idle = 0;
+  // Checkouts so far, and those that had to wait for a connection.
+  std::uint64_t checkouts = 0;
+  std::uint64_t waits = 0;
+  // Checkouts that had to change settings on the connection they got.
+  std::uint64_t setting_changes = 0;
+};
+
+export class ConnectionPool;
+
+// Exclusive use of one pooled connection until destroyed, when the
+// connection goes back to the pool. A DuckDB connection runs one query at a
+// time, so a lease must not be shared between threads.
+export class ConnectionLease final {
+ public:
+  ConnectionLease(ConnectionLease&& other) noexcept = default;
+  ConnectionLease& operator=(ConnectionLease&& other) noexcept {
+    if (this != &other) {
+      release();
+      pool_ = std::move(other.pool_);
+      pooled_ = std::move(other.pooled_);
+      discard_ = other.discard_;
+    }
+    return *this;
+  }
+
+  ConnectionLease(const ConnectionLease&) = delete;
+  ConnectionLease& operator=(const ConnectionLease&) = delete;
+
+  ~ConnectionLease() { release(); }
+
+  duckdb::Connection& connection() { return *pooled_->connection; }
+
+  // Settings in effect on the connection. Whoever changes them through SQL
+  // run on the lease must record it here, or the next session to get the
+  // connection inherits the change.
+  SessionSettings& applied() { return pooled_->applied; }
+
+  // Closes the connection instead of pooling it again, for one left in a
+  // state the next session must not see.
+  void discard() { discard_ = true; }
+
+ private:
+  friend class ConnectionPool;
+
+  ConnectionLease(std::shared_ptr<ConnectionPool> pool,
+                  std::unique_ptr<PooledConnection> pooled)
+      : pool_(std::move(pool)), pooled_(std::move(pooled)) {}
+
+  void release();
+
+  std::shared_ptr<ConnectionPool> pool_;
+  std::unique_ptr<PooledConnection> pooled_;
+  bool discard_ = false;
+};
+
+// At most `max_connections' connections to one database, opened on demand
+// and kept for reuse. Connections cost far more to set up than a short
+// query takes to run, so any number of sessions share the pool: a checkout
+// takes an idle connection, preferably one that already has the session's
+// settings, and otherwise waits for one to come back.
+export class ConnectionPool final
+    : public std::enable_shared_from_this<ConnectionPool> {
+ public:
+  static std::shared_ptr<ConnectionPool> create(
+      std::shared_ptr<duckdb::DuckDB> database, std::size_t max_connections) {
+    return std::shared_ptr<ConnectionPool>(
+        new ConnectionPool(std::move(database), max_connections));
+  }
+
+  ConnectionPool(const ConnectionPool&) = delete;
+  ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+  // A connection with `settings' applied, waiting up to `timeout' for one
+  // to be free.
+  StatusOr<ConnectionLease> checkout(const SessionSettings& settings,
+                                     std::chrono::milliseconds timeout) {
+    std::unique_ptr<PooledConnection> pooled;
+    {
+      std::unique_lock lock(mutex_);
+      ++stats_.checkouts;
+      const auto available = [this] {
+        return !idle_.empty() || open_ < max_connections_;
+      };
+      if (!available()) {
+        ++stats_.waits;
+        if (!available_.wait_for(lock, timeout, available)) {
+          return Status::QueryExecutorError(
+              "no database connection free within " +
+              std::to_string(timeout.count()) + " ms");
+        }
+      }
+      if (!idle_.empty()) {
+        pooled = takeIdle(settings);
+      } else {
+        ++open_;
+      }
+    }
+    if (pooled == nullptr) {
+      auto opened = open();
+      if (!opened.ok()) {
+        closed();
+        return opened.status();
+      }
+      pooled = std::move(opened).value();
+    }
+
+    ConnectionLease lease(shared_from_this(), std::move(pooled));
+    const auto delta = settingsDelta(lease.applied(), settings);
+    if (!delta.empty()) {
+      {
+        const std::scoped_lock lock(mutex_);
+        ++stats_.setting_changes;
+      }
+      const auto result = lease.connection().Query(delta);
+      if (result->HasError()) {
+        // Part of the delta may have run; the connection's settings are
+        // no longer known.
+        lease.discard();
+        return Status::Invalid("cannot apply session settings: " +
+                               result->GetError());
+      }
+      lease.applied() = settings;
+    }
+    return lease;
+  }
+
+  [[nodiscard]] PoolStats stats() const {
+    const std::scoped_lock lock(mutex_);
+    auto stats = stats_;
+    stats.open = open_;
+    stats.idle = idle_.size();
+    return stats;
+  }
+
+ private:
+  friend class ConnectionLease;
+
+  ConnectionPool(std::shared_ptr<duckdb::DuckDB> database,
+                 std::size_t max_connections)
+      : database_(std::move(database)),
+        max_connections_(std::max<std::size_t>(max_connections, 1)) {}
+
+  StatusOr<std::unique_ptr<PooledConnection>> open() {
+    try {
+      auto pooled = std::make_unique<PooledConnection>();
+      pooled->connection = std::make_unique<duckdb::Connection>(*database_);
+      return pooled;
+    } catch (const std::exception& e) {
+      return Status::StorageError(std::string("cannot connect to database: ") +
+                                  e.what());
+    }
+  }
+
+  // The idle connection whose settings match `settings', or else the one
+  // returned last. Called with `mutex_' held.
+  std::unique_ptr<PooledConnection> takeIdle(const SessionSettings& settings) {
+    auto chosen = std::prev(idle_.end());
+    for (auto it = idle_.begin(); it != idle_.end(); ++it) {
+      if ((*it)->applied == settings) {
+        chosen = it;
+        break;
+      }
+    }
+    auto pooled = std::move(*chosen);
+    idle_.erase(chosen);
+    return pooled;
+  }
+
+  void checkin(std::unique_ptr<PooledConnection> pooled, bool discard) {
+    // A transaction left open would hold its locks and snapshot into the
+    // next session.
+    if (!discard && pooled->connection->HasActiveTransaction()) {
+      discard = pooled->connection->Query("ROLLBACK")->HasError();
+    }
+    if (discard) {
+      pooled.reset();
+      closed();
+      return;
+    }
+    {
+      const std::scoped_lock lock(mutex_);
+      idle_.push_back(std::move(pooled));
+    }
+    available_.notify_one();
+  }
+
+  void closed() {
+    {
+      const std::scoped_lock lock(mutex_);
+      --open_;
+    }
+    available_.notify_one();
+  }
+
+  const std::shared_ptr<duckdb::DuckDB> database_;
+  const std::size_t max_connections_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable available_;
+  std::vector<std::unique_ptr<PooledConnection>> idle_;
+  std::size_t open_ = 0;
+  PoolStats stats_;
+};
+
+void ConnectionLease::release() {
+  if (pool_ != nullptr && pooled_ != nullptr) {
+    pool_->checkin(std::move(pooled_), discard_);
+  }
+  pool_.reset();
+}
+
+}  // namespace halo::server::session
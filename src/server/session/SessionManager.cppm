@@ -0,0 +1,205 @@
+module;
+#include <cctype>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <duckdb.hpp>
+
+export module halo.server.session:SessionManager;
+import halo.common;
+import :ConnectionPool;
+import :SessionSettings;
+
+namespace halo::server::session {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+std::string settingKey(const std::string& name) {
+  std::string key = name;
+  for (auto& c : key) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  return key;
+}
+
+export struct SessionManagerOptions {
+  // Connections per database, shared by every session on it.
+  std::size_t connections_per_database = std::thread::hardware_concurrency();
+  // How long a query waits for a free connection before it fails.
+  std::chrono::milliseconds checkout_timeout{30000};
+  // DuckDB options of every database opened, such as `threads' or
+  // `memory_limit'.
+  std::map<std::string, std::string> database_options;
+};
+
+// One client's view of a database: its settings and nothing else, so that
+// thousands of them cost next to nothing. Each query borrows a pooled
+// connection, brings its settings in line with the session's and gives it
+// back afterwards.
+//
+// State DuckDB keeps per connection other than settings is not shared
+// with other sessions, and only lasts as long as the connection's lease. A
+// query creating a temporary table, view or macro, a prepared statement, a
+// `USE' or `SET VARIABLE' value has its connection closed rather than
+// pooled once the lease ends; a transaction still open then is rolled
+// back. Using such state over several statements needs a lease held across
+// them (see `checkout').
+export class Session final {
+ public:
+  Session(const Session&) = delete;
+  Session& operator=(const Session&) = delete;
+
+  // Runs `sql' to completion, keeping the SETs and RESETs among its
+  // statements for the session's later queries.
+  StatusOr<std::unique_ptr<duckdb::MaterializedQueryResult>> query(
+      const std::string& sql) {
+    auto lease = checkout();
+    if (!lease.ok()) {
+      return lease.status();
+    }
+    return query(*lease, sql);
+  }
+
+  // Runs `sql' on a connection leased from `checkout'.
+  StatusOr<std::unique_ptr<duckdb::MaterializedQueryResult>> query(
+      ConnectionLease& lease, const std::string& sql) {
+    const auto scan = scanSettings(sql);
+    std::unique_ptr<duckdb::MaterializedQueryResult> result;
+    try {
+      result = lease.connection().Query(sql);
+    } catch (const std::exception& e) {
+      lease.discard();
+      return Status::QueryExecutorError(e.what());
+    }
+    if (scan.opaque || (result->HasError() && !scan.changes.empty())) {
+      // Which settings took effect is unknown.
+      lease.discard();
+    } else {
+      apply(scan.changes, lease.applied());
+    }
+    if (result->HasError()) {
+      return Status::QueryExecutorError(result->GetError());
+    }
+    apply(scan.changes, settings_);
+    return result;
+  }
+
+  // A connection with this session's settings for several statements in a
+  // row. Settings changed through it by `query(lease, sql)' are kept.
+  StatusOr<ConnectionLease> checkout() {
+    return pool_->checkout(settings_, timeout_);
+  }
+
+  // Sets `name' to the SQL expression `value' from the next query on.
+  Status set(const std::string& name, const std::string& value) {
+    if (!isSettingName(name)) {
+      return Status::Invalid("not a setting name: " + name);
+    }
+    if (value.empty()) {
+      return Status::Invalid("no value for setting " + name);
+    }
+    settings_[settingKey(name)] = value;
+    return Status::OK();
+  }
+
+  // Returns `name' to the database default from the next query on.
+  void reset(const std::string& name) {
+    settings_.erase(settingKey(name));
+  }
+
+  [[nodiscard]] const SessionSettings& settings() const { return settings_; }
+
+ private:
+  friend class SessionManager;
+
+  Session(std::shared_ptr<ConnectionPool> pool,
+          std::chrono::milliseconds timeout)
+      : pool_(std::move(pool)), timeout_(timeout) {}
+
+  const std::shared_ptr<ConnectionPool> pool_;
+  const std::chrono::milliseconds timeout_;
+  SessionSettings settings_;
+};
+
+// Keeps each database open for as long as the manager lives and hands out
+// sessions multiplexed onto its connection pool. Safe to use from any
+// number of threads; a single session is not.
+export class SessionManager final {
+ public:
+  static std::shared_ptr<SessionManager> create(
+      SessionManagerOptions options = {}) {
+    return std::shared_ptr<SessionManager>(
+        new SessionManager(std::move(options)));
+  }
+
+  SessionManager(const SessionManager&) = delete;
+  SessionManager& operator=(const SessionManager&) = delete;
+
+  // A new session on the database file at `path', or on the manager's
+  // in-memory database for an empty path or `:memory:'. The database is
+  // opened by its first session.
+  StatusOr<std::unique_ptr<Session>> openSession(const std::string& path = "") {
+    auto pool = database(path == ":memory:" ? std::string() : path);
+    if (!pool.ok()) {
+      return pool.status();
+    }
+    return std::unique_ptr<Session>(
+        new Session(std::move(pool).value(), options_.checkout_timeout));
+  }
+
+  // Pool usage of the database at `path', or nullopt if it is not open.
+  [[nodiscard]] std::optional<PoolStats> stats(
+      const std::string& path = "") const {
+    const std::scoped_lock lock(mutex_);
+    const auto it = pools_.find(path == ":memory:" ? std::string() : path);
+    if (it == pools_.end()) {
+      return std::nullopt;
+    }
+    return it->second->stats();
+  }
+
+ private:
+  explicit SessionManager(SessionManagerOptions options)
+      : options_(std::move(options)) {}
+
+  // Opening a database file takes a while and must happen once per file,
+  // so it runs under the lock.
+  StatusOr<std::shared_ptr<ConnectionPool>> database(const std::string& path) {
+    const std::scoped_lock lock(mutex_);
+    if (const auto it = pools_.find(path); it != pools_.end()) {
+      return it->second;
+    }
+    std::shared_ptr<duckdb::DuckDB> database;
+    try {
+      duckdb::DBConfig config;
+      for (const auto& [name, value] : options_.database_options) {
+        config.SetOptionByName(name, duckdb::Value(value));
+      }
+      database = std::make_shared<duckdb::DuckDB>(
+          path.empty() ? nullptr : path.c_str(), &config);
+    } catch (const std::exception& e) {
+      return Status::StorageError("cannot open database " +
+                                  (path.empty() ? ":memory:" : path) + ": " +
+                                  e.what());
+    }
+    auto pool = ConnectionPool::create(std::move(database),
+                                       options_.connections_per_database);
+    pools_.emplace(path, pool);
+    return pool;
+  }
+
+  const SessionManagerOptions options_;
+  mutable std::mutex mutex_;
+  std::map<std::string, std::shared_ptr<ConnectionPool>> pools_;
+};
+
+}  // namespace halo::server::session
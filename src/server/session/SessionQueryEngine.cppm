@@ -0,0 +1,168 @@
+module;
+#include <velox/common/memory/MemoryPool.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/arrow/Abi.h>
+#include <velox/vector/arrow/Bridge.h>
+
+#include <exception>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <duckdb.hpp>
+#include <duckdb/common/arrow/arrow_converter.hpp>
+
+export module halo.server.session:SessionQueryEngine;
+import halo.common;
+import halo.server.engine;
+import :SessionManager;
+
+namespace halo::server::session {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+using halo::server::engine::QueryEngine;
+using halo::server::engine::RowVectorSink;
+
+namespace velox = facebook::velox;
+
+// Releases the C structures an import did not take over.
+void releaseArrow(ArrowSchema& schema, ArrowArray* array = nullptr) {
+  if (schema.release != nullptr) {
+    schema.release(&schema);
+  }
+  if (array != nullptr && array->release != nullptr) {
+    array->release(array);
+  }
+}
+
+// The Velox row type of DuckDB result columns, by way of their Arrow
+// schema.
+StatusOr<velox::RowTypePtr> rowType(
+    const duckdb::vector<duckdb::LogicalType>& types,
+    const duckdb::vector<std::string>& names,
+    duckdb::ClientProperties properties) {
+  ArrowSchema schema{};
+  try {
+    duckdb::ArrowConverter::ToArrowSchema(&schema, types, names, properties);
+    auto type = velox::asRowType(velox::importFromArrow(schema));
+    releaseArrow(schema);
+    if (type == nullptr) {
+      return Status::QueryExecutorError("result is not a row type");
+    }
+    return type;
+  } catch (const std::exception& e) {
+    releaseArrow(schema);
+    return Status::QueryExecutorError(
+        std::string("cannot convert result type: ") + e.what());
+  }
+}
+
+// QueryEngine over a DuckDB database of a SessionManager. Every call runs
+// in a session of its own with the database's default settings, so calls
+// from several streams never share one; sessions cost next to nothing and
+// the connections under them are pooled. Result chunks are handed to the
+// sink as Velox vectors imported from DuckDB's Arrow export.
+export class SessionQueryEngine final : public QueryEngine {
+ public:
+  // An engine on the database at `path' of `sessions', which is opened
+  // here if no session has opened it yet.
+  static StatusOr<std::shared_ptr<SessionQueryEngine>> create(
+      std::shared_ptr<SessionManager> sessions, std::string path = "") {
+    if (sessions == nullptr) {
+      return Status::Invalid("session manager must not be null");
+    }
+    if (auto session = sessions->openSession(path); !session.ok()) {
+      return session.status();
+    }
+    return std::shared_ptr<SessionQueryEngine>(
+        new SessionQueryEngine(std::move(sessions), std::move(path)));
+  }
+
+  // Prepares `query' on a pooled connection without running it.
+  StatusOr<velox::RowTypePtr> describe(const std::string& query) override {
+    auto session = sessions_->openSession(path_);
+    if (!session.ok()) {
+      return session.status();
+    }
+    auto lease = (*session)->checkout();
+    if (!lease.ok()) {
+      return lease.status();
+    }
+    std::unique_ptr<duckdb::PreparedStatement> prepared;
+    try {
+      prepared = lease->connection().Prepare(query);
+    } catch (const std::exception& e) {
+      lease->discard();
+      return Status::QueryExecutorError(e.what());
+    }
+    if (prepared->HasError()) {
+      return Status::QueryExecutorError(prepared->GetError());
+    }
+    return rowType(prepared->GetTypes(), prepared->GetNames(),
+                   lease->connection().context->GetClientProperties());
+  }
+
+  // DuckDB materializes the whole result before the first batch reaches
+  // `sink'; its own memory limit, not `pool', bounds that.
+  Status execute(const std::string& query, velox::memory::MemoryPool* pool,
+                 const RowVectorSink& sink) override {
+    auto session = sessions_->openSession(path_);
+    if (!session.ok()) {
+      return session.status();
+    }
+    auto result = (*session)->query(query);
+    if (!result.ok()) {
+      return result.status();
+    }
+    auto& rows = **result;
+    const duckdb::unordered_map<
+        duckdb::idx_t, const duckdb::shared_ptr<duckdb::ArrowTypeExtensionData>>
+        no_extensions;
+    while (true) {
+      std::unique_ptr<duckdb::DataChunk> chunk;
+      try {
+        chunk = rows.Fetch();
+      } catch (const std::exception& e) {
+        return Status::QueryExecutorError(e.what());
+      }
+      if (chunk == nullptr || chunk->size() == 0) {
+        return Status::OK();
+      }
+      ArrowSchema c_schema{};
+      ArrowArray c_array{};
+      velox::RowVectorPtr batch;
+      try {
+        auto properties = rows.client_properties;
+        duckdb::ArrowConverter::ToArrowSchema(&c_schema, rows.types,
+                                              rows.names, properties);
+        duckdb::ArrowConverter::ToArrowArray(*chunk, &c_array, properties,
+                                             no_extensions);
+        // Takes ownership of both C structures.
+        batch = std::dynamic_pointer_cast<velox::RowVector>(
+            velox::importFromArrowAsOwner(c_schema, c_array, pool));
+      } catch (const std::exception& e) {
+        releaseArrow(c_schema, &c_array);
+        return Status::QueryExecutorError(
+            std::string("cannot convert result chunk: ") + e.what());
+      }
+      if (batch == nullptr) {
+        return Status::QueryExecutorError("result chunk is not a row vector");
+      }
+      if (auto status = sink(std::move(batch)); !status.ok()) {
+        return status;
+      }
+    }
+  }
+
+ private:
+  SessionQueryEngine(std::shared_ptr<SessionManager> sessions,
+                     std::string path)
+      : sessions_(std::move(sessions)), path_(std::move(path)) {}
+
+  const std::shared_ptr<SessionManager> sessions_;
+  const std::string path_;
+};
+
+}  // namespace halo::server::session
@@ -0,0 +1,253 @@
+module;
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+export module halo.server.session:SessionSettings;
+
+namespace halo::server::session {
+
+// Session-scoped DuckDB settings by lower-case name, each with the SQL text
+// of its value as the session wrote it. Settings absent from the map have
+// their database default.
+export using SessionSettings = std::map<std::string, std::string>;
+
+// A SET or RESET of one session setting; `value' is empty for a RESET.
+export struct SettingChange {
+  std::string name;
+  std::optional<std::string> value;
+};
+
+// What the statements of one query text do to session settings.
+export struct SettingScan {
+  std::vector<SettingChange> changes;
+  // A statement touched per-connection state this scan cannot follow: a
+  // temporary table, view or macro, a prepared statement, `USE', `SET
+  // VARIABLE' or a malformed SET. The connection that ran it must not be
+  // handed to another session.
+  bool opaque = false;
+};
+
+// Whether `name' is a plain, possibly dotted, setting name that can go
+// back into SQL unquoted.
+export bool isSettingName(std::string_view name) {
+  if (name.empty() || name.front() == '.' || name.back() == '.') {
+    return false;
+  }
+  for (const char c : name) {
+    if (std::isalnum(static_cast<unsigned char>(c)) == 0 && c != '_' &&
+        c != '.') {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string lower(std::string_view text) {
+  std::string result(text);
+  for (auto& c : result) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  return result;
+}
+
+std::string_view trim(std::string_view text) {
+  while (!text.empty() &&
+         std::isspace(static_cast<unsigned char>(text.front())) != 0) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() &&
+         std::isspace(static_cast<unsigned char>(text.back())) != 0) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+// Splits `text' into statements at semicolons outside quotes and comments,
+// with comments blanked out.
+std::vector<std::string> splitStatements(std::string_view text) {
+  std::vector<std::string> statements;
+  std::string current;
+  std::size_t i = 0;
+  while (i < text.size()) {
+    const char c = text[i];
+    if (c == '\'' || c == '"') {
+      const auto close = text.find(c, i + 1);
+      const auto end = close == std::string_view::npos ? text.size()
+                                                       : close + 1;
+      current.append(text.substr(i, end - i));
+      i = end;
+    } else if (text.substr(i, 2) == "--") {
+      const auto end = text.find('\n', i);
+      i = end == std::string_view::npos ? text.size() : end;
+      current.push_back(' ');
+    } else if (text.substr(i, 2) == "/*") {
+      const auto end = text.find("*/", i + 2);
+      i = end == std::string_view::npos ? text.size() : end + 2;
+      current.push_back(' ');
+    } else if (c == ';') {
+      statements.push_back(std::move(current));
+      current.clear();
+      ++i;
+    } else {
+      current.push_back(c);
+      ++i;
+    }
+  }
+  statements.push_back(std::move(current));
+  return statements;
+}
+
+// Takes the leading word of `text' off it, lower-cased.
+std::string nextWord(std::string_view& text) {
+  text = trim(text);
+  std::size_t end = 0;
+  while (end < text.size() &&
+         (std::isalnum(static_cast<unsigned char>(text[end])) != 0 ||
+          text[end] == '_' || text[end] == '.')) {
+    ++end;
+  }
+  auto word = lower(text.substr(0, end));
+  text.remove_prefix(end);
+  return word;
+}
+
+// Whether a statement starting with `verb' leaves state other than
+// settings on the connection that runs it: `PREPARE', `USE' and `CREATE
+// [OR REPLACE] TEMP[ORARY] ...'.
+bool keepsConnectionState(const std::string& verb, std::string_view rest) {
+  if (verb == "prepare" || verb == "use") {
+    return true;
+  }
+  if (verb != "create") {
+    return false;
+  }
+  auto word = nextWord(rest);
+  if (word == "or" && nextWord(rest) == "replace") {
+    word = nextWord(rest);
+  }
+  return word == "temp" || word == "temporary";
+}
+
+enum class Scope : std::uint8_t { kSession, kGlobal, kUnknown };
+
+// Consumes an optional scope keyword of a SET or RESET.
+Scope scope(std::string_view& text, std::string& word) {
+  if (word == "session" || word == "local") {
+    word = nextWord(text);
+    return Scope::kSession;
+  }
+  if (word == "global") {
+    word = nextWord(text);
+    return Scope::kGlobal;
+  }
+  if (word == "variable") {
+    return Scope::kUnknown;
+  }
+  return Scope::kSession;
+}
+
+// Finds the SETs and RESETs among the statements of `sql', and the
+// statements that make it opaque, on the DuckDB
+// grammar `SET [SESSION|LOCAL|GLOBAL] name {=|TO} value' and
+// `RESET [SESSION|LOCAL|GLOBAL] name'. Global settings belong to the
+// database rather than the connection and are left out. A plain SET of an
+// option DuckDB only knows globally, such as `threads', is still taken for
+// a session setting and undone when another session gets the connection;
+// those belong in the database configuration or a `SET GLOBAL'.
+export SettingScan scanSettings(std::string_view sql) {
+  SettingScan scan;
+  for (const auto& statement : splitStatements(sql)) {
+    std::string_view rest = statement;
+    const auto verb = nextWord(rest);
+    if (keepsConnectionState(verb, rest)) {
+      scan.opaque = true;
+      continue;
+    }
+    if (verb != "set" && verb != "reset") {
+      continue;
+    }
+    auto name = nextWord(rest);
+    const auto where = scope(rest, name);
+    if (where == Scope::kGlobal) {
+      continue;
+    }
+    if (where == Scope::kUnknown || !isSettingName(name)) {
+      scan.opaque = true;
+      continue;
+    }
+    rest = trim(rest);
+    if (verb == "reset") {
+      if (!rest.empty()) {
+        scan.opaque = true;
+        continue;
+      }
+      scan.changes.push_back({.name = std::move(name)});
+      continue;
+    }
+    if (rest.starts_with('=')) {
+      rest.remove_prefix(1);
+    } else if (lower(rest.substr(0, 2)) == "to" && rest.size() > 2 &&
+               std::isspace(static_cast<unsigned char>(rest[2])) != 0) {
+      rest.remove_prefix(2);
+    } else {
+      scan.opaque = true;
+      continue;
+    }
+    rest = trim(rest);
+    if (rest.empty()) {
+      scan.opaque = true;
+      continue;
+    }
+    scan.changes.push_back(
+        {.name = std::move(name), .value = std::string(rest)});
+  }
+  return scan;
+}
+
+export void apply(const std::vector<SettingChange>& changes,
+                  SessionSettings& settings) {
+  for (const auto& change : changes) {
+    if (change.value) {
+      settings[change.name] = *change.value;
+    } else {
+      settings.erase(change.name);
+    }
+  }
+}
+
+// Statements taking a connection from settings `from' to `to': a RESET
+// for every setting only `from' has and a SET for every value that
+// differs. Empty when the two agree, which is the common case of a
+// session getting back the connection it used last.
+export std::string settingsDelta(const SessionSettings& from,
+                                 const SessionSettings& to) {
+  std::string sql;
+  auto old_setting = from.begin();
+  auto new_setting = to.begin();
+  while (old_setting != from.end() || new_setting != to.end()) {
+    if (new_setting == to.end() || (old_setting != from.end() &&
+                                    old_setting->first < new_setting->first)) {
+      sql += "RESET " + old_setting->first + ";";
+      ++old_setting;
+    } else if (old_setting == from.end() ||
+               new_setting->first < old_setting->first) {
+      sql += "SET " + new_setting->first + " = " + new_setting->second + ";";
+      ++new_setting;
+    } else {
+      if (old_setting->second != new_setting->second) {
+        sql += "SET " + new_setting->first + " = " + new_setting->second + ";";
+      }
+      ++old_setting;
+      ++new_setting;
+    }
+  }
+  return sql;
+}
+
+}  // namespace halo::server::session
@@ -0,0 +1,5 @@
+export module halo.server.session;
+export import :ConnectionPool;
+export import :SessionManager;
+export import :SessionQueryEngine;
+export import :SessionSettings;
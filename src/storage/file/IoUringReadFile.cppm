@@ -0,0 +1,589 @@
+module;
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define HALO_HAS_IO_URING 1
+#else
+#define HALO_HAS_IO_URING 0
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+export module halo.storage.file:IoUringReadFile;
+import halo.common;
+import :ReadFile;
+
+namespace halo::storage::file {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+export struct IoUringOptions {
+  // Submission queue entries per ring, i.e. the queue depth one batch can
+  // keep in flight.
+  unsigned queue_depth = 64;
+  // Most rings alive at once, shared by every file of the process opened
+  // with the same ring shape (queue depth and buffers). Rings are created
+  // as concurrent preadv calls need them; each call owns one ring for its
+  // duration, and further callers wait for a ring to become free.
+  std::size_t rings = 16;
+  // Bounce buffers registered with each ring (IORING_REGISTER_BUFFERS).
+  // Coalesced reads land in them via READ_FIXED and are then scattered to
+  // the callers' buffers. Single ranges are read straight into the caller's
+  // buffer.
+  std::size_t registered_buffers = 8;
+  std::size_t registered_buffer_bytes = 256 * 1024;
+  // Ranges closer than this are merged into one read.
+  std::uint64_t coalesce_gap = 16 * 1024;
+};
+
+#if HALO_HAS_IO_URING
+
+// Largest length issued in one SQE; longer reads continue as short reads.
+constexpr std::uint64_t kMaxReadPerSqe = std::uint64_t{1} << 30;
+
+int ioUringSetup(unsigned entries, io_uring_params* params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned to_submit, unsigned min_complete,
+                 unsigned flags) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit,
+                                    min_complete, flags, nullptr, 0));
+}
+
+int ioUringRegister(int fd, unsigned opcode, const void* arg,
+                    unsigned nr_args) {
+  return static_cast<int>(
+      ::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+// One io_uring instance plus its bounce buffers. Not thread-safe: a ring is
+// owned by a single batch at a time. A ring whose io_uring_enter failed is
+// broken and must be destroyed rather than reused.
+class IoUring final {
+ public:
+  static StatusOr<std::unique_ptr<IoUring>> create(
+      const IoUringOptions& options) {
+    io_uring_params params{};
+    const int fd = ioUringSetup(options.queue_depth, &params);
+    if (fd < 0) {
+      const int error = errno;
+      if (error == ENOSYS || error == EPERM) {
+        return Status::NotImplemented(std::string("io_uring unavailable: ") +
+                                      std::strerror(error));
+      }
+      return Status::StorageError(std::string("io_uring_setup failed: ") +
+                                  std::strerror(error));
+    }
+    std::unique_ptr<IoUring> ring(new IoUring(fd));
+    auto status = ring->map(params);
+    if (!status.ok()) {
+      return status;
+    }
+    status = ring->allocateBuffers(options);
+    if (!status.ok()) {
+      return status;
+    }
+    return ring;
+  }
+
+  IoUring(const IoUring&) = delete;
+  IoUring& operator=(const IoUring&) = delete;
+  IoUring(IoUring&&) = delete;
+  IoUring& operator=(IoUring&&) = delete;
+
+  ~IoUring() {
+    if (sqes_ != nullptr) {
+      ::munmap(sqes_, sqes_bytes_);
+    }
+    if (cq_ptr_ != nullptr && cq_ptr_ != sq_ptr_) {
+      ::munmap(cq_ptr_, cq_bytes_);
+    }
+    if (sq_ptr_ != nullptr) {
+      ::munmap(sq_ptr_, sq_bytes_);
+    }
+    ::close(fd_);
+    for (auto& buffer : buffers_) {
+      std::free(buffer.iov_base);
+    }
+  }
+
+  [[nodiscard]] bool broken() const { return broken_; }
+
+  // Reads `reads' (coalesced from `ranges') from `fd', keeping up to the
+  // queue depth in flight. On error, no new reads are issued but those in
+  // flight are drained before returning, since the kernel still writes into
+  // their buffers. That holds when io_uring_enter itself fails too: the
+  // kernel posts completions as the thread returns to user space, so they
+  // are awaited by polling the completion queue.
+  Status run(int fd, std::span<const ReadRange> ranges,
+             std::span<char* const> buffers,
+             std::span<const CoalescedRead> reads) {
+    struct Op {
+      std::uint64_t offset = 0;
+      std::uint64_t remaining = 0;
+      char* cursor = nullptr;
+      int buffer = -1;
+    };
+    std::vector<Op> ops(reads.size());
+    std::vector<int> free_buffers(buffers_.size());
+    for (std::size_t i = 0; i < free_buffers.size(); ++i) {
+      free_buffers[i] = static_cast<int>(i);
+    }
+
+    Status status = Status::OK();
+    std::size_t next = 0;
+    unsigned in_flight = 0;
+    unsigned to_submit = 0;
+    while (in_flight > 0 || (status.ok() && next < reads.size())) {
+      while (status.ok() && next < reads.size() && in_flight < sq_entries_) {
+        const auto& read = reads[next];
+        auto& op = ops[next];
+        op.offset = read.offset;
+        op.remaining = read.length;
+        if (read.ranges.size() == 1) {
+          op.cursor = buffers[read.ranges.front()];
+        } else {
+          if (free_buffers.empty()) {
+            break;
+          }
+          op.buffer = free_buffers.back();
+          free_buffers.pop_back();
+          op.cursor = static_cast<char*>(buffers_[op.buffer].iov_base);
+        }
+        queueRead(fd, next, op.offset, op.remaining, op.cursor, op.buffer);
+        ++to_submit;
+        ++in_flight;
+        ++next;
+      }
+
+      const int entered =
+          ioUringEnter(fd_, to_submit, 1, IORING_ENTER_GETEVENTS);
+      if (entered >= 0) {
+        to_submit -= std::min(to_submit, static_cast<unsigned>(entered));
+      } else if (errno != EINTR) {
+        if (status.ok()) {
+          status = Status::StorageError(
+              std::string("io_uring_enter failed: ") + std::strerror(errno));
+        }
+        // Entries the kernel never consumed will not complete.
+        broken_ = true;
+        in_flight -= to_submit;
+        to_submit = 0;
+        if (in_flight > 0) {
+          const timespec pause{.tv_sec = 0, .tv_nsec = 100'000};
+          ::nanosleep(&pause, nullptr);
+        }
+      }
+
+      unsigned head = *cq_head_;
+      const unsigned tail =
+          std::atomic_ref<unsigned>(*cq_tail_).load(std::memory_order_acquire);
+      for (; head != tail; ++head) {
+        const io_uring_cqe cqe = cqes_[head & cq_mask_];
+        const auto index = static_cast<std::size_t>(cqe.user_data);
+        auto& op = ops[index];
+        const bool retry = cqe.res == -EINTR || cqe.res == -EAGAIN;
+        if (retry && !broken_) {
+          queueRead(fd, index, op.offset, op.remaining, op.cursor, op.buffer);
+          ++to_submit;
+          continue;
+        }
+        if (cqe.res < 0 || (cqe.res == 0 && op.remaining > 0)) {
+          if (status.ok()) {
+            status = cqe.res < 0
+                         ? Status::StorageError(
+                               std::string("io_uring read failed: ") +
+                               std::strerror(-cqe.res))
+                         : Status::StorageError(
+                               "unexpected end of file at offset " +
+                               std::to_string(op.offset));
+          }
+          release(op, free_buffers);
+          --in_flight;
+          continue;
+        }
+        const auto done = static_cast<std::uint64_t>(cqe.res);
+        op.offset += done;
+        op.remaining -= done;
+        op.cursor += done;
+        if (op.remaining > 0 && !broken_) {
+          queueRead(fd, index, op.offset, op.remaining, op.cursor, op.buffer);
+          ++to_submit;
+          continue;
+        }
+        if (op.remaining > 0) {
+          release(op, free_buffers);
+          --in_flight;
+          continue;
+        }
+        if (op.buffer >= 0) {
+          scatter(reads[index], ranges, buffers,
+                  static_cast<const char*>(buffers_[op.buffer].iov_base));
+        }
+        release(op, free_buffers);
+        --in_flight;
+      }
+      std::atomic_ref<unsigned>(*cq_head_).store(head,
+                                                 std::memory_order_release);
+    }
+    return status;
+  }
+
+ private:
+  explicit IoUring(int fd) : fd_(fd) {}
+
+  Status map(const io_uring_params& params) {
+    sq_entries_ = params.sq_entries;
+    sq_bytes_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_bytes_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+      sq_bytes_ = cq_bytes_ = std::max(sq_bytes_, cq_bytes_);
+    }
+    sq_ptr_ = mapRegion(sq_bytes_, IORING_OFF_SQ_RING);
+    if (sq_ptr_ == nullptr) {
+      return mapError();
+    }
+    cq_ptr_ =
+        single_mmap ? sq_ptr_ : mapRegion(cq_bytes_, IORING_OFF_CQ_RING);
+    if (cq_ptr_ == nullptr) {
+      return mapError();
+    }
+    sqes_bytes_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(
+        mapRegion(sqes_bytes_, IORING_OFF_SQES));
+    if (sqes_ == nullptr) {
+      return mapError();
+    }
+
+    auto* sq = static_cast<char*>(sq_ptr_);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    auto* cq = static_cast<char*>(cq_ptr_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return Status::OK();
+  }
+
+  void* mapRegion(std::size_t bytes, std::uint64_t offset) const {
+    void* ptr = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd_,
+                       static_cast<off_t>(offset));
+    return ptr == MAP_FAILED ? nullptr : ptr;
+  }
+
+  static Status mapError() {
+    return Status::StorageError(std::string("cannot map io_uring: ") +
+                                std::strerror(errno));
+  }
+
+  // Registration pins the buffers once instead of on every read. When the
+  // kernel refuses (e.g. RLIMIT_MEMLOCK) the same buffers are used with
+  // plain IORING_OP_READ.
+  Status allocateBuffers(const IoUringOptions& options) {
+    constexpr std::size_t kAlignment = 4096;
+    const std::size_t bytes =
+        (options.registered_buffer_bytes + kAlignment - 1) & ~(kAlignment - 1);
+    for (std::size_t i = 0; i < options.registered_buffers; ++i) {
+      void* data = std::aligned_alloc(kAlignment, bytes);
+      if (data == nullptr) {
+        return Status::StorageError("cannot allocate io_uring buffers");
+      }
+      buffers_.push_back(iovec{.iov_base = data, .iov_len = bytes});
+    }
+    fixed_buffers_ =
+        !buffers_.empty() &&
+        ioUringRegister(fd_, IORING_REGISTER_BUFFERS, buffers_.data(),
+                        static_cast<unsigned>(buffers_.size())) == 0;
+    return Status::OK();
+  }
+
+  // The caller guarantees a free SQE: at most sq_entries_ reads are in
+  // flight, and a resubmission replaces the completion that triggered it.
+  void queueRead(int fd, std::size_t index, std::uint64_t offset,
+                 std::uint64_t length, char* cursor, int buffer) {
+    const unsigned tail = *sq_tail_;
+    const unsigned slot = tail & sq_mask_;
+    io_uring_sqe* sqe = &sqes_[slot];
+    std::memset(sqe, 0, sizeof(*sqe));
+    const bool fixed = buffer >= 0 && fixed_buffers_;
+    sqe->opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->addr = reinterpret_cast<std::uint64_t>(cursor);
+    sqe->len = static_cast<std::uint32_t>(std::min(length, kMaxReadPerSqe));
+    if (fixed) {
+      sqe->buf_index = static_cast<std::uint16_t>(buffer);
+    }
+    sqe->user_data = index;
+    sq_array_[slot] = slot;
+    std::atomic_ref<unsigned>(*sq_tail_).store(tail + 1,
+                                               std::memory_order_release);
+  }
+
+  static void scatter(const CoalescedRead& read,
+                      std::span<const ReadRange> ranges,
+                      std::span<char* const> buffers, const char* data) {
+    for (auto index : read.ranges) {
+      std::memcpy(buffers[index], data + (ranges[index].offset - read.offset),
+                  ranges[index].length);
+    }
+  }
+
+  template <typename Op>
+  static void release(const Op& op, std::vector<int>& free_buffers) {
+    if (op.buffer >= 0) {
+      free_buffers.push_back(op.buffer);
+    }
+  }
+
+  int fd_;
+  unsigned sq_entries_ = 0;
+  void* sq_ptr_ = nullptr;
+  void* cq_ptr_ = nullptr;
+  io_uring_sqe* sqes_ = nullptr;
+  std::size_t sq_bytes_ = 0;
+  std::size_t cq_bytes_ = 0;
+  std::size_t sqes_bytes_ = 0;
+  unsigned* sq_tail_ = nullptr;
+  unsigned sq_mask_ = 0;
+  unsigned* sq_array_ = nullptr;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+  std::vector<iovec> buffers_;
+  bool fixed_buffers_ = false;
+  bool broken_ = false;
+};
+
+// Rings shared by every file opened with the same ring shape, so kernel
+// resources and registered buffers grow with concurrent reads rather than
+// with open files. Pools live for the rest of the process.
+class IoUringPool final {
+ public:
+  static std::shared_ptr<IoUringPool> forOptions(
+      const IoUringOptions& options) {
+    using Shape =
+        std::tuple<unsigned, std::size_t, std::size_t, std::size_t>;
+    static std::mutex mutex;
+    static std::map<Shape, std::shared_ptr<IoUringPool>> pools;
+    const Shape shape{options.queue_depth, options.rings,
+                      options.registered_buffers,
+                      options.registered_buffer_bytes};
+    std::lock_guard lock(mutex);
+    auto& pool = pools[shape];
+    if (pool == nullptr) {
+      pool.reset(new IoUringPool(options));
+    }
+    return pool;
+  }
+
+  // An idle ring, a new one while fewer than `rings' exist, or else the
+  // next one released.
+  StatusOr<std::unique_ptr<IoUring>> acquire() {
+    {
+      std::unique_lock lock(mutex_);
+      available_.wait(lock, [this] {
+        return !idle_.empty() || created_ < options_.rings;
+      });
+      if (!idle_.empty()) {
+        auto ring = std::move(idle_.back());
+        idle_.pop_back();
+        return ring;
+      }
+      ++created_;
+    }
+    auto ring = IoUring::create(options_);
+    if (!ring.ok()) {
+      forget();
+    }
+    return ring;
+  }
+
+  void release(std::unique_ptr<IoUring> ring) {
+    if (ring->broken()) {
+      ring.reset();
+      forget();
+      return;
+    }
+    {
+      std::lock_guard lock(mutex_);
+      idle_.push_back(std::move(ring));
+    }
+    available_.notify_one();
+  }
+
+ private:
+  explicit IoUringPool(const IoUringOptions& options) : options_(options) {}
+
+  void forget() {
+    {
+      std::lock_guard lock(mutex_);
+      --created_;
+    }
+    available_.notify_one();
+  }
+
+  IoUringOptions options_;
+  std::mutex mutex_;
+  std::condition_variable available_;
+  std::vector<std::unique_ptr<IoUring>> idle_;
+  std::size_t created_ = 0;
+};
+
+#endif  // HALO_HAS_IO_URING
+
+// Local file read through io_uring. A preadv call coalesces nearby ranges
+// (column chunks of one row group typically sit back to back), then keeps the
+// whole batch in flight on one ring instead of issuing one blocking pread per
+// range. preadvAsync runs the batch on the IO executor, so the driver thread
+// only waits on the returned future; the executor thread blocks in
+// io_uring_enter until the batch completes.
+export class IoUringReadFile final : public ReadFile {
+ public:
+  // Returns NotImplemented when io_uring is not compiled in or the kernel
+  // refuses it (e.g. kernel.io_uring_disabled, seccomp).
+  static StatusOr<std::unique_ptr<ReadFile>> open(
+      const std::string& path, const IoUringOptions& options = {}) {
+#if HALO_HAS_IO_URING
+    if (options.queue_depth == 0 || options.rings == 0) {
+      return Status::Invalid("queue_depth and rings must be positive");
+    }
+    // Taking a ring up front reports a kernel without io_uring here rather
+    // than on the first read.
+    auto pool = IoUringPool::forOptions(options);
+    auto ring = pool->acquire();
+    if (!ring.ok()) {
+      return ring.status();
+    }
+    pool->release(std::move(ring).value());
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return errnoStatus("cannot open", path, errno);
+    }
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) {
+      const int error = errno;
+      ::close(fd);
+      return errnoStatus("cannot stat", path, error);
+    }
+    return std::unique_ptr<ReadFile>(
+        new IoUringReadFile(path, fd, static_cast<std::uint64_t>(st.st_size),
+                            options, std::move(pool)));
+#else
+    (void)path;
+    (void)options;
+    return Status::NotImplemented("io_uring is not available on this build");
+#endif
+  }
+
+  IoUringReadFile(const IoUringReadFile&) = delete;
+  IoUringReadFile& operator=(const IoUringReadFile&) = delete;
+  IoUringReadFile(IoUringReadFile&&) = delete;
+  IoUringReadFile& operator=(IoUringReadFile&&) = delete;
+  ~IoUringReadFile() override { ::close(fd_); }
+
+  [[nodiscard]] std::string_view name() const override { return path_; }
+  [[nodiscard]] std::uint64_t size() const override { return size_; }
+
+  Status pread(std::uint64_t offset, std::uint64_t length,
+               char* buffer) const override {
+    const ReadRange range{.offset = offset, .length = length};
+    char* const target = buffer;
+    return preadv(std::span(&range, 1), std::span(&target, 1));
+  }
+
+  Status preadv(std::span<const ReadRange> ranges,
+                std::span<char* const> buffers) const override {
+    if (ranges.size() != buffers.size()) {
+      return Status::Invalid("ranges and buffers differ in size");
+    }
+#if HALO_HAS_IO_URING
+    // Without bounce buffers every range is read in place.
+    const auto reads = coalesceRanges(
+        ranges, options_.coalesce_gap,
+        options_.registered_buffers == 0 ? 0
+                                         : options_.registered_buffer_bytes);
+    if (reads.empty()) {
+      return Status::OK();
+    }
+    auto ring = pool_->acquire();
+    if (!ring.ok()) {
+      return ring.status();
+    }
+    auto status = (*ring)->run(fd_, ranges, buffers, reads);
+    pool_->release(std::move(ring).value());
+    if (!status.ok()) {
+      return Status::StorageError(std::string(status.message()) + " in '" +
+                                  path_ + "'");
+    }
+    return status;
+#else
+    return ReadFile::preadv(ranges, buffers);
+#endif
+  }
+
+ private:
+#if HALO_HAS_IO_URING
+  IoUringReadFile(std::string path, int fd, std::uint64_t size,
+                  const IoUringOptions& options,
+                  std::shared_ptr<IoUringPool> pool)
+      : path_(std::move(path)),
+        fd_(fd),
+        size_(size),
+        options_(options),
+        pool_(std::move(pool)) {}
+
+  std::string path_;
+  int fd_;
+  std::uint64_t size_;
+  IoUringOptions options_;
+  std::shared_ptr<IoUringPool> pool_;
+#else
+  std::string path_;
+  int fd_ = -1;
+  std::uint64_t size_ = 0;
+#endif
+};
+
+// Opens a local file for scanning: io_uring when available, pread otherwise.
+export StatusOr<std::unique_ptr<ReadFile>> openLocalReadFile(
+    const std::string& path, const IoUringOptions& options = {}) {
+  auto file = IoUringReadFile::open(path, options);
+  if (file.ok() || file.status().code() !=
+                       Status::Code::kNotImplemented) {
+    return file;
+  }
+  return LocalReadFile::open(path);
+}
+
+}  // namespace halo::storage::file
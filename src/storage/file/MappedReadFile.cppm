@@ -0,0 +1,128 @@
+module;
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+export module halo.storage.file:MappedReadFile;
+import halo.common;
+import :ReadFile;
+
+namespace halo::storage::file {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+// Read-only mapping of a whole local file. Besides the copying ReadFile
+// interface it hands out views of the mapped pages, which stay valid for as
+// long as any shared_ptr to the file is alive. Zero-copy consumers hold such
+// a reference next to the view instead of copying the bytes out.
+export class MappedReadFile final : public ReadFile {
+ public:
+  static StatusOr<std::shared_ptr<MappedReadFile>> open(
+      const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return errnoStatus("cannot open", path, errno);
+    }
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) {
+      const int error = errno;
+      ::close(fd);
+      return errnoStatus("cannot stat", path, error);
+    }
+    const auto size = static_cast<std::uint64_t>(st.st_size);
+    void* data = nullptr;
+    if (size > 0) {
+      data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        const int error = errno;
+        ::close(fd);
+        return errnoStatus("cannot map", path, error);
+      }
+    }
+    // The mapping keeps the file referenced; the descriptor is not needed.
+    ::close(fd);
+    return std::shared_ptr<MappedReadFile>(
+        new MappedReadFile(path, static_cast<const char*>(data), size));
+  }
+
+  MappedReadFile(const MappedReadFile&) = delete;
+  MappedReadFile& operator=(const MappedReadFile&) = delete;
+  MappedReadFile(MappedReadFile&&) = delete;
+  MappedReadFile& operator=(MappedReadFile&&) = delete;
+  ~MappedReadFile() override {
+    if (data_ != nullptr) {
+      ::munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+  [[nodiscard]] std::string_view name() const override { return path_; }
+  [[nodiscard]] std::uint64_t size() const override { return size_; }
+
+  Status pread(std::uint64_t offset, std::uint64_t length,
+               char* buffer) const override {
+    auto region = view(offset, length);
+    if (!region.ok()) {
+      return region.status();
+    }
+    std::memcpy(buffer, region->data(), region->size());
+    return Status::OK();
+  }
+
+  // Mapped bytes of [offset, offset + length). Touching them may fault pages
+  // in from disk.
+  [[nodiscard]] StatusOr<std::span<const char>> view(
+      std::uint64_t offset, std::uint64_t length) const {
+    if (offset > size_ || length > size_ - offset) {
+      return Status::StorageError(
+          "range [" + std::to_string(offset) + ", " +
+          std::to_string(offset + length) + ") is outside '" + path_ +
+          "' of size " + std::to_string(size_));
+    }
+    return std::span<const char>(data_ + offset, length);
+  }
+
+  // Hints the kernel to read the range ahead, e.g. for the column chunks of
+  // the next row group while the current one is being processed.
+  void willNeed(std::uint64_t offset, std::uint64_t length) const {
+    advise(offset, length, MADV_WILLNEED);
+  }
+
+  // Drops the pages of a consumed range from the mapping so a long scan's
+  // resident set stays bounded. Views of the range stay valid; touching them
+  // again faults the pages back in.
+  void dontNeed(std::uint64_t offset, std::uint64_t length) const {
+    advise(offset, length, MADV_DONTNEED);
+  }
+
+ private:
+  MappedReadFile(std::string path, const char* data, std::uint64_t size)
+      : path_(std::move(path)), data_(data), size_(size) {}
+
+  void advise(std::uint64_t offset, std::uint64_t length, int advice) const {
+    if (data_ == nullptr || offset >= size_) {
+      return;
+    }
+    const auto page = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+    const std::uint64_t begin = offset & ~(page - 1);
+    const std::uint64_t end = std::min(size_, offset + length);
+    ::madvise(const_cast<char*>(data_ + begin), end - begin, advice);
+  }
+
+  std::string path_;
+  const char* data_;
+  std::uint64_t size_;
+};
+
+}  // namespace halo::storage::file
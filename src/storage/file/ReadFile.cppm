@@ -0,0 +1,192 @@
+module;
+#include <fcntl.h>
+#include <folly/Executor.h>
+#include <folly/futures/Future.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+export module halo.storage.file:ReadFile;
+import halo.common;
+
+namespace halo::storage::file {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+export struct ReadRange {
+  std::uint64_t offset = 0;
+  std::uint64_t length = 0;
+
+  [[nodiscard]] std::uint64_t end() const { return offset + length; }
+};
+
+// Several requested ranges served by one physical read. `ranges' indexes into
+// the caller's range list, in offset order.
+export struct CoalescedRead {
+  std::uint64_t offset = 0;
+  std::uint64_t length = 0;
+  std::vector<std::size_t> ranges;
+};
+
+// Merges ranges whose gap is at most `max_gap' bytes as long as the merged
+// read stays within `max_bytes'. A single range longer than `max_bytes' is
+// returned on its own.
+export std::vector<CoalescedRead> coalesceRanges(
+    std::span<const ReadRange> ranges, std::uint64_t max_gap,
+    std::uint64_t max_bytes) {
+  std::vector<std::size_t> order(ranges.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::ranges::sort(order, {},
+                    [&](std::size_t i) { return ranges[i].offset; });
+
+  std::vector<CoalescedRead> reads;
+  for (auto index : order) {
+    const auto& range = ranges[index];
+    if (range.length == 0) {
+      continue;
+    }
+    if (!reads.empty()) {
+      auto& last = reads.back();
+      const std::uint64_t last_end = last.offset + last.length;
+      const std::uint64_t merged_end = std::max(last_end, range.end());
+      if (range.offset <= last_end + max_gap &&
+          merged_end - last.offset <= max_bytes) {
+        last.length = merged_end - last.offset;
+        last.ranges.push_back(index);
+        continue;
+      }
+    }
+    reads.push_back(CoalescedRead{
+        .offset = range.offset, .length = range.length, .ranges = {index}});
+  }
+  return reads;
+}
+
+Status errnoStatus(std::string_view what, std::string_view path, int error) {
+  return Status::StorageError(std::string(what) + " '" + std::string(path) +
+                              "': " + std::strerror(error));
+}
+
+// Random-access file used by halo's scan path. Mirrors the shape of Velox's
+// ReadFile (pread plus a vectored read of many ranges) and adds an
+// asynchronous batch read whose completion runs on the IO executor, so driver
+// threads do not block on storage.
+export class ReadFile {
+ public:
+  ReadFile() = default;
+  ReadFile(const ReadFile&) = delete;
+  ReadFile& operator=(const ReadFile&) = delete;
+  ReadFile(ReadFile&&) = delete;
+  ReadFile& operator=(ReadFile&&) = delete;
+  virtual ~ReadFile() = default;
+
+  [[nodiscard]] virtual std::string_view name() const = 0;
+  [[nodiscard]] virtual std::uint64_t size() const = 0;
+
+  // Reads exactly `length' bytes at `offset' into `buffer'.
+  virtual Status pread(std::uint64_t offset, std::uint64_t length,
+                       char* buffer) const = 0;
+
+  // Reads every range into the buffer at the same position.
+  virtual Status preadv(std::span<const ReadRange> ranges,
+                        std::span<char* const> buffers) const {
+    if (ranges.size() != buffers.size()) {
+      return Status::Invalid("ranges and buffers differ in size");
+    }
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+      auto status = pread(ranges[i].offset, ranges[i].length, buffers[i]);
+      if (!status.ok()) {
+        return status;
+      }
+    }
+    return Status::OK();
+  }
+
+  // Runs preadv on `executor'. The caller keeps the buffers alive until the
+  // future completes.
+  virtual folly::SemiFuture<Status> preadvAsync(
+      std::vector<ReadRange> ranges, std::vector<char*> buffers,
+      folly::Executor* executor) const {
+    folly::Promise<Status> promise;
+    auto future = promise.getSemiFuture();
+    executor->add([this, ranges = std::move(ranges),
+                   buffers = std::move(buffers),
+                   promise = std::move(promise)]() mutable {
+      promise.setValue(preadv(ranges, buffers));
+    });
+    return future;
+  }
+};
+
+// Plain pread(2) implementation; the baseline the io_uring path is measured
+// against and the fallback where io_uring is unavailable.
+export class LocalReadFile final : public ReadFile {
+ public:
+  static StatusOr<std::unique_ptr<ReadFile>> open(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return errnoStatus("cannot open", path, errno);
+    }
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) {
+      const int error = errno;
+      ::close(fd);
+      return errnoStatus("cannot stat", path, error);
+    }
+    return std::unique_ptr<ReadFile>(
+        new LocalReadFile(path, fd, static_cast<std::uint64_t>(st.st_size)));
+  }
+
+  LocalReadFile(const LocalReadFile&) = delete;
+  LocalReadFile& operator=(const LocalReadFile&) = delete;
+  LocalReadFile(LocalReadFile&&) = delete;
+  LocalReadFile& operator=(LocalReadFile&&) = delete;
+  ~LocalReadFile() override { ::close(fd_); }
+
+  [[nodiscard]] std::string_view name() const override { return path_; }
+  [[nodiscard]] std::uint64_t size() const override { return size_; }
+
+  Status pread(std::uint64_t offset, std::uint64_t length,
+               char* buffer) const override {
+    while (length > 0) {
+      const auto n = ::pread(fd_, buffer, length, static_cast<off_t>(offset));
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return errnoStatus("pread failed on", path_, errno);
+      }
+      if (n == 0) {
+        return Status::StorageError("unexpected end of file in '" + path_ +
+                                    "' at offset " + std::to_string(offset));
+      }
+      buffer += n;
+      offset += static_cast<std::uint64_t>(n);
+      length -= static_cast<std::uint64_t>(n);
+    }
+    return Status::OK();
+  }
+
+ private:
+  LocalReadFile(std::string path, int fd, std::uint64_t size)
+      : path_(std::move(path)), fd_(fd), size_(size) {}
+
+  std::string path_;
+  int fd_;
+  std::uint64_t size_;
+};
+
+}  // namespace halo::storage::file
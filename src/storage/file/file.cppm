@@ -0,0 +1,4 @@
+export module halo.storage.file;
+export import :IoUringReadFile;
+export import :MappedReadFile;
+export import :ReadFile;
@@ -0,0 +1,156 @@
+module;
+#include <xxhash.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+export module halo.storage.format:BloomFilter;
+import halo.common;
+
+namespace halo::storage::format {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+// Split-block bloom filter as specified by the Parquet format
+// (BloomFilter.md). The bitset is laid out exactly as Parquet writers emit it
+// so a filter built here can be stored in, or loaded from, a column chunk's
+// bloom filter section. Values are hashed with XXH64 (seed 0) over their plain
+// encoding, matching what Parquet readers probe with.
+export class SplitBlockBloomFilter final {
+ public:
+  static constexpr std::size_t kBytesPerBlock = 32;
+  static constexpr std::size_t kWordsPerBlock = 8;
+  static constexpr std::size_t kMinimumBytes = kBytesPerBlock;
+  static constexpr std::size_t kMaximumBytes = 128 * 1024 * 1024;
+
+  // Number of bytes needed to hold `ndv' distinct values at the given false
+  // positive probability, rounded up to a power of two within the limits
+  // allowed by the format.
+  static std::size_t optimalNumBytes(std::uint64_t ndv, double fpp) {
+    if (ndv == 0 || fpp <= 0.0 || fpp >= 1.0) {
+      return kMinimumBytes;
+    }
+    const double bits = -8.0 * static_cast<double>(ndv) /
+                        std::log(1.0 - std::pow(fpp, 1.0 / 8.0));
+    auto bytes = static_cast<std::uint64_t>(std::ceil(bits / 8.0));
+    bytes = std::clamp<std::uint64_t>(bytes, kMinimumBytes, kMaximumBytes);
+    return static_cast<std::size_t>(std::bit_ceil(bytes));
+  }
+
+  static StatusOr<SplitBlockBloomFilter> create(std::size_t num_bytes) {
+    if (num_bytes < kMinimumBytes || num_bytes > kMaximumBytes ||
+        !std::has_single_bit(num_bytes)) {
+      return Status::Invalid("bloom filter size must be a power of two in [" +
+                             std::to_string(kMinimumBytes) + ", " +
+                             std::to_string(kMaximumBytes) + "], got " +
+                             std::to_string(num_bytes));
+    }
+    return SplitBlockBloomFilter(num_bytes);
+  }
+
+  // Rebuilds a filter from a serialized bitset (e.g. the bytes following the
+  // BloomFilterHeader of a Parquet column chunk).
+  static StatusOr<SplitBlockBloomFilter> fromBitset(
+      std::span<const std::uint8_t> bitset) {
+    auto filter = create(bitset.size());
+    if (!filter.ok()) {
+      return filter;
+    }
+    std::memcpy(filter->words_.data(), bitset.data(), bitset.size());
+    return filter;
+  }
+
+  // Plain-encoding hashes, as defined by the Parquet spec.
+  static std::uint64_t hash(std::int32_t value) {
+    return XXH64(&value, sizeof(value), 0);
+  }
+  static std::uint64_t hash(std::int64_t value) {
+    return XXH64(&value, sizeof(value), 0);
+  }
+  static std::uint64_t hash(float value) {
+    return XXH64(&value, sizeof(value), 0);
+  }
+  static std::uint64_t hash(double value) {
+    return XXH64(&value, sizeof(value), 0);
+  }
+  static std::uint64_t hash(std::string_view value) {
+    return XXH64(value.data(), value.size(), 0);
+  }
+
+  void insertHash(std::uint64_t hash) {
+    auto* block = blockFor(hash);
+    const auto key = static_cast<std::uint32_t>(hash);
+    for (std::size_t i = 0; i < kWordsPerBlock; ++i) {
+      block[i] |= maskBit(key, i);
+    }
+  }
+
+  [[nodiscard]] bool findHash(std::uint64_t hash) const {
+    const auto* block = blockFor(hash);
+    const auto key = static_cast<std::uint32_t>(hash);
+    for (std::size_t i = 0; i < kWordsPerBlock; ++i) {
+      if ((block[i] & maskBit(key, i)) == 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <typename T>
+  void insert(const T& value) {
+    insertHash(hash(value));
+  }
+
+  template <typename T>
+  [[nodiscard]] bool mightContain(const T& value) const {
+    return findHash(hash(value));
+  }
+
+  [[nodiscard]] std::size_t numBytes() const {
+    return words_.size() * sizeof(std::uint32_t);
+  }
+
+  [[nodiscard]] std::span<const std::uint8_t> bitset() const {
+    return {reinterpret_cast<const std::uint8_t*>(words_.data()), numBytes()};
+  }
+
+ private:
+  static constexpr std::array<std::uint32_t, kWordsPerBlock> kSalt = {
+      0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+      0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+  explicit SplitBlockBloomFilter(std::size_t num_bytes)
+      : words_(num_bytes / sizeof(std::uint32_t), 0) {}
+
+  static std::uint32_t maskBit(std::uint32_t key, std::size_t i) {
+    return std::uint32_t{1} << ((key * kSalt[i]) >> 27);
+  }
+
+  [[nodiscard]] std::size_t blockIndex(std::uint64_t hash) const {
+    const std::uint64_t num_blocks = words_.size() / kWordsPerBlock;
+    return static_cast<std::size_t>(((hash >> 32) * num_blocks) >> 32);
+  }
+
+  std::uint32_t* blockFor(std::uint64_t hash) {
+    return words_.data() + blockIndex(hash) * kWordsPerBlock;
+  }
+
+  [[nodiscard]] const std::uint32_t* blockFor(std::uint64_t hash) const {
+    return words_.data() + blockIndex(hash) * kWordsPerBlock;
+  }
+
+  std::vector<std::uint32_t> words_;
+};
+
+}  // namespace halo::storage::format
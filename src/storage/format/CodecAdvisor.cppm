@@ -0,0 +1,467 @@
+module;
+#include <bzlib.h>
+#include <lz4.h>
+#include <lz4hc.h>
+#include <lzma.h>
+#include <snappy.h>
+#include <zlib.h>
+#include <zstd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+export module halo.storage.format:CodecAdvisor;
+import halo.common;
+
+namespace halo::storage::format {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+export enum class Codec : std::uint8_t {
+  kNone,
+  kZstd,
+  kLz4,
+  kLz4Hc,
+  kSnappy,
+  kZlib,
+  kXz,
+  kBzip2,
+};
+
+// Lower-case names, spelled as Velox's common::compressionKindToString
+// spells the codecs it also knows.
+export constexpr std::string_view codecName(Codec codec) {
+  switch (codec) {
+    case Codec::kNone:
+      return "none";
+    case Codec::kZstd:
+      return "zstd";
+    case Codec::kLz4:
+      return "lz4";
+    case Codec::kLz4Hc:
+      return "lz4hc";
+    case Codec::kSnappy:
+      return "snappy";
+    case Codec::kZlib:
+      return "zlib";
+    case Codec::kXz:
+      return "xz";
+    case Codec::kBzip2:
+      return "bzip2";
+  }
+  return "unknown";
+}
+
+// Where the compressed bytes end up. ParquetWriter writes only the codecs
+// both the Parquet spec and Velox's reader know the same way: none, snappy,
+// zstd and lz4 (as LZ4_RAW). Halo-owned files take any codec.
+export enum class CodecTarget : std::uint8_t {
+  kParquet,
+  kHaloFile,
+};
+
+export struct CodecCandidate {
+  Codec codec = Codec::kNone;
+  int level = 0;
+
+  bool operator==(const CodecCandidate&) const = default;
+};
+
+export struct CodecAdvisorOptions {
+  // Minimum single-core decompression throughput, in uncompressed bytes per
+  // second, a choice must sustain.
+  double min_decode_bytes_per_sec = 1.5e9;
+  // Bytes of each column chunk that are benchmarked.
+  std::size_t sample_bytes = 1 << 20;
+  // Decompression is repeated until at least this much time has been measured
+  // to keep the throughput estimate stable.
+  std::chrono::microseconds min_measure_time{2000};
+  // Empty means the default candidate set for the target.
+  std::vector<CodecCandidate> candidates;
+};
+
+export struct CodecMeasurement {
+  CodecCandidate candidate;
+  std::size_t input_bytes = 0;
+  std::size_t compressed_bytes = 0;
+  double encode_bytes_per_sec = 0.0;
+  double decode_bytes_per_sec = 0.0;
+
+  [[nodiscard]] double ratio() const {
+    return compressed_bytes == 0 ? 0.0
+                                 : static_cast<double>(input_bytes) /
+                                       static_cast<double>(compressed_bytes);
+  }
+};
+
+export struct CodecChoice {
+  CodecCandidate choice;
+  bool within_budget = true;
+  std::vector<CodecMeasurement> measurements;
+};
+
+// Whether `size' fits the `int' and `unsigned int' lengths of the LZ4 and
+// bzip2 APIs.
+template <typename Length>
+bool fitsLength(std::size_t size) {
+  return size <= static_cast<std::size_t>(std::numeric_limits<Length>::max());
+}
+
+// One-shot compression helpers shared by the advisor and its callers.
+export StatusOr<std::string> compressBuffer(CodecCandidate candidate,
+                                            std::span<const char> input) {
+  std::string out;
+  switch (candidate.codec) {
+    case Codec::kNone:
+      out.assign(input.begin(), input.end());
+      return out;
+    case Codec::kZstd: {
+      out.resize(ZSTD_compressBound(input.size()));
+      const auto size = ZSTD_compress(out.data(), out.size(), input.data(),
+                                      input.size(), candidate.level);
+      if (ZSTD_isError(size) != 0U) {
+        return Status::StorageError(std::string("zstd: ") +
+                                    ZSTD_getErrorName(size));
+      }
+      out.resize(size);
+      return out;
+    }
+    case Codec::kLz4:
+    case Codec::kLz4Hc: {
+      if (input.size() > LZ4_MAX_INPUT_SIZE) {
+        return Status::Invalid("lz4 input of " + std::to_string(input.size()) +
+                               " bytes is too large");
+      }
+      const auto src_size = static_cast<int>(input.size());
+      out.resize(static_cast<std::size_t>(LZ4_compressBound(src_size)));
+      const int size =
+          candidate.codec == Codec::kLz4
+              ? LZ4_compress_default(input.data(), out.data(), src_size,
+                                     static_cast<int>(out.size()))
+              : LZ4_compress_HC(input.data(), out.data(), src_size,
+                                static_cast<int>(out.size()), candidate.level);
+      if (size <= 0) {
+        return Status::StorageError("lz4 compression failed");
+      }
+      out.resize(static_cast<std::size_t>(size));
+      return out;
+    }
+    case Codec::kSnappy:
+      snappy::Compress(input.data(), input.size(), &out);
+      return out;
+    case Codec::kZlib: {
+      auto size = compressBound(input.size());
+      out.resize(size);
+      const int rc =
+          compress2(reinterpret_cast<Bytef*>(out.data()), &size,
+                    reinterpret_cast<const Bytef*>(input.data()),
+                    input.size(), candidate.level);
+      if (rc != Z_OK) {
+        return Status::StorageError("zlib compression failed: " +
+                                    std::to_string(rc));
+      }
+      out.resize(size);
+      return out;
+    }
+    case Codec::kXz: {
+      out.resize(lzma_stream_buffer_bound(input.size()));
+      std::size_t pos = 0;
+      const auto rc = lzma_easy_buffer_encode(
+          static_cast<std::uint32_t>(candidate.level), LZMA_CHECK_NONE,
+          nullptr, reinterpret_cast<const std::uint8_t*>(input.data()),
+          input.size(), reinterpret_cast<std::uint8_t*>(out.data()), &pos,
+          out.size());
+      if (rc != LZMA_OK) {
+        return Status::StorageError("xz compression failed: " +
+                                    std::to_string(rc));
+      }
+      out.resize(pos);
+      return out;
+    }
+    case Codec::kBzip2: {
+      // Worst case documented by bzip2: 1% larger plus 600 bytes.
+      const auto bound = input.size() + input.size() / 100 + 600;
+      if (!fitsLength<unsigned int>(bound)) {
+        return Status::Invalid("bzip2 input of " +
+                               std::to_string(input.size()) +
+                               " bytes is too large");
+      }
+      auto size = static_cast<unsigned int>(bound);
+      out.resize(size);
+      const int rc = BZ2_bzBuffToBuffCompress(
+          out.data(), &size, const_cast<char*>(input.data()),
+          static_cast<unsigned int>(input.size()), candidate.level, 0, 0);
+      if (rc != BZ_OK) {
+        return Status::StorageError("bzip2 compression failed: " +
+                                    std::to_string(rc));
+      }
+      out.resize(size);
+      return out;
+    }
+  }
+  return Status::NotImplemented("unknown codec");
+}
+
+// Decompresses `input' into `output', whose size must be the exact
+// uncompressed size. Never writes past `output', whatever `input' holds.
+export Status decompressBuffer(CodecCandidate candidate,
+                               std::span<const char> input,
+                               std::span<char> output) {
+  bool ok = false;
+  switch (candidate.codec) {
+    case Codec::kNone:
+      ok = input.size() == output.size();
+      if (ok) {
+        std::memcpy(output.data(), input.data(), input.size());
+      }
+      break;
+    case Codec::kZstd: {
+      const auto size = ZSTD_decompress(output.data(), output.size(),
+                                        input.data(), input.size());
+      ok = ZSTD_isError(size) == 0U && size == output.size();
+      break;
+    }
+    case Codec::kLz4:
+    case Codec::kLz4Hc:
+      ok = fitsLength<int>(input.size()) && fitsLength<int>(output.size()) &&
+           LZ4_decompress_safe(input.data(), output.data(),
+                               static_cast<int>(input.size()),
+                               static_cast<int>(output.size())) ==
+               static_cast<int>(output.size());
+      break;
+    case Codec::kSnappy: {
+      // RawUncompress writes as many bytes as the block's header claims.
+      std::size_t size = 0;
+      ok = snappy::GetUncompressedLength(input.data(), input.size(), &size) &&
+           size == output.size() &&
+           snappy::RawUncompress(input.data(), input.size(), output.data());
+      break;
+    }
+    case Codec::kZlib: {
+      uLongf size = output.size();
+      ok = uncompress(reinterpret_cast<Bytef*>(output.data()), &size,
+                      reinterpret_cast<const Bytef*>(input.data()),
+                      input.size()) == Z_OK &&
+           size == output.size();
+      break;
+    }
+    case Codec::kXz: {
+      std::uint64_t memlimit = UINT64_MAX;
+      std::size_t in_pos = 0;
+      std::size_t out_pos = 0;
+      ok = lzma_stream_buffer_decode(
+               &memlimit, 0, nullptr,
+               reinterpret_cast<const std::uint8_t*>(input.data()), &in_pos,
+               input.size(), reinterpret_cast<std::uint8_t*>(output.data()),
+               &out_pos, output.size()) == LZMA_OK &&
+           out_pos == output.size();
+      break;
+    }
+    case Codec::kBzip2: {
+      if (!fitsLength<unsigned int>(input.size()) ||
+          !fitsLength<unsigned int>(output.size())) {
+        break;
+      }
+      auto size = static_cast<unsigned int>(output.size());
+      ok = BZ2_bzBuffToBuffDecompress(output.data(), &size,
+                                      const_cast<char*>(input.data()),
+                                      static_cast<unsigned int>(input.size()),
+                                      0, 0) == BZ_OK &&
+           size == output.size();
+      break;
+    }
+  }
+  if (!ok) {
+    return Status::StorageError(std::string(codecName(candidate.codec)) +
+                                " decompression failed");
+  }
+  return Status::OK();
+}
+
+// Every candidate is trial-compressed on every chunk, so the defaults leave
+// out encoders that run at a few MB/s (zstd 19, xz, bzip2); callers writing
+// files that are read far more often than written list them in
+// `CodecAdvisorOptions::candidates'.
+export std::vector<CodecCandidate> defaultCandidates(CodecTarget target) {
+  std::vector<CodecCandidate> candidates = {
+      {Codec::kNone, 0}, {Codec::kLz4, 0},  {Codec::kSnappy, 0},
+      {Codec::kZstd, 1}, {Codec::kZstd, 3}, {Codec::kZstd, 9},
+  };
+  if (target == CodecTarget::kHaloFile) {
+    candidates.insert(candidates.end(), {{Codec::kZlib, 1},
+                                         {Codec::kZlib, 6},
+                                         {Codec::kLz4Hc, 9}});
+  }
+  return candidates;
+}
+
+bool supportedBy(CodecTarget target, Codec codec) {
+  if (target == CodecTarget::kHaloFile) {
+    return true;
+  }
+  return codec == Codec::kNone || codec == Codec::kLz4 ||
+         codec == Codec::kSnappy || codec == Codec::kZstd;
+}
+
+// Benchmarks candidate codecs on a sample of each column chunk and picks the
+// best compression ratio whose single-core decode throughput stays within
+// the configured budget. ParquetWriter runs one per chunk when asked to;
+// see `ParquetWriterOptions::codec_advice'.
+export class CodecAdvisor final {
+ public:
+  static StatusOr<CodecAdvisor> create(CodecTarget target,
+                                       CodecAdvisorOptions options) {
+    if (options.sample_bytes == 0) {
+      return Status::Invalid("sample_bytes must be positive");
+    }
+    if (options.candidates.empty()) {
+      options.candidates = defaultCandidates(target);
+    }
+    for (const auto& candidate : options.candidates) {
+      if (!supportedBy(target, candidate.codec)) {
+        return Status::Invalid(std::string(codecName(candidate.codec)) +
+                               " is not readable by the target format");
+      }
+    }
+    return CodecAdvisor(target, std::move(options));
+  }
+
+  [[nodiscard]] CodecTarget target() const { return target_; }
+
+  StatusOr<CodecChoice> advise(std::span<const char> data) const {
+    const auto sample =
+        data.first(std::min(data.size(), options_.sample_bytes));
+    CodecChoice result;
+    for (const auto& candidate : options_.candidates) {
+      auto measurement = measure(candidate, sample);
+      if (!measurement.ok()) {
+        return measurement.status();
+      }
+      result.measurements.push_back(std::move(measurement).value());
+    }
+
+    const CodecMeasurement* best = nullptr;
+    const CodecMeasurement* fastest = nullptr;
+    for (const auto& m : result.measurements) {
+      if (fastest == nullptr ||
+          m.decode_bytes_per_sec > fastest->decode_bytes_per_sec) {
+        fastest = &m;
+      }
+      if (m.decode_bytes_per_sec < options_.min_decode_bytes_per_sec) {
+        continue;
+      }
+      if (best == nullptr || m.ratio() > best->ratio()) {
+        best = &m;
+      }
+    }
+    if (best == nullptr) {
+      result.within_budget = false;
+      best = fastest;
+    }
+    if (best != nullptr) {
+      result.choice = best->candidate;
+    }
+    return result;
+  }
+
+  // Advises every column independently; `columns' maps a column name to a
+  // sample of its serialized chunk.
+  StatusOr<std::map<std::string, CodecChoice>> adviseColumns(
+      const std::map<std::string, std::span<const char>>& columns) const {
+    std::map<std::string, CodecChoice> choices;
+    for (const auto& [column, data] : columns) {
+      auto choice = advise(data);
+      if (!choice.ok()) {
+        return choice.status();
+      }
+      choices.emplace(column, std::move(choice).value());
+    }
+    return choices;
+  }
+
+ private:
+  CodecAdvisor(CodecTarget target, CodecAdvisorOptions options)
+      : target_(target), options_(std::move(options)) {}
+
+  StatusOr<CodecMeasurement> measure(CodecCandidate candidate,
+                                     std::span<const char> sample) const {
+    using Clock = std::chrono::steady_clock;
+    CodecMeasurement m{.candidate = candidate, .input_bytes = sample.size()};
+    if (sample.empty()) {
+      return m;
+    }
+
+    const auto encode_start = Clock::now();
+    auto compressed = compressBuffer(candidate, sample);
+    const auto encode_time = Clock::now() - encode_start;
+    if (!compressed.ok()) {
+      return compressed.status();
+    }
+    m.compressed_bytes = compressed->size();
+    m.encode_bytes_per_sec = bytesPerSec(sample.size(), encode_time);
+
+    std::vector<char> output(sample.size());
+    std::size_t iterations = 0;
+    const auto decode_start = Clock::now();
+    Clock::duration decode_time{};
+    do {
+      auto status = decompressBuffer(candidate, *compressed, output);
+      if (!status.ok()) {
+        return status;
+      }
+      ++iterations;
+      decode_time = Clock::now() - decode_start;
+    } while (decode_time < options_.min_measure_time);
+    m.decode_bytes_per_sec =
+        bytesPerSec(sample.size() * iterations, decode_time);
+    return m;
+  }
+
+  static double bytesPerSec(std::size_t bytes,
+                            std::chrono::steady_clock::duration elapsed) {
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    return seconds <= 0.0 ? 0.0 : static_cast<double>(bytes) / seconds;
+  }
+
+  CodecTarget target_;
+  CodecAdvisorOptions options_;
+};
+
+// Human-readable summary of the per-column decisions.
+export std::string codecReport(
+    const std::map<std::string, CodecChoice>& choices) {
+  std::ostringstream out;
+  out << std::left << std::setw(24) << "column" << std::setw(12) << "codec"
+      << std::right << std::setw(8) << "level" << std::setw(10) << "ratio"
+      << std::setw(14) << "decode_MB/s" << std::setw(8) << "budget" << '\n';
+  for (const auto& [column, choice] : choices) {
+    const auto it = std::ranges::find(choice.measurements, choice.choice,
+                                      &CodecMeasurement::candidate);
+    const double ratio = it == choice.measurements.end() ? 0.0 : it->ratio();
+    const double decode =
+        it == choice.measurements.end() ? 0.0 : it->decode_bytes_per_sec;
+    out << std::left << std::setw(24) << column << std::setw(12)
+        << codecName(choice.choice.codec) << std::right << std::setw(8)
+        << choice.choice.level << std::setw(10) << std::fixed
+        << std::setprecision(2) << ratio << std::setw(14)
+        << std::setprecision(0) << decode / 1e6 << std::setw(8)
+        << (choice.within_budget ? "ok" : "miss") << '\n';
+  }
+  return out.str();
+}
+
+}  // namespace halo::storage::format
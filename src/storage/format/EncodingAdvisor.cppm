@@ -0,0 +1,492 @@
+module;
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+export module halo.storage.format:EncodingAdvisor;
+import halo.common;
+
+namespace halo::storage::format {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+// Parquet value encodings the advisor chooses between.
+export enum class Encoding : std::uint8_t {
+  kPlain,
+  kRleDictionary,
+  kDeltaBinaryPacked,
+  kDeltaLengthByteArray,
+  kDeltaByteArray,
+  kByteStreamSplit,
+};
+
+export constexpr std::string_view encodingName(Encoding encoding) {
+  switch (encoding) {
+    case Encoding::kPlain:
+      return "PLAIN";
+    case Encoding::kRleDictionary:
+      return "RLE_DICTIONARY";
+    case Encoding::kDeltaBinaryPacked:
+      return "DELTA_BINARY_PACKED";
+    case Encoding::kDeltaLengthByteArray:
+      return "DELTA_LENGTH_BYTE_ARRAY";
+    case Encoding::kDeltaByteArray:
+      return "DELTA_BYTE_ARRAY";
+    case Encoding::kByteStreamSplit:
+      return "BYTE_STREAM_SPLIT";
+  }
+  return "UNKNOWN";
+}
+
+export enum class EncodingSelectionMode : std::uint8_t {
+  // Leave the writer's static choice (dictionary with plain fallback).
+  kDefault,
+  // Sample each column chunk and pick the cheapest encoding.
+  kSampled,
+};
+
+export struct EncodingAdvisorOptions {
+  EncodingSelectionMode mode = EncodingSelectionMode::kSampled;
+  // Values inspected per chunk, taken as `sample_runs' contiguous runs spread
+  // evenly over the chunk so delta encodings see real neighbours.
+  std::size_t sample_size = 8192;
+  std::size_t sample_runs = 8;
+  // Weight of decode cost relative to size when scoring; 0 optimizes purely
+  // for size.
+  double decode_weight = 0.25;
+  // Dictionaries larger than this fall back in the writer, so they are not
+  // considered.
+  std::size_t max_dictionary_bytes = 1024 * 1024;
+  // Size every candidate as it leaves page compression: value bytes (plain
+  // values, the dictionary page, string data, byte streams) at their order-0
+  // byte entropy, bit-packed indices and deltas as they are, since a codec
+  // gains little on them. Without compression byte-stream-split never wins.
+  bool assume_compression = true;
+};
+
+// Estimate for one candidate encoding, scaled to the whole chunk.
+export struct EncodingEstimate {
+  Encoding encoding = Encoding::kPlain;
+  std::uint64_t estimated_bytes = 0;
+  // Relative decode cost per value, plain == 1.0.
+  double decode_cost = 1.0;
+  double score = 0.0;
+};
+
+export struct EncodingChoice {
+  Encoding encoding = Encoding::kPlain;
+  std::uint64_t plain_bytes = 0;
+  std::uint64_t estimated_bytes = 0;
+  std::size_t sampled_values = 0;
+  std::vector<EncodingEstimate> candidates;
+
+  // Key/value pair ParquetWriter records in the column chunk's key/value
+  // metadata, so readers and tooling can see why an encoding was picked.
+  [[nodiscard]] std::pair<std::string, std::string> toMetadata(
+      std::string_view column) const {
+    std::string value(encodingName(encoding));
+    value += ";estimated_bytes=" + std::to_string(estimated_bytes);
+    value += ";plain_bytes=" + std::to_string(plain_bytes);
+    value += ";sampled=" + std::to_string(sampled_values);
+    return {"halo.encoding." + std::string(column), std::move(value)};
+  }
+};
+
+export template <typename T>
+concept EncodableValue =
+    std::same_as<T, std::int32_t> || std::same_as<T, std::int64_t> ||
+    std::same_as<T, float> || std::same_as<T, double> ||
+    std::same_as<T, std::string_view>;
+
+// Per-value decode cost: one plus the decode time an encoding adds over
+// PLAIN, in units of a PLAIN scan (page decompression plus decoding) of the
+// same column. Size is scored separately, so this is only the decoder's
+// work. Measured with benchmark_encoding_advisor over zstd pages on x86-64,
+// taking the median over its columns, which spread widely:
+// DELTA_BINARY_PACKED costs 1.2 on sorted ids but 3 on random ones, whose
+// PLAIN pages decompress almost for free, and the byte array encodings cost
+// more the shorter the strings. `decode_weight' sets how much they count.
+constexpr double decodeCost(Encoding encoding) {
+  switch (encoding) {
+    case Encoding::kPlain:
+      return 1.0;
+    case Encoding::kByteStreamSplit:
+      return 1.4;
+    case Encoding::kRleDictionary:
+      return 1.15;
+    case Encoding::kDeltaBinaryPacked:
+      return 1.5;
+    case Encoding::kDeltaLengthByteArray:
+      return 1.05;
+    case Encoding::kDeltaByteArray:
+      return 1.8;
+  }
+  return 1.0;
+}
+
+std::uint64_t zigzag(std::int64_t value) {
+  return (static_cast<std::uint64_t>(value) << 1) ^
+         static_cast<std::uint64_t>(value >> 63);
+}
+
+std::size_t varintBytes(std::uint64_t value) {
+  return std::max<std::size_t>(1, (std::bit_width(value) + 6) / 7);
+}
+
+// Exact DELTA_BINARY_PACKED size for `values': blocks of 128 values split into
+// four miniblocks of 32, each bit-packed at its own width.
+std::uint64_t deltaBinaryPackedBytes(std::span<const std::int64_t> values) {
+  constexpr std::size_t kBlock = 128;
+  constexpr std::size_t kMiniblock = 32;
+  if (values.empty()) {
+    return 0;
+  }
+  std::uint64_t bytes = varintBytes(kBlock) + 1 + varintBytes(values.size()) +
+                        varintBytes(zigzag(values[0]));
+  for (std::size_t start = 1; start < values.size(); start += kBlock) {
+    const std::size_t end = std::min(values.size(), start + kBlock);
+    std::int64_t min_delta = INT64_MAX;
+    for (std::size_t i = start; i < end; ++i) {
+      min_delta = std::min(
+          min_delta, static_cast<std::int64_t>(
+                         static_cast<std::uint64_t>(values[i]) -
+                         static_cast<std::uint64_t>(values[i - 1])));
+    }
+    bytes += varintBytes(zigzag(min_delta)) + kBlock / kMiniblock;
+    for (std::size_t mb = start; mb < end; mb += kMiniblock) {
+      std::uint64_t max_offset = 0;
+      for (std::size_t i = mb; i < std::min(end, mb + kMiniblock); ++i) {
+        const auto delta = static_cast<std::uint64_t>(values[i]) -
+                           static_cast<std::uint64_t>(values[i - 1]);
+        max_offset = std::max(max_offset,
+                              delta - static_cast<std::uint64_t>(min_delta));
+      }
+      bytes += kMiniblock * std::bit_width(max_offset) / 8;
+    }
+  }
+  return bytes;
+}
+
+// Order-0 entropy (bits per byte) of the bytes selected by `stride'/`offset'.
+double byteEntropy(std::span<const std::uint8_t> bytes, std::size_t stride,
+                   std::size_t offset) {
+  std::array<std::uint64_t, 256> counts{};
+  std::uint64_t total = 0;
+  for (std::size_t i = offset; i < bytes.size(); i += stride) {
+    ++counts[bytes[i]];
+    ++total;
+  }
+  if (total == 0) {
+    return 0.0;
+  }
+  double entropy = 0.0;
+  for (auto count : counts) {
+    if (count != 0) {
+      const double p = static_cast<double>(count) / static_cast<double>(total);
+      entropy -= p * std::log2(p);
+    }
+  }
+  return entropy;
+}
+
+// Distinct count estimate for the whole chunk from a sample of `r' rows with
+// `d' distinct values, `f1' of them seen once: d + f1 * (n/r - 1) * f1/r.
+// Singletons are extrapolated in proportion to how unique the sample looks,
+// so an all-unique sample scales to n while a repetitive one stays near d.
+double estimateDistinct(std::size_t rows, std::size_t sample_rows,
+                        std::size_t distinct, std::size_t singletons) {
+  if (sample_rows == 0) {
+    return 0.0;
+  }
+  const double r = static_cast<double>(sample_rows);
+  const double f1 = static_cast<double>(singletons);
+  const double unseen = f1 * (static_cast<double>(rows) / r - 1.0) * (f1 / r);
+  return std::min(static_cast<double>(rows),
+                  static_cast<double>(distinct) + unseen);
+}
+
+// Values sampled from a chunk together with the offset at which each
+// contiguous run starts, so delta estimates never span two runs.
+template <typename T>
+struct ChunkSample {
+  std::vector<T> values;
+  std::vector<std::size_t> run_starts;
+};
+
+// Chooses a Parquet encoding per column chunk from a sample of its values.
+export class EncodingAdvisor final {
+ public:
+  static StatusOr<EncodingAdvisor> create(EncodingAdvisorOptions options) {
+    if (options.sample_size == 0 || options.sample_runs == 0 ||
+        options.sample_runs > options.sample_size) {
+      return Status::Invalid(
+          "sample_size and sample_runs must be positive with sample_runs <= "
+          "sample_size");
+    }
+    if (options.decode_weight < 0.0) {
+      return Status::Invalid("decode_weight must not be negative");
+    }
+    return EncodingAdvisor(options);
+  }
+
+  [[nodiscard]] const EncodingAdvisorOptions& options() const {
+    return options_;
+  }
+
+  template <EncodableValue T>
+  [[nodiscard]] EncodingChoice choose(std::span<const T> values) const {
+    EncodingChoice choice;
+    const auto chunk_sample = takeSample(values);
+    const auto& sample = chunk_sample.values;
+    const auto& runs = chunk_sample.run_starts;
+    choice.sampled_values = sample.size();
+    const double scale =
+        sample.empty() ? 0.0
+                       : static_cast<double>(values.size()) /
+                             static_cast<double>(sample.size());
+
+    const auto plain_sample = plainEncoded<T>(sample);
+    choice.plain_bytes = static_cast<std::uint64_t>(
+        std::llround(static_cast<double>(plain_sample.size()) * scale));
+    if (sample.empty()) {
+      choice.encoding = Encoding::kPlain;
+      return choice;
+    }
+    const double plain = sized(plain_sample) * scale;
+    const double dict = dictionaryBytes<T>(sample, values.size());
+    if (options_.mode == EncodingSelectionMode::kDefault) {
+      // The writer's own policy: dictionary unless it overflows.
+      choice.encoding =
+          dict > 0.0 ? Encoding::kRleDictionary : Encoding::kPlain;
+      choice.estimated_bytes =
+          static_cast<std::uint64_t>(std::llround(dict > 0.0 ? dict : plain));
+      return choice;
+    }
+
+    auto add = [&](Encoding encoding, double bytes) {
+      EncodingEstimate estimate{
+          .encoding = encoding,
+          .estimated_bytes = static_cast<std::uint64_t>(std::llround(bytes)),
+          .decode_cost = decodeCost(encoding)};
+      const double size_ratio =
+          choice.plain_bytes == 0
+              ? 1.0
+              : bytes / static_cast<double>(choice.plain_bytes);
+      estimate.score = size_ratio + options_.decode_weight *
+                                        (estimate.decode_cost - 1.0);
+      choice.candidates.push_back(estimate);
+    };
+
+    add(Encoding::kPlain, plain);
+    if (dict > 0.0) {
+      add(Encoding::kRleDictionary, dict);
+    }
+    if constexpr (std::is_integral_v<T>) {
+      std::vector<std::int64_t> widened(sample.begin(), sample.end());
+      add(Encoding::kDeltaBinaryPacked,
+          static_cast<double>(runwiseDelta(widened, runs)) * scale);
+    } else if constexpr (std::is_floating_point_v<T>) {
+      add(Encoding::kByteStreamSplit, byteStreamSplit<T>(sample) * scale);
+    } else {
+      add(Encoding::kDeltaLengthByteArray,
+          deltaLengthBytes(sample, runs) * scale);
+      add(Encoding::kDeltaByteArray, deltaByteArrayBytes(sample, runs) * scale);
+    }
+
+    const auto best = std::ranges::min_element(
+        choice.candidates, {}, &EncodingEstimate::score);
+    choice.encoding = best->encoding;
+    choice.estimated_bytes = best->estimated_bytes;
+    return choice;
+  }
+
+ private:
+  explicit EncodingAdvisor(EncodingAdvisorOptions options)
+      : options_(options) {}
+
+  // Contiguous runs spread evenly over the chunk.
+  template <typename T>
+  [[nodiscard]] ChunkSample<T> takeSample(std::span<const T> values) const {
+    ChunkSample<T> sample;
+    if (values.size() <= options_.sample_size) {
+      sample.values.assign(values.begin(), values.end());
+      sample.run_starts.push_back(0);
+      return sample;
+    }
+    const std::size_t run_length = options_.sample_size / options_.sample_runs;
+    const std::size_t stride = values.size() / options_.sample_runs;
+    sample.values.reserve(run_length * options_.sample_runs);
+    for (std::size_t run = 0; run < options_.sample_runs; ++run) {
+      sample.run_starts.push_back(sample.values.size());
+      const auto first =
+          values.begin() + static_cast<std::ptrdiff_t>(run * stride);
+      sample.values.insert(sample.values.end(), first,
+                           first + static_cast<std::ptrdiff_t>(run_length));
+    }
+    return sample;
+  }
+
+  // The PLAIN encoding of `sample': values as they are, strings behind a
+  // 4-byte length.
+  template <typename T>
+  static std::vector<std::uint8_t> plainEncoded(const std::vector<T>& sample) {
+    std::vector<std::uint8_t> bytes;
+    if constexpr (std::is_same_v<T, std::string_view>) {
+      for (auto value : sample) {
+        appendPlain(bytes, value);
+      }
+    } else {
+      bytes.resize(sample.size() * sizeof(T));
+      std::memcpy(bytes.data(), sample.data(), bytes.size());
+    }
+    return bytes;
+  }
+
+  template <typename T>
+  static void appendPlain(std::vector<std::uint8_t>& bytes, const T& value) {
+    if constexpr (std::is_same_v<T, std::string_view>) {
+      const auto size = static_cast<std::uint32_t>(value.size());
+      const auto* length = reinterpret_cast<const std::uint8_t*>(&size);
+      bytes.insert(bytes.end(), length, length + sizeof(size));
+      bytes.insert(bytes.end(), value.begin(), value.end());
+    } else {
+      const auto* raw = reinterpret_cast<const std::uint8_t*>(&value);
+      bytes.insert(bytes.end(), raw, raw + sizeof(T));
+    }
+  }
+
+  // Size of value bytes after page compression, or raw without it.
+  [[nodiscard]] double sized(std::span<const std::uint8_t> bytes) const {
+    if (!options_.assume_compression) {
+      return static_cast<double>(bytes.size());
+    }
+    return static_cast<double>(bytes.size()) * byteEntropy(bytes, 1, 0) / 8.0;
+  }
+
+  template <typename T>
+  [[nodiscard]] double byteStreamSplit(const std::vector<T>& sample) const {
+    const std::span<const std::uint8_t> bytes(
+        reinterpret_cast<const std::uint8_t*>(sample.data()),
+        sample.size() * sizeof(T));
+    if (!options_.assume_compression) {
+      return static_cast<double>(bytes.size());
+    }
+    double bits = 0.0;
+    for (std::size_t stream = 0; stream < sizeof(T); ++stream) {
+      bits += byteEntropy(bytes, sizeof(T), stream) *
+              static_cast<double>(sample.size());
+    }
+    return bits / 8.0;
+  }
+
+  // Returns 0 when the dictionary would exceed the writer's limit.
+  template <typename T>
+  [[nodiscard]] double dictionaryBytes(const std::vector<T>& sample,
+                                       std::size_t rows) const {
+    std::unordered_map<T, std::size_t> counts;
+    std::vector<std::uint8_t> page;
+    std::size_t runs = 0;
+    for (std::size_t i = 0; i < sample.size(); ++i) {
+      if (++counts[sample[i]] == 1) {
+        appendPlain(page, sample[i]);
+      }
+      if (i == 0 || !(sample[i] == sample[i - 1])) {
+        ++runs;
+      }
+    }
+    std::size_t singletons = 0;
+    for (const auto& [value, count] : counts) {
+      singletons += count == 1 ? 1 : 0;
+    }
+    const double ndv = std::max(
+        1.0, estimateDistinct(rows, sample.size(), counts.size(), singletons));
+    // The writer's limit applies to the uncompressed dictionary page.
+    const double per_value = 1.0 / static_cast<double>(counts.size());
+    if (ndv * static_cast<double>(page.size()) * per_value >
+        static_cast<double>(options_.max_dictionary_bytes)) {
+      return 0.0;
+    }
+    const double dictionary = ndv * sized(page) * per_value;
+    // RLE/bit-packed hybrid indices: long runs collapse to a few bytes each,
+    // otherwise every index costs its bit width.
+    const double bit_width = std::max(1.0, std::ceil(std::log2(ndv + 1.0)));
+    const double packed = static_cast<double>(rows) * bit_width / 8.0;
+    const double rle = static_cast<double>(runs) *
+                       static_cast<double>(rows) /
+                       static_cast<double>(sample.size()) *
+                       (1.0 + std::ceil(bit_width / 8.0));
+    return dictionary + std::min(packed, rle);
+  }
+
+  static std::uint64_t runwiseDelta(const std::vector<std::int64_t>& sample,
+                                    const std::vector<std::size_t>& runs) {
+    std::uint64_t bytes = 0;
+    for (std::size_t run = 0; run < runs.size(); ++run) {
+      const std::size_t begin = runs[run];
+      const std::size_t end =
+          run + 1 < runs.size() ? runs[run + 1] : sample.size();
+      bytes += deltaBinaryPackedBytes(
+          std::span<const std::int64_t>(sample).subspan(begin, end - begin));
+    }
+    return bytes;
+  }
+
+  [[nodiscard]] double deltaLengthBytes(
+      const std::vector<std::string_view>& sample,
+      const std::vector<std::size_t>& runs) const {
+    std::vector<std::int64_t> lengths;
+    lengths.reserve(sample.size());
+    std::vector<std::uint8_t> data;
+    for (auto value : sample) {
+      lengths.push_back(static_cast<std::int64_t>(value.size()));
+      data.insert(data.end(), value.begin(), value.end());
+    }
+    return static_cast<double>(runwiseDelta(lengths, runs)) + sized(data);
+  }
+
+  [[nodiscard]] double deltaByteArrayBytes(
+      const std::vector<std::string_view>& sample,
+      const std::vector<std::size_t>& runs) const {
+    std::vector<std::int64_t> prefixes;
+    std::vector<std::int64_t> suffixes;
+    prefixes.reserve(sample.size());
+    suffixes.reserve(sample.size());
+    std::vector<std::uint8_t> data;
+    std::size_t next_run = 0;
+    for (std::size_t i = 0; i < sample.size(); ++i) {
+      std::size_t prefix = 0;
+      if (next_run < runs.size() && runs[next_run] == i) {
+        ++next_run;
+      } else {
+        const auto previous = sample[i - 1];
+        const auto limit = std::min(previous.size(), sample[i].size());
+        while (prefix < limit && previous[prefix] == sample[i][prefix]) {
+          ++prefix;
+        }
+      }
+      prefixes.push_back(static_cast<std::int64_t>(prefix));
+      suffixes.push_back(static_cast<std::int64_t>(sample[i].size() - prefix));
+      data.insert(data.end(), sample[i].begin() + prefix, sample[i].end());
+    }
+    return static_cast<double>(runwiseDelta(prefixes, runs) +
+                               runwiseDelta(suffixes, runs)) +
+           sized(data);
+  }
+
+  EncodingAdvisorOptions options_;
+};
+
+}  // namespace halo::storage::format
@@ -0,0 +1,395 @@
+module;
+#include <algorithm>
+#include <cmath>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+export module halo.storage.format:ZoneMap;
+import halo.common;
+import :BloomFilter;
+
+namespace halo::storage::format {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+// Physical type of the column a zone map describes. Determines how values are
+// hashed into the bloom filter so probes line up with Parquet's plain
+// encoding.
+export enum class PhysicalType : std::uint8_t {
+  kInt32,
+  kInt64,
+  kFloat,
+  kDouble,
+  kByteArray,
+};
+
+export using ZoneValue = std::variant<std::int64_t, double, std::string>;
+
+// Half-open row range [begin, end) within a column chunk.
+export struct RowRange {
+  std::int64_t begin = 0;
+  std::int64_t end = 0;
+
+  [[nodiscard]] std::int64_t size() const { return end - begin; }
+  bool operator==(const RowRange&) const = default;
+};
+
+// Min/max/null statistics of a single data page, mirroring one entry of a
+// Parquet ColumnIndex together with the row span from its OffsetIndex.
+export struct PageZone {
+  std::int64_t first_row = 0;
+  std::int64_t row_count = 0;
+  std::int64_t null_count = 0;
+  // Both unset when the page has no value to bound them: every value is
+  // null or NaN. Only the former makes the page empty for a predicate.
+  std::optional<ZoneValue> min;
+  std::optional<ZoneValue> max;
+
+  [[nodiscard]] bool allNull() const { return null_count == row_count; }
+};
+
+// Equality or IN-list predicate against a single column. NULL never matches.
+export class ColumnPredicate final {
+ public:
+  enum class Kind : std::uint8_t { kEqual, kIn };
+
+  static ColumnPredicate Equal(ZoneValue value) {
+    return ColumnPredicate(Kind::kEqual, {std::move(value)});
+  }
+
+  static ColumnPredicate In(std::vector<ZoneValue> values) {
+    std::ranges::sort(values);
+    auto dups = std::ranges::unique(values);
+    values.erase(dups.begin(), dups.end());
+    return ColumnPredicate(Kind::kIn, std::move(values));
+  }
+
+  [[nodiscard]] Kind kind() const { return kind_; }
+  [[nodiscard]] const std::vector<ZoneValue>& values() const {
+    return values_;
+  }
+
+ private:
+  ColumnPredicate(Kind kind, std::vector<ZoneValue> values)
+      : kind_(kind), values_(std::move(values)) {}
+
+  Kind kind_;
+  std::vector<ZoneValue> values_;
+};
+
+// Orders two zone values of the same alternative. Returns nullopt when the
+// values are not comparable (different types or NaN), in which case callers
+// must not prune.
+std::optional<std::partial_ordering> compareZone(const ZoneValue& lhs,
+                                                 const ZoneValue& rhs) {
+  if (lhs.index() != rhs.index()) {
+    return std::nullopt;
+  }
+  if (const auto* left = std::get_if<double>(&lhs)) {
+    const double right = std::get<double>(rhs);
+    if (std::isnan(*left) || std::isnan(right)) {
+      return std::nullopt;
+    }
+    return *left <=> right;
+  }
+  if (const auto* left = std::get_if<std::int64_t>(&lhs)) {
+    return *left <=> std::get<std::int64_t>(rhs);
+  }
+  return std::get<std::string>(lhs) <=> std::get<std::string>(rhs);
+}
+
+// Whether rows bounded by `min' and `max' may hold `value'. Rows that are
+// all null hold nothing; rows with no bounds but some values (all NaN) may
+// hold anything.
+bool mayContain(bool all_null, const std::optional<ZoneValue>& min,
+                const std::optional<ZoneValue>& max, const ZoneValue& value) {
+  if (all_null) {
+    return false;
+  }
+  if (!min.has_value() || !max.has_value()) {
+    return true;
+  }
+  auto lower = compareZone(*min, value);
+  auto upper = compareZone(value, *max);
+  if (!lower.has_value() || !upper.has_value()) {
+    return true;
+  }
+  return std::is_lteq(*lower) && std::is_lteq(*upper);
+}
+
+// -0.0 and +0.0 are equal but hash apart; values are inserted as +0.0.
+double normalizeZero(double value) { return value == 0.0 ? 0.0 : value; }
+
+std::uint64_t bloomHash(PhysicalType type, const ZoneValue& value) {
+  switch (type) {
+    case PhysicalType::kInt32:
+      return SplitBlockBloomFilter::hash(
+          static_cast<std::int32_t>(std::get<std::int64_t>(value)));
+    case PhysicalType::kInt64:
+      return SplitBlockBloomFilter::hash(std::get<std::int64_t>(value));
+    case PhysicalType::kFloat:
+      return SplitBlockBloomFilter::hash(
+          static_cast<float>(normalizeZero(std::get<double>(value))));
+    case PhysicalType::kDouble:
+      return SplitBlockBloomFilter::hash(
+          normalizeZero(std::get<double>(value)));
+    case PhysicalType::kByteArray:
+      return SplitBlockBloomFilter::hash(
+          std::string_view(std::get<std::string>(value)));
+  }
+  return 0;
+}
+
+bool matchesType(PhysicalType type, const ZoneValue& value) {
+  switch (type) {
+    case PhysicalType::kInt32:
+    case PhysicalType::kInt64:
+      return std::holds_alternative<std::int64_t>(value);
+    case PhysicalType::kFloat:
+    case PhysicalType::kDouble:
+      return std::holds_alternative<double>(value);
+    case PhysicalType::kByteArray:
+      return std::holds_alternative<std::string>(value);
+  }
+  return false;
+}
+
+// Page index of one column chunk plus its optional bloom filter. Answers
+// whether the chunk can contain a match at all, and if so which row ranges
+// need to be decoded.
+export class ColumnChunkIndex final {
+ public:
+  ColumnChunkIndex(PhysicalType type, std::vector<PageZone> pages,
+                   std::optional<SplitBlockBloomFilter> bloom_filter)
+      : type_(type),
+        pages_(std::move(pages)),
+        bloom_filter_(std::move(bloom_filter)) {
+    for (const auto& page : pages_) {
+      row_count_ += page.row_count;
+      all_null_ = all_null_ && page.allNull();
+      if (!page.min.has_value()) {
+        continue;
+      }
+      if (!min_.has_value() ||
+          compareZone(*page.min, *min_) == std::partial_ordering::less) {
+        min_ = page.min;
+      }
+      if (!max_.has_value() ||
+          compareZone(*page.max, *max_) == std::partial_ordering::greater) {
+        max_ = page.max;
+      }
+    }
+  }
+
+  [[nodiscard]] PhysicalType type() const { return type_; }
+  [[nodiscard]] std::int64_t rowCount() const { return row_count_; }
+  [[nodiscard]] const std::vector<PageZone>& pages() const { return pages_; }
+  [[nodiscard]] const std::optional<ZoneValue>& min() const { return min_; }
+  [[nodiscard]] const std::optional<ZoneValue>& max() const { return max_; }
+  [[nodiscard]] const std::optional<SplitBlockBloomFilter>& bloomFilter()
+      const {
+    return bloom_filter_;
+  }
+
+  // Row-group level check: chunk min/max first, then the bloom filter for the
+  // values that survive it.
+  [[nodiscard]] bool mayMatch(const ColumnPredicate& predicate) const {
+    return std::ranges::any_of(predicate.values(), [&](const auto& value) {
+      return valueMayMatch(value);
+    });
+  }
+
+  // Page level check: rows of every page whose [min, max] covers one of the
+  // predicate values. Adjacent ranges are coalesced.
+  [[nodiscard]] std::vector<RowRange> matchingRows(
+      const ColumnPredicate& predicate) const {
+    std::vector<ZoneValue> candidates;
+    for (const auto& value : predicate.values()) {
+      if (valueMayMatch(value)) {
+        candidates.push_back(value);
+      }
+    }
+    std::vector<RowRange> ranges;
+    if (candidates.empty()) {
+      return ranges;
+    }
+    for (const auto& page : pages_) {
+      const bool hit =
+          std::ranges::any_of(candidates, [&](const auto& value) {
+            return mayContain(page.allNull(), page.min, page.max, value);
+          });
+      if (!hit) {
+        continue;
+      }
+      const RowRange range{.begin = page.first_row,
+                           .end = page.first_row + page.row_count};
+      if (!ranges.empty() && ranges.back().end == range.begin) {
+        ranges.back().end = range.end;
+      } else {
+        ranges.push_back(range);
+      }
+    }
+    return ranges;
+  }
+
+ private:
+  [[nodiscard]] bool valueMayMatch(const ZoneValue& value) const {
+    if (!matchesType(type_, value)) {
+      return true;
+    }
+    if (!mayContain(all_null_, min_, max_, value)) {
+      return false;
+    }
+    if (!bloom_filter_.has_value()) {
+      return true;
+    }
+    if (const auto* number = std::get_if<double>(&value)) {
+      // NaN has many encodings, so the filter cannot rule it out. Writers
+      // that keep -0.0's sign bit hashed it apart from +0.0, so both are
+      // probed.
+      if (std::isnan(*number)) {
+        return true;
+      }
+      if (*number == 0.0) {
+        const auto negative_zero =
+            type_ == PhysicalType::kFloat
+                ? SplitBlockBloomFilter::hash(-0.0F)
+                : SplitBlockBloomFilter::hash(-0.0);
+        return bloom_filter_->findHash(bloomHash(type_, value)) ||
+               bloom_filter_->findHash(negative_zero);
+      }
+    }
+    return bloom_filter_->findHash(bloomHash(type_, value));
+  }
+
+  PhysicalType type_;
+  std::vector<PageZone> pages_;
+  std::optional<SplitBlockBloomFilter> bloom_filter_;
+  std::int64_t row_count_ = 0;
+  bool all_null_ = true;
+  std::optional<ZoneValue> min_;
+  std::optional<ZoneValue> max_;
+};
+
+// Write-side policy for halo-managed Parquet tables. Page-level column indexes
+// are always produced; bloom filters only for the designated key columns.
+export struct IndexWriteOptions {
+  // Rows per data page, matching Parquet's default page row count limit.
+  std::int64_t page_row_limit = 20000;
+  std::unordered_set<std::string> bloom_filter_columns;
+  double bloom_filter_fpp = 0.01;
+  // Expected distinct values per column chunk; sizes the bloom filter.
+  std::uint64_t bloom_filter_ndv = 1'000'000;
+
+  [[nodiscard]] bool wantsBloomFilter(const std::string& column) const {
+    return bloom_filter_columns.contains(column);
+  }
+};
+
+// Accumulates page zones (and optionally a bloom filter) while a column chunk
+// is written. Values must be appended in row order.
+export class ColumnChunkIndexBuilder final {
+ public:
+  static StatusOr<ColumnChunkIndexBuilder> create(
+      const std::string& column, PhysicalType type,
+      const IndexWriteOptions& options) {
+    if (options.page_row_limit <= 0) {
+      return Status::Invalid("page_row_limit must be positive");
+    }
+    std::optional<SplitBlockBloomFilter> bloom_filter;
+    if (options.wantsBloomFilter(column)) {
+      auto filter = SplitBlockBloomFilter::create(
+          SplitBlockBloomFilter::optimalNumBytes(options.bloom_filter_ndv,
+                                                 options.bloom_filter_fpp));
+      if (!filter.ok()) {
+        return filter.status();
+      }
+      bloom_filter = std::move(filter).value();
+    }
+    return ColumnChunkIndexBuilder(type, options.page_row_limit,
+                                   std::move(bloom_filter));
+  }
+
+  Status append(const ZoneValue& value) {
+    if (!matchesType(type_, value)) {
+      return Status::Invalid("zone value does not match column type");
+    }
+    auto& page = currentPage();
+    const bool is_nan = std::holds_alternative<double>(value) &&
+                        std::isnan(std::get<double>(value));
+    // NaN is excluded from min/max as required for Parquet column indexes.
+    if (!is_nan) {
+      if (!page.min.has_value() ||
+          compareZone(value, *page.min) == std::partial_ordering::less) {
+        page.min = value;
+      }
+      if (!page.max.has_value() ||
+          compareZone(value, *page.max) == std::partial_ordering::greater) {
+        page.max = value;
+      }
+    }
+    if (bloom_filter_.has_value()) {
+      bloom_filter_->insertHash(bloomHash(type_, value));
+    }
+    ++page.row_count;
+    return Status::OK();
+  }
+
+  void appendNull() {
+    auto& page = currentPage();
+    ++page.null_count;
+    ++page.row_count;
+  }
+
+  ColumnChunkIndex finish() && {
+    return {type_, std::move(pages_), std::move(bloom_filter_)};
+  }
+
+ private:
+  ColumnChunkIndexBuilder(PhysicalType type, std::int64_t page_row_limit,
+                          std::optional<SplitBlockBloomFilter> bloom_filter)
+      : type_(type),
+        page_row_limit_(page_row_limit),
+        bloom_filter_(std::move(bloom_filter)) {}
+
+  PageZone& currentPage() {
+    if (pages_.empty() || pages_.back().row_count >= page_row_limit_) {
+      const std::int64_t first_row =
+          pages_.empty() ? 0
+                         : pages_.back().first_row + pages_.back().row_count;
+      pages_.push_back(PageZone{.first_row = first_row});
+    }
+    return pages_.back();
+  }
+
+  PhysicalType type_;
+  std::int64_t page_row_limit_;
+  std::optional<SplitBlockBloomFilter> bloom_filter_;
+  std::vector<PageZone> pages_;
+};
+
+// Returns the ordinals of the row groups whose column chunk may satisfy the
+// predicate. `chunks[i]' is the index of the filtered column in row group i.
+export std::vector<std::size_t> selectRowGroups(
+    std::span<const ColumnChunkIndex> chunks,
+    const ColumnPredicate& predicate) {
+  std::vector<std::size_t> selected;
+  for (std::size_t i = 0; i < chunks.size(); ++i) {
+    if (chunks[i].mayMatch(predicate)) {
+      selected.push_back(i);
+    }
+  }
+  return selected;
+}
+
+}  // namespace halo::storage::format
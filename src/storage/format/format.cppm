@@ -0,0 +1,5 @@
+export module halo.storage.format;
+export import :BloomFilter;
+export import :CodecAdvisor;
+export import :EncodingAdvisor;
+export import :ZoneMap;
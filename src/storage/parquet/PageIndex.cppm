@@ -0,0 +1,272 @@
+module;
+#include <velox/dwio/parquet/thrift/ParquetThriftTypes.h>
+
+#include <cmath>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+export module halo.storage.parquet:PageIndex;
+import halo.common;
+import halo.storage.format;
+import :Thrift;
+
+namespace halo::storage::parquet {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+using halo::storage::format::ColumnChunkIndex;
+using halo::storage::format::PageZone;
+using halo::storage::format::PhysicalType;
+using halo::storage::format::SplitBlockBloomFilter;
+using halo::storage::format::ZoneValue;
+
+namespace thrift = facebook::velox::parquet::thrift;
+
+template <typename T>
+std::string plainBytes(T value) {
+  std::string bytes(sizeof(T), '\0');
+  std::memcpy(bytes.data(), &value, sizeof(T));
+  return bytes;
+}
+
+template <typename T>
+StatusOr<T> fromPlainBytes(std::string_view bytes) {
+  if (bytes.size() != sizeof(T)) {
+    return Status::StorageError("column index bound of " +
+                                std::to_string(bytes.size()) +
+                                " bytes, expected " +
+                                std::to_string(sizeof(T)));
+  }
+  T value;
+  std::memcpy(&value, bytes.data(), sizeof(T));
+  return value;
+}
+
+// A min or max value as Parquet statistics store it: the plain encoding of
+// the physical type, without a length for byte arrays.
+export std::string encodeBound(PhysicalType type, const ZoneValue& value) {
+  switch (type) {
+    case PhysicalType::kInt32:
+      return plainBytes(
+          static_cast<std::int32_t>(std::get<std::int64_t>(value)));
+    case PhysicalType::kInt64:
+      return plainBytes(std::get<std::int64_t>(value));
+    case PhysicalType::kFloat:
+      return plainBytes(static_cast<float>(std::get<double>(value)));
+    case PhysicalType::kDouble:
+      return plainBytes(std::get<double>(value));
+    case PhysicalType::kByteArray:
+      return std::get<std::string>(value);
+  }
+  return {};
+}
+
+export StatusOr<ZoneValue> decodeBound(PhysicalType type,
+                                       std::string_view bytes) {
+  switch (type) {
+    case PhysicalType::kInt32: {
+      auto value = fromPlainBytes<std::int32_t>(bytes);
+      if (!value.ok()) {
+        return value.status();
+      }
+      return ZoneValue{std::int64_t{*value}};
+    }
+    case PhysicalType::kInt64: {
+      auto value = fromPlainBytes<std::int64_t>(bytes);
+      if (!value.ok()) {
+        return value.status();
+      }
+      return ZoneValue{*value};
+    }
+    case PhysicalType::kFloat: {
+      auto value = fromPlainBytes<float>(bytes);
+      if (!value.ok()) {
+        return value.status();
+      }
+      return ZoneValue{static_cast<double>(*value)};
+    }
+    case PhysicalType::kDouble: {
+      auto value = fromPlainBytes<double>(bytes);
+      if (!value.ok()) {
+        return value.status();
+      }
+      return ZoneValue{*value};
+    }
+    case PhysicalType::kByteArray:
+      return ZoneValue{std::string(bytes)};
+  }
+  return Status::NotImplemented("unknown physical type");
+}
+
+// Bounds for statistics and column indexes. A zero bound is stored as -0.0
+// for a min and +0.0 for a max, as the Parquet spec asks, so that readers
+// comparing either sign prune nothing they should keep.
+ZoneValue signedZero(const ZoneValue& value, bool is_min) {
+  if (const auto* number = std::get_if<double>(&value);
+      number != nullptr && *number == 0.0) {
+    return ZoneValue{is_min ? -0.0 : 0.0};
+  }
+  return value;
+}
+
+export std::string encodeMin(PhysicalType type, const ZoneValue& value) {
+  return encodeBound(type, signedZero(value, true));
+}
+
+export std::string encodeMax(PhysicalType type, const ZoneValue& value) {
+  return encodeBound(type, signedZero(value, false));
+}
+
+// The ColumnIndex of `index', or nullopt when a page holds values but no
+// bounds (all NaN): the format can only mark a page as all null, which
+// would make readers skip it.
+export std::optional<thrift::ColumnIndex> toColumnIndex(
+    const ColumnChunkIndex& index) {
+  thrift::ColumnIndex column_index;
+  std::vector<std::int64_t> null_counts;
+  bool ascending = true;
+  bool descending = true;
+  const PageZone* previous = nullptr;
+  for (const auto& page : index.pages()) {
+    const bool all_null = page.allNull();
+    if (!all_null && !page.min.has_value()) {
+      return std::nullopt;
+    }
+    column_index.null_pages.push_back(all_null);
+    column_index.min_values.push_back(
+        all_null ? std::string() : encodeMin(index.type(), *page.min));
+    column_index.max_values.push_back(
+        all_null ? std::string() : encodeMax(index.type(), *page.max));
+    null_counts.push_back(page.null_count);
+    if (all_null) {
+      continue;
+    }
+    if (previous != nullptr) {
+      const auto mins = *page.min <=> *previous->min;
+      const auto maxes = *page.max <=> *previous->max;
+      ascending = ascending && mins >= 0 && maxes >= 0;
+      descending = descending && mins <= 0 && maxes <= 0;
+    }
+    previous = &page;
+  }
+  column_index.boundary_order =
+      ascending    ? thrift::BoundaryOrder::ASCENDING
+      : descending ? thrift::BoundaryOrder::DESCENDING
+                   : thrift::BoundaryOrder::UNORDERED;
+  column_index.__set_null_counts(null_counts);
+  return column_index;
+}
+
+// Rebuilds the index of a column chunk of `row_count' rows from its offset
+// index, which places the pages, and its column index and bloom filter when
+// the file has them. Without a column index the pages have no bounds and
+// match every value.
+export StatusOr<ColumnChunkIndex> fromPageIndex(
+    PhysicalType type, std::int64_t row_count,
+    const thrift::OffsetIndex& offset_index,
+    const std::optional<thrift::ColumnIndex>& column_index,
+    std::optional<SplitBlockBloomFilter> bloom_filter) {
+  const auto& locations = offset_index.page_locations;
+  if (column_index.has_value() &&
+      (column_index->null_pages.size() != locations.size() ||
+       column_index->min_values.size() != locations.size() ||
+       column_index->max_values.size() != locations.size() ||
+       (column_index->__isset.null_counts &&
+        column_index->null_counts.size() != locations.size()))) {
+    return Status::StorageError(
+        "column index of " + std::to_string(column_index->null_pages.size()) +
+        " pages for an offset index of " + std::to_string(locations.size()));
+  }
+  std::vector<PageZone> pages;
+  pages.reserve(locations.size());
+  for (std::size_t i = 0; i < locations.size(); ++i) {
+    const auto end = i + 1 < locations.size()
+                         ? locations[i + 1].first_row_index
+                         : row_count;
+    PageZone page{.first_row = locations[i].first_row_index,
+                  .row_count = end - locations[i].first_row_index};
+    if (page.row_count < 0) {
+      return Status::StorageError("offset index pages are out of order");
+    }
+    if (column_index.has_value()) {
+      if (column_index->null_pages[i]) {
+        page.null_count = page.row_count;
+      } else {
+        auto min = decodeBound(type, column_index->min_values[i]);
+        auto max = decodeBound(type, column_index->max_values[i]);
+        if (!min.ok()) {
+          return min.status();
+        }
+        if (!max.ok()) {
+          return max.status();
+        }
+        page.min = std::move(min).value();
+        page.max = std::move(max).value();
+        if (column_index->__isset.null_counts) {
+          page.null_count = column_index->null_counts[i];
+        }
+      }
+    }
+    pages.push_back(std::move(page));
+  }
+  return ColumnChunkIndex(type, std::move(pages), std::move(bloom_filter));
+}
+
+// A bloom filter as a column chunk stores it: its header, then the bitset.
+export std::string serializeBloomFilter(const SplitBlockBloomFilter& filter) {
+  thrift::BloomFilterHeader header;
+  header.numBytes = static_cast<std::int32_t>(filter.numBytes());
+  header.algorithm.__set_BLOCK(thrift::SplitBlockAlgorithm());
+  header.hash.__set_XXHASH(thrift::XxHash());
+  header.compression.__set_UNCOMPRESSED(thrift::Uncompressed());
+  auto bytes = serializeThrift(header);
+  const auto bitset = filter.bitset();
+  bytes.append(reinterpret_cast<const char*>(bitset.data()), bitset.size());
+  return bytes;
+}
+
+// Reads the bloom filter at the front of `bytes', which may run past its
+// end: the footer records where a filter starts but not its length.
+export StatusOr<SplitBlockBloomFilter> deserializeBloomFilter(
+    std::span<const char> bytes) {
+  thrift::BloomFilterHeader header;
+  auto header_bytes = deserializeThrift(bytes, header);
+  if (!header_bytes.ok()) {
+    return header_bytes.status();
+  }
+  if (!header.algorithm.__isset.BLOCK || !header.hash.__isset.XXHASH ||
+      !header.compression.__isset.UNCOMPRESSED) {
+    return Status::NotImplemented(
+        "only uncompressed split-block bloom filters hashed with xxHash are "
+        "supported");
+  }
+  if (header.numBytes < 0 ||
+      static_cast<std::size_t>(header.numBytes) >
+          bytes.size() - *header_bytes) {
+    return Status::StorageError("bloom filter of " +
+                                std::to_string(header.numBytes) +
+                                " bytes runs past the file");
+  }
+  return SplitBlockBloomFilter::fromBitset(std::span<const std::uint8_t>(
+      reinterpret_cast<const std::uint8_t*>(bytes.data() + *header_bytes),
+      static_cast<std::size_t>(header.numBytes)));
+}
+
+// Keys of a column chunk's key/value metadata locating its full-text index,
+// which Parquet has no field for. Values are decimal byte offsets into the
+// file and lengths.
+export constexpr std::string_view kFullTextIndexOffsetKey =
+    "halo.full_text_index.offset";
+export constexpr std::string_view kFullTextIndexLengthKey =
+    "halo.full_text_index.length";
+
+}  // namespace halo::storage::parquet
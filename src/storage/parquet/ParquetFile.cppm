@@ -0,0 +1,396 @@
+module;
+#include <velox/dwio/parquet/thrift/ParquetThriftTypes.h>
+#include <velox/type/Type.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+export module halo.storage.parquet:ParquetFile;
+import halo.common;
+import halo.storage.file;
+import halo.storage.format;
+import halo.storage.search;
+import :PageIndex;
+import :Thrift;
+
+namespace halo::storage::parquet {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+using halo::storage::format::ColumnChunkIndex;
+using halo::storage::format::PhysicalType;
+using halo::storage::format::SplitBlockBloomFilter;
+
+namespace thrift = facebook::velox::parquet::thrift;
+namespace velox = facebook::velox;
+
+StatusOr<std::pair<PhysicalType, velox::TypePtr>> columnType(
+    const thrift::SchemaElement& leaf) {
+  if (leaf.__isset.num_children && leaf.num_children > 0) {
+    return Status::NotImplemented("nested column '" + leaf.name +
+                                  "' is not supported");
+  }
+  if (leaf.__isset.repetition_type &&
+      leaf.repetition_type != thrift::FieldRepetitionType::REQUIRED) {
+    return Status::NotImplemented("column '" + leaf.name +
+                                  "' is not REQUIRED");
+  }
+  // Integers annotated as dates, decimals or narrower types would need a
+  // conversion the loader does not make.
+  const bool annotated =
+      leaf.__isset.converted_type || leaf.__isset.logicalType;
+  switch (leaf.type) {
+    case thrift::Type::INT32:
+      if (!annotated) {
+        return std::pair{PhysicalType::kInt32, velox::INTEGER()};
+      }
+      break;
+    case thrift::Type::INT64:
+      if (!annotated) {
+        return std::pair{PhysicalType::kInt64, velox::BIGINT()};
+      }
+      break;
+    case thrift::Type::FLOAT:
+      return std::pair{PhysicalType::kFloat, velox::REAL()};
+    case thrift::Type::DOUBLE:
+      return std::pair{PhysicalType::kDouble, velox::DOUBLE()};
+    case thrift::Type::BYTE_ARRAY:
+      return std::pair{PhysicalType::kByteArray, velox::VARCHAR()};
+    default:
+      break;
+  }
+  return Status::NotImplemented("column '" + leaf.name +
+                                "' has an unsupported Parquet type");
+}
+
+// The footer and page indexes of a Parquet file mapped in memory. Opening
+// parses the footer; the page indexes and bloom filters of a column chunk
+// are read when asked for, so a scan that prunes on one column never
+// parses the others'.
+//
+// Only flat files of REQUIRED INT32, INT64, FLOAT, DOUBLE and BYTE_ARRAY
+// columns are supported, the ones ColumnBufferLoader can load. Thread-safe.
+export class ParquetFile final {
+ public:
+  static StatusOr<std::shared_ptr<ParquetFile>> open(
+      std::shared_ptr<const file::MappedReadFile> file) {
+    if (file == nullptr) {
+      return Status::Invalid("Parquet file must not be null");
+    }
+    constexpr std::uint64_t kTrailer = 8;
+    if (file->size() < kTrailer + 4) {
+      return notParquet(*file);
+    }
+    auto trailer = file->view(file->size() - kTrailer, kTrailer);
+    auto head = file->view(0, 4);
+    if (!trailer.ok() || !head.ok()) {
+      return notParquet(*file);
+    }
+    if (std::string_view(trailer->data() + 4, 4) != "PAR1" ||
+        std::string_view(head->data(), 4) != "PAR1") {
+      return notParquet(*file);
+    }
+    std::uint32_t footer_length = 0;
+    std::memcpy(&footer_length, trailer->data(), sizeof(footer_length));
+    if (footer_length > file->size() - kTrailer - 4) {
+      return Status::StorageError("footer of '" + std::string(file->name()) +
+                                  "' runs past the file");
+    }
+    auto footer =
+        file->view(file->size() - kTrailer - footer_length, footer_length);
+    if (!footer.ok()) {
+      return footer.status();
+    }
+    thrift::FileMetaData meta;
+    if (auto read = deserializeThrift(*footer, meta); !read.ok()) {
+      return read.status();
+    }
+    if (meta.schema.empty() ||
+        meta.schema.front().num_children + 1 !=
+            static_cast<std::int32_t>(meta.schema.size())) {
+      return Status::NotImplemented("'" + std::string(file->name()) +
+                                    "' is not a flat Parquet file");
+    }
+    std::vector<PhysicalType> physical_types;
+    std::vector<std::string> names;
+    std::vector<velox::TypePtr> types;
+    for (std::size_t i = 1; i < meta.schema.size(); ++i) {
+      auto type = columnType(meta.schema[i]);
+      if (!type.ok()) {
+        return type.status();
+      }
+      physical_types.push_back(type->first);
+      names.push_back(meta.schema[i].name);
+      types.push_back(std::move(type->second));
+    }
+    for (const auto& row_group : meta.row_groups) {
+      if (row_group.columns.size() != names.size()) {
+        return Status::StorageError("row group of " +
+                                    std::to_string(row_group.columns.size()) +
+                                    " columns in a schema of " +
+                                    std::to_string(names.size()));
+      }
+      for (const auto& chunk : row_group.columns) {
+        if (!chunk.__isset.meta_data || chunk.__isset.file_path) {
+          return Status::NotImplemented(
+              "column chunks in other files are not supported");
+        }
+      }
+    }
+    return std::shared_ptr<ParquetFile>(new ParquetFile(
+        std::move(file), std::move(meta), std::move(physical_types),
+        velox::ROW(std::move(names), std::move(types))));
+  }
+
+  [[nodiscard]] const std::shared_ptr<const file::MappedReadFile>& file()
+      const {
+    return file_;
+  }
+  [[nodiscard]] const velox::RowTypePtr& rowType() const { return type_; }
+  [[nodiscard]] std::size_t numRowGroups() const {
+    return meta_.row_groups.size();
+  }
+  [[nodiscard]] std::int64_t numRows(std::size_t row_group) const {
+    return meta_.row_groups[row_group].num_rows;
+  }
+  [[nodiscard]] PhysicalType physicalType(std::size_t column) const {
+    return physical_types_[column];
+  }
+
+  [[nodiscard]] std::optional<std::size_t> findColumn(
+      std::string_view name) const {
+    for (std::size_t i = 0; i < type_->size(); ++i) {
+      if (type_->nameOf(i) == name) {
+        return i;
+      }
+    }
+    return std::nullopt;
+  }
+
+  [[nodiscard]] const thrift::ColumnMetaData& columnMetaData(
+      std::size_t row_group, std::size_t column) const {
+    return meta_.row_groups[row_group].columns[column].meta_data;
+  }
+
+  // The footer's key/value metadata entry `key', if there is one.
+  [[nodiscard]] std::optional<std::string> keyValue(
+      std::string_view key) const {
+    for (const auto& entry : meta_.key_value_metadata) {
+      if (entry.key == key && entry.__isset.value) {
+        return entry.value;
+      }
+    }
+    return std::nullopt;
+  }
+
+  // Where the pages of a column chunk start and which rows they hold. For
+  // a chunk written without an offset index, the data page headers are
+  // walked instead.
+  StatusOr<thrift::OffsetIndex> offsetIndex(std::size_t row_group,
+                                            std::size_t column) const {
+    const auto& chunk = meta_.row_groups[row_group].columns[column];
+    if (!chunk.__isset.offset_index_offset) {
+      return walkPageHeaders(chunk.meta_data);
+    }
+    thrift::OffsetIndex offset_index;
+    if (auto status = readIndex(chunk.offset_index_offset,
+                                chunk.offset_index_length, offset_index);
+        !status.ok()) {
+      return status;
+    }
+    return offset_index;
+  }
+
+  // The page zones and bloom filter of a column chunk, from its offset
+  // index, column index and bloom filter. Only min_value and max_value
+  // statistics stand in for a missing column index: the deprecated min and
+  // max may be ordered as signed bytes.
+  StatusOr<ColumnChunkIndex> chunkIndex(std::size_t row_group,
+                                        std::size_t column) const {
+    auto offset_index = offsetIndex(row_group, column);
+    if (!offset_index.ok()) {
+      return offset_index.status();
+    }
+    const auto& chunk = meta_.row_groups[row_group].columns[column];
+    std::optional<thrift::ColumnIndex> column_index;
+    if (chunk.__isset.column_index_offset) {
+      column_index.emplace();
+      if (auto status = readIndex(chunk.column_index_offset,
+                                  chunk.column_index_length, *column_index);
+          !status.ok()) {
+        return status;
+      }
+    } else if (const auto& stats = chunk.meta_data.statistics;
+               chunk.meta_data.__isset.statistics &&
+               stats.__isset.min_value && stats.__isset.max_value) {
+      // Without a column index every page is bounded by the chunk's
+      // statistics, which still lets a scan skip the row group.
+      column_index.emplace();
+      const auto pages = offset_index->page_locations.size();
+      column_index->null_pages.assign(pages, false);
+      column_index->min_values.assign(pages, stats.min_value);
+      column_index->max_values.assign(pages, stats.max_value);
+    }
+    std::optional<SplitBlockBloomFilter> bloom_filter;
+    if (chunk.meta_data.__isset.bloom_filter_offset) {
+      const auto offset =
+          static_cast<std::uint64_t>(chunk.meta_data.bloom_filter_offset);
+      if (offset > file_->size()) {
+        return Status::StorageError("bloom filter of column '" +
+                                    type_->nameOf(column) +
+                                    "' starts past the file");
+      }
+      auto bytes = file_->view(offset, file_->size() - offset);
+      if (!bytes.ok()) {
+        return bytes.status();
+      }
+      auto filter = deserializeBloomFilter(*bytes);
+      if (!filter.ok()) {
+        return filter.status();
+      }
+      bloom_filter = std::move(filter).value();
+    }
+    return fromPageIndex(physical_types_[column], numRows(row_group),
+                         *offset_index, column_index,
+                         std::move(bloom_filter));
+  }
+
+  // The full-text index ParquetWriter stored for a column chunk, or
+  // nullopt when the chunk has none.
+  StatusOr<std::optional<search::FullTextIndex>> fullTextIndex(
+      std::size_t row_group, std::size_t column) const {
+    const auto& meta = columnMetaData(row_group, column);
+    std::optional<std::uint64_t> offset;
+    std::optional<std::uint64_t> length;
+    for (const auto& entry : meta.key_value_metadata) {
+      std::optional<std::uint64_t>* field = nullptr;
+      if (entry.key == kFullTextIndexOffsetKey) {
+        field = &offset;
+      } else if (entry.key == kFullTextIndexLengthKey) {
+        field = &length;
+      } else {
+        continue;
+      }
+      std::uint64_t value = 0;
+      const auto* end = entry.value.data() + entry.value.size();
+      if (!entry.__isset.value ||
+          std::from_chars(entry.value.data(), end, value).ptr != end) {
+        return Status::StorageError(entry.key + " of column '" +
+                                    type_->nameOf(column) +
+                                    "' is not a number");
+      }
+      *field = value;
+    }
+    if (!offset.has_value() || !length.has_value()) {
+      return std::optional<search::FullTextIndex>();
+    }
+    auto bytes = file_->view(*offset, *length);
+    if (!bytes.ok()) {
+      return bytes.status();
+    }
+    auto index = search::FullTextIndex::deserialize(*bytes);
+    if (!index.ok()) {
+      return index.status();
+    }
+    return std::optional<search::FullTextIndex>(std::move(index).value());
+  }
+
+ private:
+  ParquetFile(std::shared_ptr<const file::MappedReadFile> file,
+              thrift::FileMetaData meta,
+              std::vector<PhysicalType> physical_types,
+              velox::RowTypePtr type)
+      : file_(std::move(file)),
+        meta_(std::move(meta)),
+        physical_types_(std::move(physical_types)),
+        type_(std::move(type)) {}
+
+  static Status notParquet(const file::MappedReadFile& file) {
+    return Status::StorageError("'" + std::string(file.name()) +
+                                "' is not a Parquet file");
+  }
+
+  StatusOr<thrift::OffsetIndex> walkPageHeaders(
+      const thrift::ColumnMetaData& meta) const {
+    auto offset = meta.data_page_offset;
+    if (meta.__isset.dictionary_page_offset) {
+      offset = std::min(offset, meta.dictionary_page_offset);
+    }
+    const auto end = offset + meta.total_compressed_size;
+    if (offset < 0 || meta.total_compressed_size < 0 ||
+        static_cast<std::uint64_t>(end) > file_->size()) {
+      return Status::StorageError("column chunk at offset " +
+                                  std::to_string(offset) +
+                                  " runs past the file");
+    }
+    thrift::OffsetIndex offset_index;
+    std::int64_t first_row = 0;
+    while (offset < end) {
+      auto bytes = file_->view(static_cast<std::uint64_t>(offset),
+                               static_cast<std::uint64_t>(end - offset));
+      if (!bytes.ok()) {
+        return bytes.status();
+      }
+      thrift::PageHeader header;
+      auto header_bytes = deserializeThrift(*bytes, header);
+      if (!header_bytes.ok()) {
+        return header_bytes.status();
+      }
+      const auto page_size = static_cast<std::int64_t>(*header_bytes) +
+                             header.compressed_page_size;
+      if (header.compressed_page_size < 0 || page_size > end - offset) {
+        return Status::StorageError("page at offset " +
+                                    std::to_string(offset) +
+                                    " runs past its column chunk");
+      }
+      std::int64_t rows = -1;
+      if (header.type == thrift::PageType::DATA_PAGE) {
+        // Without repetition, every value is a row.
+        rows = header.data_page_header.num_values;
+      } else if (header.type == thrift::PageType::DATA_PAGE_V2) {
+        rows = header.data_page_header_v2.num_rows;
+      }
+      if (rows >= 0) {
+        thrift::PageLocation location;
+        location.offset = offset;
+        location.compressed_page_size = static_cast<std::int32_t>(page_size);
+        location.first_row_index = first_row;
+        offset_index.page_locations.push_back(location);
+        first_row += rows;
+      }
+      offset += page_size;
+    }
+    return offset_index;
+  }
+
+  template <typename T>
+  Status readIndex(std::int64_t offset, std::int32_t length, T& value) const {
+    if (offset < 0 || length < 0) {
+      return Status::StorageError("negative page index location");
+    }
+    auto bytes = file_->view(static_cast<std::uint64_t>(offset),
+                             static_cast<std::uint64_t>(length));
+    if (!bytes.ok()) {
+      return bytes.status();
+    }
+    auto read = deserializeThrift(*bytes, value);
+    return read.ok() ? Status::OK() : read.status();
+  }
+
+  const std::shared_ptr<const file::MappedReadFile> file_;
+  const thrift::FileMetaData meta_;
+  const std::vector<PhysicalType> physical_types_;
+  const velox::RowTypePtr type_;
+};
+
+}  // namespace halo::storage::parquet
@@ -0,0 +1,719 @@
+module;
+#include <velox/dwio/parquet/thrift/ParquetThriftTypes.h>
+#include <velox/type/StringView.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/DecodedVector.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+export module halo.storage.parquet:ParquetWriter;
+import halo.common;
+import halo.storage.format;
+import halo.storage.search;
+import :PageIndex;
+import :Thrift;
+
+namespace halo::storage::parquet {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+using halo::storage::format::ColumnChunkIndex;
+using halo::storage::format::ColumnChunkIndexBuilder;
+using halo::storage::format::PhysicalType;
+using halo::storage::format::ZoneValue;
+
+namespace thrift = facebook::velox::parquet::thrift;
+namespace velox = facebook::velox;
+
+export struct ParquetWriterOptions {
+  // Rows per row group. A row group is buffered in memory until it is full
+  // or the writer is closed.
+  std::int64_t row_group_rows = 1'000'000;
+  // Rows per data page and the columns that get a bloom filter. Every
+  // column chunk gets a column index and an offset index.
+  format::IndexWriteOptions index;
+  // Page codec of every column not in `column_codecs', unless
+  // `codec_advice' is set.
+  format::CodecCandidate codec{.codec = format::Codec::kSnappy};
+  // Per-column codecs, such as the choices of a format::CodecAdvisor
+  // for target kParquet.
+  std::map<std::string, format::CodecCandidate> column_codecs;
+  // When set, every chunk of a column not in `column_codecs' is compressed
+  // with what a kParquet CodecAdvisor with these options picks for its first
+  // page, instead of `codec'.
+  std::optional<format::CodecAdvisorOptions> codec_advice;
+  // VARCHAR columns whose chunks get a full-text index, built with these
+  // analyzer options and stored after the chunk's pages.
+  std::map<std::string, search::TextAnalyzerOptions> full_text_columns;
+  // When set, every column chunk's values go through format::EncodingAdvisor
+  // and its choice (EncodingChoice::toMetadata) is recorded in the chunk's
+  // key/value metadata. Pages are still PLAIN; the entry tells whoever
+  // rewrites the file which encoding would pay off.
+  std::optional<format::EncodingAdvisorOptions> encoding_advice;
+  // Written to the footer as is.
+  std::map<std::string, std::string> key_value_metadata;
+};
+
+// The physical type a Velox column is written as, if the writer supports it.
+export StatusOr<PhysicalType> physicalTypeOf(const velox::Type& type) {
+  if (type.isDate()) {
+    return Status::NotImplemented("cannot write DATE columns to Parquet");
+  }
+  switch (type.kind()) {
+    case velox::TypeKind::INTEGER:
+      return PhysicalType::kInt32;
+    case velox::TypeKind::BIGINT:
+      return PhysicalType::kInt64;
+    case velox::TypeKind::REAL:
+      return PhysicalType::kFloat;
+    case velox::TypeKind::DOUBLE:
+      return PhysicalType::kDouble;
+    case velox::TypeKind::VARCHAR:
+      return PhysicalType::kByteArray;
+    default:
+      return Status::NotImplemented("cannot write " + type.toString() +
+                                    " columns to Parquet");
+  }
+}
+
+thrift::Type::type thriftType(PhysicalType type) {
+  switch (type) {
+    case PhysicalType::kInt32:
+      return thrift::Type::INT32;
+    case PhysicalType::kInt64:
+      return thrift::Type::INT64;
+    case PhysicalType::kFloat:
+      return thrift::Type::FLOAT;
+    case PhysicalType::kDouble:
+      return thrift::Type::DOUBLE;
+    case PhysicalType::kByteArray:
+      return thrift::Type::BYTE_ARRAY;
+  }
+  return thrift::Type::BYTE_ARRAY;
+}
+
+// Writes flat, non-null Velox row vectors to a Parquet file with page
+// indexes: plain-encoded DataPage V1 pages of `index.page_row_limit' rows,
+// a ColumnIndex and OffsetIndex for every column chunk and split-block bloom
+// filters for the configured columns, laid out ahead of the footer as the
+// Parquet spec places them. Columns named in `full_text_columns' also get
+// a search::FullTextIndex per chunk, written right after the chunk's pages
+// and located by the chunk's key/value metadata, where other readers skip
+// it. Scans use the indexes to skip row groups and pages; see ParquetScan.
+// Each chunk is compressed with its column's codec, or with the one a
+// format::CodecAdvisor picks from its first page.
+//
+// Columns are REQUIRED; a null value fails the write. Not thread-safe.
+export class ParquetWriter final {
+ public:
+  static StatusOr<std::unique_ptr<ParquetWriter>> create(
+      const std::filesystem::path& path, velox::RowTypePtr type,
+      ParquetWriterOptions options = {}) {
+    if (type == nullptr || type->size() == 0) {
+      return Status::Invalid("Parquet files need at least one column");
+    }
+    if (options.row_group_rows <= 0) {
+      return Status::Invalid("row_group_rows must be positive");
+    }
+    if (auto codec = toParquetCodec(options.codec.codec); !codec.ok()) {
+      return codec.status();
+    }
+    std::vector<PhysicalType> physical_types;
+    for (const auto& child : type->children()) {
+      auto physical = physicalTypeOf(*child);
+      if (!physical.ok()) {
+        return physical.status();
+      }
+      physical_types.push_back(*physical);
+    }
+    std::vector<std::optional<search::FullTextIndexBuilder>> full_text(
+        physical_types.size());
+    for (const auto& [name, analyzer] : options.full_text_columns) {
+      const auto column = type->getChildIdxIfExists(name);
+      if (!column.has_value() ||
+          physical_types[*column] != PhysicalType::kByteArray) {
+        return Status::Invalid("full-text index column '" + name +
+                               "' is not a VARCHAR column");
+      }
+      auto builder = search::FullTextIndexBuilder::create(analyzer);
+      if (!builder.ok()) {
+        return builder.status();
+      }
+      full_text[*column].emplace(std::move(builder).value());
+    }
+    std::vector<std::optional<format::CodecCandidate>> column_codecs(
+        physical_types.size());
+    for (const auto& [name, codec] : options.column_codecs) {
+      const auto column = type->getChildIdxIfExists(name);
+      if (!column.has_value()) {
+        return Status::Invalid("no column '" + name + "' to set a codec for");
+      }
+      if (auto parquet_codec = toParquetCodec(codec.codec);
+          !parquet_codec.ok()) {
+        return parquet_codec.status();
+      }
+      column_codecs[*column] = codec;
+    }
+    std::optional<format::CodecAdvisor> codec_advisor;
+    if (options.codec_advice.has_value()) {
+      auto created = format::CodecAdvisor::create(format::CodecTarget::kParquet,
+                                                  *options.codec_advice);
+      if (!created.ok()) {
+        return created.status();
+      }
+      codec_advisor.emplace(std::move(created).value());
+    }
+    std::optional<format::EncodingAdvisor> advisor;
+    if (options.encoding_advice.has_value()) {
+      auto created = format::EncodingAdvisor::create(*options.encoding_advice);
+      if (!created.ok()) {
+        return created.status();
+      }
+      advisor.emplace(std::move(created).value());
+    }
+    std::unique_ptr<ParquetWriter> writer(
+        new ParquetWriter(path, std::move(type), std::move(options),
+                          std::move(codec_advisor), std::move(advisor)));
+    for (std::size_t i = 0; i < physical_types.size(); ++i) {
+      writer->columns_.push_back(
+          ColumnWriter{.name = writer->type_->nameOf(i),
+                       .physical_type = physical_types[i],
+                       .column_codec = column_codecs[i],
+                       .full_text = std::move(full_text[i])});
+    }
+    if (auto status = writer->startRowGroup(); !status.ok()) {
+      return status;
+    }
+    writer->out_.open(path, std::ios::binary | std::ios::trunc);
+    if (auto status = writer->append(kMagic); !status.ok()) {
+      return status;
+    }
+    return writer;
+  }
+
+  ParquetWriter(const ParquetWriter&) = delete;
+  ParquetWriter& operator=(const ParquetWriter&) = delete;
+
+  // Appends the rows of `batch', whose type must be the writer's.
+  Status write(const velox::RowVectorPtr& batch) {
+    if (closed_) {
+      return Status::Invalid("Parquet writer is closed");
+    }
+    if (batch == nullptr || batch->childrenSize() != columns_.size()) {
+      return Status::Invalid("batch does not match the Parquet schema");
+    }
+    std::vector<std::unique_ptr<velox::DecodedVector>> decoded;
+    decoded.reserve(columns_.size());
+    for (std::size_t i = 0; i < columns_.size(); ++i) {
+      const auto& child = batch->childAt(i);
+      if (child->type()->kind() != type_->childAt(i)->kind()) {
+        return Status::Invalid("column '" + columns_[i].name + "' is " +
+                               child->type()->toString() + ", expected " +
+                               type_->childAt(i)->toString());
+      }
+      decoded.push_back(std::make_unique<velox::DecodedVector>(*child));
+    }
+    velox::vector_size_t row = 0;
+    while (row < batch->size()) {
+      const auto rows = static_cast<velox::vector_size_t>(
+          std::min<std::int64_t>(batch->size() - row,
+                                 options_.row_group_rows - group_rows_));
+      for (std::size_t i = 0; i < columns_.size(); ++i) {
+        if (auto status = appendValues(columns_[i], *decoded[i], row, rows);
+            !status.ok()) {
+          return status;
+        }
+      }
+      row += rows;
+      group_rows_ += rows;
+      if (group_rows_ == options_.row_group_rows) {
+        if (auto status = flushRowGroup(); !status.ok()) {
+          return status;
+        }
+      }
+    }
+    return Status::OK();
+  }
+
+  // Writes the buffered row group, the indexes and the footer. The file is
+  // incomplete until this succeeds.
+  Status close() {
+    if (closed_) {
+      return Status::OK();
+    }
+    closed_ = true;
+    if (group_rows_ > 0) {
+      if (auto status = flushRowGroup(); !status.ok()) {
+        return status;
+      }
+    }
+    if (auto status = writeIndexes(); !status.ok()) {
+      return status;
+    }
+    auto footer = serializeThrift(fileMetaData());
+    const auto length = static_cast<std::uint32_t>(footer.size());
+    char length_bytes[sizeof(length)];
+    std::memcpy(length_bytes, &length, sizeof(length));
+    footer.append(length_bytes, sizeof(length));
+    footer.append(kMagic);
+    if (auto status = append(footer); !status.ok()) {
+      return status;
+    }
+    out_.close();
+    if (!out_) {
+      return Status::StorageError("cannot write " + path_.string());
+    }
+    return Status::OK();
+  }
+
+ private:
+  static constexpr std::string_view kMagic = "PAR1";
+
+  // The chunk of one column in the row group being written: its pages so
+  // far, the page being filled and the index over both.
+  struct ColumnWriter {
+    std::string name;
+    PhysicalType physical_type;
+    // From `column_codecs', if the column is there.
+    std::optional<format::CodecCandidate> column_codec;
+    // The codec of the chunk being written, chosen at its first page.
+    std::optional<format::CodecCandidate> codec;
+    std::string chunk;
+    std::string page;
+    std::int64_t page_rows = 0;
+    std::int64_t chunk_rows = 0;
+    std::int64_t uncompressed_bytes = 0;
+    // Offsets relative to the start of the chunk until it is written.
+    std::vector<thrift::PageLocation> pages;
+    std::optional<ColumnChunkIndexBuilder> index;
+    // Reset by every build(), so one builder serves all row groups.
+    std::optional<search::FullTextIndexBuilder> full_text;
+    // The chunk's values, PLAIN-encoded, kept for the encoding advisor.
+    std::string plain_values;
+  };
+
+  // What the indexes of a written column chunk need once the row groups
+  // are done.
+  struct WrittenChunk {
+    ColumnChunkIndex index;
+    thrift::OffsetIndex offset_index;
+  };
+
+  ParquetWriter(std::filesystem::path path, velox::RowTypePtr type,
+                ParquetWriterOptions options,
+                std::optional<format::CodecAdvisor> codec_advisor,
+                std::optional<format::EncodingAdvisor> advisor)
+      : path_(std::move(path)),
+        type_(std::move(type)),
+        options_(std::move(options)),
+        codec_advisor_(std::move(codec_advisor)),
+        advisor_(std::move(advisor)) {}
+
+  Status startRowGroup() {
+    for (auto& column : columns_) {
+      auto index = ColumnChunkIndexBuilder::create(
+          column.name, column.physical_type, options_.index);
+      if (!index.ok()) {
+        return index.status();
+      }
+      column.index.emplace(std::move(index).value());
+    }
+    group_rows_ = 0;
+    return Status::OK();
+  }
+
+  Status appendValues(ColumnWriter& column,
+                      const velox::DecodedVector& decoded,
+                      velox::vector_size_t begin,
+                      velox::vector_size_t count) {
+    for (auto row = begin; row < begin + count; ++row) {
+      if (decoded.isNullAt(row)) {
+        return Status::Invalid("column '" + column.name +
+                               "' is REQUIRED but has a null value");
+      }
+      Status status = Status::OK();
+      switch (column.physical_type) {
+        case PhysicalType::kInt32:
+          status = appendFixed(column, decoded.valueAt<std::int32_t>(row));
+          break;
+        case PhysicalType::kInt64:
+          status = appendFixed(column, decoded.valueAt<std::int64_t>(row));
+          break;
+        case PhysicalType::kFloat:
+          status = appendFixed(column, decoded.valueAt<float>(row));
+          break;
+        case PhysicalType::kDouble:
+          status = appendFixed(column, decoded.valueAt<double>(row));
+          break;
+        case PhysicalType::kByteArray:
+          status = appendString(column,
+                                decoded.valueAt<velox::StringView>(row));
+          break;
+      }
+      if (!status.ok()) {
+        return status;
+      }
+      if (++column.page_rows == options_.index.page_row_limit) {
+        if (auto flushed = flushPage(column); !flushed.ok()) {
+          return flushed;
+        }
+      }
+    }
+    return Status::OK();
+  }
+
+  template <typename T>
+  static Status appendFixed(ColumnWriter& column, T value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    column.page.append(bytes, sizeof(T));
+    if constexpr (std::is_integral_v<T>) {
+      return column.index->append(ZoneValue{std::int64_t{value}});
+    } else {
+      return column.index->append(ZoneValue{static_cast<double>(value)});
+    }
+  }
+
+  static Status appendString(ColumnWriter& column, velox::StringView value) {
+    const auto length = static_cast<std::uint32_t>(value.size());
+    char bytes[sizeof(length)];
+    std::memcpy(bytes, &length, sizeof(length));
+    column.page.append(bytes, sizeof(length));
+    column.page.append(value.data(), value.size());
+    if (column.full_text.has_value()) {
+      column.full_text->append(std::string_view(value.data(), value.size()));
+    }
+    return column.index->append(
+        ZoneValue{std::string(value.data(), value.size())});
+  }
+
+  // Compresses the filled page and appends it, header first, to the chunk.
+  Status flushPage(ColumnWriter& column) {
+    if (!column.codec.has_value()) {
+      auto codec = chunkCodec(column);
+      if (!codec.ok()) {
+        return codec.status();
+      }
+      column.codec = *codec;
+    }
+    auto body = format::compressBuffer(*column.codec, column.page);
+    if (!body.ok()) {
+      return body.status();
+    }
+    if (!fitsPage(column.page.size()) || !fitsPage(body->size())) {
+      return Status::Invalid("a page of column '" + column.name +
+                             "' exceeds 2 GiB; lower page_row_limit");
+    }
+    thrift::DataPageHeader data_page;
+    data_page.num_values = static_cast<std::int32_t>(column.page_rows);
+    data_page.encoding = thrift::Encoding::PLAIN;
+    // REQUIRED, non-nested columns have no levels to encode.
+    data_page.definition_level_encoding = thrift::Encoding::RLE;
+    data_page.repetition_level_encoding = thrift::Encoding::RLE;
+    thrift::PageHeader header;
+    header.type = thrift::PageType::DATA_PAGE;
+    header.uncompressed_page_size =
+        static_cast<std::int32_t>(column.page.size());
+    header.compressed_page_size = static_cast<std::int32_t>(body->size());
+    header.__set_data_page_header(data_page);
+    const auto header_bytes = serializeThrift(header);
+
+    thrift::PageLocation location;
+    location.offset = static_cast<std::int64_t>(column.chunk.size());
+    location.compressed_page_size =
+        static_cast<std::int32_t>(header_bytes.size() + body->size());
+    location.first_row_index = column.chunk_rows;
+    column.pages.push_back(location);
+    column.chunk.append(header_bytes);
+    column.chunk.append(*body);
+    if (advisor_.has_value()) {
+      column.plain_values.append(column.page);
+    }
+    column.uncompressed_bytes += static_cast<std::int64_t>(
+        header_bytes.size() + column.page.size());
+    column.chunk_rows += column.page_rows;
+    column.page.clear();
+    column.page_rows = 0;
+    return Status::OK();
+  }
+
+  // The codec of the chunk whose first page `column' holds.
+  StatusOr<format::CodecCandidate> chunkCodec(const ColumnWriter& column) {
+    if (column.column_codec.has_value()) {
+      return *column.column_codec;
+    }
+    if (!codec_advisor_.has_value()) {
+      return options_.codec;
+    }
+    auto choice = codec_advisor_->advise(column.page);
+    if (!choice.ok()) {
+      return choice.status();
+    }
+    return choice->choice;
+  }
+
+  // The advisor's choice for the chunk `column' has buffered.
+  format::EncodingChoice adviseEncoding(const ColumnWriter& column) const {
+    const auto& bytes = column.plain_values;
+    switch (column.physical_type) {
+      case PhysicalType::kInt32:
+        return adviseFixed<std::int32_t>(bytes);
+      case PhysicalType::kInt64:
+        return adviseFixed<std::int64_t>(bytes);
+      case PhysicalType::kFloat:
+        return adviseFixed<float>(bytes);
+      case PhysicalType::kDouble:
+        return adviseFixed<double>(bytes);
+      case PhysicalType::kByteArray:
+        break;
+    }
+    std::vector<std::string_view> values;
+    for (std::size_t at = 0; at < bytes.size();) {
+      std::uint32_t length = 0;
+      std::memcpy(&length, bytes.data() + at, sizeof(length));
+      at += sizeof(length);
+      values.emplace_back(bytes.data() + at, length);
+      at += length;
+    }
+    return advisor_->choose(std::span<const std::string_view>(values));
+  }
+
+  template <typename T>
+  format::EncodingChoice adviseFixed(const std::string& bytes) const {
+    std::vector<T> values(bytes.size() / sizeof(T));
+    std::memcpy(values.data(), bytes.data(), values.size() * sizeof(T));
+    return advisor_->choose(std::span<const T>(values));
+  }
+
+  static bool fitsPage(std::size_t size) {
+    return size <= static_cast<std::size_t>(
+                       std::numeric_limits<std::int32_t>::max());
+  }
+
+  Status flushRowGroup() {
+    thrift::RowGroup row_group;
+    std::vector<WrittenChunk> written;
+    for (auto& column : columns_) {
+      if (column.page_rows > 0) {
+        if (auto status = flushPage(column); !status.ok()) {
+          return status;
+        }
+      }
+      const auto chunk_offset = position_;
+      if (auto status = append(column.chunk); !status.ok()) {
+        return status;
+      }
+      std::vector<thrift::KeyValue> chunk_metadata;
+      if (column.full_text.has_value()) {
+        const auto offset = position_;
+        if (auto status = append(column.full_text->build().serialize());
+            !status.ok()) {
+          return status;
+        }
+        chunk_metadata.resize(2);
+        chunk_metadata[0].key = kFullTextIndexOffsetKey;
+        chunk_metadata[0].__set_value(std::to_string(offset));
+        chunk_metadata[1].key = kFullTextIndexLengthKey;
+        chunk_metadata[1].__set_value(std::to_string(position_ - offset));
+      }
+      if (advisor_.has_value()) {
+        auto [key, value] = adviseEncoding(column).toMetadata(column.name);
+        thrift::KeyValue advice;
+        advice.key = std::move(key);
+        advice.__set_value(std::move(value));
+        chunk_metadata.push_back(std::move(advice));
+      }
+      auto index = std::move(*column.index).finish();
+      column.index.reset();
+
+      thrift::ColumnMetaData meta;
+      meta.type = thriftType(column.physical_type);
+      meta.encodings = {thrift::Encoding::PLAIN};
+      meta.path_in_schema = {column.name};
+      auto codec = toParquetCodec(column.codec.value_or(options_.codec).codec);
+      if (!codec.ok()) {
+        return codec.status();
+      }
+      meta.codec = *codec;
+      meta.num_values = column.chunk_rows;
+      meta.total_uncompressed_size = column.uncompressed_bytes;
+      meta.total_compressed_size =
+          static_cast<std::int64_t>(column.chunk.size());
+      meta.data_page_offset = chunk_offset;
+      thrift::Statistics statistics;
+      statistics.__set_null_count(0);
+      if (index.min().has_value()) {
+        statistics.__set_min_value(
+            encodeMin(column.physical_type, *index.min()));
+        statistics.__set_max_value(
+            encodeMax(column.physical_type, *index.max()));
+      }
+      meta.__set_statistics(statistics);
+      if (!chunk_metadata.empty()) {
+        meta.__set_key_value_metadata(chunk_metadata);
+      }
+
+      thrift::ColumnChunk chunk;
+      chunk.file_offset = chunk_offset;
+      chunk.__set_meta_data(meta);
+      row_group.columns.push_back(std::move(chunk));
+      row_group.total_byte_size += column.uncompressed_bytes;
+
+      thrift::OffsetIndex offset_index;
+      for (auto page : column.pages) {
+        page.offset += chunk_offset;
+        offset_index.page_locations.push_back(page);
+      }
+      written.push_back({std::move(index), std::move(offset_index)});
+
+      column.chunk.clear();
+      column.codec.reset();
+      column.plain_values.clear();
+      column.pages.clear();
+      column.chunk_rows = 0;
+      column.uncompressed_bytes = 0;
+    }
+    row_group.num_rows = group_rows_;
+    row_group.__set_file_offset(row_group.columns.front().file_offset);
+    row_group.__set_total_compressed_size(position_ -
+                                          row_group.file_offset);
+    row_group.__set_ordinal(static_cast<std::int16_t>(row_groups_.size()));
+    num_rows_ += group_rows_;
+    row_groups_.push_back(std::move(row_group));
+    chunks_.push_back(std::move(written));
+    return startRowGroup();
+  }
+
+  // Bloom filters, column indexes and offset indexes, each kind for all
+  // row groups together, so a reader fetches each kind in one range.
+  Status writeIndexes() {
+    for (std::size_t rg = 0; rg < row_groups_.size(); ++rg) {
+      for (std::size_t col = 0; col < columns_.size(); ++col) {
+        const auto& bloom_filter = chunks_[rg][col].index.bloomFilter();
+        if (!bloom_filter.has_value()) {
+          continue;
+        }
+        row_groups_[rg].columns[col].meta_data.__set_bloom_filter_offset(
+            position_);
+        if (auto status = append(serializeBloomFilter(*bloom_filter));
+            !status.ok()) {
+          return status;
+        }
+      }
+    }
+    for (std::size_t rg = 0; rg < row_groups_.size(); ++rg) {
+      for (std::size_t col = 0; col < columns_.size(); ++col) {
+        auto column_index = toColumnIndex(chunks_[rg][col].index);
+        if (!column_index.has_value()) {
+          continue;
+        }
+        const auto bytes = serializeThrift(*column_index);
+        auto& chunk = row_groups_[rg].columns[col];
+        chunk.__set_column_index_offset(position_);
+        chunk.__set_column_index_length(
+            static_cast<std::int32_t>(bytes.size()));
+        if (auto status = append(bytes); !status.ok()) {
+          return status;
+        }
+      }
+    }
+    for (std::size_t rg = 0; rg < row_groups_.size(); ++rg) {
+      for (std::size_t col = 0; col < columns_.size(); ++col) {
+        const auto bytes = serializeThrift(chunks_[rg][col].offset_index);
+        auto& chunk = row_groups_[rg].columns[col];
+        chunk.__set_offset_index_offset(position_);
+        chunk.__set_offset_index_length(
+            static_cast<std::int32_t>(bytes.size()));
+        if (auto status = append(bytes); !status.ok()) {
+          return status;
+        }
+      }
+    }
+    return Status::OK();
+  }
+
+  thrift::FileMetaData fileMetaData() const {
+    thrift::FileMetaData meta;
+    meta.version = 1;
+    thrift::SchemaElement root;
+    root.name = "schema";
+    root.__set_num_children(static_cast<std::int32_t>(columns_.size()));
+    meta.schema.push_back(root);
+    std::vector<thrift::ColumnOrder> column_orders;
+    for (const auto& column : columns_) {
+      thrift::SchemaElement leaf;
+      leaf.name = column.name;
+      leaf.__set_type(thriftType(column.physical_type));
+      leaf.__set_repetition_type(thrift::FieldRepetitionType::REQUIRED);
+      if (column.physical_type == PhysicalType::kByteArray) {
+        leaf.__set_converted_type(thrift::ConvertedType::UTF8);
+        thrift::LogicalType logical_type;
+        logical_type.__set_STRING(thrift::StringType());
+        leaf.__set_logicalType(logical_type);
+      }
+      meta.schema.push_back(std::move(leaf));
+      // Min and max follow the type's own order: signed for integers,
+      // byte-wise for strings. Readers ignore column index bounds of
+      // columns without one.
+      thrift::ColumnOrder order;
+      order.__set_TYPE_ORDER(thrift::TypeDefinedOrder());
+      column_orders.push_back(order);
+    }
+    meta.num_rows = num_rows_;
+    meta.row_groups = row_groups_;
+    if (!options_.key_value_metadata.empty()) {
+      std::vector<thrift::KeyValue> key_values;
+      for (const auto& [key, value] : options_.key_value_metadata) {
+        thrift::KeyValue key_value;
+        key_value.key = key;
+        key_value.__set_value(value);
+        key_values.push_back(std::move(key_value));
+      }
+      meta.__set_key_value_metadata(key_values);
+    }
+    meta.__set_created_by("halo");
+    meta.__set_column_orders(column_orders);
+    return meta;
+  }
+
+  Status append(std::string_view bytes) {
+    out_.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    if (!out_) {
+      return Status::StorageError("cannot write " + path_.string());
+    }
+    position_ += static_cast<std::int64_t>(bytes.size());
+    return Status::OK();
+  }
+
+  const std::filesystem::path path_;
+  const velox::RowTypePtr type_;
+  const ParquetWriterOptions options_;
+  const std::optional<format::CodecAdvisor> codec_advisor_;
+  const std::optional<format::EncodingAdvisor> advisor_;
+  std::ofstream out_;
+  std::int64_t position_ = 0;
+  std::vector<ColumnWriter> columns_;
+  std::int64_t group_rows_ = 0;
+  std::int64_t num_rows_ = 0;
+  std::vector<thrift::RowGroup> row_groups_;
+  // Per row group, per column.
+  std::vector<std::vector<WrittenChunk>> chunks_;
+  bool closed_ = false;
+};
+
+}  // namespace halo::storage::parquet
@@ -0,0 +1,100 @@
+module;
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <velox/dwio/parquet/thrift/ParquetThriftTypes.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+
+export module halo.storage.parquet:Thrift;
+import halo.common;
+import halo.storage.format;
+
+namespace halo::storage::parquet {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+// Structures of parquet.thrift: footer, page headers, page indexes and bloom
+// filter headers, as generated for Velox's Parquet reader.
+namespace thrift = facebook::velox::parquet::thrift;
+
+using MemoryBuffer = apache::thrift::transport::TMemoryBuffer;
+using CompactProtocol = apache::thrift::protocol::TCompactProtocolT<
+    apache::thrift::transport::TMemoryBuffer>;
+
+// `value' in the compact protocol, the encoding of every Parquet structure.
+export template <typename T>
+std::string serializeThrift(const T& value) {
+  auto buffer = std::make_shared<MemoryBuffer>();
+  CompactProtocol protocol(buffer);
+  value.write(&protocol);
+  return buffer->getBufferAsString();
+}
+
+// Reads `value' from the front of `bytes' and returns how many bytes it
+// took; for a page header, that is where the page body starts.
+export template <typename T>
+StatusOr<std::size_t> deserializeThrift(std::span<const char> bytes,
+                                        T& value) {
+  const auto length = static_cast<std::uint32_t>(std::min<std::size_t>(
+      bytes.size(), std::numeric_limits<std::uint32_t>::max()));
+  auto buffer = std::make_shared<MemoryBuffer>(
+      reinterpret_cast<std::uint8_t*>(const_cast<char*>(bytes.data())),
+      length, MemoryBuffer::OBSERVE);
+  CompactProtocol protocol(buffer);
+  try {
+    value.read(&protocol);
+  } catch (const std::exception& e) {
+    return Status::StorageError(std::string("malformed Parquet metadata: ") +
+                                e.what());
+  }
+  return static_cast<std::size_t>(length - buffer->available_read());
+}
+
+// The Parquet codec of pages compressed with `codec'. zlib output is not
+// the gzip stream Parquet's GZIP means, and lz4hc, xz and bzip2 have no
+// Parquet codec at all.
+export StatusOr<thrift::CompressionCodec::type> toParquetCodec(
+    format::Codec codec) {
+  switch (codec) {
+    case format::Codec::kNone:
+      return thrift::CompressionCodec::UNCOMPRESSED;
+    case format::Codec::kSnappy:
+      return thrift::CompressionCodec::SNAPPY;
+    case format::Codec::kZstd:
+      return thrift::CompressionCodec::ZSTD;
+    case format::Codec::kLz4:
+      // Plain LZ4 blocks, which Parquet calls LZ4_RAW.
+      return thrift::CompressionCodec::LZ4_RAW;
+    default:
+      return Status::Invalid(std::string(format::codecName(codec)) +
+                             " is not a Parquet codec");
+  }
+}
+
+export StatusOr<format::Codec> fromParquetCodec(
+    thrift::CompressionCodec::type codec) {
+  switch (codec) {
+    case thrift::CompressionCodec::UNCOMPRESSED:
+      return format::Codec::kNone;
+    case thrift::CompressionCodec::SNAPPY:
+      return format::Codec::kSnappy;
+    case thrift::CompressionCodec::ZSTD:
+      return format::Codec::kZstd;
+    case thrift::CompressionCodec::LZ4_RAW:
+      return format::Codec::kLz4;
+    default:
+      return Status::NotImplemented("Parquet codec " +
+                                    std::to_string(static_cast<int>(codec)) +
+                                    " is not supported");
+  }
+}
+
+}  // namespace halo::storage::parquet
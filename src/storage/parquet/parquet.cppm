@@ -0,0 +1,5 @@
+export module halo.storage.parquet;
+export import :PageIndex;
+export import :ParquetFile;
+export import :ParquetWriter;
+export import :Thrift;
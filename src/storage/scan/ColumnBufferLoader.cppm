@@ -0,0 +1,346 @@
+module;
+#include <velox/buffer/Buffer.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/StringView.h>
+#include <velox/type/Type.h>
+#include <velox/vector/FlatVector.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+export module halo.storage.scan:ColumnBufferLoader;
+import halo.common;
+import halo.storage.file;
+import halo.storage.format;
+
+namespace halo::storage::scan {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+namespace velox = facebook::velox;
+
+// How column bytes reach Velox buffers. kZeroCopy wraps mapped file pages
+// directly; kCopy always materializes into pool memory.
+export enum class ScanBufferMode : std::uint8_t {
+  kCopy,
+  kZeroCopy,
+};
+
+// One data page of a column chunk, as the reader located it from the page
+// header: the body is `compressed_length' bytes at `offset', just past the
+// header, and `uncompressed_length' bytes once decompressed. The body's
+// first `levels_length' bytes are the repetition and definition levels, the
+// rest plain-encoded values. Levels are skipped, not decoded, so pages must
+// come from non-null, non-repeated columns, where every value is present.
+export struct PageLocation {
+  std::uint64_t offset = 0;
+  std::uint64_t compressed_length = 0;
+  std::uint64_t uncompressed_length = 0;
+  std::uint64_t levels_length = 0;
+  // Parquet DataPage V1 compresses levels together with the values; V2
+  // stores them uncompressed ahead of the compressed values.
+  bool levels_compressed = true;
+  velox::vector_size_t num_values = 0;
+
+  [[nodiscard]] std::uint64_t valuesLength() const {
+    return uncompressed_length - levels_length;
+  }
+};
+
+// The data pages of one column chunk, in row order, under the chunk's codec.
+export struct ColumnChunkLocation {
+  format::Codec codec = format::Codec::kNone;
+  std::vector<PageLocation> pages;
+
+  [[nodiscard]] velox::vector_size_t numValues() const {
+    velox::vector_size_t values = 0;
+    for (const auto& page : pages) {
+      values += page.num_values;
+    }
+    return values;
+  }
+};
+
+export struct ColumnLoadStats {
+  std::uint64_t zero_copy_bytes = 0;
+  std::uint64_t copied_bytes = 0;
+  std::uint64_t decompressed_bytes = 0;
+};
+
+// Keeps the mapping alive for as long as a Velox buffer views it. BufferView
+// copies the releaser, so the shared_ptr copy itself is the reference count;
+// addRef/release have nothing left to do.
+class MappedRegionReleaser {
+ public:
+  explicit MappedRegionReleaser(
+      std::shared_ptr<const file::MappedReadFile> file)
+      : file_(std::move(file)) {}
+
+  void addRef() const {}
+  void release() const {}
+
+ private:
+  std::shared_ptr<const file::MappedReadFile> file_;
+};
+
+// Turns column chunks of a memory-mapped local file into Velox buffers and
+// flat vectors. The values of an uncompressed page are handed to Velox as a
+// view of the mapped pages, whose lifetime is tied to the vectors through
+// the buffer's releaser; compressed pages, and values too misaligned to be
+// viewed as their type, are decompressed or copied into pool memory. A
+// fixed-width chunk of several pages is copied into one buffer, since its
+// pages are separate ranges of the file; a VARCHAR chunk keeps a view per
+// page.
+//
+// Views are marked immutable: the mapping is read-only, so Velox copies
+// such a buffer before its first write instead of writing through it.
+// Zero-copy buffers are backed by the page cache and therefore not charged
+// to the memory pool. Thread-safe.
+export class ColumnBufferLoader final {
+ public:
+  static StatusOr<std::unique_ptr<ColumnBufferLoader>> create(
+      std::shared_ptr<const file::MappedReadFile> file,
+      velox::memory::MemoryPool* pool,
+      ScanBufferMode mode = ScanBufferMode::kZeroCopy) {
+    if (file == nullptr || pool == nullptr) {
+      return Status::Invalid("column buffer loader needs a file and a pool");
+    }
+    return std::unique_ptr<ColumnBufferLoader>(
+        new ColumnBufferLoader(std::move(file), pool, mode));
+  }
+
+  [[nodiscard]] ScanBufferMode mode() const { return mode_; }
+
+  // Uncompressed values of one page. `alignment' is the alignment the
+  // consumer needs to reinterpret them; a mapped range that does not meet it
+  // is copied.
+  StatusOr<velox::BufferPtr> loadPage(const PageLocation& page,
+                                      format::Codec codec,
+                                      std::size_t alignment = 1) const {
+    auto body = pageBody(page, codec);
+    if (!body.ok()) {
+      return body.status();
+    }
+    if (codec != format::Codec::kNone) {
+      return decompress(*body, page, codec);
+    }
+    const auto values = body->subspan(page.levels_length);
+    const auto address = reinterpret_cast<std::uintptr_t>(values.data());
+    if (mode_ == ScanBufferMode::kZeroCopy && address % alignment == 0) {
+      zero_copy_bytes_.fetch_add(values.size(), std::memory_order_relaxed);
+      auto view = velox::BufferView<MappedRegionReleaser>::create(
+          reinterpret_cast<const std::uint8_t*>(values.data()),
+          values.size(), MappedRegionReleaser(file_));
+      view->setIsMutable(false);
+      return view;
+    }
+    auto buffer = velox::AlignedBuffer::allocate<char>(values.size(), pool_);
+    std::memcpy(buffer->asMutable<char>(), values.data(), values.size());
+    copied_bytes_.fetch_add(values.size(), std::memory_order_relaxed);
+    return buffer;
+  }
+
+  // Uncompressed values of the whole chunk in one buffer: the page's own
+  // for a single page, the pages copied together otherwise.
+  StatusOr<velox::BufferPtr> load(const ColumnChunkLocation& chunk,
+                                  std::size_t alignment = 1) const {
+    if (chunk.pages.size() == 1) {
+      return loadPage(chunk.pages.front(), chunk.codec, alignment);
+    }
+    std::uint64_t length = 0;
+    for (const auto& page : chunk.pages) {
+      if (page.levels_length > page.uncompressed_length) {
+        return badPage(page, "levels overrun the page");
+      }
+      length += page.valuesLength();
+    }
+    auto buffer = velox::AlignedBuffer::allocate<char>(length, pool_);
+    auto* cursor = buffer->asMutable<char>();
+    for (const auto& page : chunk.pages) {
+      if (chunk.codec == format::Codec::kNone) {
+        auto body = pageBody(page, chunk.codec);
+        if (!body.ok()) {
+          return body.status();
+        }
+        std::memcpy(cursor, body->data() + page.levels_length,
+                    page.valuesLength());
+        copied_bytes_.fetch_add(page.valuesLength(),
+                                std::memory_order_relaxed);
+      } else {
+        auto values = loadPage(page, chunk.codec);
+        if (!values.ok()) {
+          return values.status();
+        }
+        std::memcpy(cursor, (*values)->as<char>(), (*values)->size());
+      }
+      cursor += page.valuesLength();
+    }
+    return buffer;
+  }
+
+  // Plain-encoded, non-null fixed-width values (BOOLEAN excluded: Parquet
+  // bit-packs it) as a flat vector over the loaded buffer.
+  StatusOr<velox::VectorPtr> loadFixedWidth(
+      const velox::TypePtr& type, const ColumnChunkLocation& chunk) const {
+    switch (type->kind()) {
+      case velox::TypeKind::TINYINT:
+        return loadFlat<std::int8_t>(type, chunk);
+      case velox::TypeKind::SMALLINT:
+        return loadFlat<std::int16_t>(type, chunk);
+      case velox::TypeKind::INTEGER:
+        return loadFlat<std::int32_t>(type, chunk);
+      case velox::TypeKind::BIGINT:
+        return loadFlat<std::int64_t>(type, chunk);
+      case velox::TypeKind::REAL:
+        return loadFlat<float>(type, chunk);
+      case velox::TypeKind::DOUBLE:
+        return loadFlat<double>(type, chunk);
+      default:
+        return Status::NotImplemented("no fixed-width layout for type " +
+                                      type->toString());
+    }
+  }
+
+  // Plain-encoded, non-null BYTE_ARRAY values (4-byte little-endian length
+  // followed by the bytes) as a VARCHAR vector. Only the StringView array is
+  // allocated; non-inlined strings point into each page's loaded buffer,
+  // which the vector keeps among its string buffers.
+  StatusOr<velox::VectorPtr> loadPlainVarchar(
+      const ColumnChunkLocation& chunk) const {
+    const auto num_values = chunk.numValues();
+    auto values =
+        velox::AlignedBuffer::allocate<velox::StringView>(num_values, pool_);
+    auto* views = values->asMutable<velox::StringView>();
+    std::vector<velox::BufferPtr> string_buffers;
+    for (const auto& page : chunk.pages) {
+      auto data = loadPage(page, chunk.codec);
+      if (!data.ok()) {
+        return data.status();
+      }
+      const char* cursor = (*data)->as<char>();
+      const char* const end = cursor + (*data)->size();
+      for (velox::vector_size_t i = 0; i < page.num_values; ++i) {
+        std::uint32_t length = 0;
+        if (end - cursor < static_cast<std::ptrdiff_t>(sizeof(length))) {
+          return badPage(page, "truncated BYTE_ARRAY values");
+        }
+        std::memcpy(&length, cursor, sizeof(length));
+        cursor += sizeof(length);
+        if (static_cast<std::uint64_t>(end - cursor) < length) {
+          return badPage(page, "truncated BYTE_ARRAY values");
+        }
+        *views++ =
+            velox::StringView(cursor, static_cast<std::int32_t>(length));
+        cursor += length;
+      }
+      string_buffers.push_back(std::move(data).value());
+    }
+    return std::static_pointer_cast<velox::BaseVector>(
+        std::make_shared<velox::FlatVector<velox::StringView>>(
+            pool_, velox::VARCHAR(), nullptr, num_values, std::move(values),
+            std::move(string_buffers)));
+  }
+
+  [[nodiscard]] ColumnLoadStats stats() const {
+    return {
+        .zero_copy_bytes = zero_copy_bytes_.load(std::memory_order_relaxed),
+        .copied_bytes = copied_bytes_.load(std::memory_order_relaxed),
+        .decompressed_bytes =
+            decompressed_bytes_.load(std::memory_order_relaxed)};
+  }
+
+ private:
+  ColumnBufferLoader(std::shared_ptr<const file::MappedReadFile> file,
+                     velox::memory::MemoryPool* pool, ScanBufferMode mode)
+      : file_(std::move(file)), pool_(pool), mode_(mode) {}
+
+  // The mapped page body, checked against the page's lengths.
+  StatusOr<std::span<const char>> pageBody(const PageLocation& page,
+                                           format::Codec codec) const {
+    if (page.levels_length > page.uncompressed_length) {
+      return badPage(page, "levels overrun the page");
+    }
+    if (codec == format::Codec::kNone &&
+        page.compressed_length != page.uncompressed_length) {
+      return badPage(page, "uncompressed page with two lengths");
+    }
+    if (!page.levels_compressed &&
+        page.levels_length > page.compressed_length) {
+      return badPage(page, "levels overrun the page");
+    }
+    return file_->view(page.offset, page.compressed_length);
+  }
+
+  StatusOr<velox::BufferPtr> decompress(std::span<const char> body,
+                                        const PageLocation& page,
+                                        format::Codec codec) const {
+    // V1 pages compress the levels too, which are dropped from the front of
+    // the buffer afterwards; V2 pages compress only the values.
+    auto input = body;
+    auto length = page.uncompressed_length;
+    std::uint64_t skip = page.levels_length;
+    if (!page.levels_compressed) {
+      input = body.subspan(page.levels_length);
+      length = page.valuesLength();
+      skip = 0;
+    }
+    auto buffer = velox::AlignedBuffer::allocate<char>(length, pool_);
+    auto status = format::decompressBuffer(
+        {.codec = codec}, input,
+        std::span<char>(buffer->asMutable<char>(), length));
+    if (!status.ok()) {
+      return status;
+    }
+    if (skip > 0) {
+      std::memmove(buffer->asMutable<char>(),
+                   buffer->as<char>() + skip, length - skip);
+      buffer->setSize(length - skip);
+    }
+    decompressed_bytes_.fetch_add(page.uncompressed_length,
+                                  std::memory_order_relaxed);
+    return buffer;
+  }
+
+  template <typename T>
+  StatusOr<velox::VectorPtr> loadFlat(const velox::TypePtr& type,
+                                      const ColumnChunkLocation& chunk) const {
+    auto values = load(chunk, alignof(T));
+    if (!values.ok()) {
+      return values.status();
+    }
+    const auto num_values = chunk.numValues();
+    const auto expected = static_cast<std::uint64_t>(num_values) * sizeof(T);
+    if ((*values)->size() != expected) {
+      return Status::StorageError(
+          "column chunk of " + std::to_string(chunk.pages.size()) +
+          " pages holds " + std::to_string((*values)->size()) +
+          " bytes, expected " + std::to_string(expected) + " for " +
+          type->toString());
+    }
+    return std::static_pointer_cast<velox::BaseVector>(
+        std::make_shared<velox::FlatVector<T>>(
+            pool_, type, nullptr, num_values, std::move(values).value(),
+            std::vector<velox::BufferPtr>{}));
+  }
+
+  static Status badPage(const PageLocation& page, const std::string& what) {
+    return Status::StorageError(what + " in the page at offset " +
+                                std::to_string(page.offset));
+  }
+
+  std::shared_ptr<const file::MappedReadFile> file_;
+  velox::memory::MemoryPool* pool_;
+  ScanBufferMode mode_;
+  mutable std::atomic<std::uint64_t> zero_copy_bytes_{0};
+  mutable std::atomic<std::uint64_t> copied_bytes_{0};
+  mutable std::atomic<std::uint64_t> decompressed_bytes_{0};
+};
+
+}  // namespace halo::storage::scan
@@ -0,0 +1,397 @@
+module;
+#include <velox/common/memory/Memory.h>
+#include <velox/dwio/parquet/thrift/ParquetThriftTypes.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+export module halo.storage.scan:ParquetScan;
+import halo.common;
+import halo.storage.format;
+import halo.storage.parquet;
+import halo.storage.search;
+import :ColumnBufferLoader;
+
+namespace halo::storage::scan {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+using halo::storage::format::ColumnChunkIndex;
+using halo::storage::format::ColumnPredicate;
+using halo::storage::format::PhysicalType;
+using halo::storage::format::RowRange;
+using halo::storage::parquet::ParquetFile;
+
+namespace thrift = facebook::velox::parquet::thrift;
+namespace velox = facebook::velox;
+
+export struct ParquetScanOptions {
+  // Columns to read, in this order; empty reads all of them.
+  std::vector<std::string> columns;
+  // Row groups and pages whose index rules out `filter' on `filter_column'
+  // are skipped. The rows read are a superset of the matching rows: values
+  // the index cannot rule out are returned unfiltered.
+  std::string filter_column;
+  std::optional<ColumnPredicate> filter;
+  // Narrows the rows read to those the column chunk's full-text index
+  // matches; matches close together are read as one range. Chunks without
+  // an index are read whole, as far as `filter' allows.
+  std::optional<search::MatchPredicate> match;
+  ScanBufferMode mode = ScanBufferMode::kZeroCopy;
+};
+
+export struct ParquetScanStats {
+  std::uint64_t row_groups_read = 0;
+  std::uint64_t row_groups_skipped = 0;
+  std::uint64_t pages_read = 0;
+  std::uint64_t rows_read = 0;
+};
+
+// Reads a Parquet file as row vectors, pruning with its page indexes. A
+// filtered scan consults the filter column's index of every row group once:
+// `format::selectRowGroups' drops the row groups whose min/max and bloom
+// filter rule out every predicate value, and `matchingRows' narrows the
+// rest to the row ranges of the pages that may match. A match predicate
+// then intersects those ranges with the rows the column chunk's full-text
+// index matches. Each range becomes one batch, read from only the pages of
+// each column that overlap it.
+//
+// Pages must be plain-encoded; see ColumnBufferLoader. Not thread-safe.
+export class ParquetScan final {
+ public:
+  static StatusOr<std::unique_ptr<ParquetScan>> create(
+      std::shared_ptr<const ParquetFile> file,
+      velox::memory::MemoryPool* pool, ParquetScanOptions options = {}) {
+    if (file == nullptr) {
+      return Status::Invalid("Parquet scan needs a file");
+    }
+    auto loader = ColumnBufferLoader::create(file->file(), pool, options.mode);
+    if (!loader.ok()) {
+      return loader.status();
+    }
+    const auto& file_type = *file->rowType();
+    if (options.columns.empty()) {
+      options.columns = file_type.names();
+    }
+    std::vector<std::size_t> columns;
+    std::vector<velox::TypePtr> types;
+    for (const auto& name : options.columns) {
+      auto column = file->findColumn(name);
+      if (!column.has_value()) {
+        return Status::Invalid("Parquet file has no column '" + name + "'");
+      }
+      columns.push_back(*column);
+      types.push_back(file_type.childAt(*column));
+    }
+    std::unique_ptr<ParquetScan> scan(new ParquetScan(
+        file, std::move(loader).value(), pool, std::move(columns),
+        velox::ROW(std::move(options.columns), std::move(types))));
+    if (auto status = scan->planBatches(options); !status.ok()) {
+      return status;
+    }
+    return scan;
+  }
+
+  [[nodiscard]] const velox::RowTypePtr& outputType() const { return type_; }
+
+  // The rows of the next row range, or nullptr once all were read.
+  StatusOr<velox::RowVectorPtr> next() {
+    if (next_batch_ == batches_.size()) {
+      return velox::RowVectorPtr();
+    }
+    const auto [row_group, rows] = batches_[next_batch_++];
+    if (row_group != offset_indexes_row_group_) {
+      offset_indexes_.clear();
+      for (const auto column : columns_) {
+        auto offset_index = file_->offsetIndex(row_group, column);
+        if (!offset_index.ok()) {
+          return offset_index.status();
+        }
+        offset_indexes_.push_back(std::move(offset_index).value());
+      }
+      offset_indexes_row_group_ = row_group;
+      ++stats_.row_groups_read;
+    }
+    std::vector<velox::VectorPtr> children;
+    for (std::size_t i = 0; i < columns_.size(); ++i) {
+      auto child = readColumn(row_group, i, rows);
+      if (!child.ok()) {
+        return child.status();
+      }
+      children.push_back(std::move(child).value());
+    }
+    stats_.rows_read += static_cast<std::uint64_t>(rows.size());
+    return std::make_shared<velox::RowVector>(
+        pool_, type_, nullptr, static_cast<velox::vector_size_t>(rows.size()),
+        std::move(children));
+  }
+
+  [[nodiscard]] ParquetScanStats stats() const { return stats_; }
+  [[nodiscard]] ColumnLoadStats loadStats() const { return loader_->stats(); }
+
+ private:
+  struct Batch {
+    std::size_t row_group;
+    RowRange rows;
+  };
+
+  static constexpr std::int64_t kMatchGapRows = 1024;
+
+  ParquetScan(std::shared_ptr<const ParquetFile> file,
+              std::unique_ptr<ColumnBufferLoader> loader,
+              velox::memory::MemoryPool* pool,
+              std::vector<std::size_t> columns, velox::RowTypePtr type)
+      : file_(std::move(file)),
+        loader_(std::move(loader)),
+        pool_(pool),
+        columns_(std::move(columns)),
+        type_(std::move(type)) {}
+
+  Status planBatches(const ParquetScanOptions& options) {
+    auto ranges = filterRows(options);
+    if (!ranges.ok()) {
+      return ranges.status();
+    }
+    if (options.match.has_value()) {
+      if (auto status = matchRows(*options.match, *ranges); !status.ok()) {
+        return status;
+      }
+    }
+    for (std::size_t rg = 0; rg < ranges->size(); ++rg) {
+      if ((*ranges)[rg].empty()) {
+        ++stats_.row_groups_skipped;
+      }
+      for (const auto& rows : (*ranges)[rg]) {
+        batches_.push_back({rg, rows});
+      }
+    }
+    return Status::OK();
+  }
+
+  // Per row group, the rows the page indexes of the filter column cannot
+  // rule out.
+  StatusOr<std::vector<std::vector<RowRange>>> filterRows(
+      const ParquetScanOptions& options) const {
+    std::vector<std::vector<RowRange>> ranges(file_->numRowGroups());
+    if (!options.filter.has_value()) {
+      for (std::size_t rg = 0; rg < ranges.size(); ++rg) {
+        if (file_->numRows(rg) > 0) {
+          ranges[rg].push_back({0, file_->numRows(rg)});
+        }
+      }
+      return ranges;
+    }
+    auto column = file_->findColumn(options.filter_column);
+    if (!column.has_value()) {
+      return Status::Invalid("Parquet file has no column '" +
+                             options.filter_column + "' to filter on");
+    }
+    std::vector<ColumnChunkIndex> indexes;
+    for (std::size_t rg = 0; rg < file_->numRowGroups(); ++rg) {
+      auto index = file_->chunkIndex(rg, *column);
+      if (!index.ok()) {
+        return index.status();
+      }
+      indexes.push_back(std::move(index).value());
+    }
+    for (const auto rg : format::selectRowGroups(indexes, *options.filter)) {
+      ranges[rg] = indexes[rg].matchingRows(*options.filter);
+    }
+    return ranges;
+  }
+
+  // Narrows `ranges' to the rows the full-text indexes of `match' hold.
+  Status matchRows(const search::MatchPredicate& match,
+                   std::vector<std::vector<RowRange>>& ranges) const {
+    auto column = file_->findColumn(match.column);
+    if (!column.has_value()) {
+      return Status::Invalid("Parquet file has no column '" + match.column +
+                             "' to match on");
+    }
+    for (std::size_t rg = 0; rg < ranges.size(); ++rg) {
+      if (ranges[rg].empty()) {
+        continue;
+      }
+      auto index = file_->fullTextIndex(rg, *column);
+      if (!index.ok()) {
+        return index.status();
+      }
+      if (!index->has_value()) {
+        continue;
+      }
+      search::FullTextIndexes indexes;
+      indexes.emplace(match.column, std::move(**index));
+      auto rows = search::matchingRows(match, indexes);
+      if (!rows.ok()) {
+        return rows.status();
+      }
+      ranges[rg] = intersect(ranges[rg], coalesce(**rows));
+    }
+    return Status::OK();
+  }
+
+  // Joins ranges fewer than `kMatchGapRows' apart, so that scattered
+  // matches do not each load the pages around them.
+  static std::vector<RowRange> coalesce(const std::vector<RowRange>& ranges) {
+    std::vector<RowRange> joined;
+    for (const auto& range : ranges) {
+      if (!joined.empty() && range.begin - joined.back().end < kMatchGapRows) {
+        joined.back().end = range.end;
+      } else {
+        joined.push_back(range);
+      }
+    }
+    return joined;
+  }
+
+  // Rows in both `a' and `b', each sorted and disjoint.
+  static std::vector<RowRange> intersect(const std::vector<RowRange>& a,
+                                         const std::vector<RowRange>& b) {
+    std::vector<RowRange> rows;
+    std::size_t i = 0;
+    std::size_t j = 0;
+    while (i < a.size() && j < b.size()) {
+      const auto begin = std::max(a[i].begin, b[j].begin);
+      const auto end = std::min(a[i].end, b[j].end);
+      if (begin < end) {
+        rows.push_back({begin, end});
+      }
+      if (a[i].end < b[j].end) {
+        ++i;
+      } else {
+        ++j;
+      }
+    }
+    return rows;
+  }
+
+  // The values of `rows' in output column `i', loaded from the pages that
+  // overlap them.
+  StatusOr<velox::VectorPtr> readColumn(std::size_t row_group, std::size_t i,
+                                        const RowRange& rows) {
+    const auto column = columns_[i];
+    const auto& meta = file_->columnMetaData(row_group, column);
+    auto codec = parquet::fromParquetCodec(meta.codec);
+    if (!codec.ok()) {
+      return codec.status();
+    }
+    ColumnChunkLocation chunk{.codec = *codec};
+    std::optional<std::int64_t> first_row;
+    const auto& pages = offset_indexes_[i].page_locations;
+    for (std::size_t p = 0; p < pages.size(); ++p) {
+      const auto begin = pages[p].first_row_index;
+      const auto end = p + 1 < pages.size() ? pages[p + 1].first_row_index
+                                            : file_->numRows(row_group);
+      if (end <= rows.begin || begin >= rows.end) {
+        continue;
+      }
+      auto page = locatePage(pages[p], *codec);
+      if (!page.ok()) {
+        return page.status();
+      }
+      chunk.pages.push_back(*page);
+      first_row = first_row.value_or(begin);
+    }
+    if (!first_row.has_value()) {
+      return Status::StorageError("no page of column '" +
+                                  type_->nameOf(i) + "' holds row " +
+                                  std::to_string(rows.begin));
+    }
+    stats_.pages_read += chunk.pages.size();
+    const auto& type = type_->childAt(i);
+    auto values = file_->physicalType(column) == PhysicalType::kByteArray
+                      ? loader_->loadPlainVarchar(chunk)
+                      : loader_->loadFixedWidth(type, chunk);
+    if (!values.ok()) {
+      return values.status();
+    }
+    const auto offset =
+        static_cast<velox::vector_size_t>(rows.begin - *first_row);
+    const auto length = static_cast<velox::vector_size_t>(rows.size());
+    if ((*values)->size() < offset + length) {
+      return Status::StorageError("pages of column '" + type_->nameOf(i) +
+                                  "' hold fewer rows than their index says");
+    }
+    if (offset == 0 && (*values)->size() == length) {
+      return values;
+    }
+    return (*values)->slice(offset, length);
+  }
+
+  // Where the values of the page at `location' are, from its header.
+  StatusOr<PageLocation> locatePage(const thrift::PageLocation& location,
+                                    format::Codec codec) const {
+    auto bytes = file_->file()->view(
+        static_cast<std::uint64_t>(location.offset),
+        static_cast<std::uint64_t>(location.compressed_page_size));
+    if (!bytes.ok()) {
+      return bytes.status();
+    }
+    thrift::PageHeader header;
+    auto header_bytes = parquet::deserializeThrift(*bytes, header);
+    if (!header_bytes.ok()) {
+      return header_bytes.status();
+    }
+    PageLocation page{
+        .offset = static_cast<std::uint64_t>(location.offset) + *header_bytes,
+        .compressed_length =
+            static_cast<std::uint64_t>(header.compressed_page_size),
+        .uncompressed_length =
+            static_cast<std::uint64_t>(header.uncompressed_page_size)};
+    thrift::Encoding::type encoding;
+    if (header.type == thrift::PageType::DATA_PAGE) {
+      // REQUIRED, non-nested columns have no levels.
+      encoding = header.data_page_header.encoding;
+      page.num_values = header.data_page_header.num_values;
+    } else if (header.type == thrift::PageType::DATA_PAGE_V2) {
+      const auto& v2 = header.data_page_header_v2;
+      if (v2.__isset.is_compressed && !v2.is_compressed &&
+          codec != format::Codec::kNone) {
+        return Status::NotImplemented(
+            "uncompressed pages in a compressed column chunk");
+      }
+      encoding = v2.encoding;
+      page.num_values = v2.num_values;
+      page.levels_length = static_cast<std::uint64_t>(
+          v2.definition_levels_byte_length +
+          v2.repetition_levels_byte_length);
+      page.levels_compressed = false;
+    } else {
+      return Status::NotImplemented(
+          "page of type " + std::to_string(static_cast<int>(header.type)) +
+          " at offset " + std::to_string(location.offset));
+    }
+    if (encoding != thrift::Encoding::PLAIN) {
+      return Status::NotImplemented(
+          "page encoding " + std::to_string(static_cast<int>(encoding)) +
+          " at offset " + std::to_string(location.offset) +
+          "; only PLAIN pages are read");
+    }
+    return page;
+  }
+
+  const std::shared_ptr<const ParquetFile> file_;
+  const std::unique_ptr<ColumnBufferLoader> loader_;
+  velox::memory::MemoryPool* const pool_;
+  // File ordinals of the output columns.
+  const std::vector<std::size_t> columns_;
+  const velox::RowTypePtr type_;
+  std::vector<Batch> batches_;
+  std::size_t next_batch_ = 0;
+  // Offset indexes of the output columns in the row group being read.
+  std::vector<thrift::OffsetIndex> offset_indexes_;
+  std::size_t offset_indexes_row_group_ =
+      std::numeric_limits<std::size_t>::max();
+  ParquetScanStats stats_;
+};
+
+}  // namespace halo::storage::scan
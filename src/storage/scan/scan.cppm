@@ -0,0 +1,3 @@
+export module halo.storage.scan;
+export import :ColumnBufferLoader;
+export import :ParquetScan;
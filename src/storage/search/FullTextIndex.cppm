@@ -0,0 +1,332 @@
+module;
+#include <velox/type/StringView.h>
+#include <velox/vector/BaseVector.h>
+#include <velox/vector/DecodedVector.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+export module halo.storage.search:FullTextIndex;
+import halo.common;
+import halo.storage.format;
+import :PostingList;
+import :TextAnalyzer;
+import :TextQuery;
+
+namespace halo::storage::search {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+using halo::storage::format::RowRange;
+
+namespace velox = facebook::velox;
+
+export class FullTextIndexBuilder;
+
+// Inverted index of one VARCHAR column chunk: for every term, the rows
+// containing it. Immutable and thread-safe once built. ParquetWriter stores
+// the serialized index right after the chunk's pages.
+export class FullTextIndex final {
+ public:
+  // Reads an index `serialize' wrote.
+  static StatusOr<FullTextIndex> deserialize(std::span<const char> bytes) {
+    const auto corrupt = [] {
+      return Status::StorageError("corrupt full-text index");
+    };
+    FieldReader in(bytes);
+    std::uint32_t version = 0;
+    if (!in.read(version)) {
+      return corrupt();
+    }
+    if (version != kFormatVersion) {
+      return Status::NotImplemented("full-text index format version " +
+                                    std::to_string(version));
+    }
+    TextAnalyzerOptions options;
+    std::uint8_t strip_accents = 0;
+    std::uint64_t max_term_bytes = 0;
+    std::uint32_t rows = 0;
+    std::uint64_t terms = 0;
+    if (!in.read(options.locale) || !in.read(options.stemmer) ||
+        !in.read(strip_accents) || !in.read(max_term_bytes) ||
+        !in.read(rows) || !in.read(terms)) {
+      return corrupt();
+    }
+    options.strip_accents = strip_accents != 0;
+    options.max_term_bytes = max_term_bytes;
+    std::unordered_map<std::string, PostingList> postings;
+    for (std::uint64_t i = 0; i < terms; ++i) {
+      std::string term;
+      if (!in.read(term)) {
+        return corrupt();
+      }
+      auto list = PostingList::deserialize(in);
+      if (!list.ok()) {
+        return list.status();
+      }
+      postings.emplace(std::move(term), std::move(list).value());
+    }
+    if (in.remaining() != 0) {
+      return corrupt();
+    }
+    return FullTextIndex(std::move(options), std::move(postings), rows);
+  }
+
+  // The analyzer options, then every term with its postings, in term order
+  // so that equal indexes serialize to equal bytes.
+  [[nodiscard]] std::string serialize() const {
+    std::string out;
+    appendField(out, kFormatVersion);
+    appendField(out, options_.locale);
+    appendField(out, options_.stemmer);
+    appendField(out, static_cast<std::uint8_t>(options_.strip_accents));
+    appendField(out, static_cast<std::uint64_t>(options_.max_term_bytes));
+    appendField(out, rows_);
+    appendField(out, static_cast<std::uint64_t>(postings_.size()));
+    std::vector<const std::pair<const std::string, PostingList>*> terms;
+    terms.reserve(postings_.size());
+    for (const auto& entry : postings_) {
+      terms.push_back(&entry);
+    }
+    std::sort(terms.begin(), terms.end(), [](const auto* a, const auto* b) {
+      return a->first < b->first;
+    });
+    for (const auto* entry : terms) {
+      appendField(out, entry->first);
+      entry->second.serialize(out);
+    }
+    return out;
+  }
+
+  // Rows matching `query', in increasing order.
+  [[nodiscard]] StatusOr<std::vector<std::uint32_t>> search(
+      std::string_view query) const {
+    auto analyzer = takeAnalyzer();
+    if (!analyzer.ok()) {
+      return analyzer.status();
+    }
+    auto rows = search(TextQuery::parse(query, **analyzer));
+    std::lock_guard lock(analyzers_->mutex);
+    analyzers_->idle.push_back(std::move(analyzer).value());
+    return rows;
+  }
+
+  [[nodiscard]] std::vector<std::uint32_t> search(
+      const TextQuery& query) const {
+    std::vector<std::uint32_t> rows;
+    for (const auto& alternative : query.alternatives()) {
+      auto matches = intersect(alternative);
+      if (rows.empty()) {
+        rows = std::move(matches);
+        continue;
+      }
+      std::vector<std::uint32_t> merged;
+      merged.reserve(rows.size() + matches.size());
+      std::set_union(rows.begin(), rows.end(), matches.begin(), matches.end(),
+                     std::back_inserter(merged));
+      rows = std::move(merged);
+    }
+    return rows;
+  }
+
+  // The rows matching `query' as coalesced ranges, the form the scan's
+  // other row filters (page zone maps) hand to the reader.
+  [[nodiscard]] StatusOr<std::vector<RowRange>> matchingRows(
+      std::string_view query) const {
+    auto rows = search(query);
+    if (!rows.ok()) {
+      return rows.status();
+    }
+    std::vector<RowRange> ranges;
+    for (const auto row : *rows) {
+      if (!ranges.empty() && ranges.back().end == row) {
+        ++ranges.back().end;
+      } else {
+        ranges.push_back({.begin = row, .end = row + std::int64_t{1}});
+      }
+    }
+    return ranges;
+  }
+
+  // Postings of `term' as the analyzer produces it, or null.
+  [[nodiscard]] const PostingList* postings(const std::string& term) const {
+    const auto it = postings_.find(term);
+    return it == postings_.end() ? nullptr : &it->second;
+  }
+
+  [[nodiscard]] std::uint32_t rows() const { return rows_; }
+
+  [[nodiscard]] std::size_t terms() const { return postings_.size(); }
+
+  // Encoded size of all posting lists.
+  [[nodiscard]] std::size_t postingBytes() const {
+    std::size_t bytes = 0;
+    for (const auto& [term, list] : postings_) {
+      bytes += list.bytes();
+    }
+    return bytes;
+  }
+
+  [[nodiscard]] const TextAnalyzerOptions& options() const {
+    return options_;
+  }
+
+ private:
+  friend class FullTextIndexBuilder;
+
+  static constexpr std::uint32_t kFormatVersion = 1;
+
+  // Analyzers not in use by a search(), kept as MatchFunction keeps its
+  // own: building one costs more than analyzing a query.
+  struct AnalyzerPool {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TextAnalyzer>> idle;
+  };
+
+  FullTextIndex(TextAnalyzerOptions options,
+                std::unordered_map<std::string, PostingList> postings,
+                std::uint32_t rows)
+      : options_(std::move(options)),
+        postings_(std::move(postings)),
+        rows_(rows),
+        analyzers_(std::make_unique<AnalyzerPool>()) {}
+
+  StatusOr<std::unique_ptr<TextAnalyzer>> takeAnalyzer() const {
+    {
+      std::lock_guard lock(analyzers_->mutex);
+      if (!analyzers_->idle.empty()) {
+        auto analyzer = std::move(analyzers_->idle.back());
+        analyzers_->idle.pop_back();
+        return analyzer;
+      }
+    }
+    auto analyzer = TextAnalyzer::create(options_);
+    if (!analyzer.ok()) {
+      return analyzer.status();
+    }
+    return std::make_unique<TextAnalyzer>(std::move(analyzer).value());
+  }
+
+  // Rows containing every one of `terms'. Walks the shortest list and
+  // seeks the others past the blocks that cannot hold its rows.
+  [[nodiscard]] std::vector<std::uint32_t> intersect(
+      const std::vector<std::string>& terms) const {
+    std::vector<const PostingList*> lists;
+    for (const auto& term : terms) {
+      const auto* list = postings(term);
+      if (list == nullptr) {
+        return {};
+      }
+      lists.push_back(list);
+    }
+    std::sort(lists.begin(), lists.end(), [](const auto* a, const auto* b) {
+      return a->size() < b->size();
+    });
+    std::vector<PostingList::Cursor> cursors;
+    cursors.reserve(lists.size());
+    for (const auto* list : lists) {
+      cursors.emplace_back(*list);
+    }
+
+    std::vector<std::uint32_t> rows;
+    auto& lead = cursors.front();
+    while (!lead.done()) {
+      const auto candidate = lead.row();
+      bool everywhere = true;
+      for (std::size_t i = 1; i < cursors.size(); ++i) {
+        cursors[i].seek(candidate);
+        if (cursors[i].done()) {
+          return rows;
+        }
+        if (cursors[i].row() != candidate) {
+          lead.seek(cursors[i].row());
+          everywhere = false;
+          break;
+        }
+      }
+      if (everywhere) {
+        rows.push_back(candidate);
+        lead.next();
+      }
+    }
+    return rows;
+  }
+
+  TextAnalyzerOptions options_;
+  std::unordered_map<std::string, PostingList> postings_;
+  std::uint32_t rows_;
+  // At most one analyzer per concurrent search().
+  std::unique_ptr<AnalyzerPool> analyzers_;
+};
+
+// Builds the index of a column chunk from its values in row order. NULLs
+// take a row number but contain no terms.
+export class FullTextIndexBuilder final {
+ public:
+  static StatusOr<FullTextIndexBuilder> create(
+      const TextAnalyzerOptions& options = {}) {
+    auto analyzer = TextAnalyzer::create(options);
+    if (!analyzer.ok()) {
+      return analyzer.status();
+    }
+    return FullTextIndexBuilder(std::move(analyzer).value());
+  }
+
+  void append(std::string_view text) {
+    terms_.clear();
+    analyzer_.analyze(
+        text, [&](std::string term) { terms_.push_back(std::move(term)); });
+    uniqueTerms(terms_);
+    for (auto& term : terms_) {
+      postings_[std::move(term)].push_back(rows_);
+    }
+    ++rows_;
+  }
+
+  void appendNull() { ++rows_; }
+
+  // Appends every row of a VARCHAR vector.
+  void append(const velox::BaseVector& column) {
+    const velox::DecodedVector decoded(column);
+    for (velox::vector_size_t row = 0; row < column.size(); ++row) {
+      if (decoded.isNullAt(row)) {
+        appendNull();
+      } else {
+        const auto value = decoded.valueAt<velox::StringView>(row);
+        append(std::string_view(value.data(), value.size()));
+      }
+    }
+  }
+
+  FullTextIndex build() {
+    std::unordered_map<std::string, PostingList> postings;
+    postings.reserve(postings_.size());
+    for (auto& [term, rows] : postings_) {
+      postings.emplace(term, PostingList::encode(rows));
+    }
+    postings_.clear();
+    return FullTextIndex(analyzer_.options(), std::move(postings),
+                         std::exchange(rows_, 0));
+  }
+
+ private:
+  explicit FullTextIndexBuilder(TextAnalyzer analyzer)
+      : analyzer_(std::move(analyzer)) {}
+
+  TextAnalyzer analyzer_;
+  std::unordered_map<std::string, std::vector<std::uint32_t>> postings_;
+  std::vector<std::string> terms_;
+  std::uint32_t rows_ = 0;
+};
+
+}  // namespace halo::storage::search
@@ -0,0 +1,246 @@
+module;
+#include <velox/expression/DecodedArgs.h>
+#include <velox/expression/EvalCtx.h>
+#include <velox/expression/FunctionSignature.h>
+#include <velox/expression/VectorFunction.h>
+#include <velox/type/StringView.h>
+#include <velox/type/Type.h>
+#include <velox/vector/BaseVector.h>
+#include <velox/vector/ConstantVector.h>
+#include <velox/vector/FlatVector.h>
+#include <velox/vector/SelectivityVector.h>
+
+#include <cctype>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+export module halo.storage.search:MatchPredicate;
+import halo.common;
+import halo.storage.format;
+import :FullTextIndex;
+import :TextAnalyzer;
+import :TextQuery;
+
+namespace halo::storage::search {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+using halo::storage::format::RowRange;
+
+namespace velox = facebook::velox;
+
+// Full-text predicate `match(column, 'query')' of a scan filter.
+export struct MatchPredicate {
+  std::string column;
+  std::string query;
+
+  // Parses `match(column, 'query')'. The column may be double-quoted, and a
+  // quote inside the query is written twice, as in SQL literals.
+  static StatusOr<MatchPredicate> parse(std::string_view expression) {
+    std::size_t position = 0;
+    const auto skipSpace = [&] {
+      while (position < expression.size() &&
+             std::isspace(static_cast<unsigned char>(expression[position]))) {
+        ++position;
+      }
+    };
+    const auto consume = [&](char expected) {
+      skipSpace();
+      if (position < expression.size() && expression[position] == expected) {
+        ++position;
+        return true;
+      }
+      return false;
+    };
+    // Reads a literal quoted with `quote' whose opening quote is consumed.
+    const auto quoted = [&](char quote) -> std::optional<std::string> {
+      std::string literal;
+      while (position < expression.size()) {
+        const char c = expression[position++];
+        if (c != quote) {
+          literal.push_back(c);
+        } else if (position < expression.size() &&
+                   expression[position] == quote) {
+          literal.push_back(quote);
+          ++position;
+        } else {
+          return literal;
+        }
+      }
+      return std::nullopt;
+    };
+    const auto invalid = [&](const std::string& what) {
+      return Status::Invalid("expected " + what + " at offset " +
+                             std::to_string(position) + " of `" +
+                             std::string(expression) + "'");
+    };
+
+    skipSpace();
+    constexpr std::string_view kName = "match";
+    if (expression.size() - position < kName.size()) {
+      return invalid("`match'");
+    }
+    for (const char c : kName) {
+      if (std::tolower(static_cast<unsigned char>(expression[position])) !=
+          c) {
+        return invalid("`match'");
+      }
+      ++position;
+    }
+    if (!consume('(')) {
+      return invalid("`('");
+    }
+
+    MatchPredicate predicate;
+    skipSpace();
+    if (consume('"')) {
+      auto column = quoted('"');
+      if (!column.has_value() || column->empty()) {
+        return invalid("a column name");
+      }
+      predicate.column = std::move(*column);
+    } else {
+      while (position < expression.size() &&
+             (std::isalnum(static_cast<unsigned char>(expression[position])) ||
+              expression[position] == '_')) {
+        predicate.column.push_back(expression[position++]);
+      }
+      if (predicate.column.empty()) {
+        return invalid("a column name");
+      }
+    }
+    if (!consume(',')) {
+      return invalid("`,'");
+    }
+    if (!consume('\'')) {
+      return invalid("a quoted query");
+    }
+    auto query = quoted('\'');
+    if (!query.has_value()) {
+      return invalid("the closing quote of the query");
+    }
+    predicate.query = std::move(*query);
+    if (!consume(')')) {
+      return invalid("`)'");
+    }
+    skipSpace();
+    if (position != expression.size()) {
+      return invalid("the end of the predicate");
+    }
+    return predicate;
+  }
+};
+
+// Indexes of a column chunk's VARCHAR columns, by column name.
+export using FullTextIndexes = std::map<std::string, FullTextIndex>;
+
+// Answers `predicate' for a column chunk from the index of its column.
+// Returns nullopt when the column has no index, in which case the caller
+// reads every row and filters with the `match' function instead.
+export StatusOr<std::optional<std::vector<RowRange>>> matchingRows(
+    const MatchPredicate& predicate, const FullTextIndexes& indexes) {
+  const auto it = indexes.find(predicate.column);
+  if (it == indexes.end()) {
+    return std::optional<std::vector<RowRange>>();
+  }
+  auto ranges = it->second.matchingRows(predicate.query);
+  if (!ranges.ok()) {
+    return ranges.status();
+  }
+  return std::optional<std::vector<RowRange>>(std::move(ranges).value());
+}
+
+// match(varchar, constant varchar) -> boolean, evaluated row by row with
+// the analyzer the indexes are built with. Gives the same answer as the
+// index, for chunks that have none.
+//
+// Building an analyzer opens ICU's break iterator and a Snowball stemmer,
+// which costs more than analyzing a batch of short values, so analyzers
+// are kept across calls. One instance serves every thread evaluating the
+// function; each apply() takes an analyzer to itself.
+class MatchFunction final : public velox::exec::VectorFunction {
+ public:
+  explicit MatchFunction(TextAnalyzerOptions options)
+      : options_(std::move(options)) {}
+
+  void apply(const velox::SelectivityVector& rows,
+             std::vector<velox::VectorPtr>& args,
+             const velox::TypePtr& /*outputType*/,
+             velox::exec::EvalCtx& context,
+             velox::VectorPtr& result) const override {
+    VELOX_USER_CHECK(args[1]->isConstantEncoding(),
+                     "match() needs a constant query");
+    if (args[1]->isNullAt(0)) {
+      context.moveOrCopyResult(
+          velox::BaseVector::createNullConstant(velox::BOOLEAN(), rows.end(),
+                                                context.pool()),
+          rows, result);
+      return;
+    }
+    auto analyzer = takeAnalyzer();
+    const auto query_text =
+        args[1]->as<velox::ConstantVector<velox::StringView>>()->valueAt(0);
+    const auto query = TextQuery::parse(
+        std::string_view(query_text.data(), query_text.size()), *analyzer);
+
+    velox::exec::DecodedArgs decoded_args(rows, args, context);
+    const auto* text = decoded_args.at(0);
+    context.ensureWritable(rows, velox::BOOLEAN(), result);
+    auto* matches = result->asUnchecked<velox::FlatVector<bool>>();
+    std::vector<std::string> terms;
+    rows.applyToSelected([&](velox::vector_size_t row) {
+      if (text->isNullAt(row)) {
+        matches->setNull(row, true);
+        return;
+      }
+      const auto value = text->valueAt<velox::StringView>(row);
+      terms = analyzer->analyze(std::string_view(value.data(), value.size()));
+      uniqueTerms(terms);
+      matches->set(row, query.matches(terms));
+    });
+    // An apply() that threw drops its analyzer, whatever state it was in.
+    std::lock_guard lock(mutex_);
+    idle_.push_back(std::move(analyzer));
+  }
+
+ private:
+  std::unique_ptr<TextAnalyzer> takeAnalyzer() const {
+    {
+      std::lock_guard lock(mutex_);
+      if (!idle_.empty()) {
+        auto analyzer = std::move(idle_.back());
+        idle_.pop_back();
+        return analyzer;
+      }
+    }
+    auto analyzer = TextAnalyzer::create(options_);
+    VELOX_USER_CHECK(analyzer.ok(), analyzer.status().toString());
+    return std::make_unique<TextAnalyzer>(std::move(analyzer).value());
+  }
+
+  const TextAnalyzerOptions options_;
+  mutable std::mutex mutex_;
+  // Analyzers not in use by an apply(); at most one per concurrent call.
+  mutable std::vector<std::unique_ptr<TextAnalyzer>> idle_;
+};
+
+// Registers the `match' function under `name'.
+export void registerMatchFunction(const std::string& name = "match",
+                                  const TextAnalyzerOptions& options = {}) {
+  velox::exec::registerVectorFunction(
+      name,
+      {velox::exec::FunctionSignatureBuilder()
+           .returnType("boolean")
+           .argumentType("varchar")
+           .constantArgumentType("varchar")
+           .build()},
+      std::make_unique<MatchFunction>(options));
+}
+
+}  // namespace halo::storage::search
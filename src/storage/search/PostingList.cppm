@@ -0,0 +1,305 @@
+module;
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+export module halo.storage.search:PostingList;
+import halo.common;
+
+namespace halo::storage::search {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+// Little-endian fields of the serialized index.
+template <typename T>
+void appendField(std::string& out, T value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  char bytes[sizeof(T)];
+  std::memcpy(bytes, &value, sizeof(T));
+  out.append(bytes, sizeof(T));
+}
+
+void appendField(std::string& out, const std::string& value) {
+  appendField(out, static_cast<std::uint64_t>(value.size()));
+  out.append(value);
+}
+
+// Reads what appendField wrote, failing instead of reading past the end.
+class FieldReader final {
+ public:
+  explicit FieldReader(std::span<const char> bytes) : bytes_(bytes) {}
+
+  template <typename T>
+  bool read(T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (bytes_.size() < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(&value, bytes_.data(), sizeof(T));
+    bytes_ = bytes_.subspan(sizeof(T));
+    return true;
+  }
+
+  bool read(std::string& value) {
+    std::uint64_t size = 0;
+    if (!read(size) || bytes_.size() < size) {
+      return false;
+    }
+    value.assign(bytes_.data(), size);
+    bytes_ = bytes_.subspan(size);
+    return true;
+  }
+
+  [[nodiscard]] std::size_t remaining() const { return bytes_.size(); }
+
+ private:
+  std::span<const char> bytes_;
+};
+
+// Sorted row numbers of the rows containing one term, in blocks of
+// `kBlockSize'. Each block keeps its first and last row uncompressed, for
+// skipping, and the gaps between consecutive rows (minus one) bit-packed at
+// the width of the largest gap in the block.
+export class PostingList final {
+ public:
+  static constexpr std::size_t kBlockSize = 128;
+
+  // `rows' must be strictly increasing.
+  static PostingList encode(std::span<const std::uint32_t> rows) {
+    PostingList list;
+    list.size_ = rows.size();
+    for (std::size_t begin = 0; begin < rows.size(); begin += kBlockSize) {
+      const auto block = rows.subspan(
+          begin, std::min(kBlockSize, rows.size() - begin));
+      std::uint32_t widest = 0;
+      for (std::size_t i = 1; i < block.size(); ++i) {
+        widest |= block[i] - block[i - 1] - 1;
+      }
+      const auto width = static_cast<std::uint8_t>(std::bit_width(widest));
+      list.blocks_.push_back({.first = block.front(),
+                              .last = block.back(),
+                              .offset = list.words_.size(),
+                              .count = static_cast<std::uint32_t>(block.size()),
+                              .width = width});
+      pack(block, width, list.words_);
+    }
+    list.words_.shrink_to_fit();
+    return list;
+  }
+
+  // Appends the blocks and packed gaps as they are held in memory.
+  void serialize(std::string& out) const {
+    appendField(out, static_cast<std::uint64_t>(size_));
+    appendField(out, static_cast<std::uint64_t>(blocks_.size()));
+    for (const auto& block : blocks_) {
+      appendField(out, block.first);
+      appendField(out, block.last);
+      appendField(out, static_cast<std::uint64_t>(block.offset));
+      appendField(out, block.count);
+      appendField(out, block.width);
+    }
+    appendField(out, static_cast<std::uint64_t>(words_.size()));
+    for (const auto word : words_) {
+      appendField(out, word);
+    }
+  }
+
+  // Reads a list `serialize' wrote. The block layout is checked, so that
+  // decoding a corrupt list yields wrong rows at worst, never reads out of
+  // bounds.
+  static StatusOr<PostingList> deserialize(FieldReader& in) {
+    const auto corrupt = [] {
+      return Status::StorageError("corrupt posting list");
+    };
+    PostingList list;
+    std::uint64_t size = 0;
+    std::uint64_t blocks = 0;
+    // A serialized block takes 21 bytes; checking the count against the
+    // input keeps a corrupt one from sizing a huge allocation.
+    if (!in.read(size) || !in.read(blocks) ||
+        blocks != (size + kBlockSize - 1) / kBlockSize ||
+        blocks > in.remaining() / 21) {
+      return corrupt();
+    }
+    list.size_ = size;
+    list.blocks_.resize(blocks);
+    for (std::size_t b = 0; b < blocks; ++b) {
+      auto& block = list.blocks_[b];
+      std::uint64_t offset = 0;
+      if (!in.read(block.first) || !in.read(block.last) ||
+          !in.read(offset) || !in.read(block.count) ||
+          !in.read(block.width)) {
+        return corrupt();
+      }
+      block.offset = offset;
+      const auto expected =
+          b + 1 < blocks ? kBlockSize : size - b * kBlockSize;
+      if (block.count != expected || block.width > 32) {
+        return corrupt();
+      }
+    }
+    std::uint64_t words = 0;
+    if (!in.read(words) ||
+        words > in.remaining() / sizeof(std::uint64_t)) {
+      return corrupt();
+    }
+    for (const auto& block : list.blocks_) {
+      const auto bits =
+          static_cast<std::uint64_t>(block.count - 1) * block.width;
+      if (block.offset > words || (bits + 63) / 64 > words - block.offset) {
+        return corrupt();
+      }
+    }
+    list.words_.resize(words);
+    for (auto& word : list.words_) {
+      if (!in.read(word)) {
+        return corrupt();
+      }
+    }
+    return list;
+  }
+
+  // Number of rows.
+  [[nodiscard]] std::size_t size() const { return size_; }
+
+  // Size of the encoded rows, skip entries included.
+  [[nodiscard]] std::size_t bytes() const {
+    return words_.size() * sizeof(std::uint64_t) +
+           blocks_.size() * sizeof(Block);
+  }
+
+  [[nodiscard]] std::vector<std::uint32_t> decode() const {
+    std::vector<std::uint32_t> rows(size_);
+    for (std::size_t b = 0; b < blocks_.size(); ++b) {
+      decodeBlock(b, rows.data() + b * kBlockSize);
+    }
+    return rows;
+  }
+
+  // Forward iterator over the rows that decodes one block at a time and
+  // skips whole blocks on `seek'.
+  class Cursor final {
+   public:
+    explicit Cursor(const PostingList& list) : list_(&list) {
+      load(0);
+    }
+
+    [[nodiscard]] bool done() const { return block_ >= list_->blocks_.size(); }
+
+    // Current row; only valid while not `done'.
+    [[nodiscard]] std::uint32_t row() const { return rows_[position_]; }
+
+    void next() {
+      if (++position_ >= list_->blocks_[block_].count) {
+        load(block_ + 1);
+      }
+    }
+
+    // Moves to the first row at or after `target'.
+    void seek(std::uint32_t target) {
+      if (done() || row() >= target) {
+        return;
+      }
+      const auto& blocks = list_->blocks_;
+      if (blocks[block_].last < target) {
+        const auto it = std::lower_bound(
+            blocks.begin() + static_cast<std::ptrdiff_t>(block_ + 1),
+            blocks.end(), target,
+            [](const Block& block, std::uint32_t value) {
+              return block.last < value;
+            });
+        load(static_cast<std::size_t>(it - blocks.begin()));
+        if (done()) {
+          return;
+        }
+      }
+      const auto* begin = rows_.data() + position_;
+      const auto* end = rows_.data() + blocks[block_].count;
+      position_ = static_cast<std::size_t>(
+          std::lower_bound(begin, end, target) - rows_.data());
+    }
+
+   private:
+    void load(std::size_t block) {
+      block_ = block;
+      position_ = 0;
+      if (!done()) {
+        list_->decodeBlock(block_, rows_.data());
+      }
+    }
+
+    const PostingList* list_;
+    std::size_t block_ = 0;
+    std::size_t position_ = 0;
+    std::array<std::uint32_t, kBlockSize> rows_{};
+  };
+
+ private:
+  struct Block {
+    std::uint32_t first;
+    std::uint32_t last;
+    std::size_t offset;
+    std::uint32_t count;
+    std::uint8_t width;
+  };
+
+  static void pack(std::span<const std::uint32_t> block, std::uint8_t width,
+                   std::vector<std::uint64_t>& words) {
+    if (width == 0) {
+      return;
+    }
+    std::uint64_t word = 0;
+    unsigned used = 0;
+    for (std::size_t i = 1; i < block.size(); ++i) {
+      const std::uint64_t gap = block[i] - block[i - 1] - 1;
+      word |= gap << used;
+      used += width;
+      if (used >= 64) {
+        words.push_back(word);
+        used -= 64;
+        word = used == 0 ? 0 : gap >> (width - used);
+      }
+    }
+    if (used > 0) {
+      words.push_back(word);
+    }
+  }
+
+  void decodeBlock(std::size_t b, std::uint32_t* rows) const {
+    const auto& block = blocks_[b];
+    rows[0] = block.first;
+    if (block.width == 0) {
+      // Consecutive rows.
+      for (std::uint32_t i = 1; i < block.count; ++i) {
+        rows[i] = block.first + i;
+      }
+      return;
+    }
+    const auto* words = words_.data() + block.offset;
+    const std::uint64_t mask = (std::uint64_t{1} << block.width) - 1;
+    std::size_t bit = 0;
+    for (std::uint32_t i = 1; i < block.count; ++i, bit += block.width) {
+      const auto word = bit / 64;
+      const auto shift = bit % 64;
+      auto gap = words[word] >> shift;
+      if (shift + block.width > 64) {
+        gap |= words[word + 1] << (64 - shift);
+      }
+      rows[i] = rows[i - 1] + static_cast<std::uint32_t>(gap & mask) + 1;
+    }
+  }
+
+  std::vector<Block> blocks_;
+  std::vector<std::uint64_t> words_;
+  std::size_t size_ = 0;
+};
+
+}  // namespace halo::storage::search
@@ -0,0 +1,165 @@
+module;
+#include <libstemmer.h>
+#include <unicode/brkiter.h>
+#include <unicode/locid.h>
+#include <unicode/ubrk.h>
+#include <unicode/utext.h>
+#include <unicode/utypes.h>
+#include <utf8proc.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+export module halo.storage.search:TextAnalyzer;
+import halo.common;
+
+namespace halo::storage::search {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+export struct TextAnalyzerOptions {
+  // ICU locale whose word break rules split the text.
+  std::string locale = "en";
+  // Snowball stemmer (`english', `german', ...); empty disables stemming.
+  std::string stemmer = "english";
+  // Drops combining marks after decomposition, so `café' finds `cafe'.
+  bool strip_accents = true;
+  // Words longer than this, in bytes after normalization, are not indexed.
+  std::size_t max_term_bytes = 64;
+};
+
+// Turns text into index terms: NFKC normalization and case folding with
+// utf8proc, word segmentation with ICU's word break rules, then Snowball
+// stemming. Segments without letters, digits or ideographs (spaces,
+// punctuation) produce no term. Text that is not valid UTF-8 is segmented
+// without normalization.
+//
+// Not thread-safe; the break iterator and the stemmer carry state between
+// calls.
+export class TextAnalyzer final {
+ public:
+  static StatusOr<TextAnalyzer> create(const TextAnalyzerOptions& options) {
+    UErrorCode error = U_ZERO_ERROR;
+    std::unique_ptr<icu::BreakIterator> words(
+        icu::BreakIterator::createWordInstance(
+            icu::Locale(options.locale.c_str()), error));
+    if (U_FAILURE(error) || words == nullptr) {
+      return Status::Invalid("no word break rules for locale `" +
+                             options.locale + "': " + u_errorName(error));
+    }
+    Stemmer stemmer;
+    if (!options.stemmer.empty()) {
+      stemmer.reset(sb_stemmer_new(options.stemmer.c_str(), "UTF_8"));
+      if (stemmer == nullptr) {
+        return Status::Invalid("unknown stemmer `" + options.stemmer + "'");
+      }
+    }
+    return TextAnalyzer(options, std::move(words), std::move(stemmer));
+  }
+
+  // Terms of `text' in order of appearance, repeats included.
+  std::vector<std::string> analyze(std::string_view text) {
+    std::vector<std::string> terms;
+    analyze(text, [&](std::string term) { terms.push_back(std::move(term)); });
+    return terms;
+  }
+
+  // Calls `consumer' with every term of `text'.
+  template <typename Consumer>
+  void analyze(std::string_view text, Consumer&& consumer) {
+    const auto normalized = normalize(text);
+    const std::string_view view =
+        normalized.has_value() ? std::string_view(*normalized) : text;
+
+    UErrorCode error = U_ZERO_ERROR;
+    UText utext = UTEXT_INITIALIZER;
+    // Native indices of a UTF-8 UText are byte offsets into `view'.
+    utext_openUTF8(&utext, view.data(), static_cast<std::int64_t>(view.size()),
+                   &error);
+    words_->setText(&utext, error);
+    if (U_FAILURE(error)) {
+      utext_close(&utext);
+      return;
+    }
+    for (auto begin = words_->first(), end = words_->next();
+         end != icu::BreakIterator::DONE; begin = end, end = words_->next()) {
+      if (words_->getRuleStatus() < UBRK_WORD_NONE_LIMIT) {
+        continue;
+      }
+      const auto word = view.substr(static_cast<std::size_t>(begin),
+                                    static_cast<std::size_t>(end - begin));
+      if (word.size() > options_.max_term_bytes) {
+        continue;
+      }
+      consumer(stem(word));
+    }
+    utext_close(&utext);
+  }
+
+  [[nodiscard]] const TextAnalyzerOptions& options() const {
+    return options_;
+  }
+
+ private:
+  struct StemmerDeleter {
+    void operator()(sb_stemmer* stemmer) const { sb_stemmer_delete(stemmer); }
+  };
+  using Stemmer = std::unique_ptr<sb_stemmer, StemmerDeleter>;
+
+  TextAnalyzer(TextAnalyzerOptions options,
+               std::unique_ptr<icu::BreakIterator> words, Stemmer stemmer)
+      : options_(std::move(options)),
+        words_(std::move(words)),
+        stemmer_(std::move(stemmer)) {}
+
+  // NFKC case-folded `text', or nullopt if it is not valid UTF-8.
+  [[nodiscard]] std::optional<std::string> normalize(
+      std::string_view text) const {
+    auto flags = UTF8PROC_STABLE | UTF8PROC_COMPAT | UTF8PROC_COMPOSE |
+                 UTF8PROC_CASEFOLD | UTF8PROC_IGNORE;
+    if (options_.strip_accents) {
+      flags = flags | UTF8PROC_STRIPMARK;
+    }
+    utf8proc_uint8_t* mapped = nullptr;
+    const auto length = utf8proc_map(
+        reinterpret_cast<const utf8proc_uint8_t*>(text.data()),
+        static_cast<utf8proc_ssize_t>(text.size()), &mapped,
+        static_cast<utf8proc_option_t>(flags));
+    if (length < 0) {
+      return std::nullopt;
+    }
+    std::string normalized(reinterpret_cast<const char*>(mapped),
+                           static_cast<std::size_t>(length));
+    std::free(mapped);
+    return normalized;
+  }
+
+  std::string stem(std::string_view word) {
+    if (stemmer_ == nullptr) {
+      return std::string(word);
+    }
+    const auto* stemmed = sb_stemmer_stem(
+        stemmer_.get(), reinterpret_cast<const sb_symbol*>(word.data()),
+        static_cast<int>(word.size()));
+    if (stemmed == nullptr) {
+      // Out of memory inside the stemmer; index the word as it is.
+      return std::string(word);
+    }
+    return std::string(reinterpret_cast<const char*>(stemmed),
+                       static_cast<std::size_t>(
+                           sb_stemmer_length(stemmer_.get())));
+  }
+
+  TextAnalyzerOptions options_;
+  std::unique_ptr<icu::BreakIterator> words_;
+  Stemmer stemmer_;
+};
+
+}  // namespace halo::storage::search
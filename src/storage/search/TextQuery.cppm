@@ -0,0 +1,77 @@
+module;
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+export module halo.storage.search:TextQuery;
+import :TextAnalyzer;
+
+namespace halo::storage::search {
+
+// Sorts `terms' and drops repeats, the form rows and alternatives are
+// compared in.
+export void uniqueTerms(std::vector<std::string>& terms) {
+  std::sort(terms.begin(), terms.end());
+  terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+}
+
+// Query of a `match' predicate: words, all of which a row must contain,
+// with `OR' (upper case) separating alternatives. Words go through the same
+// analyzer as the indexed text, so `Connections' finds `connected'.
+export class TextQuery final {
+ public:
+  static TextQuery parse(std::string_view query, TextAnalyzer& analyzer) {
+    TextQuery parsed;
+    std::string alternative;
+    const auto flush = [&] {
+      auto terms = analyzer.analyze(alternative);
+      uniqueTerms(terms);
+      if (!terms.empty()) {
+        parsed.alternatives_.push_back(std::move(terms));
+      }
+      alternative.clear();
+    };
+    std::size_t position = 0;
+    while (position < query.size()) {
+      const auto begin = query.find_first_not_of(" \t\r\n", position);
+      if (begin == std::string_view::npos) {
+        break;
+      }
+      auto end = query.find_first_of(" \t\r\n", begin);
+      if (end == std::string_view::npos) {
+        end = query.size();
+      }
+      const auto word = query.substr(begin, end - begin);
+      if (word == "OR") {
+        flush();
+      } else {
+        alternative.append(word).push_back(' ');
+      }
+      position = end;
+    }
+    flush();
+    return parsed;
+  }
+
+  // Each alternative's terms, sorted and unique. A query without terms
+  // matches nothing.
+  [[nodiscard]] const std::vector<std::vector<std::string>>& alternatives()
+      const {
+    return alternatives_;
+  }
+
+  // Whether a row with the sorted, unique `terms' matches.
+  [[nodiscard]] bool matches(const std::vector<std::string>& terms) const {
+    return std::ranges::any_of(alternatives_, [&](const auto& alternative) {
+      return std::includes(terms.begin(), terms.end(), alternative.begin(),
+                           alternative.end());
+    });
+  }
+
+ private:
+  std::vector<std::vector<std::string>> alternatives_;
+};
+
+}  // namespace halo::storage::search
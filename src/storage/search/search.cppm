@@ -0,0 +1,6 @@
+export module halo.storage.search;
+export import :FullTextIndex;
+export import :MatchPredicate;
+export import :PostingList;
+export import :TextAnalyzer;
+export import :TextQuery;
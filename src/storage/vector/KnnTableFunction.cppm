@@ -0,0 +1,197 @@
+module;
+#include <velox/common/memory/MemoryPool.h>
+#include <velox/type/Type.h>
+#include <velox/vector/BaseVector.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/DecodedVector.h>
+#include <velox/vector/FlatVector.h>
+#include <velox/vector/SimpleVector.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+export module halo.storage.vector:KnnTableFunction;
+import halo.common;
+import :VectorIndex;
+
+namespace halo::storage::vector {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+namespace velox = facebook::velox;
+
+// Vector indexes of all tables under `root', one directory per table with
+// each indexed column's index kept next to its data as
+// `<root>/<table>/<column>.faissindex'. Indexes are loaded on first use and
+// then shared. Thread-safe.
+export class VectorIndexCatalog final {
+ public:
+  static std::shared_ptr<VectorIndexCatalog> create(
+      std::string root, const VectorIndexOptions& search_options = {}) {
+    return std::shared_ptr<VectorIndexCatalog>(
+        new VectorIndexCatalog(std::move(root), search_options));
+  }
+
+  [[nodiscard]] std::string path(const std::string& table,
+                                 const std::string& column) const {
+    return (std::filesystem::path(root_) / table /
+            VectorIndex::fileName(column))
+        .string();
+  }
+
+  // Persists `index' as the index of `table'.`column', replacing any
+  // previous one.
+  Status put(const std::string& table, const std::string& column,
+             VectorIndex index) {
+    const auto file = path(table, column);
+    std::error_code error;
+    std::filesystem::create_directories(
+        std::filesystem::path(file).parent_path(), error);
+    if (error) {
+      return Status::StorageError("cannot create `" + file +
+                                  "': " + error.message());
+    }
+    if (auto status = index.save(file); !status.ok()) {
+      return status;
+    }
+    const std::scoped_lock lock(mutex_);
+    indexes_[{table, column}] =
+        std::make_shared<const VectorIndex>(std::move(index));
+    return Status::OK();
+  }
+
+  StatusOr<std::shared_ptr<const VectorIndex>> get(const std::string& table,
+                                                   const std::string& column) {
+    const std::scoped_lock lock(mutex_);
+    const auto key = std::make_pair(table, column);
+    if (const auto it = indexes_.find(key); it != indexes_.end()) {
+      return it->second;
+    }
+    const auto file = path(table, column);
+    if (!std::filesystem::exists(file)) {
+      return Status::Invalid("no vector index on " + table + "." + column);
+    }
+    auto index = VectorIndex::load(file, search_options_);
+    if (!index.ok()) {
+      return index.status();
+    }
+    auto shared = std::make_shared<const VectorIndex>(std::move(index).value());
+    indexes_.emplace(key, shared);
+    return shared;
+  }
+
+ private:
+  VectorIndexCatalog(std::string root, VectorIndexOptions search_options)
+      : root_(std::move(root)), search_options_(std::move(search_options)) {}
+
+  const std::string root_;
+  const VectorIndexOptions search_options_;
+  std::mutex mutex_;
+  std::map<std::pair<std::string, std::string>,
+           std::shared_ptr<const VectorIndex>>
+      indexes_;
+};
+
+// Output of `knn': for every query vector, its `k' nearest rows.
+export velox::RowTypePtr knnOutputType() {
+  return velox::ROW({"query", "row_id", "distance"},
+                    {velox::INTEGER(), velox::BIGINT(), velox::REAL()});
+}
+
+// knn(table, column, query_vector, k): the `k' rows of `table' whose
+// `column' vectors are nearest each query, as (query, row_id, distance)
+// rows ordered by query and then distance. `queries' is an ARRAY<REAL>
+// vector; all of its rows are searched in one batch. NULL queries have no
+// neighbors.
+export StatusOr<velox::RowVectorPtr> knn(VectorIndexCatalog& catalog,
+                                         const std::string& table,
+                                         const std::string& column,
+                                         const velox::BaseVector& queries,
+                                         std::size_t k,
+                                         velox::memory::MemoryPool* pool) {
+  auto index = catalog.get(table, column);
+  if (!index.ok()) {
+    return index.status();
+  }
+  const auto dimension = (*index)->dimension();
+
+  const velox::DecodedVector decoded(queries);
+  const auto* arrays = decoded.base()->as<velox::ArrayVector>();
+  const auto* elements =
+      arrays == nullptr
+          ? nullptr
+          : arrays->elements()->as<velox::SimpleVector<float>>();
+  if (elements == nullptr) {
+    return Status::Invalid("knn query vectors must be ARRAY<REAL>, got " +
+                           queries.type()->toString());
+  }
+  std::vector<float> batch;
+  std::vector<std::int32_t> query_rows;
+  for (velox::vector_size_t row = 0; row < queries.size(); ++row) {
+    if (decoded.isNullAt(row)) {
+      continue;
+    }
+    const auto offset = arrays->offsetAt(decoded.index(row));
+    const auto size = arrays->sizeAt(decoded.index(row));
+    if (static_cast<std::size_t>(size) != dimension) {
+      return Status::Invalid("knn query " + std::to_string(row) + " has " +
+                             std::to_string(size) + " dimensions, " + table +
+                             "." + column + " " + std::to_string(dimension));
+    }
+    for (velox::vector_size_t i = 0; i < size; ++i) {
+      if (elements->isNullAt(offset + i)) {
+        return Status::Invalid("knn query " + std::to_string(row) +
+                               " has a NULL element");
+      }
+      batch.push_back(elements->valueAt(offset + i));
+    }
+    query_rows.push_back(row);
+  }
+
+  KnnResult result{.k = k};
+  if (!query_rows.empty()) {
+    auto searched = (*index)->search(batch, k);
+    if (!searched.ok()) {
+      return searched.status();
+    }
+    result = std::move(searched).value();
+  }
+  std::size_t found = 0;
+  for (const auto row_id : result.row_ids) {
+    found += row_id >= 0 ? 1 : 0;
+  }
+
+  const auto size = static_cast<velox::vector_size_t>(found);
+  auto query_column = velox::BaseVector::create<velox::FlatVector<
+      std::int32_t>>(velox::INTEGER(), size, pool);
+  auto row_id_column = velox::BaseVector::create<velox::FlatVector<
+      std::int64_t>>(velox::BIGINT(), size, pool);
+  auto distance_column = velox::BaseVector::create<velox::FlatVector<float>>(
+      velox::REAL(), size, pool);
+  velox::vector_size_t out = 0;
+  for (std::size_t i = 0; i < result.row_ids.size(); ++i) {
+    if (result.row_ids[i] < 0) {
+      continue;
+    }
+    query_column->set(out, query_rows[i / k]);
+    row_id_column->set(out, result.row_ids[i]);
+    distance_column->set(out, result.distances[i]);
+    ++out;
+  }
+  return std::make_shared<velox::RowVector>(
+      pool, knnOutputType(), nullptr, size,
+      std::vector<velox::VectorPtr>{query_column, row_id_column,
+                                    distance_column});
+}
+
+}  // namespace halo::storage::vector
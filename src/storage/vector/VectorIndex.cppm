@@ -0,0 +1,330 @@
+module;
+#include <faiss/Index.h>
+#include <faiss/IndexFlat.h>
+#include <faiss/IndexHNSW.h>
+#include <faiss/IndexIDMap.h>
+#include <faiss/IndexIVF.h>
+#include <faiss/IndexIVFPQ.h>
+#include <faiss/MetricType.h>
+#include <faiss/index_io.h>
+#include <velox/vector/BaseVector.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/DecodedVector.h>
+#include <velox/vector/SimpleVector.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+export module halo.storage.vector:VectorIndex;
+import halo.common;
+import halo.common.threads;
+
+namespace halo::storage::vector {
+
+using halo::common::base::Status;
+using halo::common::base::StatusOr;
+
+namespace velox = facebook::velox;
+
+export enum class VectorIndexKind : std::uint8_t {
+  // Exact search over the raw vectors; the baseline for the others.
+  kFlat,
+  // Inverted lists over a coarse k-means quantizer, vectors compressed with
+  // product quantization. Small and fast, approximate.
+  kIvfPq,
+  // Hierarchical navigable small world graph over the raw vectors. Larger,
+  // with the best recall at a given latency.
+  kHnsw,
+};
+
+export enum class VectorMetric : std::uint8_t {
+  kL2,
+  // Distances are similarities: larger is nearer.
+  kInnerProduct,
+};
+
+export struct VectorIndexOptions {
+  VectorIndexKind kind = VectorIndexKind::kHnsw;
+  VectorMetric metric = VectorMetric::kL2;
+  // IVF-PQ: inverted lists, 0 to pick from the row count; lists probed per
+  // query; sub-quantizers, which must divide the dimension; bits per code.
+  std::size_t ivf_lists = 0;
+  std::size_t ivf_probes = 16;
+  std::size_t pq_subquantizers = 8;
+  std::size_t pq_bits = 8;
+  // HNSW: neighbors per node and the candidate list sizes while building
+  // and searching.
+  int hnsw_neighbors = 32;
+  int hnsw_ef_construction = 40;
+  int hnsw_ef_search = 64;
+  // OpenMP threads FAISS may build and search on, leased from the process's
+  // thread budget at each call; 0 asks for as many as it has free. Calls
+  // from executor threads get no more than the budget lets those have.
+  std::uint32_t threads = 0;
+};
+
+// Nearest rows of a batch of queries. Row `q' of the batch owns entries
+// [q * k, (q + 1) * k) of both arrays, nearest first; a row id of -1 pads
+// queries with fewer than `k' neighbors.
+export struct KnnResult {
+  std::size_t k = 0;
+  std::vector<std::int64_t> row_ids;
+  std::vector<float> distances;
+};
+
+export class VectorIndexBuilder;
+
+// Approximate (or, for kFlat, exact) nearest-neighbor index over the
+// vectors of one ARRAY<REAL> column, labelled with their row numbers.
+// Searching is thread-safe.
+export class VectorIndex final {
+ public:
+  // File the index of `column' is kept in, inside the table's directory.
+  static std::string fileName(const std::string& column) {
+    return column + ".faissindex";
+  }
+
+  static StatusOr<VectorIndex> load(const std::string& path,
+                                    const VectorIndexOptions& options = {}) {
+    try {
+      std::unique_ptr<faiss::Index> index(faiss::read_index(path.c_str()));
+      applySearchOptions(*index, options);
+      return VectorIndex(std::move(index), options.threads);
+    } catch (const std::exception& e) {
+      return Status::StorageError("cannot load vector index `" + path +
+                                  "': " + e.what());
+    }
+  }
+
+  Status save(const std::string& path) const {
+    try {
+      faiss::write_index(index_.get(), path.c_str());
+      return Status::OK();
+    } catch (const std::exception& e) {
+      return Status::StorageError("cannot save vector index `" + path +
+                                  "': " + e.what());
+    }
+  }
+
+  // Searches all `queries' (row-major, `dimension()' floats each) in one
+  // call, which lets FAISS score them against the vectors with a GEMM
+  // instead of one distance loop per query.
+  [[nodiscard]] StatusOr<KnnResult> search(std::span<const float> queries,
+                                           std::size_t k) const {
+    const auto d = dimension();
+    if (k == 0 || queries.size() % d != 0) {
+      return Status::Invalid("knn needs k > 0 and queries of dimension " +
+                             std::to_string(d) + ", got " +
+                             std::to_string(queries.size()) + " floats");
+    }
+    const auto n = queries.size() / d;
+    KnnResult result{.k = k,
+                     .row_ids = std::vector<std::int64_t>(n * k),
+                     .distances = std::vector<float>(n * k)};
+    try {
+      std::vector<faiss::idx_t> labels(n * k);
+      const common::threads::ScopedParallelism parallelism(
+          common::threads::ThreadBudget::global(), threads_);
+      index_->search(static_cast<faiss::idx_t>(n), queries.data(),
+                     static_cast<faiss::idx_t>(k), result.distances.data(),
+                     labels.data());
+      std::copy(labels.begin(), labels.end(), result.row_ids.begin());
+    } catch (const std::exception& e) {
+      return Status::StorageError(std::string("knn search failed: ") +
+                                  e.what());
+    }
+    return result;
+  }
+
+  [[nodiscard]] std::size_t dimension() const {
+    return static_cast<std::size_t>(index_->d);
+  }
+
+  [[nodiscard]] std::size_t size() const {
+    return static_cast<std::size_t>(index_->ntotal);
+  }
+
+ private:
+  friend class VectorIndexBuilder;
+
+  VectorIndex(std::unique_ptr<faiss::Index> index, std::uint32_t threads)
+      : index_(std::move(index)), threads_(threads) {}
+
+  // Search-time knobs are not part of the file; set them on every load.
+  static void applySearchOptions(faiss::Index& index,
+                                 const VectorIndexOptions& options) {
+    auto* inner = &index;
+    if (auto* id_map = dynamic_cast<faiss::IndexIDMap*>(inner)) {
+      inner = id_map->index;
+    }
+    if (auto* ivf = dynamic_cast<faiss::IndexIVF*>(inner)) {
+      ivf->nprobe = std::min(options.ivf_probes, ivf->nlist);
+    } else if (auto* hnsw = dynamic_cast<faiss::IndexHNSW*>(inner)) {
+      hnsw->hnsw.efSearch = options.hnsw_ef_search;
+    }
+  }
+
+  std::unique_ptr<faiss::Index> index_;
+  const std::uint32_t threads_;
+};
+
+// Collects the vectors of an ARRAY<REAL> column in row order and trains
+// and fills the index from them. NULL arrays take a row number but are not
+// indexed; every other array must have the column's dimension.
+export class VectorIndexBuilder final {
+ public:
+  static StatusOr<VectorIndexBuilder> create(
+      std::size_t dimension, const VectorIndexOptions& options = {}) {
+    if (dimension == 0) {
+      return Status::Invalid("vector index needs a dimension");
+    }
+    if (options.kind == VectorIndexKind::kIvfPq &&
+        (options.pq_subquantizers == 0 ||
+         dimension % options.pq_subquantizers != 0)) {
+      return Status::Invalid(
+          "IVF-PQ sub-quantizers must divide the dimension " +
+          std::to_string(dimension));
+    }
+    return VectorIndexBuilder(dimension, options);
+  }
+
+  Status append(std::span<const float> vector) {
+    if (vector.size() != dimension_) {
+      return Status::Invalid("row " + std::to_string(rows_) + " has " +
+                             std::to_string(vector.size()) +
+                             " dimensions, the index " +
+                             std::to_string(dimension_));
+    }
+    values_.insert(values_.end(), vector.begin(), vector.end());
+    ids_.push_back(rows_++);
+    return Status::OK();
+  }
+
+  void appendNull() { ++rows_; }
+
+  // Appends every row of an ARRAY<REAL> vector.
+  Status append(const velox::BaseVector& column) {
+    const velox::DecodedVector decoded(column);
+    const auto* arrays = decoded.base()->as<velox::ArrayVector>();
+    if (arrays == nullptr) {
+      return Status::Invalid("vector index needs an ARRAY<REAL> column, got " +
+                             column.type()->toString());
+    }
+    const auto* elements =
+        arrays->elements()->as<velox::SimpleVector<float>>();
+    if (elements == nullptr) {
+      return Status::Invalid("vector index needs an ARRAY<REAL> column, got " +
+                             column.type()->toString());
+    }
+    std::vector<float> vector;
+    for (velox::vector_size_t row = 0; row < column.size(); ++row) {
+      if (decoded.isNullAt(row)) {
+        appendNull();
+        continue;
+      }
+      const auto index = decoded.index(row);
+      const auto offset = arrays->offsetAt(index);
+      const auto size = arrays->sizeAt(index);
+      vector.resize(static_cast<std::size_t>(size));
+      for (velox::vector_size_t i = 0; i < size; ++i) {
+        if (elements->isNullAt(offset + i)) {
+          return Status::Invalid("row " + std::to_string(rows_) +
+                                 " has a NULL element");
+        }
+        vector[static_cast<std::size_t>(i)] = elements->valueAt(offset + i);
+      }
+      if (auto status = append(vector); !status.ok()) {
+        return status;
+      }
+    }
+    return Status::OK();
+  }
+
+  StatusOr<VectorIndex> build() {
+    const auto n = ids_.size();
+    const auto d = static_cast<faiss::idx_t>(dimension_);
+    const auto metric = options_.metric == VectorMetric::kInnerProduct
+                            ? faiss::METRIC_INNER_PRODUCT
+                            : faiss::METRIC_L2;
+    try {
+      std::unique_ptr<faiss::Index> inner;
+      switch (options_.kind) {
+        case VectorIndexKind::kFlat:
+          inner = std::make_unique<faiss::IndexFlat>(d, metric);
+          break;
+        case VectorIndexKind::kIvfPq: {
+          const auto lists = ivfLists(n);
+          const auto centroids = std::size_t{1} << options_.pq_bits;
+          if (n < std::max(lists, centroids)) {
+            return Status::Invalid(
+                "IVF-PQ needs at least " +
+                std::to_string(std::max(lists, centroids)) +
+                " vectors to train on, got " + std::to_string(n));
+          }
+          auto quantizer = std::make_unique<faiss::IndexFlat>(d, metric);
+          auto ivf = std::make_unique<faiss::IndexIVFPQ>(
+              quantizer.release(), d, lists, options_.pq_subquantizers,
+              options_.pq_bits, metric);
+          ivf->own_fields = true;
+          inner = std::move(ivf);
+          break;
+        }
+        case VectorIndexKind::kHnsw: {
+          auto hnsw = std::make_unique<faiss::IndexHNSWFlat>(
+              static_cast<int>(d), options_.hnsw_neighbors, metric);
+          hnsw->hnsw.efConstruction = options_.hnsw_ef_construction;
+          inner = std::move(hnsw);
+          break;
+        }
+      }
+      auto index = std::make_unique<faiss::IndexIDMap>(inner.release());
+      index->own_fields = true;
+      const common::threads::ScopedParallelism parallelism(
+          common::threads::ThreadBudget::global(), options_.threads);
+      if (!index->is_trained) {
+        index->train(static_cast<faiss::idx_t>(n), values_.data());
+      }
+      index->add_with_ids(static_cast<faiss::idx_t>(n), values_.data(),
+                          ids_.data());
+      VectorIndex::applySearchOptions(*index, options_);
+      values_.clear();
+      ids_.clear();
+      rows_ = 0;
+      return VectorIndex(std::move(index), options_.threads);
+    } catch (const std::exception& e) {
+      return Status::StorageError(std::string("cannot build vector index: ") +
+                                  e.what());
+    }
+  }
+
+ private:
+  VectorIndexBuilder(std::size_t dimension, VectorIndexOptions options)
+      : dimension_(dimension), options_(std::move(options)) {}
+
+  // About 4 * sqrt(n) lists, the usual FAISS guidance, with at least 39
+  // training vectors per list.
+  [[nodiscard]] std::size_t ivfLists(std::size_t n) const {
+    if (options_.ivf_lists != 0) {
+      return options_.ivf_lists;
+    }
+    const auto lists =
+        static_cast<std::size_t>(4 * std::sqrt(static_cast<double>(n)));
+    return std::clamp<std::size_t>(lists, 1, std::max<std::size_t>(n / 39, 1));
+  }
+
+  const std::size_t dimension_;
+  const VectorIndexOptions options_;
+  std::vector<float> values_;
+  std::vector<faiss::idx_t> ids_;
+  faiss::idx_t rows_ = 0;
+};
+
+}  // namespace halo::storage::vector
@@ -0,0 +1,3 @@
+export module halo.storage.vector;
+export import :KnnTableFunction;
+export import :VectorIndex;
@@ -0,0 +1,198 @@
+// SUM(x) GROUP BY a DECIMAL key stored as __int128, hashed with the XOR of
+// its halves the tests used to specialize std::hash with and with
+// Int128Hash, in an F14 map and in an open-addressing table probed with
+// hashes computed a batch at a time by hashInt128Batch(), the way Velox's
+// hash tables hash a vector before probing. The XOR only runs through F14,
+// which mixes its bits again: a table indexed by its bits as they are
+// degrades to linear scans on the wide keys. Also reports the rate of
+// hashing alone.
+
+#include <common/hash/Int128Hash.h>
+#include <folly/container/F14Map.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace halo::common::hash {
+
+namespace {
+
+constexpr std::size_t kRows = std::size_t{1} << 21;
+constexpr std::size_t kGroups = std::size_t{1} << 18;
+constexpr std::size_t kBatch = 1024;
+
+double millisSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+struct XorHalves {
+  std::size_t operator()(__int128 value) const noexcept {
+    return static_cast<std::uint64_t>(value) ^
+           (static_cast<std::uint64_t>(value >> 64) << 1);
+  }
+};
+
+struct KeySet {
+  std::string name;
+  std::vector<__int128> keys;
+  std::vector<std::int64_t> values;
+};
+
+// Rows drawn from kGroups distinct keys made by `group'.
+template <typename MakeKey>
+KeySet makeKeySet(std::string name, MakeKey make_key) {
+  std::mt19937_64 random(7);
+  KeySet set{std::move(name), {}, {}};
+  for (std::size_t i = 0; i < kRows; ++i) {
+    set.keys.push_back(make_key(random() % kGroups));
+    set.values.push_back(static_cast<std::int64_t>(random() % 1000));
+  }
+  return set;
+}
+
+struct Result {
+  std::size_t groups = 0;
+  std::int64_t total = 0;
+};
+
+template <typename Hash>
+Result groupByF14(const KeySet& set) {
+  folly::F14FastMap<__int128, std::int64_t, Hash> sums;
+  for (std::size_t i = 0; i < set.keys.size(); ++i) {
+    sums[set.keys[i]] += set.values[i];
+  }
+  Result result{sums.size(), 0};
+  for (const auto& [key, sum] : sums) {
+    result.total += sum;
+  }
+  return result;
+}
+
+Result groupByBatched(const KeySet& set) {
+  const std::size_t capacity = std::bit_ceil(kGroups * 2);
+  const auto mask = capacity - 1;
+  std::vector<std::uint8_t> used(capacity);
+  std::vector<__int128> slot_keys(capacity);
+  std::vector<std::int64_t> slot_sums(capacity);
+  std::vector<std::uint64_t> hashes(kBatch);
+  Result result;
+  for (std::size_t begin = 0; begin < set.keys.size(); begin += kBatch) {
+    const auto size = std::min(kBatch, set.keys.size() - begin);
+    hashInt128Batch(set.keys.data() + begin, size, hashes.data());
+    for (std::size_t i = 0; i < size; ++i) {
+      const auto key = set.keys[begin + i];
+      auto slot = hashes[i] & mask;
+      while (used[slot] != 0 && slot_keys[slot] != key) {
+        slot = (slot + 1) & mask;
+      }
+      if (used[slot] == 0) {
+        used[slot] = 1;
+        slot_keys[slot] = key;
+        ++result.groups;
+      }
+      slot_sums[slot] += set.values[begin + i];
+    }
+  }
+  for (std::size_t slot = 0; slot < capacity; ++slot) {
+    result.total += slot_sums[slot];
+  }
+  return result;
+}
+
+__int128 pow10(int exponent) {
+  __int128 value = 1;
+  for (int i = 0; i < exponent; ++i) {
+    value *= 10;
+  }
+  return value;
+}
+
+}  // namespace
+
+TEST(Int128HashBenchmark, DecimalGroupBy) {
+  const std::vector<KeySet> sets = {
+      // DECIMAL(38, 6) amounts in cents, half negative.
+      makeKeySet("amounts",
+                 [](std::uint64_t group) {
+                   const auto value = static_cast<__int128>(group * 977 + 13) *
+                                      pow10(4);
+                   return group % 2 == 0 ? value : -value;
+                 }),
+      // DECIMAL(38, 0) ids past 2^64: a 9-bit prefix and a sequence.
+      makeKeySet("wide ids", [](std::uint64_t group) {
+        return (static_cast<__int128>(group % 512) << 64) |
+               static_cast<__int128>(group / 512);
+      })};
+
+  std::cout << std::fixed << std::setprecision(2) << kRows << " rows, "
+            << kGroups << " groups\n"
+            << std::left << std::setw(12) << "keys" << std::setw(36)
+            << "GROUP BY" << std::right << std::setw(12) << "ms" << "\n";
+  for (const auto& set : sets) {
+    const auto row = [&](const char* name, const auto& group_by) {
+      const auto start = std::chrono::steady_clock::now();
+      const auto result = group_by(set);
+      const auto ms = millisSince(start);
+      std::cout << std::left << std::setw(12) << set.name << std::setw(36)
+                << name << std::right << std::setw(12) << ms << "\n";
+      return result;
+    };
+    const auto xor_result = row("F14, XOR of halves", groupByF14<XorHalves>);
+    const auto f14_result = row("F14, Int128Hash", groupByF14<Int128Hash>);
+    const auto batched_result =
+        row("open addressing, hashInt128Batch", groupByBatched);
+    EXPECT_EQ(f14_result.groups, xor_result.groups);
+    EXPECT_EQ(batched_result.groups, xor_result.groups);
+    EXPECT_EQ(f14_result.total, xor_result.total);
+    EXPECT_EQ(batched_result.total, xor_result.total);
+  }
+
+  // Hashing alone over the amounts, best of a few rounds.
+  const auto& keys = sets[0].keys;
+  std::vector<std::uint64_t> hashes(keys.size());
+  const auto rate = [&](const auto& hash_all) {
+    double best_ms = 1e300;
+    for (int round = 0; round < 5; ++round) {
+      const auto start = std::chrono::steady_clock::now();
+      hash_all();
+      best_ms = std::min(best_ms, millisSince(start));
+    }
+    EXPECT_NE(hashes[keys.size() / 2], 0U);
+    return static_cast<double>(keys.size()) / (best_ms * 1e3);
+  };
+  const auto xor_rate = rate([&] {
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+      hashes[i] = XorHalves{}(keys[i]);
+    }
+  });
+  const auto scalar_rate = rate([&] {
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+      hashes[i] = hashInt128(keys[i]);
+    }
+  });
+  const auto batch_rate = rate(
+      [&] { hashInt128Batch(keys.data(), keys.size(), hashes.data()); });
+  std::cout << std::left << std::setw(48) << "hashing" << std::right
+            << std::setw(12) << "Mkeys/s" << "\n";
+  const auto line = [](const char* name, double mkeys) {
+    std::cout << std::left << std::setw(48) << name << std::right
+              << std::setw(12) << mkeys << "\n";
+  };
+  line("XOR of halves", xor_rate);
+  line("hashInt128, one at a time", scalar_rate);
+  line("hashInt128Batch", batch_rate);
+}
+
+}  // namespace halo::common::hash
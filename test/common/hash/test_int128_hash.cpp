@@ -0,0 +1,185 @@
+#include <common/hash/Int128Hash.h>
+#include <folly/container/F14Map.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace halo::common::hash {
+
+namespace {
+
+constexpr std::size_t kBucketBits = 16;
+constexpr std::size_t kBuckets = std::size_t{1} << kBucketBits;
+
+// The XOR of the halves the tests used to specialize std::hash with;
+// std::hash<uint64_t> is the identity in libstdc++.
+std::uint64_t xorHalves(__int128 value) {
+  return static_cast<std::uint64_t>(value) ^
+         (static_cast<std::uint64_t>(value >> 64) << 1);
+}
+
+__int128 pow10(int exponent) {
+  __int128 value = 1;
+  for (int i = 0; i < exponent; ++i) {
+    value *= 10;
+  }
+  return value;
+}
+
+// DECIMAL(38, 6) amounts in whole cents, half of them negative, the way a
+// GROUP BY amount sees them.
+std::vector<__int128> decimalAmounts(std::size_t count) {
+  std::mt19937_64 random(17);
+  std::unordered_set<std::uint64_t> seen;
+  std::vector<__int128> keys;
+  while (keys.size() < count) {
+    const auto cents = random() % 100'000'000'000ULL;
+    if (!seen.insert(cents).second) {
+      continue;
+    }
+    const auto value = static_cast<__int128>(cents) * pow10(4);
+    keys.push_back(keys.size() % 2 == 0 ? value : -value);
+  }
+  return keys;
+}
+
+// DECIMAL(38, 0) ids past 2^64 made of a small prefix and a sequence, so
+// that both halves vary over a narrow range.
+std::vector<__int128> wideIds(std::size_t count) {
+  std::vector<__int128> keys;
+  for (std::size_t i = 0; keys.size() < count; ++i) {
+    const auto prefix = static_cast<__int128>(i % 256);
+    const auto sequence = static_cast<__int128>(i / 256);
+    keys.push_back((prefix << 64) | sequence);
+  }
+  return keys;
+}
+
+// Largest bucket of `keys' in a power-of-two table indexed by the low bits
+// of their hash.
+std::size_t maxLowBucket(const std::vector<__int128>& keys,
+                         std::uint64_t (*hash)(__int128)) {
+  std::vector<std::size_t> buckets(kBuckets);
+  for (const auto key : keys) {
+    ++buckets[hash(key) & (kBuckets - 1)];
+  }
+  return *std::max_element(buckets.begin(), buckets.end());
+}
+
+// Chi-squared of the keys over buckets picked by the top bits of their
+// hash, which is where F14 takes its tags from.
+double chiSquaredHighBits(const std::vector<__int128>& keys) {
+  std::vector<std::size_t> buckets(kBuckets);
+  for (const auto key : keys) {
+    ++buckets[hashInt128(key) >> (64 - kBucketBits)];
+  }
+  const double expected = static_cast<double>(keys.size()) / kBuckets;
+  double chi_squared = 0;
+  for (const auto count : buckets) {
+    const double delta = static_cast<double>(count) - expected;
+    chi_squared += delta * delta / expected;
+  }
+  return chi_squared;
+}
+
+}  // namespace
+
+TEST(Int128HashTest, SignedAndUnsignedAgree) {
+  for (const __int128 value :
+       {__int128{0}, __int128{1}, __int128{-1}, pow10(38) - 1, -pow10(38)}) {
+    const auto unsigned_value = static_cast<unsigned __int128>(value);
+    EXPECT_EQ(hashInt128(value), hashInt128(unsigned_value));
+    EXPECT_EQ(Int128Hash{}(value), Int128Hash{}(unsigned_value));
+    EXPECT_EQ(std::hash<__int128>{}(value), Int128Hash{}(value));
+    EXPECT_EQ(std::hash<unsigned __int128>{}(unsigned_value),
+              Int128Hash{}(value));
+  }
+  EXPECT_NE(hashInt128(__int128{1}), hashInt128(__int128{1} << 64));
+}
+
+TEST(Int128HashTest, BatchMatchesScalar) {
+  auto keys = decimalAmounts(1000);
+  const auto wide = wideIds(37);
+  keys.insert(keys.end(), wide.begin(), wide.end());
+  std::vector<std::uint64_t> hashes(keys.size());
+  // Every count, so that each lane width leaves every possible tail.
+  for (std::size_t count = 0; count <= 17; ++count) {
+    hashInt128Batch(keys.data(), count, hashes.data());
+    for (std::size_t i = 0; i < count; ++i) {
+      EXPECT_EQ(hashes[i], hashInt128(keys[i]));
+    }
+  }
+  hashInt128Batch(keys.data(), keys.size(), hashes.data());
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    ASSERT_EQ(hashes[i], hashInt128(keys[i])) << i;
+  }
+}
+
+TEST(Int128HashTest, DecimalAmountsSpreadOverLowBits) {
+  const auto keys = decimalAmounts(kBuckets);
+  // Multiples of 10^4 have four low bits zero, and the XOR leaves them so.
+  EXPECT_GE(maxLowBucket(keys, xorHalves), 16U);
+  // One key per bucket on average; a fair hash stays within a dozen.
+  EXPECT_LE(maxLowBucket(keys, hashInt128), 12U);
+  // 99.99th percentile of chi-squared over 65535 degrees of freedom is
+  // about 66,900.
+  EXPECT_LT(chiSquaredHighBits(keys), 66'900.0);
+}
+
+TEST(Int128HashTest, WideKeysDoNotCollide) {
+  const auto keys = wideIds(kBuckets * 4);
+  std::unordered_set<std::uint64_t> xor_hashes;
+  std::unordered_set<std::uint64_t> hashes;
+  for (const auto key : keys) {
+    xor_hashes.insert(xorHalves(key));
+    hashes.insert(hashInt128(key));
+  }
+  // The XOR maps the whole set onto about a thousand values.
+  EXPECT_LT(xor_hashes.size(), keys.size() / 16);
+  EXPECT_EQ(hashes.size(), keys.size());
+  EXPECT_LE(maxLowBucket(keys, hashInt128), 20U);
+}
+
+TEST(Int128HashTest, EveryInputBitAvalanches) {
+  std::mt19937_64 random(29);
+  constexpr int kSamples = 2000;
+  for (int bit = 0; bit < 128; ++bit) {
+    std::uint64_t flipped = 0;
+    for (int sample = 0; sample < kSamples; ++sample) {
+      const auto value =
+          (static_cast<unsigned __int128>(random()) << 64) | random();
+      const auto other = value ^ (static_cast<unsigned __int128>(1) << bit);
+      flipped += static_cast<std::uint64_t>(
+          std::popcount(hashInt128(value) ^ hashInt128(other)));
+    }
+    const double mean = static_cast<double>(flipped) / kSamples;
+    EXPECT_NEAR(mean, 32.0, 1.0) << "bit " << bit;
+  }
+}
+
+TEST(Int128HashTest, KeysF14AndStdMaps) {
+  const auto keys = decimalAmounts(10'000);
+  folly::F14FastMap<__int128, std::size_t, Int128Hash> f14;
+  folly::F14FastMap<__int128, std::size_t> f14_default;
+  std::unordered_map<__int128, std::size_t> std_map;
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    f14[keys[i]] = i;
+    f14_default[keys[i]] = i;
+    std_map[keys[i]] = i;
+  }
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    EXPECT_EQ(f14.at(keys[i]), i);
+    EXPECT_EQ(f14_default.at(keys[i]), i);
+    EXPECT_EQ(std_map.at(keys[i]), i);
+  }
+}
+
+}  // namespace halo::common::hash
@@ -0,0 +1,139 @@
+// Mixed load: a CPU pool with a thread per core runs tasks that each make
+// an OpenMP parallel loop and, on Linux, an OpenBLAS matrix multiply, the
+// way FAISS searches run from Velox drivers. Left alone each task starts a
+// team per core, so the machine runs cores * cores threads; through a
+// budgeted pool and ScopedParallelism each task runs on its own thread.
+// Reports tasks per second for both, then the time of the same work made
+// from a lone thread, which the budget still lets use every core, and
+// expects the budgeted pool to get through the tasks faster.
+
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <gtest/gtest.h>
+#include <omp.h>
+#ifdef __linux__
+#include <cblas.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+import halo.common;
+import halo.common.threads;
+
+namespace halo::common::threads {
+
+namespace {
+
+constexpr std::size_t kTasks = 512;
+constexpr int kLoopSize = 1 << 16;
+constexpr int kMatrix = 128;
+
+double millisSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// What one task computes: a parallel reduction and a matrix product.
+double work() {
+  double sum = 0;
+#pragma omp parallel for reduction(+ : sum)
+  for (int i = 0; i < kLoopSize; ++i) {
+    sum += std::sqrt(static_cast<double>(i));
+  }
+#ifdef __linux__
+  std::vector<float> a(kMatrix * kMatrix, 1.0F);
+  std::vector<float> b(kMatrix * kMatrix, 0.5F);
+  std::vector<float> c(kMatrix * kMatrix);
+  cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, kMatrix, kMatrix,
+              kMatrix, 1.0F, a.data(), kMatrix, b.data(), kMatrix, 0.0F,
+              c.data(), kMatrix);
+  sum += c[0];
+#endif
+  return sum;
+}
+
+// Runs kTasks on `executor', each wrapped by `task', and returns the
+// milliseconds until all of them finished.
+template <typename Task>
+double runTasks(folly::CPUThreadPoolExecutor& executor, const Task& task,
+                std::atomic<double>& checksum) {
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < kTasks; ++i) {
+    executor.add([&] {
+      const auto value = task();
+      auto seen = checksum.load();
+      while (!checksum.compare_exchange_weak(seen, seen + value)) {
+      }
+    });
+  }
+  executor.join();
+  return millisSince(start);
+}
+
+}  // namespace
+
+TEST(ThreadBudgetBenchmark, MixedLoad) {
+  const auto cores = std::max(1U, std::thread::hardware_concurrency());
+  auto budget = ThreadBudget::create();
+  ASSERT_TRUE(budget.ok()) << budget.status().toString();
+
+  std::atomic<double> unmanaged_sum = 0;
+  folly::CPUThreadPoolExecutor unmanaged(cores);
+  const auto unmanaged_ms = runTasks(unmanaged, work, unmanaged_sum);
+
+  std::atomic<double> budgeted_sum = 0;
+  auto budgeted = makeBudgetedExecutor(**budget, cores, "BudgetBench");
+  const auto budgeted_ms = runTasks(
+      *budgeted,
+      [&] {
+        const ScopedParallelism parallelism(**budget, 0);
+        return work();
+      },
+      budgeted_sum);
+  EXPECT_NEAR(budgeted_sum.load(), unmanaged_sum.load(),
+              1e-9 * unmanaged_sum.load());
+  budgeted.reset();
+
+  // The same tasks one after another from a thread outside any pool.
+  double lone_sum = 0;
+  const auto start = std::chrono::steady_clock::now();
+  std::uint32_t lone_threads = 0;
+  for (std::size_t i = 0; i < kTasks; ++i) {
+    const ScopedParallelism parallelism(**budget, 0);
+    lone_threads = parallelism.threads();
+    lone_sum += work();
+  }
+  const auto lone_ms = millisSince(start);
+  EXPECT_EQ(lone_threads, cores);
+  EXPECT_NEAR(lone_sum, unmanaged_sum.load(), 1e-9 * lone_sum);
+
+  std::cout << std::fixed << std::setprecision(2) << kTasks << " tasks, "
+            << cores << " cores\n"
+            << std::left << std::setw(36) << "threads" << std::right
+            << std::setw(12) << "ms" << std::setw(12) << "tasks/s" << "\n";
+  const auto row = [](const char* name, double ms) {
+    std::cout << std::left << std::setw(36) << name << std::right
+              << std::setw(12) << ms << std::setw(12)
+              << static_cast<double>(kTasks) / (ms / 1e3) << "\n";
+  };
+  row("pool, library defaults", unmanaged_ms);
+  row("budgeted pool, ScopedParallelism", budgeted_ms);
+  row("lone caller, ScopedParallelism", lone_ms);
+
+  // One core has nothing to oversubscribe.
+  if (cores > 1) {
+    EXPECT_LT(budgeted_ms, unmanaged_ms);
+  }
+}
+
+}  // namespace halo::common::threads
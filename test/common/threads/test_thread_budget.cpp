@@ -0,0 +1,132 @@
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <gtest/gtest.h>
+#include <omp.h>
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <utility>
+
+import halo.common;
+import halo.common.threads;
+
+namespace halo::common::threads {
+
+namespace {
+
+std::unique_ptr<ThreadBudget> makeBudget(std::uint32_t threads,
+                                         std::uint32_t executor_call_threads) {
+  auto budget = ThreadBudget::create(
+      {.threads = threads, .executor_call_threads = executor_call_threads});
+  EXPECT_TRUE(budget.ok()) << budget.status().toString();
+  return std::move(budget).value();
+}
+
+}  // namespace
+
+TEST(ThreadBudgetTest, CreateRejectsZeroCounts) {
+  EXPECT_FALSE(ThreadBudget::create({.threads = 0}).ok());
+  EXPECT_FALSE(
+      ThreadBudget::create({.threads = 4, .executor_call_threads = 0}).ok());
+  EXPECT_TRUE(ThreadBudget::create({.threads = 1}).ok());
+}
+
+TEST(ThreadBudgetTest, LeasesGetWhatIsFree) {
+  const auto budget = makeBudget(8, 1);
+  {
+    const auto first = budget->lease(3);
+    EXPECT_EQ(first.threads(), 3U);
+    // The rest of the budget, on top of the caller's own thread.
+    const auto second = budget->lease(0);
+    EXPECT_EQ(second.threads(), 7U);
+    // Nothing left: the caller runs alone.
+    const auto third = budget->lease(4);
+    EXPECT_EQ(third.threads(), 1U);
+    const auto stats = budget->stats();
+    EXPECT_EQ(stats.leases, 3U);
+    // Asking for all of it counts as capped when some is taken.
+    EXPECT_EQ(stats.capped, 2U);
+    EXPECT_EQ(stats.leased, 8U);
+  }
+  EXPECT_EQ(budget->stats().leased, 0U);
+  EXPECT_EQ(budget->lease(0).threads(), 8U);
+}
+
+TEST(ThreadBudgetTest, MovedLeaseReleasesOnce) {
+  const auto budget = makeBudget(8, 1);
+  auto lease = budget->lease(4);
+  {
+    const auto moved = std::move(lease);
+    EXPECT_EQ(moved.threads(), 4U);
+    EXPECT_EQ(budget->stats().leased, 3U);
+  }
+  EXPECT_EQ(budget->stats().leased, 0U);
+  lease = budget->lease(2);
+  EXPECT_EQ(budget->stats().leased, 1U);
+  lease = budget->lease(5);
+  EXPECT_EQ(budget->stats().leased, 4U);
+}
+
+TEST(ThreadBudgetTest, ReservationsLeaveLessToLease) {
+  const auto budget = makeBudget(8, 1);
+  const auto reservation = budget->reserve(6);
+  EXPECT_EQ(reservation.threads(), 6U);
+  EXPECT_EQ(budget->lease(0).threads(), 3U);
+  // Reservations are granted in full, even past the budget.
+  const auto more = budget->reserve(4);
+  EXPECT_EQ(budget->stats().reserved, 10U);
+  EXPECT_EQ(budget->lease(0).threads(), 1U);
+}
+
+TEST(ThreadBudgetTest, ExecutorThreadsAreCapped) {
+  const auto budget = makeBudget(8, 2);
+  EXPECT_FALSE(ThreadBudget::onExecutorThread());
+  {
+    const ExecutorThreadScope scope;
+    EXPECT_TRUE(ThreadBudget::onExecutorThread());
+    EXPECT_EQ(budget->lease(0).threads(), 2U);
+    EXPECT_EQ(budget->lease(1).threads(), 1U);
+  }
+  EXPECT_FALSE(ThreadBudget::onExecutorThread());
+  EXPECT_EQ(budget->lease(0).threads(), 8U);
+}
+
+TEST(ThreadBudgetTest, BudgetedExecutorReservesAndMarksItsThreads) {
+  const auto budget = makeBudget(8, 1);
+  auto executor = makeBudgetedExecutor(*budget, 3, "BudgetTest");
+  EXPECT_EQ(budget->stats().reserved, 3U);
+
+  std::promise<std::pair<bool, std::uint32_t>> seen;
+  executor->add([&] {
+    const ScopedParallelism parallelism(*budget, 4);
+    seen.set_value({ThreadBudget::onExecutorThread(), parallelism.threads()});
+  });
+  const auto [on_executor, threads] = seen.get_future().get();
+  EXPECT_TRUE(on_executor);
+  EXPECT_EQ(threads, 1U);
+  EXPECT_EQ(budget->lease(0).threads(), 6U);
+
+  executor.reset();
+  EXPECT_EQ(budget->stats().reserved, 0U);
+}
+
+TEST(ThreadBudgetTest, ScopedParallelismSizesOpenMp) {
+  const auto budget = makeBudget(8, 1);
+  omp_set_num_threads(5);
+  {
+    const ScopedParallelism parallelism(*budget, 3);
+    EXPECT_EQ(parallelism.threads(), 3U);
+    EXPECT_EQ(omp_get_max_threads(), 3);
+    int team = 0;
+#pragma omp parallel
+    {
+#pragma omp single
+      team = omp_get_num_threads();
+    }
+    EXPECT_LE(team, 3);
+  }
+  EXPECT_EQ(omp_get_max_threads(), 5);
+  EXPECT_EQ(budget->stats().leased, 0U);
+}
+
+}  // namespace halo::common::threads
@@ -0,0 +1,387 @@
+#include <gtest/gtest.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/core/Expressions.h>
+#include <velox/core/QueryCtx.h>
+#include <velox/expression/EvalCtx.h>
+#include <velox/expression/Expr.h>
+#include <velox/type/Type.h>
+#include <velox/type/Variant.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/DecodedVector.h>
+#include <velox/vector/FlatVector.h>
+#include <velox/vector/SelectivityVector.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+import halo.common;
+import halo.exec.crypto;
+
+namespace halo::exec::crypto {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+const unsigned char* unsignedBytes(std::string_view value) {
+  return reinterpret_cast<const unsigned char*>(value.data());
+}
+
+std::string toHex(std::string_view bytes) {
+  static constexpr char kDigits[] = "0123456789abcdef";
+  std::string hex;
+  for (const auto byte : bytes) {
+    hex.push_back(kDigits[static_cast<std::uint8_t>(byte) >> 4]);
+    hex.push_back(kDigits[static_cast<std::uint8_t>(byte) & 0xF]);
+  }
+  return hex;
+}
+
+// Through EVP a value at a time, as the kernels' reference.
+std::string referenceSha256(std::string_view value) {
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int size = 0;
+  EVP_Digest(value.data(), value.size(), digest, &size, EVP_sha256(),
+             nullptr);
+  return std::string(reinterpret_cast<const char*>(digest), size);
+}
+
+std::string referenceHmac(std::string_view key, std::string_view value) {
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int size = 0;
+  HMAC(EVP_sha256(), key.data(), static_cast<int>(key.size()),
+       unsignedBytes(value), value.size(), digest, &size);
+  return std::string(reinterpret_cast<const char*>(digest), size);
+}
+
+// Random bytes of every length from 0 to 400, three of each: one, two,
+// several blocks for the lanes, and past kMaxLaneBlocks for OpenSSL.
+std::vector<std::string> makeValues() {
+  std::mt19937 random(11);
+  std::vector<std::string> values;
+  for (std::size_t size = 0; size <= 400; ++size) {
+    for (int copy = 0; copy < 3; ++copy) {
+      std::string value(size, '\0');
+      for (auto& byte : value) {
+        byte = static_cast<char>(random());
+      }
+      values.push_back(std::move(value));
+    }
+  }
+  return values;
+}
+
+std::string digestAt(const std::vector<std::uint8_t>& digests,
+                     std::size_t i) {
+  return std::string(
+      reinterpret_cast<const char*>(digests.data() + kSha256Bytes * i),
+      kSha256Bytes);
+}
+
+}  // namespace
+
+TEST(Sha256LanesTest, KnownDigests) {
+  const std::vector<std::string_view> values = {
+      "", "abc", "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"};
+  std::vector<std::uint8_t> digests(kSha256Bytes * values.size());
+  sha256Batch(values, digests.data());
+  EXPECT_EQ(
+      toHex(digestAt(digests, 0)),
+      "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  EXPECT_EQ(
+      toHex(digestAt(digests, 1)),
+      "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+  EXPECT_EQ(
+      toHex(digestAt(digests, 2)),
+      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+}
+
+TEST(Sha256LanesTest, BatchMatchesOpenSsl) {
+  const auto values = makeValues();
+  const std::vector<std::string_view> views(values.begin(), values.end());
+  std::vector<std::uint8_t> digests(kSha256Bytes * views.size());
+  sha256Batch(views, digests.data());
+  for (std::size_t i = 0; i < views.size(); ++i) {
+    ASSERT_EQ(digestAt(digests, i), referenceSha256(views[i]))
+        << views[i].size() << " bytes";
+  }
+}
+
+TEST(Sha256LanesTest, HmacMatchesOpenSsl) {
+  // RFC 4231, test cases 2 and 6.
+  {
+    const HmacSha256 hmac("Jefe");
+    const std::vector<std::string_view> values = {
+        "what do ya want for nothing?"};
+    std::vector<std::uint8_t> digests(kSha256Bytes);
+    hmac.hash(values, digests.data());
+    EXPECT_EQ(
+        toHex(digestAt(digests, 0)),
+        "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+  }
+  {
+    const HmacSha256 hmac(std::string(131, '\xAA'));
+    const std::vector<std::string_view> values = {
+        "Test Using Larger Than Block-Size Key - Hash Key First"};
+    std::vector<std::uint8_t> digests(kSha256Bytes);
+    hmac.hash(values, digests.data());
+    EXPECT_EQ(
+        toHex(digestAt(digests, 0)),
+        "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54");
+  }
+
+  const auto values = makeValues();
+  const std::vector<std::string_view> views(values.begin(), values.end());
+  std::vector<std::uint8_t> digests(kSha256Bytes * views.size());
+  for (const auto& key :
+       {std::string(), std::string("pii-key"), std::string(64, 'k'),
+        std::string(100, 'x')}) {
+    HmacSha256(key).hash(views, digests.data());
+    for (std::size_t i = 0; i < views.size(); ++i) {
+      ASSERT_EQ(digestAt(digests, i), referenceHmac(key, views[i]))
+          << key.size() << "-byte key, " << views[i].size() << " bytes";
+    }
+  }
+}
+
+TEST(AesGcmTest, SealsAndOpens) {
+  const auto values = makeValues();
+  for (const std::size_t key_size : {16, 24, 32}) {
+    const std::string key(key_size, '\x42');
+    auto encryptor = AesGcm::create(key, AesGcmMode::kEncrypt);
+    auto decryptor = AesGcm::create(key, AesGcmMode::kDecrypt);
+    ASSERT_TRUE(encryptor.ok()) << encryptor.status().toString();
+    ASSERT_TRUE(decryptor.ok()) << decryptor.status().toString();
+    const auto nonces = randomNonces(values.size());
+    ASSERT_TRUE(nonces.ok()) << nonces.status().toString();
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      const auto& value = values[i];
+      std::vector<std::uint8_t> sealed(value.size() + kAesGcmOverhead);
+      ASSERT_TRUE(encryptor
+                      ->seal(value, nonces->data() + kAesGcmNonceBytes * i,
+                             sealed.data())
+                      .ok());
+      const std::string_view sealed_view(
+          reinterpret_cast<const char*>(sealed.data()), sealed.size());
+      std::vector<std::uint8_t> opened(value.size() + 1);
+      ASSERT_TRUE(decryptor->open(sealed_view, opened.data()).ok());
+      ASSERT_EQ(std::string_view(reinterpret_cast<const char*>(
+                                     opened.data()),
+                                 value.size()),
+                value);
+    }
+  }
+}
+
+TEST(AesGcmTest, OpenSslOpensWhatItSeals) {
+  // Sealed here, opened with OpenSSL directly: a nonce, the ciphertext
+  // and the tag, nothing else.
+  const std::string key("\xfe\xff\xe9\x92\x86\x65\x73\x1c\x6d\x6a\x8f\x94"
+                        "\x67\x30\x83\x08",
+                        16);
+  const std::string nonce("\xca\xfe\xba\xbe\xfa\xce\xdb\xad\xde\xca\xf8\x88",
+                          12);
+  auto encryptor = AesGcm::create(key, AesGcmMode::kEncrypt);
+  ASSERT_TRUE(encryptor.ok());
+  const std::string plaintext(64, '\x5a');
+  std::vector<std::uint8_t> sealed(plaintext.size() + kAesGcmOverhead);
+  ASSERT_TRUE(
+      encryptor->seal(plaintext, unsignedBytes(nonce), sealed.data()).ok());
+
+  auto* context = EVP_CIPHER_CTX_new();
+  ASSERT_EQ(EVP_DecryptInit_ex(context, EVP_aes_128_gcm(), nullptr,
+                               unsignedBytes(key), unsignedBytes(nonce)),
+            1);
+  std::vector<unsigned char> opened(plaintext.size());
+  int size = 0;
+  ASSERT_EQ(EVP_DecryptUpdate(context, opened.data(), &size,
+                              sealed.data() + kAesGcmNonceBytes,
+                              static_cast<int>(plaintext.size())),
+            1);
+  ASSERT_EQ(EVP_CIPHER_CTX_ctrl(
+                context, EVP_CTRL_GCM_SET_TAG, kAesGcmTagBytes,
+                sealed.data() + kAesGcmNonceBytes + plaintext.size()),
+            1);
+  int final_size = 0;
+  EXPECT_EQ(EVP_DecryptFinal_ex(context, opened.data() + size, &final_size),
+            1);
+  EVP_CIPHER_CTX_free(context);
+  EXPECT_EQ(std::string(opened.begin(), opened.end()), plaintext);
+}
+
+TEST(AesGcmTest, RejectsBadKeysAndAlteredValues) {
+  EXPECT_FALSE(AesGcm::create("short", AesGcmMode::kEncrypt).ok());
+  const std::string key(32, '\x07');
+  auto encryptor = AesGcm::create(key, AesGcmMode::kEncrypt);
+  auto decryptor = AesGcm::create(key, AesGcmMode::kDecrypt);
+  auto other = AesGcm::create(std::string(32, '\x08'), AesGcmMode::kDecrypt);
+  ASSERT_TRUE(encryptor.ok() && decryptor.ok() && other.ok());
+  const auto nonces = randomNonces(1);
+  ASSERT_TRUE(nonces.ok());
+  const std::string plaintext = "jane.doe@example.com";
+  std::vector<std::uint8_t> sealed(plaintext.size() + kAesGcmOverhead);
+  ASSERT_TRUE(encryptor->seal(plaintext, nonces->data(), sealed.data()).ok());
+  std::vector<std::uint8_t> opened(plaintext.size());
+  const auto view = [&] {
+    return std::string_view(reinterpret_cast<const char*>(sealed.data()),
+                            sealed.size());
+  };
+  EXPECT_FALSE(other->open(view(), opened.data()).ok());
+  EXPECT_FALSE(decryptor->open(view().substr(0, 20), opened.data()).ok());
+  EXPECT_FALSE(encryptor->open(view(), opened.data()).ok());
+  for (const std::size_t position : {0UL, 15UL, sealed.size() - 1}) {
+    sealed[position] ^= 1;
+    EXPECT_FALSE(decryptor->open(view(), opened.data()).ok()) << position;
+    sealed[position] ^= 1;
+  }
+  EXPECT_TRUE(decryptor->open(view(), opened.data()).ok());
+}
+
+TEST(AesGcmTest, NoncesDiffer) {
+  const auto nonces = randomNonces(10'000);
+  ASSERT_TRUE(nonces.ok());
+  std::set<std::string> distinct;
+  for (std::size_t i = 0; i < 10'000; ++i) {
+    distinct.emplace(
+        reinterpret_cast<const char*>(nonces->data() + kAesGcmNonceBytes * i),
+        kAesGcmNonceBytes);
+  }
+  EXPECT_EQ(distinct.size(), 10'000U);
+}
+
+TEST(CryptoFunctionsTest, VectorFunctionsUseTheKernels) {
+  registerCryptoFunctions("halo_");
+  auto root = velox::memory::memoryManager()->addRootPool("crypto");
+  auto pool = root->addLeafChild("crypto_leaf");
+  const std::vector<std::optional<std::string>> values = {
+      "jane.doe@example.com", std::string(300, 'p'), std::nullopt, ""};
+  const auto size = static_cast<velox::vector_size_t>(values.size());
+  auto text = velox::BaseVector::create<velox::FlatVector<velox::StringView>>(
+      velox::VARBINARY(), size, pool.get());
+  for (velox::vector_size_t i = 0; i < size; ++i) {
+    const auto& value = values[static_cast<std::size_t>(i)];
+    if (value.has_value()) {
+      text->set(i, velox::StringView(*value));
+    } else {
+      text->setNull(i, true);
+    }
+  }
+  const auto input = std::make_shared<velox::RowVector>(
+      pool.get(), velox::ROW({"pii"}, {velox::VARBINARY()}), nullptr, size,
+      std::vector<velox::VectorPtr>{text});
+
+  const std::string key(32, '\x11');
+  const auto column =
+      std::make_shared<velox::core::FieldAccessTypedExpr>(velox::VARBINARY(),
+                                                          "pii");
+  const auto constant_key = std::make_shared<velox::core::ConstantTypedExpr>(
+      velox::VARBINARY(), velox::variant::binary(key));
+  const auto call = [&](const std::string& name,
+                        std::vector<velox::core::TypedExprPtr> inputs) {
+    return std::make_shared<velox::core::CallTypedExpr>(
+        velox::VARBINARY(), std::move(inputs), name);
+  };
+  auto query_ctx = velox::core::QueryCtx::create();
+  velox::core::ExecCtx exec_ctx(pool.get(), query_ctx.get());
+  velox::exec::ExprSet expressions(
+      {call("halo_sha256", {column}),
+       call("halo_hmac_sha256", {column, constant_key}),
+       call("halo_aes_gcm_decrypt",
+            {call("halo_aes_gcm_encrypt", {column, constant_key}),
+             constant_key})},
+      &exec_ctx);
+  velox::exec::EvalCtx eval_ctx(&exec_ctx, &expressions, input.get());
+  velox::SelectivityVector rows(size);
+  std::vector<velox::VectorPtr> results(3);
+  expressions.eval(rows, eval_ctx, results);
+
+  const velox::DecodedVector hashes(*results[0]);
+  const velox::DecodedVector macs(*results[1]);
+  const velox::DecodedVector round_trip(*results[2]);
+  const auto string = [](const velox::DecodedVector& decoded,
+                         velox::vector_size_t row) {
+    return std::string(decoded.valueAt<velox::StringView>(row));
+  };
+  for (velox::vector_size_t row = 0; row < size; ++row) {
+    const auto& value = values[static_cast<std::size_t>(row)];
+    if (!value.has_value()) {
+      EXPECT_TRUE(hashes.isNullAt(row));
+      EXPECT_TRUE(macs.isNullAt(row));
+      EXPECT_TRUE(round_trip.isNullAt(row));
+      continue;
+    }
+    EXPECT_EQ(string(hashes, row), referenceSha256(*value));
+    EXPECT_EQ(string(macs, row), referenceHmac(key, *value));
+    EXPECT_EQ(string(round_trip, row), *value);
+  }
+}
+
+TEST(CryptoFunctionsTest, DictionaryRowsOfOneValueGetTheirOwnNonces) {
+  registerCryptoFunctions("halo_");
+  auto root = velox::memory::memoryManager()->addRootPool("crypto_dict");
+  auto pool = root->addLeafChild("crypto_dict_leaf");
+  // Two distinct values behind eight rows, as a low-cardinality column
+  // arrives from a dictionary-encoded file.
+  const std::vector<std::string> distinct = {"DE", "US"};
+  auto base = velox::BaseVector::create<velox::FlatVector<velox::StringView>>(
+      velox::VARBINARY(), 2, pool.get());
+  for (velox::vector_size_t i = 0; i < 2; ++i) {
+    base->set(i, velox::StringView(distinct[static_cast<std::size_t>(i)]));
+  }
+  constexpr velox::vector_size_t kRows = 8;
+  auto indices = velox::allocateIndices(kRows, pool.get());
+  auto* raw_indices = indices->asMutable<velox::vector_size_t>();
+  for (velox::vector_size_t row = 0; row < kRows; ++row) {
+    raw_indices[row] = row % 2;
+  }
+  const auto input = std::make_shared<velox::RowVector>(
+      pool.get(), velox::ROW({"country"}, {velox::VARBINARY()}), nullptr,
+      kRows,
+      std::vector<velox::VectorPtr>{velox::BaseVector::wrapInDictionary(
+          nullptr, indices, kRows, base)});
+
+  const std::string key(32, '\x22');
+  const auto constant_key = std::make_shared<velox::core::ConstantTypedExpr>(
+      velox::VARBINARY(), velox::variant::binary(key));
+  const auto encrypt = std::make_shared<velox::core::CallTypedExpr>(
+      velox::VARBINARY(),
+      std::vector<velox::core::TypedExprPtr>{
+          std::make_shared<velox::core::FieldAccessTypedExpr>(
+              velox::VARBINARY(), "country"),
+          constant_key},
+      "halo_aes_gcm_encrypt");
+  const auto decrypt = std::make_shared<velox::core::CallTypedExpr>(
+      velox::VARBINARY(),
+      std::vector<velox::core::TypedExprPtr>{encrypt, constant_key},
+      "halo_aes_gcm_decrypt");
+  auto query_ctx = velox::core::QueryCtx::create();
+  velox::core::ExecCtx exec_ctx(pool.get(), query_ctx.get());
+  velox::exec::ExprSet expressions({encrypt, decrypt}, &exec_ctx);
+  velox::exec::EvalCtx eval_ctx(&exec_ctx, &expressions, input.get());
+  velox::SelectivityVector rows(kRows);
+  std::vector<velox::VectorPtr> results(2);
+  expressions.eval(rows, eval_ctx, results);
+
+  const velox::DecodedVector sealed(*results[0]);
+  const velox::DecodedVector opened(*results[1]);
+  std::set<std::string> nonces;
+  for (velox::vector_size_t row = 0; row < kRows; ++row) {
+    const auto value = sealed.valueAt<velox::StringView>(row);
+    ASSERT_GE(value.size(), kAesGcmNonceBytes);
+    nonces.emplace(value.data(), kAesGcmNonceBytes);
+    EXPECT_EQ(std::string(opened.valueAt<velox::StringView>(row)),
+              distinct[static_cast<std::size_t>(row % 2)]);
+  }
+  EXPECT_EQ(nonces.size(), static_cast<std::size_t>(kRows));
+}
+
+}  // namespace halo::exec::crypto
@@ -0,0 +1,221 @@
+// Hashing GROUP BY and partitioning keys with KeyHasher against the path
+// the exchange used before it: Velox's hashValueAt() per column and row,
+// chained with bits::hashMix(). Reports the hashing rate over the key
+// bytes, then the time of a hash GROUP BY that sums a column over the same
+// keys with either hash.
+
+#include <gtest/gtest.h>
+#include <velox/common/base/BitUtil.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/StringView.h>
+#include <velox/type/Type.h>
+#include <velox/vector/BaseVector.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+import halo.common;
+import halo.exec.hash;
+
+namespace halo::exec::hash {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+constexpr velox::vector_size_t kBatchRows = 8192;
+constexpr std::size_t kBatches = 64;
+constexpr std::size_t kGroups = 100'000;
+
+double millisSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// The hashing the exchange did before KeyHasher.
+void hashMixed(const velox::RowVector& batch,
+               const std::vector<velox::column_index_t>& keys,
+               std::vector<std::uint64_t>& hashes) {
+  const auto size = batch.size();
+  hashes.assign(static_cast<std::size_t>(size), 0);
+  for (std::size_t k = 0; k < keys.size(); ++k) {
+    const auto* key = batch.childAt(keys[k])->loadedVector();
+    for (velox::vector_size_t row = 0; row < size; ++row) {
+      const std::uint64_t hash = key->hashValueAt(row);
+      hashes[row] = k == 0 ? hash : velox::bits::hashMix(hashes[row], hash);
+    }
+  }
+}
+
+// Batches of (customer bigint, region integer, sku varchar, amount bigint)
+// over kGroups distinct keys.
+std::vector<velox::RowVectorPtr> makeBatches(velox::memory::MemoryPool* pool,
+                                             std::size_t& key_bytes) {
+  const auto type =
+      velox::ROW({"customer", "region", "sku", "amount"},
+                 {velox::BIGINT(), velox::INTEGER(), velox::VARCHAR(),
+                  velox::BIGINT()});
+  std::mt19937_64 random(5);
+  std::vector<velox::RowVectorPtr> batches;
+  key_bytes = 0;
+  for (std::size_t b = 0; b < kBatches; ++b) {
+    auto customers = velox::BaseVector::create<velox::FlatVector<std::int64_t>>(
+        velox::BIGINT(), kBatchRows, pool);
+    auto regions = velox::BaseVector::create<velox::FlatVector<std::int32_t>>(
+        velox::INTEGER(), kBatchRows, pool);
+    auto skus = velox::BaseVector::create<velox::FlatVector<velox::StringView>>(
+        velox::VARCHAR(), kBatchRows, pool);
+    auto amounts = velox::BaseVector::create<velox::FlatVector<std::int64_t>>(
+        velox::BIGINT(), kBatchRows, pool);
+    for (velox::vector_size_t i = 0; i < kBatchRows; ++i) {
+      const auto group = random() % kGroups;
+      const auto sku = "SKU-" + std::to_string(group * 7919 % 1'000'003) +
+                       "-warehouse-" + std::to_string(group % 13);
+      customers->set(i, static_cast<std::int64_t>(group / 10));
+      regions->set(i, static_cast<std::int32_t>(group % 10));
+      skus->set(i, velox::StringView(sku));
+      amounts->set(i, static_cast<std::int64_t>(random() % 1000));
+      key_bytes += sizeof(std::int64_t) + sizeof(std::int32_t) + sku.size();
+    }
+    batches.push_back(std::make_shared<velox::RowVector>(
+        pool, type, nullptr, kBatchRows,
+        std::vector<velox::VectorPtr>{customers, regions, skus, amounts}));
+  }
+  return batches;
+}
+
+struct GroupKey {
+  std::int64_t customer;
+  std::int32_t region;
+  std::string sku;
+};
+
+// SUM(amount) GROUP BY customer, region, sku, in an open-addressing table
+// of group numbers probed with `hashes'. Returns the number of groups and
+// adds the sums into `total'.
+std::size_t groupBy(const std::vector<velox::RowVectorPtr>& batches,
+                    const std::function<void(const velox::RowVector&,
+                                             std::vector<std::uint64_t>&)>&
+                        hash,
+                    std::int64_t& total) {
+  constexpr std::uint32_t kEmpty = ~0U;
+  std::vector<std::uint32_t> slots(std::bit_ceil(kGroups * 2), kEmpty);
+  std::vector<std::uint64_t> slot_hashes(slots.size());
+  const auto mask = slots.size() - 1;
+  std::vector<GroupKey> keys;
+  std::vector<std::int64_t> sums;
+  std::vector<std::uint64_t> hashes;
+  for (const auto& batch : batches) {
+    hash(*batch, hashes);
+    const auto* customers = batch->childAt(0)->asFlatVector<std::int64_t>();
+    const auto* regions = batch->childAt(1)->asFlatVector<std::int32_t>();
+    const auto* skus = batch->childAt(2)->asFlatVector<velox::StringView>();
+    const auto* amounts = batch->childAt(3)->asFlatVector<std::int64_t>();
+    for (velox::vector_size_t row = 0; row < batch->size(); ++row) {
+      const auto customer = customers->valueAt(row);
+      const auto region = regions->valueAt(row);
+      const auto sku = skus->valueAt(row);
+      for (auto slot = hashes[row] & mask;; slot = (slot + 1) & mask) {
+        if (slots[slot] == kEmpty) {
+          slots[slot] = static_cast<std::uint32_t>(keys.size());
+          slot_hashes[slot] = hashes[row];
+          keys.push_back({customer, region, std::string(sku)});
+          sums.push_back(amounts->valueAt(row));
+          break;
+        }
+        if (slot_hashes[slot] != hashes[row]) {
+          continue;
+        }
+        const auto& key = keys[slots[slot]];
+        if (key.customer == customer && key.region == region &&
+            velox::StringView(key.sku) == sku) {
+          sums[slots[slot]] += amounts->valueAt(row);
+          break;
+        }
+      }
+    }
+  }
+  for (const auto sum : sums) {
+    total += sum;
+  }
+  return keys.size();
+}
+
+}  // namespace
+
+TEST(KeyHasherBenchmark, AgainstHashValueAtAndHashMix) {
+  auto root = velox::memory::memoryManager()->addRootPool("key_hasher");
+  auto pool = root->addLeafChild("key_hasher_leaf");
+  std::size_t key_bytes = 0;
+  const auto batches = makeBatches(pool.get(), key_bytes);
+  const std::vector<velox::column_index_t> keys = {0, 1, 2};
+  auto hasher = KeyHasher::create(velox::asRowType(batches[0]->type()), keys);
+  ASSERT_TRUE(hasher.ok()) << hasher.status().toString();
+
+  const auto mixed = [&](const velox::RowVector& batch,
+                         std::vector<std::uint64_t>& hashes) {
+    hashMixed(batch, keys, hashes);
+  };
+  const auto xxh3 = [&](const velox::RowVector& batch,
+                        std::vector<std::uint64_t>& hashes) {
+    hasher->hash(batch, hashes);
+  };
+
+  // Hashing alone, best of a few rounds.
+  const auto rate = [&](const auto& hash) {
+    double best_ms = 1e300;
+    std::uint64_t checksum = 0;
+    std::vector<std::uint64_t> hashes;
+    for (int round = 0; round < 5; ++round) {
+      const auto start = std::chrono::steady_clock::now();
+      for (const auto& batch : batches) {
+        hash(*batch, hashes);
+        checksum ^= hashes.back();
+      }
+      best_ms = std::min(best_ms, millisSince(start));
+    }
+    EXPECT_NE(checksum, 1U);
+    return static_cast<double>(key_bytes) / (best_ms * 1e6);
+  };
+  const auto mixed_gbps = rate(mixed);
+  const auto xxh3_gbps = rate(xxh3);
+
+  std::int64_t mixed_total = 0;
+  auto start = std::chrono::steady_clock::now();
+  const auto mixed_groups = groupBy(batches, mixed, mixed_total);
+  const auto mixed_ms = millisSince(start);
+  std::int64_t xxh3_total = 0;
+  start = std::chrono::steady_clock::now();
+  const auto xxh3_groups = groupBy(batches, xxh3, xxh3_total);
+  const auto xxh3_ms = millisSince(start);
+  EXPECT_EQ(xxh3_groups, mixed_groups);
+  EXPECT_EQ(xxh3_total, mixed_total);
+
+  std::cout << std::fixed << std::setprecision(2) << kBatches * kBatchRows
+            << " rows, " << key_bytes / 1e6 << " MB of keys, " << xxh3_groups
+            << " groups\n"
+            << std::left << std::setw(28) << "hash" << std::right
+            << std::setw(12) << "GB/s" << std::setw(16) << "group by ms"
+            << "\n";
+  const auto row = [](const char* name, double gbps, double ms) {
+    std::cout << std::left << std::setw(28) << name << std::right
+              << std::setw(12) << gbps << std::setw(16) << ms << "\n";
+  };
+  row("hashValueAt + hashMix", mixed_gbps, mixed_ms);
+  row("KeyHasher (xxh3)", xxh3_gbps, xxh3_ms);
+}
+
+}  // namespace halo::exec::hash
@@ -0,0 +1,203 @@
+#include <gtest/gtest.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/StringView.h>
+#include <velox/type/Type.h>
+#include <velox/vector/BaseVector.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+import halo.common;
+import halo.exec.hash;
+
+namespace halo::exec::hash {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+class KeyHasherTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = velox::memory::memoryManager()->addRootPool("key_hasher");
+    pool_ = root_->addLeafChild("key_hasher_leaf");
+  }
+
+  template <typename T>
+  velox::VectorPtr flat(const velox::TypePtr& type,
+                        const std::vector<std::optional<T>>& values) {
+    const auto size = static_cast<velox::vector_size_t>(values.size());
+    auto vector = velox::BaseVector::create<velox::FlatVector<T>>(
+        type, size, pool_.get());
+    for (velox::vector_size_t i = 0; i < size; ++i) {
+      const auto& value = values[static_cast<std::size_t>(i)];
+      if (value.has_value()) {
+        vector->set(i, *value);
+      } else {
+        vector->setNull(i, true);
+      }
+    }
+    return vector;
+  }
+
+  velox::RowVectorPtr row(std::vector<velox::VectorPtr> children) {
+    std::vector<std::string> names;
+    std::vector<velox::TypePtr> types;
+    for (const auto& child : children) {
+      names.push_back("c" + std::to_string(names.size()));
+      types.push_back(child->type());
+    }
+    const auto size = children.front()->size();
+    return std::make_shared<velox::RowVector>(
+        pool_.get(), velox::ROW(std::move(names), std::move(types)), nullptr,
+        size, std::move(children));
+  }
+
+  std::vector<std::uint64_t> hash(const velox::RowVectorPtr& batch,
+                                  std::vector<velox::column_index_t> keys) {
+    auto hasher = KeyHasher::create(velox::asRowType(batch->type()), keys);
+    EXPECT_TRUE(hasher.ok()) << hasher.status().toString();
+    std::vector<std::uint64_t> hashes;
+    hasher->hash(*batch, hashes);
+    return hashes;
+  }
+
+  std::shared_ptr<velox::memory::MemoryPool> root_;
+  std::shared_ptr<velox::memory::MemoryPool> pool_;
+};
+
+}  // namespace
+
+TEST_F(KeyHasherTest, EqualKeysHashAlikeWhateverTheEncoding) {
+  const std::vector<std::optional<std::int64_t>> ids = {7, 7, 8, 7};
+  const std::vector<std::optional<velox::StringView>> names = {
+      velox::StringView("a rather long string that is not inline"),
+      velox::StringView("a rather long string that is not inline"),
+      velox::StringView("a rather long string that is not inline"),
+      velox::StringView("short")};
+  const auto flat_hashes = hash(
+      row({flat(velox::BIGINT(), ids), flat(velox::VARCHAR(), names)}),
+      {0, 1});
+  EXPECT_EQ(flat_hashes[0], flat_hashes[1]);
+  EXPECT_NE(flat_hashes[0], flat_hashes[2]);
+  EXPECT_NE(flat_hashes[0], flat_hashes[3]);
+
+  // The same rows, as dictionaries over other orders and as constants.
+  const auto indices = velox::allocateIndices(4, pool_.get());
+  auto* raw = indices->asMutable<velox::vector_size_t>();
+  const std::vector<velox::vector_size_t> order = {3, 2, 1, 0};
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    raw[i] = order[i];
+  }
+  const auto reversed = [&](const velox::VectorPtr& base) {
+    return velox::BaseVector::wrapInDictionary(nullptr, indices, 4, base);
+  };
+  const std::vector<std::optional<std::int64_t>> reversed_ids = {7, 8, 7, 7};
+  const std::vector<std::optional<velox::StringView>> reversed_names = {
+      names[3], names[2], names[1], names[0]};
+  const auto dictionary_hashes =
+      hash(row({reversed(flat(velox::BIGINT(), reversed_ids)),
+                reversed(flat(velox::VARCHAR(), reversed_names))}),
+           {0, 1});
+  EXPECT_EQ(dictionary_hashes, flat_hashes);
+
+  const auto constant_hashes =
+      hash(row({velox::BaseVector::wrapInConstant(
+                    4, 0, flat(velox::BIGINT(), ids)),
+                velox::BaseVector::wrapInConstant(
+                    4, 0, flat(velox::VARCHAR(), names))}),
+           {0, 1});
+  for (const auto value : constant_hashes) {
+    EXPECT_EQ(value, flat_hashes[0]);
+  }
+}
+
+TEST_F(KeyHasherTest, NullsAreApartFromZeroAndEmpty) {
+  const auto hashes = hash(
+      row({flat<std::int32_t>(velox::INTEGER(), {0, std::nullopt, 0}),
+           flat<velox::StringView>(
+               velox::VARCHAR(),
+               {velox::StringView(""), velox::StringView(""), std::nullopt})}),
+      {0, 1});
+  EXPECT_NE(hashes[0], hashes[1]);
+  EXPECT_NE(hashes[0], hashes[2]);
+  EXPECT_NE(hashes[1], hashes[2]);
+}
+
+TEST_F(KeyHasherTest, FloatsHashAsTheyCompare) {
+  const auto nan = std::numeric_limits<double>::quiet_NaN();
+  const auto hashes = hash(
+      row({flat<double>(velox::DOUBLE(),
+                        {0.0, -0.0, nan, -nan, std::nan("1"), 1.0})}),
+      {0});
+  EXPECT_EQ(hashes[0], hashes[1]);
+  EXPECT_EQ(hashes[2], hashes[3]);
+  EXPECT_EQ(hashes[2], hashes[4]);
+  EXPECT_NE(hashes[0], hashes[5]);
+}
+
+TEST_F(KeyHasherTest, KeyOrderMatters) {
+  const auto batch = row({flat<std::int64_t>(velox::BIGINT(), {1, 2}),
+                          flat<std::int64_t>(velox::BIGINT(), {2, 1})});
+  const auto hashes = hash(batch, {0, 1});
+  EXPECT_NE(hashes[0], hashes[1]);
+  EXPECT_EQ(hash(batch, {1, 0})[0], hashes[1]);
+}
+
+TEST_F(KeyHasherTest, SpreadsSequentialKeysEvenly) {
+  // Dense integer keys, the usual shape of ids, into 64 partitions.
+  constexpr std::size_t kRows = 64 * 1024;
+  constexpr std::size_t kPartitions = 64;
+  std::vector<std::optional<std::int64_t>> ids;
+  std::vector<std::optional<std::int32_t>> days;
+  for (std::size_t i = 0; i < kRows; ++i) {
+    ids.push_back(static_cast<std::int64_t>(i / 16));
+    days.push_back(static_cast<std::int32_t>(i % 16));
+  }
+  const auto hashes = hash(row({flat(velox::BIGINT(), ids),
+                                flat(velox::INTEGER(), days)}),
+                           {0, 1});
+  std::vector<std::size_t> counts(kPartitions);
+  std::unordered_set<std::uint64_t> distinct;
+  for (const auto value : hashes) {
+    ++counts[value % kPartitions];
+    distinct.insert(value);
+  }
+  EXPECT_EQ(distinct.size(), kRows);
+  // Chi-squared over 63 degrees of freedom; 110 is far in the tail.
+  const double expected = static_cast<double>(kRows) / kPartitions;
+  double chi_squared = 0;
+  for (const auto count : counts) {
+    const double delta = static_cast<double>(count) - expected;
+    chi_squared += delta * delta / expected;
+  }
+  EXPECT_LT(chi_squared, 110.0);
+}
+
+TEST_F(KeyHasherTest, RejectsBadKeys) {
+  const auto type = velox::ROW({"a"}, {velox::BIGINT()});
+  EXPECT_FALSE(KeyHasher::create(type, {}).ok());
+  EXPECT_FALSE(KeyHasher::create(type, {1}).ok());
+}
+
+TEST(StringHashTest, LooksUpByView) {
+  std::unordered_map<std::string, int, StringHash, std::equal_to<>> map;
+  map.emplace("abc|orders@3", 1);
+  EXPECT_EQ(map.find(std::string_view("abc|orders@3"))->second, 1);
+  EXPECT_EQ(StringHash{}("abc"), hashBytes("abc"));
+  EXPECT_NE(hashBytes("abc"), hashBytes("abc", 1));
+}
+
+}  // namespace halo::exec::hash
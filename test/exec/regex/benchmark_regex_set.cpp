@@ -0,0 +1,142 @@
+// An OR of many patterns over a log column, the shape of an alerting rule
+// set: every pattern matched on its own, with programs compiled per batch
+// as a task without a cache would and once through the cache, against all
+// patterns matched together by one RE2::Set.
+
+#include <gtest/gtest.h>
+#include <re2/re2.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+import halo.common;
+import halo.exec.regex;
+
+namespace halo::exec::regex {
+
+namespace {
+
+constexpr std::size_t kPatterns = 300;
+constexpr std::size_t kLines = 100'000;
+constexpr std::size_t kBatch = 10'000;
+
+double millisSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Rules like `service-17 .*(timeout|refused) code=4\d\d', few of which any
+// one line matches.
+std::vector<std::string> makePatterns() {
+  const std::vector<std::string> errors = {"timeout", "refused", "reset",
+                                           "denied", "exhausted"};
+  std::vector<std::string> patterns;
+  for (std::size_t i = 0; i < kPatterns; ++i) {
+    patterns.push_back("service-" + std::to_string(i) + " .*(" +
+                       errors[i % errors.size()] + "|" +
+                       errors[(i + 2) % errors.size()] + ") code=" +
+                       std::to_string(4 + i % 2) + "\\d\\d");
+  }
+  return patterns;
+}
+
+std::vector<std::string> makeLines() {
+  const std::vector<std::string> words = {
+      "request", "served", "timeout", "refused", "cache", "miss",
+      "user",    "login",  "reset",   "ok",      "slow",  "retry"};
+  std::mt19937 random(3);
+  std::vector<std::string> lines;
+  for (std::size_t i = 0; i < kLines; ++i) {
+    std::string line = "service-" + std::to_string(random() % 1000);
+    for (int w = 0; w < 8; ++w) {
+      line += ' ';
+      line += words[random() % words.size()];
+    }
+    line += " code=" + std::to_string(200 + random() % 400);
+    lines.push_back(std::move(line));
+  }
+  return lines;
+}
+
+}  // namespace
+
+TEST(RegexSetBenchmark, SetAgainstOnePatternAtATime) {
+  const auto patterns = makePatterns();
+  const auto lines = makeLines();
+
+  // One by one, compiling every pattern again for each batch.
+  auto start = std::chrono::steady_clock::now();
+  std::uint64_t uncached_matches = 0;
+  for (std::size_t begin = 0; begin < kLines; begin += kBatch) {
+    std::vector<std::unique_ptr<RE2>> regexes;
+    for (const auto& pattern : patterns) {
+      regexes.push_back(std::make_unique<RE2>(pattern));
+    }
+    for (std::size_t i = begin; i < std::min(begin + kBatch, kLines); ++i) {
+      uncached_matches += static_cast<std::uint64_t>(
+          std::any_of(regexes.begin(), regexes.end(), [&](const auto& re) {
+            return RE2::PartialMatch(lines[i], *re);
+          }));
+    }
+  }
+  const auto uncached_ms = millisSince(start);
+
+  // One by one through the cache.
+  auto cache = RegexCache::create();
+  start = std::chrono::steady_clock::now();
+  std::uint64_t cached_matches = 0;
+  for (std::size_t begin = 0; begin < kLines; begin += kBatch) {
+    std::vector<std::shared_ptr<const RE2>> regexes;
+    for (const auto& pattern : patterns) {
+      auto regex = cache->get(pattern);
+      ASSERT_TRUE(regex.ok()) << regex.status().toString();
+      regexes.push_back(std::move(regex).value());
+    }
+    for (std::size_t i = begin; i < std::min(begin + kBatch, kLines); ++i) {
+      cached_matches += static_cast<std::uint64_t>(
+          std::any_of(regexes.begin(), regexes.end(), [&](const auto& re) {
+            return RE2::PartialMatch(lines[i], *re);
+          }));
+    }
+  }
+  const auto cached_ms = millisSince(start);
+
+  // All together.
+  start = std::chrono::steady_clock::now();
+  std::uint64_t set_matches = 0;
+  for (std::size_t begin = 0; begin < kLines; begin += kBatch) {
+    auto set = cache->getSet(patterns);
+    ASSERT_TRUE(set.ok()) << set.status().toString();
+    for (std::size_t i = begin; i < std::min(begin + kBatch, kLines); ++i) {
+      set_matches += static_cast<std::uint64_t>((*set)->matchesAny(lines[i]));
+    }
+  }
+  const auto set_ms = millisSince(start);
+
+  EXPECT_EQ(cached_matches, uncached_matches);
+  EXPECT_EQ(set_matches, uncached_matches);
+
+  std::cout << std::fixed << std::setprecision(2) << kLines << " lines, "
+            << kPatterns << " patterns, " << set_matches << " matching\n"
+            << std::left << std::setw(24) << "strategy" << std::right
+            << std::setw(12) << "ms" << std::setw(12) << "speedup" << "\n";
+  const auto row = [&](const char* name, double ms) {
+    std::cout << std::left << std::setw(24) << name << std::right
+              << std::setw(12) << ms << std::setw(12)
+              << uncached_ms / std::max(ms, 1e-3) << "\n";
+  };
+  row("one by one, uncached", uncached_ms);
+  row("one by one, cached", cached_ms);
+  row("RE2::Set, cached", set_ms);
+}
+
+}  // namespace halo::exec::regex
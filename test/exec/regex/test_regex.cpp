@@ -0,0 +1,293 @@
+#include <gtest/gtest.h>
+#include <re2/re2.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/core/Expressions.h>
+#include <velox/core/QueryCtx.h>
+#include <velox/expression/EvalCtx.h>
+#include <velox/expression/Expr.h>
+#include <velox/functions/prestosql/registration/RegistrationFunctions.h>
+#include <velox/type/Type.h>
+#include <velox/type/Variant.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/DecodedVector.h>
+#include <velox/vector/FlatVector.h>
+#include <velox/vector/SelectivityVector.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+import halo.common;
+import halo.exec.regex;
+
+namespace halo::exec::regex {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+using common::base::Status;
+
+const std::vector<std::optional<std::string>> kLog = {
+    "GET /health 200 3ms",
+    "POST /login 401 user=alice",
+    "ERROR disk full on /var/log",
+    "connection timeout after 30s",
+    "GET /orders/17 500 internal error",
+    std::nullopt,
+    "50% of workers busy",
+    "warn: retry 3 of 5",
+};
+
+velox::core::TypedExprPtr field(const std::string& name,
+                                const velox::TypePtr& type) {
+  return std::make_shared<velox::core::FieldAccessTypedExpr>(type, name);
+}
+
+velox::core::TypedExprPtr varchar(const std::string& value) {
+  return std::make_shared<velox::core::ConstantTypedExpr>(
+      velox::VARCHAR(), velox::variant(value));
+}
+
+velox::core::TypedExprPtr bigint(std::int64_t value) {
+  return std::make_shared<velox::core::ConstantTypedExpr>(
+      velox::BIGINT(), velox::variant(value));
+}
+
+velox::core::TypedExprPtr call(const std::string& name,
+                               std::vector<velox::core::TypedExprPtr> inputs,
+                               const velox::TypePtr& type = velox::BOOLEAN()) {
+  return std::make_shared<velox::core::CallTypedExpr>(type, std::move(inputs),
+                                                      name);
+}
+
+class RegexTest : public ::testing::Test {
+ protected:
+  static void SetUpTestSuite() {
+    velox::functions::prestosql::registerAllScalarFunctions();
+    registerRegexFunctions();
+  }
+
+  void SetUp() override {
+    root_ = velox::memory::memoryManager()->addRootPool("regex");
+    pool_ = root_->addLeafChild("regex_leaf");
+    const auto size = static_cast<velox::vector_size_t>(kLog.size());
+    auto messages =
+        velox::BaseVector::create<velox::FlatVector<velox::StringView>>(
+            velox::VARCHAR(), size, pool_.get());
+    auto codes = velox::BaseVector::create<velox::FlatVector<std::int64_t>>(
+        velox::BIGINT(), size, pool_.get());
+    for (velox::vector_size_t i = 0; i < size; ++i) {
+      const auto& line = kLog[static_cast<std::size_t>(i)];
+      codes->set(i, i);
+      if (line.has_value()) {
+        messages->set(i, velox::StringView(*line));
+      } else {
+        messages->setNull(i, true);
+      }
+    }
+    input_ = std::make_shared<velox::RowVector>(
+        pool_.get(),
+        velox::ROW({"message", "code"}, {velox::VARCHAR(), velox::BIGINT()}),
+        nullptr, size, std::vector<velox::VectorPtr>{messages, codes});
+  }
+
+  velox::VectorPtr eval(const velox::core::TypedExprPtr& expression) {
+    auto query_ctx = velox::core::QueryCtx::create();
+    velox::core::ExecCtx exec_ctx(pool_.get(), query_ctx.get());
+    velox::exec::ExprSet expressions({expression}, &exec_ctx);
+    velox::exec::EvalCtx eval_ctx(&exec_ctx, &expressions, input_.get());
+    velox::SelectivityVector rows(input_->size());
+    std::vector<velox::VectorPtr> results(1);
+    expressions.eval(rows, eval_ctx, results);
+    return results[0];
+  }
+
+  std::shared_ptr<velox::memory::MemoryPool> root_;
+  std::shared_ptr<velox::memory::MemoryPool> pool_;
+  velox::RowVectorPtr input_;
+};
+
+}  // namespace
+
+TEST(RegexCacheTest, CompilesEachPatternOnce) {
+  auto cache = RegexCache::create(2, 1);
+  auto first = cache->get("err(or)?");
+  ASSERT_TRUE(first.ok()) << first.status().toString();
+  auto again = cache->get("err(or)?");
+  ASSERT_TRUE(again.ok());
+  EXPECT_EQ(first->get(), again->get());
+  // The options are part of the key.
+  auto folded = cache->get("err(or)?", {.case_sensitive = false});
+  ASSERT_TRUE(folded.ok());
+  EXPECT_NE(first->get(), folded->get());
+  EXPECT_TRUE(RE2::PartialMatch("ERROR", **folded));
+
+  // A third program evicts the least recently used one, which its users
+  // still hold.
+  ASSERT_TRUE(cache->get("timeout").ok());
+  EXPECT_TRUE(RE2::PartialMatch("error", **first));
+  auto stats = cache->stats();
+  EXPECT_EQ(stats.hits, 1U);
+  EXPECT_EQ(stats.misses, 3U);
+  EXPECT_EQ(stats.evictions, 1U);
+  EXPECT_EQ(stats.regexes, 2U);
+
+  EXPECT_EQ(cache->get("(unclosed").status().code(), Status::Code::kInvalid);
+  EXPECT_EQ(cache->stats().regexes, 2U);
+
+  auto set = cache->getSet({"a", "b"});
+  ASSERT_TRUE(set.ok());
+  EXPECT_EQ(cache->getSet({"a", "b"})->get(), set->get());
+  // Order matters: it decides the indexes a set reports.
+  EXPECT_NE(cache->getSet({"b", "a"})->get(), set->get());
+  EXPECT_EQ(cache->stats().sets, 1U);
+}
+
+TEST(LikePatternTest, MatchesWhatLikeDoes) {
+  const auto matches = [](const std::string& like, const std::string& text,
+                          std::optional<char> escape = std::nullopt) {
+    auto regex = likeToRegex(like, escape);
+    EXPECT_TRUE(regex.ok()) << regex.status().toString();
+    return RE2::PartialMatch(text, RE2(*regex));
+  };
+  EXPECT_TRUE(matches("GET %", "GET /health"));
+  EXPECT_FALSE(matches("GET %", "a GET /health"));
+  EXPECT_TRUE(matches("%error", "internal\nerror"));
+  EXPECT_TRUE(matches("a_c", "a\xC3\xA9" "c"));
+  EXPECT_FALSE(matches("a_c", "abbc"));
+  EXPECT_TRUE(matches("1+1=_", "1+1=2"));
+  EXPECT_TRUE(matches("50#%%", "50% busy", '#'));
+  EXPECT_FALSE(matches("50#%%", "500 busy", '#'));
+
+  EXPECT_EQ(likeToRegex("50#", '#').status().code(), Status::Code::kInvalid);
+  EXPECT_EQ(likeToRegex("5#0", '#').status().code(), Status::Code::kInvalid);
+}
+
+TEST(PatternSetTest, AgreesWithMatchingOneByOne) {
+  std::vector<std::string> patterns = {
+      "^GET ", "\\b5\\d\\d\\b", "(?i)error", "timeout", "user=\\w+",
+      "retry \\d+ of \\d+", "^$",
+  };
+  auto set = PatternSet::create(patterns);
+  ASSERT_TRUE(set.ok()) << set.status().toString();
+  EXPECT_EQ((*set)->size(), patterns.size());
+  std::vector<int> matched;
+  for (const auto& line : kLog) {
+    if (!line.has_value()) {
+      continue;
+    }
+    std::vector<int> expected;
+    for (std::size_t i = 0; i < patterns.size(); ++i) {
+      if (RE2::PartialMatch(*line, RE2(patterns[i]))) {
+        expected.push_back(static_cast<int>(i));
+      }
+    }
+    (*set)->match(*line, matched);
+    EXPECT_EQ(matched, expected) << *line;
+    EXPECT_EQ((*set)->matchesAny(*line), !expected.empty()) << *line;
+  }
+
+  EXPECT_EQ(PatternSet::create({}).status().code(), Status::Code::kInvalid);
+  EXPECT_EQ(PatternSet::create({"ok", "(bad"}).status().code(),
+            Status::Code::kInvalid);
+}
+
+TEST_F(RegexTest, FoldsOrChainsIntoOnePatternSet) {
+  const auto message = field("message", velox::VARCHAR());
+  // regexp_like(message, 'timeout') OR code = 1 OR
+  //   (like(message, 'GET %') OR regexp_like(message, '(?i)error'))
+  //   OR like(message, '50#%%', '#')
+  const auto original = call(
+      "or",
+      {call("regexp_like", {message, varchar("timeout")}),
+       call("eq", {field("code", velox::BIGINT()), bigint(1)}),
+       call("or", {call("like", {message, varchar("GET %")}),
+                   call("regexp_like", {message, varchar("(?i)error")})}),
+       call("like", {message, varchar("50#%%"), varchar("#")})});
+
+  const auto rewritten = rewriteOrChains(original);
+  const auto* top =
+      dynamic_cast<const velox::core::CallTypedExpr*>(rewritten.get());
+  ASSERT_NE(top, nullptr);
+  EXPECT_EQ(top->name(), "or");
+  ASSERT_EQ(top->inputs().size(), 2U);
+  const auto* any =
+      dynamic_cast<const velox::core::CallTypedExpr*>(top->inputs()[0].get());
+  ASSERT_NE(any, nullptr);
+  EXPECT_EQ(any->name(), "regexp_like_any");
+  EXPECT_EQ(any->inputs().size(), 5U);
+
+  const velox::DecodedVector expected(*eval(original));
+  const velox::DecodedVector actual(*eval(rewritten));
+  for (velox::vector_size_t row = 0; row < input_->size(); ++row) {
+    ASSERT_EQ(actual.isNullAt(row), expected.isNullAt(row)) << row;
+    if (!expected.isNullAt(row)) {
+      EXPECT_EQ(actual.valueAt<bool>(row), expected.valueAt<bool>(row))
+          << row;
+    }
+  }
+}
+
+TEST_F(RegexTest, LeavesShortChainsAlone) {
+  const auto message = field("message", velox::VARCHAR());
+  const auto single =
+      call("or", {call("regexp_like", {message, varchar("timeout")}),
+                  call("eq", {field("code", velox::BIGINT()), bigint(1)})});
+  EXPECT_EQ(rewriteOrChains(single), single);
+
+  // An OR under an AND is still found.
+  const auto nested = call(
+      "and", {call("or", {call("regexp_like", {message, varchar("a")}),
+                          call("regexp_like", {message, varchar("b")})}),
+              call("regexp_like", {message, varchar("c")})});
+  const auto rewritten = rewriteOrChains(nested);
+  const auto* conjunction =
+      dynamic_cast<const velox::core::CallTypedExpr*>(rewritten.get());
+  ASSERT_NE(conjunction, nullptr);
+  const auto* any = dynamic_cast<const velox::core::CallTypedExpr*>(
+      conjunction->inputs()[0].get());
+  ASSERT_NE(any, nullptr);
+  EXPECT_EQ(any->name(), "regexp_like_any");
+}
+
+TEST_F(RegexTest, KeepsChainsWhoseSetDoesNotCompile) {
+  // Each pattern compiles on its own; as a set they exceed RE2's default
+  // memory limit, which would fail every evaluation of regexp_like_any.
+  const auto message = field("message", velox::VARCHAR());
+  const auto chain =
+      call("or", {call("regexp_like", {message, varchar("\\pL{200}x")}),
+                  call("regexp_like", {message, varchar("\\pL{200}y")})});
+  ASSERT_FALSE(
+      RegexCache::global().getSet({"\\pL{200}x", "\\pL{200}y"}).ok());
+  EXPECT_EQ(rewriteOrChains(chain), chain);
+}
+
+TEST_F(RegexTest, ReportsWhichPatternsMatched) {
+  const auto result = eval(
+      call("regexp_matching_patterns",
+           {field("message", velox::VARCHAR()), varchar("^GET "),
+            varchar("\\b5\\d\\d\\b"), varchar("(?i)error")},
+           velox::ARRAY(velox::INTEGER())));
+  const auto* arrays = result->as<velox::ArrayVector>();
+  ASSERT_NE(arrays, nullptr);
+  const auto* positions =
+      arrays->elements()->as<velox::SimpleVector<std::int32_t>>();
+  const auto positionsAt = [&](velox::vector_size_t row) {
+    std::vector<std::int32_t> values;
+    for (velox::vector_size_t i = 0; i < arrays->sizeAt(row); ++i) {
+      values.push_back(positions->valueAt(arrays->offsetAt(row) + i));
+    }
+    return values;
+  };
+  EXPECT_EQ(positionsAt(0), (std::vector<std::int32_t>{1}));
+  EXPECT_EQ(positionsAt(1), (std::vector<std::int32_t>{}));
+  EXPECT_EQ(positionsAt(2), (std::vector<std::int32_t>{3}));
+  EXPECT_EQ(positionsAt(4), (std::vector<std::int32_t>{1, 2, 3}));
+  EXPECT_TRUE(arrays->isNullAt(5));
+}
+
+}  // namespace halo::exec::regex
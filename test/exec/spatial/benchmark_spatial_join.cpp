@@ -0,0 +1,167 @@
+// Point-in-polygon join against the nested loop it replaces: build and probe
+// time of the STRtree join, the nested loop timed on a sample of the points
+// and scaled up, and the time the join would take for 100M points at the
+// measured rate. Polygons are 64-gons, so exact tests dominate the loop.
+
+#include <geos_c.h>
+#include <gtest/gtest.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <numbers>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+import halo.common;
+import halo.exec.spatial;
+
+namespace halo::exec::spatial {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+constexpr std::size_t kPolygons = 5'000;
+constexpr std::size_t kPoints = 1'000'000;
+constexpr std::size_t kBatch = 10'000;
+constexpr std::size_t kNestedLoopSample = 2'000;
+constexpr int kVertices = 64;
+constexpr double kExtent = 1'000;
+
+double millisSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+std::string circle(double x, double y, double radius) {
+  std::string wkt = "POLYGON((";
+  for (int i = 0; i <= kVertices; ++i) {
+    const auto angle = 2 * std::numbers::pi * (i % kVertices) / kVertices;
+    wkt += std::to_string(x + radius * std::cos(angle)) + " " +
+           std::to_string(y + radius * std::sin(angle));
+    wkt += i == kVertices ? "))" : ", ";
+  }
+  return wkt;
+}
+
+velox::RowVectorPtr makeRows(const std::vector<std::string>& wkt,
+                             std::size_t begin, std::size_t end,
+                             const std::string& prefix,
+                             velox::memory::MemoryPool* pool) {
+  const auto size = static_cast<velox::vector_size_t>(end - begin);
+  auto ids = velox::BaseVector::create<velox::FlatVector<std::int64_t>>(
+      velox::BIGINT(), size, pool);
+  auto geometries =
+      velox::BaseVector::create<velox::FlatVector<velox::StringView>>(
+          velox::VARCHAR(), size, pool);
+  for (velox::vector_size_t i = 0; i < size; ++i) {
+    const auto row = begin + static_cast<std::size_t>(i);
+    ids->set(i, static_cast<std::int64_t>(row));
+    geometries->set(i, velox::StringView(wkt[row]));
+  }
+  return std::make_shared<velox::RowVector>(
+      pool,
+      velox::ROW({prefix + "id", prefix + "geometry"},
+                 {velox::BIGINT(), velox::VARCHAR()}),
+      nullptr, size, std::vector<velox::VectorPtr>{ids, geometries});
+}
+
+}  // namespace
+
+TEST(SpatialJoinBenchmark, StrTreeAgainstNestedLoop) {
+  auto root = velox::memory::memoryManager()->addRootPool("spatial_bench");
+  auto pool = root->addLeafChild("spatial_bench_leaf");
+
+  std::mt19937 random(7);
+  std::uniform_real_distribution<double> coordinate(0, kExtent);
+  std::uniform_real_distribution<double> radius(2, 10);
+  std::vector<std::string> polygons;
+  for (std::size_t i = 0; i < kPolygons; ++i) {
+    polygons.push_back(
+        circle(coordinate(random), coordinate(random), radius(random)));
+  }
+  std::vector<std::string> points;
+  for (std::size_t i = 0; i < kPoints; ++i) {
+    points.push_back("POINT(" + std::to_string(coordinate(random)) + " " +
+                     std::to_string(coordinate(random)) + ")");
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  auto builder = SpatialJoinBuilder::create(
+      velox::ROW({"zone_id", "zone_geometry"},
+                 {velox::BIGINT(), velox::VARCHAR()}),
+      1, SpatialPredicate::kContains, pool.get());
+  ASSERT_TRUE(builder.ok()) << builder.status().toString();
+  ASSERT_TRUE(
+      builder->append(makeRows(polygons, 0, kPolygons, "zone_", pool.get()))
+          .ok());
+  const auto build = builder->build();
+  const auto build_ms = millisSince(start);
+
+  SpatialJoinProbe probe(build);
+  start = std::chrono::steady_clock::now();
+  for (std::size_t begin = 0; begin < kPoints; begin += kBatch) {
+    const auto end = std::min(begin + kBatch, kPoints);
+    ASSERT_TRUE(
+        probe.join(makeRows(points, begin, end, "", pool.get()), 1).ok());
+  }
+  const auto join_ms = millisSince(start);
+  const auto& stats = probe.stats();
+
+  // The nested loop: every polygon against every sampled point, unprepared.
+  auto context = GeosContext::create();
+  std::vector<GeometryPtr> parsed;
+  for (const auto& wkt : polygons) {
+    auto geometry =
+        context->read(velox::StringView(wkt), GeometryEncoding::kWkt);
+    ASSERT_TRUE(geometry.ok());
+    parsed.push_back(std::move(geometry).value());
+  }
+  start = std::chrono::steady_clock::now();
+  std::uint64_t loop_matches = 0;
+  for (std::size_t i = 0; i < kNestedLoopSample; ++i) {
+    auto point =
+        context->read(velox::StringView(points[i]), GeometryEncoding::kWkt);
+    ASSERT_TRUE(point.ok());
+    for (const auto& polygon : parsed) {
+      loop_matches += static_cast<std::uint64_t>(
+          GEOSContains_r(context->handle(), polygon.get(), point->get()) == 1);
+    }
+  }
+  const auto loop_ms = millisSince(start) * (kPoints / kNestedLoopSample);
+  EXPECT_GT(loop_matches, 0U);
+
+  const auto per_point_us = join_ms * 1e3 / kPoints;
+  std::cout << std::fixed << std::setprecision(2) << kPoints << " points x "
+            << kPolygons << " polygons of " << kVertices << " vertices\n"
+            << std::left << std::setw(14) << "join" << std::right
+            << std::setw(14) << "build ms" << std::setw(14) << "probe ms"
+            << std::setw(14) << "us/point" << std::setw(12) << "vs loop"
+            << "\n"
+            << std::left << std::setw(14) << "nested loop" << std::right
+            << std::setw(14) << 0.0 << std::setw(14) << loop_ms
+            << std::setw(14) << loop_ms * 1e3 / kPoints << std::setw(12)
+            << 1.0 << "\n"
+            << std::left << std::setw(14) << "strtree" << std::right
+            << std::setw(14) << build_ms << std::setw(14) << join_ms
+            << std::setw(14) << per_point_us << std::setw(12)
+            << loop_ms / std::max(join_ms, 1e-3) << "\n"
+            << stats.candidates << " candidates, " << stats.matches
+            << " matches, " << stats.prepared << " prepared; 100M points "
+            << "at this rate: " << per_point_us * 1e8 / 6e7 << " min\n";
+}
+
+}  // namespace halo::exec::spatial
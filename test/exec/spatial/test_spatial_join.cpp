@@ -0,0 +1,217 @@
+#include <geos_c.h>
+#include <gtest/gtest.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/DecodedVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+import halo.common;
+import halo.exec.spatial;
+
+namespace halo::exec::spatial {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+using common::base::Status;
+
+constexpr int kGrid = 10;
+
+std::string square(int x, int y) {
+  const auto point = [](int px, int py) {
+    return std::to_string(px) + " " + std::to_string(py);
+  };
+  return "POLYGON((" + point(x, y) + ", " + point(x + 1, y) + ", " +
+         point(x + 1, y + 1) + ", " + point(x, y + 1) + ", " + point(x, y) +
+         "))";
+}
+
+class SpatialJoinTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = velox::memory::memoryManager()->addRootPool("spatial_join");
+    pool_ = root_->addLeafChild("spatial_join_leaf");
+  }
+
+  // (id, geometry) rows with the given geometries as WKT, or as WKB when
+  // `wkb' is set.
+  velox::RowVectorPtr makeRows(
+      const std::vector<std::optional<std::string>>& wkt,
+      std::int64_t first_id, const std::string& prefix, bool wkb = false) {
+    const auto size = static_cast<velox::vector_size_t>(wkt.size());
+    auto ids = velox::BaseVector::create<velox::FlatVector<std::int64_t>>(
+        velox::BIGINT(), size, pool_.get());
+    const auto type = wkb ? velox::VARBINARY() : velox::VARCHAR();
+    auto geometries =
+        velox::BaseVector::create<velox::FlatVector<velox::StringView>>(
+            type, size, pool_.get());
+    for (velox::vector_size_t i = 0; i < size; ++i) {
+      ids->set(i, first_id + i);
+      const auto& value = wkt[static_cast<std::size_t>(i)];
+      if (!value.has_value()) {
+        geometries->setNull(i, true);
+        continue;
+      }
+      geometries->set(i, velox::StringView(wkb ? toWkb(*value) : *value));
+    }
+    return std::make_shared<velox::RowVector>(
+        pool_.get(),
+        velox::ROW({prefix + "id", prefix + "geometry"},
+                   {velox::BIGINT(), type}),
+        nullptr, size, std::vector<velox::VectorPtr>{ids, geometries});
+  }
+
+  static std::string toWkb(const std::string& wkt) {
+    auto context = GeosContext::create();
+    auto geometry = context->read(velox::StringView(wkt),
+                                  GeometryEncoding::kWkt);
+    EXPECT_TRUE(geometry.ok()) << geometry.status().toString();
+    const auto handle = context->handle();
+    auto* writer = GEOSWKBWriter_create_r(handle);
+    std::size_t size = 0;
+    auto* bytes = GEOSWKBWriter_write_r(handle, writer, geometry->get(), &size);
+    std::string wkb(reinterpret_cast<const char*>(bytes), size);
+    GEOSFree_r(handle, bytes);
+    GEOSWKBWriter_destroy_r(handle, writer);
+    return wkb;
+  }
+
+  // The grid of unit squares (id x * kGrid + y) over [0, kGrid)^2, in two
+  // build batches.
+  std::shared_ptr<const SpatialJoinBuild> buildGrid(
+      SpatialPredicate predicate, bool wkb = false) {
+    std::vector<std::optional<std::string>> first;
+    std::vector<std::optional<std::string>> second;
+    for (int x = 0; x < kGrid; ++x) {
+      for (int y = 0; y < kGrid; ++y) {
+        (x < kGrid / 2 ? first : second).emplace_back(square(x, y));
+      }
+    }
+    auto builder = SpatialJoinBuilder::create(
+        velox::ROW({"zone_id", "zone_geometry"},
+                   {velox::BIGINT(), wkb ? velox::VARBINARY()
+                                         : velox::VARCHAR()}),
+        1, predicate, pool_.get());
+    EXPECT_TRUE(builder.ok()) << builder.status().toString();
+    EXPECT_TRUE(builder->append(makeRows(first, 0, "zone_", wkb)).ok());
+    EXPECT_TRUE(builder
+                    ->append(makeRows(second,
+                                      static_cast<std::int64_t>(first.size()),
+                                      "zone_", wkb))
+                    .ok());
+    return builder->build();
+  }
+
+  std::shared_ptr<velox::memory::MemoryPool> root_;
+  std::shared_ptr<velox::memory::MemoryPool> pool_;
+};
+
+}  // namespace
+
+TEST_F(SpatialJoinTest, PointsJoinTheSquareContainingThem) {
+  for (const bool wkb : {false, true}) {
+    SpatialJoinProbe probe(buildGrid(SpatialPredicate::kContains, wkb));
+    std::mt19937 random(5);
+    std::uniform_real_distribution<double> coordinate(0.01, kGrid - 0.01);
+    std::vector<std::optional<std::string>> points;
+    std::vector<std::int64_t> expected;
+    for (int i = 0; i < 500; ++i) {
+      auto x = coordinate(random);
+      auto y = coordinate(random);
+      // Keep clear of the shared edges.
+      x = std::floor(x) + 0.1 + 0.8 * (x - std::floor(x));
+      y = std::floor(y) + 0.1 + 0.8 * (y - std::floor(y));
+      points.emplace_back("POINT(" + std::to_string(x) + " " +
+                          std::to_string(y) + ")");
+      expected.push_back(static_cast<std::int64_t>(std::floor(x)) * kGrid +
+                         static_cast<std::int64_t>(std::floor(y)));
+    }
+    points.emplace_back(std::nullopt);
+    points.emplace_back("POINT(50 50)");
+
+    auto joined = probe.join(makeRows(points, 0, "", wkb), 1);
+    ASSERT_TRUE(joined.ok()) << joined.status().toString();
+    const auto& output = *joined;
+    ASSERT_EQ(output->size(), 500);
+    EXPECT_EQ(output->type()->asRow().names(),
+              (std::vector<std::string>{"id", "geometry", "zone_id",
+                                        "zone_geometry"}));
+    const velox::DecodedVector ids(*output->childAt(0));
+    const velox::DecodedVector zones(*output->childAt(2));
+    for (velox::vector_size_t i = 0; i < output->size(); ++i) {
+      EXPECT_EQ(ids.valueAt<std::int64_t>(i), i);
+      EXPECT_EQ(zones.valueAt<std::int64_t>(i),
+                expected[static_cast<std::size_t>(i)]);
+    }
+
+    const auto& stats = probe.stats();
+    EXPECT_EQ(stats.probe_rows, 502U);
+    EXPECT_EQ(stats.matches, 500U);
+    // The envelopes leave about one candidate per point, far from the 100
+    // of a nested loop.
+    EXPECT_LT(stats.candidates, 2 * 500U);
+    EXPECT_GT(stats.prepared, 0U);
+  }
+}
+
+TEST_F(SpatialJoinTest, IntersectsFindsEverySquareALineCrosses) {
+  SpatialJoinProbe probe(buildGrid(SpatialPredicate::kIntersects));
+  // Runs through the squares of row y = 0 from x = 0 to x = 2.
+  auto joined = probe.join(
+      makeRows({"LINESTRING(0.5 0.5, 2.5 0.5)"}, 0, ""), 1);
+  ASSERT_TRUE(joined.ok()) << joined.status().toString();
+  const velox::DecodedVector zones(*(*joined)->childAt(2));
+  std::vector<std::int64_t> found;
+  for (velox::vector_size_t i = 0; i < (*joined)->size(); ++i) {
+    found.push_back(zones.valueAt<std::int64_t>(i));
+  }
+  EXPECT_EQ(found, (std::vector<std::int64_t>{0, kGrid, 2 * kGrid}));
+}
+
+TEST_F(SpatialJoinTest, NullBuildGeometriesNeverMatch) {
+  auto builder = SpatialJoinBuilder::create(
+      velox::ROW({"id", "geometry"}, {velox::BIGINT(), velox::VARCHAR()}), 1,
+      SpatialPredicate::kIntersects, pool_.get());
+  ASSERT_TRUE(builder.ok());
+  ASSERT_TRUE(
+      builder->append(makeRows({std::nullopt, square(0, 0)}, 0, "")).ok());
+  SpatialJoinProbe probe(builder->build());
+  auto joined = probe.join(makeRows({"POINT(0.5 0.5)"}, 0, "p_"), 1);
+  ASSERT_TRUE(joined.ok()) << joined.status().toString();
+  ASSERT_EQ((*joined)->size(), 1);
+  const velox::DecodedVector ids(*(*joined)->childAt(2));
+  EXPECT_EQ(ids.valueAt<std::int64_t>(0), 1);
+}
+
+TEST_F(SpatialJoinTest, RejectsUnreadableGeometries) {
+  auto builder = SpatialJoinBuilder::create(
+      velox::ROW({"id", "geometry"}, {velox::BIGINT(), velox::VARCHAR()}), 1,
+      SpatialPredicate::kContains, pool_.get());
+  ASSERT_TRUE(builder.ok());
+  EXPECT_EQ(builder->append(makeRows({"POLYGON((0 0, 1"}, 0, "")).code(),
+            Status::Code::kInvalid);
+
+  EXPECT_EQ(SpatialJoinBuilder::create(
+                velox::ROW({"id"}, {velox::BIGINT()}), 0,
+                SpatialPredicate::kContains, pool_.get())
+                .status()
+                .code(),
+            Status::Code::kInvalid);
+
+  SpatialJoinProbe probe(buildGrid(SpatialPredicate::kContains));
+  EXPECT_EQ(probe.join(makeRows({"POINT(1"}, 0, ""), 1).status().code(),
+            Status::Code::kInvalid);
+}
+
+}  // namespace halo::exec::spatial
@@ -0,0 +1,170 @@
+// String kernels on mostly-ASCII text against the character-at-a-time
+// utf8proc loops they replace: throughput of lower, upper, length, UTF-8
+// validation and substring over log lines where one in fifty characters
+// is outside ASCII.
+
+#include <gtest/gtest.h>
+#include <utf8proc.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+import halo.exec.utf8;
+
+namespace halo::exec::utf8 {
+
+namespace {
+
+constexpr std::size_t kLines = 200'000;
+constexpr int kRounds = 5;
+
+std::vector<std::string> makeLines() {
+  const std::vector<std::string> others = {"\xC3\xA9", "\xC3\xBC", "\xCE\xA3",
+                                           "\xE2\x82\xAC"};
+  std::mt19937 random(5);
+  std::vector<std::string> lines;
+  for (std::size_t i = 0; i < kLines; ++i) {
+    std::string line;
+    const auto length = 40 + random() % 200;
+    while (line.size() < length) {
+      if (random() % 50 == 0) {
+        line += others[random() % others.size()];
+      } else {
+        line.push_back(static_cast<char>(' ' + random() % 95));
+      }
+    }
+    lines.push_back(std::move(line));
+  }
+  return lines;
+}
+
+// Calls `function' on every line kRounds times, adding up its results in
+// `checksum'. Returns MB/s.
+double throughput(const std::vector<std::string>& lines,
+                  const std::function<std::size_t(std::string_view)>& function,
+                  std::size_t& checksum) {
+  std::size_t bytes = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < kRounds; ++round) {
+    for (const auto& line : lines) {
+      checksum += function(line);
+      bytes += line.size();
+    }
+  }
+  const auto seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  return static_cast<double>(bytes) / 1e6 / std::max(seconds, 1e-9);
+}
+
+// The per-character loops: decode every character with utf8proc.
+template <typename Visit>
+bool forEachCodepoint(std::string_view text, Visit visit) {
+  std::size_t position = 0;
+  while (position < text.size()) {
+    utf8proc_int32_t codepoint = 0;
+    const auto length = utf8proc_iterate(
+        reinterpret_cast<const utf8proc_uint8_t*>(text.data() + position),
+        static_cast<utf8proc_ssize_t>(text.size() - position), &codepoint);
+    if (length < 0) {
+      return false;
+    }
+    visit(codepoint);
+    position += static_cast<std::size_t>(length);
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST(Utf8KernelsBenchmark, KernelsAgainstUtf8proc) {
+  const auto lines = makeLines();
+  std::string out(maxCaseMappedBytes(1024), '\0');
+
+  const auto utf8procCase = [&](bool upper) {
+    return [&, upper](std::string_view text) {
+      std::size_t written = 0;
+      forEachCodepoint(text, [&](utf8proc_int32_t codepoint) {
+        written += static_cast<std::size_t>(utf8proc_encode_char(
+            upper ? utf8proc_toupper(codepoint) : utf8proc_tolower(codepoint),
+            reinterpret_cast<utf8proc_uint8_t*>(out.data() + written)));
+      });
+      return written;
+    };
+  };
+  const auto utf8procLength = [](std::string_view text) {
+    std::size_t count = 0;
+    forEachCodepoint(text, [&](utf8proc_int32_t) { ++count; });
+    return count;
+  };
+  const auto utf8procValid = [](std::string_view text) {
+    return static_cast<std::size_t>(
+        forEachCodepoint(text, [](utf8proc_int32_t) {}));
+  };
+  // Characters 20 to 39, found by decoding up to them.
+  const auto utf8procSubstr = [](std::string_view text) {
+    std::size_t position = 0;
+    auto begin = std::string_view::npos;
+    std::size_t count = 0;
+    while (position < text.size() && count < 40) {
+      if (count == 20) {
+        begin = position;
+      }
+      utf8proc_int32_t codepoint = 0;
+      position += static_cast<std::size_t>(utf8proc_iterate(
+          reinterpret_cast<const utf8proc_uint8_t*>(text.data() + position),
+          static_cast<utf8proc_ssize_t>(text.size() - position), &codepoint));
+      ++count;
+    }
+    return begin == std::string_view::npos ? 0 : position - begin;
+  };
+
+  struct Case {
+    const char* name;
+    std::function<std::size_t(std::string_view)> utf8proc;
+    std::function<std::size_t(std::string_view)> kernel;
+  };
+  const std::vector<Case> cases = {
+      {"lower", utf8procCase(false),
+       [&](std::string_view text) { return toLower(text, out.data()); }},
+      {"upper", utf8procCase(true),
+       [&](std::string_view text) { return toUpper(text, out.data()); }},
+      {"length", utf8procLength,
+       [](std::string_view text) { return codepointCount(text); }},
+      {"is_valid_utf8", utf8procValid,
+       [](std::string_view text) {
+         return static_cast<std::size_t>(isValidUtf8(text));
+       }},
+      {"substr(s, 21, 20)", utf8procSubstr,
+       [](std::string_view text) {
+         return substringByCodepoint(text, 21, 20).size();
+       }},
+  };
+
+  std::cout << std::fixed << std::setprecision(1) << kLines
+            << " lines, 2% non-ASCII characters\n"
+            << std::left << std::setw(20) << "function" << std::right
+            << std::setw(16) << "utf8proc MB/s" << std::setw(16)
+            << "kernel MB/s" << std::setw(10) << "speedup" << "\n";
+  for (const auto& c : cases) {
+    std::size_t reference = 0;
+    std::size_t actual = 0;
+    const auto before = throughput(lines, c.utf8proc, reference);
+    const auto after = throughput(lines, c.kernel, actual);
+    EXPECT_EQ(actual, reference) << c.name;
+    std::cout << std::left << std::setw(20) << c.name << std::right
+              << std::setw(16) << before << std::setw(16) << after
+              << std::setw(10) << after / std::max(before, 1e-9) << "\n";
+  }
+}
+
+}  // namespace halo::exec::utf8
@@ -0,0 +1,241 @@
+#include <gtest/gtest.h>
+#include <utf8proc.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/core/Expressions.h>
+#include <velox/core/QueryCtx.h>
+#include <velox/expression/EvalCtx.h>
+#include <velox/expression/Expr.h>
+#include <velox/type/Type.h>
+#include <velox/type/Variant.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/DecodedVector.h>
+#include <velox/vector/FlatVector.h>
+#include <velox/vector/SelectivityVector.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+import halo.exec.utf8;
+
+namespace halo::exec::utf8 {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+// Character by character through utf8proc, as the kernels' reference.
+std::optional<std::vector<std::int32_t>> decode(std::string_view text) {
+  std::vector<std::int32_t> codepoints;
+  std::size_t position = 0;
+  while (position < text.size()) {
+    utf8proc_int32_t codepoint = 0;
+    const auto length = utf8proc_iterate(
+        reinterpret_cast<const utf8proc_uint8_t*>(text.data() + position),
+        static_cast<utf8proc_ssize_t>(text.size() - position), &codepoint);
+    if (length < 0) {
+      return std::nullopt;
+    }
+    codepoints.push_back(codepoint);
+    position += static_cast<std::size_t>(length);
+  }
+  return codepoints;
+}
+
+std::string encode(const std::vector<std::int32_t>& codepoints) {
+  std::string text;
+  for (const auto codepoint : codepoints) {
+    utf8proc_uint8_t bytes[4];
+    const auto length = utf8proc_encode_char(codepoint, bytes);
+    text.append(reinterpret_cast<const char*>(bytes),
+                static_cast<std::size_t>(length));
+  }
+  return text;
+}
+
+std::string lower(std::string_view text) {
+  std::string out(maxCaseMappedBytes(text.size()), '\0');
+  out.resize(toLower(text, out.data()));
+  return out;
+}
+
+std::string upper(std::string_view text) {
+  std::string out(maxCaseMappedBytes(text.size()), '\0');
+  out.resize(toUpper(text, out.data()));
+  return out;
+}
+
+// Mostly ASCII with the odd accented, Greek, CJK or emoji character, in
+// runs that straddle block boundaries.
+std::string makeText(std::mt19937& random) {
+  const std::vector<std::string> others = {
+      "\xC3\xA9", "\xC3\x89", "\xC3\x9F", "\xCE\xA3", "\xCF\x83",
+      "\xE4\xB8\xAD", "\xF0\x9F\x98\x80", "\xE1\xBA\x9E"};
+  std::string text;
+  const auto pieces = random() % 6;
+  for (std::size_t piece = 0; piece < pieces; ++piece) {
+    const auto run = random() % 150;
+    for (std::size_t i = 0; i < run; ++i) {
+      text.push_back(static_cast<char>(' ' + random() % 95));
+    }
+    text += others[random() % others.size()];
+  }
+  return text;
+}
+
+}  // namespace
+
+TEST(Utf8KernelsTest, AgreesWithUtf8proc) {
+  std::mt19937 random(11);
+  for (int i = 0; i < 2000; ++i) {
+    const auto text = makeText(random);
+    const auto codepoints = decode(text);
+    ASSERT_TRUE(codepoints.has_value());
+    EXPECT_TRUE(isValidUtf8(text));
+    EXPECT_EQ(isAscii(text), text.size() == codepoints->size());
+    EXPECT_EQ(codepointCount(text), codepoints->size());
+
+    auto lowered = *codepoints;
+    auto uppered = *codepoints;
+    for (std::size_t c = 0; c < codepoints->size(); ++c) {
+      lowered[c] = utf8proc_tolower(lowered[c]);
+      uppered[c] = utf8proc_toupper(uppered[c]);
+    }
+    EXPECT_EQ(lower(text), encode(lowered));
+    EXPECT_EQ(upper(text), encode(uppered));
+
+    const auto size = static_cast<std::int64_t>(codepoints->size());
+    const auto start = static_cast<std::int64_t>(random() % (size + 2)) + 1;
+    const auto length = static_cast<std::int64_t>(random() % 100);
+    std::vector<std::int32_t> expected;
+    for (auto c = start - 1; c < std::min(size, start - 1 + length); ++c) {
+      expected.push_back((*codepoints)[static_cast<std::size_t>(c)]);
+    }
+    EXPECT_EQ(substringByCodepoint(text, start, length), encode(expected));
+  }
+}
+
+TEST(Utf8KernelsTest, FindsMalformedSequencesPastAsciiBlocks) {
+  const std::string prefix(100, 'a');
+  for (const std::string bad : {"\xC3", "\xC3\x28", "\x80", "\xC0\xAF",
+                                "\xED\xA0\x80", "\xF4\x90\x80\x80"}) {
+    EXPECT_FALSE(isValidUtf8(prefix + bad)) << prefix + bad;
+    EXPECT_FALSE(isValidUtf8(prefix + bad + prefix));
+    // Case mapping leaves the bytes as they are.
+    EXPECT_EQ(upper(prefix + bad), std::string(100, 'A') + bad);
+  }
+  EXPECT_TRUE(isValidUtf8(""));
+  EXPECT_TRUE(isValidUtf8(prefix + "\xF4\x8F\xBF\xBF"));
+}
+
+TEST(Utf8KernelsTest, SubstringFollowsSql) {
+  const std::string text = "na\xC3\xAFve caf\xC3\xA9";
+  EXPECT_EQ(substringByCodepoint(text, 1, 5), "na\xC3\xAFve");
+  EXPECT_EQ(substringByCodepoint(text, 3, 1), "\xC3\xAF");
+  EXPECT_EQ(substringByCodepoint(text, -4, 100), "caf\xC3\xA9");
+  EXPECT_EQ(substringByCodepoint(text, -1, 1), "\xC3\xA9");
+  EXPECT_EQ(substringByCodepoint(text, 0, 3), "");
+  EXPECT_EQ(substringByCodepoint(text, 11, 3), "");
+  EXPECT_EQ(substringByCodepoint(text, -11, 3), "");
+  EXPECT_EQ(substringByCodepoint(text, 2, 0), "");
+  EXPECT_EQ(substringByCodepoint(
+                text, std::numeric_limits<std::int64_t>::min(), 3),
+            "");
+  EXPECT_EQ(substringByCodepoint(
+                text, std::numeric_limits<std::int64_t>::max(), 3),
+            "");
+
+  // Skipping whole blocks of multi-byte characters.
+  std::string wide;
+  for (int i = 0; i < 100; ++i) {
+    wide += "\xE4\xB8\xAD";
+    wide += static_cast<char>('0' + i % 10);
+  }
+  EXPECT_EQ(codepointCount(wide), 200U);
+  EXPECT_EQ(substringByCodepoint(wide, 152, 3), "5\xE4\xB8\xAD" "6");
+}
+
+TEST(StringFunctionsTest, VectorFunctionsUseTheKernels) {
+  registerStringFunctions("halo_");
+  auto root = velox::memory::memoryManager()->addRootPool("utf8");
+  auto pool = root->addLeafChild("utf8_leaf");
+  const std::vector<std::optional<std::string>> values = {
+      "Hello, World", std::string(70, 'x') + "\xC3\x89t\xC3\xA9", std::nullopt,
+      "\xC3\x28"};
+  const auto size = static_cast<velox::vector_size_t>(values.size());
+  auto text = velox::BaseVector::create<velox::FlatVector<velox::StringView>>(
+      velox::VARCHAR(), size, pool.get());
+  for (velox::vector_size_t i = 0; i < size; ++i) {
+    const auto& value = values[static_cast<std::size_t>(i)];
+    if (value.has_value()) {
+      text->set(i, velox::StringView(*value));
+    } else {
+      text->setNull(i, true);
+    }
+  }
+  const auto input = std::make_shared<velox::RowVector>(
+      pool.get(), velox::ROW({"text"}, {velox::VARCHAR()}), nullptr, size,
+      std::vector<velox::VectorPtr>{text});
+
+  const auto column =
+      std::make_shared<velox::core::FieldAccessTypedExpr>(velox::VARCHAR(),
+                                                          "text");
+  const auto bigint = [](std::int64_t value) {
+    return std::make_shared<velox::core::ConstantTypedExpr>(
+        velox::BIGINT(), velox::variant(value));
+  };
+  const auto call = [&](const std::string& name, const velox::TypePtr& type,
+                        std::vector<velox::core::TypedExprPtr> extra = {}) {
+    std::vector<velox::core::TypedExprPtr> inputs{column};
+    inputs.insert(inputs.end(), extra.begin(), extra.end());
+    return std::make_shared<velox::core::CallTypedExpr>(
+        type, std::move(inputs), name);
+  };
+  auto query_ctx = velox::core::QueryCtx::create();
+  velox::core::ExecCtx exec_ctx(pool.get(), query_ctx.get());
+  velox::exec::ExprSet expressions(
+      {call("halo_lower", velox::VARCHAR()),
+       call("halo_upper", velox::VARCHAR()),
+       call("halo_length", velox::BIGINT()),
+       call("halo_substr", velox::VARCHAR(), {bigint(-3), bigint(2)}),
+       call("halo_is_valid_utf8", velox::BOOLEAN())},
+      &exec_ctx);
+  velox::exec::EvalCtx eval_ctx(&exec_ctx, &expressions, input.get());
+  velox::SelectivityVector rows(size);
+  std::vector<velox::VectorPtr> results(5);
+  expressions.eval(rows, eval_ctx, results);
+
+  const velox::DecodedVector lowered(*results[0]);
+  const velox::DecodedVector uppered(*results[1]);
+  const velox::DecodedVector lengths(*results[2]);
+  const velox::DecodedVector substrings(*results[3]);
+  const velox::DecodedVector valid(*results[4]);
+  const auto string = [](const velox::DecodedVector& decoded,
+                         velox::vector_size_t row) {
+    return std::string(decoded.valueAt<velox::StringView>(row));
+  };
+  EXPECT_EQ(string(lowered, 0), "hello, world");
+  EXPECT_EQ(string(uppered, 0), "HELLO, WORLD");
+  EXPECT_EQ(lengths.valueAt<std::int64_t>(0), 12);
+  EXPECT_EQ(string(substrings, 0), "rl");
+  EXPECT_TRUE(valid.valueAt<bool>(0));
+
+  EXPECT_EQ(string(lowered, 1), std::string(70, 'x') + "\xC3\xA9t\xC3\xA9");
+  EXPECT_EQ(string(uppered, 1), std::string(70, 'X') + "\xC3\x89T\xC3\x89");
+  EXPECT_EQ(lengths.valueAt<std::int64_t>(1), 73);
+  EXPECT_EQ(string(substrings, 1), "\xC3\x89t");
+
+  for (const auto* result : {&lowered, &uppered, &lengths, &valid}) {
+    EXPECT_TRUE(result->isNullAt(2));
+  }
+  EXPECT_FALSE(valid.valueAt<bool>(3));
+}
+
+}  // namespace halo::exec::utf8
@@ -0,0 +1,125 @@
+// Ingest throughput of CsvLoader on a synthetic lineitem-like file, per core
+// and with all cores, against the row-at-a-time absl::StrSplit + std::stoi
+// parsing used so far.
+
+#include <absl/strings/str_split.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+import halo.common;
+import halo.storage.file;
+import halo.ingest.csv;
+
+namespace halo::ingest::csv {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+constexpr int kRows = 2'000'000;
+
+std::string makeCsv() {
+  std::mt19937_64 rng(5);
+  std::ostringstream out;
+  out << "orderkey,partkey,quantity,price,discount,comment\n";
+  for (int i = 0; i < kRows; ++i) {
+    out << i << ',' << rng() % 200000 << ',' << 1 + rng() % 50 << ','
+        << static_cast<double>(rng() % 10000000) / 100.0 << ",0."
+        << rng() % 10 << ",carefully final deposits " << rng() % 1000 << '\n';
+  }
+  return out.str();
+}
+
+double baselineSeconds(const std::string& csv) {
+  const auto start = std::chrono::steady_clock::now();
+  std::int64_t checksum = 0;
+  std::vector<std::string> lines = absl::StrSplit(csv, '\n');
+  for (std::size_t i = 1; i < lines.size(); ++i) {
+    if (lines[i].empty()) {
+      continue;
+    }
+    std::vector<std::string> parts = absl::StrSplit(lines[i], ',');
+    checksum += std::stoll(parts[0]) + std::stoll(parts[1]) +
+                std::stoi(parts[2]) + static_cast<std::int64_t>(
+                                          std::stod(parts[3]) +
+                                          std::stod(parts[4])) +
+                static_cast<std::int64_t>(parts[5].size());
+  }
+  EXPECT_NE(checksum, 0);
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+double loaderSeconds(const storage::file::ReadFile& file,
+                     velox::memory::MemoryPool* pool, std::size_t threads) {
+  folly::CPUThreadPoolExecutor executor(threads);
+  auto type = velox::ROW(
+      {"orderkey", "partkey", "quantity", "price", "discount", "comment"},
+      {velox::BIGINT(), velox::BIGINT(), velox::INTEGER(), velox::DOUBLE(),
+       velox::DOUBLE(), velox::VARCHAR()});
+  auto loader = CsvLoader::create(type, {}, pool, &executor);
+  EXPECT_TRUE(loader.ok());
+  const auto start = std::chrono::steady_clock::now();
+  std::uint64_t rows = 0;
+  auto stats = loader->load(file, [&](velox::RowVectorPtr batch) {
+    rows += static_cast<std::uint64_t>(batch->size());
+    return common::base::Status::OK();
+  });
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  EXPECT_TRUE(stats.ok()) << stats.status().message();
+  EXPECT_EQ(rows, static_cast<std::uint64_t>(kRows));
+  return elapsed.count();
+}
+
+}  // namespace
+
+TEST(CsvLoaderBenchmark, ThroughputVersusRowAtATimeParsing) {
+  const std::string csv = makeCsv();
+  const auto path = std::filesystem::temp_directory_path() /
+                    ("halo_csv_bench_" + std::to_string(::getpid()) + ".csv");
+  {
+    std::ofstream out(path, std::ios::binary);
+    out << csv;
+  }
+  auto file = storage::file::LocalReadFile::open(path.string());
+  ASSERT_TRUE(file.ok());
+  auto pool = velox::memory::memoryManager()->addLeafPool("csv_bench");
+  const double mb = static_cast<double>(csv.size()) / 1e6;
+  const std::size_t cores = std::max(1U, std::thread::hardware_concurrency());
+
+  const double baseline = baselineSeconds(csv);
+  const double single = loaderSeconds(**file, pool.get(), 1);
+  const double parallel = loaderSeconds(**file, pool.get(), cores);
+  std::filesystem::remove(path);
+
+  std::cout << std::fixed << std::setprecision(1) << "file: " << mb
+            << " MB, " << kRows << " rows\n"
+            << std::left << std::setw(28) << "StrSplit + stoi (1 core)"
+            << std::right << std::setw(10) << mb / baseline << " MB/s\n"
+            << std::left << std::setw(28) << "CsvLoader (1 core)" << std::right
+            << std::setw(10) << mb / single << " MB/s\n"
+            << std::left << std::setw(28)
+            << "CsvLoader (" + std::to_string(cores) + " cores)" << std::right
+            << std::setw(10) << mb / parallel << " MB/s\n";
+  EXPECT_LT(single, baseline);
+}
+
+}  // namespace halo::ingest::csv
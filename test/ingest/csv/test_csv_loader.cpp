@@ -0,0 +1,262 @@
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+import halo.common;
+import halo.storage.file;
+import halo.ingest.csv;
+
+namespace halo::ingest::csv {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+class CsvLoaderTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    pool_ = velox::memory::memoryManager()->addLeafPool("csv_loader");
+    path_ = std::filesystem::temp_directory_path() /
+            ("halo_csv_loader_" + std::to_string(::getpid()) + ".csv");
+  }
+
+  void TearDown() override { std::filesystem::remove(path_); }
+
+  std::unique_ptr<storage::file::ReadFile> writeFile(
+      const std::string& contents) {
+    std::ofstream out(path_, std::ios::binary);
+    out << contents;
+    out.close();
+    auto file = storage::file::LocalReadFile::open(path_.string());
+    EXPECT_TRUE(file.ok()) << file.status().message();
+    return std::move(file).value();
+  }
+
+  common::base::StatusOr<std::vector<velox::RowVectorPtr>> load(
+      const std::string& contents, const velox::RowTypePtr& type,
+      const CsvOptions& options) {
+    auto file = writeFile(contents);
+    auto loader = CsvLoader::create(type, options, pool_.get(), &executor_);
+    if (!loader.ok()) {
+      return loader.status();
+    }
+    std::vector<velox::RowVectorPtr> batches;
+    auto stats = loader->load(*file, [&](velox::RowVectorPtr batch) {
+      batches.push_back(std::move(batch));
+      return common::base::Status::OK();
+    });
+    if (!stats.ok()) {
+      return stats.status();
+    }
+    return batches;
+  }
+
+  std::shared_ptr<velox::memory::MemoryPool> pool_;
+  folly::CPUThreadPoolExecutor executor_{4};
+  std::filesystem::path path_;
+};
+
+}  // namespace
+
+TEST_F(CsvLoaderTest, ChunksEndOnRowBoundaries) {
+  std::string contents = "id,name\n";
+  for (int i = 0; i < 1000; ++i) {
+    contents += std::to_string(i) + ",row" + std::to_string(i) + "\n";
+  }
+  auto file = writeFile(contents);
+  auto chunks = findCsvChunks(*file, {.chunk_bytes = 100});
+  ASSERT_TRUE(chunks.ok()) << chunks.status().message();
+  ASSERT_GT(chunks->size(), 50U);
+  std::uint64_t expected_offset = 8;
+  for (std::size_t i = 0; i < chunks->size(); ++i) {
+    const auto& chunk = (*chunks)[i];
+    EXPECT_EQ(chunk.offset, expected_offset);
+    EXPECT_EQ(contents[chunk.offset + chunk.length - 1], '\n');
+    if (i + 1 < chunks->size()) {
+      EXPECT_GE(chunk.length, 100U);
+    }
+    expected_offset += chunk.length;
+  }
+  EXPECT_EQ(expected_offset, contents.size());
+}
+
+TEST_F(CsvLoaderTest, ParsesTypedColumnsAcrossChunksInOrder) {
+  auto type = velox::ROW({"id", "score", "ratio", "flag", "name"},
+                         {velox::BIGINT(), velox::INTEGER(), velox::DOUBLE(),
+                          velox::BOOLEAN(), velox::VARCHAR()});
+  std::string contents = "id,score,ratio,flag,name\n";
+  constexpr int kRows = 5000;
+  for (int i = 0; i < kRows; ++i) {
+    contents += std::to_string(i * 1000003LL) + "," + std::to_string(-i) +
+                "," + std::to_string(i) + ".25," +
+                (i % 2 == 0 ? "true" : "0") + ",name_" + std::to_string(i) +
+                "_padding\r\n";
+  }
+  auto batches = load(contents, type, {.chunk_bytes = 4096});
+  ASSERT_TRUE(batches.ok()) << batches.status().message();
+  ASSERT_GT(batches->size(), 10U);
+
+  std::int64_t row = 0;
+  for (const auto& batch : *batches) {
+    auto* ids = batch->childAt(0)->asFlatVector<std::int64_t>();
+    auto* scores = batch->childAt(1)->asFlatVector<std::int32_t>();
+    auto* ratios = batch->childAt(2)->asFlatVector<double>();
+    auto* flags = batch->childAt(3)->asFlatVector<bool>();
+    auto* names = batch->childAt(4)->asFlatVector<velox::StringView>();
+    for (velox::vector_size_t i = 0; i < batch->size(); ++i, ++row) {
+      ASSERT_EQ(ids->valueAt(i), row * 1000003LL);
+      ASSERT_EQ(scores->valueAt(i), -row);
+      ASSERT_EQ(ratios->valueAt(i), static_cast<double>(row) + 0.25);
+      ASSERT_EQ(flags->valueAt(i), row % 2 == 0);
+      ASSERT_EQ(names->valueAt(i).str(),
+                "name_" + std::to_string(row) + "_padding");
+    }
+  }
+  EXPECT_EQ(row, kRows);
+}
+
+TEST_F(CsvLoaderTest, QuotedFieldsAndNulls) {
+  auto type = velox::ROW({"a", "b", "c"},
+                         {velox::VARCHAR(), velox::BIGINT(), velox::VARCHAR()});
+  const std::string contents =
+      "a,b,c\n"
+      "\"x, y\",1,\"say \"\"hi\"\"\"\n"
+      ",2,\"\"\n"
+      "NULL,3,plain\n";
+  auto batches =
+      load(contents, type, {.null_string = "NULL", .chunk_bytes = 1 << 20});
+  ASSERT_TRUE(batches.ok()) << batches.status().message();
+  ASSERT_EQ(batches->size(), 1U);
+  const auto& batch = batches->front();
+  ASSERT_EQ(batch->size(), 3);
+  auto* a = batch->childAt(0)->asFlatVector<velox::StringView>();
+  auto* b = batch->childAt(1)->asFlatVector<std::int64_t>();
+  auto* c = batch->childAt(2)->asFlatVector<velox::StringView>();
+  EXPECT_EQ(a->valueAt(0).str(), "x, y");
+  EXPECT_EQ(c->valueAt(0).str(), "say \"hi\"");
+  // With null_string "NULL", an empty unquoted field is an empty string.
+  EXPECT_FALSE(a->isNullAt(1));
+  EXPECT_EQ(a->valueAt(1).str(), "");
+  EXPECT_EQ(b->valueAt(1), 2);
+  EXPECT_EQ(c->valueAt(1).str(), "");
+  EXPECT_TRUE(a->isNullAt(2));
+  EXPECT_EQ(b->valueAt(2), 3);
+  EXPECT_FALSE(b->isNullAt(0));
+}
+
+TEST_F(CsvLoaderTest, EmptyFieldIsNullByDefault) {
+  auto type = velox::ROW({"a", "b"}, {velox::BIGINT(), velox::DOUBLE()});
+  auto batches = load("a,b\n1,\n,2.5\n", type, {});
+  ASSERT_TRUE(batches.ok()) << batches.status().message();
+  const auto& batch = batches->front();
+  EXPECT_TRUE(batch->childAt(1)->isNullAt(0));
+  EXPECT_TRUE(batch->childAt(0)->isNullAt(1));
+  EXPECT_EQ(batch->childAt(1)->asFlatVector<double>()->valueAt(1), 2.5);
+}
+
+TEST_F(CsvLoaderTest, QuotedNewlinesStayInOneRow) {
+  auto type = velox::ROW({"id", "text"}, {velox::INTEGER(), velox::VARCHAR()});
+  std::string contents = "id,text\n";
+  for (int i = 0; i < 200; ++i) {
+    contents += std::to_string(i) + ",\"line one\nline two " +
+                std::to_string(i) + "\"\n";
+  }
+  auto batches =
+      load(contents, type, {.chunk_bytes = 64, .quoted_newlines = true});
+  ASSERT_TRUE(batches.ok()) << batches.status().message();
+  int row = 0;
+  for (const auto& batch : *batches) {
+    auto* texts = batch->childAt(1)->asFlatVector<velox::StringView>();
+    for (velox::vector_size_t i = 0; i < batch->size(); ++i, ++row) {
+      ASSERT_EQ(texts->valueAt(i).str(),
+                "line one\nline two " + std::to_string(row));
+    }
+  }
+  EXPECT_EQ(row, 200);
+}
+
+TEST_F(CsvLoaderTest, ReportsMalformedRows) {
+  auto type = velox::ROW({"a", "b"}, {velox::INTEGER(), velox::INTEGER()});
+  auto bad_number = load("a,b\n1,2\n3,x4\n", type, {});
+  ASSERT_FALSE(bad_number.ok());
+  EXPECT_NE(bad_number.status().message().find("'b'"), std::string::npos);
+  EXPECT_FALSE(load("a,b\n1,2,3\n", type, {}).ok());
+  EXPECT_FALSE(load("a,b\n1\n", type, {}).ok());
+  EXPECT_FALSE(load("a,b\n99999999999,1\n", type, {}).ok());
+  EXPECT_FALSE(load("a,b\n\"1,2\n", type, {}).ok());
+
+  auto map_type =
+      velox::ROW({"m"}, {velox::MAP(velox::BIGINT(), velox::BIGINT())});
+  EXPECT_EQ(load("m\n", map_type, {}).status().code(),
+            common::base::Status::Code::kNotImplemented);
+}
+
+TEST_F(CsvLoaderTest, LeadingPlusTakesOneSign) {
+  auto type = velox::ROW({"a", "b"}, {velox::INTEGER(), velox::DOUBLE()});
+  auto batches = load("a,b\n+5,+2.5\n", type, {});
+  ASSERT_TRUE(batches.ok()) << batches.status().message();
+  const auto& batch = batches->front();
+  EXPECT_EQ(batch->childAt(0)->asFlatVector<std::int32_t>()->valueAt(0), 5);
+  EXPECT_EQ(batch->childAt(1)->asFlatVector<double>()->valueAt(0), 2.5);
+
+  EXPECT_FALSE(load("a,b\n+-5,1\n", type, {}).ok());
+  EXPECT_FALSE(load("a,b\n++5,1\n", type, {}).ok());
+  EXPECT_FALSE(load("a,b\n+,1\n", type, {}).ok());
+  EXPECT_FALSE(load("a,b\n1,+-2.5\n", type, {}).ok());
+  EXPECT_FALSE(load("a,b\n1,++2.5\n", type, {}).ok());
+}
+
+TEST_F(CsvLoaderTest, SinkErrorStopsLoad) {
+  auto type = velox::ROW({"a"}, {velox::BIGINT()});
+  std::string contents = "a\n";
+  for (int i = 0; i < 10000; ++i) {
+    contents += std::to_string(i) + "\n";
+  }
+  auto file = writeFile(contents);
+  auto loader = CsvLoader::create(type, {.chunk_bytes = 256}, pool_.get(),
+                                  &executor_);
+  ASSERT_TRUE(loader.ok());
+  int calls = 0;
+  auto stats = loader->load(*file, [&](const velox::RowVectorPtr&) {
+    return ++calls == 3 ? common::base::Status::StorageError("table full")
+                        : common::base::Status::OK();
+  });
+  ASSERT_FALSE(stats.ok());
+  EXPECT_EQ(stats.status().message(), "table full");
+  EXPECT_EQ(calls, 3);
+}
+
+TEST_F(CsvLoaderTest, VeloxErrorInTaskBecomesStatus) {
+  auto type = velox::ROW({"a"}, {velox::BIGINT()});
+  std::string contents = "a\n";
+  for (int i = 0; i < 100000; ++i) {
+    contents += std::to_string(i) + "\n";
+  }
+  auto file = writeFile(contents);
+  // Too small for a single chunk, so allocating it throws on the executor.
+  auto root = velox::memory::memoryManager()->addRootPool("csv_capped", 4096);
+  auto capped = root->addLeafChild("csv_capped_leaf");
+  auto loader = CsvLoader::create(type, {.chunk_bytes = 64 * 1024},
+                                  capped.get(), &executor_);
+  ASSERT_TRUE(loader.ok());
+  auto stats = loader->load(*file, [](const velox::RowVectorPtr&) {
+    return common::base::Status::OK();
+  });
+  ASSERT_FALSE(stats.ok());
+  EXPECT_EQ(stats.status().code(), common::base::Status::Code::kStorageError);
+  EXPECT_NE(stats.status().message().find("cannot load CSV chunk"),
+            std::string::npos);
+}
+
+}  // namespace halo::ingest::csv
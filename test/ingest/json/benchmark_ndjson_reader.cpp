@@ -0,0 +1,136 @@
+// Ingest throughput of NdjsonReader on synthetic clickstream events with 50
+// fields, of which a typical query reads five, against building a simdjson
+// DOM per document and extracting the same fields from it.
+
+#include <gtest/gtest.h>
+#include <simdjson.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+import halo.common;
+import halo.ingest.json;
+
+namespace halo::ingest::json {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+constexpr int kDocuments = 200'000;
+constexpr int kFields = 50;
+
+std::string makeEvents() {
+  std::mt19937_64 rng(11);
+  std::ostringstream out;
+  for (int i = 0; i < kDocuments; ++i) {
+    out << R"({"event_id": )" << i << R"(, "user_id": )" << rng() % 100000
+        << R"(, "page": "/product/)" << rng() % 5000 << R"(", "duration": )"
+        << static_cast<double>(rng() % 100000) / 100.0
+        << R"(, "tags": ["a", "b"])";
+    for (int field = 5; field < kFields; ++field) {
+      switch (field % 3) {
+        case 0:
+          out << R"(, "attr_)" << field << R"(": )" << rng() % 1000;
+          break;
+        case 1:
+          out << R"(, "attr_)" << field << R"(": "value )" << rng() % 1000
+              << '"';
+          break;
+        default:
+          out << R"(, "attr_)" << field << R"(": {"x": )" << rng() % 10
+              << R"(, "y": [1, 2, 3]})";
+          break;
+      }
+    }
+    out << "}\n";
+  }
+  return out.str();
+}
+
+velox::RowTypePtr projection() {
+  return velox::ROW({"event_id", "user_id", "page", "duration", "tags"},
+                    {velox::BIGINT(), velox::BIGINT(), velox::VARCHAR(),
+                     velox::DOUBLE(), velox::ARRAY(velox::VARCHAR())});
+}
+
+double domSeconds(const simdjson::padded_string& input) {
+  const auto start = std::chrono::steady_clock::now();
+  simdjson::dom::parser parser;
+  simdjson::dom::document_stream stream;
+  EXPECT_EQ(parser.parse_many(input).get(stream), simdjson::SUCCESS);
+  std::int64_t checksum = 0;
+  std::uint64_t documents = 0;
+  for (auto document : stream) {
+    simdjson::dom::object object;
+    EXPECT_EQ(document.get(object), simdjson::SUCCESS);
+    std::int64_t event_id = 0;
+    std::int64_t user_id = 0;
+    std::string_view page;
+    double duration = 0;
+    simdjson::dom::array tags;
+    EXPECT_EQ(object["event_id"].get(event_id), simdjson::SUCCESS);
+    EXPECT_EQ(object["user_id"].get(user_id), simdjson::SUCCESS);
+    EXPECT_EQ(object["page"].get(page), simdjson::SUCCESS);
+    EXPECT_EQ(object["duration"].get(duration), simdjson::SUCCESS);
+    EXPECT_EQ(object["tags"].get(tags), simdjson::SUCCESS);
+    checksum += event_id + user_id + static_cast<std::int64_t>(page.size()) +
+                static_cast<std::int64_t>(duration) +
+                static_cast<std::int64_t>(tags.size());
+    ++documents;
+  }
+  EXPECT_NE(checksum, 0);
+  EXPECT_EQ(documents, static_cast<std::uint64_t>(kDocuments));
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+double readerSeconds(const simdjson::padded_string& input,
+                     const velox::RowTypePtr& type,
+                     velox::memory::MemoryPool* pool) {
+  auto reader = NdjsonReader::create(type, {}, pool);
+  EXPECT_TRUE(reader.ok());
+  const auto start = std::chrono::steady_clock::now();
+  std::uint64_t rows = 0;
+  auto stats = reader->read(input, [&](velox::RowVectorPtr batch) {
+    rows += static_cast<std::uint64_t>(batch->size());
+    return common::base::Status::OK();
+  });
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  EXPECT_TRUE(stats.ok()) << stats.status().message();
+  EXPECT_EQ(rows, static_cast<std::uint64_t>(kDocuments));
+  return elapsed.count();
+}
+
+}  // namespace
+
+TEST(NdjsonReaderBenchmark, ProjectionVersusDom) {
+  const simdjson::padded_string input(makeEvents());
+  auto pool = velox::memory::memoryManager()->addLeafPool("ndjson_bench");
+  const double mb = static_cast<double>(input.size()) / 1e6;
+
+  const double dom = domSeconds(input);
+  const double projected = readerSeconds(input, projection(), pool.get());
+
+  std::cout << std::fixed << std::setprecision(1) << "input: " << mb
+            << " MB, " << kDocuments << " documents, 5 of " << kFields
+            << " fields read\n"
+            << std::left << std::setw(28) << "DOM + field lookup"
+            << std::right << std::setw(10) << mb / dom << " MB/s\n"
+            << std::left << std::setw(28) << "NdjsonReader" << std::right
+            << std::setw(10) << mb / projected << " MB/s\n";
+  EXPECT_LT(projected, dom);
+}
+
+}  // namespace halo::ingest::json
@@ -0,0 +1,280 @@
+#include <gtest/gtest.h>
+#include <simdjson.h>
+#include <unistd.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+import halo.common;
+import halo.storage.file;
+import halo.ingest.json;
+
+namespace halo::ingest::json {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+class NdjsonReaderTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    pool_ = velox::memory::memoryManager()->addLeafPool("ndjson_reader");
+  }
+
+  common::base::StatusOr<std::vector<velox::RowVectorPtr>> read(
+      const std::string& input, const velox::RowTypePtr& type,
+      const JsonOptions& options = {}) {
+    auto reader = NdjsonReader::create(type, options, pool_.get());
+    if (!reader.ok()) {
+      return reader.status();
+    }
+    std::vector<velox::RowVectorPtr> batches;
+    auto stats = reader->read(simdjson::padded_string(input),
+                              [&](velox::RowVectorPtr batch) {
+                                batches.push_back(std::move(batch));
+                                return common::base::Status::OK();
+                              });
+    if (!stats.ok()) {
+      return stats.status();
+    }
+    return batches;
+  }
+
+  std::shared_ptr<velox::memory::MemoryPool> pool_;
+};
+
+}  // namespace
+
+TEST_F(NdjsonReaderTest, ProjectsDeclaredFieldsAndSkipsTheRest) {
+  auto type = velox::ROW({"id", "name", "score", "ok"},
+                         {velox::BIGINT(), velox::VARCHAR(), velox::DOUBLE(),
+                          velox::BOOLEAN()});
+  const std::string input =
+      R"({"id": 1, "unused": {"deep": [1, 2, {"x": "y"}]}, "name": "a",)"
+      R"( "score": 1.5, "ok": true})"
+      "\n"
+      R"({"ok": false, "score": 2, "name": "a much longer name \"quoted\"",)"
+      R"( "id": 2, "other": "skip me"})"
+      "\n\n"
+      R"({"id": null, "name": null})"
+      "\n";
+  auto reader = NdjsonReader::create(type, {}, pool_.get());
+  ASSERT_TRUE(reader.ok()) << reader.status().message();
+  std::vector<velox::RowVectorPtr> batches;
+  auto stats = reader->read(simdjson::padded_string(input),
+                            [&](velox::RowVectorPtr batch) {
+                              batches.push_back(std::move(batch));
+                              return common::base::Status::OK();
+                            });
+  ASSERT_TRUE(stats.ok()) << stats.status().message();
+  EXPECT_EQ(stats->documents, 3U);
+  // "other" follows the last declared field and is never visited.
+  EXPECT_EQ(stats->skipped_fields, 1U);
+  ASSERT_EQ(batches.size(), 1U);
+
+  const auto& batch = batches.front();
+  ASSERT_EQ(batch->size(), 3);
+  auto* ids = batch->childAt(0)->asFlatVector<std::int64_t>();
+  auto* names = batch->childAt(1)->asFlatVector<velox::StringView>();
+  auto* scores = batch->childAt(2)->asFlatVector<double>();
+  auto* oks = batch->childAt(3)->asFlatVector<bool>();
+  EXPECT_EQ(ids->valueAt(0), 1);
+  EXPECT_EQ(ids->valueAt(1), 2);
+  EXPECT_TRUE(ids->isNullAt(2));
+  EXPECT_EQ(names->valueAt(0).str(), "a");
+  EXPECT_EQ(names->valueAt(1).str(), "a much longer name \"quoted\"");
+  EXPECT_TRUE(names->isNullAt(2));
+  EXPECT_EQ(scores->valueAt(0), 1.5);
+  EXPECT_EQ(scores->valueAt(1), 2.0);
+  EXPECT_TRUE(scores->isNullAt(2));
+  EXPECT_TRUE(oks->valueAt(0));
+  EXPECT_FALSE(oks->valueAt(1));
+  EXPECT_TRUE(oks->isNullAt(2));
+}
+
+TEST_F(NdjsonReaderTest, WritesNestedRowsArraysAndMaps) {
+  auto user = velox::ROW({"name", "tags"},
+                         {velox::VARCHAR(), velox::ARRAY(velox::VARCHAR())});
+  auto type = velox::ROW(
+      {"user", "clicks", "attributes"},
+      {user, velox::ARRAY(velox::ARRAY(velox::INTEGER())),
+       velox::MAP(velox::VARCHAR(), velox::BIGINT())});
+  const std::string input =
+      R"({"user": {"name": "ann", "tags": ["a", "b"], "age": 3},)"
+      R"( "clicks": [[1, 2], [], [3]], "attributes": {"x": 1, "y": 2}})"
+      "\n"
+      R"({"user": null, "clicks": null, "attributes": {}})"
+      "\n"
+      R"({"user": {"tags": []}, "clicks": [null, [4]]})"
+      "\n";
+  auto batches = read(input, type);
+  ASSERT_TRUE(batches.ok()) << batches.status().message();
+  const auto& batch = batches->front();
+  ASSERT_EQ(batch->size(), 3);
+
+  auto* users = batch->childAt(0)->as<velox::RowVector>();
+  ASSERT_NE(users, nullptr);
+  EXPECT_FALSE(users->isNullAt(0));
+  EXPECT_TRUE(users->isNullAt(1));
+  EXPECT_FALSE(users->isNullAt(2));
+  auto* user_names = users->childAt(0)->asFlatVector<velox::StringView>();
+  EXPECT_EQ(user_names->valueAt(0).str(), "ann");
+  EXPECT_TRUE(user_names->isNullAt(2));
+  auto* tags = users->childAt(1)->as<velox::ArrayVector>();
+  EXPECT_EQ(tags->sizeAt(0), 2);
+  EXPECT_EQ(tags->sizeAt(2), 0);
+  EXPECT_FALSE(tags->isNullAt(2));
+  auto* tag_values = tags->elements()->asFlatVector<velox::StringView>();
+  EXPECT_EQ(tag_values->valueAt(tags->offsetAt(0) + 1).str(), "b");
+
+  auto* clicks = batch->childAt(1)->as<velox::ArrayVector>();
+  EXPECT_EQ(clicks->sizeAt(0), 3);
+  EXPECT_TRUE(clicks->isNullAt(1));
+  EXPECT_EQ(clicks->sizeAt(2), 2);
+  auto* inner = clicks->elements()->as<velox::ArrayVector>();
+  ASSERT_EQ(inner->size(), 5);
+  EXPECT_EQ(inner->sizeAt(0), 2);
+  EXPECT_EQ(inner->sizeAt(1), 0);
+  EXPECT_TRUE(inner->isNullAt(3));
+  auto* numbers = inner->elements()->asFlatVector<std::int32_t>();
+  EXPECT_EQ(numbers->valueAt(inner->offsetAt(4)), 4);
+  EXPECT_EQ(numbers->valueAt(inner->offsetAt(2)), 3);
+
+  auto* attributes = batch->childAt(2)->as<velox::MapVector>();
+  EXPECT_EQ(attributes->sizeAt(0), 2);
+  EXPECT_EQ(attributes->sizeAt(1), 0);
+  EXPECT_FALSE(attributes->isNullAt(1));
+  EXPECT_TRUE(attributes->isNullAt(2));
+  auto* keys = attributes->mapKeys()->asFlatVector<velox::StringView>();
+  auto* values = attributes->mapValues()->asFlatVector<std::int64_t>();
+  EXPECT_EQ(keys->valueAt(1).str(), "y");
+  EXPECT_EQ(values->valueAt(1), 2);
+}
+
+TEST_F(NdjsonReaderTest, VarcharKeepsJsonTextOfOtherValues) {
+  auto type = velox::ROW({"v"}, {velox::VARCHAR()});
+  auto batches = read(
+      "{\"v\": {\"a\": [1, 2]} }\n{\"v\": 12.50 }\n{\"v\": \"t\\u00e9\"}\n",
+      type);
+  ASSERT_TRUE(batches.ok()) << batches.status().message();
+  auto* values =
+      batches->front()->childAt(0)->asFlatVector<velox::StringView>();
+  EXPECT_EQ(values->valueAt(0).str(), R"({"a": [1, 2]})");
+  EXPECT_EQ(values->valueAt(1).str(), "12.50");
+  EXPECT_EQ(values->valueAt(2).str(), "t\xc3\xa9");
+}
+
+TEST_F(NdjsonReaderTest, ReadsFileInBlocksAndBatches) {
+  const auto path =
+      std::filesystem::temp_directory_path() /
+      ("halo_ndjson_reader_" + std::to_string(::getpid()) + ".json");
+  constexpr int kDocuments = 5000;
+  {
+    std::ofstream out(path, std::ios::binary);
+    for (int i = 0; i < kDocuments; ++i) {
+      out << R"({"n": )" << i << R"(, "pad": ")"
+          << std::string(static_cast<std::size_t>(i % 300), 'x')
+          << R"(", "s": "value number )" << i << "\"}\n";
+    }
+  }
+  auto file = storage::file::LocalReadFile::open(path.string());
+  ASSERT_TRUE(file.ok());
+  auto type = velox::ROW({"n", "s"}, {velox::INTEGER(), velox::VARCHAR()});
+  // Blocks smaller than some lines force the reader to grow its block.
+  auto reader = NdjsonReader::create(
+      type, {.batch_rows = 700, .read_block_bytes = 256}, pool_.get());
+  ASSERT_TRUE(reader.ok());
+  int row = 0;
+  std::size_t batches = 0;
+  auto stats = reader->read(**file, [&](velox::RowVectorPtr batch) {
+    EXPECT_LE(batch->size(), 700);
+    auto* n = batch->childAt(0)->asFlatVector<std::int32_t>();
+    auto* s = batch->childAt(1)->asFlatVector<velox::StringView>();
+    for (velox::vector_size_t i = 0; i < batch->size(); ++i, ++row) {
+      EXPECT_EQ(n->valueAt(i), row);
+      EXPECT_EQ(s->valueAt(i).str(), "value number " + std::to_string(row));
+    }
+    ++batches;
+    return common::base::Status::OK();
+  });
+  std::filesystem::remove(path);
+  ASSERT_TRUE(stats.ok()) << stats.status().message();
+  EXPECT_EQ(row, kDocuments);
+  EXPECT_EQ(stats->documents, static_cast<std::uint64_t>(kDocuments));
+  EXPECT_EQ(stats->batches, batches);
+  EXPECT_EQ(batches, 8U);
+  EXPECT_EQ(stats->skipped_fields, static_cast<std::uint64_t>(kDocuments));
+}
+
+TEST_F(NdjsonReaderTest, ReportsMismatchesWithTheirFieldPath) {
+  auto type = velox::ROW(
+      {"a", "b"},
+      {velox::INTEGER(), velox::ROW({"c"}, {velox::ARRAY(velox::BIGINT())})});
+  auto bad = read("{\"a\": 1}\n{\"a\": 2, \"b\": {\"c\": [1, \"x\"]}}\n", type);
+  ASSERT_FALSE(bad.ok());
+  EXPECT_NE(bad.status().message().find("document 1"), std::string::npos)
+      << bad.status().message();
+  EXPECT_NE(bad.status().message().find("'b.c'"), std::string::npos)
+      << bad.status().message();
+
+  EXPECT_FALSE(read("{\"a\": 99999999999}\n", type).ok());
+  EXPECT_FALSE(read("{\"a\": 1.5}\n", type).ok());
+  EXPECT_FALSE(read("[1, 2]\n", type).ok());
+  EXPECT_FALSE(read("{\"a\": 1}\n{\"a\": ", type).ok());
+
+  auto lenient = read("{\"a\": \"1\", \"b\": {\"c\": [1, \"x\", 3]}}\n", type,
+                      {.null_on_type_mismatch = true});
+  ASSERT_TRUE(lenient.ok()) << lenient.status().message();
+  const auto& batch = lenient->front();
+  EXPECT_TRUE(batch->childAt(0)->isNullAt(0));
+  auto* c = batch->childAt(1)->as<velox::RowVector>()->childAt(0)->as<
+      velox::ArrayVector>();
+  ASSERT_EQ(c->sizeAt(0), 3);
+  EXPECT_TRUE(c->elements()->isNullAt(1));
+  EXPECT_EQ(c->elements()->asFlatVector<std::int64_t>()->valueAt(2), 3);
+
+  auto int_keys =
+      velox::ROW({"m"}, {velox::MAP(velox::BIGINT(), velox::BIGINT())});
+  EXPECT_EQ(NdjsonReader::create(int_keys, {}, pool_.get()).status().code(),
+            common::base::Status::Code::kNotImplemented);
+}
+
+TEST_F(NdjsonReaderTest, SinkErrorStopsRead) {
+  auto type = velox::ROW({"a"}, {velox::BIGINT()});
+  std::string input;
+  for (int i = 0; i < 1000; ++i) {
+    input += "{\"a\": " + std::to_string(i) + "}\n";
+  }
+  auto reader = NdjsonReader::create(type, {.batch_rows = 100}, pool_.get());
+  ASSERT_TRUE(reader.ok());
+  int calls = 0;
+  auto stats = reader->read(simdjson::padded_string(input),
+                            [&](const velox::RowVectorPtr&) {
+                              return ++calls == 3
+                                         ? common::base::Status::StorageError(
+                                               "table full")
+                                         : common::base::Status::OK();
+                            });
+  ASSERT_FALSE(stats.ok());
+  EXPECT_EQ(stats.status().message(), "table full");
+  EXPECT_EQ(calls, 3);
+
+  // The reader is reusable after a failed read.
+  const simdjson::padded_string one(std::string("{\"a\": 7}\n"));
+  auto again = reader->read(one, [](velox::RowVectorPtr batch) {
+    EXPECT_EQ(batch->size(), 1);
+    return common::base::Status::OK();
+  });
+  ASSERT_TRUE(again.ok());
+  EXPECT_EQ(again->documents, 1U);
+}
+
+}  // namespace halo::ingest::json
@@ -0,0 +1,164 @@
+// Export throughput of ResultFormatter on a lineitem-like result against
+// printing every cell through duckdb::Value::ToString(), as the CLI does.
+
+#include <gtest/gtest.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+import halo.common;
+import halo.result.text;
+
+namespace halo::result::text {
+
+std::size_t exportPerValue(std::span<const std::int64_t> ids,
+                           std::span<const std::int32_t> quantities,
+                           std::span<const double> prices,
+                           std::span<const std::string> comments,
+                           std::span<const bool> flags, std::string& out);
+
+namespace {
+
+namespace velox = facebook::velox;
+
+constexpr int kRows = 1'000'000;
+constexpr int kBatchRows = 8192;
+
+struct Columns {
+  std::vector<std::int64_t> ids;
+  std::vector<std::int32_t> quantities;
+  std::vector<double> prices;
+  std::vector<std::string> comments;
+  std::unique_ptr<bool[]> flags;
+};
+
+Columns makeColumns() {
+  std::mt19937_64 rng(3);
+  Columns columns;
+  columns.flags = std::make_unique<bool[]>(kRows);
+  for (int i = 0; i < kRows; ++i) {
+    columns.ids.push_back(static_cast<std::int64_t>(rng() % 6'000'000'000ULL));
+    columns.quantities.push_back(static_cast<std::int32_t>(1 + rng() % 50));
+    columns.prices.push_back(static_cast<double>(rng() % 10'000'000) / 100.0);
+    columns.comments.push_back("carefully final deposits " +
+                               std::to_string(rng() % 1000));
+    columns.flags[i] = rng() % 2 == 0;
+  }
+  return columns;
+}
+
+velox::RowTypePtr rowType() {
+  return velox::ROW({"id", "quantity", "price", "comment", "flag"},
+                    {velox::BIGINT(), velox::INTEGER(), velox::DOUBLE(),
+                     velox::VARCHAR(), velox::BOOLEAN()});
+}
+
+std::vector<velox::RowVectorPtr> makeBatches(const Columns& columns,
+                                             velox::memory::MemoryPool* pool) {
+  const auto type = rowType();
+  std::vector<velox::RowVectorPtr> batches;
+  for (int begin = 0; begin < kRows; begin += kBatchRows) {
+    const int size = std::min(kBatchRows, kRows - begin);
+    std::vector<velox::VectorPtr> children;
+    for (const auto& child : type->children()) {
+      children.push_back(velox::BaseVector::create(child, size, pool));
+    }
+    for (int i = 0; i < size; ++i) {
+      const auto row = static_cast<std::size_t>(begin + i);
+      const auto& comment = columns.comments[row];
+      children[0]->asFlatVector<std::int64_t>()->set(i, columns.ids[row]);
+      children[1]->asFlatVector<std::int32_t>()->set(i,
+                                                     columns.quantities[row]);
+      children[2]->asFlatVector<double>()->set(i, columns.prices[row]);
+      children[3]->asFlatVector<velox::StringView>()->set(
+          i, velox::StringView(comment.data(),
+                               static_cast<std::int32_t>(comment.size())));
+      children[4]->asFlatVector<bool>()->set(i, columns.flags[row]);
+    }
+    batches.push_back(std::make_shared<velox::RowVector>(
+        pool, type, nullptr, size, std::move(children)));
+  }
+  return batches;
+}
+
+double perValueSeconds(const Columns& columns, std::size_t& bytes) {
+  std::string line;
+  const auto start = std::chrono::steady_clock::now();
+  bytes = exportPerValue(columns.ids, columns.quantities, columns.prices,
+                         columns.comments,
+                         std::span<const bool>(columns.flags.get(), kRows),
+                         line);
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+double formatterSeconds(const std::vector<velox::RowVectorPtr>& batches,
+                        TextFormat format, std::size_t& bytes) {
+  auto formatter = ResultFormatter::create(
+      rowType(), {.format = format, .header = false});
+  EXPECT_TRUE(formatter.ok());
+  bytes = 0;
+  const TextSink sink = [&](std::string_view text) {
+    bytes += text.size();
+    return common::base::Status::OK();
+  };
+  const auto start = std::chrono::steady_clock::now();
+  for (const auto& batch : batches) {
+    EXPECT_TRUE(formatter->write(*batch, sink).ok());
+  }
+  EXPECT_TRUE(formatter->flush(sink).ok());
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+}  // namespace
+
+TEST(ResultFormatterBenchmark, ColumnarVersusPerValueToString) {
+  auto pool = velox::memory::memoryManager()->addLeafPool("formatter_bench");
+  const Columns columns = makeColumns();
+  const auto batches = makeBatches(columns, pool.get());
+
+  std::size_t baseline_bytes = 0;
+  const double baseline = perValueSeconds(columns, baseline_bytes);
+  std::cout << std::fixed << std::setprecision(1) << kRows << " rows\n"
+            << std::left << std::setw(28) << "Value::ToString (CSV)"
+            << std::right << std::setw(10)
+            << static_cast<double>(baseline_bytes) / 1e6 / baseline
+            << " MB/s" << std::setw(10) << kRows / baseline / 1e6
+            << " Mrows/s\n";
+
+  double csv = 0;
+  for (const auto& [name, format] :
+       {std::pair{"ResultFormatter (CSV)", TextFormat::kCsv},
+        std::pair{"ResultFormatter (TSV)", TextFormat::kTsv},
+        std::pair{"ResultFormatter (JSONL)", TextFormat::kJsonLines}}) {
+    std::size_t bytes = 0;
+    const double seconds = formatterSeconds(batches, format, bytes);
+    if (format == TextFormat::kCsv) {
+      csv = seconds;
+    }
+    std::cout << std::left << std::setw(28) << name << std::right
+              << std::setw(10) << static_cast<double>(bytes) / 1e6 / seconds
+              << " MB/s" << std::setw(10) << kRows / seconds / 1e6
+              << " Mrows/s\n";
+  }
+  EXPECT_LT(csv, baseline);
+}
+
+}  // namespace halo::result::text
@@ -0,0 +1,37 @@
+// The per-cell export path used so far: every value becomes a duckdb::Value
+// and is printed with Value::ToString(). Kept out of the Velox translation
+// unit of the benchmark.
+
+#include <duckdb.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace halo::result::text {
+
+std::size_t exportPerValue(std::span<const std::int64_t> ids,
+                           std::span<const std::int32_t> quantities,
+                           std::span<const double> prices,
+                           std::span<const std::string> comments,
+                           std::span<const bool> flags, std::string& out) {
+  std::size_t bytes = 0;
+  for (std::size_t row = 0; row < ids.size(); ++row) {
+    out.clear();
+    out += duckdb::Value::BIGINT(ids[row]).ToString();
+    out += ',';
+    out += duckdb::Value::INTEGER(quantities[row]).ToString();
+    out += ',';
+    out += duckdb::Value::DOUBLE(prices[row]).ToString();
+    out += ',';
+    out += duckdb::Value(comments[row]).ToString();
+    out += ',';
+    out += duckdb::Value::BOOLEAN(flags[row]).ToString();
+    out += '\n';
+    bytes += out.size();
+  }
+  return bytes;
+}
+
+}  // namespace halo::result::text
@@ -0,0 +1,234 @@
+#include <gtest/gtest.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+import halo.common;
+import halo.result.text;
+
+namespace halo::result::text {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+class ResultFormatterTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    pool_ = velox::memory::memoryManager()->addLeafPool("result_formatter");
+  }
+
+  template <typename T>
+  velox::VectorPtr column(const velox::TypePtr& type,
+                          const std::vector<std::optional<T>>& values) {
+    auto vector = velox::BaseVector::create(
+        type, static_cast<velox::vector_size_t>(values.size()), pool_.get());
+    auto* flat = vector->asFlatVector<T>();
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      const auto row = static_cast<velox::vector_size_t>(i);
+      if (values[i].has_value()) {
+        flat->set(row, *values[i]);
+      } else {
+        vector->setNull(row, true);
+      }
+    }
+    return vector;
+  }
+
+  velox::VectorPtr strings(
+      const std::vector<std::optional<std::string>>& values) {
+    std::vector<std::optional<velox::StringView>> views;
+    for (const auto& value : values) {
+      if (value.has_value()) {
+        views.emplace_back(velox::StringView(
+            value->data(), static_cast<std::int32_t>(value->size())));
+      } else {
+        views.emplace_back();
+      }
+    }
+    return column<velox::StringView>(velox::VARCHAR(), views);
+  }
+
+  velox::RowVectorPtr batch(const velox::RowTypePtr& type,
+                            std::vector<velox::VectorPtr> children) {
+    const auto size = children.front()->size();
+    return std::make_shared<velox::RowVector>(pool_.get(), type, nullptr,
+                                              size, std::move(children));
+  }
+
+  static std::string format(const velox::RowTypePtr& type,
+                            const std::vector<velox::RowVectorPtr>& batches,
+                            const TextFormatOptions& options) {
+    auto formatter = ResultFormatter::create(type, options);
+    EXPECT_TRUE(formatter.ok()) << formatter.status().message();
+    std::string out;
+    const TextSink sink = [&](std::string_view text) {
+      out.append(text);
+      return common::base::Status::OK();
+    };
+    for (const auto& batch : batches) {
+      auto status = formatter->write(*batch, sink);
+      EXPECT_TRUE(status.ok()) << status.message();
+    }
+    auto status = formatter->flush(sink);
+    EXPECT_TRUE(status.ok()) << status.message();
+    return out;
+  }
+
+  std::shared_ptr<velox::memory::MemoryPool> pool_;
+};
+
+}  // namespace
+
+TEST_F(ResultFormatterTest, CsvQuotesOnlyWhenNeeded) {
+  auto type = velox::ROW({"id", "name", "price", "ok"},
+                         {velox::BIGINT(), velox::VARCHAR(), velox::DOUBLE(),
+                          velox::BOOLEAN()});
+  auto rows = batch(
+      type,
+      {column<std::int64_t>(velox::BIGINT(),
+                            {-9223372036854775807LL - 1, 0, 42, std::nullopt}),
+       strings({"plain", "a,b", "say \"hi\"", ""}),
+       column<double>(velox::DOUBLE(), {0.1, 1e21, -2.5, std::nullopt}),
+       column<bool>(velox::BOOLEAN(), {true, false, std::nullopt, true})});
+  EXPECT_EQ(format(type, {rows}, {}),
+            "id,name,price,ok\n"
+            "-9223372036854775808,plain,0.1,true\n"
+            "0,\"a,b\",1e+21,false\n"
+            "42,\"say \"\"hi\"\"\",-2.5,\n"
+            ",\"\",,true\n");
+  EXPECT_EQ(format(type, {rows}, {.header = false, .null_string = "NULL"}),
+            "-9223372036854775808,plain,0.1,true\n"
+            "0,\"a,b\",1e+21,false\n"
+            "42,\"say \"\"hi\"\"\",-2.5,NULL\n"
+            "NULL,,NULL,true\n");
+}
+
+TEST_F(ResultFormatterTest, TsvEscapesControlCharacters) {
+  auto type = velox::ROW({"k", "v"}, {velox::INTEGER(), velox::VARCHAR()});
+  auto rows = batch(
+      type, {column<std::int32_t>(velox::INTEGER(), {1, 2, 3}),
+             strings({"tab\there", "line\nbreak\\", std::nullopt})});
+  EXPECT_EQ(format(type, {rows},
+                   {.format = TextFormat::kTsv, .null_string = "\\N"}),
+            "k\tv\n"
+            "1\ttab\\there\n"
+            "2\tline\\nbreak\\\\\n"
+            "3\t\\N\n");
+
+  // The rest of COPY's text format escapes.
+  auto controls = batch(type, {column<std::int32_t>(velox::INTEGER(), {4}),
+                               strings({"\b\f\v\r"})});
+  EXPECT_EQ(format(type, {controls},
+                   {.format = TextFormat::kTsv, .header = false}),
+            "4\t\\b\\f\\v\\r\n");
+}
+
+TEST_F(ResultFormatterTest, TsvWritesBackslashNForNullByDefault) {
+  auto type = velox::ROW({"v"}, {velox::VARCHAR()});
+  auto rows = batch(type, {strings({"\\N", std::nullopt, ""})});
+  EXPECT_EQ(format(type, {rows}, {.format = TextFormat::kTsv}),
+            "v\n"
+            "\\\\N\n"
+            "\\N\n"
+            "\n");
+}
+
+TEST_F(ResultFormatterTest, LogicalTypesAreNotWrittenAsIntegers) {
+  auto type =
+      velox::ROW({"d", "price"}, {velox::DATE(), velox::DECIMAL(10, 2)});
+  auto rows = batch(
+      type, {column<std::int32_t>(velox::DATE(), {19000, -1, std::nullopt}),
+             column<std::int64_t>(velox::DECIMAL(10, 2), {12345, -5, 0})});
+  EXPECT_EQ(format(type, {rows}, {}),
+            "d,price\n"
+            "2022-01-08,123.45\n"
+            "1969-12-31,-0.05\n"
+            ",0.00\n");
+  EXPECT_EQ(format(type, {rows}, {.format = TextFormat::kJsonLines}),
+            "{\"d\":\"2022-01-08\",\"price\":123.45}\n"
+            "{\"d\":\"1969-12-31\",\"price\":-0.05}\n"
+            "{\"d\":null,\"price\":0.00}\n");
+
+  auto intervals = velox::ROW({"i"}, {velox::INTERVAL_YEAR_MONTH()});
+  auto months = batch(intervals, {column<std::int32_t>(
+                                     velox::INTERVAL_YEAR_MONTH(), {14})});
+  EXPECT_NE(format(intervals, {months}, {.header = false}), "14\n");
+}
+
+TEST_F(ResultFormatterTest, JsonLinesEscapesStringsAndNonFiniteNumbers) {
+  auto type = velox::ROW({"n", "s", "x"},
+                         {velox::SMALLINT(), velox::VARCHAR(), velox::REAL()});
+  auto rows = batch(
+      type,
+      {column<std::int16_t>(velox::SMALLINT(), {7, std::nullopt}),
+       strings({"q\"\\\x01", "caf\xc3\xa9"}),
+       column<float>(velox::REAL(),
+                     {1.5F, std::numeric_limits<float>::infinity()})});
+  EXPECT_EQ(format(type, {rows}, {.format = TextFormat::kJsonLines}),
+            "{\"n\":7,\"s\":\"q\\\"\\\\\\u0001\",\"x\":1.5}\n"
+            "{\"n\":null,\"s\":\"caf\xc3\xa9\",\"x\":null}\n");
+}
+
+TEST_F(ResultFormatterTest, FlushesWhenBufferFillsAndAcrossBatches) {
+  auto type = velox::ROW({"v"}, {velox::BIGINT()});
+  std::vector<velox::RowVectorPtr> batches;
+  std::string expected = "v\n";
+  for (int b = 0; b < 3; ++b) {
+    std::vector<std::optional<std::int64_t>> values;
+    for (int i = 0; i < 1000; ++i) {
+      values.emplace_back(b * 1000 + i);
+      expected += std::to_string(b * 1000 + i) + "\n";
+    }
+    batches.push_back(
+        batch(type, {column<std::int64_t>(velox::BIGINT(), values)}));
+  }
+  auto formatter = ResultFormatter::create(type, {.buffer_bytes = 100});
+  ASSERT_TRUE(formatter.ok());
+  std::string out;
+  int calls = 0;
+  const TextSink sink = [&](std::string_view text) {
+    EXPECT_LT(text.size(), 120U);
+    out.append(text);
+    ++calls;
+    return common::base::Status::OK();
+  };
+  for (const auto& rows : batches) {
+    ASSERT_TRUE(formatter->write(*rows, sink).ok());
+  }
+  ASSERT_TRUE(formatter->flush(sink).ok());
+  EXPECT_EQ(out, expected);
+  EXPECT_GT(calls, 100);
+}
+
+TEST_F(ResultFormatterTest, HeaderOnlyForEmptyResultAndSinkErrors) {
+  auto type = velox::ROW({"a", "b c"}, {velox::BIGINT(), velox::VARCHAR()});
+  EXPECT_EQ(format(type, {}, {}), "a,b c\n");
+  EXPECT_EQ(format(type, {}, {.format = TextFormat::kJsonLines}), "");
+
+  auto formatter = ResultFormatter::create(type, {.buffer_bytes = 1});
+  ASSERT_TRUE(formatter.ok());
+  auto rows = batch(type, {column<std::int64_t>(velox::BIGINT(), {1, 2}),
+                           strings({"x", "y"})});
+  auto status = formatter->write(*rows, [](std::string_view) {
+    return common::base::Status::StorageError("socket closed");
+  });
+  EXPECT_EQ(status.message(), "socket closed");
+
+  auto narrow = batch(velox::ROW({"a"}, {velox::BIGINT()}),
+                      {column<std::int64_t>(velox::BIGINT(), {1})});
+  EXPECT_FALSE(formatter->write(*narrow, [](std::string_view) {
+                 return common::base::Status::OK();
+               }).ok());
+}
+
+}  // namespace halo::result::text
@@ -0,0 +1,216 @@
+// Latency of short interactive queries while batch load rises, with every
+// query started at once and through the admission controller. Queries burn
+// a fixed amount of CPU, so that without admission they slow each other
+// down as soon as there are more of them than cores; with admission the
+// batch queries queue within their share of the CPU slots and interactive
+// p99 stays close to its unloaded value.
+
+#include <gtest/gtest.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+import halo.common;
+import halo.server.engine;
+import halo.server.admission;
+
+namespace halo::server::admission {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+using common::base::Status;
+using common::base::StatusOr;
+using engine::QueryEngine;
+using engine::RowVectorSink;
+
+constexpr auto kRunTime = std::chrono::milliseconds(1500);
+constexpr auto kThinkTime = std::chrono::milliseconds(2);
+constexpr double kInteractiveMillis = 1;
+constexpr double kBatchMillis = 40;
+constexpr const char* kInteractive = "SELECT * FROM t WHERE id = 1";
+constexpr const char* kBatch = "/*+ priority=batch */ SELECT * FROM t";
+
+std::uint64_t burn(std::uint64_t iterations) {
+  std::uint64_t x = iterations;
+  for (std::uint64_t i = 0; i < iterations; ++i) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+  }
+  return x;
+}
+
+// Iterations of `burn' per millisecond of one core.
+std::uint64_t calibrate() {
+  constexpr std::uint64_t kIterations = 50'000'000;
+  const auto start = std::chrono::steady_clock::now();
+  volatile auto sink = burn(kIterations);
+  (void)sink;
+  const auto millis = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+  return static_cast<std::uint64_t>(static_cast<double>(kIterations) /
+                                    std::max(millis, 1.0));
+}
+
+// Burns the CPU time of an interactive or a batch query.
+class BurnEngine final : public QueryEngine {
+ public:
+  explicit BurnEngine(std::uint64_t per_milli) : per_milli_(per_milli) {}
+
+  StatusOr<velox::RowTypePtr> describe(const std::string&) override {
+    return velox::ROW({"x"}, {velox::BIGINT()});
+  }
+
+  Status execute(const std::string& query, velox::memory::MemoryPool*,
+                 const RowVectorSink&) override {
+    const auto millis = query == kBatch ? kBatchMillis : kInteractiveMillis;
+    result_ += burn(static_cast<std::uint64_t>(
+        millis * static_cast<double>(per_milli_)));
+    return Status::OK();
+  }
+
+ private:
+  const std::uint64_t per_milli_;
+  std::atomic<std::uint64_t> result_{0};
+};
+
+struct Run {
+  std::vector<double> interactive_ms;
+  std::int64_t batches = 0;
+};
+
+Run load(QueryEngine& engine, int interactive_clients, int batch_clients) {
+  auto root = velox::memory::memoryManager()->addRootPool("load", 256 << 20);
+  auto pool = root->addLeafChild("load_leaf");
+  std::atomic<bool> stop{false};
+  std::atomic<std::int64_t> batches{0};
+  std::vector<std::vector<double>> latencies(interactive_clients);
+  std::vector<std::thread> threads;
+  for (int b = 0; b < batch_clients; ++b) {
+    threads.emplace_back([&] {
+      while (!stop) {
+        EXPECT_TRUE(engine.execute(kBatch, pool.get(), {}).ok());
+        ++batches;
+      }
+    });
+  }
+  for (int c = 0; c < interactive_clients; ++c) {
+    threads.emplace_back([&, c] {
+      while (!stop) {
+        const auto start = std::chrono::steady_clock::now();
+        EXPECT_TRUE(engine.execute(kInteractive, pool.get(), {}).ok());
+        latencies[c].push_back(std::chrono::duration<double, std::milli>(
+                                   std::chrono::steady_clock::now() - start)
+                                   .count());
+        std::this_thread::sleep_for(kThinkTime);
+      }
+    });
+  }
+  std::this_thread::sleep_for(kRunTime);
+  stop = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  Run run{.batches = batches};
+  for (const auto& client : latencies) {
+    run.interactive_ms.insert(run.interactive_ms.end(), client.begin(),
+                              client.end());
+  }
+  std::sort(run.interactive_ms.begin(), run.interactive_ms.end());
+  return run;
+}
+
+double percentile(const std::vector<double>& sorted, double fraction) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  const auto index = static_cast<std::size_t>(
+      fraction * static_cast<double>(sorted.size() - 1));
+  return sorted[index];
+}
+
+}  // namespace
+
+TEST(AdmissionLoadBenchmark, InteractiveLatencyUnderRisingBatchLoad) {
+  const auto cores =
+      static_cast<int>(std::max(1U, std::thread::hardware_concurrency()));
+  const int interactive_clients = std::max(2, cores / 4);
+  auto burner = std::make_shared<BurnEngine>(calibrate());
+  auto admission = AdmissionController::create(
+      {.memory_bytes = 64ULL << 30,
+       .cpu_slots = static_cast<std::uint32_t>(cores)});
+  ASSERT_TRUE(admission.ok()) << admission.status().toString();
+  auto admitted = AdmittedQueryEngine::create(burner, *admission);
+  ASSERT_TRUE(admitted.ok()) << admitted.status().toString();
+
+  std::cout << std::fixed << std::setprecision(2) << cores << " cores, "
+            << interactive_clients << " interactive clients of "
+            << kInteractiveMillis << " ms queries, batch queries of "
+            << kBatchMillis << " ms\n"
+            << std::left << std::setw(12) << "admission" << std::right
+            << std::setw(8) << "batch" << std::setw(10) << "p50 ms"
+            << std::setw(10) << "p99 ms" << std::setw(12) << "batch/s"
+            << "\n";
+  // Interactive p99 under the heaviest batch load, without and with
+  // admission.
+  double heaviest_p99[2] = {0, 0};
+  for (const bool admit : {false, true}) {
+    QueryEngine& engine = admit ? static_cast<QueryEngine&>(**admitted)
+                                : static_cast<QueryEngine&>(*burner);
+    for (const int batch_clients : {0, cores, 4 * cores, 16 * cores}) {
+      const auto run = load(engine, interactive_clients, batch_clients);
+      EXPECT_FALSE(run.interactive_ms.empty());
+      if (batch_clients == 16 * cores) {
+        heaviest_p99[admit] = percentile(run.interactive_ms, 0.99);
+      }
+      std::cout << std::left << std::setw(12) << (admit ? "on" : "off")
+                << std::right << std::setw(8) << batch_clients
+                << std::setw(10) << percentile(run.interactive_ms, 0.5)
+                << std::setw(10) << percentile(run.interactive_ms, 0.99)
+                << std::setw(12)
+                << static_cast<double>(run.batches) /
+                       std::chrono::duration<double>(kRunTime).count()
+                << "\n";
+    }
+  }
+  // A single core has no CPU slots to keep free for interactive queries.
+  if (cores > 1) {
+    EXPECT_LT(heaviest_p99[true], heaviest_p99[false]);
+  }
+
+  const auto stats = (*admission)->stats();
+  for (const auto& group : stats.groups) {
+    for (const auto priority :
+         {QueryPriority::kInteractive, QueryPriority::kBatch}) {
+      const auto& counters =
+          group.classes[static_cast<std::size_t>(priority)];
+      std::cout << group.name << "/"
+                << (priority == QueryPriority::kBatch ? "batch"
+                                                      : "interactive")
+                << ": " << counters.admitted << " admitted, wait p99 "
+                << std::chrono::duration<double, std::milli>(
+                       counters.waitPercentile(0.99))
+                       .count()
+                << " ms, max "
+                << std::chrono::duration<double, std::milli>(
+                       counters.max_wait)
+                       .count()
+                << " ms\n";
+    }
+  }
+}
+
+}  // namespace halo::server::admission
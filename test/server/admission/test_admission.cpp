@@ -0,0 +1,379 @@
+#include <gtest/gtest.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+import halo.common;
+import halo.server.engine;
+import halo.server.admission;
+
+namespace halo::server::admission {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+using common::base::Status;
+using common::base::StatusOr;
+using engine::QueryEngine;
+using engine::RowVectorSink;
+
+std::shared_ptr<AdmissionController> controller(AdmissionOptions options) {
+  auto created = AdmissionController::create(std::move(options));
+  EXPECT_TRUE(created.ok()) << created.status().toString();
+  return std::move(created).value();
+}
+
+QueryDemand demand(QueryPriority priority, std::uint64_t memory_bytes = 1,
+                   std::uint32_t cpu_slots = 1,
+                   std::string group = std::string(kDefaultGroup)) {
+  return {.group = std::move(group),
+          .priority = priority,
+          .memory_bytes = memory_bytes,
+          .cpu_slots = cpu_slots};
+}
+
+AdmissionTicket admitted(AdmissionController& admission,
+                         QueryDemand query) {
+  auto ticket = admission.admit(std::move(query));
+  EXPECT_TRUE(ticket.ok()) << ticket.status().toString();
+  return std::move(ticket).value();
+}
+
+const ClassStats& classStats(const AdmissionStats& stats,
+                             const std::string& group,
+                             QueryPriority priority) {
+  const auto it =
+      std::find_if(stats.groups.begin(), stats.groups.end(),
+                   [&](const GroupStats& g) { return g.name == group; });
+  EXPECT_NE(it, stats.groups.end()) << group;
+  return it->classes[static_cast<std::size_t>(priority)];
+}
+
+std::uint64_t queued(const AdmissionController& admission,
+                     QueryPriority priority,
+                     const std::string& group = std::string(kDefaultGroup)) {
+  return classStats(admission.stats(), group, priority).queued;
+}
+
+bool eventually(const std::function<bool()>& condition) {
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!condition()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+// Admits `query' on a thread of its own and holds the ticket until told to
+// let go.
+class Client final {
+ public:
+  Client(std::shared_ptr<AdmissionController> admission, QueryDemand query)
+      : thread_([this, admission = std::move(admission),
+                 query = std::move(query)]() mutable {
+          auto ticket = admission->admit(std::move(query));
+          ok_ = ticket.ok();
+          done_ = true;
+          while (!release_) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+          }
+        }) {}
+
+  Client(const Client&) = delete;
+  Client& operator=(const Client&) = delete;
+
+  ~Client() {
+    release_ = true;
+    thread_.join();
+  }
+
+  [[nodiscard]] bool admitted() const { return done_ && ok_; }
+
+  void release() { release_ = true; }
+
+ private:
+  std::atomic<bool> ok_{false};
+  std::atomic<bool> done_{false};
+  std::atomic<bool> release_{false};
+  std::thread thread_;
+};
+
+}  // namespace
+
+TEST(AdmissionControllerTest, AdmitsWithinTheBudgets) {
+  auto admission = controller({.memory_bytes = 100, .cpu_slots = 4});
+  std::vector<AdmissionTicket> tickets;
+  for (int i = 0; i < 4; ++i) {
+    tickets.push_back(
+        admitted(*admission, demand(QueryPriority::kInteractive, 20)));
+  }
+  auto stats = admission->stats();
+  EXPECT_EQ(stats.memory_bytes, 80U);
+  EXPECT_EQ(stats.cpu_slots, 4U);
+  const auto& interactive = classStats(stats, "default",
+                                       QueryPriority::kInteractive);
+  EXPECT_EQ(interactive.running, 4U);
+  EXPECT_EQ(interactive.admitted, 4U);
+  EXPECT_EQ(interactive.queued, 0U);
+
+  tickets.clear();
+  stats = admission->stats();
+  EXPECT_EQ(stats.memory_bytes, 0U);
+  EXPECT_EQ(stats.cpu_slots, 0U);
+}
+
+TEST(AdmissionControllerTest, QueuesUntilBudgetsAreReleased) {
+  auto admission = controller({.memory_bytes = 100, .cpu_slots = 1});
+  std::optional<AdmissionTicket> holder =
+      admitted(*admission, demand(QueryPriority::kInteractive));
+  Client waiting(admission, demand(QueryPriority::kInteractive));
+  ASSERT_TRUE(eventually(
+      [&] { return queued(*admission, QueryPriority::kInteractive) == 1; }));
+  EXPECT_FALSE(waiting.admitted());
+
+  holder.reset();
+  ASSERT_TRUE(eventually([&] { return waiting.admitted(); }));
+  const auto stats = admission->stats();
+  const auto& interactive = classStats(stats, "default",
+                                       QueryPriority::kInteractive);
+  EXPECT_EQ(interactive.queued, 0U);
+  EXPECT_EQ(interactive.admitted, 2U);
+  EXPECT_GT(interactive.max_wait.count(), 0);
+  EXPECT_GT(interactive.waitPercentile(1.0).count(), 0);
+  EXPECT_LE(interactive.waitPercentile(1.0), interactive.max_wait);
+}
+
+TEST(AdmissionControllerTest, InteractiveQueriesOvertakeQueuedBatch) {
+  auto admission = controller(
+      {.memory_bytes = 100, .cpu_slots = 1, .batch_slot_fraction = 1});
+  std::optional<AdmissionTicket> holder =
+      admitted(*admission, demand(QueryPriority::kBatch));
+  Client batch(admission, demand(QueryPriority::kBatch));
+  ASSERT_TRUE(eventually(
+      [&] { return queued(*admission, QueryPriority::kBatch) == 1; }));
+  Client interactive(admission, demand(QueryPriority::kInteractive));
+  ASSERT_TRUE(eventually(
+      [&] { return queued(*admission, QueryPriority::kInteractive) == 1; }));
+
+  holder.reset();
+  ASSERT_TRUE(eventually([&] { return interactive.admitted(); }));
+  EXPECT_FALSE(batch.admitted());
+  interactive.release();
+  ASSERT_TRUE(eventually([&] { return batch.admitted(); }));
+}
+
+TEST(AdmissionControllerTest, BatchShareLeavesRoomForInteractive) {
+  auto admission = controller(
+      {.memory_bytes = 100, .cpu_slots = 4, .batch_slot_fraction = 0.5});
+  std::optional<AdmissionTicket> first =
+      admitted(*admission, demand(QueryPriority::kBatch));
+  auto second = admitted(*admission, demand(QueryPriority::kBatch));
+  Client third(admission, demand(QueryPriority::kBatch));
+  ASSERT_TRUE(eventually(
+      [&] { return queued(*admission, QueryPriority::kBatch) == 1; }));
+
+  // Would wait for the queue timeout if held up by the batch query.
+  auto interactive = admission->admit(demand(QueryPriority::kInteractive));
+  ASSERT_TRUE(interactive.ok());
+  EXPECT_FALSE(third.admitted());
+
+  first.reset();
+  EXPECT_TRUE(eventually([&] { return third.admitted(); }));
+}
+
+TEST(AdmissionControllerTest, GroupBudgetsOnlyHoldBackTheirGroup) {
+  auto admission = controller(
+      {.memory_bytes = 100,
+       .cpu_slots = 4,
+       .groups = {{.name = "etl", .slot_fraction = 0.25}}});
+  std::optional<AdmissionTicket> etl =
+      admitted(*admission, demand(QueryPriority::kInteractive, 1, 1, "etl"));
+  Client next_etl(admission, demand(QueryPriority::kInteractive, 1, 1, "etl"));
+  ASSERT_TRUE(eventually([&] {
+    return queued(*admission, QueryPriority::kInteractive, "etl") == 1;
+  }));
+  auto other = admission->admit(demand(QueryPriority::kInteractive));
+  EXPECT_TRUE(other.ok());
+  EXPECT_FALSE(next_etl.admitted());
+
+  // Unknown groups fall back to the default group.
+  auto unknown = admission->admit(
+      demand(QueryPriority::kInteractive, 1, 1, "no_such_group"));
+  EXPECT_TRUE(unknown.ok());
+  EXPECT_EQ(classStats(admission->stats(), "default",
+                       QueryPriority::kInteractive)
+                .running,
+            2U);
+
+  etl.reset();
+  EXPECT_TRUE(eventually([&] { return next_etl.admitted(); }));
+}
+
+TEST(AdmissionControllerTest, QueryHeldUpByGlobalBudgetsKeepsItsTurn) {
+  auto admission = controller({.memory_bytes = 100, .cpu_slots = 8});
+  std::optional<AdmissionTicket> holder =
+      admitted(*admission, demand(QueryPriority::kInteractive, 60));
+  Client large(admission, demand(QueryPriority::kInteractive, 50));
+  ASSERT_TRUE(eventually(
+      [&] { return queued(*admission, QueryPriority::kInteractive) == 1; }));
+  Client small(admission, demand(QueryPriority::kInteractive, 10));
+  ASSERT_TRUE(eventually(
+      [&] { return queued(*admission, QueryPriority::kInteractive) == 2; }));
+  EXPECT_FALSE(small.admitted());
+
+  holder.reset();
+  ASSERT_TRUE(eventually([&] { return large.admitted(); }));
+  ASSERT_TRUE(eventually([&] { return small.admitted(); }));
+}
+
+TEST(AdmissionControllerTest, RefusesWhatCannotWait) {
+  auto admission = controller(
+      {.memory_bytes = 100,
+       .cpu_slots = 1,
+       .queue_timeout = std::chrono::milliseconds(20),
+       .groups = {{.name = "strict", .max_queued = 0}}});
+  const auto oversized =
+      admission->admit(demand(QueryPriority::kInteractive, 101));
+  ASSERT_FALSE(oversized.ok());
+  EXPECT_EQ(oversized.status().code(), Status::Code::kInvalid);
+
+  auto holder = admitted(*admission, demand(QueryPriority::kInteractive));
+  const auto timed_out = admission->admit(demand(QueryPriority::kInteractive));
+  ASSERT_FALSE(timed_out.ok());
+  EXPECT_EQ(timed_out.status().code(), Status::Code::kQueryExecutorError);
+
+  const auto full = admission->admit(
+      demand(QueryPriority::kInteractive, 1, 1, "strict"));
+  ASSERT_FALSE(full.ok());
+  EXPECT_EQ(full.status().code(), Status::Code::kQueryExecutorError);
+
+  const auto stats = admission->stats();
+  EXPECT_EQ(classStats(stats, "default", QueryPriority::kInteractive).rejected,
+            2U);
+  EXPECT_EQ(classStats(stats, "strict", QueryPriority::kInteractive).rejected,
+            1U);
+  EXPECT_EQ(classStats(stats, "default", QueryPriority::kInteractive).queued,
+            0U);
+}
+
+TEST(AdmissionControllerTest, RejectsInvalidOptions) {
+  EXPECT_FALSE(AdmissionController::create({.cpu_slots = 0}).ok());
+  EXPECT_FALSE(
+      AdmissionController::create({.batch_slot_fraction = 1.5}).ok());
+  EXPECT_FALSE(
+      AdmissionController::create({.groups = {{.name = "default"}}}).ok());
+  EXPECT_FALSE(AdmissionController::create(
+                   {.groups = {{.name = "x", .memory_fraction = 0}}})
+                   .ok());
+}
+
+TEST(QueryClassifierTest, ReadsLeadingHint) {
+  const auto plain = classifyByHint("SELECT 1");
+  EXPECT_EQ(plain.group, kDefaultGroup);
+  EXPECT_EQ(plain.priority, QueryPriority::kInteractive);
+  EXPECT_EQ(plain.cpu_slots, 1U);
+
+  const auto hinted = classifyByHint(
+      "  /*+ group=etl priority=batch slots=4 junk */ SELECT * FROM t");
+  EXPECT_EQ(hinted.group, "etl");
+  EXPECT_EQ(hinted.priority, QueryPriority::kBatch);
+  EXPECT_EQ(hinted.cpu_slots, 4U);
+
+  const auto malformed = classifyByHint("/*+ slots=x priority=urgent */");
+  EXPECT_EQ(malformed.priority, QueryPriority::kInteractive);
+  EXPECT_EQ(malformed.cpu_slots, 1U);
+  EXPECT_EQ(classifyByHint("SELECT 1 /*+ priority=batch */").priority,
+            QueryPriority::kInteractive);
+}
+
+namespace {
+
+// Counts the queries it runs at once, each taking a few milliseconds.
+class CountingEngine final : public QueryEngine {
+ public:
+  StatusOr<velox::RowTypePtr> describe(const std::string&) override {
+    return velox::ROW({"x"}, {velox::BIGINT()});
+  }
+
+  Status execute(const std::string& query, velox::memory::MemoryPool*,
+                 const RowVectorSink&) override {
+    const auto now = ++running_;
+    auto peak = peak_.load();
+    while (now > peak && !peak_.compare_exchange_weak(peak, now)) {
+    }
+    if (observe_) {
+      observe_();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    --running_;
+    return query == "fail" ? Status::QueryExecutorError("failed")
+                           : Status::OK();
+  }
+
+  std::function<void()> observe_;
+  std::atomic<int> running_{0};
+  std::atomic<int> peak_{0};
+};
+
+}  // namespace
+
+TEST(AdmittedQueryEngineTest, BoundsConcurrencyAndReservesPoolCapacity) {
+  constexpr std::int64_t kPoolBytes = 64 << 20;
+  auto admission = controller({.memory_bytes = 1ULL << 30, .cpu_slots = 2});
+  auto counting = std::make_shared<CountingEngine>();
+  auto admitted_engine = AdmittedQueryEngine::create(counting, admission);
+  ASSERT_TRUE(admitted_engine.ok());
+  auto engine = std::move(admitted_engine).value();
+
+  auto root = velox::memory::memoryManager()->addRootPool("admitted",
+                                                          kPoolBytes);
+  auto pool = root->addLeafChild("admitted_leaf");
+  std::atomic<std::uint64_t> reserved{0};
+  counting->observe_ = [&] {
+    reserved = std::max<std::uint64_t>(reserved,
+                                       admission->stats().memory_bytes);
+  };
+
+  std::vector<std::thread> threads;
+  std::atomic<int> failures{0};
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&] {
+      if (!engine->execute("SELECT 1", pool.get(), {}).ok()) {
+        ++failures;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(failures.load(), 0);
+  EXPECT_LE(counting->peak_.load(), 2);
+  EXPECT_GE(reserved.load(), static_cast<std::uint64_t>(kPoolBytes));
+  EXPECT_LE(reserved.load(), static_cast<std::uint64_t>(2 * kPoolBytes));
+
+  const auto failed = engine->execute("fail", pool.get(), {});
+  EXPECT_EQ(failed.code(), Status::Code::kQueryExecutorError);
+  const auto stats = admission->stats();
+  EXPECT_EQ(stats.cpu_slots, 0U);
+  EXPECT_EQ(stats.memory_bytes, 0U);
+  EXPECT_EQ(classStats(stats, "default", QueryPriority::kInteractive).admitted,
+            9U);
+}
+
+}  // namespace halo::server::admission
@@ -0,0 +1,338 @@
+#include <arrow/buffer.h>
+#include <arrow/util/compression.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+import halo.common;
+import halo.server.engine;
+import halo.server.cache;
+
+namespace halo::server::cache {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+using common::base::Status;
+using common::base::StatusOr;
+using engine::PlanFingerprint;
+using engine::QueryEngine;
+using engine::RowVectorSink;
+
+constexpr int kBatches = 3;
+constexpr int kBatchRows = 1000;
+
+velox::RowTypePtr rowType() {
+  return velox::ROW({"id", "name"}, {velox::BIGINT(), velox::VARCHAR()});
+}
+
+// Reads table `t': a few batches of ids and names, produced slowly enough
+// that a cache hit is measurably faster. Queries calling random() cannot be
+// cached.
+class TableEngine final : public QueryEngine {
+ public:
+  StatusOr<velox::RowTypePtr> describe(const std::string&) override {
+    return rowType();
+  }
+
+  Status execute(const std::string&, velox::memory::MemoryPool* pool,
+                 const RowVectorSink& sink) override {
+    ++executions_;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    for (int b = 0; b < kBatches; ++b) {
+      auto ids = velox::BaseVector::create<velox::FlatVector<std::int64_t>>(
+          velox::BIGINT(), kBatchRows, pool);
+      auto names =
+          velox::BaseVector::create<velox::FlatVector<velox::StringView>>(
+              velox::VARCHAR(), kBatchRows, pool);
+      for (int i = 0; i < kBatchRows; ++i) {
+        const auto id = b * kBatchRows + i;
+        ids->set(i, id);
+        names->set(i, velox::StringView("name_" + std::to_string(id % 7)));
+      }
+      auto status = sink(std::make_shared<velox::RowVector>(
+          pool, rowType(), nullptr, kBatchRows,
+          std::vector<velox::VectorPtr>{ids, names}));
+      if (!status.ok()) {
+        return status;
+      }
+    }
+    return Status::OK();
+  }
+
+  std::optional<PlanFingerprint> fingerprint(
+      const std::string& query) override {
+    if (query.find("random()") != std::string::npos) {
+      return std::nullopt;
+    }
+    return PlanFingerprint{.hash = std::hash<std::string>{}(query),
+                           .tables = {"t"}};
+  }
+
+  std::atomic<int> executions_{0};
+};
+
+struct Collected {
+  Status status;
+  std::int64_t rows = 0;
+  std::int64_t id_sum = 0;
+  std::string last_name;
+};
+
+Collected collect(QueryEngine& engine, const std::string& query,
+                  velox::memory::MemoryPool* pool) {
+  Collected collected;
+  collected.status =
+      engine.execute(query, pool, [&](velox::RowVectorPtr batch) {
+        EXPECT_TRUE(batch->type()->equivalent(*rowType()));
+        const auto* ids = batch->childAt(0)->as<velox::SimpleVector<
+            std::int64_t>>();
+        const auto* names =
+            batch->childAt(1)->as<velox::SimpleVector<velox::StringView>>();
+        for (velox::vector_size_t i = 0; i < batch->size(); ++i) {
+          collected.id_sum += ids->valueAt(i);
+          collected.last_name = names->valueAt(i).str();
+        }
+        collected.rows += batch->size();
+        return Status::OK();
+      });
+  return collected;
+}
+
+std::shared_ptr<ResultCache> makeCache(
+    const ResultCacheOptions& options,
+    std::shared_ptr<TableVersions> versions = TableVersions::create()) {
+  auto cache = ResultCache::create(options, std::move(versions));
+  EXPECT_TRUE(cache.ok()) << cache.status().toString();
+  return std::move(cache).value();
+}
+
+CachedResult bytes(std::size_t size, char fill) {
+  return {.ipc = arrow::Buffer::FromString(std::string(size, fill)),
+          .rows = 1,
+          .cost = std::chrono::milliseconds(1)};
+}
+
+class CachingQueryEngineTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = velox::memory::memoryManager()->addRootPool("result_cache");
+    pool_ = root_->addLeafChild("result_cache_leaf");
+    table_ = std::make_shared<TableEngine>();
+    cache_ = makeCache({});
+    auto engine = CachingQueryEngine::create(table_, cache_);
+    ASSERT_TRUE(engine.ok()) << engine.status().toString();
+    engine_ = std::move(engine).value();
+  }
+
+  std::shared_ptr<velox::memory::MemoryPool> root_;
+  std::shared_ptr<velox::memory::MemoryPool> pool_;
+  std::shared_ptr<TableEngine> table_;
+  std::shared_ptr<ResultCache> cache_;
+  std::shared_ptr<CachingQueryEngine> engine_;
+};
+
+}  // namespace
+
+TEST_F(CachingQueryEngineTest, HitStreamsBackWithoutRunningTheQuery) {
+  const auto first = collect(*engine_, "SELECT * FROM t", pool_.get());
+  ASSERT_TRUE(first.status.ok()) << first.status.toString();
+  const auto second = collect(*engine_, "SELECT * FROM t", pool_.get());
+  ASSERT_TRUE(second.status.ok()) << second.status.toString();
+
+  EXPECT_EQ(table_->executions_.load(), 1);
+  EXPECT_EQ(second.rows, kBatches * kBatchRows);
+  EXPECT_EQ(second.rows, first.rows);
+  EXPECT_EQ(second.id_sum, first.id_sum);
+  EXPECT_EQ(second.last_name, first.last_name);
+
+  const auto stats = cache_->stats();
+  EXPECT_EQ(stats.hits, 1U);
+  EXPECT_EQ(stats.misses, 1U);
+  EXPECT_EQ(stats.inserts, 1U);
+  EXPECT_DOUBLE_EQ(stats.hitRatio(), 0.5);
+  EXPECT_GT(stats.saved.count(), 0);
+  if (arrow::util::Codec::IsAvailable(arrow::Compression::ZSTD)) {
+    // Compressed below the size of the ids alone.
+    EXPECT_LT(stats.memory_bytes,
+              static_cast<std::uint64_t>(kBatches * kBatchRows * 8));
+  }
+}
+
+TEST_F(CachingQueryEngineTest, WriteToATableInvalidatesItsResults) {
+  ASSERT_TRUE(collect(*engine_, "SELECT * FROM t", pool_.get()).status.ok());
+  EXPECT_EQ(cache_->stats().entries, 1U);
+
+  cache_->versions()->bump("other");
+  EXPECT_EQ(cache_->stats().entries, 1U);
+  cache_->versions()->bump("t");
+  EXPECT_EQ(cache_->stats().entries, 0U);
+  EXPECT_EQ(cache_->stats().invalidations, 1U);
+
+  ASSERT_TRUE(collect(*engine_, "SELECT * FROM t", pool_.get()).status.ok());
+  EXPECT_EQ(table_->executions_.load(), 2);
+  ASSERT_TRUE(collect(*engine_, "SELECT * FROM t", pool_.get()).status.ok());
+  EXPECT_EQ(table_->executions_.load(), 2);
+}
+
+TEST_F(CachingQueryEngineTest, UncacheableQueriesRunEveryTime) {
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(collect(*engine_, "SELECT random() FROM t", pool_.get())
+                    .status.ok());
+  }
+  EXPECT_EQ(table_->executions_.load(), 3);
+  EXPECT_EQ(cache_->stats().entries, 0U);
+  EXPECT_EQ(cache_->stats().misses, 0U);
+}
+
+TEST_F(CachingQueryEngineTest, FailedClientLeavesNothingCached) {
+  const auto status = engine_->execute(
+      "SELECT * FROM t", pool_.get(), [](velox::RowVectorPtr) {
+        return Status::QueryExecutorError("client went away");
+      });
+  EXPECT_FALSE(status.ok());
+  EXPECT_EQ(cache_->stats().entries, 0U);
+}
+
+TEST(ResultCacheTest, KeyCoversTablesInAnyOrderAndTheirVersions) {
+  const PlanFingerprint ab{.hash = 42, .tables = {"a", "b"}};
+  const PlanFingerprint ba{.hash = 42, .tables = {"b", "a"}};
+  EXPECT_EQ(ResultCache::key(ab, {1, 2}), ResultCache::key(ba, {2, 1}));
+  EXPECT_NE(ResultCache::key(ab, {1, 2}), ResultCache::key(ab, {1, 3}));
+  EXPECT_NE(ResultCache::key(ab, {1, 2}),
+            ResultCache::key({.hash = 43, .tables = {"a", "b"}}, {1, 2}));
+}
+
+TEST(ResultCacheTest, LruEvictsTheLeastRecentlyUsed) {
+  auto cache = makeCache({.memory_bytes = 250});
+  cache->insert("a", {}, {}, bytes(100, 'a'));
+  cache->insert("b", {}, {}, bytes(100, 'b'));
+  EXPECT_TRUE(cache->lookup("a").has_value());
+  cache->insert("c", {}, {}, bytes(100, 'c'));
+  EXPECT_TRUE(cache->lookup("a").has_value());
+  EXPECT_FALSE(cache->lookup("b").has_value());
+  EXPECT_TRUE(cache->lookup("c").has_value());
+  EXPECT_EQ(cache->stats().evictions, 1U);
+  EXPECT_EQ(cache->stats().memory_bytes, 200U);
+}
+
+TEST(ResultCacheTest, LfuKeepsTheMostOftenUsed) {
+  auto cache =
+      makeCache({.memory_bytes = 250, .policy = EvictionPolicy::kLfu});
+  cache->insert("a", {}, {}, bytes(100, 'a'));
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(cache->lookup("a").has_value());
+  }
+  cache->insert("b", {}, {}, bytes(100, 'b'));
+  EXPECT_TRUE(cache->lookup("b").has_value());
+  cache->insert("c", {}, {}, bytes(100, 'c'));
+  EXPECT_TRUE(cache->lookup("a").has_value());
+  EXPECT_FALSE(cache->lookup("b").has_value());
+}
+
+TEST(ResultCacheTest, EvictedEntriesMoveToDiskAndBack) {
+  const auto directory =
+      std::filesystem::temp_directory_path() /
+      ("halo_result_cache_" + std::to_string(::getpid()));
+  {
+    auto cache = makeCache({.memory_bytes = 150,
+                            .disk_directory = directory.string(),
+                            .disk_bytes = 150});
+    cache->insert("a", {}, {}, bytes(100, 'a'));
+    cache->insert("b", {}, {}, bytes(100, 'b'));
+    auto stats = cache->stats();
+    EXPECT_EQ(stats.demotions, 1U);
+    EXPECT_EQ(stats.memory_bytes, 100U);
+    EXPECT_EQ(stats.disk_bytes, 100U);
+
+    const auto a = cache->lookup("a");
+    ASSERT_TRUE(a.has_value());
+    EXPECT_EQ(a->ipc->ToString(), std::string(100, 'a'));
+    stats = cache->stats();
+    EXPECT_EQ(stats.disk_hits, 1U);
+    EXPECT_EQ(stats.demotions, 2U);
+
+    // `c' pushes `a' to disk, which has room for one entry and drops `b'.
+    cache->insert("c", {}, {}, bytes(100, 'c'));
+    EXPECT_FALSE(cache->lookup("b").has_value());
+    EXPECT_EQ(cache->stats().entries, 2U);
+  }
+  EXPECT_TRUE(std::filesystem::is_empty(directory));
+  std::filesystem::remove_all(directory);
+}
+
+TEST(ResultCacheTest, DiskTierStaysConsistentUnderConcurrentUse) {
+  const auto directory =
+      std::filesystem::temp_directory_path() /
+      ("halo_result_cache_concurrent_" + std::to_string(::getpid()));
+  {
+    auto versions = TableVersions::create();
+    auto cache = makeCache({.memory_bytes = 400,
+                            .disk_directory = directory.string(),
+                            .disk_bytes = 800},
+                           versions);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&, t] {
+        for (int i = 0; i < 500; ++i) {
+          const auto key = std::to_string((i * 7 + t) % 16);
+          const auto table = "t" + std::to_string(i % 4);
+          if (const auto hit = cache->lookup(key)) {
+            EXPECT_EQ(hit->ipc->ToString(),
+                      std::string(100, static_cast<char>('a' + key.size())));
+          } else {
+            cache->insert(key, {table}, versions->versions({table}),
+                          bytes(100, static_cast<char>('a' + key.size())));
+          }
+          if (i % 50 == t) {
+            versions->bump(table);
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    const auto stats = cache->stats();
+    EXPECT_LE(stats.memory_bytes, 400U);
+    EXPECT_LE(stats.disk_bytes, 800U);
+    EXPECT_EQ(stats.memory_bytes + stats.disk_bytes, stats.entries * 100);
+    EXPECT_GT(stats.disk_hits, 0U);
+  }
+  EXPECT_TRUE(std::filesystem::is_empty(directory));
+  std::filesystem::remove_all(directory);
+}
+
+TEST(ResultCacheTest, ResultOfAWrittenTableIsNotInserted) {
+  auto versions = TableVersions::create();
+  auto cache = makeCache({}, versions);
+  const auto before = versions->versions({"t"});
+  versions->bump("t");
+  cache->insert("stale", {"t"}, before, bytes(10, 's'));
+  EXPECT_EQ(cache->stats().entries, 0U);
+  cache->insert("fresh", {"t"}, versions->versions({"t"}), bytes(10, 'f'));
+  EXPECT_EQ(cache->stats().entries, 1U);
+}
+
+TEST(ResultCacheTest, OversizedResultsAreNotCached) {
+  auto cache = makeCache({.memory_bytes = 1000, .max_entry_bytes = 100});
+  cache->insert("large", {}, {}, bytes(101, 'l'));
+  EXPECT_EQ(cache->stats().entries, 0U);
+}
+
+}  // namespace halo::server::cache
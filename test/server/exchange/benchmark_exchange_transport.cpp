@@ -0,0 +1,252 @@
+// Shuffle throughput and page latency of the Rocket and QUIC exchange
+// transports on loopback: 4 upstream workers each hash-partition their
+// output 16 ways and 16 consumers read one partition from every upstream.
+// Over Rocket that takes 64 TCP connections; over QUIC the consumers share
+// one connection per upstream and each partition is a stream of its own.
+//
+// Where unshare, ip and tc are available, the runs are repeated with 1%
+// packet loss injected through netem, where head-of-line blocking shows up
+// in the tail latency of the TCP transport. The lossy runs are a copy of
+// this binary in a network namespace of its own, so the host's lo is
+// never touched.
+
+#include <gtest/gtest.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+import halo.common;
+import halo.server.exchange;
+
+namespace halo::server::exchange {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+constexpr int kUpstreams = 4;
+constexpr int kPartitions = 16;
+constexpr int kBatchesPerUpstream = 256;
+constexpr int kBatchRows = 1024;
+constexpr std::size_t kPayloadBytes = 100;
+constexpr std::int64_t kRowBytes = 2 * sizeof(std::int64_t) + kPayloadBytes;
+
+velox::RowTypePtr rowType() {
+  return velox::ROW({"sent_ns", "key", "payload"},
+                    {velox::BIGINT(), velox::BIGINT(), velox::VARCHAR()});
+}
+
+std::int64_t nowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Rows stamped with their creation time, which the consumer subtracts
+// from its own clock.
+velox::RowVectorPtr makeBatch(std::mt19937_64& rng,
+                              velox::memory::MemoryPool* pool) {
+  const auto type = rowType();
+  std::vector<velox::VectorPtr> children;
+  for (const auto& child : type->children()) {
+    children.push_back(velox::BaseVector::create(child, kBatchRows, pool));
+  }
+  const std::string payload(kPayloadBytes, 'x');
+  const auto sent = nowNanos();
+  for (int i = 0; i < kBatchRows; ++i) {
+    children[0]->asFlatVector<std::int64_t>()->set(i, sent);
+    children[1]->asFlatVector<std::int64_t>()->set(
+        i, static_cast<std::int64_t>(rng()));
+    children[2]->asFlatVector<velox::StringView>()->set(
+        i, velox::StringView(payload.data(),
+                             static_cast<std::int32_t>(payload.size())));
+  }
+  return std::make_shared<velox::RowVector>(pool, type, nullptr, kBatchRows,
+                                            std::move(children));
+}
+
+constexpr int kLossPercent = 1;
+
+// Set in the copy of this binary that runs the lossy rows.
+constexpr const char* kLossEnv = "HALO_EXCHANGE_BENCH_LOSS";
+
+// Shell prefix entering a new network namespace, as root of a new user
+// namespace when not root already, with lo up and dropping packets.
+std::string lossyNamespace() {
+  return "unshare --net --map-root-user sh -c 'ip link set lo up && "
+         "tc qdisc add dev lo root netem loss " +
+         std::to_string(kLossPercent) + "%";
+}
+
+struct Run {
+  double seconds = 0;
+  std::int64_t rows = 0;
+  // Per received batch, from creation of its first row to its arrival.
+  std::vector<double> latencies_ms;
+};
+
+Run shuffle(bool quic, const std::string& exchange_id) {
+  auto pool = velox::memory::memoryManager()->addLeafPool();
+  std::vector<std::unique_ptr<ExchangeServer>> servers;
+  std::vector<std::shared_ptr<ExchangeSink>> sinks;
+  std::vector<ExchangeEndpoint> upstreams;
+  for (int u = 0; u < kUpstreams; ++u) {
+    auto server = ExchangeServer::start({.host = "127.0.0.1", .quic = quic});
+    EXPECT_TRUE(server.ok()) << server.status().toString();
+    auto sink = (*server)->createSink(
+        exchange_id, rowType(), {1}, kPartitions,
+        {.compression = PageCompression::kNone,
+         .target_page_bytes = 64ULL << 10,
+         .max_queued_bytes = 1ULL << 20},
+        pool.get());
+    EXPECT_TRUE(sink.ok()) << sink.status().toString();
+    upstreams.push_back(
+        {.host = "127.0.0.1",
+         .port = quic ? (*server)->quicPort() : (*server)->port()});
+    servers.push_back(std::move(server).value());
+    sinks.push_back(std::move(sink).value());
+  }
+
+  ExchangeSourceOptions source_options;
+  if (quic) {
+    source_options.quic = QuicExchangeClient::create();
+  }
+  Run run;
+  std::vector<std::vector<double>> latencies(kPartitions);
+  std::atomic<std::int64_t> rows{0};
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int u = 0; u < kUpstreams; ++u) {
+    threads.emplace_back([&, u] {
+      auto producer_pool = velox::memory::memoryManager()->addLeafPool();
+      std::mt19937_64 rng(u);
+      for (int b = 0; b < kBatchesPerUpstream; ++b) {
+        EXPECT_TRUE(sinks[u]->add(makeBatch(rng, producer_pool.get())).ok());
+      }
+      EXPECT_TRUE(sinks[u]->finish().ok());
+    });
+  }
+  for (int p = 0; p < kPartitions; ++p) {
+    threads.emplace_back([&, p] {
+      auto consumer_pool = velox::memory::memoryManager()->addLeafPool();
+      auto source = ExchangeSource::create(rowType(), exchange_id, p,
+                                           upstreams, source_options,
+                                           consumer_pool.get());
+      ASSERT_TRUE(source.ok()) << source.status().toString();
+      while (true) {
+        auto batch = (*source)->next();
+        ASSERT_TRUE(batch.ok()) << batch.status().toString();
+        if (*batch == nullptr) {
+          break;
+        }
+        const auto sent =
+            (*batch)->childAt(0)->asFlatVector<std::int64_t>()->valueAt(0);
+        latencies[p].push_back(static_cast<double>(nowNanos() - sent) / 1e6);
+        rows += (*batch)->size();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  run.seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+  run.rows = rows;
+  for (auto& partition : latencies) {
+    run.latencies_ms.insert(run.latencies_ms.end(), partition.begin(),
+                            partition.end());
+  }
+  std::sort(run.latencies_ms.begin(), run.latencies_ms.end());
+  return run;
+}
+
+double percentile(const std::vector<double>& sorted, double fraction) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  const auto index = static_cast<std::size_t>(
+      fraction * static_cast<double>(sorted.size() - 1));
+  return sorted[index];
+}
+
+void printHeader() {
+  constexpr std::int64_t kRows =
+      std::int64_t{kUpstreams} * kBatchesPerUpstream * kBatchRows;
+  std::cout << kUpstreams << " upstreams x " << kPartitions
+            << " partitions, " << kRows << " rows of " << kRowBytes
+            << " bytes\n"
+            << std::left << std::setw(18) << "transport" << std::right
+            << std::setw(10) << "MB/s" << std::setw(10) << "p50 ms"
+            << std::setw(10) << "p99 ms" << std::setw(10) << "max ms" << "\n";
+}
+
+// One table row per transport at `loss' percent packet loss.
+void runTransports(int loss) {
+  constexpr std::int64_t kRows =
+      std::int64_t{kUpstreams} * kBatchesPerUpstream * kBatchRows;
+  for (const bool quic : {false, true}) {
+    const auto run = shuffle(quic, std::string("bench_") +
+                                       (quic ? "quic" : "rocket"));
+    EXPECT_EQ(run.rows, kRows);
+    const auto name = std::string(quic ? "QUIC" : "Rocket") + ", " +
+                      std::to_string(loss) + "% loss";
+    std::cout << std::left << std::setw(18) << name << std::right
+              << std::fixed << std::setprecision(2) << std::setw(10)
+              << static_cast<double>(run.rows * kRowBytes) / 1e6 /
+                     run.seconds
+              << std::setw(10) << percentile(run.latencies_ms, 0.5)
+              << std::setw(10) << percentile(run.latencies_ms, 0.99)
+              << std::setw(10) << percentile(run.latencies_ms, 1.0) << "\n";
+  }
+  std::cout.flush();
+}
+
+}  // namespace
+
+TEST(ExchangeTransportBenchmark, RocketVersusQuicOnLoopback) {
+  if (std::getenv(kLossEnv) != nullptr) {
+    GTEST_SKIP() << "lossy copy runs LossyLoopback only";
+  }
+  printHeader();
+  runTransports(0);
+
+  if (std::system((lossyNamespace() + "' >/dev/null 2>&1").c_str()) != 0) {
+    std::cout << "packet loss runs skipped: needs unshare, ip and tc netem "
+                 "with user or network namespaces permitted\n";
+    return;
+  }
+  const auto binary = std::filesystem::read_symlink("/proc/self/exe");
+  const auto command =
+      lossyNamespace() + " && " + kLossEnv + "=1 exec \"$0\" " +
+      "--gtest_filter=ExchangeTransportBenchmark.LossyLoopback' '" +
+      binary.string() + "'";
+  EXPECT_EQ(std::system(command.c_str()), 0);
+}
+
+// The rows with packet loss; runs in the copy started above, inside a
+// network namespace whose lo drops packets.
+TEST(ExchangeTransportBenchmark, LossyLoopback) {
+  if (std::getenv(kLossEnv) == nullptr) {
+    GTEST_SKIP() << "started by RocketVersusQuicOnLoopback";
+  }
+  runTransports(kLossPercent);
+}
+
+}  // namespace halo::server::exchange
@@ -0,0 +1,486 @@
+#include <folly/coro/BlockingWait.h>
+#include <folly/io/IOBuf.h>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+import halo.common;
+import halo.server.exchange;
+
+namespace halo::server::exchange {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+using common::base::Status;
+
+constexpr int kWorkers = 4;
+constexpr std::int64_t kRowsPerWorker = 20000;
+constexpr std::int64_t kKeys = 101;
+
+velox::RowTypePtr aggregateType() {
+  return velox::ROW({"key", "sum", "count"},
+                    {velox::BIGINT(), velox::BIGINT(), velox::BIGINT()});
+}
+
+// key -> {sum, count}
+using Aggregate = std::map<std::int64_t, std::pair<std::int64_t, std::int64_t>>;
+
+velox::RowVectorPtr makeBatch(
+    const std::vector<std::array<std::int64_t, 3>>& rows,
+    velox::memory::MemoryPool* pool) {
+  const auto size = static_cast<velox::vector_size_t>(rows.size());
+  std::vector<velox::VectorPtr> children;
+  for (std::size_t c = 0; c < 3; ++c) {
+    auto column = velox::BaseVector::create(velox::BIGINT(), size, pool);
+    for (velox::vector_size_t i = 0; i < size; ++i) {
+      column->asFlatVector<std::int64_t>()->set(i, rows[i][c]);
+    }
+    children.push_back(std::move(column));
+  }
+  return std::make_shared<velox::RowVector>(pool, aggregateType(), nullptr,
+                                            size, std::move(children));
+}
+
+void accumulate(const velox::RowVector& batch, Aggregate& aggregate) {
+  const auto* keys = batch.childAt(0)->asFlatVector<std::int64_t>();
+  const auto* sums = batch.childAt(1)->asFlatVector<std::int64_t>();
+  const auto* counts = batch.childAt(2)->asFlatVector<std::int64_t>();
+  for (velox::vector_size_t i = 0; i < batch.size(); ++i) {
+    auto& [sum, count] = aggregate[keys->valueAt(i)];
+    sum += sums->valueAt(i);
+    count += counts->valueAt(i);
+  }
+}
+
+bool writeAll(int fd, const void* data, std::size_t size) {
+  const auto* bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    const auto written = ::write(fd, bytes, size);
+    if (written <= 0) {
+      return false;
+    }
+    bytes += written;
+    size -= static_cast<std::size_t>(written);
+  }
+  return true;
+}
+
+bool readAll(int fd, void* data, std::size_t size) {
+  auto* bytes = static_cast<char*>(data);
+  while (size > 0) {
+    const auto got = ::read(fd, bytes, size);
+    if (got <= 0) {
+      return false;
+    }
+    bytes += got;
+    size -= static_cast<std::size_t>(got);
+  }
+  return true;
+}
+
+Status check(const Status& status) {
+  if (!status.ok()) {
+    std::fprintf(stderr, "worker failed: %s\n", status.toString().c_str());
+  }
+  return status;
+}
+
+constexpr std::string_view kWorkerFlag = "--worker=";
+constexpr std::string_view kQuicFlag = "--quic";
+
+// One worker process: partially aggregates its slice of the input, sends
+// the partial results through exchange "agg" partitioned on the key and
+// finally aggregates partition `index', which it writes to `out'. The
+// exchange runs over QUIC if `quic' is set, over Rocket otherwise.
+//
+// Workers are this binary started again with --worker=<index>, reading
+// from stdin and writing to stdout, rather than forks of the test: the
+// test process already runs Velox and folly threads, and a fork only
+// carries the calling one.
+int runWorker(int index, int in, int out, bool quic) {
+  auto pool = velox::memory::memoryManager()->addLeafPool(
+      "worker_" + std::to_string(index));
+  auto server = ExchangeServer::start({.host = "127.0.0.1", .quic = quic});
+  if (!check(server.status()).ok()) {
+    return 1;
+  }
+  // Small pages and queues so that flow control is exercised.
+  ExchangeSinkOptions sink_options;
+  sink_options.target_page_bytes = 512;
+  sink_options.max_queued_bytes = 2048;
+  auto sink = (*server)->createSink("agg", aggregateType(), {0}, kWorkers,
+                                    sink_options, pool.get());
+  if (!check(sink.status()).ok()) {
+    return 1;
+  }
+  const std::uint16_t port = quic ? (*server)->quicPort() : (*server)->port();
+  std::array<std::uint16_t, kWorkers> ports{};
+  if (!writeAll(out, &port, sizeof(port)) ||
+      !readAll(in, ports.data(), sizeof(ports))) {
+    return 1;
+  }
+
+  Status produced = Status::OK();
+  std::thread producer([&] {
+    Aggregate partial;
+    for (std::int64_t row = index * kRowsPerWorker;
+         row < (index + 1) * kRowsPerWorker; ++row) {
+      auto& [sum, count] = partial[row % kKeys];
+      sum += row;
+      ++count;
+    }
+    auto producer_pool = velox::memory::memoryManager()->addLeafPool();
+    std::vector<std::array<std::int64_t, 3>> rows;
+    for (const auto& [key, value] : partial) {
+      rows.push_back({key, value.first, value.second});
+      if (rows.size() == 16) {
+        produced = (*sink)->add(makeBatch(rows, producer_pool.get()));
+        rows.clear();
+        if (!produced.ok()) {
+          return;
+        }
+      }
+    }
+    produced = (*sink)->add(makeBatch(rows, producer_pool.get()));
+    if (produced.ok()) {
+      produced = (*sink)->finish();
+    }
+  });
+
+  std::vector<ExchangeEndpoint> upstreams;
+  for (const auto upstream : ports) {
+    upstreams.push_back({.host = "127.0.0.1", .port = upstream});
+  }
+  ExchangeSourceOptions source_options{.credit_pages = 2};
+  if (quic) {
+    source_options.quic = QuicExchangeClient::create();
+  }
+  auto source = ExchangeSource::create(aggregateType(), "agg", index,
+                                       upstreams, source_options, pool.get());
+  Aggregate final_result;
+  Status consumed = source.status();
+  while (consumed.ok()) {
+    auto batch = (*source)->next();
+    consumed = batch.status();
+    if (!batch.ok() || *batch == nullptr) {
+      break;
+    }
+    accumulate(**batch, final_result);
+  }
+  producer.join();
+  if (!check(produced).ok() || !check(consumed).ok()) {
+    return 1;
+  }
+
+  const auto size = static_cast<std::uint32_t>(final_result.size());
+  if (!writeAll(out, &size, sizeof(size))) {
+    return 1;
+  }
+  for (const auto& [key, value] : final_result) {
+    const std::array<std::int64_t, 3> row = {key, value.first, value.second};
+    if (!writeAll(out, row.data(), sizeof(row))) {
+      return 1;
+    }
+  }
+  // Other workers may still be reading this one's partitions.
+  char done = 0;
+  readAll(in, &done, sizeof(done));
+  return 0;
+}
+
+}  // namespace
+
+// Worker processes of one test; whatever a failed assertion leaves
+// running is killed and reaped in TearDown().
+class ExchangeTest : public ::testing::TestWithParam<bool> {
+ protected:
+  struct Worker {
+    pid_t pid = -1;
+    // Reads the worker's stdout.
+    int in = -1;
+    // Writes the worker's stdin.
+    int out = -1;
+  };
+
+  void TearDown() override {
+    for (auto& worker : workers_) {
+      closeFds(worker);
+      if (worker.pid > 0) {
+        ::kill(worker.pid, SIGKILL);
+        ::waitpid(worker.pid, nullptr, 0);
+      }
+    }
+    workers_.clear();
+  }
+
+  // Starts worker `index' of this binary; false if it could not.
+  bool spawn(int index) {
+    int to_worker[2];
+    int from_worker[2];
+    if (::pipe2(to_worker, O_CLOEXEC) != 0) {
+      return false;
+    }
+    if (::pipe2(from_worker, O_CLOEXEC) != 0) {
+      ::close(to_worker[0]);
+      ::close(to_worker[1]);
+      return false;
+    }
+    auto& worker = workers_.emplace_back();
+    worker.in = from_worker[0];
+    worker.out = to_worker[1];
+
+    // dup2() clears close-on-exec on the copies, so the worker inherits
+    // its stdin and stdout and none of the other workers' pipes.
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, to_worker[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, from_worker[1],
+                                     STDOUT_FILENO);
+    std::string binary = "/proc/self/exe";
+    std::string worker_flag =
+        std::string(kWorkerFlag) + std::to_string(index);
+    std::string quic_flag(kQuicFlag);
+    std::vector<char*> argv = {binary.data(), worker_flag.data()};
+    if (GetParam()) {
+      argv.push_back(quic_flag.data());
+    }
+    argv.push_back(nullptr);
+    const int spawned = ::posix_spawn(&worker.pid, binary.c_str(), &actions,
+                                      nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    ::close(to_worker[0]);
+    ::close(from_worker[1]);
+    if (spawned != 0) {
+      worker.pid = -1;
+      return false;
+    }
+    return true;
+  }
+
+  // Waits for `worker' to exit; true if it exited with 0.
+  static bool reap(Worker& worker) {
+    closeFds(worker);
+    int status = 0;
+    const bool reaped = ::waitpid(worker.pid, &status, 0) == worker.pid;
+    worker.pid = -1;
+    return reaped && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  }
+
+  static void closeFds(Worker& worker) {
+    for (int* fd : {&worker.in, &worker.out}) {
+      if (*fd >= 0) {
+        ::close(*fd);
+        *fd = -1;
+      }
+    }
+  }
+
+  std::vector<Worker> workers_;
+};
+
+// Four worker processes on loopback run SELECT key, sum(value), count(*)
+// ... GROUP BY key as partial aggregation, hash exchange on the key and
+// final aggregation.
+TEST_P(ExchangeTest, PartitionedAggregationAcrossFourWorkers) {
+  for (int w = 0; w < kWorkers; ++w) {
+    ASSERT_TRUE(spawn(w)) << "cannot start worker " << w;
+  }
+
+  std::array<std::uint16_t, kWorkers> ports{};
+  for (int w = 0; w < kWorkers; ++w) {
+    ASSERT_TRUE(readAll(workers_[w].in, &ports[w], sizeof(ports[w])));
+  }
+  for (const auto& worker : workers_) {
+    ASSERT_TRUE(writeAll(worker.out, ports.data(), sizeof(ports)));
+  }
+
+  Aggregate merged;
+  std::set<std::int64_t> seen;
+  for (const auto& worker : workers_) {
+    std::uint32_t size = 0;
+    ASSERT_TRUE(readAll(worker.in, &size, sizeof(size)));
+    for (std::uint32_t i = 0; i < size; ++i) {
+      std::array<std::int64_t, 3> row{};
+      ASSERT_TRUE(readAll(worker.in, row.data(), sizeof(row)));
+      // Each key is aggregated by exactly one worker.
+      EXPECT_TRUE(seen.insert(row[0]).second) << "key " << row[0];
+      merged[row[0]] = {row[1], row[2]};
+    }
+  }
+  for (auto& worker : workers_) {
+    const char done = 0;
+    writeAll(worker.out, &done, sizeof(done));
+  }
+  for (auto& worker : workers_) {
+    EXPECT_TRUE(reap(worker));
+  }
+
+  Aggregate expected;
+  for (std::int64_t row = 0; row < kWorkers * kRowsPerWorker; ++row) {
+    auto& [sum, count] = expected[row % kKeys];
+    sum += row;
+    ++count;
+  }
+  EXPECT_EQ(merged, expected);
+}
+
+INSTANTIATE_TEST_SUITE_P(Transports, ExchangeTest, ::testing::Bool(),
+                         [](const ::testing::TestParamInfo<bool>& info) {
+                           return info.param ? "Quic" : "Rocket";
+                         });
+
+TEST(PageCodecTest, RoundTripsSelectedRowsWithEachCompression) {
+  auto pool = velox::memory::memoryManager()->addLeafPool();
+  std::vector<std::array<std::int64_t, 3>> rows;
+  for (std::int64_t i = 0; i < 1000; ++i) {
+    rows.push_back({i, i % 3, 7});
+  }
+  const auto batch = makeBatch(rows, pool.get());
+  std::vector<velox::vector_size_t> selected(500);
+  std::iota(selected.begin(), selected.end(), 0);
+  for (auto& row : selected) {
+    row *= 2;
+  }
+
+  std::map<PageCompression, std::uint64_t> sizes;
+  for (const auto compression :
+       {PageCompression::kNone, PageCompression::kLz4,
+        PageCompression::kZstd}) {
+    PageWriter writer(aggregateType(), compression, pool.get());
+    ASSERT_TRUE(writer.append(batch, selected).ok());
+    EXPECT_EQ(writer.rows(), 500);
+    auto page = writer.flush();
+    ASSERT_TRUE(page.ok()) << page.status();
+    EXPECT_EQ(writer.rows(), 0);
+    sizes[compression] = page->bytes();
+
+    PageReader reader(aggregateType(), pool.get());
+    auto read = reader.read(*page);
+    ASSERT_TRUE(read.ok()) << read.status();
+    ASSERT_EQ((*read)->size(), 500);
+    for (velox::vector_size_t i = 0; i < 500; ++i) {
+      ASSERT_TRUE((*read)->equalValueAt(batch.get(), i, selected[i]));
+    }
+  }
+  EXPECT_LT(sizes[PageCompression::kLz4], sizes[PageCompression::kNone]);
+  EXPECT_LT(sizes[PageCompression::kZstd], sizes[PageCompression::kNone]);
+}
+
+TEST(ExchangeSinkTest, EqualKeysShareAPartition) {
+  auto pool = velox::memory::memoryManager()->addLeafPool();
+  auto sink = ExchangeSink::create(aggregateType(), {0}, 3, {}, pool.get());
+  ASSERT_TRUE(sink.ok()) << sink.status();
+  for (int b = 0; b < 2; ++b) {
+    std::vector<std::array<std::int64_t, 3>> rows;
+    for (std::int64_t i = 0; i < 300; ++i) {
+      rows.push_back({i % 50, b, 1});
+    }
+    ASSERT_TRUE((*sink)->add(makeBatch(rows, pool.get())).ok());
+  }
+  ASSERT_TRUE((*sink)->finish().ok());
+
+  std::map<std::int64_t, int> partition_of;
+  std::int64_t total = 0;
+  for (std::int32_t p = 0; p < 3; ++p) {
+    auto queue = (*sink)->takePartition(p);
+    ASSERT_TRUE(queue.ok()) << queue.status();
+    PageReader reader(aggregateType(), pool.get());
+    while (auto page = folly::coro::blockingWait((*queue)->pop())) {
+      auto batch = reader.read(*page);
+      ASSERT_TRUE(batch.ok()) << batch.status();
+      const auto* keys = (*batch)->childAt(0)->asFlatVector<std::int64_t>();
+      for (velox::vector_size_t i = 0; i < (*batch)->size(); ++i) {
+        const auto [it, inserted] = partition_of.emplace(keys->valueAt(i), p);
+        EXPECT_EQ(it->second, p) << "key " << keys->valueAt(i);
+        ++total;
+      }
+    }
+    EXPECT_TRUE((*queue)->status().ok());
+  }
+  EXPECT_EQ(total, 600);
+  EXPECT_EQ(partition_of.size(), 50U);
+  EXPECT_FALSE((*sink)->takePartition(0).ok());
+  EXPECT_TRUE((*sink)->allTaken());
+}
+
+TEST(PageQueueTest, CancelReleasesBlockedProducer) {
+  PageQueue queue(1, std::chrono::minutes(1));
+  SerializedPage first;
+  first.data = folly::IOBuf::copyBuffer("first");
+  ASSERT_TRUE(queue.push(std::move(first)).ok());
+  std::thread consumer([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    queue.cancel();
+  });
+  SerializedPage second;
+  second.data = folly::IOBuf::copyBuffer("second");
+  EXPECT_FALSE(queue.push(std::move(second)).ok());
+  consumer.join();
+}
+
+TEST(ExchangeSinkTest, UnfetchedPartitionFailsAddAfterMaxWait) {
+  auto pool = velox::memory::memoryManager()->addLeafPool();
+  ExchangeSinkOptions options;
+  options.target_page_bytes = 1;
+  options.max_queued_bytes = 1;
+  options.max_wait = std::chrono::milliseconds(50);
+  auto sink = ExchangeSink::create(aggregateType(), {0}, 1, options,
+                                   pool.get());
+  ASSERT_TRUE(sink.ok()) << sink.status();
+  // The first page fits the empty queue, the second has nowhere to go.
+  const std::vector<std::array<std::int64_t, 3>> rows(1, {1, 1, 1});
+  ASSERT_TRUE((*sink)->add(makeBatch(rows, pool.get())).ok());
+  const auto start = std::chrono::steady_clock::now();
+  const auto status = (*sink)->add(makeBatch(rows, pool.get()));
+  EXPECT_FALSE(status.ok());
+  EXPECT_GE(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(50));
+  EXPECT_FALSE(
+      ExchangeSink::create(aggregateType(), {0}, 1,
+                           {.max_wait = std::chrono::milliseconds(0)},
+                           pool.get())
+          .ok());
+}
+
+}  // namespace halo::server::exchange
+
+// The test runs in the usual gtest way; --worker=<index> instead makes
+// this process one exchange worker of
+// ExchangeTest.PartitionedAggregationAcrossFourWorkers.
+int main(int argc, char** argv) {
+  using namespace halo::server::exchange;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg.starts_with(kWorkerFlag)) {
+      const int index = std::atoi(arg.substr(kWorkerFlag.size()).data());
+      const bool quic = i + 1 < argc && argv[i + 1] == kQuicFlag;
+      return runWorker(index, STDIN_FILENO, STDOUT_FILENO, quic);
+    }
+  }
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
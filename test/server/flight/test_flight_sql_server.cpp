@@ -0,0 +1,330 @@
+#include <arrow/api.h>
+#include <arrow/flight/api.h>
+#include <arrow/flight/sql/api.h>
+#include <arrow/util/compression.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <gtest/gtest.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+import halo.common;
+import halo.server.engine;
+import halo.server.flight;
+
+namespace halo::server::flight {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+using common::base::Status;
+using common::base::StatusOr;
+using engine::QueryEngine;
+using engine::RowVectorSink;
+
+constexpr int kBatches = 4;
+constexpr int kBatchRows = 1000;
+
+velox::RowTypePtr resultType() {
+  return velox::ROW({"id", "name"}, {velox::BIGINT(), velox::VARCHAR()});
+}
+
+velox::RowVectorPtr makeBatch(int first, int rows,
+                              velox::memory::MemoryPool* pool) {
+  auto ids = velox::BaseVector::create(velox::BIGINT(), rows, pool);
+  auto names = velox::BaseVector::create(velox::VARCHAR(), rows, pool);
+  for (int i = 0; i < rows; ++i) {
+    ids->asFlatVector<std::int64_t>()->set(i, first + i);
+    if ((first + i) % 7 == 0) {
+      names->setNull(i, true);
+    } else {
+      const std::string name = "customer#" + std::to_string(first + i);
+      names->asFlatVector<velox::StringView>()->set(
+          i, velox::StringView(name.data(),
+                               static_cast<std::int32_t>(name.size())));
+    }
+  }
+  return std::make_shared<velox::RowVector>(
+      pool, resultType(), nullptr, rows,
+      std::vector<velox::VectorPtr>{std::move(ids), std::move(names)});
+}
+
+// "scan" returns kBatches batches, "fail" fails after one batch, "huge"
+// allocates more than any test limit, "endless" runs until its sink fails
+// and "missing" does not plan.
+class FakeEngine final : public QueryEngine {
+ public:
+  StatusOr<velox::RowTypePtr> describe(const std::string& query) override {
+    if (query == "missing") {
+      return Status::SqlError("table 'missing' does not exist");
+    }
+    return resultType();
+  }
+
+  Status execute(const std::string& query, velox::memory::MemoryPool* pool,
+                 const RowVectorSink& sink) override {
+    ++executions;
+    if (query == "huge") {
+      velox::BaseVector::create(velox::BIGINT(), 16 << 20, pool);
+    }
+    for (int b = 0; b < kBatches || query == "endless"; ++b) {
+      auto status = sink(makeBatch(b * kBatchRows, kBatchRows, pool));
+      if (!status.ok()) {
+        return status;
+      }
+      if (query == "fail") {
+        return Status::QueryExecutorError("worker lost");
+      }
+    }
+    return Status::OK();
+  }
+
+  std::atomic<int> executions = 0;
+};
+
+class FlightSqlServerTest : public ::testing::Test {
+ protected:
+  void start(const FlightSqlOptions& options) {
+    engine_ = std::make_shared<FakeEngine>();
+    auto server = FlightSqlServer::create(engine_, options);
+    ASSERT_TRUE(server.ok()) << server.status().message();
+    server_ = std::move(server).value();
+    auto status = server_->listen("localhost", 0);
+    ASSERT_TRUE(status.ok()) << status.message();
+
+    auto location =
+        arrow::flight::Location::ForGrpcTcp("localhost", server_->port());
+    ASSERT_TRUE(location.ok());
+    auto client = arrow::flight::FlightClient::Connect(*location);
+    ASSERT_TRUE(client.ok()) << client.status().ToString();
+    client_ = std::make_unique<arrow::flight::sql::FlightSqlClient>(
+        std::move(*client));
+  }
+
+  void TearDown() override {
+    if (server_ != nullptr) {
+      ASSERT_TRUE(server_->Shutdown().ok());
+    }
+  }
+
+  arrow::Result<std::shared_ptr<arrow::Table>> query(const std::string& sql) {
+    const arrow::flight::FlightCallOptions call;
+    ARROW_ASSIGN_OR_RAISE(auto info, client_->Execute(call, sql));
+    if (info->endpoints().size() != 1) {
+      return arrow::Status::Invalid("expected one endpoint");
+    }
+    ARROW_ASSIGN_OR_RAISE(auto reader,
+                          client_->DoGet(call, info->endpoints()[0].ticket));
+    return reader->ToTable();
+  }
+
+  static void expectScanResult(const arrow::Table& table) {
+    ASSERT_EQ(table.num_rows(), kBatches * kBatchRows);
+    ASSERT_EQ(table.schema()->field(0)->name(), "id");
+    ASSERT_EQ(table.schema()->field(1)->name(), "name");
+    std::int64_t row = 0;
+    for (const auto& batch : arrow::TableBatchReader(table)) {
+      ASSERT_TRUE(batch.ok());
+      const auto& ids =
+          static_cast<const arrow::Int64Array&>(*(*batch)->column(0));
+      const auto& names =
+          static_cast<const arrow::StringArray&>(*(*batch)->column(1));
+      for (std::int64_t i = 0; i < (*batch)->num_rows(); ++i, ++row) {
+        ASSERT_EQ(ids.Value(i), row);
+        if (row % 7 == 0) {
+          ASSERT_TRUE(names.IsNull(i));
+        } else {
+          ASSERT_EQ(names.GetView(i), "customer#" + std::to_string(row));
+        }
+      }
+    }
+  }
+
+  std::shared_ptr<FakeEngine> engine_;
+  std::unique_ptr<FlightSqlServer> server_;
+  std::unique_ptr<arrow::flight::sql::FlightSqlClient> client_;
+};
+
+}  // namespace
+
+TEST(BatchQueueTest, ProducerWaitsOnceBoundIsQueued) {
+  BatchQueue<int> queue(100);
+  ASSERT_TRUE(queue.push(1, 60));
+  ASSERT_TRUE(queue.push(2, 60));
+  EXPECT_EQ(queue.queuedBytes(), 120U);
+
+  std::atomic<bool> pushed = false;
+  std::thread producer([&] {
+    EXPECT_TRUE(queue.push(3, 500));
+    pushed = true;
+    queue.close(Status::QueryExecutorError("done early"));
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(pushed);
+
+  EXPECT_EQ(queue.pop(), 1);
+  EXPECT_EQ(queue.pop(), 2);
+  EXPECT_EQ(queue.pop(), 3);
+  EXPECT_EQ(queue.pop(), std::nullopt);
+  producer.join();
+  EXPECT_TRUE(pushed);
+  EXPECT_EQ(queue.status().message(), "done early");
+  EXPECT_EQ(queue.queuedBytes(), 0U);
+}
+
+TEST(BatchQueueTest, CancelReleasesBlockedProducer) {
+  BatchQueue<int> queue(10);
+  ASSERT_TRUE(queue.push(1, 10));
+  std::thread producer([&] { EXPECT_FALSE(queue.push(2, 10)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  queue.cancel();
+  producer.join();
+  EXPECT_EQ(queue.queuedBytes(), 0U);
+  EXPECT_FALSE(queue.push(3, 1));
+}
+
+TEST(BatchQueueTest, CancelEndsStreamForConsumer) {
+  BatchQueue<int> queue(10);
+  std::thread consumer([&] { EXPECT_EQ(queue.pop(), std::nullopt); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  queue.cancel(Status::QueryExecutorError("client left"));
+  consumer.join();
+  queue.close(Status::OK());
+  EXPECT_EQ(queue.status().message(), "client left");
+}
+
+TEST(ResultStreamTest, CancelStopsRunningQuery) {
+  auto engine = std::make_shared<FakeEngine>();
+  folly::CPUThreadPoolExecutor executor(1);
+  auto stream = ResultStream::start(engine, "endless", resultType(),
+                                    {.max_queued_bytes = 1}, &executor);
+  ASSERT_TRUE(stream.ok()) << stream.status().message();
+  std::shared_ptr<arrow::RecordBatch> batch;
+  ASSERT_TRUE((*stream)->ReadNext(&batch).ok());
+  ASSERT_NE(batch, nullptr);
+  (*stream)->cancel();
+  EXPECT_FALSE((*stream)->ReadNext(&batch).ok());
+  EXPECT_EQ(batch, nullptr);
+  // The query gave its thread back.
+  executor.join();
+
+  EXPECT_FALSE(ResultStream::start(engine, "scan", resultType(), {}, nullptr)
+                   .ok());
+}
+
+TEST(ArrowExporterTest, SharesFixedWidthBuffers) {
+  auto pool = velox::memory::memoryManager()->addLeafPool("arrow_exporter");
+  auto exporter = ArrowExporter::create(resultType(), false, pool.get());
+  ASSERT_TRUE(exporter.ok()) << exporter.status().message();
+  EXPECT_EQ(exporter->schema()->ToString(), "id: int64\nname: string");
+
+  auto batch = makeBatch(0, 100, pool.get());
+  auto record_batch = exporter->exportBatch(batch);
+  ASSERT_TRUE(record_batch.ok()) << record_batch.status().message();
+  EXPECT_EQ((*record_batch)->num_rows(), 100);
+  EXPECT_EQ((*record_batch)->column(0)->data()->buffers[1]->data(),
+            reinterpret_cast<const std::uint8_t*>(
+                batch->childAt(0)->asFlatVector<std::int64_t>()->rawValues()));
+
+  auto other = std::make_shared<velox::RowVector>(
+      pool.get(), velox::ROW({"id"}, {velox::BIGINT()}), nullptr, 1,
+      std::vector<velox::VectorPtr>{
+          velox::BaseVector::create(velox::BIGINT(), 1, pool.get())});
+  EXPECT_FALSE(exporter->exportBatch(other).ok());
+}
+
+TEST_F(FlightSqlServerTest, StreamsQueryResult) {
+  start({});
+  auto table = query("scan");
+  ASSERT_TRUE(table.ok()) << table.status().ToString();
+  expectScanResult(**table);
+  EXPECT_EQ(engine_->executions, 1);
+}
+
+TEST_F(FlightSqlServerTest, CompressesIpcBodies) {
+  for (const auto [compression, codec] :
+       {std::pair{IpcCompression::kLz4, arrow::Compression::LZ4_FRAME},
+        std::pair{IpcCompression::kZstd, arrow::Compression::ZSTD}}) {
+    if (!arrow::util::Codec::IsAvailable(codec)) {
+      continue;
+    }
+    start({.compression = compression});
+    auto table = query("scan");
+    ASSERT_TRUE(table.ok()) << table.status().ToString();
+    expectScanResult(**table);
+    ASSERT_TRUE(server_->Shutdown().ok());
+    server_.reset();
+  }
+}
+
+TEST_F(FlightSqlServerTest, SlowClientStillGetsEveryBatch) {
+  // Room for a single batch: the query waits for the client after each one.
+  start({.stream = {.max_queued_bytes = 1}});
+  const arrow::flight::FlightCallOptions call;
+  auto info = client_->Execute(call, "scan");
+  ASSERT_TRUE(info.ok()) << info.status().ToString();
+  auto reader = client_->DoGet(call, (*info)->endpoints()[0].ticket);
+  ASSERT_TRUE(reader.ok()) << reader.status().ToString();
+  std::int64_t rows = 0;
+  while (true) {
+    auto chunk = (*reader)->Next();
+    ASSERT_TRUE(chunk.ok()) << chunk.status().ToString();
+    if (chunk->data == nullptr) {
+      break;
+    }
+    rows += chunk->data->num_rows();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(rows, kBatches * kBatchRows);
+}
+
+TEST_F(FlightSqlServerTest, ClientLeavingFreesQueryThread) {
+  start({.stream = {.max_queued_bytes = 1}, .query_threads = 1});
+  {
+    const arrow::flight::FlightCallOptions call;
+    auto info = client_->Execute(call, "endless");
+    ASSERT_TRUE(info.ok()) << info.status().ToString();
+    auto reader = client_->DoGet(call, (*info)->endpoints()[0].ticket);
+    ASSERT_TRUE(reader.ok()) << reader.status().ToString();
+    auto chunk = (*reader)->Next();
+    ASSERT_TRUE(chunk.ok()) << chunk.status().ToString();
+    (*reader)->Cancel();
+  }
+  // Runs only once the endless query has let go of the single thread.
+  auto table = query("scan");
+  ASSERT_TRUE(table.ok()) << table.status().ToString();
+  expectScanResult(**table);
+}
+
+TEST_F(FlightSqlServerTest, ReportsQueryErrorsToClient) {
+  start({.stream = {.memory_limit_bytes = 8 << 20}});
+
+  auto missing = query("missing");
+  ASSERT_FALSE(missing.ok());
+  EXPECT_NE(missing.status().message().find("does not exist"),
+            std::string::npos);
+
+  auto failed = query("fail");
+  ASSERT_FALSE(failed.ok());
+  EXPECT_NE(failed.status().message().find("worker lost"), std::string::npos);
+
+  // 128 MB of BIGINT against an 8 MB stream limit.
+  EXPECT_FALSE(query("huge").ok());
+
+  auto table = query("scan");
+  ASSERT_TRUE(table.ok()) << table.status().ToString();
+  expectScanResult(**table);
+}
+
+}  // namespace halo::server::flight
@@ -0,0 +1,489 @@
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+import halo.common;
+import halo.server.engine;
+import halo.server.pgwire;
+
+namespace halo::server::pgwire {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+using common::base::Status;
+using common::base::StatusOr;
+using engine::QueryEngine;
+using engine::RowVectorSink;
+
+constexpr int kBatches = 3;
+constexpr int kBatchRows = 4;
+
+struct Message {
+  char type;
+  std::string body;
+};
+
+std::string int16(std::int16_t value) {
+  const auto bits = std::byteswap(static_cast<std::uint16_t>(value));
+  return {reinterpret_cast<const char*>(&bits), 2};
+}
+
+std::string int32(std::int32_t value) {
+  const auto bits = std::byteswap(static_cast<std::uint32_t>(value));
+  return {reinterpret_cast<const char*>(&bits), 4};
+}
+
+std::string frontend(char type, const std::string& body) {
+  return std::string(1, type) +
+         int32(static_cast<std::int32_t>(body.size() + 4)) + body;
+}
+
+std::string cstring(const std::string& value) {
+  return value + std::string(1, '\0');
+}
+
+std::int32_t readInt32(std::string_view bytes) {
+  std::uint32_t bits;
+  std::memcpy(&bits, bytes.data(), 4);
+  return static_cast<std::int32_t>(std::byteswap(bits));
+}
+
+std::int16_t readInt16(std::string_view bytes) {
+  std::uint16_t bits;
+  std::memcpy(&bits, bytes.data(), 2);
+  return static_cast<std::int16_t>(std::byteswap(bits));
+}
+
+// Appends the complete backend messages at the front of `bytes' to
+// `messages' and removes them from `bytes'.
+void parseMessages(std::string& bytes, std::vector<Message>& messages) {
+  std::size_t offset = 0;
+  while (bytes.size() - offset >= 5) {
+    const auto length = static_cast<std::size_t>(
+        readInt32(std::string_view(bytes).substr(offset + 1)));
+    if (bytes.size() - offset < 1 + length) {
+      break;
+    }
+    messages.push_back(
+        {bytes[offset], bytes.substr(offset + 5, length - 4)});
+    offset += 1 + length;
+  }
+  bytes.erase(0, offset);
+}
+
+// Cells of a DataRow; nullopt for NULL.
+std::vector<std::optional<std::string>> dataRow(const Message& message) {
+  EXPECT_EQ(message.type, 'D');
+  std::string_view body = message.body;
+  const auto columns = readInt16(body);
+  body.remove_prefix(2);
+  std::vector<std::optional<std::string>> cells;
+  for (int i = 0; i < columns; ++i) {
+    const auto length = readInt32(body);
+    body.remove_prefix(4);
+    if (length < 0) {
+      cells.emplace_back();
+    } else {
+      cells.emplace_back(std::string(body.substr(0, length)));
+      body.remove_prefix(static_cast<std::size_t>(length));
+    }
+  }
+  return cells;
+}
+
+std::string types(const std::vector<Message>& messages) {
+  std::string out;
+  for (const auto& message : messages) {
+    out.push_back(message.type);
+  }
+  return out;
+}
+
+velox::RowTypePtr resultType() {
+  return velox::ROW({"id", "name"}, {velox::BIGINT(), velox::VARCHAR()});
+}
+
+// "scan" returns kBatches batches; every third name is NULL. "slow" waits
+// after its first batch until release() is called. "missing" and
+// "invalid" do not plan.
+class FakeEngine final : public QueryEngine {
+ public:
+  StatusOr<velox::RowTypePtr> describe(const std::string& query) override {
+    if (query == "missing") {
+      return Status::SqlError("table 'missing' does not exist");
+    }
+    if (query == "invalid") {
+      return Status::Invalid("argument out of range");
+    }
+    return resultType();
+  }
+
+  Status execute(const std::string& query, velox::memory::MemoryPool* pool,
+                 const RowVectorSink& sink) override {
+    executed.push_back(query);
+    for (int b = 0; b < kBatches; ++b) {
+      auto ids = velox::BaseVector::create(velox::BIGINT(), kBatchRows, pool);
+      auto names =
+          velox::BaseVector::create(velox::VARCHAR(), kBatchRows, pool);
+      for (int i = 0; i < kBatchRows; ++i) {
+        const int id = b * kBatchRows + i;
+        ids->asFlatVector<std::int64_t>()->set(i, id);
+        if (id % 3 == 0) {
+          names->setNull(i, true);
+        } else {
+          const std::string name = id == 1 ? "a\tb" : "n" + std::to_string(id);
+          names->asFlatVector<velox::StringView>()->set(
+              i, velox::StringView(name.data(),
+                                   static_cast<std::int32_t>(name.size())));
+        }
+      }
+      events.push_back("batch " + std::to_string(b));
+      auto status = sink(std::make_shared<velox::RowVector>(
+          pool, resultType(), nullptr, kBatchRows,
+          std::vector<velox::VectorPtr>{std::move(ids), std::move(names)}));
+      if (!status.ok()) {
+        return status;
+      }
+      if (query == "slow" && b == 0) {
+        std::unique_lock lock(mutex_);
+        released_.wait_for(lock, std::chrono::seconds(10),
+                           [&] { return released; });
+      }
+    }
+    return Status::OK();
+  }
+
+  void release() {
+    std::lock_guard lock(mutex_);
+    released = true;
+    released_.notify_all();
+  }
+
+  std::vector<std::string> events;
+  std::vector<std::string> executed;
+  bool released = false;
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable released_;
+};
+
+class PgSessionTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    engine_ = std::make_shared<FakeEngine>();
+    session_ = std::make_unique<PgSession>(
+        engine_, velox::memory::memoryManager()->addLeafPool("pg_session"),
+        [this](std::string bytes) {
+          engine_->events.emplace_back("write");
+          pending_ += bytes;
+          return Status::OK();
+        },
+        PgSessionOptions{.process_id = 42});
+  }
+
+  // Sends the startup packet and drops the replies.
+  void startup() {
+    const std::string body = int32(kProtocolVersion3) + cstring("user") +
+                             cstring("bi") + cstring("application_name") +
+                             cstring("psql") + std::string(1, '\0');
+    ASSERT_TRUE(session_->handle({0, body}));
+    const auto replies = receive();
+    EXPECT_EQ(types(replies), "RSSSSSSSSKZ");
+    engine_->events.clear();
+  }
+
+  std::vector<Message> receive() {
+    std::vector<Message> messages;
+    parseMessages(pending_, messages);
+    EXPECT_TRUE(pending_.empty());
+    return messages;
+  }
+
+  std::shared_ptr<FakeEngine> engine_;
+  std::unique_ptr<PgSession> session_;
+  std::string pending_;
+};
+
+}  // namespace
+
+TEST_F(PgSessionTest, StartupDeclinesSslAndReportsParameters) {
+  ASSERT_TRUE(session_->handle({0, int32(kSslRequestCode)}));
+  EXPECT_EQ(pending_, "N");
+  pending_.clear();
+
+  const std::string body = int32(kProtocolVersion3) + cstring("user") +
+                           cstring("bi") + std::string(1, '\0');
+  ASSERT_TRUE(session_->handle({0, body}));
+  const auto replies = receive();
+  ASSERT_EQ(types(replies), "RSSSSSSSSKZ");
+  EXPECT_EQ(readInt32(replies[0].body), 0);
+  EXPECT_EQ(replies[1].body, cstring("server_version") + cstring("14.0"));
+  EXPECT_EQ(readInt32(replies[9].body), 42);
+  EXPECT_EQ(replies[10].body, "I");
+}
+
+TEST_F(PgSessionTest, SimpleQueryWritesEachBatchAsItArrives) {
+  startup();
+  ASSERT_TRUE(session_->handle({'Q', cstring("scan;")}));
+  const auto replies = receive();
+  ASSERT_EQ(types(replies), "T" + std::string(kBatches * kBatchRows, 'D') +
+                                "CZ");
+  EXPECT_EQ(replies.back().body, "I");
+  EXPECT_EQ(replies[replies.size() - 2].body,
+            cstring("SELECT " + std::to_string(kBatches * kBatchRows)));
+  // Text format: column names, then cells as text.
+  EXPECT_EQ(readInt16(replies[0].body), 2);
+  EXPECT_EQ(replies[0].body.substr(2, 3), cstring("id"));
+  EXPECT_EQ(dataRow(replies[1]),
+            (std::vector<std::optional<std::string>>{"0", std::nullopt}));
+  EXPECT_EQ(dataRow(replies[2]),
+            (std::vector<std::optional<std::string>>{"1", "a\tb"}));
+  // The rows of a batch went out before the engine made the next one.
+  EXPECT_EQ(engine_->events,
+            (std::vector<std::string>{"batch 0", "write", "batch 1", "write",
+                                      "batch 2", "write", "write"}));
+}
+
+TEST_F(PgSessionTest, ExtendedQueryUsesRequestedBinaryFormats) {
+  startup();
+  ASSERT_TRUE(session_->handle(
+      {'P', cstring("s1") + cstring("scan") + int16(0)}));
+  ASSERT_TRUE(session_->handle({'B', cstring("") + cstring("s1") + int16(0) +
+                                         int16(0) + int16(2) + int16(1) +
+                                         int16(0)}));
+  ASSERT_TRUE(session_->handle({'D', "P" + cstring("")}));
+  ASSERT_TRUE(session_->handle({'E', cstring("") + int32(0)}));
+  ASSERT_TRUE(session_->handle({'S', ""}));
+  const auto replies = receive();
+  ASSERT_EQ(types(replies), "12T" + std::string(kBatches * kBatchRows, 'D') +
+                                "CZ");
+  // RowDescription ends each field with its format code.
+  const auto& description = replies[2].body;
+  EXPECT_EQ(readInt16(description.substr(2 + 3 + 16)), 1);
+  EXPECT_EQ(readInt16(description.substr(description.size() - 2)), 0);
+
+  const auto row = dataRow(replies[4]);
+  ASSERT_TRUE(row[0].has_value());
+  ASSERT_EQ(row[0]->size(), 8U);
+  std::uint64_t bits;
+  std::memcpy(&bits, row[0]->data(), 8);
+  EXPECT_EQ(std::byteswap(bits), 1U);
+  EXPECT_EQ(row[1], "a\tb");
+}
+
+TEST_F(PgSessionTest, ErrorsSkipToSync) {
+  startup();
+  ASSERT_TRUE(session_->handle(
+      {'P', cstring("") + cstring("missing") + int16(0)}));
+  ASSERT_TRUE(session_->handle({'B', cstring("") + cstring("") + int16(0) +
+                                         int16(0) + int16(0)}));
+  ASSERT_TRUE(session_->handle({'E', cstring("") + int32(0)}));
+  ASSERT_TRUE(session_->handle({'S', ""}));
+  auto replies = receive();
+  ASSERT_EQ(types(replies), "EZ");
+  EXPECT_NE(replies[0].body.find("42601"), std::string::npos);
+  EXPECT_NE(replies[0].body.find("does not exist"), std::string::npos);
+
+  // Bind parameters are refused.
+  ASSERT_TRUE(session_->handle(
+      {'P', cstring("") + cstring("scan") + int16(0)}));
+  ASSERT_TRUE(session_->handle({'B', cstring("") + cstring("") + int16(0) +
+                                         int16(1) + int32(-1) + int16(0)}));
+  ASSERT_TRUE(session_->handle({'S', ""}));
+  replies = receive();
+  ASSERT_EQ(types(replies), "1EZ");
+  EXPECT_NE(replies[1].body.find("0A000"), std::string::npos);
+
+  // Malformed messages are protocol violations; invalid statements are not.
+  ASSERT_TRUE(session_->handle({'B', cstring("")}));
+  ASSERT_TRUE(session_->handle({'S', ""}));
+  replies = receive();
+  ASSERT_EQ(types(replies), "EZ");
+  EXPECT_NE(replies[0].body.find("08P01"), std::string::npos);
+  ASSERT_TRUE(session_->handle({'Q', cstring("invalid")}));
+  replies = receive();
+  ASSERT_EQ(types(replies), "EZ");
+  EXPECT_NE(replies[0].body.find("22023"), std::string::npos);
+
+  ASSERT_TRUE(session_->handle({'Q', cstring("missing")}));
+  EXPECT_EQ(types(receive()), "EZ");
+  ASSERT_TRUE(session_->handle({'Q', cstring("set extra_float_digits = 3")}));
+  replies = receive();
+  ASSERT_EQ(types(replies), "CZ");
+  EXPECT_EQ(replies[0].body, cstring("SET"));
+  ASSERT_TRUE(session_->handle({'Q', cstring("  ; ")}));
+  EXPECT_EQ(types(receive()), "IZ");
+  EXPECT_FALSE(session_->handle({'X', ""}));
+}
+
+TEST_F(PgSessionTest, BinaryFormatIsAcceptedForTextColumns) {
+  startup();
+  ASSERT_TRUE(session_->handle(
+      {'P', cstring("") + cstring("scan") + int16(0)}));
+  ASSERT_TRUE(session_->handle({'B', cstring("") + cstring("") + int16(0) +
+                                         int16(0) + int16(1) + int16(1)}));
+  ASSERT_TRUE(session_->handle({'E', cstring("") + int32(0)}));
+  ASSERT_TRUE(session_->handle({'S', ""}));
+  const auto replies = receive();
+  ASSERT_EQ(types(replies),
+            "12" + std::string(kBatches * kBatchRows, 'D') + "CZ");
+  // One format code for all columns: the id in binary, the name as is.
+  const auto row = dataRow(replies[3]);
+  ASSERT_TRUE(row[0].has_value());
+  EXPECT_EQ(row[0]->size(), 8U);
+  EXPECT_EQ(row[1], "a\tb");
+}
+
+TEST_F(PgSessionTest, ReadyForQueryReportsTransactionStatus) {
+  startup();
+  const auto status = [&](const std::string& query) {
+    EXPECT_TRUE(session_->handle({'Q', cstring(query)}));
+    const auto replies = receive();
+    return replies.empty() ? std::string() : replies.back().body;
+  };
+  EXPECT_EQ(status("BEGIN"), "T");
+  EXPECT_EQ(status("scan"), "T");
+  EXPECT_EQ(status("missing"), "E");
+  // Refused until the block ends; COMMIT then rolls it back.
+  EXPECT_EQ(status("scan"), "E");
+  EXPECT_TRUE(session_->handle({'Q', cstring("commit")}));
+  auto replies = receive();
+  ASSERT_EQ(types(replies), "CZ");
+  EXPECT_EQ(replies[0].body, cstring("ROLLBACK"));
+  EXPECT_EQ(replies[1].body, "I");
+  EXPECT_EQ(engine_->executed, std::vector<std::string>{"scan"});
+
+  EXPECT_EQ(status("start transaction"), "T");
+  EXPECT_EQ(status("rollback"), "I");
+
+  // The rejection in a failed block has its own SQLSTATE, also in extended
+  // queries.
+  EXPECT_EQ(status("begin"), "T");
+  EXPECT_EQ(status("missing"), "E");
+  ASSERT_TRUE(session_->handle(
+      {'P', cstring("") + cstring("scan") + int16(0)}));
+  ASSERT_TRUE(session_->handle({'B', cstring("") + cstring("") + int16(0) +
+                                         int16(0) + int16(0)}));
+  ASSERT_TRUE(session_->handle({'E', cstring("") + int32(0)}));
+  ASSERT_TRUE(session_->handle({'S', ""}));
+  replies = receive();
+  ASSERT_EQ(types(replies), "12EZ");
+  EXPECT_NE(replies[2].body.find("25P02"), std::string::npos);
+  EXPECT_EQ(replies[3].body, "E");
+  EXPECT_EQ(status("end"), "I");
+}
+
+TEST_F(PgSessionTest, KeywordsNeedAWordBoundary) {
+  startup();
+  ASSERT_TRUE(session_->handle({'Q', cstring("SET_scan")}));
+  auto replies = receive();
+  ASSERT_EQ(types(replies), "T" + std::string(kBatches * kBatchRows, 'D') +
+                                "CZ");
+  ASSERT_TRUE(session_->handle({'Q', cstring("settings")}));
+  EXPECT_EQ(types(receive()).front(), 'T');
+  EXPECT_EQ(engine_->executed,
+            (std::vector<std::string>{"SET_scan", "settings"}));
+}
+
+TEST_F(PgSessionTest, CopyOutSendsOneCopyDataPerRow) {
+  startup();
+  ASSERT_TRUE(session_->handle({'Q', cstring("COPY (scan) TO STDOUT")}));
+  auto replies = receive();
+  const int rows = kBatches * kBatchRows;
+  ASSERT_EQ(types(replies), "H" + std::string(rows, 'd') + "cCZ");
+  EXPECT_EQ(replies[0].body, std::string(1, '\0') + int16(2) + int16(0) +
+                                 int16(0));
+  EXPECT_EQ(replies[1].body, "0\t\\N\n");
+  EXPECT_EQ(replies[2].body, "1\ta\\tb\n");
+  EXPECT_EQ(replies[rows + 2].body, cstring("COPY " + std::to_string(rows)));
+
+  ASSERT_TRUE(session_->handle(
+      {'Q', cstring("copy ( scan ) to stdout with (format csv, header)")}));
+  replies = receive();
+  ASSERT_EQ(types(replies), "H" + std::string(rows, 'd') + "cCZ");
+  EXPECT_EQ(replies[1].body, "id,name\n0,\n");
+  EXPECT_EQ(replies[2].body, "1,a\tb\n");
+
+  ASSERT_TRUE(
+      session_->handle({'Q', cstring("COPY (scan) TO '/tmp/out.csv'")}));
+  EXPECT_EQ(types(receive()), "EZ");
+}
+
+TEST(PgServerTest, StreamsFirstRowsBeforeQueryFinishes) {
+  auto engine = std::make_shared<FakeEngine>();
+  auto server = PgServer::create(engine, {.worker_threads = 2});
+  ASSERT_TRUE(server.ok()) << server.status().message();
+  auto status = (*server)->listen(0);
+  ASSERT_TRUE(status.ok()) << status.message();
+
+  const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(fd, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons((*server)->port());
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(::connect(fd, reinterpret_cast<sockaddr*>(&address),
+                      sizeof(address)),
+            0);
+
+  std::string pending;
+  std::vector<Message> messages;
+  const auto send = [&](const std::string& bytes) {
+    ASSERT_EQ(::write(fd, bytes.data(), bytes.size()),
+              static_cast<ssize_t>(bytes.size()));
+  };
+  // Reads until `count' messages of `type' have arrived.
+  const auto receiveUntil = [&](char type, long count = 1) {
+    char buffer[4096];
+    while (std::ranges::count(types(messages), type) < count) {
+      const auto n = ::read(fd, buffer, sizeof(buffer));
+      ASSERT_GT(n, 0);
+      pending.append(buffer, static_cast<std::size_t>(n));
+      parseMessages(pending, messages);
+    }
+  };
+
+  const std::string startup = int32(kProtocolVersion3) + cstring("user") +
+                              cstring("bi") + std::string(1, '\0');
+  send(int32(static_cast<std::int32_t>(startup.size() + 4)) + startup);
+  receiveUntil('Z');
+  messages.clear();
+
+  send(frontend('Q', cstring("slow")));
+  receiveUntil('D', kBatchRows);
+  // The engine is still blocked after its first batch.
+  EXPECT_EQ(types(messages), "T" + std::string(kBatchRows, 'D'));
+  engine->release();
+  receiveUntil('Z');
+  EXPECT_EQ(types(messages), "T" + std::string(kBatches * kBatchRows, 'D') +
+                                 "CZ");
+
+  send(frontend('X', ""));
+  ::close(fd);
+  (*server)->stop();
+}
+
+}  // namespace halo::server::pgwire
@@ -0,0 +1,468 @@
+#include <arrow/api.h>
+#include <arrow/io/memory.h>
+#include <arrow/ipc/options.h>
+#include <arrow/ipc/reader.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <grpc/compression.h>
+#include <grpcpp/create_channel.h>
+#include <grpcpp/generic/generic_stub.h>
+#include <grpcpp/security/credentials.h>
+#include <grpcpp/support/channel_arguments.h>
+#include <gtest/gtest.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+import halo.common;
+import halo.server.engine;
+import halo.server.rpc;
+
+namespace halo::server::rpc {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+using common::base::Status;
+using common::base::StatusOr;
+using engine::QueryEngine;
+using engine::RowVectorSink;
+using google::protobuf::internal::WireFormatLite;
+
+constexpr int kBatches = 4;
+constexpr int kBatchRows = 1000;
+
+velox::RowTypePtr resultType() {
+  return velox::ROW({"id", "name"}, {velox::BIGINT(), velox::VARCHAR()});
+}
+
+velox::RowVectorPtr makeBatch(int first, int rows,
+                              velox::memory::MemoryPool* pool) {
+  auto ids = velox::BaseVector::create(velox::BIGINT(), rows, pool);
+  auto names = velox::BaseVector::create(velox::VARCHAR(), rows, pool);
+  for (int i = 0; i < rows; ++i) {
+    ids->asFlatVector<std::int64_t>()->set(i, first + i);
+    const std::string name = "customer#" + std::to_string(first + i);
+    names->asFlatVector<velox::StringView>()->set(
+        i, velox::StringView(name.data(),
+                             static_cast<std::int32_t>(name.size())));
+  }
+  return std::make_shared<velox::RowVector>(
+      pool, resultType(), nullptr, rows,
+      std::vector<velox::VectorPtr>{std::move(ids), std::move(names)});
+}
+
+// "scan" returns kBatches batches, "fail" fails after one batch, "missing"
+// does not plan, "wait" returns one batch once release() was called and
+// "endless" returns batches until the sink refuses one.
+class FakeEngine final : public QueryEngine {
+ public:
+  StatusOr<velox::RowTypePtr> describe(const std::string& query) override {
+    if (query == "missing") {
+      return Status::SqlError("table 'missing' does not exist");
+    }
+    return resultType();
+  }
+
+  Status execute(const std::string& query, velox::memory::MemoryPool* pool,
+                 const RowVectorSink& sink) override {
+    if (query == "wait") {
+      std::unique_lock lock(mutex_);
+      waiting_ = true;
+      released_.notify_all();
+      released_.wait(lock, [this] { return release_; });
+    }
+    if (query == "endless") {
+      Status status = Status::OK();
+      for (int b = 0; status.ok(); ++b) {
+        status = sink(makeBatch(b * kBatchRows, kBatchRows, pool));
+      }
+      std::lock_guard lock(mutex_);
+      endless_stopped_ = true;
+      released_.notify_all();
+      return status;
+    }
+    const int batches = query == "scan" ? kBatches : 1;
+    for (int b = 0; b < batches; ++b) {
+      auto status = sink(makeBatch(b * kBatchRows, kBatchRows, pool));
+      if (!status.ok()) {
+        return status;
+      }
+    }
+    if (query == "fail") {
+      return Status::QueryExecutorError("worker lost");
+    }
+    return Status::OK();
+  }
+
+  // Returns once a "wait" query runs.
+  void awaitWaiting() {
+    std::unique_lock lock(mutex_);
+    released_.wait(lock, [this] { return waiting_; });
+  }
+
+  void release() {
+    std::lock_guard lock(mutex_);
+    release_ = true;
+    released_.notify_all();
+  }
+
+  // Returns once an "endless" query has stopped.
+  void awaitEndlessStopped() {
+    std::unique_lock lock(mutex_);
+    released_.wait(lock, [this] { return endless_stopped_; });
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable released_;
+  bool waiting_ = false;
+  bool release_ = false;
+  bool endless_stopped_ = false;
+};
+
+grpc::ByteBuffer executeRequest(const std::string& sql,
+                                CallCompression compression) {
+  std::string bytes;
+  {
+    google::protobuf::io::StringOutputStream output(&bytes);
+    google::protobuf::io::CodedOutputStream coded(&output);
+    WireFormatLite::WriteString(1, sql, &coded);
+    WireFormatLite::WriteEnum(2, static_cast<int>(compression), &coded);
+  }
+  grpc::Slice slice(bytes);
+  return grpc::ByteBuffer(&slice, 1);
+}
+
+struct CallResult {
+  grpc::Status status;
+  // ExecuteResponse.rows of each response.
+  std::vector<std::int64_t> rows;
+  // The concatenated ExecuteResponse.arrow_ipc.
+  std::string ipc;
+
+  [[nodiscard]] std::shared_ptr<arrow::Table> table() const {
+    auto reader = arrow::ipc::RecordBatchStreamReader::Open(
+        std::make_shared<arrow::io::BufferReader>(
+            arrow::Buffer::FromString(ipc)));
+    if (!reader.ok()) {
+      ADD_FAILURE() << reader.status().ToString();
+      return nullptr;
+    }
+    auto table = (*reader)->ToTable();
+    if (!table.ok()) {
+      ADD_FAILURE() << table.status().ToString();
+      return nullptr;
+    }
+    return *table;
+  }
+};
+
+// A client of QueryService.Execute, as a generated stub would call it: one
+// request, then the response stream.
+class ExecuteCall final
+    : public grpc::ClientBidiReactor<grpc::ByteBuffer, grpc::ByteBuffer> {
+ public:
+  ExecuteCall(grpc::GenericStub& stub, const std::string& sql,
+              CallCompression compression,
+              std::chrono::milliseconds read_delay)
+      : request_(executeRequest(sql, compression)), read_delay_(read_delay) {
+    stub.PrepareBidiStreamingCall(&context_, std::string(kExecuteMethod),
+                                  grpc::StubOptions(), this);
+    StartWriteLast(&request_, grpc::WriteOptions());
+    StartRead(&response_);
+    StartCall();
+  }
+
+  void OnReadDone(bool ok) override {
+    if (!ok) {
+      return;
+    }
+    std::vector<grpc::Slice> slices;
+    ASSERT_TRUE(response_.Dump(&slices).ok());
+    std::string bytes;
+    for (const auto& slice : slices) {
+      bytes.append(reinterpret_cast<const char*>(slice.begin()),
+                   slice.size());
+    }
+    google::protobuf::io::CodedInputStream input(
+        reinterpret_cast<const std::uint8_t*>(bytes.data()),
+        static_cast<int>(bytes.size()));
+    std::int64_t rows = 0;
+    while (const auto tag = input.ReadTag()) {
+      if (WireFormatLite::GetTagFieldNumber(tag) == 1) {
+        std::string ipc;
+        ASSERT_TRUE(WireFormatLite::ReadBytes(&input, &ipc));
+        result_.ipc += ipc;
+      } else {
+        std::uint64_t value = 0;
+        ASSERT_TRUE(input.ReadVarint64(&value));
+        rows = static_cast<std::int64_t>(value);
+      }
+    }
+    result_.rows.push_back(rows);
+    if (result_.rows.size() == 1) {
+      first_response_.set_value();
+    }
+    std::this_thread::sleep_for(read_delay_);
+    StartRead(&response_);
+  }
+
+  void OnDone(const grpc::Status& status) override {
+    result_.status = status;
+    done_.set_value();
+  }
+
+  CallResult await() {
+    done_.get_future().wait();
+    return std::move(result_);
+  }
+
+  void cancel() { context_.TryCancel(); }
+
+  // Returns once the first response arrived.
+  void awaitFirstResponse() { first_response_.get_future().wait(); }
+
+ private:
+  grpc::ClientContext context_;
+  grpc::ByteBuffer request_;
+  grpc::ByteBuffer response_;
+  const std::chrono::milliseconds read_delay_;
+  CallResult result_;
+  std::promise<void> done_;
+  std::promise<void> first_response_;
+};
+
+class QueryServiceTest : public ::testing::Test {
+ protected:
+  void start(const QueryServiceOptions& options) {
+    engine_ = std::make_shared<FakeEngine>();
+    auto server = QueryServer::start(engine_, options);
+    ASSERT_TRUE(server.ok()) << server.status().message();
+    server_ = std::move(server).value();
+    connect({});
+  }
+
+  // `arguments' lets a test restrict the encodings the client accepts.
+  void connect(const grpc::ChannelArguments& arguments) {
+    channel_ = grpc::CreateCustomChannel(
+        "127.0.0.1:" + std::to_string(server_->port()),
+        grpc::InsecureChannelCredentials(), arguments);
+    stub_ = std::make_unique<grpc::GenericStub>(channel_);
+  }
+
+  CallResult execute(
+      const std::string& sql,
+      CallCompression compression = CallCompression::kDefault,
+      std::chrono::milliseconds read_delay = std::chrono::milliseconds(0)) {
+    ExecuteCall call(*stub_, sql, compression, read_delay);
+    return call.await();
+  }
+
+  static void expectScanResult(const CallResult& result) {
+    ASSERT_TRUE(result.status.ok()) << result.status.error_message();
+    ASSERT_EQ(result.rows.size(), kBatches + 1U);
+    EXPECT_EQ(result.rows[0], 0);
+    const auto table = result.table();
+    ASSERT_NE(table, nullptr);
+    ASSERT_EQ(table->num_rows(), kBatches * kBatchRows);
+    EXPECT_EQ(table->schema()->ToString(), "id: int64\nname: string");
+    std::int64_t row = 0;
+    for (const auto& batch : arrow::TableBatchReader(*table)) {
+      ASSERT_TRUE(batch.ok());
+      const auto& ids =
+          static_cast<const arrow::Int64Array&>(*(*batch)->column(0));
+      const auto& names =
+          static_cast<const arrow::StringArray&>(*(*batch)->column(1));
+      for (std::int64_t i = 0; i < (*batch)->num_rows(); ++i, ++row) {
+        ASSERT_EQ(ids.Value(i), row);
+        ASSERT_EQ(names.GetView(i), "customer#" + std::to_string(row));
+      }
+    }
+  }
+
+  std::shared_ptr<FakeEngine> engine_;
+  std::unique_ptr<QueryServer> server_;
+  std::shared_ptr<grpc::Channel> channel_;
+  std::unique_ptr<grpc::GenericStub> stub_;
+};
+
+}  // namespace
+
+TEST(MessagesTest, DecodesRequestAndSkipsUnknownFields) {
+  std::string bytes;
+  {
+    google::protobuf::io::StringOutputStream output(&bytes);
+    google::protobuf::io::CodedOutputStream coded(&output);
+    WireFormatLite::WriteString(1, "SELECT 1", &coded);
+    WireFormatLite::WriteInt64(9, 42, &coded);
+    WireFormatLite::WriteEnum(2, 3, &coded);
+  }
+  grpc::Slice slice(bytes);
+  auto request = decodeExecuteRequest(grpc::ByteBuffer(&slice, 1));
+  ASSERT_TRUE(request.ok()) << request.status().message();
+  EXPECT_EQ(request->sql, "SELECT 1");
+  EXPECT_EQ(request->compression, CallCompression::kMedium);
+
+  grpc::Slice truncated(bytes.substr(0, 4));
+  EXPECT_FALSE(decodeExecuteRequest(grpc::ByteBuffer(&truncated, 1)).ok());
+}
+
+TEST(MessagesTest, ResponseSharesLargeBuffers) {
+  arrow::Int64Builder values;
+  for (std::int64_t i = 0; i < 4096; ++i) {
+    ASSERT_TRUE(values.Append(i).ok());
+  }
+  auto array = values.Finish();
+  ASSERT_TRUE(array.ok());
+  const auto batch = arrow::RecordBatch::Make(
+      arrow::schema({arrow::field("v", arrow::int64())}), 4096, {*array});
+  auto response =
+      batchResponse(*batch, arrow::ipc::IpcWriteOptions::Defaults());
+  ASSERT_TRUE(response.ok()) << response.status().message();
+  std::vector<grpc::Slice> slices;
+  ASSERT_TRUE(response->Dump(&slices).ok());
+  const auto* values_data = (*array)->data()->buffers[1]->data();
+  bool shared = false;
+  for (const auto& slice : slices) {
+    shared = shared || slice.begin() == values_data;
+  }
+  EXPECT_TRUE(shared);
+}
+
+TEST_F(QueryServiceTest, StreamsResultAsArrowIpc) {
+  start({});
+  expectScanResult(execute("scan"));
+}
+
+TEST_F(QueryServiceTest, NegotiatesCompressionWithClient) {
+  start({});
+  for (const auto compression :
+       {CallCompression::kNone, CallCompression::kLow,
+        CallCompression::kHigh}) {
+    expectScanResult(execute("scan", compression));
+  }
+  // A client that only accepts gzip, then one that accepts no compression.
+  for (const std::uint32_t accepted :
+       {(1U << GRPC_COMPRESS_NONE) | (1U << GRPC_COMPRESS_GZIP),
+        1U << GRPC_COMPRESS_NONE}) {
+    grpc::ChannelArguments arguments;
+    arguments.SetInt(GRPC_COMPRESSION_CHANNEL_ENABLED_ALGORITHMS_BITSET,
+                     static_cast<int>(accepted));
+    connect(arguments);
+    expectScanResult(execute("scan", CallCompression::kHigh));
+  }
+}
+
+TEST_F(QueryServiceTest, SlowClientStillGetsEveryBatch) {
+  // Room for a single batch: the query waits for the client after each one.
+  start({.stream = {.max_queued_bytes = 1}});
+  expectScanResult(
+      execute("scan", CallCompression::kNone, std::chrono::milliseconds(10)));
+}
+
+TEST_F(QueryServiceTest, RefusesQueriesBeyondMemoryQuota) {
+  // Room for one running query.
+  start({.stream = {.memory_limit_bytes = 64 << 20},
+         .memory_quota_bytes = 64 << 20});
+  std::thread first([this] {
+    const auto result = execute("wait");
+    EXPECT_TRUE(result.status.ok()) << result.status.error_message();
+  });
+  engine_->awaitWaiting();
+  EXPECT_EQ(execute("scan").status.error_code(),
+            grpc::StatusCode::RESOURCE_EXHAUSTED);
+  engine_->release();
+  first.join();
+
+  // The reservation is returned once the server is done with the call.
+  CallResult admitted;
+  for (int attempt = 0; attempt < 100; ++attempt) {
+    admitted = execute("scan");
+    if (admitted.status.error_code() != grpc::StatusCode::RESOURCE_EXHAUSTED) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  expectScanResult(admitted);
+}
+
+TEST_F(QueryServiceTest, CancelledCallStopsItsQuery) {
+  // One thread each: the next call only runs once the cancelled one has
+  // given both back.
+  start({.query_threads = 1, .writer_threads = 1});
+  ExecuteCall call(*stub_, "endless", CallCompression::kDefault,
+                   std::chrono::milliseconds(0));
+  call.awaitFirstResponse();
+  call.cancel();
+  EXPECT_EQ(call.await().status.error_code(), grpc::StatusCode::CANCELLED);
+  engine_->awaitEndlessStopped();
+  expectScanResult(execute("scan"));
+}
+
+TEST_F(QueryServiceTest, ReportsErrorsWithStatusCodes) {
+  start({});
+  const auto missing = execute("missing");
+  EXPECT_EQ(missing.status.error_code(), grpc::StatusCode::INVALID_ARGUMENT);
+  EXPECT_NE(missing.status.error_message().find("does not exist"),
+            std::string::npos);
+
+  const auto failed = execute("fail");
+  EXPECT_EQ(failed.status.error_code(), grpc::StatusCode::INTERNAL);
+  EXPECT_NE(failed.status.error_message().find("worker lost"),
+            std::string::npos);
+
+  grpc::ClientContext context;
+  grpc::ByteBuffer response;
+  std::promise<grpc::Status> done;
+  const auto request = executeRequest("scan", CallCompression::kDefault);
+  stub_->UnaryCall(&context, "/halo.rpc.QueryService/Describe",
+                   grpc::StubOptions(), &request, &response,
+                   [&](grpc::Status status) { done.set_value(status); });
+  EXPECT_EQ(done.get_future().get().error_code(),
+            grpc::StatusCode::UNIMPLEMENTED);
+}
+
+TEST_F(QueryServiceTest, AnswersHealthChecks) {
+  start({});
+  std::string bytes;
+  {
+    google::protobuf::io::StringOutputStream output(&bytes);
+    google::protobuf::io::CodedOutputStream coded(&output);
+    WireFormatLite::WriteString(1, std::string(kServiceName), &coded);
+  }
+  grpc::Slice slice(bytes);
+  const grpc::ByteBuffer request(&slice, 1);
+  grpc::ClientContext context;
+  grpc::ByteBuffer response;
+  std::promise<grpc::Status> done;
+  stub_->UnaryCall(&context, "/grpc.health.v1.Health/Check",
+                   grpc::StubOptions(), &request, &response,
+                   [&](grpc::Status status) { done.set_value(status); });
+  const auto status = done.get_future().get();
+  ASSERT_TRUE(status.ok()) << status.error_message();
+
+  std::vector<grpc::Slice> slices;
+  ASSERT_TRUE(response.Dump(&slices).ok());
+  std::string message;
+  for (const auto& part : slices) {
+    message.append(reinterpret_cast<const char*>(part.begin()), part.size());
+  }
+  // HealthCheckResponse { status: SERVING }
+  EXPECT_EQ(message, std::string({0x08, 0x01}));
+}
+
+}  // namespace halo::server::rpc
@@ -0,0 +1,117 @@
+// Cost of a short query with and without the session pool: opening a
+// database and a connection for each query, a fresh connection to a shared
+// database for each query, and a pooled session, alone and with many
+// sessions of different settings contending for a few connections.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <duckdb.hpp>
+
+import halo.common;
+import halo.server.session;
+
+namespace halo::server::session {
+
+namespace {
+
+constexpr int kQueries = 2000;
+constexpr int kSessions = 1000;
+constexpr int kThreads = 8;
+constexpr std::size_t kConnections = 4;
+constexpr const char* kQuery = "SELECT sum(range) FROM range(100)";
+
+template <typename Run>
+double microsPerQuery(int queries, Run run) {
+  const auto start = std::chrono::steady_clock::now();
+  run();
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         queries;
+}
+
+void print(const std::string& name, double micros) {
+  std::cout << std::left << std::setw(34) << name << std::right
+            << std::setw(12) << micros << "\n";
+}
+
+}  // namespace
+
+TEST(SessionPoolBenchmark, ConnectionSetupVersusPooledSessions) {
+  std::cout << std::fixed << std::setprecision(1) << kQueries
+            << " queries of `" << kQuery << "'\n"
+            << std::left << std::setw(34) << "connection" << std::right
+            << std::setw(12) << "us/query" << "\n";
+
+  print("new database and connection", microsPerQuery(kQueries, [] {
+          for (int i = 0; i < kQueries; ++i) {
+            duckdb::DuckDB database(nullptr);
+            duckdb::Connection connection(database);
+            EXPECT_FALSE(connection.Query(kQuery)->HasError());
+          }
+        }));
+
+  duckdb::DuckDB shared(nullptr);
+  print("new connection", microsPerQuery(kQueries, [&] {
+          for (int i = 0; i < kQueries; ++i) {
+            duckdb::Connection connection(shared);
+            EXPECT_FALSE(connection.Query(kQuery)->HasError());
+          }
+        }));
+
+  auto manager =
+      SessionManager::create({.connections_per_database = kConnections});
+  auto session = manager->openSession();
+  ASSERT_TRUE(session.ok()) << session.status().toString();
+  print("pooled session", microsPerQuery(kQueries, [&] {
+          for (int i = 0; i < kQueries; ++i) {
+            EXPECT_TRUE((*session)->query(kQuery).ok());
+          }
+        }));
+
+  std::vector<std::unique_ptr<Session>> sessions;
+  for (int i = 0; i < kSessions; ++i) {
+    auto opened = manager->openSession();
+    ASSERT_TRUE(opened.ok()) << opened.status().toString();
+    if (i % 4 == 0) {
+      ASSERT_TRUE((*opened)->set("search_path", "'main'").ok());
+    }
+    sessions.push_back(std::move(opened).value());
+  }
+  const auto before = manager->stats().value();
+  std::atomic<int> next{0};
+  const auto name = std::to_string(kSessions) + " sessions, " +
+                    std::to_string(kThreads) + " threads";
+  print(name, microsPerQuery(kQueries, [&] {
+          std::vector<std::thread> threads;
+          for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&] {
+              for (int i = next++; i < kQueries; i = next++) {
+                EXPECT_TRUE(sessions[i % kSessions]->query(kQuery).ok());
+              }
+            });
+          }
+          for (auto& thread : threads) {
+            thread.join();
+          }
+        }));
+  const auto after = manager->stats().value();
+  std::cout << after.open << " connections open, "
+            << after.waits - before.waits << " waits, "
+            << after.setting_changes - before.setting_changes
+            << " setting changes\n";
+  EXPECT_LE(after.open, kConnections);
+}
+
+}  // namespace halo::server::session
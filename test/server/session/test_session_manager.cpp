@@ -0,0 +1,317 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <duckdb.hpp>
+
+import halo.common;
+import halo.server.engine;
+import halo.server.session;
+
+namespace halo::server::session {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+using common::base::Status;
+
+std::unique_ptr<Session> open(SessionManager& manager,
+                              const std::string& path = "") {
+  auto session = manager.openSession(path);
+  EXPECT_TRUE(session.ok()) << session.status().toString();
+  return std::move(session).value();
+}
+
+// The first value of `sql' run by `session', as text.
+std::string scalar(Session& session, const std::string& sql) {
+  auto result = session.query(sql);
+  EXPECT_TRUE(result.ok()) << result.status().toString();
+  if (!result.ok() || (*result)->RowCount() == 0) {
+    return {};
+  }
+  return (*result)->GetValue(0, 0).ToString();
+}
+
+constexpr const char* kSearchPath = "SELECT current_setting('search_path')";
+
+}  // namespace
+
+TEST(SessionSettingsTest, ScansSetsAndResets) {
+  const auto scan = scanSettings(
+      "SET Search_Path = 'a;b'; reset SESSION enable_profiling;"
+      " -- SET ignored = 1\n SET GLOBAL threads TO 4; SET memory_limit TO "
+      "'1GB'; UPDATE t SET x = 1");
+  EXPECT_FALSE(scan.opaque);
+  ASSERT_EQ(scan.changes.size(), 3U);
+  EXPECT_EQ(scan.changes[0].name, "search_path");
+  EXPECT_EQ(scan.changes[0].value, "'a;b'");
+  EXPECT_EQ(scan.changes[1].name, "enable_profiling");
+  EXPECT_FALSE(scan.changes[1].value.has_value());
+  EXPECT_EQ(scan.changes[2].name, "memory_limit");
+  EXPECT_EQ(scan.changes[2].value, "'1GB'");
+
+  EXPECT_TRUE(scanSettings("SET VARIABLE x = 1").opaque);
+  EXPECT_TRUE(scanSettings("SET \"odd name\" = 1").opaque);
+  EXPECT_TRUE(scanSettings("SET search_path").opaque);
+  EXPECT_FALSE(scanSettings("SELECT 'SET x = 1'").opaque);
+  EXPECT_TRUE(scanSettings("create temp table t (x int)").opaque);
+  EXPECT_TRUE(
+      scanSettings("SELECT 1; CREATE OR REPLACE TEMPORARY VIEW v AS SELECT 1")
+          .opaque);
+  EXPECT_TRUE(scanSettings("CREATE TEMP MACRO twice(x) AS x * 2").opaque);
+  EXPECT_TRUE(scanSettings("PREPARE q AS SELECT $1").opaque);
+  EXPECT_TRUE(scanSettings("USE memory.other").opaque);
+  EXPECT_FALSE(scanSettings("CREATE TABLE temp (x int)").opaque);
+  EXPECT_FALSE(scanSettings("CREATE VIEW temporary_v AS SELECT 1").opaque);
+  EXPECT_TRUE(scanSettings("SELECT 'SET x = 1'").changes.empty());
+}
+
+TEST(SessionSettingsTest, DeltaTouchesOnlyDifferences) {
+  const SessionSettings from{{"a", "1"}, {"b", "2"}, {"c", "3"}};
+  const SessionSettings to{{"b", "2"}, {"c", "4"}, {"d", "5"}};
+  EXPECT_EQ(settingsDelta(from, to), "RESET a;SET c = 4;SET d = 5;");
+  EXPECT_EQ(settingsDelta(to, to), "");
+  EXPECT_EQ(settingsDelta({}, {}), "");
+}
+
+TEST(SessionManagerTest, SettingsFollowTheSessionAcrossSharedConnections) {
+  auto manager = SessionManager::create({.connections_per_database = 1});
+  auto first = open(*manager);
+  auto second = open(*manager);
+  const auto initial = scalar(*second, kSearchPath);
+
+  ASSERT_TRUE(first->query("CREATE SCHEMA other").ok());
+  ASSERT_TRUE(first->query("SET search_path = 'other'").ok());
+  EXPECT_EQ(first->settings().at("search_path"), "'other'");
+  EXPECT_EQ(scalar(*first, kSearchPath), "other");
+  EXPECT_EQ(scalar(*second, kSearchPath), initial);
+  EXPECT_EQ(scalar(*first, kSearchPath), "other");
+
+  ASSERT_TRUE(second->set("Search_Path", "'other'").ok());
+  EXPECT_EQ(scalar(*second, kSearchPath), "other");
+  first->reset("search_path");
+  EXPECT_EQ(scalar(*first, kSearchPath), initial);
+
+  const auto stats = manager->stats();
+  ASSERT_TRUE(stats.has_value());
+  EXPECT_EQ(stats->open, 1U);
+  EXPECT_GT(stats->setting_changes, 0U);
+}
+
+TEST(SessionManagerTest, ReusesTheConnectionThatHasTheSessionsSettings) {
+  auto manager = SessionManager::create({.connections_per_database = 2});
+  auto session = open(*manager);
+  ASSERT_TRUE(session->query("SET search_path = 'main'").ok());
+  const auto before = manager->stats()->setting_changes;
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(scalar(*session, kSearchPath), "main");
+  }
+  EXPECT_EQ(manager->stats()->setting_changes, before);
+}
+
+TEST(SessionManagerTest, FailedSetLeavesSessionSettingsAlone) {
+  auto manager = SessionManager::create({.connections_per_database = 1});
+  auto session = open(*manager);
+  const auto failed = session->query("SET no_such_setting = 1");
+  ASSERT_FALSE(failed.ok());
+  EXPECT_EQ(failed.status().code(), Status::Code::kQueryExecutorError);
+  EXPECT_TRUE(session->settings().empty());
+  EXPECT_EQ(scalar(*session, "SELECT 42"), "42");
+
+  EXPECT_EQ(session->set("bad name", "1").code(), Status::Code::kInvalid);
+  EXPECT_EQ(session->set("search_path", "").code(), Status::Code::kInvalid);
+}
+
+TEST(SessionManagerTest, BadSessionSettingFailsTheCheckout) {
+  auto manager = SessionManager::create({.connections_per_database = 1});
+  auto session = open(*manager);
+  ASSERT_TRUE(session->set("no_such_setting", "1").ok());
+  const auto result = session->query("SELECT 1");
+  ASSERT_FALSE(result.ok());
+  EXPECT_EQ(result.status().code(), Status::Code::kInvalid);
+  EXPECT_EQ(manager->stats()->open, 0U);
+}
+
+TEST(SessionManagerTest, OpenTransactionIsRolledBackOnReturn) {
+  auto manager = SessionManager::create({.connections_per_database = 1});
+  auto writer = open(*manager);
+  auto reader = open(*manager);
+  ASSERT_TRUE(writer->query("CREATE TABLE t (x INTEGER)").ok());
+  {
+    auto lease = writer->checkout();
+    ASSERT_TRUE(lease.ok()) << lease.status().toString();
+    ASSERT_TRUE(writer->query(*lease, "BEGIN TRANSACTION").ok());
+    ASSERT_TRUE(writer->query(*lease, "INSERT INTO t VALUES (1)").ok());
+  }
+  EXPECT_EQ(scalar(*reader, "SELECT count(*) FROM t"), "0");
+  EXPECT_EQ(manager->stats()->open, 1U);
+}
+
+TEST(SessionManagerTest, OpaqueStatementRetiresTheConnection) {
+  auto manager = SessionManager::create({.connections_per_database = 1});
+  auto session = open(*manager);
+  ASSERT_TRUE(session->query("SET VARIABLE answer = 42").ok());
+  EXPECT_EQ(manager->stats()->open, 0U);
+  auto other = open(*manager);
+  EXPECT_EQ(scalar(*other, "SELECT getvariable('answer')"), "NULL");
+}
+
+TEST(SessionManagerTest, TemporaryTablesStayWithTheirSession) {
+  auto manager = SessionManager::create({.connections_per_database = 1});
+  auto creator = open(*manager);
+  auto other = open(*manager);
+  constexpr const char* kScratchTables =
+      "SELECT count(*) FROM duckdb_tables() WHERE table_name = 'scratch'";
+  {
+    auto lease = creator->checkout();
+    ASSERT_TRUE(lease.ok()) << lease.status().toString();
+    ASSERT_TRUE(creator
+                    ->query(*lease,
+                            "CREATE TEMP TABLE scratch AS SELECT 1 AS x")
+                    .ok());
+    auto rows = creator->query(*lease, "SELECT count(*) FROM scratch");
+    ASSERT_TRUE(rows.ok()) << rows.status().toString();
+    EXPECT_EQ((*rows)->GetValue(0, 0).ToString(), "1");
+  }
+  EXPECT_EQ(scalar(*other, kScratchTables), "0");
+
+  ASSERT_TRUE(creator->query("PREPARE answer AS SELECT 42").ok());
+  EXPECT_FALSE(other->query("EXECUTE answer").ok());
+  EXPECT_EQ(manager->stats()->open, 1U);
+}
+
+TEST(SessionManagerTest, CheckoutTimesOutWhenEveryConnectionIsLeased) {
+  auto manager = SessionManager::create(
+      {.connections_per_database = 1,
+       .checkout_timeout = std::chrono::milliseconds(50)});
+  auto holder = open(*manager);
+  auto waiter = open(*manager);
+  auto lease = holder->checkout();
+  ASSERT_TRUE(lease.ok());
+  const auto result = waiter->query("SELECT 1");
+  ASSERT_FALSE(result.ok());
+  EXPECT_EQ(result.status().code(), Status::Code::kQueryExecutorError);
+  EXPECT_EQ(manager->stats()->waits, 1U);
+}
+
+TEST(SessionManagerTest, ThousandsOfSessionsShareFewConnections) {
+  constexpr std::size_t kConnections = 4;
+  constexpr int kSessions = 2000;
+  constexpr int kThreads = 16;
+  auto manager =
+      SessionManager::create({.connections_per_database = kConnections});
+  std::vector<std::unique_ptr<Session>> sessions;
+  for (int i = 0; i < kSessions; ++i) {
+    sessions.push_back(open(*manager));
+    if (i % 2 == 0) {
+      ASSERT_TRUE(sessions.back()->set("search_path", "'main'").ok());
+    }
+  }
+  std::atomic<int> next{0};
+  std::atomic<int> failures{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&] {
+      for (int i = next++; i < kSessions; i = next++) {
+        auto result = sessions[i]->query("SELECT " + std::to_string(i));
+        if (!result.ok() ||
+            (*result)->GetValue(0, 0).GetValue<std::int32_t>() != i) {
+          ++failures;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(failures.load(), 0);
+  const auto stats = manager->stats();
+  EXPECT_LE(stats->open, kConnections);
+  EXPECT_EQ(stats->checkouts, static_cast<std::uint64_t>(kSessions));
+}
+
+TEST(SessionManagerTest, SessionsOnAFileShareOneDatabase) {
+  const auto path = std::filesystem::temp_directory_path() /
+                    ("halo_session_" + std::to_string(::getpid()) + ".db");
+  {
+    auto manager = SessionManager::create();
+    auto writer = open(*manager, path.string());
+    auto reader = open(*manager, path.string());
+    ASSERT_TRUE(writer->query("CREATE TABLE t AS SELECT 7 AS x").ok());
+    EXPECT_EQ(scalar(*reader, "SELECT x FROM t"), "7");
+    EXPECT_TRUE(manager->stats(path.string()).has_value());
+    EXPECT_FALSE(manager->stats("elsewhere.db").has_value());
+  }
+  std::filesystem::remove(path);
+  std::filesystem::remove(path.string() + ".wal");
+}
+
+TEST(SessionQueryEngineTest, StreamsDuckDbResultsAsVeloxVectors) {
+  auto engine = SessionQueryEngine::create(SessionManager::create());
+  ASSERT_TRUE(engine.ok()) << engine.status().toString();
+  const std::string query =
+      "SELECT i AS id, 'row ' || i AS name, i * 0.5 AS half"
+      " FROM range(5000) t(i)";
+
+  auto type = (*engine)->describe(query);
+  ASSERT_TRUE(type.ok()) << type.status().toString();
+  EXPECT_EQ((*type)->names(),
+            (std::vector<std::string>{"id", "name", "half"}));
+  EXPECT_EQ((*type)->childAt(0)->kind(), velox::TypeKind::BIGINT);
+  EXPECT_EQ((*type)->childAt(1)->kind(), velox::TypeKind::VARCHAR);
+
+  auto pool = velox::memory::memoryManager()->addLeafPool("session_engine");
+  std::int64_t rows = 0;
+  int batches = 0;
+  const auto status = (*engine)->execute(
+      query, pool.get(), [&](velox::RowVectorPtr batch) {
+        ++batches;
+        auto* ids = batch->childAt(0)->asFlatVector<std::int64_t>();
+        auto* names = batch->childAt(1)->asFlatVector<velox::StringView>();
+        for (velox::vector_size_t i = 0; i < batch->size(); ++i, ++rows) {
+          EXPECT_EQ(ids->valueAt(i), rows);
+          EXPECT_EQ(names->valueAt(i).str(), "row " + std::to_string(rows));
+        }
+        return Status::OK();
+      });
+  ASSERT_TRUE(status.ok()) << status.toString();
+  EXPECT_EQ(rows, 5000);
+  // DuckDB hands out chunks of 2048 rows.
+  EXPECT_GT(batches, 1);
+}
+
+TEST(SessionQueryEngineTest, ReportsErrorsAndStopsOnSinkStatus) {
+  auto engine = SessionQueryEngine::create(SessionManager::create());
+  ASSERT_TRUE(engine.ok()) << engine.status().toString();
+  auto pool = velox::memory::memoryManager()->addLeafPool("session_engine");
+  EXPECT_EQ((*engine)->describe("SELECT * FROM missing").status().code(),
+            Status::Code::kQueryExecutorError);
+  EXPECT_FALSE(
+      (*engine)->execute("SELECT * FROM missing", pool.get(), {}).ok());
+
+  int batches = 0;
+  const auto status = (*engine)->execute(
+      "SELECT * FROM range(10000)", pool.get(), [&](velox::RowVectorPtr) {
+        ++batches;
+        return Status::StorageError("client went away");
+      });
+  EXPECT_EQ(status.message(), "client went away");
+  EXPECT_EQ(batches, 1);
+  EXPECT_FALSE(SessionQueryEngine::create(nullptr).ok());
+}
+
+}  // namespace halo::server::session
@@ -0,0 +1,144 @@
+// Scan throughput of IoUringReadFile against LocalReadFile at queue depths
+// 1-64. Each scan step reads `depth' random 128 KiB column-chunk ranges; the
+// io_uring file issues them as one batch from a single thread, the pread file
+// from `depth' threads (the best the synchronous path can do at equal
+// concurrency) and from a single driver thread (today's scan path).
+//
+// Point HALO_BENCH_FILE at a large file on the NVMe device under test and
+// drop the page cache first for device numbers; otherwise a cached temporary
+// file is used and the comparison reflects per-read submission overhead.
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+import halo.common;
+import halo.storage.file;
+
+namespace halo::storage::file {
+
+namespace {
+
+constexpr std::uint64_t kRangeBytes = 128 * 1024;
+constexpr std::uint64_t kTempFileBytes = 256ULL * 1024 * 1024;
+constexpr std::uint64_t kBytesPerRun = 512ULL * 1024 * 1024;
+
+std::vector<ReadRange> randomRanges(std::uint64_t file_size, std::size_t n,
+                                    std::mt19937_64& rng) {
+  std::vector<ReadRange> ranges(n);
+  const std::uint64_t slots = file_size / kRangeBytes;
+  for (auto& range : ranges) {
+    range = {.offset = (rng() % slots) * kRangeBytes, .length = kRangeBytes};
+  }
+  return ranges;
+}
+
+// Returns MB/s reading kBytesPerRun in batches of `depth' ranges.
+double batchedThroughput(const ReadFile& file, std::size_t depth) {
+  std::mt19937_64 rng(depth);
+  std::vector<std::string> storage(depth, std::string(kRangeBytes, '\0'));
+  std::vector<char*> buffers;
+  for (auto& buffer : storage) {
+    buffers.push_back(buffer.data());
+  }
+  const std::size_t steps = kBytesPerRun / (kRangeBytes * depth);
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t step = 0; step < steps; ++step) {
+    const auto ranges = randomRanges(file.size(), depth, rng);
+    auto status = file.preadv(ranges, buffers);
+    EXPECT_TRUE(status.ok()) << status.message();
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return static_cast<double>(steps * depth * kRangeBytes) / 1e6 /
+         elapsed.count();
+}
+
+// Returns MB/s with `threads' threads each issuing blocking preads.
+double threadedThroughput(const ReadFile& file, std::size_t threads) {
+  const std::size_t reads_per_thread = kBytesPerRun / kRangeBytes / threads;
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (std::size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      std::mt19937_64 rng(t + 1);
+      std::string buffer(kRangeBytes, '\0');
+      for (std::size_t i = 0; i < reads_per_thread; ++i) {
+        const auto range = randomRanges(file.size(), 1, rng).front();
+        auto status = file.pread(range.offset, range.length, buffer.data());
+        EXPECT_TRUE(status.ok()) << status.message();
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return static_cast<double>(threads * reads_per_thread * kRangeBytes) / 1e6 /
+         elapsed.count();
+}
+
+}  // namespace
+
+TEST(ReadFileBenchmark, IoUringVersusPreadByQueueDepth) {
+  std::filesystem::path path;
+  bool temporary = false;
+  if (const char* bench_file = std::getenv("HALO_BENCH_FILE")) {
+    path = bench_file;
+  } else {
+    path = std::filesystem::temp_directory_path() /
+           ("halo_read_file_bench_" + std::to_string(::getpid()) + ".bin");
+    temporary = true;
+    std::ofstream out(path, std::ios::binary);
+    std::string block(1 << 20, 'x');
+    for (std::uint64_t written = 0; written < kTempFileBytes;
+         written += block.size()) {
+      out.write(block.data(), static_cast<std::streamsize>(block.size()));
+    }
+  }
+
+  auto local = LocalReadFile::open(path.string());
+  ASSERT_TRUE(local.ok()) << local.status().message();
+  ASSERT_GE((*local)->size(), kRangeBytes * 64);
+
+  std::cout << "file: " << path << (temporary ? " (page cache)" : "") << '\n'
+            << std::left << std::setw(8) << "depth" << std::right
+            << std::setw(14) << "uring_MB/s" << std::setw(16)
+            << "pread_N_MB/s" << std::setw(16) << "pread_1_MB/s" << '\n';
+  const double single = threadedThroughput(**local, 1);
+  for (const std::size_t depth : {1, 2, 4, 8, 16, 32, 64}) {
+    auto uring = IoUringReadFile::open(
+        path.string(), {.queue_depth = static_cast<unsigned>(depth),
+                        .rings = 1,
+                        .coalesce_gap = 0});
+    if (!uring.ok()) {
+      if (temporary) {
+        std::filesystem::remove(path);
+      }
+      GTEST_SKIP() << uring.status().message();
+    }
+    std::cout << std::left << std::setw(8) << depth << std::right
+              << std::fixed << std::setprecision(0) << std::setw(14)
+              << batchedThroughput(**uring, depth) << std::setw(16)
+              << threadedThroughput(**local, depth) << std::setw(16) << single
+              << '\n';
+  }
+  if (temporary) {
+    std::filesystem::remove(path);
+  }
+}
+
+}  // namespace halo::storage::file
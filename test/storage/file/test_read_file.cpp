@@ -0,0 +1,246 @@
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+import halo.common;
+import halo.storage.file;
+
+namespace halo::storage::file {
+
+namespace {
+
+// Open io_uring instances of this process.
+std::size_t openRings() {
+  std::size_t rings = 0;
+  for (const auto& entry :
+       std::filesystem::directory_iterator("/proc/self/fd")) {
+    std::error_code error;
+    const auto target = std::filesystem::read_symlink(entry.path(), error);
+    if (!error && target.string().find("io_uring") != std::string::npos) {
+      ++rings;
+    }
+  }
+  return rings;
+}
+
+class ReadFileTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = std::filesystem::temp_directory_path() /
+            ("halo_read_file_" + std::to_string(::getpid()) + ".bin");
+    contents_.resize(4 * 1024 * 1024);
+    std::mt19937_64 rng(7);
+    for (auto& byte : contents_) {
+      byte = static_cast<char>(rng());
+    }
+    std::ofstream out(path_, std::ios::binary);
+    out.write(contents_.data(), static_cast<std::streamsize>(contents_.size()));
+  }
+
+  void TearDown() override { std::filesystem::remove(path_); }
+
+  std::unique_ptr<ReadFile> openIoUring(const IoUringOptions& options = {}) {
+    auto file = IoUringReadFile::open(path_.string(), options);
+    if (!file.ok()) {
+      EXPECT_EQ(file.status().code(),
+                common::base::Status::Code::kNotImplemented)
+          << file.status().message();
+      return nullptr;
+    }
+    return std::move(file).value();
+  }
+
+  void expectRanges(const ReadFile& file,
+                    const std::vector<ReadRange>& ranges) {
+    std::vector<std::string> outputs;
+    std::vector<char*> buffers;
+    for (const auto& range : ranges) {
+      outputs.emplace_back(range.length, '\0');
+    }
+    for (auto& output : outputs) {
+      buffers.push_back(output.data());
+    }
+    auto status = file.preadv(ranges, buffers);
+    ASSERT_TRUE(status.ok()) << status.message();
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+      EXPECT_EQ(outputs[i],
+                contents_.substr(ranges[i].offset, ranges[i].length))
+          << "range " << i;
+    }
+  }
+
+  std::filesystem::path path_;
+  std::string contents_;
+};
+
+}  // namespace
+
+TEST(CoalesceRangesTest, MergesNearbyRangesWithinLimit) {
+  const std::vector<ReadRange> ranges = {{.offset = 1000, .length = 100},
+                                         {.offset = 0, .length = 100},
+                                         {.offset = 150, .length = 50},
+                                         {.offset = 5000, .length = 10}};
+  const auto reads = coalesceRanges(ranges, 100, 1 << 20);
+  ASSERT_EQ(reads.size(), 3U);
+  EXPECT_EQ(reads[0].offset, 0U);
+  EXPECT_EQ(reads[0].length, 200U);
+  EXPECT_EQ(reads[0].ranges, (std::vector<std::size_t>{1, 2}));
+  EXPECT_EQ(reads[1].offset, 1000U);
+  EXPECT_EQ(reads[2].ranges, (std::vector<std::size_t>{3}));
+}
+
+TEST(CoalesceRangesTest, RespectsMaximumAndHandlesOverlap) {
+  const std::vector<ReadRange> ranges = {{.offset = 0, .length = 60},
+                                         {.offset = 50, .length = 20},
+                                         {.offset = 70, .length = 60},
+                                         {.offset = 200, .length = 0}};
+  const auto reads = coalesceRanges(ranges, 0, 100);
+  ASSERT_EQ(reads.size(), 2U);
+  EXPECT_EQ(reads[0].length, 70U);
+  EXPECT_EQ(reads[1].offset, 70U);
+  EXPECT_TRUE(coalesceRanges(ranges, 1000, 0).size() == 3U);
+}
+
+TEST_F(ReadFileTest, LocalReadFileReadsRanges) {
+  auto file = LocalReadFile::open(path_.string());
+  ASSERT_TRUE(file.ok()) << file.status().message();
+  EXPECT_EQ((*file)->size(), contents_.size());
+  expectRanges(**file, {{.offset = 0, .length = 10},
+                        {.offset = 4096, .length = 100000},
+                        {.offset = contents_.size() - 1, .length = 1}});
+}
+
+TEST_F(ReadFileTest, ReadPastEndFails) {
+  auto file = LocalReadFile::open(path_.string());
+  ASSERT_TRUE(file.ok());
+  std::string buffer(16, '\0');
+  auto status = (*file)->pread(contents_.size() - 8, 16, buffer.data());
+  EXPECT_EQ(status.code(), common::base::Status::Code::kStorageError);
+
+  auto uring = openIoUring();
+  if (uring != nullptr) {
+    status = uring->pread(contents_.size() - 8, 16, buffer.data());
+    EXPECT_EQ(status.code(), common::base::Status::Code::kStorageError);
+    // The ring is still usable after a failed batch.
+    expectRanges(*uring, {{.offset = 0, .length = 64}});
+  }
+}
+
+TEST_F(ReadFileTest, MissingFileFails) {
+  auto file = openLocalReadFile(path_.string() + ".missing");
+  EXPECT_FALSE(file.ok());
+}
+
+TEST_F(ReadFileTest, IoUringReadsCoalescedAndLargeRanges) {
+  auto file = openIoUring({.queue_depth = 8,
+                           .rings = 1,
+                           .registered_buffers = 2,
+                           .registered_buffer_bytes = 64 * 1024,
+                           .coalesce_gap = 4096});
+  if (file == nullptr) {
+    GTEST_SKIP() << "io_uring not available";
+  }
+  // Column-chunk-like layout: many small neighbouring ranges (coalesced into
+  // bounce buffers), a few large ones read in place, and more reads than the
+  // queue depth and buffer count.
+  std::vector<ReadRange> ranges;
+  std::mt19937_64 rng(11);
+  for (std::uint64_t offset = 0; offset + 70000 < contents_.size();) {
+    const std::uint64_t length = rng() % 3 == 0 ? 70000 : 1 + rng() % 3000;
+    ranges.push_back({.offset = offset, .length = length});
+    offset += length + rng() % 6000;
+  }
+  ASSERT_GT(ranges.size(), 100U);
+  std::shuffle(ranges.begin(), ranges.end(), rng);
+  expectRanges(*file, ranges);
+  expectRanges(*file, {{.offset = 0, .length = contents_.size()}});
+}
+
+TEST_F(ReadFileTest, IoUringConcurrentCallersShareRings) {
+  auto file = openIoUring({.rings = 2});
+  if (file == nullptr) {
+    GTEST_SKIP() << "io_uring not available";
+  }
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 6; ++t) {
+    threads.emplace_back([&, t] {
+      std::vector<ReadRange> ranges;
+      for (int i = 0; i < 64; ++i) {
+        ranges.push_back({.offset = static_cast<std::uint64_t>(
+                              (t * 64 + i) * 8192 % (contents_.size() - 4096)),
+                          .length = 4096});
+      }
+      expectRanges(*file, ranges);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+TEST_F(ReadFileTest, IoUringFilesShareProcessRings) {
+  // A ring shape no other test uses, so its pool starts empty.
+  const IoUringOptions options{.queue_depth = 4, .rings = 2};
+  const auto before = openRings();
+  std::vector<std::unique_ptr<ReadFile>> files;
+  for (int i = 0; i < 8; ++i) {
+    files.push_back(openIoUring(options));
+    if (files.back() == nullptr) {
+      GTEST_SKIP() << "io_uring not available";
+    }
+  }
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    threads.emplace_back([&, i] {
+      expectRanges(*files[i], {{.offset = i * 4096, .length = 4096},
+                               {.offset = i * 65536, .length = 100}});
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_LE(openRings() - before, 2U);
+}
+
+TEST_F(ReadFileTest, MappedReadFileViewsAndCopies) {
+  auto file = MappedReadFile::open(path_.string());
+  ASSERT_TRUE(file.ok()) << file.status().message();
+  expectRanges(**file, {{.offset = 7, .length = 70000},
+                        {.offset = contents_.size() - 3, .length = 3}});
+  auto view = (*file)->view(4096, 128);
+  ASSERT_TRUE(view.ok());
+  EXPECT_EQ(std::string(view->data(), view->size()),
+            contents_.substr(4096, 128));
+  (*file)->dontNeed(0, contents_.size());
+  EXPECT_EQ(std::string(view->data(), view->size()),
+            contents_.substr(4096, 128));
+  EXPECT_FALSE((*file)->view(contents_.size() - 1, 2).ok());
+}
+
+TEST_F(ReadFileTest, AsyncReadCompletesOnExecutor) {
+  auto file = openLocalReadFile(path_.string());
+  ASSERT_TRUE(file.ok()) << file.status().message();
+  folly::CPUThreadPoolExecutor executor(2);
+  std::string first(1000, '\0');
+  std::string second(5000, '\0');
+  auto future = (*file)->preadvAsync(
+      {{.offset = 100, .length = 1000}, {.offset = 2'000'000, .length = 5000}},
+      {first.data(), second.data()}, &executor);
+  auto status = std::move(future).get();
+  ASSERT_TRUE(status.ok()) << status.message();
+  EXPECT_EQ(first, contents_.substr(100, 1000));
+  EXPECT_EQ(second, contents_.substr(2'000'000, 5000));
+}
+
+}  // namespace halo::storage::file
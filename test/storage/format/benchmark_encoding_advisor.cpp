@@ -0,0 +1,717 @@
+// Reports, per synthetic column shape, the encoding the advisor picks against
+// the writer's static default (dictionary, falling back to plain). Every
+// candidate is actually encoded over the whole column and compressed with
+// zstd in 1 MiB pages, so the table shows measured bytes next to the
+// advisor's estimates, plus the advisor's own overhead. A size-only advisor
+// must land within 10% of the smallest measured encoding.
+//
+// Each candidate is also decompressed and decoded back to values, best of
+// `kDecodeRuns', and listed under its column with its decode and scan
+// (decompress plus decode) speeds in plain megabytes per second. Its measured
+// cost is one plus the decode time it adds over PLAIN, in PLAIN scans of the
+// column: size already counts for the bytes decompressed, so the cost is
+// only the decoder's work. The advisor's `decodeCost' is calibrated from
+// these and printed next to them. The default-weighted pick closes each
+// column.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+import halo.common;
+import halo.storage.format;
+
+namespace halo::storage::format {
+
+namespace {
+
+constexpr std::size_t kRows = 1 << 20;
+constexpr std::size_t kPageBytes = 1 << 20;
+// Measured bytes of the size-only pick, over the smallest measured.
+constexpr double kPickTolerance = 1.10;
+constexpr std::size_t kMaxDictionaryBytes = 1024 * 1024;
+constexpr int kDecodeRuns = 5;
+
+using Bytes = std::vector<std::uint8_t>;
+
+void appendVarint(Bytes& out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<std::uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<std::uint8_t>(value));
+}
+
+std::uint64_t zigzag(std::int64_t value) {
+  return (static_cast<std::uint64_t>(value) << 1) ^
+         static_cast<std::uint64_t>(value >> 63);
+}
+
+// Packs `values' LSB first at `width' bits each.
+void appendPacked(Bytes& out, std::span<const std::uint64_t> values,
+                  int width) {
+  std::uint64_t buffer = 0;
+  int bits = 0;
+  for (const auto value : values) {
+    for (int bit = 0; bit < width; ++bit) {
+      buffer |= ((value >> bit) & 1) << bits;
+      if (++bits == 8) {
+        out.push_back(static_cast<std::uint8_t>(buffer));
+        buffer = 0;
+        bits = 0;
+      }
+    }
+  }
+  if (bits > 0) {
+    out.push_back(static_cast<std::uint8_t>(buffer));
+  }
+}
+
+Bytes deltaBinaryPacked(std::span<const std::int64_t> values) {
+  constexpr std::size_t kBlock = 128;
+  constexpr std::size_t kMiniblock = 32;
+  Bytes out;
+  appendVarint(out, kBlock);
+  appendVarint(out, kBlock / kMiniblock);
+  appendVarint(out, values.size());
+  appendVarint(out, values.empty() ? 0 : zigzag(values[0]));
+  for (std::size_t start = 1; start < values.size(); start += kBlock) {
+    const auto end = std::min(values.size(), start + kBlock);
+    std::vector<std::int64_t> deltas;
+    for (auto i = start; i < end; ++i) {
+      deltas.push_back(static_cast<std::int64_t>(
+          static_cast<std::uint64_t>(values[i]) -
+          static_cast<std::uint64_t>(values[i - 1])));
+    }
+    const auto min_delta = *std::ranges::min_element(deltas);
+    appendVarint(out, zigzag(min_delta));
+    std::vector<std::uint64_t> offsets;
+    for (const auto delta : deltas) {
+      offsets.push_back(static_cast<std::uint64_t>(delta) -
+                        static_cast<std::uint64_t>(min_delta));
+    }
+    offsets.resize((offsets.size() + kMiniblock - 1) / kMiniblock *
+                   kMiniblock);
+    const auto widths_at = out.size();
+    out.resize(out.size() + kBlock / kMiniblock);
+    for (std::size_t mb = 0; mb * kMiniblock < offsets.size(); ++mb) {
+      const std::span<const std::uint64_t> miniblock(
+          offsets.data() + mb * kMiniblock, kMiniblock);
+      const auto width =
+          std::bit_width(*std::ranges::max_element(miniblock));
+      out[widths_at + mb] = static_cast<std::uint8_t>(width);
+      appendPacked(out, miniblock, static_cast<int>(width));
+    }
+  }
+  return out;
+}
+
+// RLE/bit-packed hybrid of dictionary indices: runs of 8 or more as RLE,
+// the rest bit-packed in groups of 8.
+Bytes rleDictionaryIndices(const std::vector<std::uint64_t>& indices,
+                           int width) {
+  Bytes out{static_cast<std::uint8_t>(width)};
+  std::vector<std::uint64_t> literals;
+  const auto flush = [&] {
+    if (literals.empty()) {
+      return;
+    }
+    literals.resize((literals.size() + 7) / 8 * 8);
+    appendVarint(out, (literals.size() / 8) << 1 | 1);
+    appendPacked(out, literals, width);
+    literals.clear();
+  };
+  for (std::size_t i = 0; i < indices.size();) {
+    auto j = i;
+    while (j < indices.size() && indices[j] == indices[i]) {
+      ++j;
+    }
+    if (j - i >= 8) {
+      // Literal groups borrow from the run to fill up to a multiple of 8.
+      while (literals.size() % 8 != 0 && i < j) {
+        literals.push_back(indices[i++]);
+      }
+      flush();
+      if (i < j) {
+        appendVarint(out, (j - i) << 1);
+        for (int byte = 0; byte < (width + 7) / 8; ++byte) {
+          out.push_back(static_cast<std::uint8_t>(indices[i] >> (8 * byte)));
+        }
+      }
+    } else {
+      literals.insert(literals.end(), indices.begin() + i,
+                      indices.begin() + j);
+    }
+    i = j;
+  }
+  flush();
+  return out;
+}
+
+template <typename T>
+void appendPlain(Bytes& out, const T& value) {
+  if constexpr (std::is_same_v<T, std::string_view>) {
+    const auto size = static_cast<std::uint32_t>(value.size());
+    const auto* length = reinterpret_cast<const std::uint8_t*>(&size);
+    out.insert(out.end(), length, length + sizeof(size));
+    out.insert(out.end(), value.begin(), value.end());
+  } else {
+    const auto* raw = reinterpret_cast<const std::uint8_t*>(&value);
+    out.insert(out.end(), raw, raw + sizeof(T));
+  }
+}
+
+constexpr CodecCandidate kPageCodec{.codec = Codec::kZstd, .level = 1};
+
+std::vector<std::string> compressPages(const Bytes& bytes) {
+  std::vector<std::string> pages;
+  for (std::size_t begin = 0; begin < bytes.size(); begin += kPageBytes) {
+    const auto size = std::min(kPageBytes, bytes.size() - begin);
+    auto compressed = compressBuffer(
+        kPageCodec,
+        std::span<const char>(
+            reinterpret_cast<const char*>(bytes.data()) + begin, size));
+    EXPECT_TRUE(compressed.ok());
+    pages.push_back(std::move(compressed).value());
+  }
+  return pages;
+}
+
+// Decompresses `pages' into `out', sized to hold them.
+void decompressPages(const std::vector<std::string>& pages, Bytes& out) {
+  std::size_t begin = 0;
+  for (const auto& page : pages) {
+    const auto size = std::min(kPageBytes, out.size() - begin);
+    auto status = decompressBuffer(
+        kPageCodec, page,
+        std::span<char>(reinterpret_cast<char*>(out.data()) + begin, size));
+    EXPECT_TRUE(status.ok());
+    begin += size;
+  }
+}
+
+// A column in one encoding: the dictionary page, if any, and the values.
+struct Encoded {
+  Encoding encoding = Encoding::kPlain;
+  Bytes dictionary;
+  Bytes data;
+};
+
+// `values' in `encoding'. A dictionary that overflows the writer's limit
+// falls back to plain, as the writer does.
+template <typename T>
+Encoded encode(const std::vector<T>& values, Encoding encoding) {
+  Encoded encoded{.encoding = encoding};
+  switch (encoding) {
+    case Encoding::kPlain:
+      for (const auto& value : values) {
+        appendPlain(encoded.data, value);
+      }
+      return encoded;
+    case Encoding::kRleDictionary: {
+      std::unordered_map<T, std::uint64_t> ids;
+      std::vector<std::uint64_t> indices;
+      indices.reserve(values.size());
+      for (const auto& value : values) {
+        const auto [it, inserted] = ids.try_emplace(value, ids.size());
+        if (inserted) {
+          appendPlain(encoded.dictionary, value);
+        }
+        indices.push_back(it->second);
+      }
+      if (encoded.dictionary.size() > kMaxDictionaryBytes) {
+        return encode(values, Encoding::kPlain);
+      }
+      const auto width = static_cast<int>(std::max<std::size_t>(
+          1, std::bit_width(ids.size() - 1)));
+      encoded.data = rleDictionaryIndices(indices, width);
+      return encoded;
+    }
+    case Encoding::kByteStreamSplit: {
+      const auto plain = encode(values, Encoding::kPlain).data;
+      encoded.data.resize(plain.size());
+      for (std::size_t i = 0; i < values.size(); ++i) {
+        for (std::size_t byte = 0; byte < sizeof(T); ++byte) {
+          encoded.data[byte * values.size() + i] =
+              plain[i * sizeof(T) + byte];
+        }
+      }
+      return encoded;
+    }
+    case Encoding::kDeltaBinaryPacked:
+      if constexpr (std::is_integral_v<T>) {
+        std::vector<std::int64_t> widened(values.begin(), values.end());
+        encoded.data = deltaBinaryPacked(widened);
+        return encoded;
+      }
+      break;
+    case Encoding::kDeltaLengthByteArray:
+    case Encoding::kDeltaByteArray:
+      if constexpr (std::is_same_v<T, std::string_view>) {
+        std::vector<std::int64_t> prefixes;
+        std::vector<std::int64_t> suffixes;
+        Bytes data;
+        for (std::size_t i = 0; i < values.size(); ++i) {
+          std::size_t prefix = 0;
+          if (encoding == Encoding::kDeltaByteArray && i > 0) {
+            const auto previous = values[i - 1];
+            const auto limit = std::min(values[i].size(), previous.size());
+            while (prefix < limit && values[i][prefix] == previous[prefix]) {
+              ++prefix;
+            }
+          }
+          prefixes.push_back(static_cast<std::int64_t>(prefix));
+          suffixes.push_back(
+              static_cast<std::int64_t>(values[i].size() - prefix));
+          data.insert(data.end(), values[i].begin() + prefix, values[i].end());
+        }
+        encoded.data = deltaBinaryPacked(suffixes);
+        if (encoding == Encoding::kDeltaByteArray) {
+          const auto lengths = deltaBinaryPacked(prefixes);
+          encoded.data.insert(encoded.data.begin(), lengths.begin(),
+                              lengths.end());
+        }
+        encoded.data.insert(encoded.data.end(), data.begin(), data.end());
+        return encoded;
+      }
+      break;
+  }
+  ADD_FAILURE() << "no encoder for " << encodingName(encoding);
+  return encoded;
+}
+
+// `encoded' as it is stored: its pages after compression.
+struct Stored {
+  std::vector<std::string> dictionary;
+  std::vector<std::string> data;
+
+  [[nodiscard]] std::size_t bytes() const {
+    std::size_t total = 0;
+    for (const auto* pages : {&dictionary, &data}) {
+      for (const auto& page : *pages) {
+        total += page.size();
+      }
+    }
+    return total;
+  }
+};
+
+Stored store(const Encoded& encoded) {
+  return {compressPages(encoded.dictionary), compressPages(encoded.data)};
+}
+
+std::uint64_t readVarint(const std::uint8_t*& in) {
+  std::uint64_t value = 0;
+  for (int shift = 0;; shift += 7) {
+    const auto byte = *in++;
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      return value;
+    }
+  }
+}
+
+std::int64_t unzigzag(std::uint64_t value) {
+  return static_cast<std::int64_t>(value >> 1) ^
+         -static_cast<std::int64_t>(value & 1);
+}
+
+// Unpacks `count' values of `width' bits, LSB first, a word at a time. The
+// input must be readable 16 bytes past the packed bits.
+void unpack(const std::uint8_t* in, int width, std::size_t count,
+            std::uint64_t* out) {
+  const auto mask = width == 64 ? ~std::uint64_t{0}
+                                : (std::uint64_t{1} << width) - 1;
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto bit = i * static_cast<std::size_t>(width);
+    const auto shift = static_cast<int>(bit % 8);
+    std::uint64_t word;
+    std::memcpy(&word, in + bit / 8, sizeof(word));
+    auto value = word >> shift;
+    if (shift + width > 64) {
+      value |= static_cast<std::uint64_t>(in[bit / 8 + 8]) << (64 - shift);
+    }
+    out[i] = value & mask;
+  }
+}
+
+// Decodes what deltaBinaryPacked wrote, returning the end of its input.
+const std::uint8_t* decodeDeltaBinaryPacked(const std::uint8_t* in,
+                                            std::vector<std::int64_t>& out) {
+  const auto block = readVarint(in);
+  const auto miniblocks = readVarint(in);
+  const auto count = readVarint(in);
+  const auto first = unzigzag(readVarint(in));
+  const auto miniblock = block / miniblocks;
+  out.resize(count);
+  if (count == 0) {
+    return in;
+  }
+  out[0] = first;
+  std::vector<std::uint64_t> offsets(miniblock);
+  for (std::size_t i = 1; i < count;) {
+    const auto min_delta =
+        static_cast<std::uint64_t>(unzigzag(readVarint(in)));
+    const auto* widths = in;
+    in += miniblocks;
+    for (std::size_t mb = 0; mb < miniblocks && i < count; ++mb) {
+      unpack(in, widths[mb], miniblock, offsets.data());
+      in += miniblock * widths[mb] / 8;
+      for (std::size_t j = 0; j < miniblock && i < count; ++j, ++i) {
+        out[i] = static_cast<std::int64_t>(
+            static_cast<std::uint64_t>(out[i - 1]) + min_delta + offsets[j]);
+      }
+    }
+  }
+  return in;
+}
+
+// Decodes what rleDictionaryIndices wrote.
+void decodeRleIndices(const std::uint8_t* in, std::size_t count,
+                      std::vector<std::uint64_t>& out) {
+  const int width = *in++;
+  // Bit-packed groups round up to 8 values.
+  out.resize(count + 8);
+  for (std::size_t i = 0; i < count;) {
+    const auto header = readVarint(in);
+    if (header & 1) {
+      const auto values = (header >> 1) * 8;
+      unpack(in, width, values, out.data() + i);
+      in += values * static_cast<std::size_t>(width) / 8;
+      i += values;
+    } else {
+      std::uint64_t value = 0;
+      for (int byte = 0; byte < (width + 7) / 8; ++byte) {
+        value |= static_cast<std::uint64_t>(*in++) << (8 * byte);
+      }
+      std::fill_n(out.begin() + static_cast<std::ptrdiff_t>(i), header >> 1,
+                  value);
+      i += header >> 1;
+    }
+  }
+  out.resize(count);
+}
+
+template <typename T>
+void decodePlain(const std::uint8_t* in, std::size_t count,
+                 std::vector<T>& out) {
+  out.resize(count);
+  if constexpr (std::is_same_v<T, std::string_view>) {
+    for (auto& value : out) {
+      std::uint32_t length;
+      std::memcpy(&length, in, sizeof(length));
+      value = {reinterpret_cast<const char*>(in) + sizeof(length), length};
+      in += sizeof(length) + length;
+    }
+  } else {
+    std::memcpy(out.data(), in, count * sizeof(T));
+  }
+}
+
+// Strings of the byte array encodings: their lengths, then their bytes.
+void sliceStrings(const std::uint8_t* data,
+                  const std::vector<std::int64_t>& lengths,
+                  std::vector<std::string_view>& out) {
+  out.resize(lengths.size());
+  for (std::size_t i = 0; i < lengths.size(); ++i) {
+    const auto length = static_cast<std::size_t>(lengths[i]);
+    out[i] = {reinterpret_cast<const char*>(data), length};
+    data += length;
+  }
+}
+
+// Buffers a decoder reuses from page to page.
+template <typename T>
+struct DecodeScratch {
+  std::vector<T> dictionary;
+  std::vector<std::uint64_t> indices;
+  std::vector<std::int64_t> integers;
+  std::vector<std::int64_t> prefixes;
+  // DELTA_BYTE_ARRAY strings, rebuilt from their prefixes.
+  std::string arena;
+};
+
+// Decodes `rows' values of `encoded' into `out', the way a reader fills a
+// vector: strings point into the page or, for DELTA_BYTE_ARRAY, into the
+// scratch arena.
+template <typename T>
+void decode(const Encoded& encoded, std::size_t rows, std::vector<T>& out,
+            DecodeScratch<T>& scratch) {
+  const auto* data = encoded.data.data();
+  switch (encoded.encoding) {
+    case Encoding::kPlain:
+      decodePlain(data, rows, out);
+      return;
+    case Encoding::kRleDictionary: {
+      auto& dictionary = scratch.dictionary;
+      auto& indices = scratch.indices;
+      std::size_t entries = 0;
+      if constexpr (std::is_same_v<T, std::string_view>) {
+        for (const auto* in = encoded.dictionary.data();
+             in < encoded.dictionary.data() + encoded.dictionary.size();
+             ++entries) {
+          std::uint32_t length;
+          std::memcpy(&length, in, sizeof(length));
+          in += sizeof(length) + length;
+        }
+      } else {
+        entries = encoded.dictionary.size() / sizeof(T);
+      }
+      decodePlain(encoded.dictionary.data(), entries, dictionary);
+      decodeRleIndices(data, rows, indices);
+      out.resize(rows);
+      for (std::size_t i = 0; i < rows; ++i) {
+        out[i] = dictionary[indices[i]];
+      }
+      return;
+    }
+    case Encoding::kByteStreamSplit:
+      out.resize(rows);
+      if constexpr (!std::is_same_v<T, std::string_view>) {
+        auto* bytes = reinterpret_cast<std::uint8_t*>(out.data());
+        for (std::size_t i = 0; i < rows; ++i) {
+          for (std::size_t byte = 0; byte < sizeof(T); ++byte) {
+            bytes[i * sizeof(T) + byte] = data[byte * rows + i];
+          }
+        }
+      }
+      return;
+    case Encoding::kDeltaBinaryPacked:
+      if constexpr (std::is_integral_v<T>) {
+        decodeDeltaBinaryPacked(data, scratch.integers);
+        out.assign(scratch.integers.begin(), scratch.integers.end());
+      }
+      return;
+    case Encoding::kDeltaLengthByteArray:
+      if constexpr (std::is_same_v<T, std::string_view>) {
+        sliceStrings(decodeDeltaBinaryPacked(data, scratch.integers),
+                     scratch.integers, out);
+      }
+      return;
+    case Encoding::kDeltaByteArray:
+      if constexpr (std::is_same_v<T, std::string_view>) {
+        const auto& prefixes = scratch.prefixes;
+        const auto& suffixes = scratch.integers;
+        auto& arena = scratch.arena;
+        const auto* suffix_data = decodeDeltaBinaryPacked(
+            decodeDeltaBinaryPacked(data, scratch.prefixes),
+            scratch.integers);
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < rows; ++i) {
+          total += static_cast<std::size_t>(prefixes[i] + suffixes[i]);
+        }
+        arena.clear();
+        arena.reserve(total);
+        out.resize(rows);
+        std::size_t previous = 0;
+        for (std::size_t i = 0; i < rows; ++i) {
+          const auto start = arena.size();
+          arena.append(arena, previous, static_cast<std::size_t>(prefixes[i]));
+          arena.append(reinterpret_cast<const char*>(suffix_data),
+                       static_cast<std::size_t>(suffixes[i]));
+          suffix_data += suffixes[i];
+          previous = start;
+        }
+        for (std::size_t i = 0, offset = 0; i < rows; ++i) {
+          const auto length =
+              static_cast<std::size_t>(prefixes[i] + suffixes[i]);
+          out[i] = std::string_view(arena).substr(offset, length);
+          offset += length;
+        }
+      }
+      return;
+  }
+}
+
+struct ScanTime {
+  double decompress = HUGE_VAL;
+  double decode = HUGE_VAL;
+
+  [[nodiscard]] double total() const { return decompress + decode; }
+};
+
+// Best times, over `kDecodeRuns', to decompress the pages of `stored' and
+// decode them back into `values', which the result is checked against.
+template <typename T>
+ScanTime scanSeconds(const std::vector<T>& values, const Encoded& encoded,
+                     const Stored& stored) {
+  const auto seconds = [](auto start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  };
+  Encoded pages{.encoding = encoded.encoding,
+                .dictionary = Bytes(encoded.dictionary.size()),
+                .data = Bytes(encoded.data.size())};
+  std::vector<T> out;
+  DecodeScratch<T> scratch;
+  ScanTime best;
+  for (int run = 0; run < kDecodeRuns; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    decompressPages(stored.dictionary, pages.dictionary);
+    decompressPages(stored.data, pages.data);
+    best.decompress = std::min(best.decompress, seconds(start));
+    // Room for unpack() to read whole words past the last packed value.
+    pages.data.resize(encoded.data.size() + 16);
+    start = std::chrono::steady_clock::now();
+    decode(pages, values.size(), out, scratch);
+    best.decode = std::min(best.decode, seconds(start));
+    pages.data.resize(encoded.data.size());
+  }
+  EXPECT_TRUE(out == values) << encodingName(encoded.encoding);
+  return best;
+}
+
+template <typename T>
+std::size_t plainBytes(const std::vector<T>& values) {
+  if constexpr (std::is_same_v<T, std::string_view>) {
+    std::size_t bytes = 0;
+    for (const auto value : values) {
+      bytes += sizeof(std::uint32_t) + value.size();
+    }
+    return bytes;
+  } else {
+    return values.size() * sizeof(T);
+  }
+}
+
+template <typename T>
+void report(const std::string& name, const std::vector<T>& values) {
+  auto sized = EncodingAdvisor::create({.decode_weight = 0.0});
+  auto weighted = EncodingAdvisor::create({});
+  auto defaulted =
+      EncodingAdvisor::create({.mode = EncodingSelectionMode::kDefault});
+  ASSERT_TRUE(sized.ok());
+  ASSERT_TRUE(weighted.ok());
+  ASSERT_TRUE(defaulted.ok());
+  const auto start = std::chrono::steady_clock::now();
+  const auto choice = sized->choose(std::span<const T>(values));
+  const auto elapsed = std::chrono::duration<double, std::micro>(
+      std::chrono::steady_clock::now() - start);
+  const auto balanced = weighted->choose(std::span<const T>(values));
+  const auto baseline = defaulted->choose(std::span<const T>(values));
+
+  struct Measured {
+    EncodingEstimate estimate;
+    std::size_t bytes;
+    ScanTime time;
+  };
+  std::vector<Measured> measured;
+  std::size_t smallest = SIZE_MAX;
+  std::size_t picked = 0;
+  ScanTime plain;
+  for (const auto& candidate : choice.candidates) {
+    const auto encoded = encode(values, candidate.encoding);
+    const auto stored = store(encoded);
+    measured.push_back(
+        {candidate, stored.bytes(), scanSeconds(values, encoded, stored)});
+    smallest = std::min(smallest, measured.back().bytes);
+    if (candidate.encoding == choice.encoding) {
+      picked = measured.back().bytes;
+    }
+    if (candidate.encoding == Encoding::kPlain) {
+      plain = measured.back().time;
+    }
+  }
+  const auto base = store(encode(values, baseline.encoding)).bytes();
+
+  std::cout << std::left << std::setw(16) << name << std::setw(26)
+            << encodingName(choice.encoding) << std::right << std::setw(12)
+            << choice.estimated_bytes << std::setw(12) << picked
+            << std::setw(12) << smallest << std::setw(12) << base
+            << std::setw(12) << std::fixed << std::setprecision(0)
+            << elapsed.count() << '\n';
+  const auto megabytes = static_cast<double>(plainBytes(values)) / 1e6;
+  for (const auto& [estimate, bytes, time] : measured) {
+    std::cout << "  " << std::left << std::setw(28)
+              << encodingName(estimate.encoding) << std::right
+              << std::setw(12) << bytes << std::setw(12)
+              << std::setprecision(0) << megabytes / time.decode
+              << std::setw(12) << megabytes / time.total() << std::setw(12)
+              << std::setprecision(2)
+              << 1.0 + (time.decode - plain.decode) / plain.total()
+              << std::setw(12) << estimate.decode_cost << '\n';
+  }
+  std::cout << "  weighted pick: " << encodingName(balanced.encoding)
+            << '\n';
+  EXPECT_LE(static_cast<double>(picked),
+            kPickTolerance * static_cast<double>(smallest))
+      << name;
+  EXPECT_LE(static_cast<double>(picked),
+            kPickTolerance * static_cast<double>(base))
+      << name;
+}
+
+}  // namespace
+
+TEST(EncodingAdvisorBenchmark, MeasuredBytesAndDecodeSpeed) {
+  std::cout << std::left << std::setw(16) << "column" << std::setw(26)
+            << "chosen" << std::right << std::setw(12) << "estimated"
+            << std::setw(12) << "measured" << std::setw(12) << "smallest"
+            << std::setw(12) << "default" << std::setw(12) << "advise_us"
+            << '\n'
+            << "  " << std::left << std::setw(28) << "candidate" << std::right
+            << std::setw(12) << "measured" << std::setw(12) << "decode_MBps"
+            << std::setw(12) << "scan_MBps" << std::setw(12) << "cost"
+            << std::setw(12) << "model"
+            << '\n';
+
+  std::mt19937_64 rng(42);
+  std::vector<std::int64_t> sorted_ids(kRows);
+  for (std::size_t i = 0; i < kRows; ++i) {
+    sorted_ids[i] = static_cast<std::int64_t>(i * 3 + rng() % 3);
+  }
+  report("sorted_bigint", sorted_ids);
+
+  std::vector<std::int64_t> random_ids(kRows);
+  for (auto& id : random_ids) {
+    id = static_cast<std::int64_t>(rng());
+  }
+  report("random_bigint", random_ids);
+
+  std::vector<std::int32_t> status_codes(kRows);
+  for (auto& code : status_codes) {
+    code = 200 + static_cast<std::int32_t>(rng() % 8) * 100;
+  }
+  report("low_card_int", status_codes);
+
+  std::vector<double> sensor(kRows);
+  for (std::size_t i = 0; i < kRows; ++i) {
+    sensor[i] = 100.0 + std::sin(static_cast<double>(i) * 1e-4) * 5.0;
+  }
+  report("smooth_double", sensor);
+
+  std::vector<std::string> urls;
+  urls.reserve(kRows);
+  for (std::size_t i = 0; i < kRows; ++i) {
+    urls.push_back("https://halo.example/events/" + std::to_string(i / 16) +
+                   "/" + std::to_string(rng() % 1000));
+  }
+  std::vector<std::string_view> url_views(urls.begin(), urls.end());
+  report("url_varchar", url_views);
+
+  const std::vector<std::string_view> countries = {
+      "US", "DE", "FR", "CN", "JP", "BR", "IN", "GB",
+      "IT", "ES", "CA", "MX", "KR", "AU", "NL", "SE"};
+  std::vector<std::string_view> country_codes(kRows);
+  for (auto& code : country_codes) {
+    code = countries[rng() % countries.size()];
+  }
+  report("country_varchar", country_codes);
+}
+
+}  // namespace halo::storage::format
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+import halo.common;
+import halo.storage.format;
+
+namespace halo::storage::format {
+
+TEST(SplitBlockBloomFilterTest, OptimalNumBytesIsPowerOfTwoWithinLimits) {
+  EXPECT_EQ(SplitBlockBloomFilter::optimalNumBytes(0, 0.01),
+            SplitBlockBloomFilter::kMinimumBytes);
+  auto bytes = SplitBlockBloomFilter::optimalNumBytes(1'000'000, 0.01);
+  EXPECT_EQ(bytes & (bytes - 1), 0U);
+  EXPECT_GE(bytes, 1'000'000U);
+  EXPECT_LE(SplitBlockBloomFilter::optimalNumBytes(1ULL << 40, 1e-9),
+            SplitBlockBloomFilter::kMaximumBytes);
+}
+
+TEST(SplitBlockBloomFilterTest, CreateRejectsInvalidSize) {
+  EXPECT_FALSE(SplitBlockBloomFilter::create(16).ok());
+  EXPECT_FALSE(SplitBlockBloomFilter::create(48).ok());
+  auto filter = SplitBlockBloomFilter::create(1024);
+  ASSERT_TRUE(filter.ok());
+  EXPECT_EQ(filter->numBytes(), 1024U);
+}
+
+TEST(SplitBlockBloomFilterTest, NoFalseNegatives) {
+  auto filter = SplitBlockBloomFilter::create(
+      SplitBlockBloomFilter::optimalNumBytes(10000, 0.01));
+  ASSERT_TRUE(filter.ok());
+  for (std::int64_t i = 0; i < 10000; ++i) {
+    filter->insert(i * 7919);
+  }
+  for (std::int64_t i = 0; i < 10000; ++i) {
+    EXPECT_TRUE(filter->mightContain(i * 7919));
+  }
+}
+
+TEST(SplitBlockBloomFilterTest, FalsePositiveRateNearTarget) {
+  auto filter = SplitBlockBloomFilter::create(
+      SplitBlockBloomFilter::optimalNumBytes(10000, 0.01));
+  ASSERT_TRUE(filter.ok());
+  for (std::int64_t i = 0; i < 10000; ++i) {
+    filter->insert(i);
+  }
+  int false_positives = 0;
+  constexpr int kProbes = 100000;
+  for (std::int64_t i = 0; i < kProbes; ++i) {
+    if (filter->mightContain(i + 1'000'000'000)) {
+      ++false_positives;
+    }
+  }
+  EXPECT_LT(static_cast<double>(false_positives) / kProbes, 0.02);
+}
+
+TEST(SplitBlockBloomFilterTest, StringValues) {
+  auto filter = SplitBlockBloomFilter::create(4096);
+  ASSERT_TRUE(filter.ok());
+  std::vector<std::string> users = {"user_1", "user_42", "user_1337"};
+  for (const auto& user : users) {
+    filter->insert(std::string_view(user));
+  }
+  for (const auto& user : users) {
+    EXPECT_TRUE(filter->mightContain(std::string_view(user)));
+  }
+}
+
+TEST(SplitBlockBloomFilterTest, BitsetRoundTrip) {
+  auto filter = SplitBlockBloomFilter::create(256);
+  ASSERT_TRUE(filter.ok());
+  filter->insert(std::int64_t{12345});
+  auto bitset = filter->bitset();
+  std::vector<std::uint8_t> bytes(bitset.begin(), bitset.end());
+
+  auto restored = SplitBlockBloomFilter::fromBitset(bytes);
+  ASSERT_TRUE(restored.ok());
+  EXPECT_TRUE(restored->mightContain(std::int64_t{12345}));
+  EXPECT_FALSE(SplitBlockBloomFilter::fromBitset(
+                   std::span<const std::uint8_t>(bytes.data(), 40))
+                   .ok());
+}
+
+}  // namespace halo::storage::format
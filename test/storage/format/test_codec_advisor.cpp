@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+import halo.common;
+import halo.storage.format;
+
+namespace halo::storage::format {
+
+namespace {
+
+std::string repetitiveText(std::size_t bytes) {
+  std::string text;
+  std::mt19937 rng(3);
+  const std::vector<std::string> words = {"select", "from",  "where", "halo",
+                                          "velox",  "group", "order", "by"};
+  while (text.size() < bytes) {
+    text += words[rng() % words.size()];
+    text += ' ';
+  }
+  text.resize(bytes);
+  return text;
+}
+
+std::string randomBytes(std::size_t bytes) {
+  std::string data(bytes, '\0');
+  std::mt19937_64 rng(5);
+  for (auto& c : data) {
+    c = static_cast<char>(rng());
+  }
+  return data;
+}
+
+CodecAdvisorOptions fastOptions(double budget) {
+  CodecAdvisorOptions options;
+  options.min_decode_bytes_per_sec = budget;
+  options.sample_bytes = 64 * 1024;
+  options.min_measure_time = std::chrono::microseconds(200);
+  return options;
+}
+
+}  // namespace
+
+TEST(CodecAdvisorTest, EveryCodecRoundTrips) {
+  const auto input = repetitiveText(100000);
+  auto candidates = defaultCandidates(CodecTarget::kHaloFile);
+  candidates.insert(candidates.end(), {CodecCandidate{Codec::kZstd, 19},
+                                       CodecCandidate{Codec::kXz, 6},
+                                       CodecCandidate{Codec::kBzip2, 9}});
+  for (const auto& candidate : candidates) {
+    auto compressed = compressBuffer(candidate, input);
+    ASSERT_TRUE(compressed.ok()) << codecName(candidate.codec);
+    std::string output(input.size(), '\0');
+    ASSERT_TRUE(decompressBuffer(candidate, *compressed, output).ok())
+        << codecName(candidate.codec);
+    EXPECT_EQ(output, input) << codecName(candidate.codec);
+  }
+}
+
+TEST(CodecAdvisorTest, DecompressDetectsWrongSize) {
+  const auto input = repetitiveText(1000);
+  const CodecCandidate zstd{Codec::kZstd, 3};
+  auto compressed = compressBuffer(zstd, input);
+  ASSERT_TRUE(compressed.ok());
+  std::string output(input.size() - 1, '\0');
+  auto status = decompressBuffer(zstd, *compressed, output);
+  EXPECT_EQ(status.code(), common::base::Status::Code::kStorageError);
+}
+
+TEST(CodecAdvisorTest, DecompressNeverOverrunsOutput) {
+  // A block whose header claims more bytes than the output holds, as a
+  // corrupt or mismatched one would, fails without writing past it.
+  const auto input = repetitiveText(4096);
+  for (const auto codec : {Codec::kSnappy, Codec::kLz4, Codec::kZlib,
+                           Codec::kXz, Codec::kBzip2}) {
+    const CodecCandidate candidate{codec, codec == Codec::kXz ? 1 : 6};
+    auto compressed = compressBuffer(candidate, input);
+    ASSERT_TRUE(compressed.ok()) << codecName(codec);
+    std::string output(input.size() / 2 + 16, '\0');
+    const auto guard = output.size() - 16;
+    std::span<char> target(output.data(), guard);
+    EXPECT_FALSE(decompressBuffer(candidate, *compressed, target).ok())
+        << codecName(codec);
+    EXPECT_EQ(output.substr(guard), std::string(16, '\0'))
+        << codecName(codec);
+  }
+}
+
+TEST(CodecAdvisorTest, DefaultsLeaveOutSlowEncoders) {
+  for (const auto target : {CodecTarget::kParquet, CodecTarget::kHaloFile}) {
+    for (const auto& candidate : defaultCandidates(target)) {
+      EXPECT_NE(candidate, (CodecCandidate{Codec::kZstd, 19}));
+      EXPECT_NE(candidate.codec, Codec::kXz);
+      EXPECT_NE(candidate.codec, Codec::kBzip2);
+    }
+  }
+}
+
+TEST(CodecAdvisorTest, TargetRestrictsCandidates) {
+  auto parquet = CodecAdvisor::create(
+      CodecTarget::kParquet,
+      {.candidates = {CodecCandidate{Codec::kXz, 6}}});
+  EXPECT_FALSE(parquet.ok());
+  // Parquet's GZIP is not the raw zlib stream compressBuffer writes.
+  auto zlib = CodecAdvisor::create(
+      CodecTarget::kParquet, {.candidates = {CodecCandidate{Codec::kZlib, 6}}});
+  EXPECT_FALSE(zlib.ok());
+  EXPECT_TRUE(CodecAdvisor::create(
+                  CodecTarget::kHaloFile,
+                  {.candidates = {CodecCandidate{Codec::kXz, 6}}})
+                  .ok());
+  for (const auto& candidate : defaultCandidates(CodecTarget::kParquet)) {
+    EXPECT_TRUE(candidate.codec == Codec::kNone ||
+                candidate.codec == Codec::kLz4 ||
+                candidate.codec == Codec::kSnappy ||
+                candidate.codec == Codec::kZstd)
+        << codecName(candidate.codec);
+  }
+}
+
+TEST(CodecAdvisorTest, UnlimitedBudgetPicksBestRatio) {
+  auto advisor = CodecAdvisor::create(CodecTarget::kHaloFile, fastOptions(0));
+  ASSERT_TRUE(advisor.ok());
+  const auto data = repetitiveText(256 * 1024);
+  auto choice = advisor->advise(data);
+  ASSERT_TRUE(choice.ok());
+  EXPECT_TRUE(choice->within_budget);
+  double best_ratio = 0.0;
+  double chosen_ratio = 0.0;
+  for (const auto& m : choice->measurements) {
+    best_ratio = std::max(best_ratio, m.ratio());
+    if (m.candidate == choice->choice) {
+      chosen_ratio = m.ratio();
+    }
+  }
+  EXPECT_DOUBLE_EQ(chosen_ratio, best_ratio);
+  EXPECT_NE(choice->choice.codec, Codec::kNone);
+}
+
+TEST(CodecAdvisorTest, ImpossibleBudgetFallsBackToFastestDecoder) {
+  auto advisor =
+      CodecAdvisor::create(CodecTarget::kParquet, fastOptions(1e18));
+  ASSERT_TRUE(advisor.ok());
+  auto choice = advisor->advise(repetitiveText(64 * 1024));
+  ASSERT_TRUE(choice.ok());
+  EXPECT_FALSE(choice->within_budget);
+  for (const auto& m : choice->measurements) {
+    if (m.candidate == choice->choice) {
+      continue;
+    }
+    EXPECT_GE(std::ranges::find(choice->measurements, choice->choice,
+                                &CodecMeasurement::candidate)
+                  ->decode_bytes_per_sec,
+              m.decode_bytes_per_sec);
+  }
+}
+
+TEST(CodecAdvisorTest, ReportListsEveryColumn) {
+  auto advisor = CodecAdvisor::create(CodecTarget::kParquet, fastOptions(0));
+  ASSERT_TRUE(advisor.ok());
+  const auto text = repetitiveText(32 * 1024);
+  const auto noise = randomBytes(32 * 1024);
+  std::map<std::string, std::span<const char>> columns = {
+      {"query_text", text}, {"payload", noise}};
+  auto choices = advisor->adviseColumns(columns);
+  ASSERT_TRUE(choices.ok());
+  ASSERT_EQ(choices->size(), 2U);
+  const auto report = codecReport(*choices);
+  EXPECT_NE(report.find("query_text"), std::string::npos);
+  EXPECT_NE(report.find("payload"), std::string::npos);
+  EXPECT_NE(report.find("decode_MB/s"), std::string::npos);
+}
+
+}  // namespace halo::storage::format
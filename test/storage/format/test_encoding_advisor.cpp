@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+import halo.common;
+import halo.storage.format;
+
+namespace halo::storage::format {
+
+namespace {
+
+EncodingAdvisor makeAdvisor(EncodingAdvisorOptions options = {}) {
+  auto advisor = EncodingAdvisor::create(options);
+  EXPECT_TRUE(advisor.ok());
+  return std::move(advisor).value();
+}
+
+}  // namespace
+
+TEST(EncodingAdvisorTest, RejectsInvalidOptions) {
+  EXPECT_FALSE(EncodingAdvisor::create({.sample_size = 0}).ok());
+  EXPECT_FALSE(
+      EncodingAdvisor::create({.sample_size = 4, .sample_runs = 8}).ok());
+  EXPECT_FALSE(EncodingAdvisor::create({.decode_weight = -1.0}).ok());
+}
+
+TEST(EncodingAdvisorTest, SortedIntegersPreferDelta) {
+  std::vector<std::int64_t> timestamps(100000);
+  for (std::size_t i = 0; i < timestamps.size(); ++i) {
+    timestamps[i] = 1'700'000'000'000 + static_cast<std::int64_t>(i) * 1000;
+  }
+  auto choice = makeAdvisor().choose(std::span<const std::int64_t>(timestamps));
+  EXPECT_EQ(choice.encoding, Encoding::kDeltaBinaryPacked);
+  EXPECT_LT(choice.estimated_bytes, choice.plain_bytes / 10);
+  EXPECT_EQ(choice.plain_bytes, timestamps.size() * sizeof(std::int64_t));
+}
+
+TEST(EncodingAdvisorTest, LowCardinalityPrefersDictionary) {
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> pick(0, 15);
+  std::vector<std::string> countries = {"US", "DE", "FR", "CN", "JP", "BR",
+                                        "IN", "GB", "IT", "ES", "CA", "MX",
+                                        "KR", "AU", "NL", "SE"};
+  std::vector<std::string_view> values;
+  values.reserve(50000);
+  for (int i = 0; i < 50000; ++i) {
+    values.emplace_back(countries[pick(rng)]);
+  }
+  auto choice = makeAdvisor().choose(std::span<const std::string_view>(values));
+  EXPECT_EQ(choice.encoding, Encoding::kRleDictionary);
+  EXPECT_LT(choice.estimated_bytes, choice.plain_bytes / 4);
+}
+
+TEST(EncodingAdvisorTest, SharedPrefixStringsPreferDeltaByteArray) {
+  std::vector<std::string> urls;
+  urls.reserve(20000);
+  for (int i = 0; i < 20000; ++i) {
+    urls.push_back("https://example.com/catalog/products/item-" +
+                   std::to_string(1'000'000 + i));
+  }
+  std::vector<std::string_view> values(urls.begin(), urls.end());
+  auto choice = makeAdvisor({.decode_weight = 0.0})
+                    .choose(std::span<const std::string_view>(values));
+  EXPECT_EQ(choice.encoding, Encoding::kDeltaByteArray);
+}
+
+TEST(EncodingAdvisorTest, SmoothDoublesPreferByteStreamSplit) {
+  std::vector<double> readings(65536);
+  for (std::size_t i = 0; i < readings.size(); ++i) {
+    readings[i] = 20.0 + std::sin(static_cast<double>(i) * 0.001) *
+                             (1.0 + static_cast<double>(i % 7) * 1e-9);
+  }
+  auto choice = makeAdvisor().choose(std::span<const double>(readings));
+  EXPECT_EQ(choice.encoding, Encoding::kByteStreamSplit);
+}
+
+TEST(EncodingAdvisorTest, DefaultModeIsDictionaryWithPlainFallback) {
+  std::vector<std::int32_t> values = {1, 2, 3, 4, 5};
+  auto choice = makeAdvisor({.mode = EncodingSelectionMode::kDefault})
+                    .choose(std::span<const std::int32_t>(values));
+  EXPECT_EQ(choice.encoding, Encoding::kRleDictionary);
+  EXPECT_TRUE(choice.candidates.empty());
+  EXPECT_EQ(choice.sampled_values, 5U);
+  EXPECT_EQ(choice.plain_bytes, 5 * sizeof(std::int32_t));
+
+  // A dictionary over the writer's limit falls back to plain.
+  auto fallback = makeAdvisor({.mode = EncodingSelectionMode::kDefault,
+                               .max_dictionary_bytes = 8,
+                               .assume_compression = false})
+                      .choose(std::span<const std::int32_t>(values));
+  EXPECT_EQ(fallback.encoding, Encoding::kPlain);
+  EXPECT_EQ(fallback.estimated_bytes, 5 * sizeof(std::int32_t));
+}
+
+TEST(EncodingAdvisorTest, DecodeWeightTradesSizeForSpeed) {
+  // Moderately sized dictionary: smaller than plain, but slower to decode.
+  std::mt19937 rng(11);
+  std::uniform_int_distribution<std::int64_t> pick(0, 4095);
+  std::vector<std::int64_t> values(100000);
+  for (auto& value : values) {
+    value = pick(rng) * 1'000'003;
+  }
+  auto small = makeAdvisor({.decode_weight = 0.0, .assume_compression = false})
+                   .choose(std::span<const std::int64_t>(values));
+  EXPECT_EQ(small.encoding, Encoding::kRleDictionary);
+  auto fast = makeAdvisor({.decode_weight = 10.0})
+                  .choose(std::span<const std::int64_t>(values));
+  EXPECT_EQ(fast.encoding, Encoding::kPlain);
+}
+
+TEST(EncodingAdvisorTest, MetadataRecordsChoice) {
+  std::vector<std::int64_t> values(1000, 42);
+  auto choice = makeAdvisor().choose(std::span<const std::int64_t>(values));
+  auto [key, value] = choice.toMetadata("user_id");
+  EXPECT_EQ(key, "halo.encoding.user_id");
+  EXPECT_TRUE(value.starts_with(encodingName(choice.encoding)));
+  EXPECT_NE(value.find("plain_bytes=8000"), std::string::npos);
+}
+
+}  // namespace halo::storage::format
@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+import halo.common;
+import halo.storage.format;
+
+namespace halo::storage::format {
+
+namespace {
+
+// Builds an index over `rows' sequential int64 values [start, start + rows),
+// grouped into pages of `page_rows'.
+ColumnChunkIndex buildSequential(std::int64_t start, std::int64_t rows,
+                                 std::int64_t page_rows,
+                                 bool with_bloom = false) {
+  IndexWriteOptions options;
+  options.page_row_limit = page_rows;
+  options.bloom_filter_ndv = static_cast<std::uint64_t>(rows);
+  if (with_bloom) {
+    options.bloom_filter_columns.insert("user_id");
+  }
+  auto builder = ColumnChunkIndexBuilder::create(
+      "user_id", PhysicalType::kInt64, options);
+  EXPECT_TRUE(builder.ok());
+  for (std::int64_t i = 0; i < rows; ++i) {
+    EXPECT_TRUE(builder->append(ZoneValue{start + i}).ok());
+  }
+  return std::move(builder).value().finish();
+}
+
+}  // namespace
+
+TEST(ZoneMapTest, BuilderSplitsPages) {
+  auto index = buildSequential(0, 250, 100);
+  ASSERT_EQ(index.pages().size(), 3U);
+  EXPECT_EQ(index.rowCount(), 250);
+  EXPECT_EQ(index.pages()[2].first_row, 200);
+  EXPECT_EQ(index.pages()[2].row_count, 50);
+  EXPECT_EQ(std::get<std::int64_t>(*index.pages()[1].min), 100);
+  EXPECT_EQ(std::get<std::int64_t>(*index.pages()[1].max), 199);
+  EXPECT_EQ(std::get<std::int64_t>(*index.min()), 0);
+  EXPECT_EQ(std::get<std::int64_t>(*index.max()), 249);
+}
+
+TEST(ZoneMapTest, EqualityPrunesPages) {
+  auto index = buildSequential(0, 1000, 100);
+  auto ranges = index.matchingRows(ColumnPredicate::Equal(ZoneValue{450}));
+  ASSERT_EQ(ranges.size(), 1U);
+  EXPECT_EQ(ranges[0], (RowRange{.begin = 400, .end = 500}));
+
+  EXPECT_TRUE(
+      index.matchingRows(ColumnPredicate::Equal(ZoneValue{5000})).empty());
+}
+
+TEST(ZoneMapTest, InListCoalescesAdjacentPages) {
+  auto index = buildSequential(0, 1000, 100);
+  auto ranges = index.matchingRows(ColumnPredicate::In(
+      {ZoneValue{150}, ZoneValue{250}, ZoneValue{950}, ZoneValue{150}}));
+  ASSERT_EQ(ranges.size(), 2U);
+  EXPECT_EQ(ranges[0], (RowRange{.begin = 100, .end = 300}));
+  EXPECT_EQ(ranges[1], (RowRange{.begin = 900, .end = 1000}));
+}
+
+TEST(ZoneMapTest, RowGroupSelection) {
+  std::vector<ColumnChunkIndex> chunks;
+  chunks.push_back(buildSequential(0, 100, 10));
+  chunks.push_back(buildSequential(100, 100, 10));
+  chunks.push_back(buildSequential(200, 100, 10));
+
+  auto selected = selectRowGroups(
+      chunks, ColumnPredicate::In({ZoneValue{5}, ZoneValue{250}}));
+  EXPECT_EQ(selected, (std::vector<std::size_t>{0, 2}));
+}
+
+TEST(ZoneMapTest, BloomFilterPrunesInsideRange) {
+  // Even values only: odd probes fall inside min/max but miss the bloom filter.
+  IndexWriteOptions options;
+  options.page_row_limit = 1000;
+  options.bloom_filter_columns.insert("user_id");
+  options.bloom_filter_ndv = 5000;
+  options.bloom_filter_fpp = 0.001;
+  auto builder = ColumnChunkIndexBuilder::create(
+      "user_id", PhysicalType::kInt64, options);
+  ASSERT_TRUE(builder.ok());
+  for (std::int64_t i = 0; i < 5000; ++i) {
+    ASSERT_TRUE(builder->append(ZoneValue{i * 2}).ok());
+  }
+  auto index = std::move(builder).value().finish();
+  ASSERT_TRUE(index.bloomFilter().has_value());
+
+  EXPECT_TRUE(index.mayMatch(ColumnPredicate::Equal(ZoneValue{4000})));
+  int pruned = 0;
+  for (std::int64_t i = 0; i < 1000; ++i) {
+    if (!index.mayMatch(ColumnPredicate::Equal(ZoneValue{i * 2 + 1}))) {
+      ++pruned;
+    }
+  }
+  EXPECT_GT(pruned, 980);
+}
+
+TEST(ZoneMapTest, NullsAndNaNAreNotMatched) {
+  IndexWriteOptions options;
+  options.page_row_limit = 2;
+  auto builder =
+      ColumnChunkIndexBuilder::create("score", PhysicalType::kDouble, options);
+  ASSERT_TRUE(builder.ok());
+  builder->appendNull();
+  builder->appendNull();
+  ASSERT_TRUE(builder->append(ZoneValue{1.5}).ok());
+  ASSERT_TRUE(builder->append(ZoneValue{std::nan("")}).ok());
+  auto index = std::move(builder).value().finish();
+  ASSERT_EQ(index.pages().size(), 2U);
+  EXPECT_TRUE(index.pages()[0].allNull());
+  EXPECT_EQ(index.pages()[0].null_count, 2);
+  EXPECT_DOUBLE_EQ(std::get<double>(*index.pages()[1].max), 1.5);
+
+  auto ranges = index.matchingRows(ColumnPredicate::Equal(ZoneValue{1.5}));
+  ASSERT_EQ(ranges.size(), 1U);
+  EXPECT_EQ(ranges[0], (RowRange{.begin = 2, .end = 4}));
+}
+
+TEST(ZoneMapTest, AllNaNPageIsNotPruned) {
+  IndexWriteOptions options;
+  options.page_row_limit = 2;
+  auto builder =
+      ColumnChunkIndexBuilder::create("score", PhysicalType::kDouble, options);
+  ASSERT_TRUE(builder.ok());
+  ASSERT_TRUE(builder->append(ZoneValue{std::nan("")}).ok());
+  ASSERT_TRUE(builder->append(ZoneValue{std::nan("")}).ok());
+  auto index = std::move(builder).value().finish();
+  ASSERT_EQ(index.pages().size(), 1U);
+  EXPECT_FALSE(index.pages()[0].allNull());
+  EXPECT_FALSE(index.min().has_value());
+
+  const auto nan = ColumnPredicate::Equal(ZoneValue{std::nan("")});
+  EXPECT_TRUE(index.mayMatch(nan));
+  EXPECT_EQ(index.matchingRows(nan),
+            (std::vector<RowRange>{{.begin = 0, .end = 2}}));
+}
+
+TEST(ZoneMapTest, BloomFilterFindsEitherSignedZero) {
+  for (const auto type : {PhysicalType::kFloat, PhysicalType::kDouble}) {
+    IndexWriteOptions options;
+    options.bloom_filter_columns.insert("score");
+    options.bloom_filter_ndv = 16;
+    auto builder = ColumnChunkIndexBuilder::create("score", type, options);
+    ASSERT_TRUE(builder.ok());
+    ASSERT_TRUE(builder->append(ZoneValue{-1.0}).ok());
+    ASSERT_TRUE(builder->append(ZoneValue{-0.0}).ok());
+    ASSERT_TRUE(builder->append(ZoneValue{1.0}).ok());
+    auto index = std::move(builder).value().finish();
+    EXPECT_TRUE(index.mayMatch(ColumnPredicate::Equal(ZoneValue{0.0})));
+    EXPECT_TRUE(index.mayMatch(ColumnPredicate::Equal(ZoneValue{-0.0})));
+  }
+}
+
+TEST(ZoneMapTest, TypeMismatchIsRejectedOrConservative) {
+  auto builder = ColumnChunkIndexBuilder::create(
+      "name", PhysicalType::kByteArray, IndexWriteOptions{});
+  ASSERT_TRUE(builder.ok());
+  EXPECT_FALSE(builder->append(ZoneValue{1}).ok());
+  ASSERT_TRUE(builder->append(ZoneValue{std::string("bob")}).ok());
+  auto index = std::move(builder).value().finish();
+  // A predicate of the wrong type can never be used to prune.
+  EXPECT_TRUE(index.mayMatch(ColumnPredicate::Equal(ZoneValue{1})));
+  EXPECT_FALSE(
+      index.mayMatch(ColumnPredicate::Equal(ZoneValue{std::string("carol")})));
+}
+
+}  // namespace halo::storage::format
@@ -0,0 +1,327 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/dwio/parquet/thrift/ParquetThriftTypes.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <variant>
+#include <vector>
+
+import halo.common;
+import halo.storage.file;
+import halo.storage.format;
+import halo.storage.parquet;
+import halo.storage.search;
+
+namespace halo::storage::parquet {
+
+namespace {
+
+namespace thrift = facebook::velox::parquet::thrift;
+namespace velox = facebook::velox;
+
+using format::ColumnPredicate;
+using format::PhysicalType;
+using format::ZoneValue;
+
+velox::RowTypePtr eventType() {
+  return velox::ROW({"id", "bucket", "score", "name"},
+                    {velox::BIGINT(), velox::INTEGER(), velox::DOUBLE(),
+                     velox::VARCHAR()});
+}
+
+class ParquetFileTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    pool_ = velox::memory::memoryManager()->addLeafPool("parquet_file");
+    path_ = std::filesystem::temp_directory_path() /
+            ("halo_parquet_file_" + std::to_string(::getpid()) + ".parquet");
+  }
+
+  void TearDown() override { std::filesystem::remove(path_); }
+
+  // Rows [begin, begin + rows) of the event table: ascending ids, 97
+  // buckets, scores crossing zero at id 400.
+  velox::RowVectorPtr events(std::int64_t begin, std::int64_t rows) {
+    const auto size = static_cast<velox::vector_size_t>(rows);
+    auto ids = velox::BaseVector::create<velox::FlatVector<std::int64_t>>(
+        velox::BIGINT(), size, pool_.get());
+    auto buckets = velox::BaseVector::create<velox::FlatVector<std::int32_t>>(
+        velox::INTEGER(), size, pool_.get());
+    auto scores = velox::BaseVector::create<velox::FlatVector<double>>(
+        velox::DOUBLE(), size, pool_.get());
+    auto names =
+        velox::BaseVector::create<velox::FlatVector<velox::StringView>>(
+            velox::VARCHAR(), size, pool_.get());
+    for (velox::vector_size_t i = 0; i < size; ++i) {
+      const auto id = begin + i;
+      ids->set(i, id);
+      buckets->set(i, static_cast<std::int32_t>(id % 97));
+      scores->set(i, static_cast<double>(id) * 0.25 - 100.0);
+      names_.push_back("event name " + std::to_string(id));
+      names->set(i, velox::StringView(names_.back()));
+    }
+    return std::make_shared<velox::RowVector>(
+        pool_.get(), eventType(), nullptr, size,
+        std::vector<velox::VectorPtr>{ids, buckets, scores, names});
+  }
+
+  // 5000 events in row groups of 2000 rows and pages of 500, written in
+  // batches that straddle row group boundaries.
+  void writeEvents(ParquetWriterOptions options = {}) {
+    options.row_group_rows = 2000;
+    options.index.page_row_limit = 500;
+    options.index.bloom_filter_columns = {"bucket"};
+    options.index.bloom_filter_ndv = 100;
+    auto writer = ParquetWriter::create(path_, eventType(), options);
+    ASSERT_TRUE(writer.ok()) << writer.status().message();
+    for (std::int64_t begin = 0; begin < 5000; begin += 1500) {
+      auto status =
+          (*writer)->write(events(begin, std::min<std::int64_t>(
+                                             1500, 5000 - begin)));
+      ASSERT_TRUE(status.ok()) << status.message();
+    }
+    auto status = (*writer)->close();
+    ASSERT_TRUE(status.ok()) << status.message();
+  }
+
+  std::shared_ptr<ParquetFile> openEvents() {
+    auto mapped = file::MappedReadFile::open(path_.string());
+    EXPECT_TRUE(mapped.ok()) << mapped.status().message();
+    auto file = ParquetFile::open(std::move(mapped).value());
+    EXPECT_TRUE(file.ok()) << file.status().message();
+    return std::move(file).value();
+  }
+
+  std::shared_ptr<velox::memory::MemoryPool> pool_;
+  std::filesystem::path path_;
+  // Backs the StringViews of the name column.
+  std::deque<std::string> names_;
+};
+
+}  // namespace
+
+TEST_F(ParquetFileTest, FooterDescribesRowGroups) {
+  ParquetWriterOptions options;
+  options.key_value_metadata = {{"halo.table", "events"}};
+  writeEvents(options);
+  auto file = openEvents();
+  ASSERT_NE(file, nullptr);
+  EXPECT_EQ(file->rowType()->names(), eventType()->names());
+  EXPECT_EQ(file->rowType()->childAt(1)->kind(), velox::TypeKind::INTEGER);
+  EXPECT_EQ(file->rowType()->childAt(3)->kind(), velox::TypeKind::VARCHAR);
+  ASSERT_EQ(file->numRowGroups(), 3U);
+  EXPECT_EQ(file->numRows(0), 2000);
+  EXPECT_EQ(file->numRows(2), 1000);
+  EXPECT_EQ(file->physicalType(1), PhysicalType::kInt32);
+  EXPECT_EQ(file->findColumn("score"), 2U);
+  EXPECT_FALSE(file->findColumn("missing").has_value());
+  EXPECT_EQ(file->keyValue("halo.table"), "events");
+  EXPECT_FALSE(file->keyValue("halo.other").has_value());
+  EXPECT_EQ(file->columnMetaData(1, 0).num_values, 2000);
+}
+
+TEST_F(ParquetFileTest, PageIndexesRoundTrip) {
+  writeEvents();
+  auto file = openEvents();
+  ASSERT_NE(file, nullptr);
+
+  auto offsets = file->offsetIndex(1, 0);
+  ASSERT_TRUE(offsets.ok()) << offsets.status().message();
+  ASSERT_EQ(offsets->page_locations.size(), 4U);
+  EXPECT_EQ(offsets->page_locations[2].first_row_index, 1000);
+  EXPECT_LT(offsets->page_locations[0].offset,
+            offsets->page_locations[1].offset);
+
+  auto ids = file->chunkIndex(1, 0);
+  ASSERT_TRUE(ids.ok()) << ids.status().message();
+  ASSERT_EQ(ids->pages().size(), 4U);
+  EXPECT_EQ(ids->rowCount(), 2000);
+  EXPECT_EQ(std::get<std::int64_t>(*ids->pages()[1].min), 2500);
+  EXPECT_EQ(std::get<std::int64_t>(*ids->pages()[1].max), 2999);
+  EXPECT_FALSE(ids->bloomFilter().has_value());
+  const auto rows = ids->matchingRows(ColumnPredicate::Equal(ZoneValue{2750}));
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(rows[0], (format::RowRange{.begin = 500, .end = 1000}));
+
+  auto names = file->chunkIndex(2, 3);
+  ASSERT_TRUE(names.ok()) << names.status().message();
+  EXPECT_EQ(std::get<std::string>(*names->min()), "event name 4000");
+  EXPECT_EQ(std::get<std::string>(*names->max()), "event name 4999");
+}
+
+TEST_F(ParquetFileTest, BloomFilterIsReadBack) {
+  writeEvents();
+  auto file = openEvents();
+  ASSERT_NE(file, nullptr);
+  auto buckets = file->chunkIndex(0, 1);
+  ASSERT_TRUE(buckets.ok()) << buckets.status().message();
+  ASSERT_TRUE(buckets->bloomFilter().has_value());
+  for (std::int32_t bucket = 0; bucket < 97; ++bucket) {
+    EXPECT_TRUE(buckets->bloomFilter()->findHash(
+        format::SplitBlockBloomFilter::hash(bucket)));
+  }
+  EXPECT_TRUE(buckets->mayMatch(ColumnPredicate::Equal(ZoneValue{42})));
+  EXPECT_FALSE(buckets->mayMatch(ColumnPredicate::Equal(ZoneValue{500})));
+}
+
+TEST_F(ParquetFileTest, FullTextIndexIsReadBack) {
+  ParquetWriterOptions options;
+  options.full_text_columns = {{"name", {}}};
+  writeEvents(options);
+  auto file = openEvents();
+  ASSERT_NE(file, nullptr);
+  auto ids = file->fullTextIndex(2, 0);
+  ASSERT_TRUE(ids.ok()) << ids.status().message();
+  EXPECT_FALSE(ids->has_value());
+
+  auto names = file->fullTextIndex(2, 3);
+  ASSERT_TRUE(names.ok()) << names.status().message();
+  ASSERT_TRUE(names->has_value());
+  EXPECT_EQ((*names)->rows(), 1000U);
+  auto rows = (*names)->search("4321 OR 4999");
+  ASSERT_TRUE(rows.ok()) << rows.status().message();
+  EXPECT_EQ(*rows, (std::vector<std::uint32_t>{321, 999}));
+  // The index sits outside the chunk's pages, so its rows read as before.
+  auto chunk = file->chunkIndex(2, 3);
+  ASSERT_TRUE(chunk.ok()) << chunk.status().message();
+  EXPECT_EQ(std::get<std::string>(*chunk->max()), "event name 4999");
+}
+
+TEST_F(ParquetFileTest, EncodingAdviceIsRecordedPerChunk) {
+  ParquetWriterOptions options;
+  options.encoding_advice = format::EncodingAdvisorOptions{};
+  writeEvents(options);
+  auto file = openEvents();
+  ASSERT_NE(file, nullptr);
+  const auto advice = [&](std::size_t row_group, std::size_t column) {
+    const auto& meta = file->columnMetaData(row_group, column);
+    const auto key = "halo.encoding." + file->rowType()->nameOf(column);
+    for (const auto& entry : meta.key_value_metadata) {
+      if (entry.key == key) {
+        return entry.value;
+      }
+    }
+    return std::string();
+  };
+  EXPECT_TRUE(advice(1, 0).starts_with("DELTA_BINARY_PACKED;"))
+      << advice(1, 0);
+  EXPECT_NE(advice(2, 0).find("plain_bytes=8000;"), std::string::npos)
+      << advice(2, 0);
+  EXPECT_TRUE(advice(0, 1).starts_with("RLE_DICTIONARY;")) << advice(0, 1);
+  // Advice does not change what is written.
+  EXPECT_EQ(file->columnMetaData(0, 1).encodings,
+            std::vector{thrift::Encoding::PLAIN});
+}
+
+TEST_F(ParquetFileTest, ColumnCodecsOverrideTheDefault) {
+  ParquetWriterOptions options;
+  options.codec = {.codec = format::Codec::kLz4};
+  options.column_codecs = {
+      {"name", {.codec = format::Codec::kZstd, .level = 3}}};
+  writeEvents(options);
+  auto file = openEvents();
+  ASSERT_NE(file, nullptr);
+  for (std::size_t row_group = 0; row_group < 3; ++row_group) {
+    EXPECT_EQ(file->columnMetaData(row_group, 0).codec,
+              thrift::CompressionCodec::LZ4_RAW);
+    EXPECT_EQ(file->columnMetaData(row_group, 3).codec,
+              thrift::CompressionCodec::ZSTD);
+  }
+  auto chunk = file->chunkIndex(1, 3);
+  ASSERT_TRUE(chunk.ok()) << chunk.status().message();
+  EXPECT_EQ(std::get<std::string>(*chunk->min()), "event name 2000");
+}
+
+TEST_F(ParquetFileTest, CodecAdvicePicksAParquetCodecPerChunk) {
+  ParquetWriterOptions options;
+  options.column_codecs = {{"id", {.codec = format::Codec::kNone}}};
+  options.codec_advice = format::CodecAdvisorOptions{
+      .min_decode_bytes_per_sec = 0,
+      .sample_bytes = 4096,
+      .min_measure_time = std::chrono::microseconds(50)};
+  writeEvents(options);
+  auto file = openEvents();
+  ASSERT_NE(file, nullptr);
+  for (std::size_t row_group = 0; row_group < 3; ++row_group) {
+    EXPECT_EQ(file->columnMetaData(row_group, 0).codec,
+              thrift::CompressionCodec::UNCOMPRESSED);
+    // With no decode budget the advisor trades speed for ratio, and the
+    // repetitive names compress.
+    EXPECT_NE(file->columnMetaData(row_group, 3).codec,
+              thrift::CompressionCodec::UNCOMPRESSED);
+    for (std::size_t column = 0; column < 4; ++column) {
+      EXPECT_TRUE(file->chunkIndex(row_group, column).ok());
+    }
+  }
+}
+
+TEST_F(ParquetFileTest, ZeroBoundsAreSigned) {
+  format::IndexWriteOptions options;
+  auto builder = format::ColumnChunkIndexBuilder::create(
+      "score", PhysicalType::kDouble, options);
+  ASSERT_TRUE(builder.ok());
+  ASSERT_TRUE(builder->append(ZoneValue{0.0}).ok());
+  auto index = std::move(builder).value().finish();
+  auto column_index = toColumnIndex(index);
+  ASSERT_TRUE(column_index.has_value());
+  auto min = decodeBound(PhysicalType::kDouble, column_index->min_values[0]);
+  auto max = decodeBound(PhysicalType::kDouble, column_index->max_values[0]);
+  ASSERT_TRUE(min.ok() && max.ok());
+  EXPECT_TRUE(std::signbit(std::get<double>(*min)));
+  EXPECT_FALSE(std::signbit(std::get<double>(*max)));
+}
+
+TEST_F(ParquetFileTest, AllNanPageHasNoColumnIndex) {
+  auto builder = format::ColumnChunkIndexBuilder::create(
+      "score", PhysicalType::kDouble, {});
+  ASSERT_TRUE(builder.ok());
+  ASSERT_TRUE(builder->append(ZoneValue{std::nan("")}).ok());
+  EXPECT_FALSE(toColumnIndex(std::move(builder).value().finish()));
+}
+
+TEST_F(ParquetFileTest, WriterRejectsWhatItCannotWrite) {
+  auto booleans = ParquetWriter::create(
+      path_, velox::ROW({"flag"}, {velox::BOOLEAN()}));
+  EXPECT_FALSE(booleans.ok());
+
+  ParquetWriterOptions full_text_ids;
+  full_text_ids.full_text_columns = {{"id", {}}};
+  EXPECT_FALSE(ParquetWriter::create(path_, eventType(), full_text_ids).ok());
+
+  ParquetWriterOptions zlib;
+  zlib.codec = {.codec = format::Codec::kZlib};
+  EXPECT_FALSE(ParquetWriter::create(path_, eventType(), zlib).ok());
+  ParquetWriterOptions zlib_name;
+  zlib_name.column_codecs = {{"name", {.codec = format::Codec::kZlib}}};
+  EXPECT_FALSE(ParquetWriter::create(path_, eventType(), zlib_name).ok());
+  ParquetWriterOptions missing_codec;
+  missing_codec.column_codecs = {{"missing", {.codec = format::Codec::kZstd}}};
+  EXPECT_FALSE(ParquetWriter::create(path_, eventType(), missing_codec).ok());
+
+  auto writer = ParquetWriter::create(path_, eventType());
+  ASSERT_TRUE(writer.ok()) << writer.status().message();
+  auto batch = events(0, 10);
+  batch->childAt(2)->setNull(3, true);
+  EXPECT_FALSE((*writer)->write(batch).ok());
+}
+
+TEST_F(ParquetFileTest, RejectsFilesThatAreNotParquet) {
+  std::ofstream(path_, std::ios::binary) << "not a Parquet file at all";
+  auto mapped = file::MappedReadFile::open(path_.string());
+  ASSERT_TRUE(mapped.ok());
+  EXPECT_FALSE(ParquetFile::open(std::move(mapped).value()).ok());
+}
+
+}  // namespace halo::storage::parquet
@@ -0,0 +1,146 @@
+// Load time of plain BIGINT pages as Velox vectors with ColumnBufferLoader's
+// zero-copy views over the mapping against copies into pool memory, alone
+// and followed by a sum over every value. Pages are 1 MiB behind a stand-in
+// page header, and the file is warm in the page cache, so the comparison is
+// the copy the view avoids rather than device reads.
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/FlatVector.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+import halo.common;
+import halo.storage.file;
+import halo.storage.format;
+import halo.storage.scan;
+
+namespace halo::storage::scan {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+constexpr velox::vector_size_t kValuesPerPage = 128 * 1024;
+constexpr std::size_t kPages = 256;
+constexpr std::size_t kHeaderBytes = 64;
+constexpr int kRounds = 5;
+
+struct Timing {
+  double load_seconds = 1e300;
+  double load_and_sum_seconds = 1e300;
+};
+
+// Best of a few rounds of loading every page, without and with summing it.
+Timing time(ColumnBufferLoader& loader,
+            const std::vector<ColumnChunkLocation>& chunks,
+            std::int64_t expected_sum) {
+  Timing timing;
+  for (int round = 0; round < kRounds; ++round) {
+    for (const bool sum : {false, true}) {
+      std::int64_t total = 0;
+      const auto start = std::chrono::steady_clock::now();
+      for (const auto& chunk : chunks) {
+        auto vector = loader.loadFixedWidth(velox::BIGINT(), chunk);
+        if (!vector.ok()) {
+          ADD_FAILURE() << vector.status().message();
+          return timing;
+        }
+        if (sum) {
+          const auto* values =
+              (*vector)->asFlatVector<std::int64_t>()->rawValues();
+          for (velox::vector_size_t i = 0; i < kValuesPerPage; ++i) {
+            total += values[i];
+          }
+        }
+      }
+      const std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      auto& best = sum ? timing.load_and_sum_seconds : timing.load_seconds;
+      best = std::min(best, elapsed.count());
+      if (sum) {
+        EXPECT_EQ(total, expected_sum);
+      }
+    }
+  }
+  return timing;
+}
+
+}  // namespace
+
+TEST(ColumnBufferLoaderBenchmark, ZeroCopyVersusCopy) {
+  const auto path =
+      std::filesystem::temp_directory_path() /
+      ("halo_column_loader_bench_" + std::to_string(::getpid()) + ".bin");
+  std::vector<ColumnChunkLocation> chunks;
+  std::int64_t expected_sum = 0;
+  {
+    std::ofstream out(path, std::ios::binary);
+    std::vector<std::int64_t> values(kValuesPerPage);
+    const std::string header(kHeaderBytes, 'h');
+    std::uint64_t offset = 0;
+    for (std::size_t page = 0; page < kPages; ++page) {
+      for (velox::vector_size_t i = 0; i < kValuesPerPage; ++i) {
+        values[i] = static_cast<std::int64_t>(page) * kValuesPerPage + i;
+        expected_sum += values[i];
+      }
+      out.write(header.data(), static_cast<std::streamsize>(header.size()));
+      offset += header.size();
+      const auto bytes = values.size() * sizeof(std::int64_t);
+      out.write(reinterpret_cast<const char*>(values.data()),
+                static_cast<std::streamsize>(bytes));
+      chunks.push_back({.pages = {{.offset = offset,
+                                   .compressed_length = bytes,
+                                   .uncompressed_length = bytes,
+                                   .num_values = kValuesPerPage}}});
+      offset += bytes;
+    }
+  }
+
+  auto file = file::MappedReadFile::open(path.string());
+  ASSERT_TRUE(file.ok()) << file.status().message();
+  auto pool = velox::memory::memoryManager()->addLeafPool("loader_bench");
+  auto zero_copy = ColumnBufferLoader::create(*file, pool.get(),
+                                              ScanBufferMode::kZeroCopy);
+  auto copy =
+      ColumnBufferLoader::create(*file, pool.get(), ScanBufferMode::kCopy);
+  ASSERT_TRUE(zero_copy.ok() && copy.ok());
+
+  // Fault the mapping in once so neither mode pays for it.
+  time(**copy, chunks, expected_sum);
+  const auto viewed = time(**zero_copy, chunks, expected_sum);
+  const auto copied = time(**copy, chunks, expected_sum);
+  std::filesystem::remove(path);
+
+  const double megabytes = static_cast<double>(kPages) * kValuesPerPage *
+                           sizeof(std::int64_t) / 1e6;
+  std::cout << kPages << " pages of " << kValuesPerPage << " BIGINT values\n"
+            << std::left << std::setw(12) << "mode" << std::right
+            << std::setw(14) << "load_MB/s" << std::setw(18)
+            << "load+sum_MB/s" << '\n';
+  const auto row = [&](const char* mode, const Timing& timing) {
+    std::cout << std::left << std::setw(12) << mode << std::right
+              << std::fixed << std::setprecision(0) << std::setw(14)
+              << megabytes / timing.load_seconds << std::setw(18)
+              << megabytes / timing.load_and_sum_seconds << '\n';
+  };
+  row("zero-copy", viewed);
+  row("copy", copied);
+
+  EXPECT_EQ((*zero_copy)->stats().copied_bytes, 0U);
+  EXPECT_LT(viewed.load_seconds, copied.load_seconds);
+  EXPECT_LT(viewed.load_and_sum_seconds, copied.load_and_sum_seconds);
+}
+
+}  // namespace halo::storage::scan
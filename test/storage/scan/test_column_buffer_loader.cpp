@@ -0,0 +1,298 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/FlatVector.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+import halo.common;
+import halo.storage.file;
+import halo.storage.format;
+import halo.storage.scan;
+
+namespace halo::storage::scan {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+template <typename T>
+void appendValues(std::string& out, const std::vector<T>& values) {
+  out.append(reinterpret_cast<const char*>(values.data()),
+             values.size() * sizeof(T));
+}
+
+// Staging-table-like file of column chunks, each page behind a stand-in
+// page header: an aligned single-page BIGINT chunk, a two-page BIGINT
+// chunk, a misaligned INTEGER page, zstd DOUBLE chunks with levels in a V1
+// and a V2 page, and a two-page VARCHAR chunk whose second page has levels.
+class ColumnBufferLoaderTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    pool_ = velox::memory::memoryManager()->addLeafPool("column_loader");
+    for (std::int64_t i = 0; i < 1000; ++i) {
+      bigints_.push_back(i * 7 - 300);
+      integers_.push_back(static_cast<std::int32_t>(i * 3));
+      doubles_.push_back(static_cast<double>(i) * 0.5);
+    }
+    strings_ = {"a", "", "a string longer than twelve bytes", "halo"};
+
+    std::string contents(8, 'h');
+    std::string raw;
+    appendValues(raw, bigints_);
+    bigint_chunk_.pages.push_back(appendPage(contents, raw, 1000));
+
+    // Page headers between the pages of a chunk keep them apart.
+    std::string first_half;
+    std::string second_half;
+    appendValues(first_half, std::vector(bigints_.begin(),
+                                         bigints_.begin() + 600));
+    appendValues(second_half,
+                 std::vector(bigints_.begin() + 600, bigints_.end()));
+    two_page_chunk_.pages.push_back(appendPage(contents, first_half, 600));
+    contents.append(24, 'p');
+    two_page_chunk_.pages.push_back(appendPage(contents, second_half, 400));
+
+    contents.push_back('x');
+    raw.clear();
+    appendValues(raw, integers_);
+    integer_chunk_.pages.push_back(appendPage(contents, raw, 1000));
+
+    const std::string levels(6, '\x01');
+    std::string raw_doubles;
+    appendValues(raw_doubles, doubles_);
+    auto v1 = format::compressBuffer(
+        {.codec = format::Codec::kZstd, .level = 1}, levels + raw_doubles);
+    ASSERT_TRUE(v1.ok()) << v1.status().message();
+    double_chunk_.codec = format::Codec::kZstd;
+    double_chunk_.pages.push_back(
+        {.offset = contents.size(),
+         .compressed_length = v1->size(),
+         .uncompressed_length = levels.size() + raw_doubles.size(),
+         .levels_length = levels.size(),
+         .num_values = 1000});
+    contents += *v1;
+    auto v2 = format::compressBuffer(
+        {.codec = format::Codec::kZstd, .level = 1}, raw_doubles);
+    ASSERT_TRUE(v2.ok()) << v2.status().message();
+    v2_double_chunk_.codec = format::Codec::kZstd;
+    v2_double_chunk_.pages.push_back(
+        {.offset = contents.size(),
+         .compressed_length = levels.size() + v2->size(),
+         .uncompressed_length = levels.size() + raw_doubles.size(),
+         .levels_length = levels.size(),
+         .levels_compressed = false,
+         .num_values = 1000});
+    contents += levels + *v2;
+
+    std::string strings;
+    for (const auto& value : strings_) {
+      const auto length = static_cast<std::uint32_t>(value.size());
+      strings.append(reinterpret_cast<const char*>(&length), sizeof(length));
+      strings += value;
+    }
+    varchar_chunk_.pages.push_back(appendPage(contents, strings, 4));
+    contents.append(24, 'p');
+    auto page = appendPage(contents, std::string(4, '\x01') + strings, 4);
+    page.levels_length = 4;
+    varchar_chunk_.pages.push_back(page);
+
+    path_ = std::filesystem::temp_directory_path() /
+            ("halo_column_loader_" + std::to_string(::getpid()) + ".bin");
+    std::ofstream out(path_, std::ios::binary);
+    out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    out.close();
+
+    auto file = file::MappedReadFile::open(path_.string());
+    ASSERT_TRUE(file.ok()) << file.status().message();
+    file_ = std::move(file).value();
+  }
+
+  void TearDown() override { std::filesystem::remove(path_); }
+
+  // Appends an uncompressed page body and returns its location.
+  static PageLocation appendPage(std::string& contents,
+                                 const std::string& body,
+                                 velox::vector_size_t num_values) {
+    const PageLocation page{.offset = contents.size(),
+                            .compressed_length = body.size(),
+                            .uncompressed_length = body.size(),
+                            .num_values = num_values};
+    contents += body;
+    return page;
+  }
+
+  std::unique_ptr<ColumnBufferLoader> makeLoader(ScanBufferMode mode) {
+    auto loader = ColumnBufferLoader::create(file_, pool_.get(), mode);
+    EXPECT_TRUE(loader.ok()) << loader.status().message();
+    return std::move(loader).value();
+  }
+
+  std::shared_ptr<velox::memory::MemoryPool> pool_;
+  std::filesystem::path path_;
+  std::shared_ptr<file::MappedReadFile> file_;
+  std::vector<std::int64_t> bigints_;
+  std::vector<std::int32_t> integers_;
+  std::vector<double> doubles_;
+  std::vector<std::string> strings_;
+  ColumnChunkLocation bigint_chunk_;
+  ColumnChunkLocation two_page_chunk_;
+  ColumnChunkLocation integer_chunk_;
+  ColumnChunkLocation double_chunk_;
+  ColumnChunkLocation v2_double_chunk_;
+  ColumnChunkLocation varchar_chunk_;
+};
+
+}  // namespace
+
+TEST_F(ColumnBufferLoaderTest, UncompressedPageIsViewedInPlace) {
+  auto loader = makeLoader(ScanBufferMode::kZeroCopy);
+  auto vector = loader->loadFixedWidth(velox::BIGINT(), bigint_chunk_);
+  ASSERT_TRUE(vector.ok()) << vector.status().message();
+  auto* flat = (*vector)->asFlatVector<std::int64_t>();
+  ASSERT_NE(flat, nullptr);
+  const auto& page = bigint_chunk_.pages.front();
+  auto mapped = file_->view(page.offset, page.compressed_length);
+  ASSERT_TRUE(mapped.ok());
+  EXPECT_EQ(static_cast<const void*>(flat->rawValues()),
+            static_cast<const void*>(mapped->data()));
+  for (velox::vector_size_t i = 0; i < 1000; ++i) {
+    ASSERT_EQ(flat->valueAt(i), bigints_[i]);
+  }
+  EXPECT_EQ(loader->stats().zero_copy_bytes, page.compressed_length);
+  EXPECT_EQ(loader->stats().copied_bytes, 0U);
+  EXPECT_EQ(pool_->usedBytes(), 0);
+}
+
+TEST_F(ColumnBufferLoaderTest, ViewIsCopiedBeforeItIsWritten) {
+  auto loader = makeLoader(ScanBufferMode::kZeroCopy);
+  auto vector = loader->loadFixedWidth(velox::BIGINT(), bigint_chunk_);
+  ASSERT_TRUE(vector.ok());
+  auto* flat = (*vector)->asFlatVector<std::int64_t>();
+  EXPECT_FALSE(flat->values()->isMutable());
+  const auto* mapped = flat->rawValues();
+  auto* writable = flat->mutableRawValues();
+  EXPECT_NE(static_cast<const void*>(writable),
+            static_cast<const void*>(mapped));
+  writable[0] = 42;
+  EXPECT_EQ(flat->valueAt(0), 42);
+  EXPECT_EQ(flat->valueAt(999), bigints_.back());
+  EXPECT_EQ(mapped[0], bigints_.front());
+}
+
+TEST_F(ColumnBufferLoaderTest, VectorKeepsMappingAlive) {
+  auto loader = makeLoader(ScanBufferMode::kZeroCopy);
+  auto vector = loader->loadFixedWidth(velox::BIGINT(), bigint_chunk_);
+  ASSERT_TRUE(vector.ok());
+  loader.reset();
+  file_.reset();
+  auto* flat = (*vector)->asFlatVector<std::int64_t>();
+  EXPECT_EQ(flat->valueAt(0), bigints_.front());
+  EXPECT_EQ(flat->valueAt(999), bigints_.back());
+}
+
+TEST_F(ColumnBufferLoaderTest, PagesOfAChunkAreCopiedTogether) {
+  auto loader = makeLoader(ScanBufferMode::kZeroCopy);
+  auto vector = loader->loadFixedWidth(velox::BIGINT(), two_page_chunk_);
+  ASSERT_TRUE(vector.ok()) << vector.status().message();
+  auto* flat = (*vector)->asFlatVector<std::int64_t>();
+  ASSERT_EQ(flat->size(), 1000);
+  for (velox::vector_size_t i = 0; i < 1000; ++i) {
+    ASSERT_EQ(flat->valueAt(i), bigints_[i]);
+  }
+  EXPECT_EQ(loader->stats().copied_bytes, 1000 * sizeof(std::int64_t));
+  EXPECT_EQ(loader->stats().zero_copy_bytes, 0U);
+}
+
+TEST_F(ColumnBufferLoaderTest, MisalignedPageIsCopied) {
+  auto loader = makeLoader(ScanBufferMode::kZeroCopy);
+  auto vector = loader->loadFixedWidth(velox::INTEGER(), integer_chunk_);
+  ASSERT_TRUE(vector.ok()) << vector.status().message();
+  auto* flat = (*vector)->asFlatVector<std::int32_t>();
+  for (velox::vector_size_t i = 0; i < 1000; ++i) {
+    ASSERT_EQ(flat->valueAt(i), integers_[i]);
+  }
+  EXPECT_EQ(loader->stats().copied_bytes,
+            integer_chunk_.pages.front().compressed_length);
+  EXPECT_EQ(loader->stats().zero_copy_bytes, 0U);
+}
+
+TEST_F(ColumnBufferLoaderTest, CompressedPagesSkipTheirLevels) {
+  auto loader = makeLoader(ScanBufferMode::kZeroCopy);
+  for (const auto* chunk : {&double_chunk_, &v2_double_chunk_}) {
+    auto vector = loader->loadFixedWidth(velox::DOUBLE(), *chunk);
+    ASSERT_TRUE(vector.ok()) << vector.status().message();
+    auto* flat = (*vector)->asFlatVector<double>();
+    for (velox::vector_size_t i = 0; i < 1000; ++i) {
+      ASSERT_EQ(flat->valueAt(i), doubles_[i]);
+    }
+  }
+  EXPECT_EQ(loader->stats().decompressed_bytes,
+            double_chunk_.pages.front().uncompressed_length +
+                v2_double_chunk_.pages.front().uncompressed_length);
+  EXPECT_EQ(loader->stats().zero_copy_bytes, 0U);
+}
+
+TEST_F(ColumnBufferLoaderTest, PlainVarcharPointsIntoEachPage) {
+  auto loader = makeLoader(ScanBufferMode::kZeroCopy);
+  auto vector = loader->loadPlainVarchar(varchar_chunk_);
+  ASSERT_TRUE(vector.ok()) << vector.status().message();
+  auto* flat = (*vector)->asFlatVector<velox::StringView>();
+  ASSERT_EQ(flat->size(), 8);
+  for (std::size_t i = 0; i < 8; ++i) {
+    EXPECT_EQ(flat->valueAt(static_cast<velox::vector_size_t>(i)).str(),
+              strings_[i % strings_.size()]);
+  }
+  EXPECT_EQ(flat->stringBuffers().size(), 2U);
+  EXPECT_EQ(pool_->usedBytes(),
+            static_cast<std::int64_t>(flat->values()->capacity()));
+
+  auto truncated = varchar_chunk_;
+  ++truncated.pages.back().num_values;
+  EXPECT_FALSE(loader->loadPlainVarchar(truncated).ok());
+}
+
+TEST_F(ColumnBufferLoaderTest, CopyModeMaterializesIntoPool) {
+  auto loader = makeLoader(ScanBufferMode::kCopy);
+  auto vector = loader->loadFixedWidth(velox::BIGINT(), bigint_chunk_);
+  ASSERT_TRUE(vector.ok());
+  auto* flat = (*vector)->asFlatVector<std::int64_t>();
+  const auto& page = bigint_chunk_.pages.front();
+  auto mapped = file_->view(page.offset, page.compressed_length);
+  EXPECT_NE(static_cast<const void*>(flat->rawValues()),
+            static_cast<const void*>(mapped->data()));
+  EXPECT_EQ(flat->valueAt(42), bigints_[42]);
+  EXPECT_EQ(loader->stats().copied_bytes, page.compressed_length);
+}
+
+TEST_F(ColumnBufferLoaderTest, RejectsBadChunks) {
+  auto loader = makeLoader(ScanBufferMode::kZeroCopy);
+  auto short_chunk = bigint_chunk_;
+  --short_chunk.pages.front().num_values;
+  EXPECT_FALSE(loader->loadFixedWidth(velox::BIGINT(), short_chunk).ok());
+
+  const ColumnChunkLocation past_end{
+      .pages = {{.offset = file_->size() - 8,
+                 .compressed_length = 16,
+                 .uncompressed_length = 16,
+                 .num_values = 2}}};
+  EXPECT_FALSE(loader->loadFixedWidth(velox::BIGINT(), past_end).ok());
+
+  auto overrun = bigint_chunk_;
+  overrun.pages.front().levels_length = 1 << 20;
+  EXPECT_FALSE(loader->loadFixedWidth(velox::BIGINT(), overrun).ok());
+
+  auto unsupported = loader->loadFixedWidth(velox::BOOLEAN(), bigint_chunk_);
+  EXPECT_EQ(unsupported.status().code(),
+            common::base::Status::Code::kNotImplemented);
+}
+
+}  // namespace halo::storage::scan
@@ -0,0 +1,222 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+import halo.common;
+import halo.storage.file;
+import halo.storage.format;
+import halo.storage.parquet;
+import halo.storage.scan;
+import halo.storage.search;
+
+namespace halo::storage::scan {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+using format::ColumnPredicate;
+using format::ZoneValue;
+
+velox::RowTypePtr eventType() {
+  return velox::ROW({"id", "bucket", "name"},
+                    {velox::BIGINT(), velox::INTEGER(), velox::VARCHAR()});
+}
+
+// 5000 events with ascending ids, zstd-compressed into row groups of 2000
+// rows and pages of 500, with a bloom filter on `bucket' and a full-text
+// index on `name'.
+class ParquetScanTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    pool_ = velox::memory::memoryManager()->addLeafPool("parquet_scan");
+    path_ = std::filesystem::temp_directory_path() /
+            ("halo_parquet_scan_" + std::to_string(::getpid()) + ".parquet");
+    parquet::ParquetWriterOptions options;
+    options.row_group_rows = 2000;
+    options.index.page_row_limit = 500;
+    options.index.bloom_filter_columns = {"bucket"};
+    options.index.bloom_filter_ndv = 100;
+    options.codec = {.codec = format::Codec::kZstd, .level = 1};
+    options.full_text_columns = {{"name", {}}};
+    auto writer = parquet::ParquetWriter::create(path_, eventType(), options);
+    ASSERT_TRUE(writer.ok()) << writer.status().message();
+
+    constexpr velox::vector_size_t kRows = 5000;
+    auto ids = velox::BaseVector::create<velox::FlatVector<std::int64_t>>(
+        velox::BIGINT(), kRows, pool_.get());
+    auto buckets = velox::BaseVector::create<velox::FlatVector<std::int32_t>>(
+        velox::INTEGER(), kRows, pool_.get());
+    auto names =
+        velox::BaseVector::create<velox::FlatVector<velox::StringView>>(
+            velox::VARCHAR(), kRows, pool_.get());
+    for (velox::vector_size_t i = 0; i < kRows; ++i) {
+      ids->set(i, i);
+      // Even buckets only, so odd ones in range are left to the bloom
+      // filter.
+      buckets->set(i, (i % 50) * 2);
+      names_.push_back("event name " + std::to_string(i));
+      names->set(i, velox::StringView(names_.back()));
+    }
+    auto status = (*writer)->write(std::make_shared<velox::RowVector>(
+        pool_.get(), eventType(), nullptr, kRows,
+        std::vector<velox::VectorPtr>{ids, buckets, names}));
+    ASSERT_TRUE(status.ok()) << status.message();
+    status = (*writer)->close();
+    ASSERT_TRUE(status.ok()) << status.message();
+
+    auto mapped = file::MappedReadFile::open(path_.string());
+    ASSERT_TRUE(mapped.ok()) << mapped.status().message();
+    auto file = parquet::ParquetFile::open(std::move(mapped).value());
+    ASSERT_TRUE(file.ok()) << file.status().message();
+    file_ = std::move(file).value();
+  }
+
+  void TearDown() override {
+    file_.reset();
+    std::filesystem::remove(path_);
+  }
+
+  std::unique_ptr<ParquetScan> makeScan(ParquetScanOptions options) {
+    auto scan = ParquetScan::create(file_, pool_.get(), std::move(options));
+    EXPECT_TRUE(scan.ok()) << scan.status().message();
+    return std::move(scan).value();
+  }
+
+  // The ids of every batch the scan returns, checking each row's name.
+  static std::vector<std::int64_t> readIds(ParquetScan& scan) {
+    std::vector<std::int64_t> ids;
+    while (true) {
+      auto batch = scan.next();
+      EXPECT_TRUE(batch.ok()) << batch.status().message();
+      if (!batch.ok() || *batch == nullptr) {
+        return ids;
+      }
+      const auto* id = (*batch)->childAt(0)->asFlatVector<std::int64_t>();
+      const auto* name =
+          (*batch)->childAt(1)->asFlatVector<velox::StringView>();
+      for (velox::vector_size_t row = 0; row < (*batch)->size(); ++row) {
+        ids.push_back(id->valueAt(row));
+        EXPECT_EQ(std::string(name->valueAt(row)),
+                  "event name " + std::to_string(ids.back()));
+      }
+    }
+  }
+
+  static std::vector<std::int64_t> idRange(std::int64_t begin,
+                                           std::int64_t end) {
+    std::vector<std::int64_t> ids;
+    for (auto id = begin; id < end; ++id) {
+      ids.push_back(id);
+    }
+    return ids;
+  }
+
+  std::shared_ptr<velox::memory::MemoryPool> pool_;
+  std::filesystem::path path_;
+  std::deque<std::string> names_;
+  std::shared_ptr<parquet::ParquetFile> file_;
+};
+
+}  // namespace
+
+TEST_F(ParquetScanTest, UnfilteredScanReadsEveryRowGroup) {
+  auto scan = makeScan({.columns = {"id", "name"}});
+  EXPECT_EQ(scan->outputType()->names(),
+            (std::vector<std::string>{"id", "name"}));
+  EXPECT_EQ(readIds(*scan), idRange(0, 5000));
+  EXPECT_EQ(scan->stats().row_groups_read, 3U);
+  EXPECT_EQ(scan->stats().pages_read, 20U);
+  EXPECT_EQ(scan->stats().rows_read, 5000U);
+}
+
+TEST_F(ParquetScanTest, EqualityReadsOnlyTheMatchingPage) {
+  auto scan = makeScan({.columns = {"id", "name"},
+                        .filter_column = "id",
+                        .filter = ColumnPredicate::Equal(ZoneValue{2750})});
+  EXPECT_EQ(readIds(*scan), idRange(2500, 3000));
+  EXPECT_EQ(scan->stats().row_groups_read, 1U);
+  EXPECT_EQ(scan->stats().row_groups_skipped, 2U);
+  EXPECT_EQ(scan->stats().pages_read, 2U);
+}
+
+TEST_F(ParquetScanTest, InListSkipsRowGroupsAndPages) {
+  auto scan = makeScan(
+      {.columns = {"id", "name"},
+       .filter_column = "id",
+       .filter = ColumnPredicate::In({ZoneValue{10}, ZoneValue{4600},
+                                      ZoneValue{4999}})});
+  auto expected = idRange(0, 500);
+  for (const auto id : idRange(4500, 5000)) {
+    expected.push_back(id);
+  }
+  EXPECT_EQ(readIds(*scan), expected);
+  EXPECT_EQ(scan->stats().row_groups_read, 2U);
+  EXPECT_EQ(scan->stats().row_groups_skipped, 1U);
+  EXPECT_EQ(scan->stats().pages_read, 4U);
+}
+
+TEST_F(ParquetScanTest, BloomFilterSkipsValuesWithinMinMax) {
+  auto absent = makeScan({.columns = {"id", "name"},
+                          .filter_column = "bucket",
+                          .filter = ColumnPredicate::Equal(ZoneValue{41})});
+  EXPECT_TRUE(readIds(*absent).empty());
+  EXPECT_EQ(absent->stats().row_groups_skipped, 3U);
+
+  auto present = makeScan({.columns = {"id", "name"},
+                           .filter_column = "bucket",
+                           .filter = ColumnPredicate::Equal(ZoneValue{42})});
+  EXPECT_EQ(readIds(*present).size(), 5000U);
+}
+
+TEST_F(ParquetScanTest, MatchReadsOnlyTheIndexedRows) {
+  auto scan = makeScan(
+      {.columns = {"id", "name"},
+       .match = search::MatchPredicate{.column = "name",
+                                       .query = "10 OR 20 OR 4999"}});
+  // Matches this close together are read as one range.
+  auto expected = idRange(10, 21);
+  expected.push_back(4999);
+  EXPECT_EQ(readIds(*scan), expected);
+  EXPECT_EQ(scan->stats().row_groups_read, 2U);
+  EXPECT_EQ(scan->stats().row_groups_skipped, 1U);
+  EXPECT_EQ(scan->stats().rows_read, 12U);
+}
+
+TEST_F(ParquetScanTest, MatchAndFilterIntersect) {
+  auto scan = makeScan(
+      {.columns = {"id", "name"},
+       .filter_column = "id",
+       .filter = ColumnPredicate::Equal(ZoneValue{20}),
+       .match = search::MatchPredicate{.column = "name",
+                                       .query = "20 OR 4999"}});
+  EXPECT_EQ(readIds(*scan), (std::vector<std::int64_t>{20}));
+  EXPECT_EQ(scan->stats().row_groups_skipped, 2U);
+}
+
+TEST_F(ParquetScanTest, RejectsUnknownColumns) {
+  EXPECT_FALSE(
+      ParquetScan::create(file_, pool_.get(), {.columns = {"missing"}}).ok());
+  EXPECT_FALSE(ParquetScan::create(
+                   file_, pool_.get(),
+                   {.filter_column = "missing",
+                    .filter = ColumnPredicate::Equal(ZoneValue{1})})
+                   .ok());
+  EXPECT_FALSE(ParquetScan::create(
+                   file_, pool_.get(),
+                   {.match = search::MatchPredicate{.column = "missing",
+                                                    .query = "x"}})
+                   .ok());
+}
+
+}  // namespace halo::storage::scan
@@ -0,0 +1,134 @@
+// Log search through the full-text index against the full scan a LIKE
+// predicate does today: per query, the rows found and the time taken by
+// each, plus the cost of building the index and its size next to the text.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+import halo.common;
+import halo.storage.search;
+
+namespace halo::storage::search {
+
+namespace {
+
+constexpr std::size_t kRows = 200'000;
+constexpr int kRepeats = 5;
+
+std::vector<std::string> makeLog() {
+  const std::vector<std::string> levels = {"INFO", "INFO", "INFO", "WARN",
+                                           "ERROR"};
+  const std::vector<std::string> events = {
+      "request served in {} ms",
+      "connection refused by upstream {}",
+      "cache miss for key {}",
+      "user {} logged in",
+      "disk usage at {} percent",
+      "retrying request {} after timeout",
+      "checkpoint {} written",
+  };
+  std::mt19937 random(3);
+  std::vector<std::string> log;
+  log.reserve(kRows);
+  for (std::size_t i = 0; i < kRows; ++i) {
+    auto line = levels[random() % levels.size()] + " ";
+    // Refused connections are rare, so that query is selective.
+    std::size_t event = 1;
+    if (random() % 1000 != 0) {
+      event = random() % (events.size() - 1);
+      event += event >= 1 ? 1 : 0;
+    }
+    auto text = events[event];
+    text.replace(text.find("{}"), 2, std::to_string(random() % 100000));
+    log.push_back(line + text);
+  }
+  return log;
+}
+
+template <typename Fn>
+double millis(Fn&& fn) {
+  double best = 1e300;
+  for (int i = 0; i < kRepeats; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    best = std::min(best, std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - start)
+                              .count());
+  }
+  return best;
+}
+
+}  // namespace
+
+TEST(FullTextSearchBenchmark, IndexAgainstLikeScan) {
+  const auto log = makeLog();
+  std::size_t text_bytes = 0;
+  for (const auto& line : log) {
+    text_bytes += line.size();
+  }
+
+  auto builder = FullTextIndexBuilder::create();
+  ASSERT_TRUE(builder.ok()) << builder.status().toString();
+  const auto build_start = std::chrono::steady_clock::now();
+  for (const auto& line : log) {
+    builder->append(line);
+  }
+  const auto index = builder->build();
+  const auto build_ms = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - build_start)
+                            .count();
+
+  std::cout << std::fixed << std::setprecision(2) << kRows << " rows, "
+            << text_bytes / 1024 << " KiB of text, index of " << index.terms()
+            << " terms in " << index.postingBytes() / 1024
+            << " KiB built in " << build_ms << " ms\n"
+            << std::left << std::setw(28) << "query" << std::right
+            << std::setw(10) << "rows" << std::setw(12) << "like ms"
+            << std::setw(12) << "index ms" << std::setw(10) << "speedup"
+            << "\n";
+
+  // Each query with the substrings its LIKE form would need, all of which
+  // must appear.
+  const std::vector<std::pair<std::string, std::vector<std::string>>>
+      queries = {
+          {"refused", {"refused"}},
+          {"connection refused", {"connection", "refused"}},
+          {"error timeout", {"ERROR", "timeout"}},
+          {"request", {"request"}},
+      };
+  for (const auto& [query, substrings] : queries) {
+    std::size_t like_rows = 0;
+    const auto like_ms = millis([&] {
+      like_rows = 0;
+      for (const auto& line : log) {
+        like_rows += std::ranges::all_of(substrings, [&](const auto& s) {
+          return std::string_view(line).find(s) != std::string_view::npos;
+        });
+      }
+    });
+    std::size_t index_rows = 0;
+    const auto index_ms = millis([&] {
+      auto rows = index.search(query);
+      ASSERT_TRUE(rows.ok()) << rows.status().toString();
+      index_rows = rows->size();
+    });
+    // The index folds case, so it never finds fewer rows than LIKE.
+    EXPECT_GE(index_rows, like_rows) << query;
+    std::cout << std::left << std::setw(28) << query << std::right
+              << std::setw(10) << index_rows << std::setw(12) << like_ms
+              << std::setw(12) << index_ms << std::setw(10)
+              << like_ms / std::max(index_ms, 1e-3) << "\n";
+  }
+}
+
+}  // namespace halo::storage::search
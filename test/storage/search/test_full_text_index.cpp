@@ -0,0 +1,310 @@
+#include <gtest/gtest.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/core/Expressions.h>
+#include <velox/core/QueryCtx.h>
+#include <velox/expression/EvalCtx.h>
+#include <velox/expression/Expr.h>
+#include <velox/type/Type.h>
+#include <velox/type/Variant.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+#include <velox/vector/SelectivityVector.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+import halo.common;
+import halo.storage.format;
+import halo.storage.search;
+
+namespace halo::storage::search {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+using format::RowRange;
+
+TextAnalyzer makeAnalyzer(const TextAnalyzerOptions& options = {}) {
+  auto analyzer = TextAnalyzer::create(options);
+  EXPECT_TRUE(analyzer.ok()) << analyzer.status().toString();
+  return std::move(analyzer).value();
+}
+
+const std::vector<std::string> kLog = {
+    "Connection refused by upstream 10.0.0.7",
+    "request timed out after 30s",
+    "Connections REFUSED: too many clients",
+    "disk-full (code=28) on /var/log",
+    "user logged in",
+    "connection reset by peer",
+};
+
+FullTextIndex buildIndex(const std::vector<std::optional<std::string>>& rows) {
+  auto builder = FullTextIndexBuilder::create();
+  EXPECT_TRUE(builder.ok()) << builder.status().toString();
+  for (const auto& row : rows) {
+    if (row.has_value()) {
+      builder->append(*row);
+    } else {
+      builder->appendNull();
+    }
+  }
+  return builder->build();
+}
+
+FullTextIndex buildLogIndex() {
+  return buildIndex({kLog.begin(), kLog.end()});
+}
+
+std::vector<std::uint32_t> search(const FullTextIndex& index,
+                                  const std::string& query) {
+  auto rows = index.search(query);
+  EXPECT_TRUE(rows.ok()) << rows.status().toString();
+  return rows.ok() ? *rows : std::vector<std::uint32_t>{};
+}
+
+}  // namespace
+
+TEST(TextAnalyzerTest, NormalizesSegmentsAndStems) {
+  auto analyzer = makeAnalyzer();
+  EXPECT_EQ(analyzer.analyze("The Runners were RUNNING, café!"),
+            (std::vector<std::string>{"the", "runner", "were", "run",
+                                      "cafe"}));
+  // Compatibility forms fold to their plain letters.
+  EXPECT_EQ(analyzer.analyze("\xEF\xAC\x81les \xEF\xBC\xA1\xEF\xBC\xA2"),
+            (std::vector<std::string>{"file", "ab"}));
+  EXPECT_EQ(analyzer.analyze("disk-full (code=28)"),
+            (std::vector<std::string>{"disk", "full", "code", "28"}));
+  EXPECT_TRUE(analyzer.analyze(" -- !! ").empty());
+}
+
+TEST(TextAnalyzerTest, OptionsTurnOffStemmingAndAccentFolding) {
+  auto analyzer = makeAnalyzer({.stemmer = "", .strip_accents = false});
+  EXPECT_EQ(analyzer.analyze("Running café"),
+            (std::vector<std::string>{"running", "caf\xC3\xA9"}));
+
+  EXPECT_EQ(TextAnalyzer::create({.stemmer = "klingon"}).status().code(),
+            common::base::Status::Code::kInvalid);
+}
+
+TEST(PostingListTest, RoundTripsAndSeeks) {
+  std::mt19937 random(7);
+  std::vector<std::uint32_t> rows;
+  std::uint32_t row = 3;
+  for (int i = 0; i < 1000; ++i) {
+    rows.push_back(row);
+    // Mostly small gaps with the occasional long jump.
+    row += i % 97 == 0 ? 100000 : 1 + random() % 20;
+  }
+  const auto list = PostingList::encode(rows);
+  EXPECT_EQ(list.size(), rows.size());
+  EXPECT_EQ(list.decode(), rows);
+  EXPECT_LT(list.bytes(), rows.size() * sizeof(std::uint32_t));
+
+  PostingList::Cursor cursor(list);
+  cursor.seek(rows[500] - 1);
+  ASSERT_FALSE(cursor.done());
+  EXPECT_EQ(cursor.row(), rows[500]);
+  cursor.next();
+  EXPECT_EQ(cursor.row(), rows[501]);
+  cursor.seek(rows.back());
+  EXPECT_EQ(cursor.row(), rows.back());
+  cursor.seek(rows.back() + 1);
+  EXPECT_TRUE(cursor.done());
+}
+
+TEST(PostingListTest, ConsecutiveRowsTakeNoPackedBits) {
+  std::vector<std::uint32_t> rows(1000);
+  for (std::uint32_t i = 0; i < rows.size(); ++i) {
+    rows[i] = 42 + i;
+  }
+  const auto list = PostingList::encode(rows);
+  EXPECT_EQ(list.decode(), rows);
+  EXPECT_LT(list.bytes(), 256U);
+  EXPECT_TRUE(PostingList::encode({}).decode().empty());
+}
+
+TEST(FullTextIndexTest, AnswersConjunctionsAndAlternatives) {
+  const auto index = buildLogIndex();
+  EXPECT_EQ(index.rows(), kLog.size());
+  EXPECT_EQ(search(index, "connection refused"),
+            (std::vector<std::uint32_t>{0, 2}));
+  EXPECT_EQ(search(index, "connected"),
+            (std::vector<std::uint32_t>{0, 2, 5}));
+  EXPECT_EQ(search(index, "timeout OR refused"),
+            (std::vector<std::uint32_t>{0, 2}));
+  EXPECT_EQ(search(index, "timed OR full OR peer"),
+            (std::vector<std::uint32_t>{1, 3, 5}));
+  EXPECT_TRUE(search(index, "connection missing").empty());
+  EXPECT_TRUE(search(index, "?!").empty());
+}
+
+TEST(FullTextIndexTest, NullsTakeARowButMatchNothing) {
+  const auto index =
+      buildIndex({"error one", std::nullopt, std::nullopt, "error two"});
+  EXPECT_EQ(index.rows(), 4U);
+  EXPECT_EQ(search(index, "error"), (std::vector<std::uint32_t>{0, 3}));
+}
+
+TEST(FullTextIndexTest, MatchingRowsAreCoalesced) {
+  const auto index = buildIndex(
+      {"warn", "error a", "error b", "error c", "warn", "error d"});
+  const auto ranges = index.matchingRows("error");
+  ASSERT_TRUE(ranges.ok()) << ranges.status().toString();
+  EXPECT_EQ(*ranges, (std::vector<RowRange>{{.begin = 1, .end = 4},
+                                            {.begin = 5, .end = 6}}));
+}
+
+TEST(FullTextIndexTest, AgreesWithEvaluatingEveryRow) {
+  const std::vector<std::string> words = {
+      "alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta", "theta"};
+  std::mt19937 random(11);
+  std::vector<std::optional<std::string>> rows;
+  for (int i = 0; i < 5000; ++i) {
+    std::string text;
+    const auto length = 1 + random() % 4;
+    for (std::uint32_t w = 0; w < length; ++w) {
+      text += words[random() % words.size()] + " ";
+    }
+    rows.emplace_back(std::move(text));
+  }
+  const auto index = buildIndex(rows);
+  auto analyzer = makeAnalyzer();
+  for (const std::string query :
+       {"alpha", "alpha beta", "gamma delta zeta", "eta OR theta beta"}) {
+    const auto parsed = TextQuery::parse(query, analyzer);
+    std::vector<std::uint32_t> expected;
+    for (std::uint32_t row = 0; row < rows.size(); ++row) {
+      auto terms = analyzer.analyze(*rows[row]);
+      uniqueTerms(terms);
+      if (parsed.matches(terms)) {
+        expected.push_back(row);
+      }
+    }
+    EXPECT_FALSE(expected.empty()) << query;
+    EXPECT_EQ(search(index, query), expected) << query;
+  }
+}
+
+TEST(FullTextIndexTest, SerializedIndexAnswersTheSame) {
+  auto builder = FullTextIndexBuilder::create({.stemmer = ""});
+  ASSERT_TRUE(builder.ok()) << builder.status().toString();
+  for (int i = 0; i < 3000; ++i) {
+    builder->append(i % 3 == 0 ? "error code " + std::to_string(i % 7)
+                               : "request ok " + std::to_string(i));
+  }
+  builder->appendNull();
+  const auto index = builder->build();
+  const auto bytes = index.serialize();
+  auto read = FullTextIndex::deserialize(bytes);
+  ASSERT_TRUE(read.ok()) << read.status().toString();
+  EXPECT_EQ(read->rows(), index.rows());
+  EXPECT_EQ(read->terms(), index.terms());
+  EXPECT_EQ(read->options().stemmer, "");
+  EXPECT_EQ(read->serialize(), bytes);
+  for (const std::string query : {"error", "error 3", "request OR 5", "x"}) {
+    EXPECT_EQ(search(*read, query), search(index, query)) << query;
+  }
+}
+
+TEST(FullTextIndexTest, RejectsCorruptBytes) {
+  const auto bytes = buildLogIndex().serialize();
+  for (std::size_t length = 0; length < bytes.size(); ++length) {
+    EXPECT_FALSE(
+        FullTextIndex::deserialize(std::span(bytes.data(), length)).ok())
+        << length;
+  }
+  auto newer = bytes;
+  newer[0] = 2;
+  EXPECT_EQ(FullTextIndex::deserialize(newer).status().code(),
+            common::base::Status::Code::kNotImplemented);
+}
+
+TEST(MatchPredicateTest, Parses) {
+  auto predicate = MatchPredicate::parse("match(message, 'disk full')");
+  ASSERT_TRUE(predicate.ok()) << predicate.status().toString();
+  EXPECT_EQ(predicate->column, "message");
+  EXPECT_EQ(predicate->query, "disk full");
+
+  predicate = MatchPredicate::parse(R"( MATCH ( "log line" , 'it''s' ) )");
+  ASSERT_TRUE(predicate.ok()) << predicate.status().toString();
+  EXPECT_EQ(predicate->column, "log line");
+  EXPECT_EQ(predicate->query, "it's");
+
+  for (const char* invalid :
+       {"matches(m, 'x')", "match(m 'x')", "match(, 'x')", "match(m, x)",
+        "match(m, 'x'", "match(m, 'x) ", "match(m, 'x') AND"}) {
+    EXPECT_EQ(MatchPredicate::parse(invalid).status().code(),
+              common::base::Status::Code::kInvalid)
+        << invalid;
+  }
+}
+
+TEST(MatchPredicateTest, ScanAnswersFromTheColumnIndex) {
+  FullTextIndexes indexes;
+  indexes.emplace("message", buildLogIndex());
+  auto rows = matchingRows({.column = "message", .query = "refused"},
+                           indexes);
+  ASSERT_TRUE(rows.ok()) << rows.status().toString();
+  ASSERT_TRUE(rows->has_value());
+  EXPECT_EQ(**rows, (std::vector<RowRange>{{.begin = 0, .end = 1},
+                                           {.begin = 2, .end = 3}}));
+
+  rows = matchingRows({.column = "host", .query = "refused"}, indexes);
+  ASSERT_TRUE(rows.ok()) << rows.status().toString();
+  EXPECT_FALSE(rows->has_value());
+}
+
+TEST(MatchPredicateTest, FunctionAgreesWithTheIndex) {
+  registerMatchFunction();
+  auto root = velox::memory::memoryManager()->addRootPool("match");
+  auto pool = root->addLeafChild("match_leaf");
+
+  const auto size = static_cast<velox::vector_size_t>(kLog.size());
+  auto messages =
+      velox::BaseVector::create<velox::FlatVector<velox::StringView>>(
+          velox::VARCHAR(), size + 1, pool.get());
+  for (velox::vector_size_t i = 0; i < size; ++i) {
+    messages->set(i, velox::StringView(kLog[i]));
+  }
+  messages->setNull(size, true);
+  const auto input = std::make_shared<velox::RowVector>(
+      pool.get(), velox::ROW({"message"}, {velox::VARCHAR()}), nullptr,
+      messages->size(), std::vector<velox::VectorPtr>{messages});
+
+  const auto call = std::make_shared<velox::core::CallTypedExpr>(
+      velox::BOOLEAN(),
+      std::vector<velox::core::TypedExprPtr>{
+          std::make_shared<velox::core::FieldAccessTypedExpr>(
+              velox::VARCHAR(), "message"),
+          std::make_shared<velox::core::ConstantTypedExpr>(
+              velox::VARCHAR(),
+              velox::variant(std::string("connection refused")))},
+      "match");
+  auto query_ctx = velox::core::QueryCtx::create();
+  velox::core::ExecCtx exec_ctx(pool.get(), query_ctx.get());
+  velox::exec::ExprSet expressions({call}, &exec_ctx);
+  velox::exec::EvalCtx eval_ctx(&exec_ctx, &expressions, input.get());
+  velox::SelectivityVector rows(input->size());
+  std::vector<velox::VectorPtr> results(1);
+  expressions.eval(rows, eval_ctx, results);
+
+  const auto* matches = results[0]->as<velox::SimpleVector<bool>>();
+  const auto expected = search(buildLogIndex(), "connection refused");
+  for (velox::vector_size_t row = 0; row < size; ++row) {
+    EXPECT_EQ(matches->valueAt(row),
+              std::ranges::find(expected, static_cast<std::uint32_t>(row)) !=
+                  expected.end())
+        << kLog[row];
+  }
+  EXPECT_TRUE(matches->isNullAt(size));
+}
+
+}  // namespace halo::storage::search
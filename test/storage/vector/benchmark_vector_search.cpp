@@ -0,0 +1,132 @@
+// Embedding lookups against the brute-force scan they replace: per index
+// kind, build time, and the time to answer a batch of queries searched one
+// at a time and all together. Searching the batch together lets the flat
+// and IVF indexes score it with BLAS GEMM kernels.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+import halo.common;
+import halo.storage.vector;
+
+namespace halo::storage::vector {
+
+namespace {
+
+constexpr std::size_t kDimension = 128;
+constexpr std::size_t kRows = 100'000;
+constexpr std::size_t kQueries = 256;
+constexpr std::size_t kK = 10;
+
+std::vector<float> makeVectors(std::size_t rows, std::uint32_t seed) {
+  std::mt19937 random(seed);
+  std::normal_distribution<float> value;
+  std::vector<float> values(rows * kDimension);
+  for (auto& v : values) {
+    v = value(random);
+  }
+  return values;
+}
+
+double millisSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Top-k by L2 over every row, one query at a time.
+std::int64_t bruteForce(const std::vector<float>& values,
+                        std::span<const float> query) {
+  std::vector<std::pair<float, std::int64_t>> scored(kRows);
+  for (std::size_t row = 0; row < kRows; ++row) {
+    float distance = 0;
+    for (std::size_t i = 0; i < kDimension; ++i) {
+      const auto diff = values[row * kDimension + i] - query[i];
+      distance += diff * diff;
+    }
+    scored[row] = {distance, static_cast<std::int64_t>(row)};
+  }
+  std::partial_sort(scored.begin(), scored.begin() + kK, scored.end());
+  return scored.front().second;
+}
+
+}  // namespace
+
+TEST(VectorSearchBenchmark, IndexesAgainstBruteForce) {
+  const auto values = makeVectors(kRows, 1);
+  const auto queries = makeVectors(kQueries, 2);
+
+  auto start = std::chrono::steady_clock::now();
+  std::int64_t checksum = 0;
+  for (std::size_t q = 0; q < kQueries; ++q) {
+    checksum += bruteForce(
+        values, std::span<const float>(queries).subspan(q * kDimension,
+                                                         kDimension));
+  }
+  const auto brute_ms = millisSince(start);
+  EXPECT_GE(checksum, 0);
+
+  std::cout << std::fixed << std::setprecision(2) << kRows << " rows of "
+            << kDimension << " floats, " << kQueries << " queries, k = " << kK
+            << "\n"
+            << std::left << std::setw(12) << "index" << std::right
+            << std::setw(12) << "build ms" << std::setw(14) << "single ms"
+            << std::setw(14) << "batch ms" << std::setw(12) << "vs brute"
+            << "\n"
+            << std::left << std::setw(12) << "brute force" << std::right
+            << std::setw(12) << 0.0 << std::setw(14) << brute_ms
+            << std::setw(14) << brute_ms << std::setw(12) << 1.0 << "\n";
+
+  const std::vector<std::pair<const char*, VectorIndexKind>> kinds = {
+      {"flat", VectorIndexKind::kFlat},
+      {"ivf-pq", VectorIndexKind::kIvfPq},
+      {"hnsw", VectorIndexKind::kHnsw},
+  };
+  for (const auto& [name, kind] : kinds) {
+    start = std::chrono::steady_clock::now();
+    auto builder = VectorIndexBuilder::create(
+        kDimension, {.kind = kind, .pq_subquantizers = 16});
+    ASSERT_TRUE(builder.ok()) << builder.status().toString();
+    for (std::size_t row = 0; row < kRows; ++row) {
+      ASSERT_TRUE(builder
+                      ->append(std::span<const float>(values).subspan(
+                          row * kDimension, kDimension))
+                      .ok());
+    }
+    auto index = builder->build();
+    ASSERT_TRUE(index.ok()) << index.status().toString();
+    const auto build_ms = millisSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for (std::size_t q = 0; q < kQueries; ++q) {
+      ASSERT_TRUE(index
+                      ->search(std::span<const float>(queries).subspan(
+                                   q * kDimension, kDimension),
+                               kK)
+                      .ok());
+    }
+    const auto single_ms = millisSince(start);
+
+    start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(index->search(queries, kK).ok());
+    const auto batch_ms = millisSince(start);
+
+    std::cout << std::left << std::setw(12) << name << std::right
+              << std::setw(12) << build_ms << std::setw(14) << single_ms
+              << std::setw(14) << batch_ms << std::setw(12)
+              << brute_ms / std::max(batch_ms, 1e-3) << "\n";
+  }
+}
+
+}  // namespace halo::storage::vector
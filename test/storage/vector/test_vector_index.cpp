@@ -0,0 +1,281 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <velox/common/memory/Memory.h>
+#include <velox/type/Type.h>
+#include <velox/vector/ComplexVector.h>
+#include <velox/vector/FlatVector.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+import halo.common;
+import halo.storage.vector;
+
+namespace halo::storage::vector {
+
+namespace {
+
+namespace velox = facebook::velox;
+
+using common::base::Status;
+
+constexpr std::size_t kDimension = 32;
+constexpr std::size_t kRows = 4000;
+constexpr std::size_t kK = 10;
+
+// Points scattered around a few dozen centers, like clustered embeddings.
+std::vector<float> makeVectors(std::size_t rows, std::uint32_t seed) {
+  std::mt19937 random(seed);
+  std::normal_distribution<float> noise(0.0F, 0.1F);
+  std::uniform_real_distribution<float> center(-1.0F, 1.0F);
+  std::vector<float> centers(40 * kDimension);
+  for (auto& value : centers) {
+    value = center(random);
+  }
+  std::vector<float> values(rows * kDimension);
+  for (std::size_t row = 0; row < rows; ++row) {
+    const auto c = random() % 40;
+    for (std::size_t i = 0; i < kDimension; ++i) {
+      values[row * kDimension + i] =
+          centers[c * kDimension + i] + noise(random);
+    }
+  }
+  return values;
+}
+
+// Exact k nearest rows of every query by L2 distance.
+std::vector<std::vector<std::int64_t>> bruteForce(
+    const std::vector<float>& values, const std::vector<float>& queries) {
+  std::vector<std::vector<std::int64_t>> nearest;
+  for (std::size_t q = 0; q * kDimension < queries.size(); ++q) {
+    std::vector<std::pair<float, std::int64_t>> scored;
+    for (std::size_t row = 0; row * kDimension < values.size(); ++row) {
+      float distance = 0;
+      for (std::size_t i = 0; i < kDimension; ++i) {
+        const auto diff =
+            values[row * kDimension + i] - queries[q * kDimension + i];
+        distance += diff * diff;
+      }
+      scored.emplace_back(distance, static_cast<std::int64_t>(row));
+    }
+    std::partial_sort(scored.begin(), scored.begin() + kK, scored.end());
+    std::vector<std::int64_t> rows;
+    for (std::size_t i = 0; i < kK; ++i) {
+      rows.push_back(scored[i].second);
+    }
+    nearest.push_back(std::move(rows));
+  }
+  return nearest;
+}
+
+VectorIndex build(const std::vector<float>& values,
+                  const VectorIndexOptions& options) {
+  auto builder = VectorIndexBuilder::create(kDimension, options);
+  EXPECT_TRUE(builder.ok()) << builder.status().toString();
+  for (std::size_t row = 0; row * kDimension < values.size(); ++row) {
+    EXPECT_TRUE(builder
+                    ->append(std::span<const float>(
+                        values.data() + row * kDimension, kDimension))
+                    .ok());
+  }
+  auto index = builder->build();
+  EXPECT_TRUE(index.ok()) << index.status().toString();
+  return std::move(index).value();
+}
+
+// Fraction of the exact neighbors the index found.
+double recall(const VectorIndex& index, const std::vector<float>& values,
+              const std::vector<float>& queries) {
+  const auto result = index.search(queries, kK);
+  EXPECT_TRUE(result.ok()) << result.status().toString();
+  const auto expected = bruteForce(values, queries);
+  std::size_t found = 0;
+  for (std::size_t q = 0; q < expected.size(); ++q) {
+    const auto begin = result->row_ids.begin() +
+                       static_cast<std::ptrdiff_t>(q * kK);
+    for (const auto row : expected[q]) {
+      found += std::find(begin, begin + kK, row) != begin + kK ? 1 : 0;
+    }
+  }
+  return static_cast<double>(found) /
+         static_cast<double>(expected.size() * kK);
+}
+
+velox::VectorPtr makeArrays(const std::vector<float>& values,
+                            std::size_t dimension,
+                            velox::memory::MemoryPool* pool,
+                            const std::vector<bool>& nulls = {}) {
+  const auto rows = values.size() / dimension;
+  auto elements = velox::BaseVector::create<velox::FlatVector<float>>(
+      velox::REAL(), static_cast<velox::vector_size_t>(values.size()), pool);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    elements->set(static_cast<velox::vector_size_t>(i), values[i]);
+  }
+  auto arrays = velox::BaseVector::create<velox::ArrayVector>(
+      velox::ARRAY(velox::REAL()), static_cast<velox::vector_size_t>(rows),
+      pool);
+  arrays->setElements(elements);
+  for (std::size_t row = 0; row < rows; ++row) {
+    const auto r = static_cast<velox::vector_size_t>(row);
+    arrays->setOffsetAndSize(
+        r, static_cast<velox::vector_size_t>(row * dimension),
+        static_cast<velox::vector_size_t>(dimension));
+    if (row < nulls.size() && nulls[row]) {
+      arrays->setNull(r, true);
+    }
+  }
+  return arrays;
+}
+
+class VectorIndexTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = velox::memory::memoryManager()->addRootPool("vector_index");
+    pool_ = root_->addLeafChild("vector_index_leaf");
+    values_ = makeVectors(kRows, 1);
+    queries_ = makeVectors(100, 2);
+  }
+
+  std::shared_ptr<velox::memory::MemoryPool> root_;
+  std::shared_ptr<velox::memory::MemoryPool> pool_;
+  std::vector<float> values_;
+  std::vector<float> queries_;
+};
+
+}  // namespace
+
+TEST_F(VectorIndexTest, FlatIsExact) {
+  const auto index = build(values_, {.kind = VectorIndexKind::kFlat});
+  EXPECT_EQ(index.size(), kRows);
+  // Exact up to rounding: batched queries get their distances from a GEMM,
+  // which can swap near ties at the k-th place.
+  EXPECT_GE(recall(index, values_, queries_), 0.99);
+}
+
+TEST_F(VectorIndexTest, HnswRecall) {
+  const auto index = build(values_, {.kind = VectorIndexKind::kHnsw});
+  EXPECT_GT(recall(index, values_, queries_), 0.9);
+}
+
+TEST_F(VectorIndexTest, IvfPqFindsIndexedVectors) {
+  const auto index = build(values_, {.kind = VectorIndexKind::kIvfPq});
+  // Product quantization blurs the distances between near neighbors, but
+  // an indexed vector still ranks itself among its nearest rows.
+  std::vector<float> queries(values_.begin(),
+                             values_.begin() + 200 * kDimension);
+  const auto result = index.search(queries, kK);
+  ASSERT_TRUE(result.ok()) << result.status().toString();
+  std::size_t found = 0;
+  for (std::size_t q = 0; q < 200; ++q) {
+    const auto begin = result->row_ids.begin() +
+                       static_cast<std::ptrdiff_t>(q * kK);
+    found += std::find(begin, begin + kK, static_cast<std::int64_t>(q)) !=
+                     begin + kK
+                 ? 1
+                 : 0;
+  }
+  EXPECT_GT(found, 180U);
+}
+
+TEST_F(VectorIndexTest, IvfPqValidatesItsShape) {
+  EXPECT_EQ(VectorIndexBuilder::create(
+                30, {.kind = VectorIndexKind::kIvfPq, .pq_subquantizers = 8})
+                .status()
+                .code(),
+            Status::Code::kInvalid);
+  const std::vector<float> few(100 * kDimension, 1.0F);
+  auto builder =
+      VectorIndexBuilder::create(kDimension, {.kind = VectorIndexKind::kIvfPq});
+  ASSERT_TRUE(builder.ok());
+  for (std::size_t row = 0; row < 100; ++row) {
+    ASSERT_TRUE(builder
+                    ->append(std::span<const float>(
+                        few.data() + row * kDimension, kDimension))
+                    .ok());
+  }
+  EXPECT_EQ(builder->build().status().code(), Status::Code::kInvalid);
+}
+
+TEST_F(VectorIndexTest, ArrayColumnRowsKeepTheirNumbers) {
+  std::vector<float> values(4 * kDimension);
+  for (std::size_t row = 0; row < 4; ++row) {
+    std::fill_n(values.begin() + static_cast<std::ptrdiff_t>(row * kDimension),
+                kDimension, static_cast<float>(row));
+  }
+  auto builder =
+      VectorIndexBuilder::create(kDimension, {.kind = VectorIndexKind::kFlat});
+  ASSERT_TRUE(builder.ok());
+  ASSERT_TRUE(builder
+                  ->append(*makeArrays(values, kDimension, pool_.get(),
+                                       {false, true, false, false}))
+                  .ok());
+  auto index = builder->build();
+  ASSERT_TRUE(index.ok()) << index.status().toString();
+  EXPECT_EQ(index->size(), 3U);
+
+  const std::vector<float> query(kDimension, 1.2F);
+  const auto result = index->search(query, 2);
+  ASSERT_TRUE(result.ok()) << result.status().toString();
+  // Row 1 is NULL, so the nearest rows to 1.2 are 2 and 0.
+  EXPECT_EQ(result->row_ids, (std::vector<std::int64_t>{2, 0}));
+
+  auto wrong = VectorIndexBuilder::create(kDimension + 1);
+  ASSERT_TRUE(wrong.ok());
+  EXPECT_EQ(wrong->append(*makeArrays(values, kDimension, pool_.get())).code(),
+            Status::Code::kInvalid);
+}
+
+TEST_F(VectorIndexTest, KnnReadsPersistedIndexes) {
+  const auto directory =
+      std::filesystem::temp_directory_path() /
+      ("halo_vector_index_" + std::to_string(::getpid()));
+  const VectorIndexOptions options{.kind = VectorIndexKind::kHnsw};
+  {
+    auto catalog = VectorIndexCatalog::create(directory.string(), options);
+    ASSERT_TRUE(catalog->put("docs", "embedding", build(values_, options))
+                    .ok());
+  }
+  EXPECT_TRUE(std::filesystem::exists(directory / "docs" /
+                                      VectorIndex::fileName("embedding")));
+
+  // A fresh catalog loads the index from disk.
+  auto catalog = VectorIndexCatalog::create(directory.string(), options);
+  std::vector<float> queries(queries_.begin(),
+                             queries_.begin() + 3 * kDimension);
+  auto rows = knn(*catalog, "docs", "embedding",
+                  *makeArrays(queries, kDimension, pool_.get(),
+                              {false, true, false}),
+                  kK, pool_.get());
+  ASSERT_TRUE(rows.ok()) << rows.status().toString();
+  const auto& output = *rows;
+  EXPECT_TRUE(output->type()->equivalent(*knnOutputType()));
+  ASSERT_EQ(output->size(), static_cast<velox::vector_size_t>(2 * kK));
+
+  const auto k = static_cast<velox::vector_size_t>(kK);
+  const auto* query =
+      output->childAt(0)->as<velox::SimpleVector<std::int32_t>>();
+  const auto* distance = output->childAt(2)->as<velox::SimpleVector<float>>();
+  for (velox::vector_size_t i = 0; i < output->size(); ++i) {
+    // The NULL query in the middle has no neighbors.
+    EXPECT_EQ(query->valueAt(i), i < k ? 0 : 2);
+    if (i % k != 0) {
+      EXPECT_LE(distance->valueAt(i - 1), distance->valueAt(i));
+    }
+  }
+
+  const auto arrays = makeArrays(queries, kDimension, pool_.get());
+  EXPECT_EQ(
+      knn(*catalog, "docs", "title", *arrays, kK, pool_.get()).status().code(),
+      Status::Code::kInvalid);
+  std::filesystem::remove_all(directory);
+}
+
+}  // namespace halo::storage::vector
@@ -1,31 +1,8 @@
 #include <gtest/gtest.h>
 
-// Provide hash specialization for __int128 before including Folly headers
-// This is needed because std::hash<__int128> is not defined in the standard
-// library
-#if defined(__linux__) && defined(__SIZEOF_INT128__)
-namespace std {
-template <>
-struct hash<__int128> {
-  size_t operator()(__int128 value) const noexcept {
-    // Combine high and low 64 bits using a simple hash function
-    uint64_t low = static_cast<uint64_t>(value);
-    uint64_t high = static_cast<uint64_t>(value >> 64);
-    // Use FNV-1a style mixing
-    return hash<uint64_t>{}(low) ^ (hash<uint64_t>{}(high) << 1);
-  }
-};
-
-template <>
-struct hash<unsigned __int128> {
-  size_t operator()(unsigned __int128 value) const noexcept {
-    uint64_t low = static_cast<uint64_t>(value);
-    uint64_t high = static_cast<uint64_t>(value >> 64);
-    return hash<uint64_t>{}(low) ^ (hash<uint64_t>{}(high) << 1);
-  }
-};
-}  // namespace std
-#endif
+// std::hash<__int128> for the Folly containers Velox and DuckDB pull in;
+// must come before their headers.
+#include <common/hash/Int128Hash.h>
 
 #include <velox/common/memory/Memory.h>
 #include <velox/core/Expressions.h>
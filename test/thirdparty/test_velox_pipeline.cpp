@@ -5,35 +5,10 @@
 // fails due to forward declaration) and instead include the umbrella Memory.h
 // plus the specific vector/type headers we need.
 
-// Workaround for libstdc++ (GCC's standard library on Linux) missing __int128
-// hash support. This is needed by Folly F14 containers used internally by
-// Velox. Note: macOS with libc++ (Clang's standard library) doesn't need this
-// workaround as it provides __int128 hash support out of the box.
-#include <cstdint>
-
-// Only define __int128 hash specializations for libstdc++ (not libc++)
-#if defined(__GLIBCXX__) && !defined(_LIBCPP_VERSION)
-#include <functional>
-#include <type_traits>
-
-namespace std {
-template <>
-struct hash<__int128> {
-  size_t operator()(__int128 value) const noexcept {
-    return std::hash<uint64_t>{}(static_cast<uint64_t>(value)) ^
-           (std::hash<uint64_t>{}(static_cast<uint64_t>(value >> 64)) << 1);
-  }
-};
-
-template <>
-struct hash<unsigned __int128> {
-  size_t operator()(unsigned __int128 value) const noexcept {
-    return std::hash<uint64_t>{}(static_cast<uint64_t>(value)) ^
-           (std::hash<uint64_t>{}(static_cast<uint64_t>(value >> 64)) << 1);
-  }
-};
-}  // namespace std
-#endif  // __GLIBCXX__ && !_LIBCPP_VERSION
+// libstdc++ has no std::hash<__int128> without GNU extensions, and Folly
+// F14 containers inside Velox need one; the shared header provides it, and
+// must come before them.
+#include <common/hash/Int128Hash.h>
 
 #include <gtest/gtest.h>
 #include <velox/common/caching/SsdCache.h>
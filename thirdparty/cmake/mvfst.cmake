@@ -170,4 +170,8 @@ thirdparty_build_cmake_library("mvfst"
 
 halo_find_package(mvfst CONFIG QUIET REQUIRED)
 
-thirdparty_map_imported_config(mvfst::mvfst_transport)
+thirdparty_map_imported_config(
+    mvfst::mvfst_transport
+    mvfst::mvfst_client
+    mvfst::mvfst_server
+    mvfst::mvfst_fizz_client)